@@ -0,0 +1,67 @@
+// Microbenchmarks of the platform independent core (std only headers, no D3D12/Windows types).
+// Builds with any C++20 compiler through CMakeLists.txt in this folder, eg: on Linux
+//   cmake -S . -B build && cmake --build build -j
+//   ./build/AstroBenchmarks [--filter <name substring>] [--min-time <seconds>]
+
+#include "MicroBenchmark.h"
+
+#include <cstdlib>
+#include <new>
+
+// Every heap allocation of the process goes through these, so the harness can report allocations per iteration
+void* operator new(std::size_t byteSize)
+{
+	MicroBenchmark::AllocationCounters& counters = MicroBenchmark::GetAllocationCounters();
+	counters.Count.fetch_add(1, std::memory_order_relaxed);
+	counters.ByteSize.fetch_add(byteSize, std::memory_order_relaxed);
+
+	if (void* memory = std::malloc(byteSize == 0 ? 1 : byteSize))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void* operator new[](std::size_t byteSize)
+{
+	return operator new(byteSize);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+int main(int argc, char** argv)
+{
+	MicroBenchmark::RunSettings settings;
+	for (int argIdx = 1; argIdx + 1 < argc; ++argIdx)
+	{
+		const std::string_view arg = argv[argIdx];
+		if (arg == "--filter")
+		{
+			settings.Filter = argv[++argIdx];
+		}
+		else if (arg == "--min-time")
+		{
+			settings.MinSeconds = std::atof(argv[++argIdx]);
+		}
+	}
+
+	return MicroBenchmark::RunAll(settings) > 0 ? 0 : 1;
+}
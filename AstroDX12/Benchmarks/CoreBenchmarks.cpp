@@ -0,0 +1,588 @@
+#include "MicroBenchmark.h"
+#include "RenderingFixtures.h"
+
+#include <map>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <DemoConfig.h>
+#include <External/Hash.h>
+#include <GameContent/Scene/SceneDescriptionParser.h>
+#include <Input/InputRecording.h>
+#include <Rendering/Common/GPUMemorySubAllocator.h>
+#include <Rendering/RenderData/Icosphere.h>
+#include <Rendering/RenderData/VertexDataConversion.h>
+#include <Rendering/Common/SDFRaymarch.h>
+#include <Rendering/Common/ShaderKey.h>
+#include <Rendering/Common/SimStateSnapshot.h>
+#include <Simulation/ParticleSystem.h>
+#include <Timing/FixedStepScheduler.h>
+
+using namespace MicroBenchmark;
+using namespace RenderingFixtures;
+
+namespace
+{
+	std::string MakeSceneText(int64_t objectCount)
+	{
+		std::string text;
+		for (int64_t objectIdx = 0; objectIdx < objectCount; ++objectIdx)
+		{
+			text += "#\nMeshPath\nContent/Meshes/spider_" + std::to_string(objectIdx) + ".fbx\n";
+			text += "Position\n100.23,4.1234,4.8\nRotation\n33,90,-40\nScale\n0.2,0.2,0.2\n/\n";
+		}
+		return text;
+	}
+
+	std::string MakeDemoConfigText(int64_t demoCount)
+	{
+		std::string text = "# Astro DX12 Demo Configuration\n# Set demos to true/false to enable/disable them on startup\n\n";
+		for (int64_t demoIdx = 0; demoIdx < demoCount; ++demoIdx)
+		{
+			text += "Demo" + std::to_string(demoIdx) + " = " + (demoIdx % 2 == 0 ? "true" : "false") + "\n";
+		}
+		return text;
+	}
+
+	// Same footprint as a D3D12_GRAPHICS_PIPELINE_STATE_DESC with a few input elements, hashed the way PipelineStateObjectLibrary does
+	struct PSODescStandIn
+	{
+		uint32_t Words[160];
+	};
+
+	size_t HashPSODescStandIn(const PSODescStandIn& desc)
+	{
+		size_t hash = Utility::HashState(&desc.Words[0], 4);
+		for (size_t wordIdx = 4; wordIdx < std::size(desc.Words); wordIdx += 4)
+		{
+			hash = Utility::HashState(&desc.Words[wordIdx], 4, hash);
+		}
+		return hash;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Scene & config parsing
+//---------------------------------------------------------------------------------------
+
+static void SceneDescriptionParser_Parse(State& state)
+{
+	const std::string sceneText = MakeSceneText(state.GetArg());
+	while (state.KeepRunning())
+	{
+		std::istringstream stream(sceneText);
+		const std::vector<ParsedSceneObject> sceneObjects = SceneDescriptionParser::Parse(stream);
+		DoNotOptimize(sceneObjects.data());
+	}
+	state.SetBytesProcessed(state.GetIterationCount() * sceneText.size());
+}
+ASTRO_BENCHMARK(SceneDescriptionParser_Parse, { 1, 64, 1024 });
+
+static void DemoConfig_Parse(State& state)
+{
+	const std::string configText = MakeDemoConfigText(state.GetArg());
+	while (state.KeepRunning())
+	{
+		std::istringstream stream(configText);
+		const std::vector<DemoConfigEntry> entries = DemoConfig::Parse(stream);
+		DoNotOptimize(entries.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * uint64_t(state.GetArg()));
+}
+ASTRO_BENCHMARK(DemoConfig_Parse, { 9, 256 });
+
+//---------------------------------------------------------------------------------------
+// Hashing & caches
+//---------------------------------------------------------------------------------------
+
+static void Utility_HashRange(State& state)
+{
+	const std::vector<uint32_t> words(size_t(state.GetArg()) / sizeof(uint32_t), 0x9E3779B9u);
+	while (state.KeepRunning())
+	{
+		const size_t hash = Utility::HashRange(words.data(), words.data() + words.size(), 2166136261U);
+		DoNotOptimize(hash);
+	}
+	state.SetBytesProcessed(state.GetIterationCount() * uint64_t(state.GetArg()));
+}
+ASTRO_BENCHMARK(Utility_HashRange, { 64, 1024, 65536 });
+
+// PipelineStateObjectLibrary::GetPSO: hash the desc, then find it in the cache. The D3D12 desc types don't exist
+// outside Windows, so a stand-in of the same size is hashed instead, against a map of Arg cached PSOs.
+static void PSOLibrary_Lookup(State& state)
+{
+	std::vector<PSODescStandIn> descs(size_t(state.GetArg()));
+	std::map<size_t, uint32_t> cachedPSOs;
+	for (size_t descIdx = 0; descIdx < descs.size(); ++descIdx)
+	{
+		std::fill(std::begin(descs[descIdx].Words), std::end(descs[descIdx].Words), uint32_t(descIdx));
+		cachedPSOs.emplace(HashPSODescStandIn(descs[descIdx]), uint32_t(descIdx));
+	}
+
+	size_t descIdx = 0;
+	while (state.KeepRunning())
+	{
+		const auto psoIt = cachedPSOs.find(HashPSODescStandIn(descs[descIdx]));
+		DoNotOptimize(psoIt->second);
+		descIdx = (descIdx + 1) % descs.size();
+	}
+	state.SetItemsProcessed(state.GetIterationCount());
+}
+ASTRO_BENCHMARK(PSOLibrary_Lookup, { 16, 256 });
+
+static void ShaderLibrary_BuildShaderKey(State& state)
+{
+	const std::wstring path = L"C:\\Projects\\AstroDX12\\AstroDX12\\Shaders\\FluidSim\\Project.hlsl";
+	std::vector<std::wstring> defines;
+	for (int64_t defineIdx = 0; defineIdx < state.GetArg(); ++defineIdx)
+	{
+		defines.push_back(L"SOME_PERMUTATION_DEFINE_" + std::to_wstring(defineIdx) + L"=1");
+	}
+
+	while (state.KeepRunning())
+	{
+		const std::wstring key = AstroTools::Rendering::BuildShaderKey(path, L"CSMain", defines, L"cs_6_6");
+		DoNotOptimize(key.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount());
+}
+ASTRO_BENCHMARK(ShaderLibrary_BuildShaderKey, { 0, 4 });
+
+//---------------------------------------------------------------------------------------
+// GPU memory
+//---------------------------------------------------------------------------------------
+
+// PlacedResourceAllocator's bookkeeping in 256MiB pages: Arg live allocations, each iteration frees a random one & allocates a replacement.
+// Sizes are log-uniform between 1KiB and 4MiB (small constant & structured buffers up to render targets), 1 in 8 asks for the MSAA alignment.
+// The fragmentation counters are the steady state's, after the churn.
+static void GPUMemorySubAllocator_AllocateFree(State& state)
+{
+	constexpr uint64_t PageSize = 256 * 1024 * 1024;
+	uint32_t randomState = 0x12345678u;
+	const auto nextRandom = [&randomState]()
+	{
+		randomState = randomState * 1664525u + 1013904223u;
+		return randomState >> 8;
+	};
+	const auto allocateRandom = [&](GPUMemorySubAllocator& allocator)
+	{
+		const uint64_t byteSize = uint64_t(1024) << (nextRandom() % 13);
+		const uint64_t alignment = nextRandom() % 8 == 0 ? GPUMemorySubAllocator::MSAAAlignment : GPUMemorySubAllocator::DefaultAlignment;
+		return allocator.Allocate(byteSize - nextRandom() % (byteSize / 2), alignment);
+	};
+
+	GPUMemorySubAllocator allocator(PageSize);
+	std::vector<GPUMemoryHandle> handles(size_t(state.GetArg()));
+	for (GPUMemoryHandle& handle : handles)
+	{
+		handle = allocateRandom(allocator);
+	}
+
+	while (state.KeepRunning())
+	{
+		GPUMemoryHandle& handle = handles[nextRandom() % handles.size()];
+		allocator.Free(handle);
+		handle = allocateRandom(allocator);
+		DoNotOptimize(handle);
+	}
+	state.SetItemsProcessed(state.GetIterationCount());
+
+	const GPUMemoryReport report = allocator.GetReport();
+	state.SetCounter("Pages", report.PageCount);
+	state.SetCounter("InternalFrag", report.InternalFragmentation());
+	state.SetCounter("ExternalFrag", report.ExternalFragmentation());
+}
+ASTRO_BENCHMARK(GPUMemorySubAllocator_AllocateFree, { 64, 1024 });
+
+//---------------------------------------------------------------------------------------
+// Mesh generation
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	struct Float3StandIn
+	{
+		float x, y, z;
+	};
+
+	// Same layout as VertexData_Position_Normal_UV_POD, DirectXMath types don't exist outside Windows
+	struct PositionNormalUVStandIn
+	{
+		float Position[3];
+		float Normal[3];
+		float UV[2];
+	};
+
+	// Owns its POD through a shared_ptr the same way the VertexData_ types do
+	class VertexDataStandIn : public IVertexData
+	{
+	public:
+		explicit VertexDataStandIn(const PositionNormalUVStandIn& pod)
+			: POD{ std::make_shared<PositionNormalUVStandIn>(pod) }
+		{
+		}
+
+		virtual std::shared_ptr<void> GetData() override
+		{
+			return POD;
+		}
+
+	private:
+		std::shared_ptr<PositionNormalUVStandIn> POD;
+	};
+}
+
+// GeometryHelper::GenerateDelaunaySphere, Arg subdivisions (the common sphere mesh uses 4)
+static void GeometryHelper_GenerateSphere(State& state)
+{
+	size_t vertexCount = 0;
+	while (state.KeepRunning())
+	{
+		const Geometry<Float3StandIn> sphere = Icosphere::Generate<Float3StandIn>(int(state.GetArg()));
+		vertexCount = sphere.vertices.size();
+		DoNotOptimize(sphere.indices.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * vertexCount);
+}
+ASTRO_BENCHMARK(GeometryHelper_GenerateSphere, { 2, 4, 6 });
+
+// VertexDataFactory::Convert of Arg vertices
+static void VertexDataFactory_Convert(State& state)
+{
+	std::vector<VertexDataStandIn> vertices;
+	vertices.reserve(size_t(state.GetArg()));
+	for (int64_t vertexIdx = 0; vertexIdx < state.GetArg(); ++vertexIdx)
+	{
+		const float value = float(vertexIdx);
+		vertices.emplace_back(PositionNormalUVStandIn{ { value, value, value }, { 0.f, 1.f, 0.f }, { value, value } });
+	}
+
+	while (state.KeepRunning())
+	{
+		const std::vector<PositionNormalUVStandIn> converted = VertexDataConversion::ToPOD<PositionNormalUVStandIn>(vertices);
+		DoNotOptimize(converted.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * uint64_t(state.GetArg()));
+}
+ASTRO_BENCHMARK(VertexDataFactory_Convert, { 1024, 65536 });
+
+//---------------------------------------------------------------------------------------
+// Sim & replay infrastructure
+//---------------------------------------------------------------------------------------
+
+static void FixedStepScheduler_Advance(State& state)
+{
+	FixedStepScheduler scheduler(60.f, 4);
+	float frameTime = 1.f / 144.f;
+	while (state.KeepRunning())
+	{
+		const SimStepData stepData = scheduler.Advance(frameTime);
+		DoNotOptimize(stepData);
+		frameTime = frameTime < 0.02f ? frameTime * 1.01f : 1.f / 144.f;
+	}
+	state.SetItemsProcessed(state.GetIterationCount());
+}
+ASTRO_BENCHMARK(FixedStepScheduler_Advance);
+
+// A FluidSim2D sized snapshot: 256x256 velocity & density grids
+static SimStateSnapshot MakeFluidSnapshot()
+{
+	SimStateSnapshot snapshot;
+	snapshot.SimName = "FluidSim2D";
+	snapshot.LayoutVersion = 1;
+	snapshot.Chunks.push_back({ "Velocity", 8, 256, 256, std::vector<uint8_t>(256 * 256 * 8, 1) });
+	snapshot.Chunks.push_back({ "Density", 16, 256, 256, std::vector<uint8_t>(256 * 256 * 16, 2) });
+	return snapshot;
+}
+
+static void SimStateSerialization_Serialize(State& state)
+{
+	const SimStateSnapshot snapshot = MakeFluidSnapshot();
+	size_t byteSize = 0;
+	while (state.KeepRunning())
+	{
+		const std::vector<uint8_t> bytes = SimStateSerialization::Serialize(snapshot);
+		byteSize = bytes.size();
+		DoNotOptimize(bytes.data());
+	}
+	state.SetBytesProcessed(state.GetIterationCount() * byteSize);
+}
+ASTRO_BENCHMARK(SimStateSerialization_Serialize);
+
+static void SimStateSerialization_Deserialize(State& state)
+{
+	const std::vector<uint8_t> bytes = SimStateSerialization::Serialize(MakeFluidSnapshot());
+	while (state.KeepRunning())
+	{
+		SimStateSnapshot snapshot;
+		const SimStateReadResult result = SimStateSerialization::Deserialize(bytes.data(), bytes.size(), snapshot);
+		DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.GetIterationCount() * bytes.size());
+}
+ASTRO_BENCHMARK(SimStateSerialization_Deserialize);
+
+// A minute of recorded frames at 60 fps, with a mouse move every other frame
+static void InputRecording_Deserialize(State& state)
+{
+	InputRecorder recorder;
+	for (int32_t frameIdx = 0; frameIdx < 3600; ++frameIdx)
+	{
+		if (frameIdx % 2 == 0)
+		{
+			recorder.RecordEvent({ RecordedInputType::MouseMove, 1, frameIdx, -frameIdx });
+		}
+		recorder.RecordFrame(float(frameIdx) / 60.f, 1.f / 60.f, {});
+	}
+	const std::vector<uint8_t> bytes = InputRecordingSerialization::Serialize(recorder.GetRecording());
+
+	while (state.KeepRunning())
+	{
+		InputRecording recording;
+		const InputRecordingReadResult result = InputRecordingSerialization::Deserialize(bytes.data(), bytes.size(), recording);
+		DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.GetIterationCount() * bytes.size());
+}
+ASTRO_BENCHMARK(InputRecording_Deserialize);
+
+//---------------------------------------------------------------------------------------
+// SDF raymarching
+//---------------------------------------------------------------------------------------
+
+// Arg is the object count. CellObjectCount is the mean of the non empty cells', what a ray evaluates per step instead of every object,
+// MaxCellObjectCount the largest. PoolUse is the cell lists' share of their pool, DroppedObjects the objects which didn't fit in it.
+static void SDFRaymarch_Bin(State& state)
+{
+	const SDFRaymarch::Camera camera = MakeRaymarchCamera();
+	const std::vector<SDFRaymarch::Object> objects = MakeRaymarchObjects(uint32_t(state.GetArg()));
+	SDFRaymarch::TileBins bins(camera);
+	while (state.KeepRunning())
+	{
+		bins.Bin(objects.data(), uint32_t(objects.size()));
+		DoNotOptimize(bins);
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * objects.size());
+
+	uint32_t nonEmptyCellCount = 0;
+	uint32_t maxCellObjectCount = 0;
+	for (uint32_t cellIdx = 0; cellIdx < camera.GetCellCount(); ++cellIdx)
+	{
+		nonEmptyCellCount += bins.GetCellObjectCount(cellIdx) > 0 ? 1 : 0;
+		maxCellObjectCount = std::max(maxCellObjectCount, bins.GetCellObjectCount(cellIdx));
+	}
+	state.SetCounter("CellObjectCount", nonEmptyCellCount > 0 ? double(bins.GetListedObjectCount()) / nonEmptyCellCount : 0.);
+	state.SetCounter("MaxCellObjectCount", maxCellObjectCount);
+	state.SetCounter("PoolUse", double(bins.GetListedObjectCount()) / double(bins.GetCellListCapacity()));
+	state.SetCounter("DroppedObjects", bins.GetDroppedObjectCount());
+}
+ASTRO_BENCHMARK(SDFRaymarch_Bin, { 20, 256, 1024 });
+
+// Rays of one pixel out of RaymarchPixelStride^2. Arg is the object count.
+// The binned march's ObjectEvaluations per ray follow the objects around the ray, the full march's the scene's object count.
+constexpr uint32_t RaymarchPixelStride = 16;
+
+static void RunRaymarchBenchmark(State& state, bool binned)
+{
+	const SDFRaymarch::Camera camera = MakeRaymarchCamera();
+	const std::vector<SDFRaymarch::Object> objects = MakeRaymarchObjects(uint32_t(state.GetArg()));
+	const uint32_t objectCount = uint32_t(objects.size());
+	SDFRaymarch::TileBins bins(camera);
+	bins.Bin(objects.data(), objectCount);
+
+	uint64_t rayCount = 0;
+	uint64_t stepCount = 0;
+	uint64_t evaluationCount = 0;
+	while (state.KeepRunning())
+	{
+		for (uint32_t y = 0; y < camera.Height; y += RaymarchPixelStride)
+		{
+			for (uint32_t x = 0; x < camera.Width; x += RaymarchPixelStride)
+			{
+				const SDFRaymarch::MarchResult result = binned
+					? SDFRaymarch::MarchBinned(bins, objects.data(), x, y)
+					: SDFRaymarch::March(camera, objects.data(), objectCount, x, y);
+				DoNotOptimize(result);
+				++rayCount;
+				stepCount += result.StepCount;
+				evaluationCount += result.ObjectEvaluationCount;
+			}
+		}
+	}
+	state.SetItemsProcessed(rayCount);
+	state.SetCounter("StepsPerRay", double(stepCount) / double(rayCount));
+	state.SetCounter("ObjectEvaluationsPerRay", double(evaluationCount) / double(rayCount));
+}
+
+static void SDFRaymarch_March(State& state)
+{
+	RunRaymarchBenchmark(state, false);
+}
+ASTRO_BENCHMARK(SDFRaymarch_March, { 20, 256 });
+
+static void SDFRaymarch_MarchBinned(State& state)
+{
+	RunRaymarchBenchmark(state, true);
+}
+ASTRO_BENCHMARK(SDFRaymarch_MarchBinned, { 20, 256, 1024 });
+
+// Every pixel of one cone block out of RaymarchBlockStride^2, binned marches. Arg is the object count.
+// StepsPerPixel & MaxStepsPerPixel are the pixels' marches, the cone prepass' steps are amortised over its block in ConeStepsPerPixel.
+// ObjectEvaluationsPerPixel includes the cones'. Against the march without prepass: RecoveredHits are rays it hits which ran out of
+// steps without it, HitDepthDifference the mean depth difference of the rays hitting in both. It loses no hit, see RenderingCoreTests'
+// SDFRaymarch_ConePrepassLosesNoHit.
+constexpr uint32_t RaymarchBlockStride = 4;
+
+static void RunConePrepassBenchmark(State& state, bool conePrepass)
+{
+	const SDFRaymarch::Camera camera = MakeRaymarchCamera();
+	const std::vector<SDFRaymarch::Object> objects = MakeRaymarchObjects(uint32_t(state.GetArg()));
+	const uint32_t objectCount = uint32_t(objects.size());
+	SDFRaymarch::TileBins bins(camera);
+	bins.Bin(objects.data(), objectCount);
+
+	const uint32_t blockCountX = camera.Width / SDFRaymarch::ConeBlockSize;
+	const uint32_t blockCountY = camera.Height / SDFRaymarch::ConeBlockSize;
+	const auto forEachBlockPixel = [&](uint32_t blockX, uint32_t blockY, auto&& visit)
+	{
+		for (uint32_t y = blockY * SDFRaymarch::ConeBlockSize; y < (blockY + 1) * SDFRaymarch::ConeBlockSize; ++y)
+		{
+			for (uint32_t x = blockX * SDFRaymarch::ConeBlockSize; x < (blockX + 1) * SDFRaymarch::ConeBlockSize; ++x)
+			{
+				visit(x, y);
+			}
+		}
+	};
+
+	uint64_t pixelCount = 0;
+	uint64_t stepCount = 0;
+	uint64_t coneStepCount = 0;
+	uint64_t evaluationCount = 0;
+	uint32_t maxStepCount = 0;
+	while (state.KeepRunning())
+	{
+		for (uint32_t blockY = 0; blockY < blockCountY; blockY += RaymarchBlockStride)
+		{
+			for (uint32_t blockX = 0; blockX < blockCountX; blockX += RaymarchBlockStride)
+			{
+				SDFRaymarch::ConeResult cone;
+				if (conePrepass)
+				{
+					cone = SDFRaymarch::ConeMarch(bins, objects.data(), blockX, blockY);
+					coneStepCount += cone.StepCount;
+					evaluationCount += cone.ObjectEvaluationCount;
+				}
+				forEachBlockPixel(blockX, blockY, [&](uint32_t x, uint32_t y)
+					{
+						const SDFRaymarch::MarchResult result = SDFRaymarch::MarchBinned(bins, objects.data(), x, y, cone.StartDistance);
+						DoNotOptimize(result);
+						++pixelCount;
+						stepCount += result.StepCount;
+						evaluationCount += result.ObjectEvaluationCount;
+						maxStepCount = std::max(maxStepCount, result.StepCount);
+					});
+			}
+		}
+	}
+	state.SetItemsProcessed(pixelCount);
+	state.SetCounter("StepsPerPixel", double(stepCount) / double(pixelCount));
+	state.SetCounter("MaxStepsPerPixel", maxStepCount);
+	state.SetCounter("ObjectEvaluationsPerPixel", double(evaluationCount) / double(pixelCount));
+	if (!conePrepass)
+	{
+		return;
+	}
+	state.SetCounter("ConeStepsPerPixel", double(coneStepCount) / double(pixelCount));
+
+	uint32_t recoveredHitCount = 0;
+	uint32_t hitCount = 0;
+	double hitDepthDifference = 0.;
+	for (uint32_t blockY = 0; blockY < blockCountY; blockY += RaymarchBlockStride)
+	{
+		for (uint32_t blockX = 0; blockX < blockCountX; blockX += RaymarchBlockStride)
+		{
+			const SDFRaymarch::ConeResult cone = SDFRaymarch::ConeMarch(bins, objects.data(), blockX, blockY);
+			forEachBlockPixel(blockX, blockY, [&](uint32_t x, uint32_t y)
+				{
+					const SDFRaymarch::MarchResult seededResult = SDFRaymarch::MarchBinned(bins, objects.data(), x, y, cone.StartDistance);
+					const SDFRaymarch::MarchResult result = SDFRaymarch::MarchBinned(bins, objects.data(), x, y);
+					if (seededResult.Hit && !result.Hit)
+					{
+						++recoveredHitCount;
+					}
+					else if (result.Hit)
+					{
+						++hitCount;
+						hitDepthDifference += std::abs(seededResult.Distance - result.Distance);
+					}
+				});
+		}
+	}
+	state.SetCounter("RecoveredHits", recoveredHitCount);
+	state.SetCounter("HitDepthDifference", hitCount > 0 ? hitDepthDifference / hitCount : 0.);
+}
+
+static void SDFRaymarch_MarchBlocks(State& state)
+{
+	RunConePrepassBenchmark(state, false);
+}
+ASTRO_BENCHMARK(SDFRaymarch_MarchBlocks, { 20, 256, 1024 });
+
+static void SDFRaymarch_MarchBlocksConePrepass(State& state)
+{
+	RunConePrepassBenchmark(state, true);
+}
+ASTRO_BENCHMARK(SDFRaymarch_MarchBlocksConePrepass, { 20, 256, 1024 });
+
+// The last of frameCount frames against a full resolution march, see RenderingFixtures::MeasureReconstructionError
+static void MeasureReconstructionError(SDFRaymarch::Resolution resolution, bool stepParticles, double& outHitMismatchRatio, double& outColorError)
+{
+	constexpr uint32_t FrameCount = 16;
+	const SDFRaymarch::Camera camera = MakeReconstructionCamera();
+	RaymarchReconstructionScene scene;
+	SDFRaymarch::Reconstructor reconstructor(camera, resolution);
+	for (uint32_t frameIdx = 0; frameIdx < FrameCount; ++frameIdx)
+	{
+		scene.NextFrame(stepParticles, true);
+		reconstructor.RenderFrame(scene.Objects.data(), uint32_t(scene.Objects.size()), scene.EyePos);
+	}
+	MeasureReconstructionError(reconstructor, camera, scene, outHitMismatchRatio, outColorError);
+}
+
+// A frame per iteration, the particles stepping. Arg is the SDFRaymarch::Resolution.
+// MarchedRaysPerPixel is the march's cost, ReprojectedRatio the share of pixels kept from the previous frame.
+// HitMismatchRatio & ColorError are MeasureReconstructionError's, Static* the same with the particles frozen: only the camera moves,
+// which is all the reprojection follows. Moving objects' history is only rejected outside the depth range around them.
+// Their bounds are checked by RenderingCoreTests' SDFRaymarch_ReducedResolutionStaysCloseToTheMarch.
+static void SDFRaymarch_Reconstruct(State& state)
+{
+	const SDFRaymarch::Camera camera = MakeReconstructionCamera();
+	const SDFRaymarch::Resolution resolution = SDFRaymarch::Resolution(state.GetArg());
+	RaymarchReconstructionScene scene;
+	SDFRaymarch::Reconstructor reconstructor(camera, resolution);
+	uint64_t pixelCount = 0;
+	uint64_t reprojectedCount = 0;
+	while (state.KeepRunning())
+	{
+		scene.NextFrame(true, true);
+		reconstructor.RenderFrame(scene.Objects.data(), uint32_t(scene.Objects.size()), scene.EyePos);
+		DoNotOptimize(reconstructor);
+		pixelCount += uint64_t(camera.Width) * camera.Height;
+		reprojectedCount += reconstructor.GetReprojectedPixelCount();
+	}
+	state.SetItemsProcessed(pixelCount);
+	state.SetCounter("MarchedRaysPerPixel", double(reconstructor.GetMarchedRayCount()) / (double(camera.Width) * camera.Height));
+	state.SetCounter("ReprojectedRatio", double(reprojectedCount) / double(pixelCount));
+
+	double hitMismatchRatio = 0.;
+	double colorError = 0.;
+	MeasureReconstructionError(resolution, true, hitMismatchRatio, colorError);
+	state.SetCounter("HitMismatchRatio", hitMismatchRatio);
+	state.SetCounter("ColorError", colorError);
+	MeasureReconstructionError(resolution, false, hitMismatchRatio, colorError);
+	state.SetCounter("StaticHitMismatchRatio", hitMismatchRatio);
+	state.SetCounter("StaticColorError", colorError);
+}
+ASTRO_BENCHMARK(SDFRaymarch_Reconstruct, { 0, 1, 2 });
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Minimal microbenchmark harness, in the spirit of Google Benchmark without the dependency:
+// benchmarks register themselves, run enough iterations to reach a minimum duration, and report time, throughput & heap allocations per iteration.
+// Heap allocations are counted by the global operator new replacement in BenchmarkMain.cpp.
+namespace MicroBenchmark
+{
+	struct AllocationCounters
+	{
+		std::atomic<uint64_t> Count{ 0 };
+		std::atomic<uint64_t> ByteSize{ 0 };
+	};
+
+	inline AllocationCounters& GetAllocationCounters()
+	{
+		static AllocationCounters counters;
+		return counters;
+	}
+
+	// Keeps the compiler from optimising away a value a benchmark computes
+	template<typename T>
+	inline void DoNotOptimize(const T& value)
+	{
+#if defined(_MSC_VER)
+		const volatile char* volatile sink = reinterpret_cast<const volatile char*>(&value);
+		(void)sink;
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+
+	class State
+	{
+	public:
+		State(uint64_t iterationCount, int64_t arg)
+			: m_iterationCount(iterationCount)
+			, m_arg(arg)
+		{
+		}
+
+		// while (state.KeepRunning()) { ... } runs the timed loop
+		bool KeepRunning()
+		{
+			if (m_iterationIdx == 0)
+			{
+				Start();
+			}
+			if (m_iterationIdx++ < m_iterationCount)
+			{
+				return true;
+			}
+			Stop();
+			return false;
+		}
+
+		// Excludes per iteration setup from the timing & allocation counts
+		void PauseTiming()
+		{
+			m_elapsed += std::chrono::steady_clock::now() - m_startTime;
+			m_allocationCount += GetAllocationCounters().Count - m_startAllocationCount;
+			m_allocatedByteSize += GetAllocationCounters().ByteSize - m_startAllocatedByteSize;
+		}
+
+		void ResumeTiming()
+		{
+			Start();
+		}
+
+		int64_t GetArg() const { return m_arg; }
+		uint64_t GetIterationCount() const { return m_iterationCount; }
+
+		void SetItemsProcessed(uint64_t itemCount) { m_itemsProcessed = itemCount; }
+		void SetBytesProcessed(uint64_t byteSize) { m_bytesProcessed = byteSize; }
+		// Extra named result printed after the timings, eg: the error a solver reached. Set after the timed loop.
+		void SetCounter(std::string_view name, double value) { m_counters.push_back({ std::string(name), value }); }
+
+		double GetElapsedSeconds() const { return std::chrono::duration<double>(m_elapsed).count(); }
+		uint64_t GetItemsProcessed() const { return m_itemsProcessed; }
+		uint64_t GetBytesProcessed() const { return m_bytesProcessed; }
+		uint64_t GetAllocationCount() const { return m_allocationCount; }
+		uint64_t GetAllocatedByteSize() const { return m_allocatedByteSize; }
+		const std::vector<std::pair<std::string, double>>& GetCounters() const { return m_counters; }
+
+	private:
+		void Start()
+		{
+			m_startAllocationCount = GetAllocationCounters().Count;
+			m_startAllocatedByteSize = GetAllocationCounters().ByteSize;
+			m_startTime = std::chrono::steady_clock::now();
+		}
+
+		void Stop()
+		{
+			PauseTiming();
+		}
+
+		uint64_t m_iterationCount;
+		uint64_t m_iterationIdx = 0;
+		int64_t m_arg;
+
+		std::chrono::steady_clock::time_point m_startTime;
+		std::chrono::steady_clock::duration m_elapsed{ 0 };
+		uint64_t m_startAllocationCount = 0;
+		uint64_t m_startAllocatedByteSize = 0;
+		uint64_t m_allocationCount = 0;
+		uint64_t m_allocatedByteSize = 0;
+		uint64_t m_itemsProcessed = 0;
+		uint64_t m_bytesProcessed = 0;
+		std::vector<std::pair<std::string, double>> m_counters;
+	};
+
+	using BenchmarkFunction = void(*)(State&);
+
+	struct Benchmark
+	{
+		std::string Name;
+		BenchmarkFunction Function;
+		std::vector<int64_t> Args; // The benchmark runs once per arg, State::GetArg()
+	};
+
+	inline std::vector<Benchmark>& GetRegisteredBenchmarks()
+	{
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+
+	inline bool Register(const char* name, BenchmarkFunction function, std::vector<int64_t> args = { 0 })
+	{
+		GetRegisteredBenchmarks().push_back({ name, function, std::move(args) });
+		return true;
+	}
+
+	struct RunSettings
+	{
+		double MinSeconds = 0.2;
+		std::string_view Filter; // Substring of the benchmark names to run, all of them if empty
+	};
+
+	inline void PrintHeader()
+	{
+		printf("%-44s %14s %12s %14s %12s %14s\n", "Benchmark", "Time/iter", "Iterations", "Throughput", "Allocs/iter", "Alloc B/iter");
+	}
+
+	inline void PrintResult(const std::string& name, const State& state)
+	{
+		const double iterations = double(state.GetIterationCount());
+		const double seconds = state.GetElapsedSeconds();
+
+		char throughput[32] = "-";
+		if (state.GetBytesProcessed() > 0)
+		{
+			snprintf(throughput, sizeof(throughput), "%.1f MB/s", double(state.GetBytesProcessed()) / seconds / (1024.0 * 1024.0));
+		}
+		else if (state.GetItemsProcessed() > 0)
+		{
+			snprintf(throughput, sizeof(throughput), "%.2f M/s", double(state.GetItemsProcessed()) / seconds / 1e6);
+		}
+
+		printf("%-44s %11.1f ns %12llu %14s %12.1f %14.1f",
+			name.c_str(),
+			seconds * 1e9 / iterations,
+			(unsigned long long)state.GetIterationCount(),
+			throughput,
+			double(state.GetAllocationCount()) / iterations,
+			double(state.GetAllocatedByteSize()) / iterations);
+		for (const auto& [counterName, value] : state.GetCounters())
+		{
+			printf("  %s=%g", counterName.c_str(), value);
+		}
+		printf("\n");
+	}
+
+	// Returns the amount of benchmark runs
+	inline int RunAll(const RunSettings& settings)
+	{
+		PrintHeader();
+
+		int runCount = 0;
+		for (const Benchmark& benchmark : GetRegisteredBenchmarks())
+		{
+			if (!settings.Filter.empty() && benchmark.Name.find(settings.Filter) == std::string::npos)
+			{
+				continue;
+			}
+
+			for (int64_t arg : benchmark.Args)
+			{
+				const std::string name = benchmark.Args.size() > 1 ? benchmark.Name + "/" + std::to_string(arg) : benchmark.Name;
+
+				// Grow the iteration count until the run is long enough to be measured reliably
+				uint64_t iterationCount = 1;
+				while (true)
+				{
+					State state(iterationCount, arg);
+					benchmark.Function(state);
+
+					const double seconds = state.GetElapsedSeconds();
+					if (seconds >= settings.MinSeconds || iterationCount >= (uint64_t(1) << 40))
+					{
+						PrintResult(name, state);
+						break;
+					}
+
+					const double scale = seconds > 0.0 ? std::min(settings.MinSeconds * 1.4 / seconds, 10.0) : 10.0;
+					iterationCount = std::max(iterationCount + 1, uint64_t(double(iterationCount) * scale));
+				}
+				++runCount;
+			}
+		}
+		return runCount;
+	}
+}
+
+#define ASTRO_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define ASTRO_BENCHMARK_CONCAT(a, b) ASTRO_BENCHMARK_CONCAT_IMPL(a, b)
+
+// ASTRO_BENCHMARK(Function) or ASTRO_BENCHMARK(Function, { arg0, arg1, ... })
+#define ASTRO_BENCHMARK(function, ...) \
+	static const bool ASTRO_BENCHMARK_CONCAT(s_registered_, function) = MicroBenchmark::Register(#function, function __VA_OPT__(,) __VA_ARGS__)
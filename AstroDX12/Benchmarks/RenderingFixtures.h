@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Rendering/Common/SDFRaymarch.h>
+#include <Simulation/ParticleSystem.h>
+
+// Scenes shared by the rendering benchmarks & the tests checking the same code against its reference
+namespace RenderingFixtures
+{
+	// The demo's camera & gbuffer, backed off to see the whole fountain
+	inline SDFRaymarch::Camera MakeRaymarchCamera()
+	{
+		SDFRaymarch::Camera camera;
+		camera.Width = 1280;
+		camera.Height = 720;
+		camera.ProjScaleY = 1.f / std::tan(0.125f * 3.14159265f);
+		camera.ProjScaleX = camera.ProjScaleY * float(camera.Height) / float(camera.Width);
+		return camera;
+	}
+
+	// The first objectCount alive particles of the steady state fountain, as the raymarch pass picks them, in view space
+	inline std::vector<SDFRaymarch::Object> MakeRaymarchObjects(uint32_t objectCount)
+	{
+		constexpr float StepDeltaTime = 1.f / 60.f;
+		constexpr float EyePos[3] = { 0.f, 20.f, -100.f };
+		Particles::CPUParticleSystem particleSystem(64 * 1024);
+		Particles::EmissionBudget emission;
+		for (uint32_t stepIndex = 0; stepIndex < 300; ++stepIndex)
+		{
+			particleSystem.Step(StepDeltaTime, emission.Next(12000.f, StepDeltaTime), stepIndex);
+		}
+
+		std::vector<SDFRaymarch::Object> objects(std::min(objectCount, particleSystem.GetAliveCount()));
+		for (size_t objectIdx = 0; objectIdx < objects.size(); ++objectIdx)
+		{
+			const Particles::Particle& particle = particleSystem.GetParticles()[particleSystem.GetAliveList()[objectIdx]];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				objects[objectIdx].Pos[axis] = particle.Pos[axis] - EyePos[axis];
+			}
+			objects[objectIdx].Size = particle.Size;
+		}
+		return objects;
+	}
+
+	// The fountain's first 64 objects in world space, a frame at a time with the camera strafing
+	class RaymarchReconstructionScene
+	{
+	public:
+		RaymarchReconstructionScene()
+			: m_particleSystem(64 * 1024)
+		{
+			for (; m_stepIndex < 300; ++m_stepIndex)
+			{
+				m_particleSystem.Step(StepDeltaTime, m_emission.Next(12000.f, StepDeltaTime), m_stepIndex);
+			}
+		}
+
+		// Frozen particles & camera: the same frame again
+		void NextFrame(bool stepParticles, bool moveCamera)
+		{
+			if (stepParticles)
+			{
+				m_particleSystem.Step(StepDeltaTime, m_emission.Next(12000.f, StepDeltaTime), m_stepIndex);
+			}
+			if (moveCamera)
+			{
+				EyePos[0] = 10.f * std::sin(float(m_stepIndex) * 0.02f);
+			}
+			++m_stepIndex;
+
+			Objects.resize(std::min(ObjectCount, m_particleSystem.GetAliveCount()));
+			for (size_t objectIdx = 0; objectIdx < Objects.size(); ++objectIdx)
+			{
+				const Particles::Particle& particle = m_particleSystem.GetParticles()[m_particleSystem.GetAliveList()[objectIdx]];
+				std::copy(particle.Pos, particle.Pos + 3, Objects[objectIdx].Pos);
+				Objects[objectIdx].Size = particle.Size;
+			}
+		}
+
+		std::vector<SDFRaymarch::Object> Objects;
+		float EyePos[3] = { 0.f, 20.f, -100.f };
+
+	private:
+		static constexpr float StepDeltaTime = 1.f / 60.f;
+		static constexpr uint32_t ObjectCount = 64;
+
+		Particles::CPUParticleSystem m_particleSystem;
+		Particles::EmissionBudget m_emission;
+		uint32_t m_stepIndex = 0;
+	};
+
+	// A quarter of the gbuffer, the CPU march is slow
+	inline SDFRaymarch::Camera MakeReconstructionCamera()
+	{
+		SDFRaymarch::Camera camera = MakeRaymarchCamera();
+		camera.Width = 320;
+		camera.Height = 180;
+		return camera;
+	}
+
+	// The reconstructor's last frame against a full resolution march of the scene's: the share of pixels hitting in one but
+	// not the other & the mean absolute difference of the color channels
+	inline void MeasureReconstructionError(const SDFRaymarch::Reconstructor& reconstructor, const SDFRaymarch::Camera& camera, const RaymarchReconstructionScene& scene,
+		double& outHitMismatchRatio, double& outColorError)
+	{
+		SDFRaymarch::Reconstructor reference(camera, SDFRaymarch::Resolution::Full);
+		reference.RenderFrame(scene.Objects.data(), uint32_t(scene.Objects.size()), scene.EyePos);
+		const float worldSize = camera.FarZ - camera.NearZ;
+		const size_t pixelCount = reference.GetDistances().size();
+		uint32_t hitMismatchCount = 0;
+		double colorError = 0.;
+		for (size_t pixelIdx = 0; pixelIdx < pixelCount; ++pixelIdx)
+		{
+			if ((reconstructor.GetDistances()[pixelIdx] < worldSize) != (reference.GetDistances()[pixelIdx] < worldSize))
+			{
+				++hitMismatchCount;
+			}
+			for (uint32_t channel = 0; channel < 3; ++channel)
+			{
+				colorError += std::abs(reconstructor.GetColors()[pixelIdx * 4 + channel] - reference.GetColors()[pixelIdx * 4 + channel]);
+			}
+		}
+		outHitMismatchRatio = double(hitMismatchCount) / double(pixelCount);
+		outColorError = colorError / (3. * double(pixelCount));
+	}
+}
@@ -0,0 +1,493 @@
+#include "MicroBenchmark.h"
+#include "SimulationFixtures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Simulation/ChainPBDSolver.h>
+#include <Simulation/ChainVBDSolver.h>
+#include <Simulation/ColliderSet.h>
+#include <Simulation/MultigridPoisson.h>
+#include <Simulation/ParallelPrimitives.h>
+#include <Simulation/ParticleSystem.h>
+#include <Simulation/PicFlipBricks.h>
+#include <Simulation/PicFlipPressure.h>
+#include <Simulation/PicFlipTransfer.h>
+
+using namespace MicroBenchmark;
+using namespace SimulationFixtures;
+
+//---------------------------------------------------------------------------------------
+// Chains: PBD & VBD
+//---------------------------------------------------------------------------------------
+
+// One 60Hz step of 10k chains of 15 elements, Arg workers (0: all hardware threads)
+static void ChainPBD_Step10kChains(State& state)
+{
+	std::vector<ChainPBD::ChainDesc> chains;
+	std::vector<ChainPBD::Element> elements;
+	MakeChains(10000, 15, chains, elements);
+
+	ChainPBD::CPUSolver solver(chains, elements);
+	const ChainPBD::SolverSettings settings;
+	const std::vector<ChainPBD::CollisionSphere> collisionSpheres = ChainPBD::MakeDefaultCollisionSpheres();
+	while (state.KeepRunning())
+	{
+		solver.Step(1.f / 60.f, settings, collisionSpheres, uint32_t(state.GetArg()));
+	}
+
+	solver.ReadElements(elements);
+	DoNotOptimize(elements.data());
+	state.SetItemsProcessed(state.GetIterationCount() * chains.size());
+}
+ASTRO_BENCHMARK(ChainPBD_Step10kChains, { 1, 0 });
+
+// Convergence per iteration: Arg iterations per step, for the VBD chain & the PBD chain in the same setup.
+// MaxStretch is the worst relative link stretch reached over the measured steps. VBD's links are springs: converged, they still
+// stretch by ~0.0177 under the chain's weight (Stiffness 1e6), which 16 iterations & up reach.
+static void ChainVBD_Convergence(State& state)
+{
+	const std::vector<ChainPBD::CollisionSphere> collisionSpheres = ChainPBD::MakeDefaultCollisionSpheres();
+	ChainVBD::SolverSettings settings;
+	settings.IterationCount = uint32_t(state.GetArg());
+
+	std::vector<ChainVBD::Element> elements = MakeVBDChain();
+	const uint32_t colorCount = ChainVBD::ColorConstraintGraph(elements);
+	while (state.KeepRunning())
+	{
+		ChainVBD::Step(elements, colorCount, 1.f / 60.f, settings, collisionSpheres);
+	}
+	DoNotOptimize(elements.data());
+	state.SetItemsProcessed(state.GetIterationCount() * settings.IterationCount);
+
+	elements = MakeVBDChain();
+	ChainVBD::ColorConstraintGraph(elements);
+	float maxStretch = 0.f;
+	for (uint32_t stepIdx = 0; stepIdx < ConvergenceSettleStepCount + ConvergenceMeasureStepCount; ++stepIdx)
+	{
+		ChainVBD::Step(elements, colorCount, 1.f / 60.f, settings, collisionSpheres);
+		if (stepIdx >= ConvergenceSettleStepCount)
+		{
+			maxStretch = std::max(maxStretch, GetMaxLinkStretch(elements));
+		}
+	}
+	state.SetCounter("MaxStretch", maxStretch);
+}
+ASTRO_BENCHMARK(ChainVBD_Convergence, { 1, 2, 4, 8, 16, 30, 64 });
+
+// Same measurement for the PBD chain solver, Arg being PBD iterations or XPBD substeps.
+// ConstraintEvals is the cost side: link constraint evaluations per step.
+static void MeasureChainPBDConvergence(State& state, const ChainPBD::SolverSettings& settings)
+{
+	const std::vector<ChainPBD::CollisionSphere> collisionSpheres = ChainPBD::MakeDefaultCollisionSpheres();
+	const uint32_t constraintIterationCount = settings.Mode == ChainPBD::SolverMode::XPBDSmallSteps ? settings.SubstepCount : settings.IterationCount;
+
+	std::vector<ChainPBD::ChainDesc> chains;
+	std::vector<ChainPBD::Element> elements;
+	MakeChains(1, 15, chains, elements);
+	{
+		ChainPBD::CPUSolver solver(chains, elements);
+		while (state.KeepRunning())
+		{
+			solver.Step(1.f / 60.f, settings, collisionSpheres, 1);
+		}
+		solver.ReadElements(elements);
+		DoNotOptimize(elements.data());
+		state.SetItemsProcessed(state.GetIterationCount() * constraintIterationCount);
+	}
+
+	MakeChains(1, 15, chains, elements);
+	ChainPBD::CPUSolver solver(chains, elements);
+	float maxStretch = 0.f;
+	for (uint32_t stepIdx = 0; stepIdx < ConvergenceSettleStepCount + ConvergenceMeasureStepCount; ++stepIdx)
+	{
+		solver.Step(1.f / 60.f, settings, collisionSpheres, 1);
+		if (stepIdx >= ConvergenceSettleStepCount)
+		{
+			solver.ReadElements(elements);
+			maxStretch = std::max(maxStretch, GetMaxLinkStretch(elements));
+		}
+	}
+	state.SetCounter("ConstraintEvals", double(constraintIterationCount * (elements.size() - 1)));
+	state.SetCounter("MaxStretch", maxStretch);
+}
+
+static void ChainPBD_Convergence(State& state)
+{
+	ChainPBD::SolverSettings settings;
+	settings.IterationCount = uint32_t(state.GetArg());
+	MeasureChainPBDConvergence(state, settings);
+}
+ASTRO_BENCHMARK(ChainPBD_Convergence, { 1, 2, 4, 8, 16, 30, 64 });
+
+// Rigid links, small steps: 20-25% less stretch than PBD at equal constraint evaluations, so PBD's 30 iterations take 23 substeps.
+// Not the fraction of the evaluations hoped for, PBD iterations already being small steps with the velocity kept for the whole step.
+static void ChainXPBD_Convergence(State& state)
+{
+	ChainPBD::SolverSettings settings;
+	settings.Mode = ChainPBD::SolverMode::XPBDSmallSteps;
+	settings.SubstepCount = uint32_t(state.GetArg());
+	MeasureChainPBDConvergence(state, settings);
+}
+ASTRO_BENCHMARK(ChainXPBD_Convergence, { 1, 2, 4, 8, 16, 20, 23, 30, 64 });
+
+//---------------------------------------------------------------------------------------
+// Colliders: broadphase
+//---------------------------------------------------------------------------------------
+
+// 4096 nodes against Arg colliders, every collider tested
+static void Colliders_ResolveBruteForce(State& state)
+{
+	float fieldSize = 0.f;
+	const Colliders::ColliderSet colliderSet = MakeColliderField(uint32_t(state.GetArg()), fieldSize);
+	const std::vector<float> nodes = MakeColliderQueryNodes(fieldSize);
+	while (state.KeepRunning())
+	{
+		for (uint32_t nodeIdx = 0; nodeIdx < ColliderQueryNodeCount; ++nodeIdx)
+		{
+			float pos[3] = { nodes[nodeIdx * 3], nodes[nodeIdx * 3 + 1], nodes[nodeIdx * 3 + 2] };
+			Colliders::ResolveCollisionsBruteForce(colliderSet, pos, ColliderQueryNodeRadius);
+			DoNotOptimize(pos);
+		}
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * ColliderQueryNodeCount);
+}
+ASTRO_BENCHMARK(Colliders_ResolveBruteForce, { 16, 128, 1024 });
+
+// Same through the grid: the cost per node stays flat with the collider count. CandidatesPerNode is the colliders tested per node.
+// SimulationTests checks the grid resolves every node to the brute force's position.
+static void Colliders_ResolveGrid(State& state)
+{
+	float fieldSize = 0.f;
+	const Colliders::ColliderSet colliderSet = MakeColliderField(uint32_t(state.GetArg()), fieldSize);
+	const std::vector<float> nodes = MakeColliderQueryNodes(fieldSize);
+	Colliders::ColliderGrid grid;
+	grid.Build(colliderSet.Colliders, ColliderGridCellSize, ColliderQueryNodeRadius);
+	while (state.KeepRunning())
+	{
+		for (uint32_t nodeIdx = 0; nodeIdx < ColliderQueryNodeCount; ++nodeIdx)
+		{
+			float pos[3] = { nodes[nodeIdx * 3], nodes[nodeIdx * 3 + 1], nodes[nodeIdx * 3 + 2] };
+			Colliders::ResolveCollisions(colliderSet, grid, pos, ColliderQueryNodeRadius);
+			DoNotOptimize(pos);
+		}
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * ColliderQueryNodeCount);
+
+	uint64_t candidateCount = 0;
+	for (uint32_t nodeIdx = 0; nodeIdx < ColliderQueryNodeCount; ++nodeIdx)
+	{
+		const float pos[3] = { nodes[nodeIdx * 3], nodes[nodeIdx * 3 + 1], nodes[nodeIdx * 3 + 2] };
+		grid.ForEachCandidate(pos, [&](uint32_t) { ++candidateCount; });
+	}
+	state.SetCounter("CandidatesPerNode", double(candidateCount) / ColliderQueryNodeCount);
+}
+ASTRO_BENCHMARK(Colliders_ResolveGrid, { 16, 128, 1024 });
+
+// Grid rebuild, as when colliders move
+static void Colliders_BuildGrid(State& state)
+{
+	float fieldSize = 0.f;
+	const Colliders::ColliderSet colliderSet = MakeColliderField(uint32_t(state.GetArg()), fieldSize);
+	Colliders::ColliderGrid grid;
+	while (state.KeepRunning())
+	{
+		grid.Build(colliderSet.Colliders, ColliderGridCellSize, ColliderQueryNodeRadius);
+		DoNotOptimize(grid.GetColliderIndices().data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * colliderSet.Colliders.size());
+	state.SetCounter("GridEntries", double(grid.GetColliderIndices().size()));
+}
+ASTRO_BENCHMARK(Colliders_BuildGrid, { 16, 128, 1024 });
+
+// Steady state particle steps, with the demo's pool & step, arg is the emission rate in particles per second.
+// The cost follows the alive count, not the pool size. SimulationTests checks the lists stay valid.
+static void Particles_Step(State& state)
+{
+	constexpr uint32_t MaxParticleCount = 64 * 1024;
+	constexpr float StepDeltaTime = 1.f / 60.f;
+	const float emissionRate = float(state.GetArg());
+
+	Particles::CPUParticleSystem particleSystem(MaxParticleCount);
+	Particles::EmissionBudget emission;
+	uint32_t stepIndex = 0;
+
+	// Past the longest lifetime, emission & deaths balance out
+	for (; stepIndex < 300; ++stepIndex)
+	{
+		particleSystem.Step(StepDeltaTime, emission.Next(emissionRate, StepDeltaTime), stepIndex);
+	}
+
+	uint64_t simulatedCount = 0;
+	while (state.KeepRunning())
+	{
+		simulatedCount += particleSystem.GetAliveCount();
+		particleSystem.Step(StepDeltaTime, emission.Next(emissionRate, StepDeltaTime), stepIndex++);
+		DoNotOptimize(particleSystem.GetParticles().data());
+	}
+	state.SetItemsProcessed(simulatedCount);
+	state.SetCounter("AliveCount", particleSystem.GetAliveCount());
+}
+ASTRO_BENCHMARK(Particles_Step, { 1000, 12000, 30000 });
+
+// Parallel primitives, on every hardware thread. Arg is the element count.
+// SimulationTests checks them against serial std implementations, the GPU kernels are expected to produce the same results.
+
+static void Primitives_Reduce(State& state)
+{
+	const std::vector<uint32_t> values = MakePrimitivesInput(size_t(state.GetArg()), UINT32_MAX);
+	while (state.KeepRunning())
+	{
+		DoNotOptimize(ParallelPrimitives::Reduce(values.data(), values.size(), ParallelPrimitives::ReduceOp::Sum));
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * values.size());
+}
+ASTRO_BENCHMARK(Primitives_Reduce, { 1'000'000, 10'000'000 });
+
+static void Primitives_ExclusiveScan(State& state)
+{
+	const std::vector<uint32_t> values = MakePrimitivesInput(size_t(state.GetArg()), 0xFFFF);
+	std::vector<uint32_t> scanned(values.size());
+	while (state.KeepRunning())
+	{
+		DoNotOptimize(ParallelPrimitives::ExclusiveScan(values.data(), scanned.data(), values.size()));
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * values.size());
+}
+ASTRO_BENCHMARK(Primitives_ExclusiveScan, { 1'000'000, 10'000'000 });
+
+// Half the values kept, eg: alive particles
+static void Primitives_Compact(State& state)
+{
+	const std::vector<uint32_t> values = MakePrimitivesInput(size_t(state.GetArg()), UINT32_MAX);
+	std::vector<uint32_t> flags(values.size());
+	std::transform(values.begin(), values.end(), flags.begin(), [](uint32_t value) { return value >> 31; });
+	std::vector<uint32_t> compacted(values.size());
+	while (state.KeepRunning())
+	{
+		DoNotOptimize(ParallelPrimitives::Compact(values.data(), flags.data(), compacted.data(), values.size()));
+		DoNotOptimize(compacted.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * values.size());
+}
+ASTRO_BENCHMARK(Primitives_Compact, { 1'000'000, 10'000'000 });
+
+// 20 bits keys, many duplicates
+static void Primitives_RadixSort(State& state)
+{
+	const std::vector<uint32_t> unsortedKeys = MakePrimitivesInput(size_t(state.GetArg()), 0xFFFFF);
+	std::vector<uint32_t> keys(unsortedKeys.size());
+	std::vector<uint32_t> values(unsortedKeys.size());
+	while (state.KeepRunning())
+	{
+		state.PauseTiming();
+		keys = unsortedKeys;
+		std::iota(values.begin(), values.end(), 0u);
+		state.ResumeTiming();
+
+		ParallelPrimitives::RadixSortKeyValues(keys.data(), values.data(), keys.size(), 20);
+		DoNotOptimize(keys.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * keys.size());
+}
+ASTRO_BENCHMARK(Primitives_RadixSort, { 1'000'000, 10'000'000 });
+
+//---------------------------------------------------------------------------------------
+// Fluid sim 2D: pressure
+//---------------------------------------------------------------------------------------
+
+// Pressure solves of the fluid sim's 256^2 grid from 0, like every sim step.
+// ResidualRms is left by the solve, ResidualReduction is how much lower than the starting one it is.
+
+// Returns the residual reduction
+static float SetPressureResidualCounters(State& state, const std::vector<float>& pressure, const std::vector<float>& rhs, uint32_t resolution = PressureGridResolution)
+{
+	const std::vector<float> zeroPressure(pressure.size(), 0.f);
+	const float initialResidual = MultigridPoisson::ComputeResidualRms(zeroPressure.data(), rhs.data(), resolution);
+	const float residual = MultigridPoisson::ComputeResidualRms(pressure.data(), rhs.data(), resolution);
+	state.SetCounter("ResidualRms", residual);
+	state.SetCounter("ResidualReduction", initialResidual / residual);
+	return initialResidual / residual;
+}
+
+// Arg Jacobi iterations, the solver FluidSim2D ran 120 of, one dispatch each
+static void FluidPressure_Jacobi(State& state)
+{
+	const uint32_t iterationCount = uint32_t(state.GetArg());
+	const std::vector<float> rhs = MakePressureRhs();
+	std::vector<float> pressure(rhs.size());
+	std::vector<float> pressureScratch(rhs.size());
+	while (state.KeepRunning())
+	{
+		std::fill(pressure.begin(), pressure.end(), 0.f);
+		for (uint32_t iterationIdx = 0; iterationIdx < iterationCount; ++iterationIdx)
+		{
+			MultigridPoisson::JacobiIteration(pressure.data(), rhs.data(), pressureScratch.data(), PressureGridResolution);
+			std::swap(pressure, pressureScratch);
+		}
+		DoNotOptimize(pressure.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * rhs.size());
+	state.SetCounter("Dispatches", double(iterationCount));
+	SetPressureResidualCounters(state, pressure, rhs);
+}
+ASTRO_BENCHMARK(FluidPressure_Jacobi, { 30, 120, 480 });
+
+// Arg multigrid V-cycles. ConvergenceFactor is the average residual reduction per cycle, lower converges faster.
+static void FluidPressure_Multigrid(State& state)
+{
+	const uint32_t vCycleCount = uint32_t(state.GetArg());
+	const std::vector<float> rhs = MakePressureRhs();
+	std::vector<float> pressure(rhs.size());
+	MultigridPoisson::Solver solver(PressureGridResolution);
+	while (state.KeepRunning())
+	{
+		std::fill(pressure.begin(), pressure.end(), 0.f);
+		for (uint32_t vCycleIdx = 0; vCycleIdx < vCycleCount; ++vCycleIdx)
+		{
+			solver.VCycle(pressure.data(), rhs.data());
+		}
+		DoNotOptimize(pressure.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * rhs.size());
+	state.SetCounter("Dispatches", double(vCycleCount * MultigridPoisson::GetDispatchCountPerVCycle(PressureGridResolution, solver.GetSettings())));
+	const float residualReduction = SetPressureResidualCounters(state, pressure, rhs);
+	state.SetCounter("ConvergenceFactor", std::pow(1.f / residualReduction, 1.f / float(vCycleCount)));
+}
+ASTRO_BENCHMARK(FluidPressure_Multigrid, { 1, 2, 3, 4 });
+
+// Rounds to the nearest half float, R16_FLOAT storage. The values here are all in the normal range.
+static float RoundToHalf(float value)
+{
+	int exponent = 0;
+	const float mantissa = std::frexp(value, &exponent);
+	return std::ldexp(std::round(std::ldexp(mantissa, 11)), exponent - 11);
+}
+
+// The 2 V-cycles FluidSim2D runs, at an Arg^2 grid resolution: the dispatches grow by 10 per level & cycle, the convergence doesn't change.
+// HalfStorageResidualRms is the residual left once the solution is rounded to R16_FLOAT, SimSettings::HalfPrecisionPressure's floor.
+static void FluidPressure_MultigridResolution(State& state)
+{
+	const uint32_t resolution = uint32_t(state.GetArg());
+	constexpr uint32_t vCycleCount = 2;
+	const std::vector<float> rhs = MakePressureRhs(resolution);
+	std::vector<float> pressure(rhs.size());
+	MultigridPoisson::Solver solver(resolution);
+	while (state.KeepRunning())
+	{
+		std::fill(pressure.begin(), pressure.end(), 0.f);
+		for (uint32_t vCycleIdx = 0; vCycleIdx < vCycleCount; ++vCycleIdx)
+		{
+			solver.VCycle(pressure.data(), rhs.data());
+		}
+		DoNotOptimize(pressure.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * rhs.size());
+	state.SetCounter("Dispatches", double(vCycleCount * MultigridPoisson::GetDispatchCountPerVCycle(resolution, solver.GetSettings())));
+	SetPressureResidualCounters(state, pressure, rhs, resolution);
+
+	std::vector<float> halfPressure(pressure.size());
+	std::transform(pressure.begin(), pressure.end(), halfPressure.begin(), RoundToHalf);
+	state.SetCounter("HalfStorageResidualRms", MultigridPoisson::ComputeResidualRms(halfPressure.data(), rhs.data(), resolution));
+}
+ASTRO_BENCHMARK(FluidPressure_MultigridResolution, { 256, 512, 1024 });
+
+// PIC/FLIP 3D particle to grid transfer on the demo's 64^3 grid, arg is the particle count.
+// The particles fill the lower half of the grid, a settled column of fluid.
+// The sorted transfer scatters the sorted particles, the gather's grid bit for bit (SimulationTests' PicFlipP2G_*): the sort is paid back
+// by the sorted particles' node sums staying in cache.
+static void PicFlipP2G_Scatter(State& state)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipGrid();
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipParticles(size_t(state.GetArg()));
+	std::vector<float> nodeVelocities(size_t(grid.GetNodeCount()) * 3);
+	while (state.KeepRunning())
+	{
+		PicFlipTransfer::ScatterToGrid(grid, particles.data(), particles.size(), nodeVelocities.data());
+		DoNotOptimize(nodeVelocities.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * particles.size());
+}
+ASTRO_BENCHMARK(PicFlipP2G_Scatter, { 100'000, 1'000'000 });
+
+static void PicFlipP2G_SortGather(State& state)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipGrid();
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipParticles(size_t(state.GetArg()));
+	std::vector<PicFlipTransfer::Particle> sortedParticles;
+	std::vector<float> nodeVelocities;
+	PicFlipTransfer::Transfer transfer;
+	while (state.KeepRunning())
+	{
+		transfer.Run(grid, particles.data(), particles.size(), sortedParticles, nodeVelocities);
+		DoNotOptimize(nodeVelocities.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * particles.size());
+}
+ASTRO_BENCHMARK(PicFlipP2G_SortGather, { 100'000, 1'000'000 });
+
+// PIC/FLIP 3D brick activation, arg is the grid resolution. A dam break's block of fluid fills an eighth of the domain, a particle per cell.
+// ActiveBrickRatio is the pools' memory & the grid dispatches over the dense grid's, it follows the fluid volume & its one brick margin.
+// The maps' validity, full & half pool, is checked by SimulationTests' PicFlipBricks_*.
+static void PicFlipBricks_Activate(State& state)
+{
+	const uint32_t resolution = uint32_t(state.GetArg());
+	const PicFlipTransfer::Grid grid = MakePicFlipUnitGrid(resolution);
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipDamBreakParticles(resolution);
+
+	const PicFlipBricks::BrickGrid brickGrid(grid, PicFlipBricks::BrickGrid(grid, 0).GetBrickCount());
+	PicFlipBricks::BrickMap brickMap(brickGrid);
+	while (state.KeepRunning())
+	{
+		brickMap.Update(grid, particles.data(), particles.size());
+		DoNotOptimize(brickMap.GetActiveBricks());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * particles.size());
+	state.SetCounter("ActiveBricks", brickMap.GetActiveBrickCount());
+	state.SetCounter("ActiveBrickRatio", double(brickMap.GetActiveBrickCount()) / double(brickGrid.GetBrickCount()));
+}
+ASTRO_BENCHMARK(PicFlipBricks_Activate, { 64, 128, 256 });
+
+// PIC/FLIP 3D pressure solve on the demo's 64^3 grid: the P2G of the fluid column, arg is its velocities' scale, from a calm pool to a splash.
+// The iterations follow the residual target: the calm pool stops at AbsoluteTolerance in about half the splash's, whose target is relative.
+// IncompletePoisson takes about half Jacobi's iterations, for 2 neighbour passes per iteration instead of 1.
+// DivergenceRms is the projected velocities', over the fluid cells.
+static void RunPicFlipPressureBenchmark(State& state, PicFlipPressure::Preconditioner preconditioner)
+{
+	PicFlipPressureScene scene = MakePicFlipPressureScene(float(state.GetArg()) * 0.01f);
+	const uint32_t cellCount = scene.Grid.GetCellCount();
+	std::vector<float> pressure(cellCount);
+
+	PicFlipPressure::SolveSettings settings;
+	settings.Preconditioning = preconditioner;
+	PicFlipPressure::Solver solver(scene.Grid, settings);
+	PicFlipPressure::SolveStats stats;
+	while (state.KeepRunning())
+	{
+		stats = solver.Solve(scene.IsFluid.data(), scene.Rhs.data(), pressure.data());
+		DoNotOptimize(pressure.data());
+	}
+	state.SetItemsProcessed(state.GetIterationCount() * cellCount);
+	state.SetCounter("Iterations", stats.IterationCount);
+	state.SetCounter("Converged", stats.Converged ? 1. : 0.);
+	state.SetCounter("InitialResidualNorm", stats.InitialResidualNorm);
+	state.SetCounter("ResidualNorm", solver.ComputeResidualNorm(scene.IsFluid.data(), scene.Rhs.data(), pressure.data()));
+
+	PicFlipPressure::Project(scene.Grid, scene.IsFluid.data(), pressure.data(), scene.NodeVelocities.data());
+	state.SetCounter("DivergenceRms", ComputePicFlipDivergenceRms(scene));
+}
+
+static void PicFlipPressure_Jacobi(State& state)
+{
+	RunPicFlipPressureBenchmark(state, PicFlipPressure::Preconditioner::Jacobi);
+}
+ASTRO_BENCHMARK(PicFlipPressure_Jacobi, { 1, 100, 10000 });
+
+static void PicFlipPressure_IncompletePoisson(State& state)
+{
+	RunPicFlipPressureBenchmark(state, PicFlipPressure::Preconditioner::IncompletePoisson);
+}
+ASTRO_BENCHMARK(PicFlipPressure_IncompletePoisson, { 1, 100, 10000 });
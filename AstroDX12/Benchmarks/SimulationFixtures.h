@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Simulation/ChainPBDSolver.h>
+#include <Simulation/ChainVBDSolver.h>
+#include <Simulation/ColliderSet.h>
+#include <Simulation/PicFlipPressure.h>
+#include <Simulation/PicFlipTransfer.h>
+
+// Scenes shared by the simulation benchmarks & the tests checking the same code against its reference
+namespace SimulationFixtures
+{
+	// Chains hanging from a grid, laid out the way ComputePassPhysicsChain lays them out in its element buffer
+	inline void MakeChains(uint32_t chainCount, uint32_t elementsPerChain, std::vector<ChainPBD::ChainDesc>& outChains, std::vector<ChainPBD::Element>& outElements)
+	{
+		outChains.clear();
+		outElements.clear();
+		const uint32_t gridSize = uint32_t(std::ceil(std::sqrt(double(chainCount))));
+		for (uint32_t chainIdx = 0; chainIdx < chainCount; ++chainIdx)
+		{
+			outChains.push_back({ uint32_t(outElements.size()), elementsPerChain });
+			for (uint32_t elementIdx = 0; elementIdx < elementsPerChain; ++elementIdx)
+			{
+				ChainPBD::Element& element = outElements.emplace_back();
+				element.Pos[0] = 10.f + float(chainIdx % gridSize) * 4.f + float(elementIdx) * 8.f;
+				element.Pos[1] = 0.f;
+				element.Pos[2] = 10.f + float(chainIdx / gridSize) * 4.f;
+				std::copy(std::begin(element.Pos), std::end(element.Pos), std::begin(element.PrevPos));
+				element.RestLength = 8.f;
+				element.Radius = 2.f;
+				element.Pinned = elementIdx == 0;
+			}
+		}
+	}
+
+	// Largest relative stretch of a link, |length - RestLength| / RestLength, how far from converged a solve stopped
+	template<typename TElement>
+	float GetMaxLinkStretch(const std::vector<TElement>& chainElements)
+	{
+		float maxStretch = 0.f;
+		for (size_t elementIdx = 1; elementIdx < chainElements.size(); ++elementIdx)
+		{
+			const TElement& element = chainElements[elementIdx];
+			const TElement& parent = chainElements[elementIdx - 1];
+			float lengthSqr = 0.f;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				lengthSqr += (element.Pos[axis] - parent.Pos[axis]) * (element.Pos[axis] - parent.Pos[axis]);
+			}
+			maxStretch = std::max(maxStretch, std::fabs(std::sqrt(lengthSqr) - element.RestLength) / element.RestLength);
+		}
+		return maxStretch;
+	}
+
+	// The VBD chain demo: one 15 element chain, laid out horizontally & released
+	inline std::vector<ChainVBD::Element> MakeVBDChain()
+	{
+		std::vector<ChainPBD::ChainDesc> chains;
+		std::vector<ChainPBD::Element> pbdElements;
+		MakeChains(1, 15, chains, pbdElements);
+
+		std::vector<ChainVBD::Element> elements(pbdElements.size());
+		for (size_t elementIdx = 0; elementIdx < elements.size(); ++elementIdx)
+		{
+			std::copy(std::begin(pbdElements[elementIdx].Pos), std::end(pbdElements[elementIdx].Pos), std::begin(elements[elementIdx].Pos));
+			std::copy(std::begin(pbdElements[elementIdx].PrevPos), std::end(pbdElements[elementIdx].PrevPos), std::begin(elements[elementIdx].PrevPos));
+			elements[elementIdx].ParentIndex = int32_t(elementIdx) - 1;
+			elements[elementIdx].RestLength = pbdElements[elementIdx].RestLength;
+			elements[elementIdx].Radius = pbdElements[elementIdx].Radius;
+			elements[elementIdx].Pinned = pbdElements[elementIdx].Pinned;
+		}
+		return elements;
+	}
+
+	// Convergence is measured over seconds 2 to 4 of a released chain, once it swings through the colliders
+	constexpr uint32_t ConvergenceSettleStepCount = 120;
+	constexpr uint32_t ConvergenceMeasureStepCount = 120;
+
+	// Colliders of every shape, at a constant density: the volume they're scattered in grows with their count
+	inline Colliders::ColliderSet MakeColliderField(uint32_t colliderCount, float& outFieldSize)
+	{
+		outFieldSize = 32.f * std::cbrt(float(colliderCount));
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> position(0.f, outFieldSize);
+		std::uniform_real_distribution<float> size(1.f, 4.f);
+		const float rotation[4] = { 0.f, 0.3826834f, 0.f, 0.9238795f };
+
+		Colliders::ColliderSet colliderSet;
+		for (uint32_t colliderIdx = 0; colliderIdx < colliderCount; ++colliderIdx)
+		{
+			const float center[3] = { position(random), position(random), position(random) };
+			switch (colliderIdx % 4)
+			{
+			case 0:
+				colliderSet.AddSphere(center, size(random));
+				break;
+			case 1:
+			{
+				const float end[3] = { center[0] + 6.f, center[1] + 3.f, center[2] };
+				colliderSet.AddCapsule(center, end, size(random));
+				break;
+			}
+			case 2:
+			{
+				const float halfSize[3] = { size(random), size(random), size(random) };
+				colliderSet.AddBox(center, halfSize, rotation, 0.5f);
+				break;
+			}
+			case 3:
+			{
+				const float halfSize[3] = { 5.f, 5.f, 5.f };
+				const uint32_t resolution[3] = { 8, 8, 8 };
+				const float radius = size(random);
+				colliderSet.AddSdf(center, halfSize, rotation, resolution, [radius](float x, float y, float z) { return std::sqrt(x * x + y * y + z * z) - radius; });
+				break;
+			}
+			}
+		}
+		return colliderSet;
+	}
+
+	constexpr uint32_t ColliderQueryNodeCount = 4096;
+	constexpr float ColliderQueryNodeRadius = 2.f;
+	constexpr float ColliderGridCellSize = 16.f; // As ComputePassPhysicsChain
+
+	inline std::vector<float> MakeColliderQueryNodes(float fieldSize)
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> position(0.f, fieldSize);
+		std::vector<float> nodes(ColliderQueryNodeCount * 3);
+		for (float& coord : nodes)
+		{
+			coord = position(random);
+		}
+		return nodes;
+	}
+
+	// Random values for the parallel primitives, the bits outside valueMask cleared
+	inline std::vector<uint32_t> MakePrimitivesInput(size_t count, uint32_t valueMask, uint32_t seed = 1234)
+	{
+		std::mt19937 rng(seed);
+		std::vector<uint32_t> values(count);
+		for (uint32_t& value : values)
+		{
+			value = rng() & valueMask;
+		}
+		return values;
+	}
+
+	// The demo's PIC/FLIP 3D grid, 64^3 cells over 10 units
+	inline PicFlipTransfer::Grid MakePicFlipGrid()
+	{
+		PicFlipTransfer::Grid grid;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			grid.Resolution[axis] = 64;
+			grid.InvCellSize[axis] = 64.f / 10.f;
+		}
+		return grid;
+	}
+
+	// A settled column of fluid filling the lower half of MakePicFlipGrid's grid
+	inline std::vector<PicFlipTransfer::Particle> MakePicFlipParticles(size_t count)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(0.f, 10.f);
+		std::uniform_real_distribution<float> velocity(-1.f, 1.f);
+		std::vector<PicFlipTransfer::Particle> particles(count);
+		for (PicFlipTransfer::Particle& particle : particles)
+		{
+			particle.Pos[0] = position(rng);
+			particle.Pos[1] = position(rng) * 0.5f;
+			particle.Pos[2] = position(rng);
+			for (float& velocityComponent : particle.Vel)
+			{
+				velocityComponent = velocity(rng);
+			}
+		}
+		return particles;
+	}
+
+	// The pressure solve's input: MakePicFlipParticles' column transferred to MakePicFlipGrid, its velocities scaled by velocityScale
+	struct PicFlipPressureScene
+	{
+		PicFlipTransfer::Grid Grid;
+		std::vector<uint8_t> IsFluid;
+		std::vector<float> Rhs;
+		std::vector<float> NodeVelocities;
+	};
+
+	inline PicFlipPressureScene MakePicFlipPressureScene(float velocityScale)
+	{
+		PicFlipPressureScene scene;
+		scene.Grid = MakePicFlipGrid();
+		std::vector<PicFlipTransfer::Particle> particles = MakePicFlipParticles(200'000);
+		for (PicFlipTransfer::Particle& particle : particles)
+		{
+			for (float& velocityComponent : particle.Vel)
+			{
+				velocityComponent *= velocityScale;
+			}
+		}
+
+		const PicFlipTransfer::Grid& grid = scene.Grid;
+		const uint32_t cellCount = grid.GetCellCount();
+		std::vector<uint32_t> keys(particles.size());
+		std::vector<uint32_t> particleIndices(particles.size());
+		std::vector<uint32_t> cellStart(cellCount);
+		std::vector<uint32_t> cellEnd(cellCount);
+		std::vector<PicFlipTransfer::Particle> sortedParticles(particles.size());
+		scene.NodeVelocities.resize(size_t(grid.GetNodeCount()) * 3);
+		PicFlipTransfer::ComputeCellKeys(grid, particles.data(), particles.size(), keys.data(), particleIndices.data());
+		PicFlipTransfer::SortByCell(grid, keys.data(), particleIndices.data(), particles.size());
+		PicFlipTransfer::FindCellRanges(grid, keys.data(), particles.size(), cellStart.data(), cellEnd.data());
+		for (size_t sortedIdx = 0; sortedIdx < particles.size(); ++sortedIdx)
+		{
+			sortedParticles[sortedIdx] = particles[particleIndices[sortedIdx]];
+		}
+		PicFlipTransfer::GatherToGrid(grid, sortedParticles.data(), cellStart.data(), cellEnd.data(), scene.NodeVelocities.data());
+
+		scene.IsFluid.resize(cellCount);
+		scene.Rhs.resize(cellCount);
+		PicFlipPressure::MarkFluidCells(grid, cellStart.data(), cellEnd.data(), scene.IsFluid.data());
+		PicFlipPressure::ComputeDivergenceRhs(grid, scene.IsFluid.data(), scene.NodeVelocities.data(), scene.Rhs.data());
+		return scene;
+	}
+
+	// RMS of the scene's node velocities' divergence over the fluid cells
+	inline float ComputePicFlipDivergenceRms(const PicFlipPressureScene& scene)
+	{
+		std::vector<float> divergence(scene.Grid.GetCellCount());
+		PicFlipPressure::ComputeDivergenceRhs(scene.Grid, scene.IsFluid.data(), scene.NodeVelocities.data(), divergence.data());
+		const double fluidCellCount = double(std::count(scene.IsFluid.begin(), scene.IsFluid.end(), uint8_t(1)));
+		double divergenceSq = 0.;
+		for (float cellDivergence : divergence)
+		{
+			divergenceSq += double(cellDivergence) * cellDivergence;
+		}
+		return float(std::sqrt(divergenceSq / fluidCellCount));
+	}
+
+	// A grid of resolution^3 unit cells
+	inline PicFlipTransfer::Grid MakePicFlipUnitGrid(uint32_t resolution)
+	{
+		PicFlipTransfer::Grid grid;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			grid.Resolution[axis] = resolution;
+			grid.InvCellSize[axis] = 1.f;
+		}
+		return grid;
+	}
+
+	// A dam break's block of fluid in MakePicFlipUnitGrid's grid, an eighth of the domain at a particle per cell
+	inline std::vector<PicFlipTransfer::Particle> MakePicFlipDamBreakParticles(uint32_t resolution)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		std::vector<PicFlipTransfer::Particle> particles(size_t(resolution) * resolution * resolution / 8);
+		for (PicFlipTransfer::Particle& particle : particles)
+		{
+			particle.Pos[0] = unit(rng) * float(resolution) * 0.5f;
+			particle.Pos[1] = unit(rng) * float(resolution) * 0.25f;
+			particle.Pos[2] = unit(rng) * float(resolution);
+		}
+		return particles;
+	}
+
+	// The fluid sim's pressure grid
+	constexpr uint32_t PressureGridResolution = 256;
+
+	// A few smooth sources & sinks, like the divergence the cursor's splats leave. Zero mean: with zero gradient boundaries, there's only a solution then.
+	// The blobs scale with the resolution, the same flow on a finer grid.
+	inline std::vector<float> MakePressureRhs(uint32_t resolution = PressureGridResolution)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unitDistribution(0.f, 1.f);
+
+		const float resolutionScale = float(resolution) / float(PressureGridResolution);
+		std::vector<float> rhs(size_t(resolution) * resolution, 0.f);
+		for (uint32_t blobIdx = 0; blobIdx < 12; ++blobIdx)
+		{
+			const float centreX = unitDistribution(rng) * resolution;
+			const float centreY = unitDistribution(rng) * resolution;
+			const float amplitude = (unitDistribution(rng) * 2.f - 1.f) * 0.01f;
+			const float radius = (4.f + unitDistribution(rng) * 20.f) * resolutionScale;
+			for (uint32_t cellY = 0; cellY < resolution; ++cellY)
+			{
+				for (uint32_t cellX = 0; cellX < resolution; ++cellX)
+				{
+					const float dx = float(cellX) - centreX;
+					const float dy = float(cellY) - centreY;
+					rhs[size_t(cellY) * resolution + cellX] += amplitude * std::exp(-(dx * dx + dy * dy) / (radius * radius));
+				}
+			}
+		}
+
+		const double mean = std::accumulate(rhs.begin(), rhs.end(), 0.0) / double(rhs.size());
+		for (float& value : rhs)
+		{
+			value -= float(mean);
+		}
+		return rhs;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal test harness, the counterpart of MicroBenchmark.h for correctness: tests register themselves,
+// ASTRO_CHECK records a failure (and carries on), and the executable returns non-zero if any check failed.
+namespace MicroTest
+{
+	using TestFunction = void(*)();
+
+	struct Test
+	{
+		std::string Name;
+		TestFunction Function;
+	};
+
+	inline std::vector<Test>& GetRegisteredTests()
+	{
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	inline bool Register(const char* name, TestFunction function)
+	{
+		GetRegisteredTests().push_back({ name, function });
+		return true;
+	}
+
+	// Failed checks of the test currently running
+	inline int& GetFailedCheckCount()
+	{
+		static int failedCheckCount = 0;
+		return failedCheckCount;
+	}
+
+	inline void ReportFailure(const char* file, int line, const char* expression)
+	{
+		printf("    %s(%d): check failed: %s\n", file, line, expression);
+		++GetFailedCheckCount();
+	}
+
+	// Returns the amount of failed tests
+	inline int RunAll(std::string_view filter)
+	{
+		int runCount = 0;
+		int failedCount = 0;
+		for (const Test& test : GetRegisteredTests())
+		{
+			if (!filter.empty() && test.Name.find(filter) == std::string::npos)
+			{
+				continue;
+			}
+
+			GetFailedCheckCount() = 0;
+			test.Function();
+			++runCount;
+
+			const bool passed = GetFailedCheckCount() == 0;
+			printf("[%s] %s\n", passed ? "  OK  " : "FAILED", test.Name.c_str());
+			failedCount += passed ? 0 : 1;
+		}
+
+		printf("%d tests, %d failed\n", runCount, failedCount);
+		return runCount == 0 ? 1 : failedCount;
+	}
+}
+
+#define ASTRO_TEST_CONCAT_IMPL(a, b) a##b
+#define ASTRO_TEST_CONCAT(a, b) ASTRO_TEST_CONCAT_IMPL(a, b)
+
+// ASTRO_TEST(Name) { ... checks ... }
+#define ASTRO_TEST(name) \
+	static void name(); \
+	static const bool ASTRO_TEST_CONCAT(s_registered_, name) = MicroTest::Register(#name, name); \
+	static void name()
+
+#define ASTRO_CHECK(expression) \
+	((expression) ? (void)0 : MicroTest::ReportFailure(__FILE__, __LINE__, #expression))
+
+#define ASTRO_CHECK_NEAR(value, expected, tolerance) \
+	ASTRO_CHECK(std::abs(double(value) - double(expected)) <= double(tolerance))
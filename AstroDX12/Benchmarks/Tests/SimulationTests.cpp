@@ -0,0 +1,1004 @@
+#include "MicroTest.h"
+#include "../SimulationFixtures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <Simulation/ChainVBDSolver.h>
+#include <Simulation/ColliderSet.h>
+#include <Simulation/MultigridPoisson.h>
+#include <Simulation/ParallelPrimitives.h>
+#include <Simulation/ParticleSystem.h>
+#include <Simulation/PicFlipBricks.h>
+#include <Simulation/PicFlipPressure.h>
+#include <Simulation/PicFlipTransfer.h>
+#include <Timing/FixedStepScheduler.h>
+
+using namespace SimulationFixtures;
+
+//---------------------------------------------------------------------------------------
+// Colliders: broadphase
+//---------------------------------------------------------------------------------------
+
+// The grid only skips work: every node must end exactly where testing every collider in order leaves it
+ASTRO_TEST(Colliders_GridMatchesBruteForce)
+{
+	for (const uint32_t colliderCount : { 16u, 128u, 1024u })
+	{
+		float fieldSize = 0.f;
+		const Colliders::ColliderSet colliderSet = MakeColliderField(colliderCount, fieldSize);
+		const std::vector<float> nodes = MakeColliderQueryNodes(fieldSize);
+		Colliders::ColliderGrid grid;
+		grid.Build(colliderSet.Colliders, ColliderGridCellSize, ColliderQueryNodeRadius);
+
+		uint32_t mismatchCount = 0;
+		uint32_t movedCount = 0;
+		for (uint32_t nodeIdx = 0; nodeIdx < ColliderQueryNodeCount; ++nodeIdx)
+		{
+			const float startPos[3] = { nodes[nodeIdx * 3], nodes[nodeIdx * 3 + 1], nodes[nodeIdx * 3 + 2] };
+			float gridPos[3] = { startPos[0], startPos[1], startPos[2] };
+			float bruteForcePos[3] = { startPos[0], startPos[1], startPos[2] };
+			Colliders::ResolveCollisions(colliderSet, grid, gridPos, ColliderQueryNodeRadius);
+			Colliders::ResolveCollisionsBruteForce(colliderSet, bruteForcePos, ColliderQueryNodeRadius);
+			mismatchCount += std::equal(std::begin(gridPos), std::end(gridPos), std::begin(bruteForcePos)) ? 0 : 1;
+			movedCount += std::equal(std::begin(startPos), std::end(startPos), std::begin(bruteForcePos)) ? 0 : 1;
+		}
+		ASTRO_CHECK(mismatchCount == 0);
+		// Otherwise there's nothing to compare
+		ASTRO_CHECK(movedCount > ColliderQueryNodeCount / 100);
+	}
+}
+
+ASTRO_TEST(Colliders_GridListsEveryTouchingCollider)
+{
+	float fieldSize = 0.f;
+	const Colliders::ColliderSet colliderSet = MakeColliderField(128, fieldSize);
+	const std::vector<float> nodes = MakeColliderQueryNodes(fieldSize);
+	Colliders::ColliderGrid grid;
+	grid.Build(colliderSet.Colliders, ColliderGridCellSize, ColliderQueryNodeRadius);
+
+	uint32_t missedCount = 0;
+	for (uint32_t nodeIdx = 0; nodeIdx < ColliderQueryNodeCount; ++nodeIdx)
+	{
+		const float pos[3] = { nodes[nodeIdx * 3], nodes[nodeIdx * 3 + 1], nodes[nodeIdx * 3 + 2] };
+		std::vector<uint32_t> candidates;
+		grid.ForEachCandidate(pos, [&](uint32_t colliderIdx) { candidates.push_back(colliderIdx); });
+		ASTRO_CHECK(std::is_sorted(candidates.begin(), candidates.end()));
+
+		for (uint32_t colliderIdx = 0; colliderIdx < colliderSet.Colliders.size(); ++colliderIdx)
+		{
+			float pushedPos[3] = { pos[0], pos[1], pos[2] };
+			Colliders::ResolveCollision(colliderSet.Colliders[colliderIdx], colliderSet.SdfSamples, pushedPos, ColliderQueryNodeRadius);
+			const bool touches = !std::equal(std::begin(pos), std::end(pos), std::begin(pushedPos));
+			missedCount += touches && !std::binary_search(candidates.begin(), candidates.end(), colliderIdx) ? 1 : 0;
+		}
+	}
+	ASTRO_CHECK(missedCount == 0);
+}
+
+ASTRO_TEST(Colliders_GridGrowsCellsPastMaxCellCount)
+{
+	float fieldSize = 0.f;
+	const Colliders::ColliderSet colliderSet = MakeColliderField(1024, fieldSize);
+	Colliders::ColliderGrid grid;
+	grid.Build(colliderSet.Colliders, 1.f, ColliderQueryNodeRadius, 4096);
+
+	const Colliders::GridDesc& desc = grid.GetDesc();
+	ASTRO_CHECK(desc.CellSize > 1.f);
+	ASTRO_CHECK(uint64_t(desc.CellCount[0]) * desc.CellCount[1] * desc.CellCount[2] <= 4096);
+	ASTRO_CHECK(grid.GetCellStarts().size() == size_t(desc.CellCount[0]) * desc.CellCount[1] * desc.CellCount[2] + 1);
+	ASTRO_CHECK(grid.GetCellStarts().back() == grid.GetColliderIndices().size());
+}
+
+ASTRO_TEST(Colliders_EmptyGridHasNoCandidates)
+{
+	Colliders::ColliderGrid grid;
+	grid.Build({}, ColliderGridCellSize, ColliderQueryNodeRadius);
+
+	const float pos[3] = { 0.f, 0.f, 0.f };
+	uint32_t candidateCount = 0;
+	grid.ForEachCandidate(pos, [&](uint32_t) { ++candidateCount; });
+	ASTRO_CHECK(candidateCount == 0);
+}
+
+//---------------------------------------------------------------------------------------
+// Particles: dead & alive lists
+//---------------------------------------------------------------------------------------
+
+// The demo's pool & step, from a trickle to more than the pool holds: every slot stays either alive or dead, exactly once
+ASTRO_TEST(Particles_ListsStayValid)
+{
+	constexpr uint32_t MaxParticleCount = 64 * 1024;
+	constexpr float StepDeltaTime = 1.f / 60.f;
+	for (const float emissionRate : { 1000.f, 12000.f, 30000.f })
+	{
+		Particles::CPUParticleSystem particleSystem(MaxParticleCount);
+		Particles::EmissionBudget emission;
+		uint32_t invalidStepCount = 0;
+		uint32_t deadInAliveListCount = 0;
+		for (uint32_t stepIndex = 0; stepIndex < 400; ++stepIndex)
+		{
+			particleSystem.Step(StepDeltaTime, emission.Next(emissionRate, StepDeltaTime), stepIndex);
+			invalidStepCount += particleSystem.ValidateLists() ? 0 : 1;
+
+			// The alive list only holds particles which survived the step
+			for (uint32_t aliveIdx = 0; aliveIdx < particleSystem.GetAliveCount(); ++aliveIdx)
+			{
+				const Particles::Particle& particle = particleSystem.GetParticles()[particleSystem.GetAliveList()[aliveIdx]];
+				deadInAliveListCount += particle.Age < particle.Lifetime ? 0 : 1;
+			}
+		}
+		ASTRO_CHECK(invalidStepCount == 0);
+		ASTRO_CHECK(deadInAliveListCount == 0);
+		ASTRO_CHECK(particleSystem.GetAliveCount() > 0);
+		ASTRO_CHECK(particleSystem.GetAliveCount() <= MaxParticleCount);
+	}
+}
+
+ASTRO_TEST(Particles_EmissionStopsWhenThePoolIsFull)
+{
+	Particles::CPUParticleSystem particleSystem(256);
+	particleSystem.Step(1.f / 60.f, 1000, 0);
+	ASTRO_CHECK(particleSystem.GetAliveCount() == 256);
+	ASTRO_CHECK(particleSystem.GetDeadCount() == 0);
+	ASTRO_CHECK(particleSystem.ValidateLists());
+
+	particleSystem.Reset();
+	ASTRO_CHECK(particleSystem.GetAliveCount() == 0);
+	ASTRO_CHECK(particleSystem.GetDeadCount() == 256);
+	ASTRO_CHECK(particleSystem.ValidateLists());
+}
+
+ASTRO_TEST(Particles_ValidateListsCatchesBrokenLists)
+{
+	const uint32_t aliveList[] = { 0, 2 };
+	const uint32_t deadList[] = { 1, 3 };
+	ASTRO_CHECK(Particles::CPUParticleSystem::ValidateLists(4, aliveList, 2, deadList, 2));
+
+	// A slot listed twice, a slot missing
+	const uint32_t duplicateDeadList[] = { 1, 2 };
+	ASTRO_CHECK(!Particles::CPUParticleSystem::ValidateLists(4, aliveList, 2, duplicateDeadList, 2));
+	ASTRO_CHECK(!Particles::CPUParticleSystem::ValidateLists(4, aliveList, 2, deadList, 1));
+	// Out of the pool
+	const uint32_t outOfRangeDeadList[] = { 1, 4 };
+	ASTRO_CHECK(!Particles::CPUParticleSystem::ValidateLists(4, aliveList, 2, outOfRangeDeadList, 2));
+}
+
+//---------------------------------------------------------------------------------------
+// Parallel primitives
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	// Empty, single, around the per worker minimum & large enough for every hardware thread
+	constexpr size_t PrimitivesTestCounts[] = { 0, 1, 1000, 64 * 1024 + 1, 1'000'003 };
+}
+
+ASTRO_TEST(Primitives_ReduceMatchesStd)
+{
+	for (const size_t count : PrimitivesTestCounts)
+	{
+		const std::vector<uint32_t> values = MakePrimitivesInput(count, UINT32_MAX);
+		const uint32_t expectedMin = values.empty() ? UINT32_MAX : *std::min_element(values.begin(), values.end());
+		const uint32_t expectedMax = values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+		ASTRO_CHECK(ParallelPrimitives::Reduce(values.data(), values.size(), ParallelPrimitives::ReduceOp::Sum) == std::accumulate(values.begin(), values.end(), 0u));
+		ASTRO_CHECK(ParallelPrimitives::Reduce(values.data(), values.size(), ParallelPrimitives::ReduceOp::Min) == expectedMin);
+		ASTRO_CHECK(ParallelPrimitives::Reduce(values.data(), values.size(), ParallelPrimitives::ReduceOp::Max) == expectedMax);
+	}
+}
+
+ASTRO_TEST(Primitives_ExclusiveScanMatchesStd)
+{
+	for (const size_t count : PrimitivesTestCounts)
+	{
+		const std::vector<uint32_t> values = MakePrimitivesInput(count, 0xFFFF);
+		std::vector<uint32_t> expected(values.size());
+		std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u);
+
+		std::vector<uint32_t> scanned(values.size());
+		const uint32_t total = ParallelPrimitives::ExclusiveScan(values.data(), scanned.data(), values.size());
+		ASTRO_CHECK(scanned == expected);
+		ASTRO_CHECK(total == std::accumulate(values.begin(), values.end(), 0u));
+
+		// In place
+		std::vector<uint32_t> inPlace = values;
+		ParallelPrimitives::ExclusiveScan(inPlace.data(), inPlace.data(), inPlace.size());
+		ASTRO_CHECK(inPlace == expected);
+	}
+}
+
+ASTRO_TEST(Primitives_CompactMatchesStd)
+{
+	for (const size_t count : PrimitivesTestCounts)
+	{
+		const std::vector<uint32_t> values = MakePrimitivesInput(count, UINT32_MAX);
+		std::vector<uint32_t> flags(values.size());
+		std::transform(values.begin(), values.end(), flags.begin(), [](uint32_t value) { return value >> 31; });
+		std::vector<uint32_t> expected;
+		std::copy_if(values.begin(), values.end(), std::back_inserter(expected), [](uint32_t value) { return (value >> 31) != 0; });
+
+		std::vector<uint32_t> compacted(values.size());
+		const uint32_t keptCount = ParallelPrimitives::Compact(values.data(), flags.data(), compacted.data(), values.size());
+		ASTRO_CHECK(keptCount == expected.size());
+		compacted.resize(keptCount);
+		ASTRO_CHECK(compacted == expected);
+	}
+}
+
+// Values are the original indices: a stable sort keeps equal keys in that order
+static bool RadixSortMatchesStableSort(const std::vector<uint32_t>& unsortedKeys, uint32_t keyBitCount, uint32_t workerCount)
+{
+	const uint32_t keyMask = keyBitCount >= 32 ? UINT32_MAX : (1u << keyBitCount) - 1;
+	std::vector<uint32_t> expectedValues(unsortedKeys.size());
+	std::iota(expectedValues.begin(), expectedValues.end(), 0u);
+	std::stable_sort(expectedValues.begin(), expectedValues.end(), [&](uint32_t a, uint32_t b) { return (unsortedKeys[a] & keyMask) < (unsortedKeys[b] & keyMask); });
+
+	std::vector<uint32_t> keys = unsortedKeys;
+	std::vector<uint32_t> values(keys.size());
+	std::iota(values.begin(), values.end(), 0u);
+	ParallelPrimitives::RadixSortKeyValues(keys.data(), values.data(), keys.size(), keyBitCount, workerCount);
+
+	for (size_t keyIdx = 0; keyIdx < keys.size(); ++keyIdx)
+	{
+		if (values[keyIdx] != expectedValues[keyIdx] || keys[keyIdx] != unsortedKeys[expectedValues[keyIdx]])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+ASTRO_TEST(Primitives_RadixSortIsStable)
+{
+	for (const size_t count : PrimitivesTestCounts)
+	{
+		// 20 bits keys, many duplicates
+		const std::vector<uint32_t> keys = MakePrimitivesInput(count, 0xFFFFF);
+		ASTRO_CHECK(RadixSortMatchesStableSort(keys, 20, 0));
+		ASTRO_CHECK(RadixSortMatchesStableSort(keys, 32, 0));
+	}
+	// Odd & even pass counts, a single worker
+	const std::vector<uint32_t> keys = MakePrimitivesInput(100'000, UINT32_MAX);
+	ASTRO_CHECK(RadixSortMatchesStableSort(keys, 8, 1));
+	ASTRO_CHECK(RadixSortMatchesStableSort(keys, 16, 1));
+	ASTRO_CHECK(RadixSortMatchesStableSort(keys, 24, 3));
+}
+
+// The bits above keyBitCount don't take part: sorting on a bit count which isn't a multiple of the digit size (8 here, 4 on the GPU)
+// gives the same order as sorting on exactly those bits, whatever is stored above them
+ASTRO_TEST(Primitives_RadixSortIgnoresBitsAboveKeyBitCount)
+{
+	const std::vector<uint32_t> keys = MakePrimitivesInput(200'000, UINT32_MAX, 99);
+	for (const uint32_t keyBitCount : { 1u, 3u, 5u, 12u, 13u, 18u, 21u, 30u })
+	{
+		ASTRO_CHECK(RadixSortMatchesStableSort(keys, keyBitCount, 0));
+	}
+
+	// Same keys below the bit count, only differing above it: the input order is kept
+	const std::vector<uint32_t> sameLowBits = { 0x105, 0x005, 0x205, 0x003, 0x103 };
+	ASTRO_CHECK(RadixSortMatchesStableSort(sameLowBits, 5, 1));
+	std::vector<uint32_t> sortedKeys = sameLowBits;
+	std::vector<uint32_t> values = { 0, 1, 2, 3, 4 };
+	ParallelPrimitives::RadixSortKeyValues(sortedKeys.data(), values.data(), values.size(), 5, 1);
+	ASTRO_CHECK((values == std::vector<uint32_t>{ 3, 4, 0, 1, 2 }));
+}
+
+//---------------------------------------------------------------------------------------
+// PIC/FLIP 3D particle to grid transfer
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	// The fluid column, plus particles outside of the grid on every side which transfer to its boundary
+	std::vector<PicFlipTransfer::Particle> MakePicFlipTestParticles(size_t count)
+	{
+		std::vector<PicFlipTransfer::Particle> particles = MakePicFlipParticles(count);
+		for (size_t particleIdx = 0; particleIdx < 64; ++particleIdx)
+		{
+			PicFlipTransfer::Particle& particle = particles[particleIdx * 7];
+			particle.Pos[particleIdx % 3] = (particleIdx & 4) != 0 ? -1.f : 11.f;
+		}
+		return particles;
+	}
+
+	// The GPU's kernels one after the other: cell keys, sort, cell ranges & a gather per node
+	std::vector<float> GatherSortedParticles(const PicFlipTransfer::Grid& grid, const std::vector<PicFlipTransfer::Particle>& particles,
+		std::vector<PicFlipTransfer::Particle>& outSortedParticles)
+	{
+		std::vector<uint32_t> keys(particles.size());
+		std::vector<uint32_t> particleIndices(particles.size());
+		std::vector<uint32_t> cellStart(grid.GetCellCount());
+		std::vector<uint32_t> cellEnd(grid.GetCellCount());
+		PicFlipTransfer::ComputeCellKeys(grid, particles.data(), particles.size(), keys.data(), particleIndices.data());
+		PicFlipTransfer::SortByCell(grid, keys.data(), particleIndices.data(), particles.size());
+		PicFlipTransfer::FindCellRanges(grid, keys.data(), particles.size(), cellStart.data(), cellEnd.data());
+
+		outSortedParticles.resize(particles.size());
+		for (size_t sortedIdx = 0; sortedIdx < particles.size(); ++sortedIdx)
+		{
+			outSortedParticles[sortedIdx] = particles[particleIndices[sortedIdx]];
+		}
+		std::vector<float> nodeVelocities(size_t(grid.GetNodeCount()) * 3);
+		PicFlipTransfer::GatherToGrid(grid, outSortedParticles.data(), cellStart.data(), cellEnd.data(), nodeVelocities.data());
+		return nodeVelocities;
+	}
+}
+
+// Transfer scatters the sorted particles instead of gathering them per node: same sums in the same order, the GPU's grid bit for bit
+ASTRO_TEST(PicFlipP2G_TransferMatchesGatherBitForBit)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipGrid();
+	for (const size_t particleCount : { size_t(1000), size_t(50'000) })
+	{
+		const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipTestParticles(particleCount);
+		std::vector<PicFlipTransfer::Particle> gatheredParticles;
+		const std::vector<float> gatheredVelocities = GatherSortedParticles(grid, particles, gatheredParticles);
+
+		std::vector<PicFlipTransfer::Particle> sortedParticles;
+		std::vector<float> nodeVelocities;
+		PicFlipTransfer::Transfer transfer;
+		transfer.Run(grid, particles.data(), particles.size(), sortedParticles, nodeVelocities);
+
+		ASTRO_CHECK(sortedParticles.size() == gatheredParticles.size());
+		ASTRO_CHECK(std::memcmp(sortedParticles.data(), gatheredParticles.data(), sortedParticles.size() * sizeof(PicFlipTransfer::Particle)) == 0);
+		ASTRO_CHECK(nodeVelocities.size() == gatheredVelocities.size());
+		ASTRO_CHECK(std::memcmp(nodeVelocities.data(), gatheredVelocities.data(), nodeVelocities.size() * sizeof(float)) == 0);
+	}
+}
+
+// The sorted transfer & the unsorted scatter only differ by the order their sums add up in
+ASTRO_TEST(PicFlipP2G_TransferMatchesScatter)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipGrid();
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipTestParticles(100'000);
+	std::vector<PicFlipTransfer::Particle> sortedParticles;
+	std::vector<float> nodeVelocities;
+	PicFlipTransfer::Transfer transfer;
+	transfer.Run(grid, particles.data(), particles.size(), sortedParticles, nodeVelocities);
+
+	std::vector<float> scatteredVelocities(nodeVelocities.size());
+	PicFlipTransfer::ScatterToGrid(grid, particles.data(), particles.size(), scatteredVelocities.data());
+	float maxDifference = 0.f;
+	size_t nonZeroCount = 0;
+	for (size_t valueIdx = 0; valueIdx < nodeVelocities.size(); ++valueIdx)
+	{
+		maxDifference = std::max(maxDifference, std::abs(nodeVelocities[valueIdx] - scatteredVelocities[valueIdx]));
+		nonZeroCount += nodeVelocities[valueIdx] != 0.f ? 1 : 0;
+	}
+	ASTRO_CHECK(maxDifference < 1e-5f);
+	// The column covers about half the nodes
+	ASTRO_CHECK(nonZeroCount > nodeVelocities.size() / 3);
+}
+
+// Reruns of the same particles give the same grid, whatever was transferred before
+ASTRO_TEST(PicFlipP2G_TransferIsDeterministic)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipGrid();
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipTestParticles(20'000);
+	PicFlipTransfer::Transfer transfer;
+	std::vector<PicFlipTransfer::Particle> sortedParticles;
+	std::vector<float> firstVelocities;
+	transfer.Run(grid, particles.data(), particles.size(), sortedParticles, firstVelocities);
+
+	const std::vector<PicFlipTransfer::Particle> otherParticles = MakePicFlipTestParticles(70'000);
+	std::vector<float> nodeVelocities;
+	transfer.Run(grid, otherParticles.data(), otherParticles.size(), sortedParticles, nodeVelocities);
+	transfer.Run(grid, particles.data(), particles.size(), sortedParticles, nodeVelocities);
+	ASTRO_CHECK(std::memcmp(nodeVelocities.data(), firstVelocities.data(), nodeVelocities.size() * sizeof(float)) == 0);
+}
+
+//---------------------------------------------------------------------------------------
+// PIC/FLIP 3D bricks
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	// Brute force: brick b is active if a particle's brick is b or one of its 26 neighbours
+	std::vector<uint32_t> FindActiveBricks(const PicFlipTransfer::Grid& grid, const PicFlipBricks::BrickGrid& brickGrid, const std::vector<PicFlipTransfer::Particle>& particles)
+	{
+		std::vector<uint32_t> active(brickGrid.GetBrickCount(), 0);
+		for (const PicFlipTransfer::Particle& particle : particles)
+		{
+			int32_t particleBrick[3];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float coord = std::clamp((particle.Pos[axis] - grid.Origin[axis]) * grid.InvCellSize[axis], 0.f, float(grid.Resolution[axis]));
+				particleBrick[axis] = int32_t(std::min(uint32_t(coord), grid.Resolution[axis] - 1) / PicFlipBricks::BrickSize);
+			}
+			for (int32_t z = particleBrick[2] - 1; z <= particleBrick[2] + 1; ++z)
+			{
+				for (int32_t y = particleBrick[1] - 1; y <= particleBrick[1] + 1; ++y)
+				{
+					for (int32_t x = particleBrick[0] - 1; x <= particleBrick[0] + 1; ++x)
+					{
+						if (x >= 0 && y >= 0 && z >= 0 && x < int32_t(brickGrid.Resolution[0]) && y < int32_t(brickGrid.Resolution[1]) && z < int32_t(brickGrid.Resolution[2]))
+						{
+							active[brickGrid.GetBrickIdx(uint32_t(x), uint32_t(y), uint32_t(z))] = 1;
+						}
+					}
+				}
+			}
+		}
+		return active;
+	}
+
+	// The active bricks get slots in brick order until the pool is full, the active list is their inverse
+	bool SlotsFollowBrickOrder(const PicFlipBricks::BrickMap& brickMap, const std::vector<uint32_t>& expectedActive)
+	{
+		const PicFlipBricks::BrickGrid& brickGrid = brickMap.GetBrickGrid();
+		uint32_t nextSlot = 0;
+		for (uint32_t brickIdx = 0; brickIdx < brickGrid.GetBrickCount(); ++brickIdx)
+		{
+			const bool hasSlot = expectedActive[brickIdx] != 0 && nextSlot < brickGrid.PoolCapacity;
+			const uint32_t expectedSlot = hasSlot ? nextSlot++ : PicFlipBricks::InvalidSlot;
+			if (brickMap.GetSlot(brickIdx) != expectedSlot || (hasSlot && brickMap.GetActiveBricks()[expectedSlot] != brickIdx))
+			{
+				return false;
+			}
+		}
+		return nextSlot == brickMap.GetActiveBrickCount();
+	}
+}
+
+// The dam break at a few resolutions, with a pool for every brick: the kernels' map is the brute force one
+ASTRO_TEST(PicFlipBricks_MapMatchesBruteForce)
+{
+	for (const uint32_t resolution : { 32u, 64u, 100u })
+	{
+		const PicFlipTransfer::Grid grid = MakePicFlipUnitGrid(resolution);
+		const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipDamBreakParticles(resolution);
+		const PicFlipBricks::BrickGrid brickGrid(grid, PicFlipBricks::BrickGrid(grid, 0).GetBrickCount());
+		PicFlipBricks::BrickMap brickMap(brickGrid);
+		brickMap.Update(grid, particles.data(), particles.size());
+
+		const std::vector<uint32_t> expectedActive = FindActiveBricks(grid, brickGrid, particles);
+		const uint32_t expectedActiveCount = uint32_t(std::count(expectedActive.begin(), expectedActive.end(), 1u));
+		ASTRO_CHECK(brickMap.Validate());
+		ASTRO_CHECK(SlotsFollowBrickOrder(brickMap, expectedActive));
+		ASTRO_CHECK(brickMap.GetActiveBrickCount() == expectedActiveCount);
+		ASTRO_CHECK(brickMap.GetOverflowBrickCount() == 0);
+		// The fluid & its margin, not the whole domain
+		ASTRO_CHECK(expectedActiveCount > 0 && expectedActiveCount < brickGrid.GetBrickCount());
+	}
+}
+
+// Every node a particle transfers to is in an active brick: the cells around the particle's cell & their upper nodes
+ASTRO_TEST(PicFlipBricks_ActiveBricksCoverTransferNodes)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipUnitGrid(64);
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipDamBreakParticles(64);
+	const PicFlipBricks::BrickGrid brickGrid(grid, PicFlipBricks::BrickGrid(grid, 0).GetBrickCount());
+	PicFlipBricks::BrickMap brickMap(brickGrid);
+	brickMap.Update(grid, particles.data(), particles.size());
+
+	uint32_t uncoveredNodeCount = 0;
+	for (const PicFlipTransfer::Particle& particle : particles)
+	{
+		const uint32_t cellIdx = PicFlipTransfer::ComputeCellKey(grid, particle);
+		const uint32_t cell[3] = { cellIdx % grid.Resolution[0], (cellIdx / grid.Resolution[0]) % grid.Resolution[1], cellIdx / (grid.Resolution[0] * grid.Resolution[1]) };
+		for (uint32_t z = cell[2] > 0 ? cell[2] - 1 : 0; z <= std::min(cell[2] + 2, grid.Resolution[2]); ++z)
+		{
+			for (uint32_t y = cell[1] > 0 ? cell[1] - 1 : 0; y <= std::min(cell[1] + 2, grid.Resolution[1]); ++y)
+			{
+				for (uint32_t x = cell[0] > 0 ? cell[0] - 1 : 0; x <= std::min(cell[0] + 2, grid.Resolution[0]); ++x)
+				{
+					uncoveredNodeCount += brickMap.GetSlot(brickGrid.GetBrickIdxOfNode(x, y, z)) == PicFlipBricks::InvalidSlot ? 1 : 0;
+				}
+			}
+		}
+	}
+	ASTRO_CHECK(uncoveredNodeCount == 0);
+}
+
+// A pool of half the active bricks: the later ones in brick order are dropped, the map stays consistent
+ASTRO_TEST(PicFlipBricks_HalfPoolDropsTheLastBricks)
+{
+	for (const uint32_t resolution : { 32u, 64u })
+	{
+		const PicFlipTransfer::Grid grid = MakePicFlipUnitGrid(resolution);
+		const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipDamBreakParticles(resolution);
+		const std::vector<uint32_t> expectedActive = FindActiveBricks(grid, PicFlipBricks::BrickGrid(grid, 0), particles);
+		const uint32_t expectedActiveCount = uint32_t(std::count(expectedActive.begin(), expectedActive.end(), 1u));
+
+		PicFlipBricks::BrickMap halfPoolMap(PicFlipBricks::BrickGrid(grid, expectedActiveCount / 2));
+		halfPoolMap.Update(grid, particles.data(), particles.size());
+		ASTRO_CHECK(halfPoolMap.Validate());
+		ASTRO_CHECK(SlotsFollowBrickOrder(halfPoolMap, expectedActive));
+		ASTRO_CHECK(halfPoolMap.GetActiveBrickCount() == expectedActiveCount / 2);
+		ASTRO_CHECK(halfPoolMap.GetOverflowBrickCount() == expectedActiveCount - expectedActiveCount / 2);
+	}
+}
+
+// No particles, no active bricks, whatever the previous update activated
+ASTRO_TEST(PicFlipBricks_EmptyFluidHasNoActiveBricks)
+{
+	const PicFlipTransfer::Grid grid = MakePicFlipUnitGrid(32);
+	const std::vector<PicFlipTransfer::Particle> particles = MakePicFlipDamBreakParticles(32);
+	PicFlipBricks::BrickMap brickMap(PicFlipBricks::BrickGrid(grid, 64));
+	brickMap.Update(grid, particles.data(), particles.size());
+	ASTRO_CHECK(brickMap.GetActiveBrickCount() > 0);
+
+	brickMap.Update(grid, nullptr, 0);
+	ASTRO_CHECK(brickMap.GetActiveBrickCount() == 0);
+	ASTRO_CHECK(brickMap.GetOverflowBrickCount() == 0);
+	ASTRO_CHECK(brickMap.Validate());
+	for (uint32_t brickIdx = 0; brickIdx < brickMap.GetBrickGrid().GetBrickCount(); ++brickIdx)
+	{
+		ASTRO_CHECK(brickMap.GetSlot(brickIdx) == PicFlipBricks::InvalidSlot);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// PIC/FLIP 3D pressure
+//---------------------------------------------------------------------------------------
+
+// The calm pool's target is AbsoluteTolerance, the splash's is relative: its divergence is too large for the absolute one in float
+constexpr float PicFlipCalmVelocityScale = 0.01f;
+constexpr float PicFlipSplashVelocityScale = 1.f;
+
+ASTRO_TEST(PicFlipPressure_ConvergesWithEitherPreconditioner)
+{
+	for (const float velocityScale : { PicFlipCalmVelocityScale, PicFlipSplashVelocityScale })
+	{
+		const PicFlipPressureScene scene = MakePicFlipPressureScene(velocityScale);
+		std::vector<float> pressure(scene.Grid.GetCellCount());
+		for (const PicFlipPressure::Preconditioner preconditioner : { PicFlipPressure::Preconditioner::Jacobi, PicFlipPressure::Preconditioner::IncompletePoisson })
+		{
+			PicFlipPressure::SolveSettings settings;
+			settings.Preconditioning = preconditioner;
+			PicFlipPressure::Solver solver(scene.Grid, settings);
+			const PicFlipPressure::SolveStats stats = solver.Solve(scene.IsFluid.data(), scene.Rhs.data(), pressure.data());
+			ASTRO_CHECK(stats.Converged);
+			ASTRO_CHECK(stats.IterationCount > 0 && stats.IterationCount < settings.MaxIterationCount);
+		}
+	}
+}
+
+// Projected, the velocities' divergence is the solve's residual: at most the target the solve stopped at
+ASTRO_TEST(PicFlipPressure_ProjectionMeetsTheResidualTarget)
+{
+	for (const float velocityScale : { PicFlipCalmVelocityScale, PicFlipSplashVelocityScale })
+	{
+		const PicFlipPressureScene unprojectedScene = MakePicFlipPressureScene(velocityScale);
+		const float initialDivergenceRms = ComputePicFlipDivergenceRms(unprojectedScene);
+		for (const PicFlipPressure::Preconditioner preconditioner : { PicFlipPressure::Preconditioner::Jacobi, PicFlipPressure::Preconditioner::IncompletePoisson })
+		{
+			PicFlipPressureScene scene = unprojectedScene;
+			std::vector<float> pressure(scene.Grid.GetCellCount());
+			PicFlipPressure::SolveSettings settings;
+			settings.Preconditioning = preconditioner;
+			PicFlipPressure::Solver solver(scene.Grid, settings);
+			solver.Solve(scene.IsFluid.data(), scene.Rhs.data(), pressure.data());
+			PicFlipPressure::Project(scene.Grid, scene.IsFluid.data(), pressure.data(), scene.NodeVelocities.data());
+
+			const float divergenceRms = ComputePicFlipDivergenceRms(scene);
+			if (velocityScale == PicFlipCalmVelocityScale)
+			{
+				ASTRO_CHECK(divergenceRms <= settings.AbsoluteTolerance);
+			}
+			else
+			{
+				ASTRO_CHECK(divergenceRms > settings.AbsoluteTolerance);
+				ASTRO_CHECK(divergenceRms <= initialDivergenceRms * settings.RelativeTolerance * 1.01f);
+			}
+		}
+	}
+}
+
+// The dot products sum per z slice then in slice order, however the slices are split between the workers
+ASTRO_TEST(PicFlipPressure_SameResultForAnyWorkerCount)
+{
+	const PicFlipPressureScene scene = MakePicFlipPressureScene(PicFlipSplashVelocityScale);
+	const size_t cellCount = scene.Grid.GetCellCount();
+	std::vector<float> referencePressure(cellCount);
+	PicFlipPressure::Solver referenceSolver(scene.Grid, {}, 1);
+	const PicFlipPressure::SolveStats referenceStats = referenceSolver.Solve(scene.IsFluid.data(), scene.Rhs.data(), referencePressure.data());
+
+	for (const uint32_t workerCount : { 2u, 3u, 8u, 0u })
+	{
+		std::vector<float> pressure(cellCount);
+		PicFlipPressure::Solver solver(scene.Grid, {}, workerCount);
+		const PicFlipPressure::SolveStats stats = solver.Solve(scene.IsFluid.data(), scene.Rhs.data(), pressure.data());
+		ASTRO_CHECK(stats.IterationCount == referenceStats.IterationCount);
+		ASTRO_CHECK(std::memcmp(&stats.ResidualNorm, &referenceStats.ResidualNorm, sizeof(float)) == 0);
+		ASTRO_CHECK(std::memcmp(pressure.data(), referencePressure.data(), cellCount * sizeof(float)) == 0);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Fluid sim 2D: multigrid pressure
+//---------------------------------------------------------------------------------------
+
+// The 2 V-cycles FluidSim2D runs replace its 120 Jacobi iterations: they must leave a lower residual
+ASTRO_TEST(Multigrid_TwoVCyclesBeatJacobi)
+{
+	const std::vector<float> rhs = MakePressureRhs();
+	std::vector<float> jacobiPressure(rhs.size(), 0.f);
+	std::vector<float> jacobiScratch(rhs.size());
+	for (uint32_t iterationIdx = 0; iterationIdx < 120; ++iterationIdx)
+	{
+		MultigridPoisson::JacobiIteration(jacobiPressure.data(), rhs.data(), jacobiScratch.data(), PressureGridResolution);
+		std::swap(jacobiPressure, jacobiScratch);
+	}
+
+	std::vector<float> multigridPressure(rhs.size(), 0.f);
+	MultigridPoisson::Solver solver(PressureGridResolution);
+	solver.VCycle(multigridPressure.data(), rhs.data());
+	solver.VCycle(multigridPressure.data(), rhs.data());
+
+	const float jacobiResidual = MultigridPoisson::ComputeResidualRms(jacobiPressure.data(), rhs.data(), PressureGridResolution);
+	const float multigridResidual = MultigridPoisson::ComputeResidualRms(multigridPressure.data(), rhs.data(), PressureGridResolution);
+	ASTRO_CHECK(multigridResidual * 10.f < jacobiResidual);
+}
+
+// Every V-cycle cuts the residual by 5 at least, whatever the resolution, until the float precision floor
+ASTRO_TEST(Multigrid_ConvergencePerVCycle)
+{
+	for (const uint32_t resolution : { 64u, 256u, 512u })
+	{
+		const std::vector<float> rhs = MakePressureRhs(resolution);
+		std::vector<float> pressure(rhs.size(), 0.f);
+		MultigridPoisson::Solver solver(resolution);
+		float residual = MultigridPoisson::ComputeResidualRms(pressure.data(), rhs.data(), resolution);
+		for (uint32_t vCycleIdx = 0; vCycleIdx < 3; ++vCycleIdx)
+		{
+			solver.VCycle(pressure.data(), rhs.data());
+			const float nextResidual = MultigridPoisson::ComputeResidualRms(pressure.data(), rhs.data(), resolution);
+			ASTRO_CHECK(nextResidual < residual * 0.2f);
+			residual = nextResidual;
+		}
+	}
+}
+
+// FluidSim2D's divergence kernel writes RedPassFromZero's output for the first V-cycle to skip its first colour pass: the same solution
+// as cycling from 0, bit for bit. At the coarsest resolution the single level solve redoes the red pass, which reads 0 black cells again.
+ASTRO_TEST(Multigrid_RedPassFromZeroMatchesCyclingFromZero)
+{
+	for (const uint32_t resolution : { 16u, 64u, 256u })
+	{
+		const std::vector<float> rhs = MakePressureRhs(resolution);
+		MultigridPoisson::Solver solver(resolution);
+
+		std::vector<float> pressureFromZero(rhs.size(), 0.f);
+		solver.VCycle(pressureFromZero.data(), rhs.data());
+
+		std::vector<float> pressureFromRedPass(rhs.size(), 1.f); // Written over, not read
+		MultigridPoisson::RedPassFromZero(rhs.data(), pressureFromRedPass.data(), resolution);
+		solver.VCycle(pressureFromRedPass.data(), rhs.data(), true);
+
+		ASTRO_CHECK(std::memcmp(pressureFromZero.data(), pressureFromRedPass.data(), rhs.size() * sizeof(float)) == 0);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Chains: XPBD
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	// Worst link stretch of a 15 element chain over the convergence benchmark's measured steps
+	float MeasureChainPBDStretch(const ChainPBD::SolverSettings& settings)
+	{
+		const std::vector<ChainPBD::CollisionSphere> collisionSpheres = ChainPBD::MakeDefaultCollisionSpheres();
+		std::vector<ChainPBD::ChainDesc> chains;
+		std::vector<ChainPBD::Element> elements;
+		MakeChains(1, 15, chains, elements);
+		ChainPBD::CPUSolver solver(chains, elements);
+		float maxStretch = 0.f;
+		for (uint32_t stepIdx = 0; stepIdx < ConvergenceSettleStepCount + ConvergenceMeasureStepCount; ++stepIdx)
+		{
+			solver.Step(1.f / 60.f, settings, collisionSpheres, 1);
+			if (stepIdx >= ConvergenceSettleStepCount)
+			{
+				solver.ReadElements(elements);
+				maxStretch = std::max(maxStretch, GetMaxLinkStretch(elements));
+			}
+		}
+		return maxStretch;
+	}
+
+	float GetLinkLength(const std::vector<ChainPBD::Element>& elements, size_t elementIdx)
+	{
+		float lengthSq = 0.f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float delta = elements[elementIdx].Pos[axis] - elements[elementIdx - 1].Pos[axis];
+			lengthSq += delta * delta;
+		}
+		return std::sqrt(lengthSq);
+	}
+}
+
+// The default substeps are picked as the fewest which are as stiff as the default PBD iterations
+ASTRO_TEST(ChainXPBD_DefaultSubstepsAsStiffAsPBD)
+{
+	const ChainPBD::SolverSettings pbdSettings;
+	ChainPBD::SolverSettings xpbdSettings;
+	xpbdSettings.Mode = ChainPBD::SolverMode::XPBDSmallSteps;
+	ASTRO_CHECK(xpbdSettings.SubstepCount < pbdSettings.IterationCount);
+	ASTRO_CHECK(MeasureChainPBDStretch(xpbdSettings) <= MeasureChainPBDStretch(pbdSettings));
+
+	--xpbdSettings.SubstepCount;
+	ASTRO_CHECK(MeasureChainPBDStretch(xpbdSettings) > MeasureChainPBDStretch(pbdSettings));
+}
+
+// A hanging chain at rest: each link holds the weight of the elements below it, so it stretches by Compliance * |g| * that count.
+// The tip link holds a single element & converges, the others keep some of the rigid solve's stretch on top.
+ASTRO_TEST(ChainXPBD_ComplianceSoftensTheLinks)
+{
+	constexpr uint32_t ElementCount = 15;
+	float previousTopStretch = -1.f;
+	for (const float compliance : { 0.f, 1e-7f, 1e-6f, 1e-5f })
+	{
+		std::vector<ChainPBD::ChainDesc> chains;
+		std::vector<ChainPBD::Element> elements;
+		MakeChains(1, ElementCount, chains, elements);
+		ChainPBD::CPUSolver solver(chains, elements);
+		ChainPBD::SolverSettings settings;
+		settings.Mode = ChainPBD::SolverMode::XPBDSmallSteps;
+		settings.Compliance = compliance;
+		for (uint32_t stepIdx = 0; stepIdx < 600; ++stepIdx)
+		{
+			solver.Step(1.f / 60.f, settings, {}, 1);
+		}
+		solver.ReadElements(elements);
+
+		const float gravity = -settings.Gravity[1];
+		const float tipStretch = GetLinkLength(elements, ElementCount - 1) - elements[ElementCount - 1].RestLength;
+		ASTRO_CHECK_NEAR(tipStretch, compliance * gravity, 0.0005f + compliance * gravity * 0.05f);
+
+		const float topStretch = GetLinkLength(elements, 1) - elements[1].RestLength;
+		ASTRO_CHECK(topStretch > previousTopStretch);
+		ASTRO_CHECK(topStretch >= compliance * gravity * float(ElementCount - 1));
+		previousTopStretch = topStretch;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Chains: VBD
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	uint32_t CountSameColorLinks(const std::vector<int32_t>& parentIndices, const std::vector<uint32_t>& colors)
+	{
+		uint32_t sameColorLinkCount = 0;
+		for (size_t elementIdx = 0; elementIdx < parentIndices.size(); ++elementIdx)
+		{
+			const int32_t parentIdx = parentIndices[elementIdx];
+			sameColorLinkCount += (parentIdx >= 0 && colors[parentIdx] == colors[elementIdx]) ? 1 : 0;
+		}
+		return sameColorLinkCount;
+	}
+
+	// Worst link stretch of the VBD chain demo over the convergence benchmark's measured steps
+	float MeasureVBDChainStretch(uint32_t iterationCount)
+	{
+		const std::vector<ChainPBD::CollisionSphere> collisionSpheres = ChainPBD::MakeDefaultCollisionSpheres();
+		ChainVBD::SolverSettings settings;
+		settings.IterationCount = iterationCount;
+		std::vector<ChainVBD::Element> elements = MakeVBDChain();
+		const uint32_t colorCount = ChainVBD::ColorConstraintGraph(elements);
+		float maxStretch = 0.f;
+		for (uint32_t stepIdx = 0; stepIdx < ConvergenceSettleStepCount + ConvergenceMeasureStepCount; ++stepIdx)
+		{
+			ChainVBD::Step(elements, colorCount, 1.f / 60.f, settings, collisionSpheres);
+			if (stepIdx >= ConvergenceSettleStepCount)
+			{
+				maxStretch = std::max(maxStretch, GetMaxLinkStretch(elements));
+			}
+		}
+		return maxStretch;
+	}
+}
+
+ASTRO_TEST(ChainVBD_ChainIsTwoColored)
+{
+	for (const uint32_t elementCount : { 2u, 15u, 32u })
+	{
+		std::vector<int32_t> parentIndices(elementCount);
+		std::iota(parentIndices.begin(), parentIndices.end(), -1);
+		std::vector<uint32_t> colors;
+		ASTRO_CHECK(ChainVBD::ColorConstraintGraph(parentIndices, colors) == 2);
+		ASTRO_CHECK(colors.size() == elementCount);
+		ASTRO_CHECK(CountSameColorLinks(parentIndices, colors) == 0);
+	}
+
+	// The demo's chain, colored in place
+	std::vector<ChainVBD::Element> elements = MakeVBDChain();
+	ASTRO_CHECK(ChainVBD::ColorConstraintGraph(elements) == 2);
+	uint32_t sameColorLinkCount = 0;
+	for (size_t elementIdx = 1; elementIdx < elements.size(); ++elementIdx)
+	{
+		sameColorLinkCount += elements[elementIdx].Color == elements[elementIdx - 1].Color ? 1 : 0;
+	}
+	ASTRO_CHECK(sameColorLinkCount == 0);
+}
+
+// Trees (several children per element) & forests: linked elements never share a color, whatever the count
+ASTRO_TEST(ChainVBD_LinkedElementsNeverShareAColor)
+{
+	std::mt19937 rng(5678);
+	for (uint32_t treeIdx = 0; treeIdx < 20; ++treeIdx)
+	{
+		std::vector<int32_t> parentIndices(32);
+		for (size_t elementIdx = 0; elementIdx < parentIndices.size(); ++elementIdx)
+		{
+			// Roots every now & then, else any earlier element
+			parentIndices[elementIdx] = (elementIdx == 0 || rng() % 8 == 0) ? -1 : int32_t(rng() % elementIdx);
+		}
+
+		std::vector<uint32_t> colors;
+		const uint32_t colorCount = ChainVBD::ColorConstraintGraph(parentIndices, colors);
+		ASTRO_CHECK(CountSameColorLinks(parentIndices, colors) == 0);
+		ASTRO_CHECK(colorCount == *std::max_element(colors.begin(), colors.end()) + 1);
+	}
+}
+
+ASTRO_TEST(ChainVBD_StepIsDeterministic)
+{
+	const std::vector<ChainPBD::CollisionSphere> collisionSpheres = ChainPBD::MakeDefaultCollisionSpheres();
+	const ChainVBD::SolverSettings settings;
+	std::vector<ChainVBD::Element> runs[2] = { MakeVBDChain(), MakeVBDChain() };
+	for (std::vector<ChainVBD::Element>& elements : runs)
+	{
+		const uint32_t colorCount = ChainVBD::ColorConstraintGraph(elements);
+		for (uint32_t stepIdx = 0; stepIdx < 240; ++stepIdx)
+		{
+			ChainVBD::Step(elements, colorCount, 1.f / 60.f, settings, collisionSpheres);
+		}
+	}
+
+	uint32_t mismatchCount = 0;
+	for (size_t elementIdx = 0; elementIdx < runs[0].size(); ++elementIdx)
+	{
+		const ChainVBD::Element& lhs = runs[0][elementIdx];
+		const ChainVBD::Element& rhs = runs[1][elementIdx];
+		mismatchCount += (std::memcmp(lhs.Pos, rhs.Pos, sizeof(lhs.Pos)) != 0
+			|| std::memcmp(lhs.PrevPos, rhs.PrevPos, sizeof(lhs.PrevPos)) != 0
+			|| std::memcmp(lhs.Acceleration, rhs.Acceleration, sizeof(lhs.Acceleration)) != 0) ? 1 : 0;
+	}
+	ASTRO_CHECK(mismatchCount == 0);
+}
+
+// The default iterations reach the springs' own stretch under the chain's weight, as far as the solve can go
+ASTRO_TEST(ChainVBD_DefaultIterationsConverge)
+{
+	const float convergedStretch = MeasureVBDChainStretch(256);
+	ASTRO_CHECK(convergedStretch > 0.015f && convergedStretch < 0.02f);
+	ASTRO_CHECK(MeasureVBDChainStretch(ChainVBD::SolverSettings().IterationCount) < convergedStretch * 1.1f);
+}
+
+// Adaptive initialization: a free-falling chain isn't held back by starting its steps without gravity
+ASTRO_TEST(ChainVBD_FreeFallingChainKeepsUpWithGravity)
+{
+	std::vector<ChainVBD::Element> elements = MakeVBDChain();
+	for (ChainVBD::Element& element : elements)
+	{
+		element.Pinned = false;
+	}
+	const uint32_t colorCount = ChainVBD::ColorConstraintGraph(elements);
+	ChainVBD::SolverSettings settings;
+	settings.Damping = 1.f;
+
+	// Verlet from rest: after n steps, the drop is dt^2 * g * n (n + 1) / 2
+	constexpr uint32_t StepCount = 60;
+	constexpr float Dt = 1.f / 60.f;
+	for (uint32_t stepIdx = 0; stepIdx < StepCount; ++stepIdx)
+	{
+		ChainVBD::Step(elements, colorCount, Dt, settings, {});
+	}
+	const float expectedDrop = Dt * Dt * -settings.Gravity[1] * float(StepCount * (StepCount + 1) / 2);
+
+	float meanY = 0.f;
+	for (const ChainVBD::Element& element : elements)
+	{
+		meanY += element.Pos[1] / float(elements.size());
+	}
+	ASTRO_CHECK_NEAR(-meanY, expectedDrop, expectedDrop * 0.01f);
+}
+
+//---------------------------------------------------------------------------------------
+// Fixed timestep scheduling
+//---------------------------------------------------------------------------------------
+
+// 64Hz: the step & the deltas below are exact in floats
+ASTRO_TEST(FixedStep_NoStepBelowOnePeriod)
+{
+	FixedStepScheduler scheduler(64.f, 4);
+	SimStepData stepData = scheduler.Advance(0.5f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 0);
+	ASTRO_CHECK(stepData.StepDeltaTime == 1.f / 64.f);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.5f);
+
+	stepData = scheduler.Advance(0.25f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 0);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.75f);
+
+	// The time below a period carries over
+	stepData = scheduler.Advance(0.5f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 1);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.25f);
+	ASTRO_CHECK(scheduler.GetTotalStepCount() == 1);
+}
+
+ASTRO_TEST(FixedStep_CapDropsTheExcessTime)
+{
+	FixedStepScheduler scheduler(64.f, 4);
+	SimStepData stepData = scheduler.Advance(10.5f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 4);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.5f);
+	ASTRO_CHECK(scheduler.GetDroppedStepCount() == 6);
+
+	// Only the partial step is left, the dropped ones aren't caught up on
+	stepData = scheduler.Advance(0.25f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 0);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.75f);
+
+	stepData = scheduler.Advance(3.25f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 4);
+	ASTRO_CHECK(scheduler.GetDroppedStepCount() == 6);
+	ASTRO_CHECK(scheduler.GetTotalStepCount() == 8);
+}
+
+ASTRO_TEST(FixedStep_AlphaStaysBelowOne)
+{
+	// Just short of a period: 25Hz is one of the rates where the alpha rounds up to 1 as a float
+	for (const float stepRateHz : { 25.f, 29.f, 60.f, 144.f })
+	{
+		FixedStepScheduler scheduler(stepRateHz, 4);
+		float delta = float(1.0 / double(stepRateHz));
+		if (double(delta) >= 1.0 / double(stepRateHz))
+		{
+			delta = std::nextafter(delta, 0.f);
+		}
+		const SimStepData stepData = scheduler.Advance(delta);
+		ASTRO_CHECK(stepData.StepCount == 0);
+		ASTRO_CHECK(stepData.InterpolationAlpha < 1.f);
+	}
+
+	// Frame times from nothing to past the cap
+	FixedStepScheduler scheduler(60.f, 4);
+	uint32_t state = 12345u;
+	uint32_t outOfRangeCount = 0;
+	for (uint32_t frameIdx = 0; frameIdx < 10000; ++frameIdx)
+	{
+		state = state * 1664525u + 1013904223u;
+		const float delta = float(state >> 8) / float(1u << 24) * 6.f / 60.f;
+		const SimStepData stepData = scheduler.Advance(delta);
+		outOfRangeCount += (stepData.InterpolationAlpha < 0.f || stepData.InterpolationAlpha >= 1.f || stepData.StepCount > 4) ? 1 : 0;
+	}
+	ASTRO_CHECK(outOfRangeCount == 0);
+}
+
+ASTRO_TEST(FixedStep_SetStepRateKeepsTheAccumulatedTime)
+{
+	FixedStepScheduler scheduler(64.f, 4);
+	ASTRO_CHECK(scheduler.Advance(0.75f / 64.f).StepCount == 0);
+
+	// 0.75 of a 64Hz step is 1.5 of a 128Hz one
+	scheduler.SetStepRate(128.f);
+	const SimStepData stepData = scheduler.Advance(0.f);
+	ASTRO_CHECK(stepData.StepCount == 1);
+	ASTRO_CHECK(stepData.StepDeltaTime == 1.f / 128.f);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.5f);
+}
+
+ASTRO_TEST(FixedStep_NegativeDeltasAreIgnored)
+{
+	FixedStepScheduler scheduler(64.f, 4);
+	scheduler.Advance(0.5f / 64.f);
+
+	SimStepData stepData = scheduler.Advance(-1.f);
+	ASTRO_CHECK(stepData.StepCount == 0);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.5f);
+
+	stepData = scheduler.Advance(0.5f / 64.f);
+	ASTRO_CHECK(stepData.StepCount == 1);
+	ASTRO_CHECK(stepData.InterpolationAlpha == 0.f);
+	ASTRO_CHECK(scheduler.GetTotalStepCount() == 1);
+	ASTRO_CHECK(scheduler.GetDroppedStepCount() == 0);
+}
@@ -0,0 +1,19 @@
+// Correctness tests of the platform independent core, built next to the benchmarks by CMakeLists.txt & run by ctest:
+//   ./build/AstroTests [--filter <name substring>]
+// Returns the amount of failed tests, so any failure fails the run.
+
+#include "MicroTest.h"
+
+int main(int argc, char** argv)
+{
+	std::string_view filter;
+	for (int argIdx = 1; argIdx + 1 < argc; ++argIdx)
+	{
+		if (std::string_view(argv[argIdx]) == "--filter")
+		{
+			filter = argv[++argIdx];
+		}
+	}
+
+	return MicroTest::RunAll(filter);
+}
@@ -1,8 +1,19 @@
-#define THREAD_GROUP_SIZE_X 32
-#define THREAD_GROUP_SIZE_Y 32
+// Backwards advection of the velocity & the density through the same velocity, in a single pass.
+// The backtraced positions fall between cells: Sample's bilinear filtering is the interpolation.
+// The density's edge ring copies the cell inside it, advected from there.
+
+// Permutation defines, ComputePassFluidSim2D::SimSettings::ThreadGroupSize
+#ifndef THREAD_GROUP_SIZE_X
+#define THREAD_GROUP_SIZE_X 16
+#endif
+#ifndef THREAD_GROUP_SIZE_Y
+#define THREAD_GROUP_SIZE_Y 16
+#endif
 
 Texture2D<float2> VelocityGridInput : register(t0);
+Texture2D<float4> DensityGridInput : register(t1);
 RWTexture2D<float2> VelocityGridOutput : register(u0);
+RWTexture2D<float4> DensityGridOutput : register(u1);
 
 SamplerState g_BindlessSamplers[] : register(s0);
 
@@ -10,27 +21,27 @@ cbuffer BindlessRenderResources : register(b0)
 {
     int GridResolution;
     int samplerIndex;
+    float SimDeltaTime; // Fixed step of the fluid sim clock
 }
 
-bool IsEdge(uint2 coord)
+// Where the fluid in the cell was a step ago
+float2 BackTrace(int2 coord)
 {
-    float edgeWidth = 5.f;
-    return (coord.x < edgeWidth || coord.x > GridResolution - edgeWidth || coord.y < edgeWidth || coord.y > GridResolution - edgeWidth);
+    const float deltaTime = SimDeltaTime;
+
+    float2 velocityCurrentCell = VelocityGridInput[coord];
+    float2 backTracedCellOffset = (float2(1.f, -1.f) * velocityCurrentCell * deltaTime) / float(GridResolution);
+    const float2 texelCenterOffset = (float2) 1.f / GridResolution * 0.5f;
+    float2 currentUV = float2(coord) / float(GridResolution) + texelCenterOffset;
+    return saturate(currentUV - backTracedCellOffset);
 }
 
 [numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, 1)]
 void CSMain(uint3 DTid : SV_DispatchThreadID)
 {
-    const float deltaTime = 1.f / 60.f;
-    
-    // backwards advection
-    float2 velocityCurrentCell = VelocityGridInput[DTid.xy];
-    float2 backTracedCellOffset = (float2(1.f, -1.f) * velocityCurrentCell * deltaTime) / float(GridResolution);
-    const float2 texelCenterOffset = (float2) 1.f / GridResolution * 0.5f;
-    float2 currentUV = float2(DTid.xy) / float(GridResolution) + texelCenterOffset;
-    float2 targetUV = saturate(currentUV - backTracedCellOffset);
-                   
-    float2 interpolatedVelocityValue = VelocityGridInput.Sample(g_BindlessSamplers[samplerIndex], targetUV);
+    const int2 coord = int2(DTid.xy);
+    VelocityGridOutput[coord] = VelocityGridInput.Sample(g_BindlessSamplers[samplerIndex], BackTrace(coord));
 
-    VelocityGridOutput[DTid.xy] = interpolatedVelocityValue;
-}
\ No newline at end of file
+    const int2 densitySourceCoord = int2(clamp(coord.x, 1, GridResolution - 2), clamp(coord.y, 1, GridResolution - 2));
+    DensityGridOutput[coord] = DensityGridInput.Sample(g_BindlessSamplers[samplerIndex], BackTrace(densitySourceCoord));
+}
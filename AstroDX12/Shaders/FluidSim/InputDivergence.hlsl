@@ -0,0 +1,175 @@
+// Cursor input, divergence of the resulting velocity & the first red pass of the pressure solve, fused into a single pass.
+// The divergence taps read the post input velocities of a groupshared tile, the input being applied to its ghost cells as well.
+
+// Permutation defines, ComputePassFluidSim2D::SimSettings::ThreadGroupSize
+#ifndef THREAD_GROUP_SIZE_X
+#define THREAD_GROUP_SIZE_X 16
+#endif
+#ifndef THREAD_GROUP_SIZE_Y
+#define THREAD_GROUP_SIZE_Y 16
+#endif
+#define TILE_SIZE_X (THREAD_GROUP_SIZE_X + 2) // 1 ghost cell on each side
+#define TILE_SIZE_Y (THREAD_GROUP_SIZE_Y + 2)
+
+cbuffer cbPass : register(b0)
+{
+    float4x4 gView;
+    float4x4 InvView;
+    float4x4 gProj;
+    float4x4 gInvProj;
+    float4x4 gViewProj;
+    float4x4 gInvViewProj;
+    float3 gEyePosW;
+    float gPerObjectPad1; // Unused - padding
+    float2 gRenderTargetSize;
+    float2 gInvRenderTargetSize;
+    float gNearZ;
+    float gFarZ;
+    float gTotalTime;
+    float gDeltaTime;
+};
+
+Texture2D<float2> VelocityGridInput : register(t0);
+Texture2D<float4> DensityGridInput : register(t1);
+RWTexture2D<float2> VelocityGridOutput : register(u0);
+RWTexture2D<float4> DensityGridOutput : register(u1);
+RWTexture2D<float> DivergenceGridOutput : register(u2);
+RWTexture2D<float> PressureGridOutput : register(u3);
+
+cbuffer BindlessRenderResources : register(b1)
+{
+    int GridResolution;
+    float time;
+    int inputPosX;
+    int inputPosY;
+    int inputPrevPosX;
+    int inputPrevPosY;
+    float SimDeltaTime; // Fixed step of the fluid sim clock
+}
+
+float2 GetInputInQuadUV(float2 inputScreenUV)
+{
+    float2 centeredInputScreenUV = (inputScreenUV - 0.5f) * 2.f; // -1. to 1.
+    
+    // TODO: get vertex positions from a structured buffer
+    //StructuredBuffer<VertexData> vertexData = ResourceDescriptorHeap[modelVertexDataBufferIdx];
+    
+    // get Quad extrema in screen UV space
+    float3 QuadBLWS = float3(-10, -10, 0);
+    float3 QuadTRWS = float3(10, 10, 0);
+    // Put in clipspace
+    float4 QualBLProjSpace = mul(float4(QuadBLWS, 1.0f), gViewProj);
+    float4 QualTRProjSpace = mul(float4(QuadTRWS, 1.0f), gViewProj);
+    // Put in NDC space
+    float3 QuadBLNDC = QualBLProjSpace.xyz / QualBLProjSpace.w;
+    float3 QuadTRNDC = QualTRProjSpace.xyz / QualTRProjSpace.w;
+    // Put in quad-screen UV space
+    // Screenspace
+    float2 QuadScreenUV_BL = (QuadBLNDC.xy * 0.5f) + 0.5f;
+    float2 QuadScreenUV_TR = (QuadTRNDC.xy * 0.5f) + 0.5f;
+    float2 inputPosUV = (inputScreenUV - QuadScreenUV_BL) / (QuadScreenUV_TR - QuadScreenUV_BL);
+    
+    return inputPosUV;
+}
+
+struct CursorInput
+{
+    float2 PosUV;
+    float2 Velocity; // Added to the cells under the cursor this step
+};
+
+CursorInput GetCursorInput()
+{
+    const float2 invViewPortSize = ((float2) 1.f) / gRenderTargetSize;
+    const uint2 pixelCoord = uint2(inputPosX, gRenderTargetSize.y- inputPosY);
+    const float2 inputScreenUV = pixelCoord * invViewPortSize;
+    
+    const float2 inputPosUV = GetInputInQuadUV(inputScreenUV);
+    
+    const bool inBounds = any(inputPosUV >= 0.f) || any(inputPosUV <= 1.f);
+    const float deltaTime = SimDeltaTime;
+    
+    const float InputVelocityScale = 300000.0f;
+    const float2 inputCursorVelocity = float2(inputPosX - inputPrevPosX, inputPosY - inputPrevPosY) * invViewPortSize * InputVelocityScale;
+    // Clamp velocity
+    const float velocityMagSqr = dot(inputCursorVelocity, inputCursorVelocity);
+    float2 addedVelocityDir = float2(0.f, 0.f);
+    float velocityMagnitude = 0.f;
+    if (velocityMagSqr > 0.001f)
+    {
+        addedVelocityDir = normalize(inputCursorVelocity); 
+        velocityMagnitude = sqrt(velocityMagSqr);
+        
+        const float MaxVelocityMagnitude = 30000.f;
+        if (velocityMagnitude > MaxVelocityMagnitude)
+        {
+            velocityMagnitude = MaxVelocityMagnitude;
+        }
+    }
+    const float addedVelocityStrength = velocityMagnitude * deltaTime * (inBounds ? 1.f : 0.f);
+
+    CursorInput cursor;
+    cursor.PosUV = inputPosUV;
+    cursor.Velocity = addedVelocityDir * addedVelocityStrength;
+    return cursor;
+}
+
+// 1 under the cursor, 0 elsewhere
+float GetCursorMask(int2 cell, CursorInput cursor)
+{
+    const float2 uv = (float2(cell) + 0.5f) / float2(GridResolution, GridResolution) - cursor.PosUV;
+    const float maskRadius = 0.02f;
+    return step(length(uv), maskRadius);
+}
+
+int2 SafeCoord(int2 coord)
+{
+    return int2(clamp(coord.x, 0, GridResolution - 1), clamp(coord.y, 0, GridResolution - 1));
+}
+
+groupshared float2 gs_velocityTile[TILE_SIZE_X * TILE_SIZE_Y];
+
+float2 LoadTileVelocity(int2 tileCell)
+{
+    return gs_velocityTile[tileCell.y * TILE_SIZE_X + tileCell.x];
+}
+
+[numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, 1)]
+void CSMain(uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    const CursorInput cursor = GetCursorInput();
+
+    // Post input velocities of the group's cells & their ghost cells, the ones outside the grid clamped like the divergence taps were
+    const int2 tileOrigin = int2(Gid.xy) * int2(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y) - 1;
+    for (uint tileIdx = GTid.y * THREAD_GROUP_SIZE_X + GTid.x; tileIdx < TILE_SIZE_X * TILE_SIZE_Y; tileIdx += THREAD_GROUP_SIZE_X * THREAD_GROUP_SIZE_Y)
+    {
+        const int2 tileCellCoord = SafeCoord(tileOrigin + int2(tileIdx % TILE_SIZE_X, tileIdx / TILE_SIZE_X));
+        const float2 currentVelocity = VelocityGridInput[tileCellCoord];
+        gs_velocityTile[tileIdx] = lerp(currentVelocity, currentVelocity + cursor.Velocity, GetCursorMask(tileCellCoord, cursor));
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    const int2 coord = int2(DTid.xy);
+    const int2 tileCell = int2(GTid.xy) + 1;
+    VelocityGridOutput[coord] = LoadTileVelocity(tileCell);
+    
+    const float decayRate = 0.999f;
+    const float4 density = DensityGridInput[coord] * decayRate;
+    DensityGridOutput[coord] = min(1.f, lerp(density, 
+    (float4((0.5 * sin(time)) + 1.f, 0.5f * (cos(time)) + 1.f, time % 1.f, 0.f)) * 1.0f
+    , GetCursorMask(coord, cursor)));
+
+    // Divergence
+    const float dx = 1.0f / GridResolution;
+    const float2 Vel_Left = LoadTileVelocity(tileCell + int2(-1, 0));
+    const float2 Vel_Right = LoadTileVelocity(tileCell + int2(1, 0));
+    const float2 Vel_Down = LoadTileVelocity(tileCell + int2(0, 1)); // origin is top left
+    const float2 Vel_Up = LoadTileVelocity(tileCell + int2(0, -1));
+    const float divergence = 0.5f * (Vel_Right.x - Vel_Left.x + Vel_Up.y - Vel_Down.y) * dx;
+    DivergenceGridOutput[coord] = divergence;
+
+    // First red pass of the pressure solve from 0, same as MultigridPoisson::RedPassFromZero: -divergence / neighbour count on the red cells
+    const int2 isInnerCoord = int2(coord > 0) * int2(coord < GridResolution - 1);
+    const float neighbourCount = float(2 + isInnerCoord.x + isInnerCoord.y);
+    PressureGridOutput[coord] = ((coord.x + coord.y) & 1) == 0 ? (0.f - divergence) / neighbourCount : 0.f;
+}
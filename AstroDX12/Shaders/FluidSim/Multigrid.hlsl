@@ -0,0 +1,162 @@
+// Geometric multigrid V-cycle kernels for the fluid sim's pressure, recorded by GPUMultigridPoisson2D.
+// Solves L x = b, L being the 5 point Laplacian in grid units with zero gradient boundaries: (L x)_i = sum over the neighbours j inside the grid of (x_j - x_i).
+// MultigridPoisson (Src/Simulation/MultigridPoisson.h) is the CPU reference, keep both in sync.
+
+cbuffer BindlessRenderResources : register(b0)
+{
+    int BindlessIndexSolutionTex; // x of the level
+    int BindlessIndexRhsTex; // b of the level
+    int BindlessIndexCoarseSolutionTex;
+    int BindlessIndexCoarseRhsTex;
+    int Resolution; // Of the level, int for the clamps
+    uint Parity; // Colour smoothed: 0 for the cells with an even x + y
+    uint SweepCount; // Red & black sweeps of the coarsest level
+}
+
+#define MULTIGRID_THREAD_GROUP_SIZE 8
+#define MULTIGRID_COARSEST_RESOLUTION 16 // VCycleSettings::CoarsestResolution, one thread per cell
+
+bool IsInsideGrid(int2 cell, int resolution)
+{
+    return all(cell >= 0) && all(cell < resolution);
+}
+
+// Sum of the neighbours inside the grid & their count
+float SumNeighbours(RWTexture2D<float> solution, int2 cell, out float neighbourCount)
+{
+    const int2 offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+
+    float sum = 0.f;
+    neighbourCount = 0.f;
+    [unroll]
+    for (int offsetIdx = 0; offsetIdx < 4; ++offsetIdx)
+    {
+        const int2 neighbour = cell + offsets[offsetIdx];
+        if (IsInsideGrid(neighbour, Resolution))
+        {
+            sum += solution[neighbour];
+            neighbourCount += 1.f;
+        }
+    }
+    return sum;
+}
+
+float ComputeResidual(RWTexture2D<float> solution, RWTexture2D<float> rhs, int2 cell)
+{
+    float neighbourCount;
+    const float neighbourSum = SumNeighbours(solution, cell, neighbourCount);
+    return rhs[cell] - (neighbourSum - neighbourCount * solution[cell]);
+}
+
+// Gauss-Seidel on the cells of one colour, in place: a thread per cell of the colour, Resolution / 2 x Resolution threads
+[numthreads(MULTIGRID_THREAD_GROUP_SIZE, MULTIGRID_THREAD_GROUP_SIZE, 1)]
+void CSSmoothRedBlack(uint3 DTid : SV_DispatchThreadID)
+{
+    RWTexture2D<float> solution = ResourceDescriptorHeap[BindlessIndexSolutionTex];
+    RWTexture2D<float> rhs = ResourceDescriptorHeap[BindlessIndexRhsTex];
+
+    const int2 cell = int2(DTid.x * 2 + ((DTid.y + Parity) & 1), DTid.y);
+    if (!IsInsideGrid(cell, Resolution))
+    {
+        return;
+    }
+
+    float neighbourCount;
+    const float neighbourSum = SumNeighbours(solution, cell, neighbourCount);
+    solution[cell] = (neighbourSum - rhs[cell]) / neighbourCount;
+}
+
+// A thread per coarse cell: its right hand side is the sum of the residuals of its 2x2 fine cells, its solution starts from 0
+[numthreads(MULTIGRID_THREAD_GROUP_SIZE, MULTIGRID_THREAD_GROUP_SIZE, 1)]
+void CSRestrictResidual(uint3 DTid : SV_DispatchThreadID)
+{
+    RWTexture2D<float> solution = ResourceDescriptorHeap[BindlessIndexSolutionTex];
+    RWTexture2D<float> rhs = ResourceDescriptorHeap[BindlessIndexRhsTex];
+    RWTexture2D<float> coarseSolution = ResourceDescriptorHeap[BindlessIndexCoarseSolutionTex];
+    RWTexture2D<float> coarseRhs = ResourceDescriptorHeap[BindlessIndexCoarseRhsTex];
+
+    const int2 coarseCell = int2(DTid.xy);
+    if (!IsInsideGrid(coarseCell, Resolution / 2))
+    {
+        return;
+    }
+
+    float residualSum = 0.f;
+    [unroll]
+    for (int childIdx = 0; childIdx < 4; ++childIdx)
+    {
+        residualSum += ComputeResidual(solution, rhs, coarseCell * 2 + int2(childIdx & 1, childIdx >> 1));
+    }
+    coarseRhs[coarseCell] = residualSum;
+    coarseSolution[coarseCell] = 0.f;
+}
+
+// A thread per fine cell: adds the bilinear interpolation of the coarse correction, clamped at the edges
+[numthreads(MULTIGRID_THREAD_GROUP_SIZE, MULTIGRID_THREAD_GROUP_SIZE, 1)]
+void CSProlongate(uint3 DTid : SV_DispatchThreadID)
+{
+    RWTexture2D<float> solution = ResourceDescriptorHeap[BindlessIndexSolutionTex];
+    RWTexture2D<float> coarseSolution = ResourceDescriptorHeap[BindlessIndexCoarseSolutionTex];
+
+    const int2 cell = int2(DTid.xy);
+    if (!IsInsideGrid(cell, Resolution))
+    {
+        return;
+    }
+
+    // Fine cell centres sit a quarter of a coarse cell from the nearest coarse centre, the far one is on the side of the odd cells
+    const int2 nearCell = cell / 2;
+    const int2 farCell = clamp(nearCell + (cell & 1) * 2 - 1, 0, Resolution / 2 - 1);
+    const float correction =
+        0.5625f * coarseSolution[nearCell] +
+        0.1875f * (coarseSolution[int2(farCell.x, nearCell.y)] + coarseSolution[int2(nearCell.x, farCell.y)]) +
+        0.0625f * coarseSolution[farCell];
+    solution[cell] += correction;
+}
+
+groupshared float gs_coarsestSolution[MULTIGRID_COARSEST_RESOLUTION * MULTIGRID_COARSEST_RESOLUTION];
+
+// A single group: SweepCount red-black sweeps of the coarsest level, in groupshared memory
+[numthreads(MULTIGRID_COARSEST_RESOLUTION, MULTIGRID_COARSEST_RESOLUTION, 1)]
+void CSSolveCoarsest(uint3 GTid : SV_GroupThreadID)
+{
+    RWTexture2D<float> solution = ResourceDescriptorHeap[BindlessIndexSolutionTex];
+    RWTexture2D<float> rhs = ResourceDescriptorHeap[BindlessIndexRhsTex];
+
+    const int2 cell = int2(GTid.xy);
+    const uint cellIdx = cell.y * MULTIGRID_COARSEST_RESOLUTION + cell.x;
+    gs_coarsestSolution[cellIdx] = solution[cell];
+    const float cellRhs = rhs[cell];
+
+    // The neighbour count doesn't change from one sweep to the next
+    const int2 offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+    float neighbourCount = 0.f;
+    [unroll]
+    for (int offsetIdx = 0; offsetIdx < 4; ++offsetIdx)
+    {
+        neighbourCount += IsInsideGrid(cell + offsets[offsetIdx], MULTIGRID_COARSEST_RESOLUTION) ? 1.f : 0.f;
+    }
+    const uint cellParity = (cell.x + cell.y) & 1;
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint colourPassIdx = 0; colourPassIdx < SweepCount * 2; ++colourPassIdx)
+    {
+        if (cellParity == (colourPassIdx & 1))
+        {
+            float neighbourSum = 0.f;
+            [unroll]
+            for (int offsetIdx = 0; offsetIdx < 4; ++offsetIdx)
+            {
+                const int2 neighbour = cell + offsets[offsetIdx];
+                if (IsInsideGrid(neighbour, MULTIGRID_COARSEST_RESOLUTION))
+                {
+                    neighbourSum += gs_coarsestSolution[neighbour.y * MULTIGRID_COARSEST_RESOLUTION + neighbour.x];
+                }
+            }
+            gs_coarsestSolution[cellIdx] = (neighbourSum - cellRhs) / neighbourCount;
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    solution[cell] = gs_coarsestSolution[cellIdx];
+}
@@ -1,5 +1,17 @@
-#define THREAD_GROUP_SIZE_X 32
-#define THREAD_GROUP_SIZE_Y 32
+// Subtracts the pressure gradient from the velocity. The boundaries are folded in rather than fixed up by passes of their own:
+// - the pressure's edge ring reads as its inner neighbour, zero gradient across the walls
+// - the velocity's edge ring is the reflection of the projected velocity of the cell inside it, its normal component flipped
+// The pressure taps read a groupshared tile of the group's cells & their ghost cells.
+
+// Permutation defines, ComputePassFluidSim2D::SimSettings::ThreadGroupSize
+#ifndef THREAD_GROUP_SIZE_X
+#define THREAD_GROUP_SIZE_X 16
+#endif
+#ifndef THREAD_GROUP_SIZE_Y
+#define THREAD_GROUP_SIZE_Y 16
+#endif
+#define TILE_SIZE_X (THREAD_GROUP_SIZE_X + 2) // 1 ghost cell on each side
+#define TILE_SIZE_Y (THREAD_GROUP_SIZE_Y + 2)
 
 Texture2D<float2> velocityTexIn : register(t0);
 Texture2D<float> pressureTex : register(t1);
@@ -10,55 +22,47 @@ cbuffer BindlessRenderResources : register(b0)
     int GridResolution;
 }
 
-int2 SafeCoord(int2 coord)
+int2 InnerCoord(int2 coord)
 {
-    return int2(clamp(coord.x, 0, GridResolution - 1), clamp(coord.y, 0, GridResolution - 1));
+    return int2(clamp(coord.x, 1, GridResolution - 2), clamp(coord.y, 1, GridResolution - 2));
 }
 
-[numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, 1)]
-void CSMain(uint3 DTid : SV_DispatchThreadID)
+groupshared float gs_pressureTile[TILE_SIZE_X * TILE_SIZE_Y];
+
+float LoadTilePressure(int2 tileCell)
 {
-    const float cellSize = 1.f / GridResolution;
-    const float2 currentVelocity = velocityTexIn[DTid.xy];
-    
-    int2 coord = int2(DTid.xy);
-    
-    const float p_up = pressureTex[SafeCoord(coord + int2(0, -1))];
-    const float p_down = pressureTex[SafeCoord(coord + int2(0, 1))];
-    const float p_right = pressureTex[SafeCoord(coord + int2(1, 0))];
-    const float p_left = pressureTex[SafeCoord(coord + int2(-1, 0))];
-    
-    const float cellSpacing = 1.f / (2.f * cellSize);
-    const float2 pressureGradient = float2(p_right - p_left, p_up - p_down) * 0.5 * cellSpacing;
-    
-    const float2 newVelocity = currentVelocity - pressureGradient;
-    
-    velocityTexOut[DTid.xy] = newVelocity;
+    return gs_pressureTile[tileCell.y * TILE_SIZE_X + tileCell.x];
 }
 
-//Done after projection
 [numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, 1)]
-void CSMain_ReflectEdgeVelocity(uint3 DTid : SV_DispatchThreadID)
+void CSMain(uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
 {
-    // reflect velocity at the edges
-    float2 velocity = velocityTexOut[DTid.xy];
-    if (DTid.x == 0)
-    {
-        velocity = float2(-1.f, 1.f) * velocityTexOut[uint2(1, DTid.y)];
-    }
-    else if (DTid.x == GridResolution - 1)
+    const int2 tileOrigin = int2(Gid.xy) * int2(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y) - 1;
+    for (uint tileIdx = GTid.y * THREAD_GROUP_SIZE_X + GTid.x; tileIdx < TILE_SIZE_X * TILE_SIZE_Y; tileIdx += THREAD_GROUP_SIZE_X * THREAD_GROUP_SIZE_Y)
     {
-        velocity = float2(-1.f, 1.f) * velocityTexOut[uint2(GridResolution - 2, DTid.y)];
+        gs_pressureTile[tileIdx] = pressureTex[InnerCoord(tileOrigin + int2(tileIdx % TILE_SIZE_X, tileIdx / TILE_SIZE_X))];
     }
+    GroupMemoryBarrierWithGroupSync();
 
-    if (DTid.y == 0)
-    {
-        velocity = float2(1.f, -1.f) * velocityTexOut[uint2(DTid.x, 1)];
-    }
-    else if (DTid.y == GridResolution - 1)
-    {
-        velocity = float2(1.f, -1.f) * velocityTexOut[uint2(DTid.x, GridResolution - 2)];
-    }
+    // Edge cells project the cell inside them, which is in the same group
+    const int2 coord = int2(DTid.xy);
+    const int2 sourceCoord = InnerCoord(coord);
+    const int2 sourceTileCell = int2(GTid.xy) + 1 + (sourceCoord - coord);
+
+    const float cellSize = 1.f / GridResolution;
+    const float2 currentVelocity = velocityTexIn[sourceCoord];
+
+    const float p_up = LoadTilePressure(sourceTileCell + int2(0, -1));
+    const float p_down = LoadTilePressure(sourceTileCell + int2(0, 1));
+    const float p_right = LoadTilePressure(sourceTileCell + int2(1, 0));
+    const float p_left = LoadTilePressure(sourceTileCell + int2(-1, 0));
 
-    velocityTexOut[DTid.xy] = velocity;
-}
\ No newline at end of file
+    const float cellSpacing = 1.f / (2.f * cellSize);
+    const float2 pressureGradient = float2(p_right - p_left, p_up - p_down) * 0.5 * cellSpacing;
+
+    const float2 newVelocity = currentVelocity - pressureGradient;
+
+    // Reflected at the edges: the x component flips on the left & right ones, the y component on the top & bottom ones
+    const float2 reflection = float2(coord.x == sourceCoord.x ? 1.f : -1.f, coord.y == sourceCoord.y ? 1.f : -1.f);
+    velocityTexOut[coord] = reflection * newVelocity;
+}
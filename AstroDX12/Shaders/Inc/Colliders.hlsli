@@ -0,0 +1,207 @@
+#pragma once
+
+// Scene colliders & their uniform grid broadphase, built & uploaded by the CPU.
+// Colliders::ColliderSet / ColliderGrid (Src/Simulation/ColliderSet.h) are the CPU reference, keep both in sync.
+
+// Keep in sync with Colliders::ColliderShape
+#define COLLIDER_SHAPE_SPHERE 0
+#define COLLIDER_SHAPE_CAPSULE 1
+#define COLLIDER_SHAPE_BOX 2
+#define COLLIDER_SHAPE_SDF 3
+
+struct Collider
+{
+    float3 Center;
+    uint Shape;
+    float3 Extents; // Capsule: half segment, in world space. Box & SDF: half size, in local space
+    float Radius; // Sphere & Capsule. Box: rounding
+    float4 Rotation; // Box & SDF: local to world, quaternion xyzw
+    uint3 SdfResolution; // SDF: samples per axis, spanning [-Extents, Extents]
+    uint SdfFirstSample; // SDF: its first sample in the SDF sample buffer, x fastest, then y, then z
+};
+
+struct ColliderGridDesc
+{
+    float3 Origin;
+    float CellSize;
+    uint3 CellCount;
+    uint ColliderCount;
+};
+
+// Bindless indices of the collider buffers, plus the grid they were built with
+struct ColliderScene
+{
+    int ColliderBufferIndex;
+    int CellStartsBufferIndex; // Cell count + 1 entries: the colliders of cell i are ColliderIndices[CellStarts[i], CellStarts[i + 1])
+    int ColliderIndicesBufferIndex;
+    int SdfSamplesBufferIndex;
+    ColliderGridDesc Grid;
+};
+
+ColliderScene LoadColliderScene(int colliderBufferIndex, int gridDescBufferIndex, int cellStartsBufferIndex, int colliderIndicesBufferIndex, int sdfSamplesBufferIndex)
+{
+    StructuredBuffer<ColliderGridDesc> gridDescBuffer = ResourceDescriptorHeap[gridDescBufferIndex];
+
+    ColliderScene scene;
+    scene.ColliderBufferIndex = colliderBufferIndex;
+    scene.CellStartsBufferIndex = cellStartsBufferIndex;
+    scene.ColliderIndicesBufferIndex = colliderIndicesBufferIndex;
+    scene.SdfSamplesBufferIndex = sdfSamplesBufferIndex;
+    scene.Grid = gridDescBuffer[0];
+    return scene;
+}
+
+float3 RotateByQuaternion(float4 q, float3 v)
+{
+    const float3 t = 2.f * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+float3 InverseRotateByQuaternion(float4 q, float3 v)
+{
+    return RotateByQuaternion(float4(-q.xyz, q.w), v);
+}
+
+// World space half size of the collider's bounds
+float3 GetColliderBoundsHalfSize(Collider collider)
+{
+    float3 localHalfSize = collider.Extents;
+    switch (collider.Shape)
+    {
+    case COLLIDER_SHAPE_SPHERE:
+        return collider.Radius.xxx;
+    case COLLIDER_SHAPE_CAPSULE:
+        return abs(collider.Extents) + collider.Radius.xxx;
+    case COLLIDER_SHAPE_BOX:
+        localHalfSize += collider.Radius.xxx;
+        break;
+    }
+    return abs(RotateByQuaternion(collider.Rotation, float3(localHalfSize.x, 0.f, 0.f)))
+        + abs(RotateByQuaternion(collider.Rotation, float3(0.f, localHalfSize.y, 0.f)))
+        + abs(RotateByQuaternion(collider.Rotation, float3(0.f, 0.f, localHalfSize.z)));
+}
+
+// Trilinear, localPos clamped to the volume
+float SampleColliderSdf(Collider collider, StructuredBuffer<float> sdfSamples, float3 localPos)
+{
+    const float3 lastSample = float3(collider.SdfResolution - 1);
+    const float3 coord = clamp((localPos + collider.Extents) / (2.f * collider.Extents) * lastSample, 0.f, lastSample);
+    const uint3 cell = min(uint3(coord), collider.SdfResolution - 2);
+    const float3 weight = coord - float3(cell);
+
+    float result = 0.f;
+    [unroll]
+    for (uint corner = 0; corner < 8; ++corner)
+    {
+        const uint3 offset = uint3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+        const float3 axisWeights = lerp(1.f - weight, weight, float3(offset));
+        const uint3 sampleCoord = cell + offset;
+        const uint sampleIdx = collider.SdfFirstSample + (sampleCoord.z * collider.SdfResolution.y + sampleCoord.y) * collider.SdfResolution.x + sampleCoord.x;
+        result += axisWeights.x * axisWeights.y * axisWeights.z * sdfSamples[sampleIdx];
+    }
+    return result;
+}
+
+// Pushes pos along toPos until it is contactDistance away from the closest point, if closer
+float3 PushOutOfCollider(float3 pos, float3 toPos, float distance, float contactDistance)
+{
+    const float penetration = contactDistance - distance;
+    if (penetration <= 0.f || distance < 1e-6f)
+    {
+        return pos;
+    }
+    return pos + toPos * (penetration / distance);
+}
+
+// Moves a node of radius nodeRadius at pos out of the collider
+void ResolveCollision(inout float3 pos, float nodeRadius, Collider collider, StructuredBuffer<float> sdfSamples)
+{
+    switch (collider.Shape)
+    {
+    case COLLIDER_SHAPE_SPHERE:
+    {
+        const float3 toPos = pos - collider.Center;
+        pos = PushOutOfCollider(pos, toPos, length(toPos), collider.Radius + nodeRadius);
+        break;
+    }
+    case COLLIDER_SHAPE_CAPSULE:
+    {
+        const float3 segmentStart = collider.Center - collider.Extents;
+        const float segmentLengthSqr = 4.f * dot(collider.Extents, collider.Extents);
+        const float t = segmentLengthSqr > 0.f ? saturate(dot(pos - segmentStart, collider.Extents * 2.f) / segmentLengthSqr) : 0.f;
+        const float3 toPos = pos - (segmentStart + collider.Extents * (2.f * t));
+        pos = PushOutOfCollider(pos, toPos, length(toPos), collider.Radius + nodeRadius);
+        break;
+    }
+    case COLLIDER_SHAPE_BOX:
+    {
+        const float3 localPos = InverseRotateByQuaternion(collider.Rotation, pos - collider.Center);
+        const float3 toPos = localPos - clamp(localPos, -collider.Extents, collider.Extents);
+        const float distance = length(toPos);
+        if (distance > 1e-6f)
+        {
+            // Only the push goes through the rotation, a node left untouched doesn't pick up its rounding
+            pos += RotateByQuaternion(collider.Rotation, PushOutOfCollider(localPos, toPos, distance, collider.Radius + nodeRadius) - localPos);
+            break;
+        }
+
+        // Inside: out through the closest face
+        const float3 faceDistances = collider.Extents - abs(localPos);
+        uint faceAxis = faceDistances.y < faceDistances.x ? 1 : 0;
+        faceAxis = faceDistances.z < faceDistances[faceAxis] ? 2 : faceAxis;
+        float3 localPush = 0.f;
+        localPush[faceAxis] = (localPos[faceAxis] < 0.f ? -1.f : 1.f) * (faceDistances[faceAxis] + collider.Radius + nodeRadius);
+        pos += RotateByQuaternion(collider.Rotation, localPush);
+        break;
+    }
+    case COLLIDER_SHAPE_SDF:
+    {
+        const float3 localPos = InverseRotateByQuaternion(collider.Rotation, pos - collider.Center);
+        const float3 clampedPos = clamp(localPos, -collider.Extents, collider.Extents);
+
+        // Outside the volume, the distance to it is added to the distance sampled on its boundary
+        const float distance = SampleColliderSdf(collider, sdfSamples, clampedPos) + length(localPos - clampedPos);
+        const float penetration = nodeRadius - distance;
+        if (penetration <= 0.f)
+        {
+            break;
+        }
+
+        // Central differences, one sample apart
+        const float3 sampleSpacing = 2.f * collider.Extents / float3(collider.SdfResolution - 1);
+        const float3 gradient = float3(
+            SampleColliderSdf(collider, sdfSamples, clampedPos + float3(sampleSpacing.x, 0.f, 0.f)) - SampleColliderSdf(collider, sdfSamples, clampedPos - float3(sampleSpacing.x, 0.f, 0.f)),
+            SampleColliderSdf(collider, sdfSamples, clampedPos + float3(0.f, sampleSpacing.y, 0.f)) - SampleColliderSdf(collider, sdfSamples, clampedPos - float3(0.f, sampleSpacing.y, 0.f)),
+            SampleColliderSdf(collider, sdfSamples, clampedPos + float3(0.f, 0.f, sampleSpacing.z)) - SampleColliderSdf(collider, sdfSamples, clampedPos - float3(0.f, 0.f, sampleSpacing.z)));
+        const float gradientLength = length(gradient);
+        if (gradientLength >= 1e-6f)
+        {
+            pos += RotateByQuaternion(collider.Rotation, gradient * (penetration / gradientLength));
+        }
+        break;
+    }
+    }
+}
+
+// Collides a node against the colliders of its grid cell, in collider order. Outside the grid there is nothing to collide with.
+void ResolveCollisions(inout float3 pos, float nodeRadius, ColliderScene scene)
+{
+    const float3 cellCoord = floor((pos - scene.Grid.Origin) / scene.Grid.CellSize);
+    if (scene.Grid.ColliderCount == 0 || any(cellCoord < 0.f) || any(cellCoord >= float3(scene.Grid.CellCount)))
+    {
+        return;
+    }
+
+    StructuredBuffer<Collider> colliders = ResourceDescriptorHeap[scene.ColliderBufferIndex];
+    StructuredBuffer<uint> cellStarts = ResourceDescriptorHeap[scene.CellStartsBufferIndex];
+    StructuredBuffer<uint> colliderIndices = ResourceDescriptorHeap[scene.ColliderIndicesBufferIndex];
+    StructuredBuffer<float> sdfSamples = ResourceDescriptorHeap[scene.SdfSamplesBufferIndex];
+
+    const uint3 cell = uint3(cellCoord);
+    const uint cellIdx = (cell.z * scene.Grid.CellCount.y + cell.y) * scene.Grid.CellCount.x + cell.x;
+    const uint entryEnd = cellStarts[cellIdx + 1];
+    for (uint entryIdx = cellStarts[cellIdx]; entryIdx < entryEnd; ++entryIdx)
+    {
+        ResolveCollision(pos, nodeRadius, colliders[colliderIndices[entryIdx]], sdfSamples);
+    }
+}
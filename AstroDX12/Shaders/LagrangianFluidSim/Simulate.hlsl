@@ -9,12 +9,46 @@
 
 #define MAX_PARTICLES_PER_CELL 8
 
+// Sparse grids, PicFlipBricks (Src/Simulation/PicFlipBricks.h) is the CPU reference. The grid passes dispatch a group per active brick.
+#define PICFLIP_BRICK_SIZE 8
+#define PICFLIP_BRICK_NODE_COUNT (PICFLIP_BRICK_SIZE * PICFLIP_BRICK_SIZE * PICFLIP_BRICK_SIZE)
+#define PICFLIP_BRICK_POOL_ROW_BRICK_COUNT 256 // Bricks per row of the pool textures, ComputePassPicFlip3D's BrickPoolRowBrickCount
+#define INVALID_BRICK_SLOT 0xFFFFFFFF
+
+// Pressure solve, PicFlipPressure (Src/Simulation/PicFlipPressure.h) is the CPU reference. Keep in sync with PicFlipPressure::Preconditioner.
+#define PICFLIP_PRESSURE_PRECONDITIONER_JACOBI 0
+#define PICFLIP_PRESSURE_PRECONDITIONER_INCOMPLETE_POISSON 1
+#ifndef PICFLIP_PRESSURE_PRECONDITIONER
+#define PICFLIP_PRESSURE_PRECONDITIONER PICFLIP_PRESSURE_PRECONDITIONER_INCOMPLETE_POISSON
+#endif
+
+// Keep in sync with PicFlip::ParticleData & PicFlipTransfer::Particle
 struct ParticleData
 {
     float3 Pos;
     float3 Vel;
 };
 
+// Keep in sync with PicFlip::IndirectArgs, one ExecuteIndirect per member
+struct IndirectArgs
+{
+    uint3 Bricks; // A group per active brick
+    uint3 PressureSolve; // The same, until the solve converges: 0 groups then
+};
+
+// Keep in sync with PicFlip::PressureSolveState
+struct PressureSolveState
+{
+    float ResidualDotPreconditioned;
+    float Alpha;
+    float Beta;
+    float ResidualSqThreshold;
+    uint IterationCount;
+    uint ActiveBrickCount;
+    uint Converged;
+    float ResidualSq;
+};
+
 cbuffer BindlessRenderResources : register(b0)
 {
     int indexParticleInputBuffer;
@@ -38,6 +72,42 @@ cbuffer BindlessRenderResources : register(b0)
     
     int3 pressureGridExtents;
     int particleCount;
+
+    // Particle to grid transfer, PicFlipTransfer (Src/Simulation/PicFlipTransfer.h) is the CPU reference
+    int indexParticleCellKeysBuffer;
+    int indexParticleSortedIndicesBuffer;
+    int indexCellParticleStartBuffer;
+    int indexCellParticleEndBuffer;
+
+    float3 gridInvCellSize; // Multiplied by rather than divided by, the GPU's division isn't exact
+    uint pad3;
+
+    // Sparse grids: per brick of the top level grid, then per pool slot
+    int indexBrickOccupancyBuffer;
+    int indexBrickActiveFlagsBuffer;
+    int indexBrickSlotsBuffer;
+    int indexActiveBricksBuffer;
+
+    uint3 brickGridResolution;
+    uint brickPoolCapacity;
+
+    int indexIndirectArgsBuffer;
+    uint3 pad4;
+
+    // Pressure solve, per cell of the active bricks by pool slot
+    int indexPressureDiagonalBuffer;
+    int indexPcgResidualBuffer;
+    int indexPcgPreconditionedBuffer;
+    int indexPcgSearchDirectionBuffer;
+
+    int indexPcgLaplacianDirectionBuffer;
+    int indexPcgPreconditionerTempBuffer;
+    int indexPcgBrickPartialsBuffer; // Per slot, the brick's terms of the dot products
+    int indexPressureSolveStateBuffer;
+
+    float pressureRelativeTolerance;
+    float pressureAbsoluteTolerance;
+    uint2 pad5;
 }
 
 struct DebugLineVertex
@@ -261,46 +331,6 @@ void DebugDrawCellBoundaryCenter(float3 cellPos, float3 gridCellHalfSize)
     }
 }
 
-struct ParticleGridData
-{
-    uint3 baseCellIndexH; // Horizontal
-    uint3 baseCellIndexV; // Vertical
-    uint3 baseCellIndexD; // Depth
-    float3 weightH;
-    float3 weightV;
-    float3 weightD;
-};
-
-ParticleGridData CalculateParticleGridData(float3 particlePos, float3 gridLowerEndCorner, float3 gridCellSize)
-{
-    ParticleGridData results;
-
-    float3 localPos = particlePos - gridLowerEndCorner;
-    
-    // We apply an offset of a half cell, to find the bottom left back cell which the particle will splat it's velocity into.
-    // the other cells are +1 in each direction & the diagonal.
- 
-    // Horizontal offset
-    float3 cellIndexF = (localPos - float3(gridCellSize.x * .5f, 0.f, 0.f)) / gridCellSize;
-    uint3 cellIndex = (uint3) floor(cellIndexF);
-    results.baseCellIndexH = cellIndex;
-    results.weightH = cellIndexF - cellIndex;
-    
-    // Vertical offset
-    cellIndexF = (localPos - float3(0.f, gridCellSize.y * .5f, 0.f)) / gridCellSize;
-    cellIndex = (uint3) floor(cellIndexF);
-    results.baseCellIndexV = cellIndex;
-    results.weightV = cellIndexF - cellIndex;
-    
-    // Depth offset
-    cellIndexF = (localPos - float3(0.f, 0.f, gridCellSize.z * .5f)) / gridCellSize;
-    cellIndex = (uint3) floor(cellIndexF);
-    results.baseCellIndexD = cellIndex;
-    results.weightD = cellIndexF - cellIndex;
-    
-    return results;
-}
-
 [numthreads(PRESSUREGRID_THREAD_GROUP_SIZE_X, PRESSUREGRID_THREAD_GROUP_SIZE_Y, PRESSUREGRID_THREAD_GROUP_SIZE_Z)]
 void DebugDrawGrid(uint3 DTid : SV_DispatchThreadID)
 {
@@ -325,94 +355,657 @@ void DebugDrawGrid(uint3 DTid : SV_DispatchThreadID)
     
 }
 
-void Splat(RWTexture3D<float3> velocityGrid, uint3 baseCellIndex, float3 weight, float VelocityComponent)
+// Particle to grid transfer: the particles are sorted by cell, then every velocity node gathers the particles of the cells around it.
+// No atomics & the same sums every run, matching PicFlipTransfer's bit for bit: the float operations are precise & in the same order.
+// Velocities are staggered (MAC): component c of node n is on the face of cell n facing -c.
+// Only the active bricks' cells & nodes are processed: particles are only near them, the other nodes' velocities would be 0.
+
+// Position in cell units, clamped to the grid
+float3 GetCellSpacePosition(float3 particlePos)
+{
+    precise const float3 cellSpacePos = (particlePos - float3(gridPosition)) * gridInvCellSize;
+    return clamp(cellSpacePos, (float3) 0.f, float3(pressureGridResolution));
+}
+
+uint GetBrickIdx(uint3 brick)
+{
+    return brick.x + brickGridResolution.x * (brick.y + brickGridResolution.y * brick.z);
+}
+
+uint GetBrickLocalIdx(uint3 node)
+{
+    const uint3 localNode = node % PICFLIP_BRICK_SIZE;
+    return localNode.x + PICFLIP_BRICK_SIZE * (localNode.y + PICFLIP_BRICK_SIZE * localNode.z);
+}
+
+// Brick major: the particles of a brick are contiguous once sorted. See PicFlipBricks::BrickGrid::GetCellKey.
+uint GetCellKey(uint3 cell)
+{
+    return GetBrickIdx(cell / PICFLIP_BRICK_SIZE) * PICFLIP_BRICK_NODE_COUNT + GetBrickLocalIdx(cell);
+}
+
+uint3 GetBrickCoord(uint brickIdx)
 {
-    velocityGrid[baseCellIndex + uint3(0, 0, 0)].x = VelocityComponent * (1.f - weight.x) * (1.f - weight.y) * (1.f - weight.z);
-    velocityGrid[baseCellIndex + uint3(1, 0, 0)].x = VelocityComponent * (weight.x) * (1.f - weight.y) * (1.f - weight.z);
-    velocityGrid[baseCellIndex + uint3(0, 1, 0)].x = VelocityComponent * (1.f - weight.x) * (weight.y) * (1.f - weight.z);
-    velocityGrid[baseCellIndex + uint3(1, 1, 0)].x = VelocityComponent * (weight.x) * (weight.y) * (1.f - weight.z);
-    velocityGrid[baseCellIndex + uint3(0, 0, 1)].x = VelocityComponent * (1.f - weight.x) * (1.f - weight.y) * (weight.z);
-    velocityGrid[baseCellIndex + uint3(1, 0, 1)].x = VelocityComponent * (weight.x) * (1.f - weight.y) * (weight.z);
-    velocityGrid[baseCellIndex + uint3(0, 1, 1)].x = VelocityComponent * (1.f - weight.x) * (weight.y) * (weight.z);
-    velocityGrid[baseCellIndex + uint3(1, 1, 1)].x = VelocityComponent * (weight.x) * (weight.y) * (weight.z);
+    return uint3(brickIdx % brickGridResolution.x, (brickIdx / brickGridResolution.x) % brickGridResolution.y, brickIdx / (brickGridResolution.x * brickGridResolution.y));
 }
 
+// Texel of a brick's node in the pool textures
+uint3 GetBrickPoolTexel(uint slot, uint3 localNode)
+{
+    return uint3(slot % PICFLIP_BRICK_POOL_ROW_BRICK_COUNT, slot / PICFLIP_BRICK_POOL_ROW_BRICK_COUNT, 0) * PICFLIP_BRICK_SIZE + localNode;
+}
+
+// Trilinear weight of node along an axis, 0 when it isn't one of the 2 nodes around the sample. See PicFlipTransfer::Privates::GetNodeAxisWeight.
+float GetNodeAxisWeight(float cellSpaceCoord, int node, bool isComponentAxis)
+{
+    precise const float sampleCoord = isComponentAxis ? cellSpaceCoord : cellSpaceCoord - 0.5f;
+    precise const float baseNode = floor(sampleCoord);
+    precise const float fraction = sampleCoord - baseNode;
+    const int nodeOffset = node - int(baseNode);
+    if (nodeOffset == 0)
+    {
+        return 1.f - fraction;
+    }
+    return nodeOffset == 1 ? fraction : 0.f;
+}
 
 [numthreads(PARTICLES_THREAD_GROUP_SIZE_X, PARTICLES_THREAD_GROUP_SIZE_Y, PARTICLES_THREAD_GROUP_SIZE_Z)]
-void SplatParticlesToGrid(uint3 DTid : SV_DispatchThreadID) // Splat particle velocities to the grid.
+void ComputeParticleCellKeys(uint3 DTid : SV_DispatchThreadID)
 {
     if (DTid.x >= particleCount)
     {
         return;
     }
-    
-    //Texture3D<float> pressureGridIn = ResourceDescriptorHeap[indexPressureGridInputIndex];
-    RWTexture3D<float> pressureGridOut = ResourceDescriptorHeap[indexPressureGridOutputIndex];
-    RWTexture3D<float3> velocityGridOut = ResourceDescriptorHeap[indexVelocityGridOutputIndex];
-    
-    
+
     StructuredBuffer<ParticleData> particlesBufferIn = ResourceDescriptorHeap[indexParticleInputBuffer];
-    //RWStructuredBuffer<ParticleData> particlesBufferOut = ResourceDescriptorHeap[indexParticleOutputBuffer];
-    
-    
-    float3 extents = float3(pressureGridExtents);
-    float3 gridPos = float3(gridPosition); // origin is left-botom-back of the grid in world space
-    const float3 gridCellSize = extents / pressureGridResolution;
-    //const float3 gridCellHalfSize = gridCellSize * 0.5f;
-    //const float3 cellPos = gridPos + (DTid * gridCellSize) + gridCellHalfSize; // centered pos
-    
-    float3 fakeParticlePos = gridPos + (gridCellSize * float3(0.6f,0.6f,0.6f));
-    ParticleGridData pgd = CalculateParticleGridData( fakeParticlePos, gridPos, gridCellSize);
-    //ParticleGridData particleGridData = CalculateParticleGridData(particlesBufferIn[DTid.x].Pos, gridPos, gridCellSize);
-    
-    // There's 1 more cell in each direction in the velocity grid than the pressure grid.
-    // we want to write the component wise velocity paramters of the particles to the 8 nearest velocity grid cells, 
-    // weighted by baricentric weights. 
-    
-    //We will then normalize by the total weight contributed to each cell in a separate pass. - will we?
-    float3 particleVel = particlesBufferIn[DTid.x].Vel;
-    // Splat Horizontal
-    Splat(velocityGridOut, pgd.baseCellIndexH, pgd.weightH, particleVel.x);
-    //Splat(velocityGridOut, pgd.baseCellIndexV, pgd.weightV, particleVel.y);
-    //Splat(velocityGridOut, pgd.baseCellIndexD, pgd.weightD, particleVel.z);
-    
-    //float3 velX = particleVel.x;
-    //velocityGridOut[pgd.baseCellIndexH + uint3(0, 0, 0)].x = velX * (1.f - pgd.weightH.x) * (1.f - pgd.weightH.y) * (1.f - pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(1, 0, 0)].x = velX * (pgd.weightH.x) * (1.f - pgd.weightH.y) * (1.f - pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(0, 1, 0)].x = velX * (1.f - pgd.weightH.x) * (pgd.weightH.y) * (1.f - pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(1, 1, 0)].x = velX * (pgd.weightH.x) * (pgd.weightH.y) * (1.f - pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(0, 0, 1)].x = velX * (1.f - pgd.weightH.x) * (1.f - pgd.weightH.y) * (pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(1, 0, 1)].x = velX * (pgd.weightH.x) * (1.f - pgd.weightH.y) * (pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(0, 1, 1)].x = velX * (1.f - pgd.weightH.x) * (pgd.weightH.y) * (pgd.weightH.z);
-    //velocityGridOut[pgd.baseCellIndexH + uint3(1, 1, 1)].x = velX * (pgd.weightH.x) * (pgd.weightH.y) * (pgd.weightH.z);
-    
-    
-    // Test
-    float FakePressure = 1.f;
-    
-    pressureGridOut[pgd.baseCellIndexH] = FakePressure;// * pgd.baricentricWeights.x * pgd.baricentricWeights.y * pgd.baricentricWeights.z;
-    
-    // There's going to be overwrites this way - we need to use atomic operations probably... although that will be slow...
-    
+    RWStructuredBuffer<uint> cellKeys = ResourceDescriptorHeap[indexParticleCellKeysBuffer];
+    RWStructuredBuffer<uint> sortedIndices = ResourceDescriptorHeap[indexParticleSortedIndicesBuffer];
+
+    RWStructuredBuffer<uint> brickOccupancy = ResourceDescriptorHeap[indexBrickOccupancyBuffer];
+
+    const uint3 cell = min((uint3) GetCellSpacePosition(particlesBufferIn[DTid.x].Pos), pressureGridResolution - (uint3) 1);
+    cellKeys[DTid.x] = GetCellKey(cell);
+    sortedIndices[DTid.x] = DTid.x; // Moved along with the keys by the radix sort
+    brickOccupancy[GetBrickIdx(cell / PICFLIP_BRICK_SIZE)] = 1; // Same value from every particle of the brick, no atomic needed
 }
 
-[numthreads(PRESSUREGRID_THREAD_GROUP_SIZE_X, PRESSUREGRID_THREAD_GROUP_SIZE_Y, PRESSUREGRID_THREAD_GROUP_SIZE_Z)]
-void ComputeGridDivergence(uint3 DTid : SV_DispatchThreadID)
+// Brick activation, a thread per brick of the top level grid
+
+[numthreads(PARTICLES_THREAD_GROUP_SIZE_X, PARTICLES_THREAD_GROUP_SIZE_Y, PARTICLES_THREAD_GROUP_SIZE_Z)]
+void ClearBrickOccupancy(uint3 DTid : SV_DispatchThreadID)
 {
-    //if (any(DTid >= velocityGridResolution))
-    //{
-    //    return;
-    //}
+    const uint3 brickGridSize = brickGridResolution;
+    if (DTid.x >= brickGridSize.x * brickGridSize.y * brickGridSize.z)
+    {
+        return;
+    }
+
+    RWStructuredBuffer<uint> brickOccupancy = ResourceDescriptorHeap[indexBrickOccupancyBuffer];
+    brickOccupancy[DTid.x] = 0;
 }
 
+// Dilated by a brick: the nodes a particle transfers to & the air around the fluid are in its neighbours
+[numthreads(PARTICLES_THREAD_GROUP_SIZE_X, PARTICLES_THREAD_GROUP_SIZE_Y, PARTICLES_THREAD_GROUP_SIZE_Z)]
+void ActivateBricks(uint3 DTid : SV_DispatchThreadID)
+{
+    const uint3 brickGridSize = brickGridResolution;
+    if (DTid.x >= brickGridSize.x * brickGridSize.y * brickGridSize.z)
+    {
+        return;
+    }
+
+    RWStructuredBuffer<uint> brickOccupancy = ResourceDescriptorHeap[indexBrickOccupancyBuffer];
+    RWStructuredBuffer<uint> brickActiveFlags = ResourceDescriptorHeap[indexBrickActiveFlagsBuffer];
 
-[numthreads(PRESSUREGRID_THREAD_GROUP_SIZE_X, PRESSUREGRID_THREAD_GROUP_SIZE_Y, PRESSUREGRID_THREAD_GROUP_SIZE_Z)]
-void SolvePressureOnGrid(uint3 DTid : SV_DispatchThreadID)
+    const int3 brick = int3(GetBrickCoord(DTid.x));
+    const uint3 firstNeighbour = uint3(max(brick - 1, (int3) 0));
+    const uint3 lastNeighbour = min(uint3(brick) + 1, brickGridSize - (uint3) 1);
+    uint isActive = 0;
+    for (uint neighbourZ = firstNeighbour.z; neighbourZ <= lastNeighbour.z; ++neighbourZ)
+    {
+        for (uint neighbourY = firstNeighbour.y; neighbourY <= lastNeighbour.y; ++neighbourY)
+        {
+            for (uint neighbourX = firstNeighbour.x; neighbourX <= lastNeighbour.x; ++neighbourX)
+            {
+                isActive |= brickOccupancy[GetBrickIdx(uint3(neighbourX, neighbourY, neighbourZ))];
+            }
+        }
+    }
+    brickActiveFlags[DTid.x] = isActive;
+}
+
+// Run on the exclusive scan of the active flags, in place: the scanned value is the slot. Bricks past the pool's capacity get none.
+// The last brick's thread writes the group count of the grid passes' indirect dispatches.
+[numthreads(PARTICLES_THREAD_GROUP_SIZE_X, PARTICLES_THREAD_GROUP_SIZE_Y, PARTICLES_THREAD_GROUP_SIZE_Z)]
+void AssignBrickSlots(uint3 DTid : SV_DispatchThreadID)
 {
-    //if (any(DTid >= velocityGridResolution))
-    //{
-    //    return;
-    //}
+    const uint3 brickGridSize = brickGridResolution;
+    const uint brickCount = brickGridSize.x * brickGridSize.y * brickGridSize.z;
+    if (DTid.x >= brickCount)
+    {
+        return;
+    }
+
+    RWStructuredBuffer<uint> brickActiveFlags = ResourceDescriptorHeap[indexBrickActiveFlagsBuffer];
+    RWStructuredBuffer<uint> brickSlots = ResourceDescriptorHeap[indexBrickSlotsBuffer];
+    RWStructuredBuffer<uint> activeBricks = ResourceDescriptorHeap[indexActiveBricksBuffer];
+
+    const uint slot = brickSlots[DTid.x];
+    const bool isActive = brickActiveFlags[DTid.x] != 0;
+    if (isActive && slot < brickPoolCapacity)
+    {
+        activeBricks[slot] = DTid.x;
+    }
+    brickSlots[DTid.x] = isActive && slot < brickPoolCapacity ? slot : INVALID_BRICK_SLOT;
+
+    if (DTid.x == brickCount - 1)
+    {
+        RWStructuredBuffer<IndirectArgs> indirectArgs = ResourceDescriptorHeap[indexIndirectArgsBuffer];
+        RWStructuredBuffer<PressureSolveState> pressureSolveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+        const uint activeBrickCount = min(slot + (isActive ? 1 : 0), brickPoolCapacity);
+        indirectArgs[0].Bricks = uint3(activeBrickCount, 1, 1);
+        indirectArgs[0].PressureSolve = uint3(activeBrickCount, 1, 1);
+        pressureSolveState[0].ActiveBrickCount = activeBrickCount;
+    }
+}
+
+// First sorted particle whose key isn't below key
+uint LowerBoundSortedKey(RWStructuredBuffer<uint> sortedKeys, uint key)
+{
+    uint first = 0;
+    uint count = particleCount;
+    while (count > 0)
+    {
+        const uint halfCount = count / 2;
+        if (sortedKeys[first + halfCount] < key)
+        {
+            first += halfCount + 1;
+            count -= halfCount + 1;
+        }
+        else
+        {
+            count = halfCount;
+        }
+    }
+    return first;
+}
+
+// A group per active brick, the cell ranges are stored per pool slot
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void FindCellParticleRanges(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<uint> sortedKeys = ResourceDescriptorHeap[indexParticleCellKeysBuffer];
+    RWStructuredBuffer<uint> cellStart = ResourceDescriptorHeap[indexCellParticleStartBuffer];
+    RWStructuredBuffer<uint> cellEnd = ResourceDescriptorHeap[indexCellParticleEndBuffer];
+    RWStructuredBuffer<uint> activeBricks = ResourceDescriptorHeap[indexActiveBricksBuffer];
+
+    // Empty cells get start == end, nothing to clear beforehand. So do the node only ones past the last cell, no particle has their key.
+    const uint slot = Gid.x;
+    const uint cellKey = activeBricks[slot] * PICFLIP_BRICK_NODE_COUNT + GetBrickLocalIdx(GTid);
+    const uint rangeIdx = slot * PICFLIP_BRICK_NODE_COUNT + GetBrickLocalIdx(GTid);
+    cellStart[rangeIdx] = LowerBoundSortedKey(sortedKeys, cellKey);
+    cellEnd[rangeIdx] = LowerBoundSortedKey(sortedKeys, cellKey + 1);
+}
+
+// The step's particles are written sorted by cell: the gather & the grid to particle transfer read them coherently
+[numthreads(PARTICLES_THREAD_GROUP_SIZE_X, PARTICLES_THREAD_GROUP_SIZE_Y, PARTICLES_THREAD_GROUP_SIZE_Z)]
+void ReorderParticles(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= particleCount)
+    {
+        return;
+    }
+
+    StructuredBuffer<ParticleData> particlesBufferIn = ResourceDescriptorHeap[indexParticleInputBuffer];
+    RWStructuredBuffer<ParticleData> particlesBufferOut = ResourceDescriptorHeap[indexParticleOutputBuffer];
+    RWStructuredBuffer<uint> sortedIndices = ResourceDescriptorHeap[indexParticleSortedIndicesBuffer];
+
+    particlesBufferOut[DTid.x] = particlesBufferIn[sortedIndices[DTid.x]];
+}
+
+// A group per active brick, a thread per node, written to the brick's slot of the velocity pool
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void GatherParticlesToGrid(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<uint> activeBricks = ResourceDescriptorHeap[indexActiveBricksBuffer];
+    const uint slot = Gid.x;
+    const uint3 DTid = GetBrickCoord(activeBricks[slot]) * PICFLIP_BRICK_SIZE + GTid;
+    if (any(DTid >= velocityGridResolution))
+    {
+        return;
+    }
+
+    RWStructuredBuffer<ParticleData> sortedParticles = ResourceDescriptorHeap[indexParticleOutputBuffer];
+    RWStructuredBuffer<uint> cellStart = ResourceDescriptorHeap[indexCellParticleStartBuffer];
+    RWStructuredBuffer<uint> cellEnd = ResourceDescriptorHeap[indexCellParticleEndBuffer];
+    RWStructuredBuffer<uint> brickSlots = ResourceDescriptorHeap[indexBrickSlotsBuffer];
+    RWTexture3D<float3> velocityPoolOut = ResourceDescriptorHeap[indexVelocityGridOutputIndex];
+
+    const int3 node = int3(DTid);
+    precise float3 velocitySum = (float3) 0.f;
+    precise float3 weightSum = (float3) 0.f;
+
+    // Particles within a cell of any of the node's 3 samples: the 3x3x3 cells around the node's lower corner cell
+    const uint3 firstCell = uint3(max(node - 1, (int3) 0));
+    const uint3 lastCell = min(DTid + 1, pressureGridResolution - (uint3) 1);
+    for (uint cellZ = firstCell.z; cellZ <= lastCell.z; ++cellZ)
+    {
+        for (uint cellY = firstCell.y; cellY <= lastCell.y; ++cellY)
+        {
+            for (uint cellX = firstCell.x; cellX <= lastCell.x; ++cellX)
+            {
+                // The cells of the neighbour bricks without a slot have no particles, or none the pool had room for
+                const uint3 cell = uint3(cellX, cellY, cellZ);
+                const uint cellSlot = brickSlots[GetBrickIdx(cell / PICFLIP_BRICK_SIZE)];
+                if (cellSlot == INVALID_BRICK_SLOT)
+                {
+                    continue;
+                }
+                const uint rangeIdx = cellSlot * PICFLIP_BRICK_NODE_COUNT + GetBrickLocalIdx(cell);
+                for (uint sortedIdx = cellStart[rangeIdx]; sortedIdx < cellEnd[rangeIdx]; ++sortedIdx)
+                {
+                    const ParticleData particle = sortedParticles[sortedIdx];
+                    const float3 cellSpacePos = GetCellSpacePosition(particle.Pos);
+
+                    [unroll]
+                    for (uint component = 0; component < 3; ++component)
+                    {
+                        precise const float weight = GetNodeAxisWeight(cellSpacePos.x, node.x, component == 0)
+                            * GetNodeAxisWeight(cellSpacePos.y, node.y, component == 1)
+                            * GetNodeAxisWeight(cellSpacePos.z, node.z, component == 2);
+                        velocitySum[component] += weight * particle.Vel[component];
+                        weightSum[component] += weight;
+                    }
+                }
+            }
+        }
+    }
+
+    velocityPoolOut[GetBrickPoolTexel(slot, GTid)] = float3(
+        weightSum.x > 0.f ? velocitySum.x / weightSum.x : 0.f,
+        weightSum.y > 0.f ? velocitySum.y / weightSum.y : 0.f,
+        weightSum.z > 0.f ? velocitySum.z / weightSum.z : 0.f);
+}
+
+// Pressure projection: A p = -div u over the fluid cells, preconditioned conjugate gradient until the residual target.
+// The iterations are recorded up to the max count, the convergence check zeroes the PressureSolve args: the rest dispatch no groups.
+// The per brick passes are a group per active brick & a thread per cell, the dot products are summed per brick then by a single group.
+// Fluid cells have particles, air cells p = 0, the domain's walls are solid. Every vector is 0 in the air cells, so are the bricks without a slot.
+
+// Index of the cell's values, -1 past the walls or if its brick has no slot
+int GetCellValueIdx(int3 cell)
+{
+    if (any(cell < 0) || any(cell >= int3(pressureGridResolution)))
+    {
+        return -1;
+    }
+    RWStructuredBuffer<uint> brickSlots = ResourceDescriptorHeap[indexBrickSlotsBuffer];
+    const uint slot = brickSlots[GetBrickIdx(uint3(cell) / PICFLIP_BRICK_SIZE)];
+    return slot == INVALID_BRICK_SLOT ? -1 : int(slot * PICFLIP_BRICK_NODE_COUNT + GetBrickLocalIdx(uint3(cell)));
+}
+
+float LoadCellValue(RWStructuredBuffer<float> values, int3 cell)
+{
+    const int valueIdx = GetCellValueIdx(cell);
+    return valueIdx < 0 ? 0.f : values[valueIdx];
+}
+
+static const int3 PressureNeighbourOffsets[6] = { int3(-1, 0, 0), int3(0, -1, 0), int3(0, 0, -1), int3(1, 0, 0), int3(0, 1, 0), int3(0, 0, 1) };
+#define PRESSURE_LOWER_NEIGHBOUR_COUNT 3 // The first 3 of PressureNeighbourOffsets, see PicFlipPressure::Privates::NeighbourOffsets
+
+// Sum of the neighbours' values, air ones are 0: neighbours first to last excluded of PressureNeighbourOffsets
+float SumNeighbourValues(RWStructuredBuffer<float> values, int3 cell, uint neighbourFirst, uint neighbourLast)
+{
+    float sum = 0.f;
+    for (uint neighbourIdx = neighbourFirst; neighbourIdx < neighbourLast; ++neighbourIdx)
+    {
+        sum += LoadCellValue(values, cell + PressureNeighbourOffsets[neighbourIdx]);
+    }
+    return sum;
+}
+
+struct BrickCell
+{
+    uint Slot;
+    uint ValueIdx;
+    int3 Cell;
+    bool IsInGrid; // The last bricks' nodes go one further than the cells
+};
+
+BrickCell GetBrickCell(uint3 GTid, uint3 Gid)
+{
+    RWStructuredBuffer<uint> activeBricks = ResourceDescriptorHeap[indexActiveBricksBuffer];
+    BrickCell brickCell;
+    brickCell.Slot = Gid.x;
+    brickCell.ValueIdx = Gid.x * PICFLIP_BRICK_NODE_COUNT + GetBrickLocalIdx(GTid);
+    brickCell.Cell = int3(GetBrickCoord(activeBricks[Gid.x]) * PICFLIP_BRICK_SIZE + GTid);
+    brickCell.IsInGrid = all(brickCell.Cell < int3(pressureGridResolution));
+    return brickCell;
+}
+
+groupshared float2 gs_dotTerms[PICFLIP_BRICK_NODE_COUNT];
+
+// Sums the group's terms, the same tree every run: thread 0 gets the total
+float2 SumGroupTerms(uint threadIdx, float2 terms)
+{
+    gs_dotTerms[threadIdx] = terms;
+    GroupMemoryBarrierWithGroupSync();
+    [unroll]
+    for (uint stride = PICFLIP_BRICK_NODE_COUNT / 2; stride > 0; stride /= 2)
+    {
+        if (threadIdx < stride)
+        {
+            gs_dotTerms[threadIdx] += gs_dotTerms[threadIdx + stride];
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+    return gs_dotTerms[0];
+}
+
+void WriteBrickPartials(uint3 GTid, uint slot, float2 terms)
+{
+    const uint threadIdx = GetBrickLocalIdx(GTid);
+    const float2 brickSum = SumGroupTerms(threadIdx, terms);
+    if (threadIdx == 0)
+    {
+        RWStructuredBuffer<float2> brickPartials = ResourceDescriptorHeap[indexPcgBrickPartialsBuffer];
+        brickPartials[slot] = brickSum;
+    }
+}
+
+// A single group: the sum of the active bricks' partials, for thread 0
+float2 SumBrickPartials(uint threadIdx, uint activeBrickCount)
+{
+    RWStructuredBuffer<float2> brickPartials = ResourceDescriptorHeap[indexPcgBrickPartialsBuffer];
+    float2 terms = (float2) 0.f;
+    for (uint slot = threadIdx; slot < activeBrickCount; slot += PICFLIP_BRICK_NODE_COUNT)
+    {
+        terms += brickPartials[slot];
+    }
+    return SumGroupTerms(threadIdx, terms);
+}
+
+// Diagonal, right hand side, p = 0. Partials: (r.r, fluid cell count)
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void ComputeGridDivergence(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<uint> cellStart = ResourceDescriptorHeap[indexCellParticleStartBuffer];
+    RWStructuredBuffer<uint> cellEnd = ResourceDescriptorHeap[indexCellParticleEndBuffer];
+    RWStructuredBuffer<float> diagonal = ResourceDescriptorHeap[indexPressureDiagonalBuffer];
+    RWStructuredBuffer<float> residual = ResourceDescriptorHeap[indexPcgResidualBuffer];
+    RWTexture3D<float3> velocityPool = ResourceDescriptorHeap[indexVelocityGridOutputIndex];
+    RWTexture3D<float> pressurePool = ResourceDescriptorHeap[indexPressureGridOutputIndex];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const bool isFluid = brickCell.IsInGrid && cellStart[brickCell.ValueIdx] < cellEnd[brickCell.ValueIdx];
+
+    float nonSolidNeighbourCount = 0.f;
+    float divergence = 0.f;
+    if (isFluid)
+    {
+        const float3 lowerFaces = velocityPool[GetBrickPoolTexel(brickCell.Slot, GTid)];
+        [unroll]
+        for (uint component = 0; component < 3; ++component)
+        {
+            int3 upperNode = brickCell.Cell;
+            upperNode[component] += 1;
+            const int upperNodeValueIdx = GetCellValueIdx(upperNode); // Nodes share the cells' bricks & slots
+            const float upperFace = upperNode[component] == int(pressureGridResolution[component]) || upperNodeValueIdx < 0
+                ? 0.f
+                : velocityPool[GetBrickPoolTexel(uint(upperNodeValueIdx) / PICFLIP_BRICK_NODE_COUNT, uint3(upperNode) % PICFLIP_BRICK_SIZE)][component];
+            const float lowerFace = brickCell.Cell[component] == 0 ? 0.f : lowerFaces[component];
+            divergence += upperFace - lowerFace;
+
+            nonSolidNeighbourCount += (brickCell.Cell[component] > 0 ? 1.f : 0.f) + (upperNode[component] < int(pressureGridResolution[component]) ? 1.f : 0.f);
+        }
+    }
+
+    const float rhs = isFluid ? -divergence : 0.f;
+    diagonal[brickCell.ValueIdx] = isFluid ? nonSolidNeighbourCount : 0.f;
+    residual[brickCell.ValueIdx] = rhs;
+    pressurePool[GetBrickPoolTexel(brickCell.Slot, GTid)] = 0.f;
+
+    WriteBrickPartials(GTid, brickCell.Slot, float2(rhs * rhs, isFluid ? 1.f : 0.f));
+}
+
+[numthreads(PICFLIP_BRICK_NODE_COUNT, 1, 1)]
+void InitPressureSolve(uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<PressureSolveState> solveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+    const float2 sums = SumBrickPartials(GTid.x, solveState[0].ActiveBrickCount);
+    if (GTid.x == 0)
+    {
+        const float initialResidualSq = sums.x;
+        const float fluidCellCount = sums.y;
+        PressureSolveState state = solveState[0];
+        state.ResidualSqThreshold = max(
+            pressureRelativeTolerance * pressureRelativeTolerance * initialResidualSq,
+            pressureAbsoluteTolerance * pressureAbsoluteTolerance * fluidCellCount);
+        state.ResidualSq = initialResidualSq;
+        state.IterationCount = 0;
+        state.Converged = initialResidualSq <= state.ResidualSqThreshold ? 1 : 0;
+        solveState[0] = state;
+
+        if (state.Converged)
+        {
+            RWStructuredBuffer<IndirectArgs> indirectArgs = ResourceDescriptorHeap[indexIndirectArgsBuffer];
+            indirectArgs[0].PressureSolve = uint3(0, 1, 1);
+        }
+    }
+}
+
+// z = M^-1 r. Partials, from the pass which writes z: (r.z, 0)
+#if PICFLIP_PRESSURE_PRECONDITIONER == PICFLIP_PRESSURE_PRECONDITIONER_JACOBI
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void ApplyPressurePreconditioner(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> diagonalBuffer = ResourceDescriptorHeap[indexPressureDiagonalBuffer];
+    RWStructuredBuffer<float> residual = ResourceDescriptorHeap[indexPcgResidualBuffer];
+    RWStructuredBuffer<float> preconditioned = ResourceDescriptorHeap[indexPcgPreconditionedBuffer];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const float diagonal = diagonalBuffer[brickCell.ValueIdx];
+    const float r = residual[brickCell.ValueIdx];
+    const float z = diagonal > 0.f ? r / diagonal : 0.f;
+    preconditioned[brickCell.ValueIdx] = z;
+
+    WriteBrickPartials(GTid, brickCell.Slot, float2(r * z, 0.f));
+}
+#else
+// Incomplete Poisson, z = K K^T r. First t = K^T r: t_i = r_i + (sum of the upper fluid neighbours' r_j) / d_i
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void ApplyPressurePreconditionerTranspose(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> diagonalBuffer = ResourceDescriptorHeap[indexPressureDiagonalBuffer];
+    RWStructuredBuffer<float> residual = ResourceDescriptorHeap[indexPcgResidualBuffer];
+    RWStructuredBuffer<float> preconditionerTemp = ResourceDescriptorHeap[indexPcgPreconditionerTempBuffer];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const float diagonal = diagonalBuffer[brickCell.ValueIdx];
+    preconditionerTemp[brickCell.ValueIdx] = diagonal > 0.f
+        ? residual[brickCell.ValueIdx] + SumNeighbourValues(residual, brickCell.Cell, PRESSURE_LOWER_NEIGHBOUR_COUNT, 6) / diagonal
+        : 0.f;
+}
+
+// Then z = K t: z_i = t_i + sum of the lower fluid neighbours' t_j / d_j
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void ApplyPressurePreconditioner(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> diagonalBuffer = ResourceDescriptorHeap[indexPressureDiagonalBuffer];
+    RWStructuredBuffer<float> residual = ResourceDescriptorHeap[indexPcgResidualBuffer];
+    RWStructuredBuffer<float> preconditionerTemp = ResourceDescriptorHeap[indexPcgPreconditionerTempBuffer];
+    RWStructuredBuffer<float> preconditioned = ResourceDescriptorHeap[indexPcgPreconditionedBuffer];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    float z = 0.f;
+    if (diagonalBuffer[brickCell.ValueIdx] > 0.f)
+    {
+        z = preconditionerTemp[brickCell.ValueIdx];
+        for (uint neighbourIdx = 0; neighbourIdx < PRESSURE_LOWER_NEIGHBOUR_COUNT; ++neighbourIdx)
+        {
+            const int neighbourValueIdx = GetCellValueIdx(brickCell.Cell + PressureNeighbourOffsets[neighbourIdx]);
+            const float neighbourDiagonal = neighbourValueIdx < 0 ? 0.f : diagonalBuffer[neighbourValueIdx];
+            z += neighbourDiagonal > 0.f ? preconditionerTemp[neighbourValueIdx] / neighbourDiagonal : 0.f;
+        }
+    }
+    preconditioned[brickCell.ValueIdx] = z;
+
+    WriteBrickPartials(GTid, brickCell.Slot, float2(residual[brickCell.ValueIdx] * z, 0.f));
+}
+#endif
+
+// rz = r.z, beta = rz / the previous rz
+[numthreads(PICFLIP_BRICK_NODE_COUNT, 1, 1)]
+void ComputePcgBeta(uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<PressureSolveState> solveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+    if (solveState[0].Converged)
+    {
+        return; // The partials are stale
+    }
+    const float2 sums = SumBrickPartials(GTid.x, solveState[0].ActiveBrickCount);
+    if (GTid.x == 0)
+    {
+        const float residualDotPreconditioned = sums.x;
+        solveState[0].Beta = solveState[0].IterationCount > 0 ? residualDotPreconditioned / solveState[0].ResidualDotPreconditioned : 0.f;
+        solveState[0].ResidualDotPreconditioned = residualDotPreconditioned;
+    }
+}
+
+// d = z + beta d, d = z on the first iteration: d's previous values may be anything
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void UpdateSearchDirection(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> preconditioned = ResourceDescriptorHeap[indexPcgPreconditionedBuffer];
+    RWStructuredBuffer<float> searchDirection = ResourceDescriptorHeap[indexPcgSearchDirectionBuffer];
+    RWStructuredBuffer<PressureSolveState> solveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const float z = preconditioned[brickCell.ValueIdx];
+    searchDirection[brickCell.ValueIdx] = solveState[0].IterationCount > 0 ? z + solveState[0].Beta * searchDirection[brickCell.ValueIdx] : z;
+}
+
+// q = A d. Partials: (d.q, 0)
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void ApplyPressureLaplacian(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> diagonalBuffer = ResourceDescriptorHeap[indexPressureDiagonalBuffer];
+    RWStructuredBuffer<float> searchDirection = ResourceDescriptorHeap[indexPcgSearchDirectionBuffer];
+    RWStructuredBuffer<float> laplacianDirection = ResourceDescriptorHeap[indexPcgLaplacianDirectionBuffer];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const float diagonal = diagonalBuffer[brickCell.ValueIdx];
+    const float d = searchDirection[brickCell.ValueIdx];
+    const float q = diagonal > 0.f ? diagonal * d - SumNeighbourValues(searchDirection, brickCell.Cell, 0, 6) : 0.f;
+    laplacianDirection[brickCell.ValueIdx] = q;
+
+    WriteBrickPartials(GTid, brickCell.Slot, float2(d * q, 0.f));
+}
+
+// alpha = rz / d.q
+[numthreads(PICFLIP_BRICK_NODE_COUNT, 1, 1)]
+void ComputePcgAlpha(uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<PressureSolveState> solveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+    if (solveState[0].Converged)
+    {
+        return;
+    }
+    const float2 sums = SumBrickPartials(GTid.x, solveState[0].ActiveBrickCount);
+    if (GTid.x == 0)
+    {
+        solveState[0].Alpha = solveState[0].ResidualDotPreconditioned / sums.x;
+    }
+}
+
+// p += alpha d, r -= alpha q. Partials: (r.r, 0)
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void UpdatePressureResidual(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> residual = ResourceDescriptorHeap[indexPcgResidualBuffer];
+    RWStructuredBuffer<float> searchDirection = ResourceDescriptorHeap[indexPcgSearchDirectionBuffer];
+    RWStructuredBuffer<float> laplacianDirection = ResourceDescriptorHeap[indexPcgLaplacianDirectionBuffer];
+    RWStructuredBuffer<PressureSolveState> solveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+    RWTexture3D<float> pressurePool = ResourceDescriptorHeap[indexPressureGridOutputIndex];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const float alpha = solveState[0].Alpha;
+    const uint3 pressureTexel = GetBrickPoolTexel(brickCell.Slot, GTid);
+    pressurePool[pressureTexel] = pressurePool[pressureTexel] + alpha * searchDirection[brickCell.ValueIdx];
+    const float r = residual[brickCell.ValueIdx] - alpha * laplacianDirection[brickCell.ValueIdx];
+    residual[brickCell.ValueIdx] = r;
+
+    WriteBrickPartials(GTid, brickCell.Slot, float2(r * r, 0.f));
+}
+
+// Stops the solve once r.r is within the target: the following passes' args are 0 groups
+[numthreads(PICFLIP_BRICK_NODE_COUNT, 1, 1)]
+void CheckPressureConvergence(uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<PressureSolveState> solveState = ResourceDescriptorHeap[indexPressureSolveStateBuffer];
+    if (solveState[0].Converged)
+    {
+        return;
+    }
+    const float2 sums = SumBrickPartials(GTid.x, solveState[0].ActiveBrickCount);
+    if (GTid.x == 0)
+    {
+        PressureSolveState state = solveState[0];
+        state.ResidualSq = sums.x;
+        state.IterationCount += 1;
+        state.Converged = state.ResidualSq <= state.ResidualSqThreshold ? 1 : 0;
+        solveState[0] = state;
+
+        if (state.Converged)
+        {
+            RWStructuredBuffer<IndirectArgs> indirectArgs = ResourceDescriptorHeap[indexIndirectArgsBuffer];
+            indirectArgs[0].PressureSolve = uint3(0, 1, 1);
+        }
+    }
+}
+
+// Subtracts the pressure gradient from the faces next to fluid, zeroes the walls' faces. In place: typed UAV loads of R16G16B16A16_FLOAT.
+[numthreads(PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE, PICFLIP_BRICK_SIZE)]
+void ProjectVelocity(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+    RWStructuredBuffer<float> diagonalBuffer = ResourceDescriptorHeap[indexPressureDiagonalBuffer];
+    RWTexture3D<float3> velocityPool = ResourceDescriptorHeap[indexVelocityGridOutputIndex];
+    RWTexture3D<float> pressurePool = ResourceDescriptorHeap[indexPressureGridOutputIndex];
+
+    const BrickCell brickCell = GetBrickCell(GTid, Gid);
+    const int3 node = brickCell.Cell;
+    if (any(node > int3(pressureGridResolution)))
+    {
+        return;
+    }
+
+    const uint3 velocityTexel = GetBrickPoolTexel(brickCell.Slot, GTid);
+    float3 velocity = velocityPool[velocityTexel];
+    const bool upperIsFluid = brickCell.IsInGrid && diagonalBuffer[brickCell.ValueIdx] > 0.f;
+    const float upperPressure = brickCell.IsInGrid ? pressurePool[velocityTexel] : 0.f;
+    [unroll]
+    for (uint component = 0; component < 3; ++component)
+    {
+        // Walls, & the last node along the other axes which no face is at
+        if (node[component] == 0 || any(node == int3(pressureGridResolution)))
+        {
+            velocity[component] = 0.f;
+            continue;
+        }
+
+        int3 lowerCell = node;
+        lowerCell[component] -= 1;
+        const int lowerValueIdx = GetCellValueIdx(lowerCell);
+        const bool lowerIsFluid = lowerValueIdx >= 0 && diagonalBuffer[lowerValueIdx] > 0.f;
+        if (upperIsFluid || lowerIsFluid)
+        {
+            const float lowerPressure = lowerValueIdx < 0
+                ? 0.f
+                : pressurePool[GetBrickPoolTexel(uint(lowerValueIdx) / PICFLIP_BRICK_NODE_COUNT, uint3(lowerCell) % PICFLIP_BRICK_SIZE)];
+            velocity[component] -= upperPressure - lowerPressure;
+        }
+    }
+    velocityPool[velocityTexel] = velocity;
 }
 
 [numthreads(PARTICLES_THREAD_GROUP_SIZE_X, PARTICLES_THREAD_GROUP_SIZE_Y, PARTICLES_THREAD_GROUP_SIZE_Z)]
@@ -0,0 +1,301 @@
+// Reduction, exclusive prefix sum, stream compaction & key/value radix sort of uint buffers, recorded by GPUParallelPrimitives.
+// Everything works on tiles of PRIMITIVES_TILE_SIZE elements, a threadgroup per tile, each thread owning consecutive elements.
+// Arrays of more than one tile go through several levels: tile results are themselves reduced / scanned, then scattered back.
+// ParallelPrimitives (Src/Simulation/ParallelPrimitives.h) is the CPU reference, keep both in sync.
+
+cbuffer BindlessRenderResources : register(b0)
+{
+    int BindlessIndexInput;
+    int BindlessIndexOutput; // May be the input
+    int BindlessIndexTileResults; // Reduce & scan: the result of each tile, -1 when there's a single tile. Radix sort: the per digit tile offsets
+    int BindlessIndexAuxInput; // Compact: flags. Radix sort: values in
+    int BindlessIndexAuxInput2; // Compact: scanned flags
+    int BindlessIndexAuxOutput; // Compact: kept count. Radix sort: values out
+    uint ElementCount;
+    uint OpOrShift; // Reduce: REDUCE_OP_. Radix sort: bit shift of the digit sorted on
+    uint DigitMask; // Radix sort: RADIX_DIGIT_COUNT - 1, less for the last digit of keys whose bit count isn't a multiple of RADIX_DIGIT_BIT_COUNT
+}
+
+#define PRIMITIVES_THREAD_GROUP_SIZE 256
+#define PRIMITIVES_ELEMENTS_PER_THREAD 4
+#define PRIMITIVES_TILE_SIZE (PRIMITIVES_THREAD_GROUP_SIZE * PRIMITIVES_ELEMENTS_PER_THREAD)
+
+// Keep in sync with ParallelPrimitives::ReduceOp
+#define REDUCE_OP_SUM 0
+#define REDUCE_OP_MIN 1
+#define REDUCE_OP_MAX 2
+
+#define RADIX_DIGIT_BIT_COUNT 4
+#define RADIX_DIGIT_COUNT (1 << RADIX_DIGIT_BIT_COUNT)
+
+groupshared uint gs_groupValues[PRIMITIVES_THREAD_GROUP_SIZE];
+groupshared uint gs_digitCounts[RADIX_DIGIT_COUNT];
+
+uint GetReduceIdentity(uint op)
+{
+    return op == REDUCE_OP_MIN ? 0xFFFFFFFF : 0;
+}
+
+uint ApplyReduceOp(uint op, uint a, uint b)
+{
+    switch (op)
+    {
+    case REDUCE_OP_MIN:
+        return min(a, b);
+    case REDUCE_OP_MAX:
+        return max(a, b);
+    default:
+        return a + b;
+    }
+}
+
+uint GetElementIdx(uint tileIdx, uint groupThreadIdx, uint elementIdx)
+{
+    return tileIdx * PRIMITIVES_TILE_SIZE + groupThreadIdx * PRIMITIVES_ELEMENTS_PER_THREAD + elementIdx;
+}
+
+// Exclusive scan of one value per thread across the group (Hillis-Steele), groupTotal is the sum of every value
+uint GroupExclusiveScan(uint threadValue, uint groupThreadIdx, out uint groupTotal)
+{
+    gs_groupValues[groupThreadIdx] = threadValue;
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint offset = 1; offset < PRIMITIVES_THREAD_GROUP_SIZE; offset <<= 1)
+    {
+        const uint addend = groupThreadIdx >= offset ? gs_groupValues[groupThreadIdx - offset] : 0;
+        GroupMemoryBarrierWithGroupSync();
+        gs_groupValues[groupThreadIdx] += addend;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    groupTotal = gs_groupValues[PRIMITIVES_THREAD_GROUP_SIZE - 1];
+    const uint result = gs_groupValues[groupThreadIdx] - threadValue;
+    // gs_groupValues is reused by the next scan
+    GroupMemoryBarrierWithGroupSync();
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+// Reduce
+//---------------------------------------------------------------------------------------
+
+// Reduces every tile of the input to TileResults[tile], or to Output[0] when there's a single tile
+[numthreads(PRIMITIVES_THREAD_GROUP_SIZE, 1, 1)]
+void CSReduceTiles(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<uint> input = ResourceDescriptorHeap[BindlessIndexInput];
+
+    const uint op = OpOrShift;
+    uint threadResult = GetReduceIdentity(op);
+    [unroll]
+    for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+    {
+        const uint inputIdx = GetElementIdx(Gid.x, GTid.x, elementIdx);
+        if (inputIdx < ElementCount)
+        {
+            threadResult = ApplyReduceOp(op, threadResult, input[inputIdx]);
+        }
+    }
+
+    gs_groupValues[GTid.x] = threadResult;
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint stride = PRIMITIVES_THREAD_GROUP_SIZE / 2; stride > 0; stride >>= 1)
+    {
+        if (GTid.x < stride)
+        {
+            gs_groupValues[GTid.x] = ApplyReduceOp(op, gs_groupValues[GTid.x], gs_groupValues[GTid.x + stride]);
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (GTid.x == 0)
+    {
+        if (BindlessIndexTileResults >= 0)
+        {
+            RWStructuredBuffer<uint> tileResults = ResourceDescriptorHeap[BindlessIndexTileResults];
+            tileResults[Gid.x] = gs_groupValues[0];
+        }
+        else
+        {
+            RWStructuredBuffer<uint> output = ResourceDescriptorHeap[BindlessIndexOutput];
+            output[0] = gs_groupValues[0];
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Exclusive scan
+//---------------------------------------------------------------------------------------
+
+// Scans every tile on its own, the sum of each tile goes to TileResults[tile] to be scanned in turn
+[numthreads(PRIMITIVES_THREAD_GROUP_SIZE, 1, 1)]
+void CSScanTiles(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<uint> input = ResourceDescriptorHeap[BindlessIndexInput];
+    RWStructuredBuffer<uint> output = ResourceDescriptorHeap[BindlessIndexOutput];
+
+    uint values[PRIMITIVES_ELEMENTS_PER_THREAD];
+    uint threadSum = 0;
+    [unroll]
+    for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+    {
+        const uint inputIdx = GetElementIdx(Gid.x, GTid.x, elementIdx);
+        values[elementIdx] = inputIdx < ElementCount ? input[inputIdx] : 0;
+        threadSum += values[elementIdx];
+    }
+
+    uint tileSum;
+    uint sum = GroupExclusiveScan(threadSum, GTid.x, tileSum);
+    [unroll]
+    for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+    {
+        const uint outputIdx = GetElementIdx(Gid.x, GTid.x, elementIdx);
+        if (outputIdx < ElementCount)
+        {
+            output[outputIdx] = sum;
+        }
+        sum += values[elementIdx];
+    }
+
+    if (GTid.x == 0 && BindlessIndexTileResults >= 0)
+    {
+        RWStructuredBuffer<uint> tileResults = ResourceDescriptorHeap[BindlessIndexTileResults];
+        tileResults[Gid.x] = tileSum;
+    }
+}
+
+// Adds the scanned tile sums to the tiles scanned on their own
+[numthreads(PRIMITIVES_THREAD_GROUP_SIZE, 1, 1)]
+void CSAddTileOffsets(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+    RWStructuredBuffer<uint> output = ResourceDescriptorHeap[BindlessIndexOutput];
+    RWStructuredBuffer<uint> tileOffsets = ResourceDescriptorHeap[BindlessIndexTileResults];
+
+    const uint tileOffset = tileOffsets[Gid.x];
+    [unroll]
+    for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+    {
+        const uint outputIdx = GetElementIdx(Gid.x, GTid.x, elementIdx);
+        if (outputIdx < ElementCount)
+        {
+            output[outputIdx] += tileOffset;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Compaction, after the flags have been scanned
+//---------------------------------------------------------------------------------------
+
+[numthreads(PRIMITIVES_THREAD_GROUP_SIZE * PRIMITIVES_ELEMENTS_PER_THREAD, 1, 1)]
+void CSCompactScatter(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= ElementCount)
+    {
+        return;
+    }
+
+    RWStructuredBuffer<uint> values = ResourceDescriptorHeap[BindlessIndexInput];
+    RWStructuredBuffer<uint> output = ResourceDescriptorHeap[BindlessIndexOutput];
+    RWStructuredBuffer<uint> flags = ResourceDescriptorHeap[BindlessIndexAuxInput];
+    RWStructuredBuffer<uint> scannedFlags = ResourceDescriptorHeap[BindlessIndexAuxInput2];
+
+    const uint flag = flags[DTid.x];
+    const uint outputIdx = scannedFlags[DTid.x];
+    if (flag != 0)
+    {
+        output[outputIdx] = values[DTid.x];
+    }
+
+    if (DTid.x == ElementCount - 1)
+    {
+        RWStructuredBuffer<uint> keptCount = ResourceDescriptorHeap[BindlessIndexAuxOutput];
+        keptCount[0] = outputIdx + flag;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Radix sort, one pass per digit: histogram, scan of the histograms, scatter
+//---------------------------------------------------------------------------------------
+
+uint GetDigit(uint key)
+{
+    return (key >> OpOrShift) & DigitMask;
+}
+
+// TileResults[digit * tileCount + tile] = how many keys of the tile have that digit. Scanned, it's where they go.
+[numthreads(PRIMITIVES_THREAD_GROUP_SIZE, 1, 1)]
+void CSRadixHistogram(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint3 GroupCount : SV_GroupCount)
+{
+    RWStructuredBuffer<uint> keys = ResourceDescriptorHeap[BindlessIndexInput];
+    RWStructuredBuffer<uint> tileDigitCounts = ResourceDescriptorHeap[BindlessIndexTileResults];
+
+    if (GTid.x < RADIX_DIGIT_COUNT)
+    {
+        gs_digitCounts[GTid.x] = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+    {
+        const uint keyIdx = GetElementIdx(Gid.x, GTid.x, elementIdx);
+        if (keyIdx < ElementCount)
+        {
+            InterlockedAdd(gs_digitCounts[GetDigit(keys[keyIdx])], 1);
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (GTid.x < RADIX_DIGIT_COUNT)
+    {
+        tileDigitCounts[GTid.x * GroupCount.x + Gid.x] = gs_digitCounts[GTid.x];
+    }
+}
+
+// Stable: within a tile, keys of a digit keep their order as threads own consecutive keys & are ranked in thread order
+[numthreads(PRIMITIVES_THREAD_GROUP_SIZE, 1, 1)]
+void CSRadixScatter(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint3 GroupCount : SV_GroupCount)
+{
+    RWStructuredBuffer<uint> keysIn = ResourceDescriptorHeap[BindlessIndexInput];
+    RWStructuredBuffer<uint> keysOut = ResourceDescriptorHeap[BindlessIndexOutput];
+    RWStructuredBuffer<uint> tileDigitOffsets = ResourceDescriptorHeap[BindlessIndexTileResults];
+    RWStructuredBuffer<uint> valuesIn = ResourceDescriptorHeap[BindlessIndexAuxInput];
+    RWStructuredBuffer<uint> valuesOut = ResourceDescriptorHeap[BindlessIndexAuxOutput];
+
+    uint keys[PRIMITIVES_ELEMENTS_PER_THREAD];
+    uint digits[PRIMITIVES_ELEMENTS_PER_THREAD];
+    [unroll]
+    for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+    {
+        const uint keyIdx = GetElementIdx(Gid.x, GTid.x, elementIdx);
+        keys[elementIdx] = keyIdx < ElementCount ? keysIn[keyIdx] : 0;
+        digits[elementIdx] = keyIdx < ElementCount ? GetDigit(keys[elementIdx]) : RADIX_DIGIT_COUNT; // Out of range keys match no digit
+    }
+
+    for (uint digit = 0; digit < RADIX_DIGIT_COUNT; ++digit)
+    {
+        uint threadDigitCount = 0;
+        [unroll]
+        for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+        {
+            threadDigitCount += digits[elementIdx] == digit ? 1 : 0;
+        }
+
+        uint tileDigitCount;
+        uint outputIdx = tileDigitOffsets[digit * GroupCount.x + Gid.x] + GroupExclusiveScan(threadDigitCount, GTid.x, tileDigitCount);
+        [unroll]
+        for (uint elementIdx = 0; elementIdx < PRIMITIVES_ELEMENTS_PER_THREAD; ++elementIdx)
+        {
+            if (digits[elementIdx] == digit)
+            {
+                keysOut[outputIdx] = keys[elementIdx];
+                valuesOut[outputIdx] = valuesIn[GetElementIdx(Gid.x, GTid.x, elementIdx)];
+                ++outputIdx;
+            }
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+// Keep in sync with Particles::Particle
 struct ParticleData
 {
     float3 Pos;
@@ -8,3 +9,8 @@ struct ParticleData
     float Lifetime;
     float Size;
 };
+
+// Particles counters buffer, a raw buffer of uints, keep in sync with Particles::Counter
+#define COUNTER_DEAD_COUNT 0
+#define COUNTER_ALIVE_COUNT_0 1 // Of alive list 0, the one of alive list 1 follows
+#define COUNTER_EMIT_COUNT 3
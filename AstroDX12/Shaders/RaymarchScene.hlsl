@@ -16,16 +16,77 @@ cbuffer cbPass : register(b0)
     float gFarZ;
     float gTotalTime;
     float gDeltaTime;
+    float4x4 gPrevViewProj;
+    float4x4 gPrevInvViewProj;
+    float3 gPrevEyePosW;
+    float gPerObjectPad2; // Unused - padding
 };
 
+// Tile binning, SDFRaymarch (Src/Rendering/Common/SDFRaymarch.h) is the CPU reference. A cell is a screen tile's depth slice,
+// it lists the objects whose sphere inflated by the support radius overlaps it: rays only evaluate their current cell's objects.
+// The lists are packed in a pool: counted per cell, scanned into offsets, filled. Objects whose cells don't fit aren't binned.
+#define SDF_TILE_SIZE 32
+#define SDF_DEPTH_SLICE_COUNT 16
+#define SDF_MEAN_CELL_CAPACITY 64 // The pool holds this many objects per cell
+#define SDF_BLEND_RADIUS 15.f
+#define SDF_MAX_BLENDED_DISTANCE 5.f // The smooth union's start, objects further than it + SDF_BLEND_RADIUS don't change it
+#define SDF_SUPPORT_RADIUS (SDF_MAX_BLENDED_DISTANCE + SDF_BLEND_RADIUS)
+#define SDF_BOUNDS_GROUP_SIZE 64
+#define SDF_BIN_TILES_PER_GROUP 4
+#define SDF_BIN_GROUP_SIZE (SDF_DEPTH_SLICE_COUNT * SDF_BIN_TILES_PER_GROUP)
+
+// Reduced resolution, SDFRaymarch::Reconstructor is the CPU reference. CSMain marches one pixel of each 2x2 quad into the march
+// textures, CSResolve upsamples them to the gbuffer, reprojecting the previous frame's output in checkerboard mode.
+#define SDF_UPSAMPLE_DEPTH_TOLERANCE 0.05f // Relative to the nearest sample's distance
+#define SDF_REPROJECTION_TOLERANCE 0.05f // Relative to the footprint's distance range
+
+// Cone prepass, SDFRaymarch::ConeMarch is the CPU reference: a start distance per block of pixels, no surface is closer to its rays
+#define SDF_CONE_BLOCK_SIZE 8
+#define SDF_RAYMARCH_STEP_COUNT (100 + SDF_DEPTH_SLICE_COUNT) // Entering the next slice takes a step
+#define SDF_MAX_DISTANCE_PER_STEP 30.f
+#define SDF_MIN_DIST_FOR_COLLISION 0.0001f
+
+// Step counts, keep in sync with RaymarchStatsSlot in ComputePassRaymarchScene.cpp
+#define SDF_STATS_PIXEL_STEPS 0
+#define SDF_STATS_PIXEL_MAX_STEPS 1
+#define SDF_STATS_CONE_STEPS 2
+#define SDF_STATS_CONE_MAX_STEPS 3
+
 cbuffer BindlessRenderResources : register(b1)
 {
     int SDFSceneObjectsResourceIndex;
+    int SDFSceneAliveListResourceIndex; // Objects are the first alive particles
+    int SDFSceneCountersResourceIndex;
+    uint SDFSceneAliveListIdx;
     int OutputTextureDepthResourceIndex;
     int OutputTextureColorResourceIndex;
-    int SDFObjectCount;
+    int SDFObjectCount; // At most
     int GBufferWidth;
     int GBufferHeight;
+    int SDFObjectBoundsResourceIndex; // Per object, its cells packed
+    int SDFObjectCellCountsResourceIndex; // Per object, how many cells it overlaps
+    int SDFObjectCellOffsetsResourceIndex; // Per object, its cell counts scanned: where its entries would start in the pool
+    int SDFCellObjectCountsResourceIndex; // Per cell
+    int SDFCellObjectOffsetsResourceIndex; // Per cell, its cell counts scanned: where its list starts in the pool
+    int SDFCellObjectsResourceIndex; // The pool, the cells' lists of particle indices
+    uint TileCountX;
+    uint TileCountY;
+    uint MarchPixelStride; // 1 at full resolution, CSMain writes the gbuffer directly
+    uint MarchPixelOffsetX; // The pixel of each quad marched this frame
+    uint MarchPixelOffsetY;
+    int MarchColorResourceIndex;
+    int MarchDistanceResourceIndex; // Ray distances, -1 at full resolution
+    uint MarchWidth;
+    uint MarchHeight;
+    int HistoryColorResourceIndex; // The previous frame's resolve
+    int HistoryDistanceResourceIndex;
+    int OutputHistoryColorResourceIndex;
+    int OutputHistoryDistanceResourceIndex;
+    uint HistoryValid; // Checkerboard only, reset on mode changes
+    int ConeStartResourceIndex; // Per cone block, -1 without the prepass
+    uint ConeCountX;
+    uint ConeCountY;
+    int MarchStatsResourceIndex;
 }
 
 struct SminResult
@@ -44,76 +105,417 @@ SminResult smin(float a, float b, float k)
     return result;
 }
 
+int GetObjectCount()
+{
+    ByteAddressBuffer SDFSceneCounters = ResourceDescriptorHeap[SDFSceneCountersResourceIndex];
+    return min(SDFObjectCount, int(SDFSceneCounters.Load((COUNTER_ALIVE_COUNT_0 + SDFSceneAliveListIdx) * 4)));
+}
+
+// Exponential slices, slice 0 starts at the eye & the last one ends at the far plane
+uint GetDepthSlice(float viewZ)
+{
+    if (viewZ <= gNearZ)
+    {
+        return 0;
+    }
+    const float slice = log(viewZ / gNearZ) * (float(SDF_DEPTH_SLICE_COUNT) / log(gFarZ / gNearZ));
+    return min(uint(slice), SDF_DEPTH_SLICE_COUNT - 1);
+}
+
+float GetDepthSliceEnd(uint slice)
+{
+    return gNearZ * pow(gFarZ / gNearZ, float(slice + 1) / float(SDF_DEPTH_SLICE_COUNT));
+}
+
+// A tile's slices are contiguous, its rays walk them in order
+uint GetCellIdx(uint2 tile, uint slice)
+{
+    return (tile.x + TileCountX * tile.y) * SDF_DEPTH_SLICE_COUNT + slice;
+}
+
+uint GetCellListCapacity()
+{
+    return TileCountX * TileCountY * SDF_DEPTH_SLICE_COUNT * SDF_MEAN_CELL_CAPACITY;
+}
+
+// Same as SDFRaymarch::ComputeObjectBounds: the view space box around the inflated sphere, projected.
+// Packed: tile min x, min y, max x, max y a byte each, then slice min & max a byte each & the visible bit. Invisible objects are 0.
+uint2 ComputeObjectBounds(float3 viewPos, float size)
+{
+    const float radius = size + SDF_SUPPORT_RADIUS;
+    const float minZ = viewPos.z - radius;
+    const float maxZ = viewPos.z + radius;
+    if (maxZ <= 0.f || minZ >= gFarZ)
+    {
+        return uint2(0, 0);
+    }
+
+    // Around or behind the eye, it can cover any pixel
+    float2 minNdc = float2(-1.f, -1.f);
+    float2 maxNdc = float2(1.f, 1.f);
+    if (minZ > 0.001f)
+    {
+        const float2 projScale = float2(gProj[0][0], gProj[1][1]);
+        const float2 low = (viewPos.xy - radius) * projScale;
+        const float2 high = (viewPos.xy + radius) * projScale;
+        minNdc = min(low / minZ, low / maxZ);
+        maxNdc = max(high / minZ, high / maxZ);
+    }
+    if (any(maxNdc < -1.f) || any(minNdc > 1.f))
+    {
+        return uint2(0, 0);
+    }
+
+    // Pixel p's ray goes through p + 0.5, in tile p / SDF_TILE_SIZE
+    const float2 pixelCount = float2(GBufferWidth, GBufferHeight);
+    const float2 maxTile = float2(TileCountX - 1, TileCountY - 1);
+    const uint2 tileMin = uint2(clamp(floor((minNdc * 0.5f + 0.5f) * pixelCount / SDF_TILE_SIZE), 0.f, maxTile));
+    const uint2 tileMax = uint2(clamp(floor((maxNdc * 0.5f + 0.5f) * pixelCount / SDF_TILE_SIZE), 0.f, maxTile));
+
+    // A margin for the slices' rounding, the march's slice ends & GetDepthSlice don't round alike
+    const uint sliceMin = GetDepthSlice(max(minZ, 0.f) * 0.999f);
+    const uint sliceMax = GetDepthSlice(maxZ * 1.001f);
+    return uint2(
+        tileMin.x | (tileMin.y << 8) | (tileMax.x << 16) | (tileMax.y << 24),
+        sliceMin | (sliceMax << 8) | (1u << 16));
+}
+
+// Same as SDFRaymarch::ObjectBounds::GetCellCount, 0 if the object isn't visible
+uint GetBoundsCellCount(uint2 bounds)
+{
+    const uint2 tileMin = uint2(bounds.x & 0xFF, (bounds.x >> 8) & 0xFF);
+    const uint2 tileMax = uint2((bounds.x >> 16) & 0xFF, bounds.x >> 24);
+    const uint sliceMin = bounds.y & 0xFF;
+    const uint sliceMax = (bounds.y >> 8) & 0xFF;
+    return (bounds.y >> 16) != 0 ? (tileMax.x - tileMin.x + 1) * (tileMax.y - tileMin.y + 1) * (sliceMax - sliceMin + 1) : 0;
+}
+
+bool OverlapsCell(uint2 bounds, uint2 tile, uint slice)
+{
+    const uint2 tileMin = uint2(bounds.x & 0xFF, (bounds.x >> 8) & 0xFF);
+    const uint2 tileMax = uint2((bounds.x >> 16) & 0xFF, bounds.x >> 24);
+    const uint sliceMin = bounds.y & 0xFF;
+    const uint sliceMax = (bounds.y >> 8) & 0xFF;
+    return (bounds.y >> 16) != 0
+        && all(tile >= tileMin) && all(tile <= tileMax)
+        && slice >= sliceMin && slice <= sliceMax;
+}
+
+// A thread per object slot: the objects past the scene's count overlap no cell, the scan of the cell counts covers every slot
+[numthreads(SDF_BOUNDS_GROUP_SIZE, 1, 1)]
+void CSComputeObjectBounds(uint3 DTid : SV_DispatchThreadID)
+{
+    if (int(DTid.x) >= SDFObjectCount)
+    {
+        return;
+    }
+
+    RWStructuredBuffer<uint2> objectBounds = ResourceDescriptorHeap[SDFObjectBoundsResourceIndex];
+    RWStructuredBuffer<uint> objectCellCounts = ResourceDescriptorHeap[SDFObjectCellCountsResourceIndex];
+    uint2 bounds = uint2(0, 0);
+    if (int(DTid.x) < GetObjectCount())
+    {
+        StructuredBuffer<ParticleData> SDFSceneBuffer = ResourceDescriptorHeap[SDFSceneObjectsResourceIndex];
+        StructuredBuffer<uint> SDFSceneAliveList = ResourceDescriptorHeap[SDFSceneAliveListResourceIndex];
+        const ParticleData SDFObject = SDFSceneBuffer[SDFSceneAliveList[DTid.x]];
+        bounds = ComputeObjectBounds(mul(float4(SDFObject.Pos, 1.f), gView).xyz, SDFObject.Size);
+    }
+    objectBounds[DTid.x] = bounds;
+    objectCellCounts[DTid.x] = GetBoundsCellCount(bounds);
+}
+
+groupshared uint2 gs_objectBounds[SDF_BIN_GROUP_SIZE];
+groupshared uint gs_objectParticleIndices[SDF_BIN_GROUP_SIZE];
+
+// Same as SDFRaymarch::CountCellObjects & BinCell, a thread per cell: the binned objects overlapping it in scene order,
+// smin isn't associative. An object is binned if all its entries fit in the pool, the offsets only grow: they're a prefix
+// of the scene. The group stages the objects' bounds a chunk at a time, each of its threads tests them all against its cell.
+// Returns the cell's object count, writes its list at its offset if fill is set.
+uint VisitCellObjects(uint3 Gid, uint3 GTid, uint GI, bool fill)
+{
+    StructuredBuffer<uint> SDFSceneAliveList = ResourceDescriptorHeap[SDFSceneAliveListResourceIndex];
+    RWStructuredBuffer<uint2> objectBounds = ResourceDescriptorHeap[SDFObjectBoundsResourceIndex];
+    RWStructuredBuffer<uint> objectCellCounts = ResourceDescriptorHeap[SDFObjectCellCountsResourceIndex];
+    RWStructuredBuffer<uint> objectCellOffsets = ResourceDescriptorHeap[SDFObjectCellOffsetsResourceIndex];
+    RWStructuredBuffer<uint> cellObjectOffsets = ResourceDescriptorHeap[SDFCellObjectOffsetsResourceIndex];
+    RWStructuredBuffer<uint> cellObjects = ResourceDescriptorHeap[SDFCellObjectsResourceIndex];
+
+    const uint tileIdx = Gid.x * SDF_BIN_TILES_PER_GROUP + GTid.y;
+    const bool isTileValid = tileIdx < TileCountX * TileCountY;
+    const uint2 tile = uint2(tileIdx % TileCountX, tileIdx / TileCountX);
+    const uint cellIdx = GetCellIdx(tile, GTid.x);
+    const uint cellObjectOffset = fill && isTileValid ? cellObjectOffsets[cellIdx] : 0;
+    const uint objectCount = uint(GetObjectCount());
+
+    uint cellObjectCount = 0;
+    for (uint chunkStart = 0; chunkStart < objectCount; chunkStart += SDF_BIN_GROUP_SIZE)
+    {
+        const uint objectIdx = chunkStart + GI;
+        const bool isBinned = objectIdx < objectCount && objectCellOffsets[objectIdx] + objectCellCounts[objectIdx] <= GetCellListCapacity();
+        gs_objectBounds[GI] = isBinned ? objectBounds[objectIdx] : uint2(0, 0);
+        gs_objectParticleIndices[GI] = isBinned ? SDFSceneAliveList[objectIdx] : 0;
+        GroupMemoryBarrierWithGroupSync();
+
+        const uint chunkCount = min(SDF_BIN_GROUP_SIZE, objectCount - chunkStart);
+        for (uint chunkObjectIdx = 0; chunkObjectIdx < chunkCount; ++chunkObjectIdx)
+        {
+            if (!isTileValid || !OverlapsCell(gs_objectBounds[chunkObjectIdx], tile, GTid.x))
+            {
+                continue;
+            }
+            if (fill)
+            {
+                cellObjects[cellObjectOffset + cellObjectCount] = gs_objectParticleIndices[chunkObjectIdx];
+            }
+            ++cellObjectCount;
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+    return cellObjectCount;
+}
+
+[numthreads(SDF_DEPTH_SLICE_COUNT, SDF_BIN_TILES_PER_GROUP, 1)]
+void CSCountCellObjects(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    const uint cellObjectCount = VisitCellObjects(Gid, GTid, GI, false);
+    const uint tileIdx = Gid.x * SDF_BIN_TILES_PER_GROUP + GTid.y;
+    if (tileIdx < TileCountX * TileCountY)
+    {
+        RWStructuredBuffer<uint> cellObjectCounts = ResourceDescriptorHeap[SDFCellObjectCountsResourceIndex];
+        cellObjectCounts[GetCellIdx(uint2(tileIdx % TileCountX, tileIdx / TileCountX), GTid.x)] = cellObjectCount;
+    }
+}
+
+[numthreads(SDF_DEPTH_SLICE_COUNT, SDF_BIN_TILES_PER_GROUP, 1)]
+void CSBinObjects(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    VisitCellObjects(Gid, GTid, GI, true);
+}
+
+// Smoothly blend distances and normals of multiple objects to create a combined SDF field
+void BlendObject(float objDist, float3 objNormal, inout float DistToClosestObject, inout float3 blendedNormal)
+{
+    SminResult result = smin(DistToClosestObject, objDist, SDF_BLEND_RADIUS);
+    blendedNormal = lerp(objNormal, blendedNormal, result.blend);
+    DistToClosestObject = result.dist;
+}
+
+// Same as SDFRaymarch::EvaluateField over a cell's objects. Empty cells aren't evaluated, they have no surface.
+// The smooth union starts at SDF_MAX_BLENDED_DISTANCE, the objects further than SDF_SUPPORT_RADIUS don't change it & are skipped.
+// With none closer, the field is the nearest object's distance less the blend radius: continuous, never past the union's surface.
+float EvaluateCellField(uint cellIdx, uint cellObjectCount, float3 pos, inout float3 blendedNormal)
+{
+    StructuredBuffer<ParticleData> SDFSceneBuffer = ResourceDescriptorHeap[SDFSceneObjectsResourceIndex];
+    RWStructuredBuffer<uint> cellObjectOffsets = ResourceDescriptorHeap[SDFCellObjectOffsetsResourceIndex];
+    RWStructuredBuffer<uint> cellObjects = ResourceDescriptorHeap[SDFCellObjectsResourceIndex];
+    const uint cellObjectOffset = cellObjectOffsets[cellIdx];
+
+    float dist = SDF_MAX_BLENDED_DISTANCE;
+    float nearestDist = SDF_MAX_DISTANCE_PER_STEP + SDF_BLEND_RADIUS;
+    bool isBlended = false;
+    for (uint objIdx = 0; objIdx < cellObjectCount; ++objIdx)
+    {
+        const ParticleData SDFObject = SDFSceneBuffer[cellObjects[cellObjectOffset + objIdx]];
+        const float3 objToSamplePos = SDFObject.Pos.xyz - pos;
+        const float distToCenter = length(objToSamplePos);
+        const float objDist = distToCenter - SDFObject.Size;
+        if (objDist >= SDF_SUPPORT_RADIUS)
+        {
+            nearestDist = min(nearestDist, objDist);
+            continue;
+        }
+        isBlended = true;
+        BlendObject(objDist, -objToSamplePos / max(distToCenter, 0.0001f), dist, blendedNormal);
+    }
+    return isBlended ? dist : nearestDist - SDF_BLEND_RADIUS;
+}
+
+// View space, normalised, through a position in pixels: pixel p's center is p + 0.5
+float3 GetViewRayDir(float2 pixelPos)
+{
+    const float2 ndc = (pixelPos / float2(GBufferWidth, GBufferHeight)) * 2.f - 1.f;
+    const float4 rayEndCamSpace = mul(float4(ndc, 1.0f, 1.0f), gInvProj);
+    return normalize(rayEndCamSpace.xyz / rayEndCamSpace.w);
+}
+
+// Step counts of the group's active lanes, an atomic per wave
+void AddStepCountStats(uint stepCount, uint sumSlot, uint maxSlot)
+{
+    const uint waveStepCount = WaveActiveSum(stepCount);
+    const uint waveMaxStepCount = WaveActiveMax(stepCount);
+    if (WaveIsFirstLane())
+    {
+        RWStructuredBuffer<uint> marchStats = ResourceDescriptorHeap[MarchStatsResourceIndex];
+        InterlockedAdd(marchStats[sumSlot], waveStepCount);
+        InterlockedMax(marchStats[maxSlot], waveMaxStepCount);
+    }
+}
+
+// Same as SDFRaymarch::ConeMarch, a thread per block: the cone around the block's rays along its center ray, through its tile's
+// cells, until a surface may be within it. The block's rays are spread over the slices between t times their smallest & largest
+// view z per unit of ray, each of these cells is evaluated & steps stop at the earliest end of the furthest one.
+[numthreads(8, 8, 1)]
+void CSConeMarch(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= ConeCountX || DTid.y >= ConeCountY)
+    {
+        return;
+    }
+
+    RWStructuredBuffer<uint> cellObjectCounts = ResourceDescriptorHeap[SDFCellObjectCountsResourceIndex];
+    const float WorldSize = gFarZ - gNearZ;
+    const float2 RenderTargetPixelSize = float2(GBufferWidth, GBufferHeight);
+
+    // The block's pixel centers, clipped to the screen
+    const float2 pixelMin = float2(DTid.xy * SDF_CONE_BLOCK_SIZE) + 0.5f;
+    const float2 pixelMax = min(float2((DTid.xy + 1) * SDF_CONE_BLOCK_SIZE), RenderTargetPixelSize) - 0.5f;
+    const float3 centerDir = GetViewRayDir((pixelMin + pixelMax) * 0.5f);
+
+    // Every block ray's point at t is within t * slope of the center ray's, slope is the widest chord to a corner ray
+    float slope = 0.f;
+    [unroll]
+    for (uint corner = 0; corner < 4; ++corner)
+    {
+        const float2 cornerPos = lerp(pixelMin, pixelMax, float2(corner & 1, corner >> 1));
+        slope = max(slope, length(GetViewRayDir(cornerPos) - centerDir));
+    }
+
+    // View z per unit of ray falls off away from the screen's center
+    const float2 screenCenter = RenderTargetPixelSize * 0.5f;
+    const float maxDirZ = GetViewRayDir(clamp(screenCenter, pixelMin, pixelMax)).z;
+    const float minDirZ = GetViewRayDir(lerp(pixelMax, pixelMin, float2(screenCenter - pixelMin > pixelMax - screenCenter))).z;
+
+    const uint2 tile = (DTid.xy * SDF_CONE_BLOCK_SIZE) / SDF_TILE_SIZE;
+    float startDistance = 0.f;
+    uint sliceMax = 0;
+    uint stepCount = 0;
+    for (int Step = 0; Step < SDF_RAYMARCH_STEP_COUNT; ++Step)
+    {
+        const float sliceEnd = GetDepthSliceEnd(sliceMax) / maxDirZ;
+        const float3 pos = centerDir * startDistance;
+        float dist = sliceEnd - startDistance;
+        for (uint slice = min(GetDepthSlice(startDistance * minDirZ), sliceMax); slice <= sliceMax; ++slice)
+        {
+            const uint cellIdx = GetCellIdx(tile, slice);
+            const uint cellObjectCount = cellObjectCounts[cellIdx];
+            if (cellObjectCount > 0)
+            {
+                float3 unusedNormal = float3(0.f, 0.f, 0.f);
+                dist = min(dist, EvaluateCellField(cellIdx, cellObjectCount, pos, unusedNormal) - startDistance * slope);
+            }
+        }
+        stepCount = Step + 1;
+
+        // A surface may be within the cone
+        if (dist <= SDF_MIN_DIST_FOR_COLLISION)
+        {
+            break;
+        }
+        if (startDistance + dist >= sliceEnd)
+        {
+            startDistance = sliceEnd;
+            ++sliceMax;
+        }
+        else
+        {
+            startDistance += dist;
+        }
+        if (sliceMax == SDF_DEPTH_SLICE_COUNT || startDistance >= WorldSize)
+        {
+            startDistance = WorldSize;
+            break;
+        }
+    }
+
+    RWTexture2D<float> coneStarts = ResourceDescriptorHeap[ConeStartResourceIndex];
+    coneStarts[DTid.xy] = startDistance;
+    AddStepCountStats(stepCount, SDF_STATS_CONE_STEPS, SDF_STATS_CONE_MAX_STEPS);
+}
+
+// Same as SDFRaymarch::MarchBinned: through the pixel's tile cells front to back, a step never crosses the cell's far depth.
+// An empty cell is skipped in a step. Starts at the pixel's cone start if there is one.
 [numthreads(8, 8, 1)]
 void CSMain(uint3 DTid : SV_DispatchThreadID)
 {
-    StructuredBuffer<ParticleData> SDFSceneBuffer = ResourceDescriptorHeap[SDFSceneObjectsResourceIndex];
-    const int RaymarchStepCount = 100;
-    const float MaxDistancePerStep = 30.f; 
+    RWStructuredBuffer<uint> cellObjectCounts = ResourceDescriptorHeap[SDFCellObjectCountsResourceIndex];
     const float WorldSize = gFarZ - gNearZ;
 
-    const float2 RenderTargetPixelSize = float2(GBufferWidth, GBufferHeight);
-    float2 UV = ((DTid.xy + 0.5) / RenderTargetPixelSize);
-    float2 ndc = (UV * 2.f) - 1.f;
+    const uint2 pixel = DTid.xy * MarchPixelStride + uint2(MarchPixelOffsetX, MarchPixelOffsetY);
     const float3 RayOrigin = gEyePosW;
-    float4 rayEndCamSpace = mul(float4(ndc, 1.0f, 1.0f), gInvProj);
-    float3 rayDirInCamSpace = rayEndCamSpace.xyz / rayEndCamSpace.w;
+    const float3 rayDirInCamSpace = GetViewRayDir(pixel + 0.5f);
     
     float3 RayDir = normalize(
         mul(float4(rayDirInCamSpace, 0.f), InvView).xyz
     );
     
-    const float minDistForCollision = 0.0001f;
     float distanceTravelled = 0.f;
-    float3 RayPos = RayOrigin;
+    if (ConeStartResourceIndex >= 0)
+    {
+        RWTexture2D<float> coneStarts = ResourceDescriptorHeap[ConeStartResourceIndex];
+        distanceTravelled = coneStarts[pixel / SDF_CONE_BLOCK_SIZE];
+    }
+    const uint2 tile = pixel / SDF_TILE_SIZE;
+    uint slice = GetDepthSlice(distanceTravelled * rayDirInCamSpace.z);
 
     bool Hit = false;
     float3 HitNormal = float3(0.f, 0.f, 0.f);
-    for (int Step = 0; Step < RaymarchStepCount; ++Step)
+    uint stepCount = 0;
+    for (int Step = 0; Step < SDF_RAYMARCH_STEP_COUNT && distanceTravelled < WorldSize; ++Step)
     {
-        float DistToClosestObject = MaxDistancePerStep;
-        float3 blendedNormal = float3(0.f, 0.f, 0.f);
+        const uint cellIdx = GetCellIdx(tile, slice);
+        const float sliceEnd = GetDepthSliceEnd(slice) / rayDirInCamSpace.z;
+        const uint cellObjectCount = cellObjectCounts[cellIdx];
 
-        for (int objIdx = 0; objIdx < SDFObjectCount; ++objIdx)
+        float DistToClosestObject = sliceEnd - distanceTravelled;
+        float3 blendedNormal = float3(0.f, 0.f, 0.f);
+        if (cellObjectCount > 0)
         {
-            ParticleData SDFObject = SDFSceneBuffer[objIdx];
-            
-            const float3 objToSamplePos = (SDFObject.Pos.xyz - RayPos);
-            float distToCenter = length(objToSamplePos);
-            float objDist = distToCenter - SDFObject.Size;
-            float3 objNormal = -objToSamplePos / max(distToCenter, 0.0001f);
-
-            // Smoothly blend distances and normals of multiple objects to create a combined SDF field
-            static const float blendFactor = 15.f;
-            SminResult result = smin(DistToClosestObject, objDist, blendFactor);
-            blendedNormal = lerp(objNormal, blendedNormal, result.blend);
-            DistToClosestObject = result.dist;
+            const float3 RayPos = RayOrigin + RayDir * distanceTravelled;
+            DistToClosestObject = EvaluateCellField(cellIdx, cellObjectCount, RayPos, blendedNormal);
         }
+        stepCount = Step + 1;
 
-        distanceTravelled += DistToClosestObject;
-        RayPos += (RayDir * DistToClosestObject);
+        if (distanceTravelled + DistToClosestObject >= sliceEnd)
+        {
+            distanceTravelled = sliceEnd;
+            ++slice;
+        }
+        else
+        {
+            distanceTravelled += DistToClosestObject;
+        }
         
-        if (DistToClosestObject <= minDistForCollision)
+        if (cellObjectCount > 0 && DistToClosestObject <= SDF_MIN_DIST_FOR_COLLISION)
         {
             Hit = true;
             HitNormal = normalize(blendedNormal);
             break;
         }
         
-        if (Step == RaymarchStepCount - 1 || distanceTravelled >= WorldSize)
+        if (Step == SDF_RAYMARCH_STEP_COUNT - 1 || slice == SDF_DEPTH_SLICE_COUNT || distanceTravelled >= WorldSize)
         {
             distanceTravelled = WorldSize; // No hits
             break;
         }
     }
+    distanceTravelled = min(distanceTravelled, WorldSize); // Cones which saw nothing start at WorldSize
+    AddStepCountStats(stepCount, SDF_STATS_PIXEL_STEPS, SDF_STATS_PIXEL_MAX_STEPS);
         
-    // Normalize distance to [0, 1] range
-    float normalizedDepth = 1.f - saturate(distanceTravelled / WorldSize);
+    if (MarchPixelStride == 1)
+    {
+        // Normalize distance to [0, 1] range
+        float normalizedDepth = 1.f - saturate(distanceTravelled / WorldSize);
 
-    RWTexture2D<float> depthTexture = ResourceDescriptorHeap[OutputTextureDepthResourceIndex];
-    depthTexture[DTid.xy] = normalizedDepth;
+        RWTexture2D<float> depthTexture = ResourceDescriptorHeap[OutputTextureDepthResourceIndex];
+        depthTexture[DTid.xy] = normalizedDepth;
+    }
+    else
+    {
+        RWTexture2D<float> distanceTexture = ResourceDescriptorHeap[MarchDistanceResourceIndex];
+        distanceTexture[DTid.xy] = distanceTravelled;
+    }
 
-    RWTexture2D<float4> colorTexture = ResourceDescriptorHeap[OutputTextureColorResourceIndex];
+    RWTexture2D<float4> colorTexture = ResourceDescriptorHeap[MarchColorResourceIndex];
     float4 shading = float4(0.f, 0.f, 0.f, 0.f);
     if( Hit )
     {
@@ -124,4 +526,139 @@ void CSMain(uint3 DTid : SV_DispatchThreadID)
         shading = float4(ambientColor + (nDotL * fakeLightColor), 1.f);
     }
     colorTexture[DTid.xy] = shading;
+}
+
+// World space ray through the pixel's center, from a frame's camera
+float3 GetPixelRayDir(uint2 pixel, float4x4 invViewProj, float3 eyePos)
+{
+    const float2 ndc = ((pixel + 0.5f) / float2(GBufferWidth, GBufferHeight)) * 2.f - 1.f;
+    const float4 farPos = mul(float4(ndc, 1.f, 1.f), invViewProj);
+    return normalize(farPos.xyz / farPos.w - eyePos);
+}
+
+// The march footprint's color & distance ranges around a pixel
+struct PixelNeighbourhood
+{
+    float4 minColor;
+    float4 maxColor;
+    float minDistance;
+    float maxDistance;
+};
+
+// Same as SDFRaymarch::Reconstructor::Reproject: the upsampled surface point into the previous frame. The history there is kept
+// if its own surface point is within the neighbourhood's distance range, its color clamped to the neighbourhood's.
+bool TryReprojectHistory(uint2 pixel, PixelNeighbourhood neighbourhood, inout float4 color, inout float distance)
+{
+    const float WorldSize = gFarZ - gNearZ;
+    const float2 RenderTargetPixelSize = float2(GBufferWidth, GBufferHeight);
+    const float3 worldPos = gEyePosW + GetPixelRayDir(pixel, gInvViewProj, gEyePosW) * distance;
+    const float4 prevClipPos = mul(float4(worldPos, 1.f), gPrevViewProj);
+    if (prevClipPos.w <= 0.f)
+    {
+        return false;
+    }
+
+    const float2 prevPixelPos = round(((prevClipPos.xy / prevClipPos.w) * 0.5f + 0.5f) * RenderTargetPixelSize - 0.5f);
+    if (any(prevPixelPos < 0.f) || any(prevPixelPos > RenderTargetPixelSize - 1.f))
+    {
+        return false;
+    }
+
+    // A miss stays a miss, a hit is at the history's point seen from the current eye
+    RWTexture2D<float4> historyColors = ResourceDescriptorHeap[HistoryColorResourceIndex];
+    RWTexture2D<float> historyDistances = ResourceDescriptorHeap[HistoryDistanceResourceIndex];
+    const uint2 prevPixel = uint2(prevPixelPos);
+    float historyDistance = historyDistances[prevPixel];
+    if (historyDistance < WorldSize)
+    {
+        const float3 historyPos = gPrevEyePosW + GetPixelRayDir(prevPixel, gPrevInvViewProj, gPrevEyePosW) * historyDistance;
+        historyDistance = length(historyPos - gEyePosW);
+    }
+    if (historyDistance < neighbourhood.minDistance * (1.f - SDF_REPROJECTION_TOLERANCE)
+        || historyDistance > neighbourhood.maxDistance * (1.f + SDF_REPROJECTION_TOLERANCE))
+    {
+        return false;
+    }
+
+    color = clamp(historyColors[prevPixel], neighbourhood.minColor, neighbourhood.maxColor);
+    distance = historyDistance;
+    return true;
+}
+
+// Same as SDFRaymarch::Reconstructor::ResolvePixel, a thread per gbuffer pixel: the bilinear footprint of the marched samples,
+// the ones too far from the nearest one's distance left out. Pixels not marched this frame reproject the history if it's valid.
+[numthreads(8, 8, 1)]
+void CSResolve(uint3 DTid : SV_DispatchThreadID)
+{
+    RWTexture2D<float4> marchColors = ResourceDescriptorHeap[MarchColorResourceIndex];
+    RWTexture2D<float> marchDistances = ResourceDescriptorHeap[MarchDistanceResourceIndex];
+    const float WorldSize = gFarZ - gNearZ;
+
+    // Sample q is pixel q * MarchPixelStride + offset
+    const float2 marchPos = (float2(DTid.xy) - float2(MarchPixelOffsetX, MarchPixelOffsetY)) / float(MarchPixelStride);
+    const float2 marchFloor = floor(marchPos);
+    const float2 marchFrac = marchPos - marchFloor;
+    const int2 maxSample = int2(MarchWidth, MarchHeight) - 1;
+
+    float4 sampleColors[4];
+    float sampleDistances[4];
+    float sampleWeights[4];
+    float nearestWeight = 0.f;
+    float nearestDistance = 0.f;
+    [unroll]
+    for (uint sampleIdx = 0; sampleIdx < 4; ++sampleIdx)
+    {
+        const uint2 sampleOffset = uint2(sampleIdx & 1, sampleIdx >> 1);
+        const int2 samplePos = clamp(int2(marchFloor) + int2(sampleOffset), int2(0, 0), maxSample);
+        sampleColors[sampleIdx] = marchColors[samplePos];
+        sampleDistances[sampleIdx] = marchDistances[samplePos];
+        const float2 axisWeights = lerp(1.f - marchFrac, marchFrac, float2(sampleOffset));
+        sampleWeights[sampleIdx] = axisWeights.x * axisWeights.y;
+        if (sampleWeights[sampleIdx] > nearestWeight)
+        {
+            nearestWeight = sampleWeights[sampleIdx];
+            nearestDistance = sampleDistances[sampleIdx];
+        }
+    }
+
+    // All the footprint's samples bound the reprojected history: they straddle the silhouettes the history refines
+    PixelNeighbourhood neighbourhood;
+    neighbourhood.minColor = sampleColors[0];
+    neighbourhood.maxColor = sampleColors[0];
+    neighbourhood.minDistance = sampleDistances[0];
+    neighbourhood.maxDistance = sampleDistances[0];
+    float4 color = float4(0.f, 0.f, 0.f, 0.f);
+    float distance = 0.f;
+    float totalWeight = 0.f;
+    [unroll]
+    for (uint footprintIdx = 0; footprintIdx < 4; ++footprintIdx)
+    {
+        neighbourhood.minColor = min(neighbourhood.minColor, sampleColors[footprintIdx]);
+        neighbourhood.maxColor = max(neighbourhood.maxColor, sampleColors[footprintIdx]);
+        neighbourhood.minDistance = min(neighbourhood.minDistance, sampleDistances[footprintIdx]);
+        neighbourhood.maxDistance = max(neighbourhood.maxDistance, sampleDistances[footprintIdx]);
+        if (abs(sampleDistances[footprintIdx] - nearestDistance) <= SDF_UPSAMPLE_DEPTH_TOLERANCE * nearestDistance)
+        {
+            color += sampleColors[footprintIdx] * sampleWeights[footprintIdx];
+            distance += sampleDistances[footprintIdx] * sampleWeights[footprintIdx];
+            totalWeight += sampleWeights[footprintIdx];
+        }
+    }
+    color /= totalWeight;
+    distance /= totalWeight;
+
+    const bool isMarched = all(marchFrac == 0.f);
+    if (HistoryValid != 0 && !isMarched)
+    {
+        TryReprojectHistory(DTid.xy, neighbourhood, color, distance);
+    }
+
+    RWTexture2D<float> depthTexture = ResourceDescriptorHeap[OutputTextureDepthResourceIndex];
+    RWTexture2D<float4> colorTexture = ResourceDescriptorHeap[OutputTextureColorResourceIndex];
+    RWTexture2D<float> outputHistoryDistances = ResourceDescriptorHeap[OutputHistoryDistanceResourceIndex];
+    RWTexture2D<float4> outputHistoryColors = ResourceDescriptorHeap[OutputHistoryColorResourceIndex];
+    depthTexture[DTid.xy] = 1.f - saturate(distance / WorldSize);
+    colorTexture[DTid.xy] = color;
+    outputHistoryDistances[DTid.xy] = distance;
+    outputHistoryColors[DTid.xy] = color;
 }
\ No newline at end of file
@@ -21,7 +21,10 @@ cbuffer cbPass : register(b0)
 cbuffer BindlessRenderResources : register(b1)
 {
     int particlesBufferIndex;
+    int aliveListBufferIndex; // Latest alive list, an instance per alive particle
     int modelVertexDataBufferIdx;
+    float SimInterpolationAlpha; // Fraction of a sim step elapsed since the latest sim state
+    float SimDeltaTime;
 };
 
 struct VertexData
@@ -40,11 +43,16 @@ PSInput VS(uint VertexID : SV_VertexID, uint InstanceID : SV_InstanceID)
     PSInput o;
 
     StructuredBuffer<ParticleData> particleData = ResourceDescriptorHeap[particlesBufferIndex];
+    StructuredBuffer<uint> aliveList = ResourceDescriptorHeap[aliveListBufferIndex];
     StructuredBuffer<VertexData> vertexData = ResourceDescriptorHeap[modelVertexDataBufferIdx];
 
+    const ParticleData particle = particleData[aliveList[InstanceID]];
+
 	// Transform to homogeneous clip space.
-    const float3 posL = vertexData[VertexID].posLocal * particleData[InstanceID].Size;
-    const float3 posW = posL + particleData[InstanceID].Pos;
+    const float3 posL = vertexData[VertexID].posLocal * particle.Size;
+    // The sim runs at a fixed rate, extrapolate from its latest state to the current render time
+    const float3 simPos = particle.Pos + particle.Vel * (SimInterpolationAlpha * SimDeltaTime);
+    const float3 posW = posL + simPos;
     o.PosH = mul(float4(posW, 1.0f), gViewProj);
     
     float3 normalWS = posL;
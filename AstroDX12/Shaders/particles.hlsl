@@ -1,52 +1,216 @@
 #include "Shaders/ParticlesCommon.hlsli"
 
+// Fixed pool of particle slots, each slot either on the dead list or on an alive list.
+// Per step: CSPrepareStep sizes the step from the counters, CSEmit turns dead slots into alive ones, CSSimulate moves the alive ones along
+// & sorts them back onto the dead list or onto the other alive list. Emit & simulate are dispatched indirectly, their cost follows the alive count.
+// Particles::CPUParticleSystem (Src/Simulation/ParticleSystem.h) is the CPU reference, keep both in sync.
+
 cbuffer BindlessRenderResources : register(b0)
 {
-    int BindlessIndexParticlesBufferInput;
-    int BindlessIndexParticlesBufferOutput;
+    int BindlessIndexParticlesBuffer;
+    int BindlessIndexDeadListBuffer;
+    int BindlessIndexAliveListInBuffer; // Emitted into & simulated this step
+    int BindlessIndexAliveListOutBuffer; // Survivors of this step
+    int BindlessIndexCountersBuffer;
+    int BindlessIndexIndirectArgsBuffer;
+    float SimDeltaTime; // Fixed step of the particles sim clock
+    uint EmitBudget; // Particles to emit this step, if there are enough dead ones
+    uint StepIndex; // Seeds the emission
+    uint AliveListInIdx; // 0 or 1, which alive count goes with the alive list in
+    uint MaxParticleCount;
+    uint MeshIndexCount;
+}
+
+#define PARTICLES_THREAD_GROUP_SIZE 64
+
+struct D3D12_DISPATCH_ARGUMENTS
+{
+    uint ThreadGroupCountX;
+    uint ThreadGroupCountY;
+    uint ThreadGroupCountZ;
+};
+
+struct D3D12_DRAW_INDEXED_ARGUMENTS
+{
+    uint IndexCountPerInstance;
+    uint InstanceCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint StartInstanceLocation;
+};
+
+// Keep in sync with ParticleIndirectArgs
+struct ParticleIndirectArgs
+{
+    D3D12_DISPATCH_ARGUMENTS Emit;
+    D3D12_DISPATCH_ARGUMENTS Simulate;
+    D3D12_DRAW_INDEXED_ARGUMENTS Draw;
+};
+
+D3D12_DISPATCH_ARGUMENTS MakeDispatchArgs(uint threadCount)
+{
+    D3D12_DISPATCH_ARGUMENTS args;
+    args.ThreadGroupCountX = (threadCount + PARTICLES_THREAD_GROUP_SIZE - 1) / PARTICLES_THREAD_GROUP_SIZE;
+    args.ThreadGroupCountY = 1;
+    args.ThreadGroupCountZ = 1;
+    return args;
 }
 
-float3 Random(float seed)
+// PCG hash, same as Particles::Hash
+uint Hash(uint value)
 {
-    return float3(cos(seed * 53.13f) * 8.42f, sin(seed * 13.13f) * 4.92f, tan(seed * 95.83f) * 19.22f);
+    const uint state = value * 747796405u + 2891336453u;
+    const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
 }
 
-void ResetParticle(inout ParticleData p, uint3 DTid)
+// [0, 1), advancing the seed
+float NextRandom(inout uint seed)
 {
-    p.Age -= p.Lifetime;
-    p.Pos = Random(p.Age + DTid.x) * float3(1, 0, 1);
-    p.Vel = float3(0.f, 60.f, 0.f) + (normalize(Random(p.Age + DTid.x + 1.234f)) * float3(20.f, 40.f, 20.f));
+    seed = Hash(seed);
+    return float(seed >> 8) * (1.f / 16777216.f);
 }
 
-[numthreads(20, 1, 1)]
-void CSMain( uint3 DTid : SV_DispatchThreadID )
+// Same as Particles::EmitParticle
+ParticleData EmitParticle(uint stepIndex, uint emitIdx)
 {
-    StructuredBuffer<ParticleData> particlesBufferIn = ResourceDescriptorHeap[BindlessIndexParticlesBufferInput];
-    RWStructuredBuffer<ParticleData> particlesBufferOut = ResourceDescriptorHeap[BindlessIndexParticlesBufferOutput];
-    
-    ParticleData Data = particlesBufferIn[DTid.x];
-    // Reset
-    if (Data.Age > Data.Lifetime)
+    uint seed = Hash(stepIndex) + emitIdx;
+    const float angle = NextRandom(seed) * 6.2831853f;
+    const float radius = 8.f * sqrt(NextRandom(seed));
+
+    ParticleData p;
+    p.Pos = float3(cos(angle) * radius, 0.f, sin(angle) * radius);
+    p.Vel.x = (NextRandom(seed) * 2.f - 1.f) * 20.f;
+    p.Vel.y = 60.f + (NextRandom(seed) * 2.f - 1.f) * 40.f;
+    p.Vel.z = (NextRandom(seed) * 2.f - 1.f) * 20.f;
+    p.Age = 0.f;
+    p.Lifetime = 3.f + NextRandom(seed);
+    p.Size = 1.f;
+    return p;
+}
+
+// Same as Particles::Integrate, returns false once the particle is past its lifetime
+bool Integrate(inout ParticleData p, float dt)
+{
+    p.Vel += float3(0.f, -98.1f, 0.f) * dt;
+    p.Pos += p.Vel * dt;
+
+    if (p.Pos.y < -2.f)
     {
-        ResetParticle(Data, DTid);
+        p.Vel.xz *= 0.9f;
+        p.Vel.y *= -1.f;
+        p.Pos.y = -2.f;
     }
-    
-    const float dt = 1.f / 60.f; // should be an input arg
-    
-    Data.Vel += float3(0.f, -98.1f, 0.f) * dt;
-    Data.Pos += Data.Vel * dt;
-    
-    if(Data.Pos.y < -2.f)
+
+    p.Age += dt;
+    return p.Age < p.Lifetime;
+}
+
+// Once, before the first step: every slot dead
+[numthreads(PARTICLES_THREAD_GROUP_SIZE, 1, 1)]
+void CSReset(uint3 DTid : SV_DispatchThreadID)
+{
+    RWStructuredBuffer<uint> deadList = ResourceDescriptorHeap[BindlessIndexDeadListBuffer];
+    RWByteAddressBuffer counters = ResourceDescriptorHeap[BindlessIndexCountersBuffer];
+
+    if (DTid.x < MaxParticleCount)
     {
-        Data.Vel.xz *= 0.9f;
-        Data.Vel.y *= -1.f;
-        Data.Pos.y = -2.f;
+        deadList[DTid.x] = DTid.x;
+    }
 
+    if (DTid.x == 0)
+    {
+        counters.Store4(0, uint4(MaxParticleCount, 0, 0, 0));
     }
-    
-    Data.Age += 0.016f;
-    
+}
+
+// 1 thread: clamps the emission to the dead slots & sizes the emit & simulate dispatches
+[numthreads(1, 1, 1)]
+void CSPrepareStep(uint3 DTid : SV_DispatchThreadID)
+{
+    RWByteAddressBuffer counters = ResourceDescriptorHeap[BindlessIndexCountersBuffer];
+    RWStructuredBuffer<ParticleIndirectArgs> indirectArgs = ResourceDescriptorHeap[BindlessIndexIndirectArgsBuffer];
+
+    const uint emitCount = min(EmitBudget, counters.Load(COUNTER_DEAD_COUNT * 4));
+    const uint aliveCountIn = counters.Load((COUNTER_ALIVE_COUNT_0 + AliveListInIdx) * 4);
+    counters.Store(COUNTER_EMIT_COUNT * 4, emitCount);
+    counters.Store((COUNTER_ALIVE_COUNT_0 + 1 - AliveListInIdx) * 4, 0);
 
-    
-    particlesBufferOut[DTid.x] = Data;
-}
\ No newline at end of file
+    // Every emitted particle is simulated in the same step
+    indirectArgs[0].Emit = MakeDispatchArgs(emitCount);
+    indirectArgs[0].Simulate = MakeDispatchArgs(aliveCountIn + emitCount);
+}
+
+[numthreads(PARTICLES_THREAD_GROUP_SIZE, 1, 1)]
+void CSEmit(uint3 DTid : SV_DispatchThreadID)
+{
+    RWStructuredBuffer<ParticleData> particles = ResourceDescriptorHeap[BindlessIndexParticlesBuffer];
+    RWStructuredBuffer<uint> deadList = ResourceDescriptorHeap[BindlessIndexDeadListBuffer];
+    RWStructuredBuffer<uint> aliveListIn = ResourceDescriptorHeap[BindlessIndexAliveListInBuffer];
+    RWByteAddressBuffer counters = ResourceDescriptorHeap[BindlessIndexCountersBuffer];
+
+    if (DTid.x >= counters.Load(COUNTER_EMIT_COUNT * 4))
+    {
+        return;
+    }
+
+    // The emit count is clamped to the dead count, the pop can't underflow
+    uint deadCountBefore;
+    counters.InterlockedAdd(COUNTER_DEAD_COUNT * 4, uint(-1), deadCountBefore);
+    const uint slotIdx = deadList[deadCountBefore - 1];
+
+    particles[slotIdx] = EmitParticle(StepIndex, DTid.x);
+
+    uint aliveIdx;
+    counters.InterlockedAdd((COUNTER_ALIVE_COUNT_0 + AliveListInIdx) * 4, 1, aliveIdx);
+    aliveListIn[aliveIdx] = slotIdx;
+}
+
+[numthreads(PARTICLES_THREAD_GROUP_SIZE, 1, 1)]
+void CSSimulate(uint3 DTid : SV_DispatchThreadID)
+{
+    RWStructuredBuffer<ParticleData> particles = ResourceDescriptorHeap[BindlessIndexParticlesBuffer];
+    RWStructuredBuffer<uint> deadList = ResourceDescriptorHeap[BindlessIndexDeadListBuffer];
+    RWStructuredBuffer<uint> aliveListIn = ResourceDescriptorHeap[BindlessIndexAliveListInBuffer];
+    RWStructuredBuffer<uint> aliveListOut = ResourceDescriptorHeap[BindlessIndexAliveListOutBuffer];
+    RWByteAddressBuffer counters = ResourceDescriptorHeap[BindlessIndexCountersBuffer];
+
+    if (DTid.x >= counters.Load((COUNTER_ALIVE_COUNT_0 + AliveListInIdx) * 4))
+    {
+        return;
+    }
+
+    const uint slotIdx = aliveListIn[DTid.x];
+    ParticleData p = particles[slotIdx];
+    const bool alive = Integrate(p, SimDeltaTime);
+    particles[slotIdx] = p;
+
+    if (alive)
+    {
+        uint aliveIdx;
+        counters.InterlockedAdd((COUNTER_ALIVE_COUNT_0 + 1 - AliveListInIdx) * 4, 1, aliveIdx);
+        aliveListOut[aliveIdx] = slotIdx;
+    }
+    else
+    {
+        uint deadIdx;
+        counters.InterlockedAdd(COUNTER_DEAD_COUNT * 4, 1, deadIdx);
+        deadList[deadIdx] = slotIdx;
+    }
+}
+
+// 1 thread, after the last step of the frame: one instance per alive particle, AliveListInIdx is the latest alive list
+[numthreads(1, 1, 1)]
+void CSPrepareDraw(uint3 DTid : SV_DispatchThreadID)
+{
+    RWByteAddressBuffer counters = ResourceDescriptorHeap[BindlessIndexCountersBuffer];
+    RWStructuredBuffer<ParticleIndirectArgs> indirectArgs = ResourceDescriptorHeap[BindlessIndexIndirectArgsBuffer];
+
+    D3D12_DRAW_INDEXED_ARGUMENTS drawArgs;
+    drawArgs.IndexCountPerInstance = MeshIndexCount;
+    drawArgs.InstanceCount = counters.Load((COUNTER_ALIVE_COUNT_0 + AliveListInIdx) * 4);
+    drawArgs.StartIndexLocation = 0;
+    drawArgs.BaseVertexLocation = 0;
+    drawArgs.StartInstanceLocation = 0;
+    indirectArgs[0].Draw = drawArgs;
+}
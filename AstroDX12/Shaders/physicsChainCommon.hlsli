@@ -10,8 +10,16 @@ struct ParticleData
 struct ChainElementData
 {
     ParticleData Particle;
-    int ParentIndex;
+    int ParentIndex; // Within its chain, the previous element (-1 for the root)
     float RestLength;
     bool Pinned;
     float Radius;
-};
\ No newline at end of file
+};
+
+// A chain is a range of the element buffer, its first element being the root
+struct ChainDesc
+{
+    uint FirstElement;
+    uint ElementCount;
+    float3 Origin; // Where the chain is laid out from on reset
+};
@@ -1,19 +1,6 @@
 #include "Shaders/physicsChainCommon.hlsli"
 #include "Shaders/Inc/DebugDrawData.hlsli"
-
-
-struct CollisionElement
-{
-    float3 Pos;
-    float Radius;
-};
-
-#define MAX_COLLISION_ELEMENTS 8
-struct CollisionCollectionData
-{
-    CollisionElement Elements[MAX_COLLISION_ELEMENTS];
-    int ElementCount;
-};
+#include "Shaders/Inc/Colliders.hlsli"
 
 cbuffer BindlessRenderResources : register(b0)
 {
@@ -22,34 +9,36 @@ cbuffer BindlessRenderResources : register(b0)
     int SimNeedsReset;
     int DebugDrawBufferUAVIndex;
     int DebugDrawCounterUAVIndex;
+    float SimDeltaTime; // Fixed step of the chain sim clock
+    int EmitDebugDraw; // Only the last step of a frame draws, the debug draw buffer is sized for one
+    int BindlessIndexChainDescBuffer;
+    uint ChainCount;
+    uint SolverMode; // SOLVER_MODE_PBD or SOLVER_MODE_XPBD_SMALL_STEPS
+    uint ConstraintIterationCount; // PBD iterations or XPBD substeps
+    float Compliance; // XPBD, inverse stiffness of the links, 0 is rigid
+    int BindlessIndexColliderBuffer;
+    int BindlessIndexColliderGridDescBuffer;
+    int BindlessIndexColliderCellStartsBuffer;
+    int BindlessIndexColliderIndicesBuffer;
+    int BindlessIndexColliderSdfSamplesBuffer;
 };
 
-#define GROUP_SIZE 32
+// Keep in sync with ChainPBD::SolverMode
+#define SOLVER_MODE_PBD 0
+#define SOLVER_MODE_XPBD_SMALL_STEPS 1
 
-groupshared float3 Pos[GROUP_SIZE];
-groupshared float3 PrevPos[GROUP_SIZE];
-groupshared bool Pinned[GROUP_SIZE];
-groupshared float RestLengths[GROUP_SIZE];
-groupshared int ParentIndex[GROUP_SIZE];
-groupshared float NodeRadii[GROUP_SIZE];
+// One threadgroup per chain, one thread per element: chains are at most this long (ChainPBD::MaxChainElementCount on the CPU)
+#define MAX_CHAIN_ELEMENTS 32
 
-CollisionCollectionData MakeCollisionData()
-{
-    CollisionCollectionData data;
-    data.Elements[0].Pos = float3(16.f, -24.f, 9.f);
-    data.Elements[0].Radius = 5.f;
-    
-    data.Elements[1].Pos = float3(18.f, -35.f, 10.f);
-    data.Elements[1].Radius = 3.f;
-    
-    data.Elements[2].Pos = float3(10.f, -47.f, 10.f);
-    data.Elements[2].Radius = 3.5f;
+groupshared float3 Pos[MAX_CHAIN_ELEMENTS];
+groupshared bool Pinned[MAX_CHAIN_ELEMENTS];
 
-    data.ElementCount = 3;
-    return data;
-}
+// Colliders drawn by the debug visualisation, the debug draw buffer is sized for a handful of objects
+#define MAX_DEBUG_DRAWN_COLLIDERS 64
 
-void HandleConstraints(inout float3 nodePos, inout float3 parentNodePos, in float restLength, in bool isParentPinned)
+// XPBD with the parent's inverse mass 0 if pinned, 1 otherwise: dLambda = -C / (1 + wParent + alpha / h^2), lambda restarting from 0 every substep.
+// With 0 compliance the weights are the PBD ones.
+void HandleConstraints(inout float3 nodePos, inout float3 parentNodePos, in float restLength, in bool isParentPinned, in float alphaTilde)
 {
     // Only length constraint for now
     const float3 NodeToParent = parentNodePos - nodePos;
@@ -57,63 +46,63 @@ void HandleConstraints(inout float3 nodePos, inout float3 parentNodePos, in floa
     const float lengthCorrection = distanceToParent - restLength;
     if (abs(lengthCorrection) > 0.0001f)
     {
-        const float3 correctionDir = normalize(NodeToParent) * lengthCorrection;
-        float w1 = isParentPinned ? 1.f : 0.5f;
-        float w2 = 1.f - w1;
-        nodePos += correctionDir * w1;
-        parentNodePos -= correctionDir * w2;
+        const float3 correctionDir = NodeToParent * (lengthCorrection / max(distanceToParent, 1e-6f));
+        const float parentInvMass = isParentPinned ? 0.f : 1.f;
+        const float invDenominator = 1.f / (1.f + parentInvMass + alphaTilde);
+        nodePos += correctionDir * invDenominator;
+        parentNodePos -= correctionDir * (parentInvMass * invDenominator);
     }
 }
 
-void HandleCollisions(inout float3 nodePos, in float nodeRadius, in CollisionCollectionData collisionData)
+// Every thread of the group runs this for its element, threads past the end of the chain only take part in the barriers.
+// Integration & collisions are per element, length constraints are solved in 2 phases, odd links then even links, so no two links of a phase share an element.
+// PBD: the velocity is fixed for the step, every iteration moves the elements by it over dt / iterationCount.
+// XPBD small steps: the same loop over substeps with compliant constraints, every substep deriving the velocity from its own displacement.
+// ChainPBD::CPUSolver (Src/Simulation/ChainPBDSolver.h) is the CPU reference of this solver.
+void PBDSolver(uint elementIdx, bool isElement, float dt, float3 externalForcesAcceleration, float3 velocity, float restLength, float nodeRadius, in ColliderScene colliderScene)
 {
-    for (int i = 0; i < collisionData.ElementCount; ++i)
+    const uint iterationCount = max(ConstraintIterationCount, 1);
+    const bool isSmallSteps = SolverMode == SOLVER_MODE_XPBD_SMALL_STEPS;
+    const float dtIt = dt / iterationCount;
+    const float dtItSqr = dtIt * dtIt;
+    const float dampeningFactor = isSmallSteps ? pow(0.99f, 1.f / iterationCount) : 0.99f; // 0.99 of the velocity kept per step
+    const float alphaTilde = isSmallSteps ? Compliance / dtItSqr : 0.f;
+    const bool isPinned = !isElement || Pinned[elementIdx];
+
+    for (uint iter = 0; iter < iterationCount; ++iter)
     {
-        const CollisionElement element = collisionData.Elements[i];
-        const float3 toElement = element.Pos - nodePos;
-        const float distance = length(toElement);
-        if (distance < element.Radius + nodeRadius)
+        const float3 subStepStartPos = Pos[elementIdx];
+        if (!isPinned)
         {
-            // Simple collision response - push the node out of the element
-            const float3 pushDir = normalize(toElement);
-            float diff = (element.Radius + nodeRadius) - distance;
-            nodePos += -pushDir * diff;
+            float3 newPos = subStepStartPos;
+            newPos += velocity * dtIt * dampeningFactor; // velocity + Damping
+            // factor in acceleration 
+            newPos += externalForcesAcceleration * dtItSqr;
+
+            ResolveCollisions(newPos, nodeRadius, colliderScene);
+            Pos[elementIdx] = newPos;
         }
-    }
-}
+        GroupMemoryBarrierWithGroupSync();
 
-void PBDSolver(float dt, float3 externalForcesAcceleration, uint elementCount, in CollisionCollectionData collisionData)
-{
-    
-    const uint iterationCount = 30;
-    const float dtIt = dt / iterationCount;
-    const float dtItSqr = dtIt * dtIt;
-    float3 velocity[GROUP_SIZE];
-    for(uint i = 0; i < elementCount; ++i)
-    {
-        velocity[i] = (Pos[i] - PrevPos[i]) / dt;
-    }
-        
-    for(uint iter = 0; iter < iterationCount; ++iter)
-    {
-        for(uint i = 0; i < elementCount; ++i)
+        [unroll]
+        for (uint firstLink = 1; firstLink <= 2; ++firstLink)
         {
-            if (!Pinned[i])
+            // Link to the parent, the previous element of the chain
+            if (!isPinned && elementIdx > 0 && (elementIdx & 1) == (firstLink & 1))
             {
-                float3 newPos = Pos[i];
-                const float dampeningFactor = 0.99f;
-                newPos += velocity[i] * dtIt * dampeningFactor; // velocity + Damping
-                // factor in acceleration 
-                newPos += externalForcesAcceleration * dtItSqr;
-
-                const uint parentIdx = ParentIndex[i];
-                
-                HandleCollisions(newPos, NodeRadii[i], collisionData);
-                HandleConstraints(newPos, Pos[parentIdx], RestLengths[i], Pinned[parentIdx]);
-                
-            
-                Pos[i] = newPos;
+                const uint parentIdx = elementIdx - 1;
+                float3 nodePos = Pos[elementIdx];
+                float3 parentNodePos = Pos[parentIdx];
+                HandleConstraints(nodePos, parentNodePos, restLength, Pinned[parentIdx], alphaTilde);
+                Pos[elementIdx] = nodePos;
+                Pos[parentIdx] = parentNodePos;
             }
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        if (isSmallSteps && !isPinned)
+        {
+            velocity = (Pos[elementIdx] - subStepStartPos) / dtIt;
         }
     }
 }
@@ -133,66 +122,89 @@ float3x3 CalculateRotationMatrix(float3 direction)
     return float3x3(xAxis, yAxis, zAxis);
 }
 
-void ResetChain(inout ChainElementData data, int idx)
+void ResetChain(inout ChainElementData data, float3 origin, uint idx)
 {
-    const float3 origin = float3(10.f, 0.f, 10.f);
     data.Particle.Pos = origin + float3(idx * data.RestLength, 0.f, 0.f);
     data.Particle.PrevPos = data.Particle.Pos;
 }
 
-#define LANECOUNT 15
-[numthreads(LANECOUNT, 1, 1)]
-void CSMain(uint3 DTid : SV_DispatchThreadID)
+// Dispatched with one group per chain
+[numthreads(MAX_CHAIN_ELEMENTS, 1, 1)]
+void CSMain(uint3 GroupID : SV_GroupID, uint3 GroupThreadID : SV_GroupThreadID)
 {
     StructuredBuffer<ChainElementData> chainDataBufferIn = ResourceDescriptorHeap[BindlessIndexChainElementBufferInput];
     RWStructuredBuffer<ChainElementData> chainDataBufferOut = ResourceDescriptorHeap[BindlessIndexChainElementBufferOutput];
     RWStructuredBuffer<DebugObjectData> drawDebugBufferOut = ResourceDescriptorHeap[DebugDrawBufferUAVIndex];
-    
-    ChainElementData Data = chainDataBufferIn[DTid.x];
-    
-    if (SimNeedsReset == 1)
+    StructuredBuffer<ChainDesc> chainDescBuffer = ResourceDescriptorHeap[BindlessIndexChainDescBuffer];
+
+    const uint chainIdx = GroupID.x;
+    if (chainIdx >= ChainCount)
+    {
+        return; // Whole group, no barrier is left waiting
+    }
+
+    const ChainDesc chain = chainDescBuffer[chainIdx];
+    const uint elementCount = min(chain.ElementCount, MAX_CHAIN_ELEMENTS);
+    const uint elementIdx = GroupThreadID.x;
+    const bool isElement = elementIdx < elementCount;
+    const uint bufferIdx = chain.FirstElement + elementIdx;
+
+    // Threads past the end of the chain still run the solver's barriers, they just don't load nor store anything
+    ChainElementData Data = (ChainElementData)0;
+    if (isElement)
     {
-        ResetChain(Data, DTid.x);
+        Data = chainDataBufferIn[bufferIdx];
+        if (SimNeedsReset == 1)
+        {
+            ResetChain(Data, chain.Origin, elementIdx);
+        }
     }
     
-    const float dt = 1.f / 60.f; // should be an input arg
+    const float dt = SimDeltaTime;
     const float gravityScale = 1000.f;
     const float3 gravity = float3(0.f, -9.81f, 0.f) * gravityScale;
-    const uint elementCount = LANECOUNT; //TODO: should be an input arg
     
-    Pos[DTid.x] = Data.Particle.Pos;
-    PrevPos[DTid.x] = Data.Particle.PrevPos;
-    Pinned[DTid.x] = Data.Pinned;
-    RestLengths[DTid.x] = Data.RestLength;
-    ParentIndex[DTid.x] = Data.ParentIndex;
-    NodeRadii[DTid.x] = Data.Radius;
+    Pos[elementIdx] = Data.Particle.Pos;
+    Pinned[elementIdx] = Data.Pinned;
+    const float3 velocity = (Data.Particle.Pos - Data.Particle.PrevPos) / dt;
     
     GroupMemoryBarrierWithGroupSync();
     
-    // Tmp - create collision data in shader for now
-    const CollisionCollectionData collisionData = MakeCollisionData();
+    const ColliderScene colliderScene = LoadColliderScene(
+        BindlessIndexColliderBuffer,
+        BindlessIndexColliderGridDescBuffer,
+        BindlessIndexColliderCellStartsBuffer,
+        BindlessIndexColliderIndicesBuffer,
+        BindlessIndexColliderSdfSamplesBuffer);
+
+    PBDSolver(elementIdx, isElement, dt, gravity, velocity, Data.RestLength, Data.Radius, colliderScene);
 
-    if (DTid.x == 0)
+    if (!isElement)
     {
-        PBDSolver(dt, gravity, elementCount, collisionData);
+        return;
     }
-    GroupMemoryBarrierWithGroupSync();
     
     Data.Particle.PrevPos = Data.Particle.Pos;
-    Data.Particle.Pos = Pos[DTid.x];
+    Data.Particle.Pos = Pos[elementIdx];
     
-    uint RotationRefNodeTopIndex = DTid.x;
-    uint RotationRefNodeBottomIndex = DTid.x+1;
-    if (DTid.x == elementCount - 1)
+    uint RotationRefNodeTopIndex = elementIdx;
+    uint RotationRefNodeBottomIndex = elementIdx + 1;
+    if (elementIdx == elementCount - 1)
     {
-        RotationRefNodeTopIndex = DTid.x-1;
-        RotationRefNodeBottomIndex = DTid.x;
+        RotationRefNodeTopIndex = max(elementIdx, 1) - 1;
+        RotationRefNodeBottomIndex = elementIdx;
         
     }
     Data.Particle.Rot = CalculateRotationMatrix(Pos[RotationRefNodeTopIndex] - Pos[RotationRefNodeBottomIndex]);
 
-    chainDataBufferOut[DTid.x] = Data;
+    chainDataBufferOut[bufferIdx] = Data;
     
+    // Only the first chain is drawn: the debug draw buffer is sized for a handful of objects, not thousands of chains
+    if (EmitDebugDraw == 0 || chainIdx != 0)
+    {
+        return;
+    }
+
     //--------------------------------------
     // Debug visualisation - allocate slots via atomic counter
     RWStructuredBuffer<uint> drawDebugCounterOut = ResourceDescriptorHeap[DebugDrawCounterUAVIndex];
@@ -209,24 +221,25 @@ void CSMain(uint3 DTid : SV_DispatchThreadID)
     );
     drawDebugBufferOut[mySlot].Color = float3(0.f, 0.f, 1.f);
     
-    //Visualise the collision elements
-    if (DTid.x == 0)
+    //Visualise the colliders, as their bounds
+    if (elementIdx == 0)
     {
-        for(int i = 0; i < collisionData.ElementCount; ++i)
+        StructuredBuffer<Collider> colliders = ResourceDescriptorHeap[BindlessIndexColliderBuffer];
+        const uint drawnColliderCount = min(colliderScene.Grid.ColliderCount, MAX_DEBUG_DRAWN_COLLIDERS);
+        for (uint i = 0; i < drawnColliderCount; ++i)
         {
-            const float3 pos = collisionData.Elements[i].Pos;
-            const float radius = collisionData.Elements[i].Radius;
+            const Collider collider = colliders[i];
+            const float3 size = GetColliderBoundsHalfSize(collider) * 2.f;
             
             uint collSlot;
             InterlockedAdd(drawDebugCounterOut[0], 1, collSlot);
             drawDebugBufferOut[collSlot].Transform = float4x4(
-                float4(radius * 2.f, 0.f, 0.f, 0.f),
-                float4(0.f, radius * 2.f, 0.f, 0.f),
-                float4(0.f, 0.f, radius * 2.f, 0.f),
-                float4(pos.x, pos.y, pos.z, 1.f)
+                float4(size.x, 0.f, 0.f, 0.f),
+                float4(0.f, size.y, 0.f, 0.f),
+                float4(0.f, 0.f, size.z, 0.f),
+                float4(collider.Center.x, collider.Center.y, collider.Center.z, 1.f)
             );
             drawDebugBufferOut[collSlot].Color = float3(1.f, 1.f, 0.f);
-
         }
     }
     //--------------------------------------
@@ -22,6 +22,7 @@ cbuffer BindlessRenderResources : register(b1)
 {
     int chainElementBufferIndex;
     int modelVertexDataBufferIdx;
+    float SimInterpolationAlpha; // Fraction of a sim step elapsed since the latest sim state
 };
 
 struct VertexData
@@ -46,7 +47,9 @@ PSInput VS(uint VertexID : SV_VertexID, uint InstanceID : SV_InstanceID)
 	// Transform to homogeneous clip space.
     const float3 posL = vertexData[VertexID].posLocal;
     const float3x3 particleRotation = chainElementData[InstanceID].Particle.Rot;
-    const float3 posW = chainElementData[InstanceID].Particle.Pos + mul(posL, particleRotation);
+    // The sim runs at a fixed rate, blend its last two states to the current render time
+    const float3 simPos = lerp(chainElementData[InstanceID].Particle.PrevPos, chainElementData[InstanceID].Particle.Pos, SimInterpolationAlpha);
+    const float3 posW = simPos + mul(posL, particleRotation);
     o.PosH = mul(float4(posW, 1.0f), gViewProj);
     o.Color = chainElementData[InstanceID].Pinned ? float4(1.f, 0.f, 0.f, 1.f) : float4(1.f, 1.f, 1.f, 1.f);
     
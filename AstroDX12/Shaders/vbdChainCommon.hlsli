@@ -14,4 +14,6 @@ struct VBDChainElementData
     float RestLength;
     bool Pinned;
     float Radius;
+    uint Color; // Graph color, elements linked by ParentIndex never share one
+    float3 Acceleration; // Of the last step, for the next one's initial guess
 };
@@ -8,34 +8,170 @@ cbuffer BindlessRenderResources : register(b0)
     int SimNeedsReset;
     int DebugDrawBufferUAVIndex;
     int DebugDrawCounterUAVIndex;
+    float SimDeltaTime; // Fixed step of the chain sim clock
+    int EmitDebugDraw; // Only the last step of a frame draws, the debug draw buffer is sized for one
+    uint ElementCount;
+    uint ColorCount; // Of the constraint graph, colored at init
 };
 
+// One thread per element (ChainVBD::MaxChainElementCount on the CPU)
 #define GROUP_SIZE 32
 
 groupshared float3 Pos[GROUP_SIZE];
-groupshared float3 PrevPos[GROUP_SIZE];
-groupshared float3 InertialPos[GROUP_SIZE]; // x̃ — the inertial prediction
 groupshared bool Pinned[GROUP_SIZE];
 groupshared float RestLengths[GROUP_SIZE];
 groupshared int ParentIndex[GROUP_SIZE];
-groupshared float NodeRadii[GROUP_SIZE];
 
+struct CollisionElement
+{
+    float3 Pos;
+    float Radius;
+};
+
+#define MAX_COLLISION_ELEMENTS 8
+struct CollisionCollectionData
+{
+    CollisionElement Elements[MAX_COLLISION_ELEMENTS];
+    int ElementCount;
+};
+
+// Same colliders as the PBD chain
+CollisionCollectionData MakeCollisionData()
+{
+    CollisionCollectionData data;
+    data.Elements[0].Pos = float3(16.f, -24.f, 9.f);
+    data.Elements[0].Radius = 5.f;
+    
+    data.Elements[1].Pos = float3(18.f, -35.f, 10.f);
+    data.Elements[1].Radius = 3.f;
+    
+    data.Elements[2].Pos = float3(10.f, -47.f, 10.f);
+    data.Elements[2].Radius = 3.5f;
+
+    data.ElementCount = 3;
+    return data;
+}
+
+struct VBDSolverSettings
+{
+    uint IterationCount;
+    float Mass;
+    float Stiffness;
+    float CollisionStiffness;
+    float Damping;
+};
+
+// Force & Hessian of a spring between x and other: E = k/2 (|x - other| - restLength)^2.
+// The Hessian's transverse term is clamped at 0 when compressed, keeping it positive semi-definite.
+void AccumulateSpring(float3 x, float3 other, float restLength, float stiffness, inout float3 force, inout float3x3 hessian)
+{
+    const float3 d = x - other;
+    const float len = length(d);
+    if (len < 1e-6f)
+    {
+        return;
+    }
+
+    const float3 n = d / len;
+    const float3x3 nnT = float3x3(n * n.x, n * n.y, n * n.z);
+    const float3x3 identity = float3x3(1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f);
+    const float transverse = max(0.f, 1.f - restLength / len);
+    force -= n * (stiffness * (len - restLength));
+    hessian += (nnT + (identity - nnT) * transverse) * stiffness;
+}
+
+// Penalty spring pushing x out of a sphere it penetrates
+void AccumulateCollision(float3 x, float radius, CollisionElement sphere, float stiffness, inout float3 force, inout float3x3 hessian)
+{
+    const float3 d = x - sphere.Pos;
+    const float distance = length(d);
+    const float penetration = sphere.Radius + radius - distance;
+    if (penetration <= 0.f || distance < 1e-6f)
+    {
+        return;
+    }
+
+    const float3 n = d / distance;
+    force += n * (stiffness * penetration);
+    hessian += float3x3(n * n.x, n * n.y, n * n.z) * stiffness;
+}
+
+// dx = H^-1 f through the adjugate, no step if H is singular
+float3 Solve3x3(float3x3 H, float3 f)
+{
+    const float3 c0 = cross(H[1], H[2]);
+    const float3 c1 = cross(H[2], H[0]);
+    const float3 c2 = cross(H[0], H[1]);
+    const float det = dot(H[0], c0);
+    if (abs(det) < 1e-12f)
+    {
+        return float3(0.f, 0.f, 0.f);
+    }
+
+    // adj(H) has the cofactor vectors as columns, H being symmetric they can be used as rows
+    return mul(float3x3(c0, c1, c2), f) / det;
+}
 
 //=============================================================================
-// TODO: You will implement this function step by step!
-//
-// VBD Solver — the core algorithm:
-//   1. Compute inertial prediction x̃ for each link
-//   2. For each Gauss-Seidel iteration:
-//      a. For each non-pinned link:
-//         - Assemble gradient g and Hessian H from inertia + constraints
-//         - Solve 3x3 system: H * dx = -g
-//         - Update position: x -= dx
-//         - Handle collisions
+// VBD Solver (Vertex Block Descent, Chen et al. 2024)
+//   1. Inertial prediction y = x + dt * v * damping + dt^2 * g, the initial guess only taking the part of g
+//      the element's last step accelerated by (adaptive initialization, see ChainVBDSolver.h)
+//   2. For each Gauss-Seidel iteration, color by color:
+//      every non-pinned element of the color (one per thread, in parallel) assembles
+//      the force f & Hessian H of its local energy: inertia + springs to its parent & children + collisions,
+//      then takes one Newton step x += H^-1 f
+// Elements of a color share no spring, a barrier between colors is all the sync needed.
+// ChainVBD::Step (Src/Simulation/ChainVBDSolver.h) is the CPU reference of this solver.
 //=============================================================================
-void VBDSolver(float dt, float3 externalForces, uint elementCount)
+void VBDSolver(uint elementIdx, bool isElement, float3 velocity, float3 prevAcceleration, float dt, float3 externalForces, float radius, uint color, in VBDSolverSettings settings, in CollisionCollectionData collisionData)
 {
-    // Your implementation goes here!
+    const float inertia = settings.Mass / (dt * dt);
+    const bool isSolved = isElement && !Pinned[elementIdx];
+
+    float3 inertialPos = float3(0.f, 0.f, 0.f);
+    if (isSolved)
+    {
+        const float3 freeMotion = Pos[elementIdx] + velocity * (dt * settings.Damping);
+        const float externalLength = length(externalForces);
+        const float3 externalDir = externalLength > 0.f ? externalForces / externalLength : float3(0.f, 0.f, 0.f);
+        const float adaptiveExternal = clamp(dot(prevAcceleration, externalDir), 0.f, externalLength);
+        inertialPos = freeMotion + externalForces * (dt * dt);
+        Pos[elementIdx] = freeMotion + externalDir * (adaptiveExternal * dt * dt);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint iter = 0; iter < settings.IterationCount; ++iter)
+    {
+        for (uint colorIdx = 0; colorIdx < ColorCount; ++colorIdx)
+        {
+            if (isSolved && color == colorIdx)
+            {
+                const float3 x = Pos[elementIdx];
+                float3 force = (inertialPos - x) * inertia;
+                float3x3 hessian = float3x3(inertia, 0.f, 0.f, 0.f, inertia, 0.f, 0.f, 0.f, inertia);
+
+                const int parentIdx = ParentIndex[elementIdx];
+                if (parentIdx >= 0)
+                {
+                    AccumulateSpring(x, Pos[parentIdx], RestLengths[elementIdx], settings.Stiffness, force, hessian);
+                }
+                for (uint childIdx = 0; childIdx < min(ElementCount, GROUP_SIZE); ++childIdx)
+                {
+                    if (ParentIndex[childIdx] == int(elementIdx))
+                    {
+                        AccumulateSpring(x, Pos[childIdx], RestLengths[childIdx], settings.Stiffness, force, hessian);
+                    }
+                }
+                for (int i = 0; i < collisionData.ElementCount; ++i)
+                {
+                    AccumulateCollision(x, radius, collisionData.Elements[i], settings.CollisionStiffness, force, hessian);
+                }
+
+                Pos[elementIdx] = x + Solve3x3(hessian, force);
+            }
+            GroupMemoryBarrierWithGroupSync();
+        }
+    }
 }
 
 
@@ -59,59 +195,84 @@ void ResetChain(inout VBDChainElementData data, int idx)
     const float3 origin = float3(10.f, 0.f, 10.f);
     data.Particle.Pos = origin + float3(idx * data.RestLength, 0.f, 0.f);
     data.Particle.PrevPos = data.Particle.Pos;
+    data.Acceleration = float3(0.f, 0.f, 0.f);
 }
 
-#define LANECOUNT 15
-[numthreads(LANECOUNT, 1, 1)]
+[numthreads(GROUP_SIZE, 1, 1)]
 void CSMain(uint3 DTid : SV_DispatchThreadID)
 {
     StructuredBuffer<VBDChainElementData> chainDataBufferIn = ResourceDescriptorHeap[BindlessIndexChainElementBufferInput];
     RWStructuredBuffer<VBDChainElementData> chainDataBufferOut = ResourceDescriptorHeap[BindlessIndexChainElementBufferOutput];
     RWStructuredBuffer<DebugObjectData> drawDebugBufferOut = ResourceDescriptorHeap[DebugDrawBufferUAVIndex];
     
-    VBDChainElementData Data = chainDataBufferIn[DTid.x];
-    
-    if (SimNeedsReset == 1)
+    const uint elementIdx = DTid.x;
+    const uint elementCount = min(ElementCount, GROUP_SIZE);
+    const bool isElement = elementIdx < elementCount;
+
+    // Threads past the end of the chain still run the solver's barriers, they just don't load nor store anything
+    VBDChainElementData Data = (VBDChainElementData)0;
+    Data.ParentIndex = -1;
+    if (isElement)
     {
-        ResetChain(Data, DTid.x);
+        Data = chainDataBufferIn[elementIdx];
+        if (SimNeedsReset == 1)
+        {
+            ResetChain(Data, elementIdx);
+        }
     }
     
-    const float dt = 1.f / 60.f;
-    const float3 gravity = float3(0.f, -9.81f, 0.f);
-    const uint elementCount = LANECOUNT;
+    const float dt = SimDeltaTime;
+    const float gravityScale = 1000.f; // Same scale as the PBD chain, for the two to be comparable
+    const float3 gravity = float3(0.f, -9.81f, 0.f) * gravityScale;
+
+    // Keep in sync with ChainVBD::SolverSettings
+    VBDSolverSettings settings;
+    settings.IterationCount = 30;
+    settings.Mass = 1.f;
+    settings.Stiffness = 1e6f;
+    settings.CollisionStiffness = 1e6f;
+    settings.Damping = 0.99f;
     
     // Load into groupshared memory
-    Pos[DTid.x] = Data.Particle.Pos;
-    PrevPos[DTid.x] = Data.Particle.PrevPos;
-    Pinned[DTid.x] = Data.Pinned;
-    RestLengths[DTid.x] = Data.RestLength;
-    ParentIndex[DTid.x] = Data.ParentIndex;
-    NodeRadii[DTid.x] = Data.Radius;
+    Pos[elementIdx] = Data.Particle.Pos;
+    Pinned[elementIdx] = Data.Pinned;
+    RestLengths[elementIdx] = Data.RestLength;
+    ParentIndex[elementIdx] = Data.ParentIndex;
+    const float3 velocity = (Data.Particle.Pos - Data.Particle.PrevPos) / dt;
     
     GroupMemoryBarrierWithGroupSync();
 
-    // Thread 0 runs the VBD solver sequentially (Gauss-Seidel)
-    if (DTid.x == 0)
+    // Tmp - create collision data in shader for now
+    const CollisionCollectionData collisionData = MakeCollisionData();
+
+    VBDSolver(elementIdx, isElement, velocity, Data.Acceleration, dt, gravity, Data.Radius, Data.Color, settings, collisionData);
+
+    if (!isElement)
     {
-        VBDSolver(dt, gravity, elementCount);
+        return;
     }
-    GroupMemoryBarrierWithGroupSync();
     
     // Write results back
+    Data.Acceleration = ((Pos[elementIdx] - Data.Particle.Pos) / dt - velocity) / dt;
     Data.Particle.PrevPos = Data.Particle.Pos;
-    Data.Particle.Pos = Pos[DTid.x];
+    Data.Particle.Pos = Pos[elementIdx];
     
-    uint RotationRefNodeTopIndex = DTid.x;
-    uint RotationRefNodeBottomIndex = DTid.x+1;
-    if (DTid.x == elementCount - 1)
+    uint RotationRefNodeTopIndex = elementIdx;
+    uint RotationRefNodeBottomIndex = elementIdx + 1;
+    if (elementIdx == elementCount - 1)
     {
-        RotationRefNodeTopIndex = DTid.x-1;
-        RotationRefNodeBottomIndex = DTid.x;
+        RotationRefNodeTopIndex = max(elementIdx, 1) - 1;
+        RotationRefNodeBottomIndex = elementIdx;
     }
     Data.Particle.Rot = CalculateRotationMatrix(Pos[RotationRefNodeTopIndex] - Pos[RotationRefNodeBottomIndex]);
 
-    chainDataBufferOut[DTid.x] = Data;
+    chainDataBufferOut[elementIdx] = Data;
     
+    if (EmitDebugDraw == 0)
+    {
+        return;
+    }
+
     //--------------------------------------
     // Debug visualisation - allocate slots via atomic counter
     RWStructuredBuffer<uint> drawDebugCounterOut = ResourceDescriptorHeap[DebugDrawCounterUAVIndex];
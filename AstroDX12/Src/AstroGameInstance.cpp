@@ -4,6 +4,8 @@
 #include <Rendering/RenderData/VertexData.h>
 #include <Rendering/RenderData/VertexDataFactory.h>
 #include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RendererContext.h>
+#include <Rendering/Common/SimStateBackendDX12.h>
 #include <Rendering/Common/VertexDataInputLayoutLibrary.h>
 #include <Rendering/Compute/ComputableObject.h>
 #include <Rendering/Common/VectorTypes.h>
@@ -26,11 +28,108 @@
 
 #include <GameContent/Scene/SceneLoader.h>
 
+#include <cmath>
+#include <filesystem>
+
 namespace
 {
 	namespace
 	{
-		constexpr size_t NumFrameResources = 3;
+		constexpr FramePacingPolicy DefaultFramePacingPolicy = FramePacingPolicy::MaximumThroughput;
+
+		// Simulation rates, independent from the render rate. Past MaxStepsPerFrame the sim slows down instead of stalling the frame.
+		constexpr float ParticlesSimRateHz = 60.f;
+		constexpr uint32_t ParticlesMaxCount = 64 * 1024;
+		constexpr float ParticlesEmissionRate = 12000.f; // Particles per second, ~3.5s lifetime: ~42K alive
+		constexpr float ChainsSimRateHz = 60.f;
+		constexpr float FluidSim2DRateHz = 30.f;
+		constexpr uint32_t MaxSimStepsPerFrame = 4;
+
+		// The 2D fluid sim's quality / bandwidth trade-off: the bandwidth scales with the cell count, half precision storage about halves the velocity & density's
+		constexpr ComputePassFluidSim2D::SimSettings FluidSim2DSettings = { .GridResolution = 256, .ThreadGroupSize = ivec2(16, 16), .HalfPrecisionStorage = false, .HalfPrecisionPressure = false };
+
+		// Batched PBD chains, solved one threadgroup per chain
+		constexpr uint32_t PhysicsChainCount = 16;
+		constexpr uint32_t PhysicsChainElementCount = 15;
+	}
+
+	// Frame pacing only needs the renderer's frame fence
+	class RendererFrameFence final : public IFrameFence
+	{
+	public:
+		explicit RendererFrameFence(IRenderer& renderer)
+			: m_renderer(renderer)
+		{
+		}
+
+		virtual uint64_t GetCompletedValue() const override
+		{
+			return m_renderer.GetLastCompletedFence();
+		}
+
+		virtual void WaitForValue(uint64_t fenceValue) override
+		{
+			m_renderer.WaitForFence(fenceValue);
+		}
+
+	private:
+		IRenderer& m_renderer;
+	};
+
+	// The PhysicsChain scene: the original 3 spheres under the first chain, a capsule, rounded box or baked SDF torus under every other one,
+	// and a bed of 256 spheres below them all, in reach of the chain ends. Chains hang from a grid starting at (10, 0, 10), 16 apart.
+	Colliders::ColliderSet MakePhysicsChainColliders(uint32_t chainCount)
+	{
+		Colliders::ColliderSet colliderSet;
+		for (const ChainPBD::CollisionSphere& sphere : ChainPBD::MakeDefaultCollisionSpheres())
+		{
+			colliderSet.AddSphere(sphere.Pos, sphere.Radius);
+		}
+
+		constexpr float ChainGridSpacing = 16.f;
+		const uint32_t chainGridSize = uint32_t(std::ceil(std::sqrt(float(chainCount))));
+		const float tilt[4] = { 0.f, 0.f, 0.3826834f, 0.9238795f }; // 45 degrees around z
+		for (uint32_t chainIdx = 1; chainIdx < chainCount; ++chainIdx)
+		{
+			const float x = 10.f + float(chainIdx % chainGridSize) * ChainGridSpacing + 6.f;
+			const float z = 10.f + float(chainIdx / chainGridSize) * ChainGridSpacing;
+			const float center[3] = { x, -40.f, z };
+			switch (chainIdx % 3)
+			{
+			case 0:
+			{
+				const float start[3] = { x - 6.f, -36.f, z - 4.f };
+				const float end[3] = { x + 6.f, -44.f, z + 4.f };
+				colliderSet.AddCapsule(start, end, 3.f);
+				break;
+			}
+			case 1:
+			{
+				const float halfSize[3] = { 5.f, 3.f, 4.f };
+				colliderSet.AddBox(center, halfSize, tilt, 1.f);
+				break;
+			}
+			case 2:
+			{
+				const float halfSize[3] = { 8.f, 4.f, 8.f };
+				const uint32_t resolution[3] = { 24, 12, 24 };
+				colliderSet.AddSdf(center, halfSize, tilt, resolution, [](float localX, float localY, float localZ)
+				{
+					const float ringDistance = std::sqrt(localX * localX + localZ * localZ) - 5.f;
+					return std::sqrt(ringDistance * ringDistance + localY * localY) - 2.f;
+				});
+				break;
+			}
+			}
+		}
+
+		const float bedSize = float(chainGridSize) * ChainGridSpacing + 32.f;
+		for (uint32_t sphereIdx = 0; sphereIdx < 16 * 16; ++sphereIdx)
+		{
+			const float pos[3] = { -6.f + float(sphereIdx % 16) * bedSize / 16.f, -118.f, -6.f + float(sphereIdx / 16) * bedSize / 16.f };
+			colliderSet.AddSphere(pos, 3.f);
+		}
+		return colliderSet;
 	}
 }
 
@@ -40,7 +139,6 @@ AstroGameInstance::AstroGameInstance()
 	, m_cameraPos(0,0,0)
 	, m_frameResources()
 	, m_currentFrameResource(nullptr)
-	, m_currentFrameResourceIndex(0)
 	, m_meshLibrary(std::make_unique<MeshLibrary>())
 	, m_gpuPasses()
 {
@@ -59,35 +157,34 @@ void AstroGameInstance::InitCamera()
 void AstroGameInstance::CreateConstantBufferViews()
 {
 	// Create CBV descriptors shared for the whole render pass, in each frame resource, after all the renderable objects in the renderable object heap
-	for (int16_t frameIdx = 0; frameIdx < NumFrameResources; ++frameIdx)
+	// The constants themselves live in the upload ring, start with zeroed data until the first UpdateMainRenderPassConstantBuffer
+	auto uploadRing = m_renderer->GetRendererContext().UploadRing.lock();
+	const UINT passCBByteSize = AstroTools::Rendering::CalcConstantBufferByteSize(sizeof(RenderPassConstants));
+	for (uint32_t frameIdx = 0; frameIdx < m_framesInFlight; ++frameIdx)
 	{
-		UINT passCBByteSize = m_frameResources[frameIdx]->PassConstantBuffer->GetElementByteSize();
-		auto passCB = m_frameResources[frameIdx]->PassConstantBuffer->Resource();
-
-		D3D12_GPU_VIRTUAL_ADDRESS cbAddress = passCB->GetGPUVirtualAddress();
+		const UploadAllocation passCBAllocation = uploadRing->Allocate(passCBByteSize, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		memset(passCBAllocation.CPUAddress, 0, passCBByteSize);
 
 		// Finalise creation of constant buffer view
-		const auto cbvHeapDescriptorIndex = m_renderer->CreateConstantBufferView(cbAddress, passCBByteSize);
-		m_frameResources[frameIdx]->PassConstantBuffer->SetHeapDescriptorIndex(cbvHeapDescriptorIndex);
+		const auto cbvHeapDescriptorIndex = m_renderer->CreateConstantBufferView(passCBAllocation.GPUAddress, passCBByteSize);
+		m_frameResources[frameIdx]->PassConstantBufferGPUAddress = passCBAllocation.GPUAddress;
+		m_frameResources[frameIdx]->PassConstantBufferHeapIndex = cbvHeapDescriptorIndex;
 	}
 }
 
 void AstroGameInstance::BuildFrameResources()
 {
-	m_renderer->BuildFrameResources(m_frameResources, NumFrameResources);
+	m_renderer->BuildFrameResources(m_frameResources, int(m_framesInFlight));
+
+	m_frameFence = std::make_unique<RendererFrameFence>(*m_renderer);
+	m_framePacer = std::make_unique<FramePacer>(m_framesInFlight, DefaultFramePacingPolicy, *m_frameFence, m_frameClock);
 }
 
 void AstroGameInstance::UpdateFrameResource()
 {
-	// cycle through the Circular buffer
-	m_currentFrameResourceIndex = (m_currentFrameResourceIndex + 1) % NumFrameResources;
-	m_currentFrameResource = m_frameResources[m_currentFrameResourceIndex].get();
-
-	if (m_currentFrameResource->Fence != 0 &&
-		m_renderer->GetLastCompletedFence() < m_currentFrameResource->Fence)
-	{
-		m_renderer->WaitForFence(m_currentFrameResource->Fence);
-	}
+	// Cycle through the circular buffer, the pacer waits until the GPU is done with the frame resource (or further, depending on its policy)
+	const uint32_t frameResourceIndex = m_framePacer->BeginFrame();
+	m_currentFrameResource = m_frameResources[frameResourceIndex].get();
 }
 
 void AstroGameInstance::UpdateMainRenderPassConstantBuffer(float deltaTime)
@@ -119,8 +216,28 @@ void AstroGameInstance::UpdateMainRenderPassConstantBuffer(float deltaTime)
 	renderPassCB.TotalTime = GetTotalTime();
 	renderPassCB.DeltaTime = deltaTime;
 
-	auto currentPassCB = m_currentFrameResource->PassConstantBuffer.get();
-	currentPassCB->CopyData(0, renderPassCB);
+	if (!m_hasPrevPassCamera)
+	{
+		m_prevViewProj = renderPassCB.ViewProj;
+		m_prevInvViewProj = renderPassCB.InvViewProj;
+		m_prevCameraPos = renderPassCB.EyePosWorld;
+		m_hasPrevPassCamera = true;
+	}
+	renderPassCB.PrevViewProj = m_prevViewProj;
+	renderPassCB.PrevInvViewProj = m_prevInvViewProj;
+	renderPassCB.PrevEyePosWorld = m_prevCameraPos;
+	m_prevViewProj = renderPassCB.ViewProj;
+	m_prevInvViewProj = renderPassCB.InvViewProj;
+	m_prevCameraPos = renderPassCB.EyePosWorld;
+
+	// Fresh ring allocation every frame, the previous one may still be read by in-flight frames.
+	// Re-pointing this frame resource's CBV is safe since we waited on its fence in UpdateFrameResource.
+	const UINT passCBByteSize = AstroTools::Rendering::CalcConstantBufferByteSize(sizeof(RenderPassConstants));
+	const UploadAllocation passCBAllocation = m_renderer->GetRendererContext().UploadRing.lock()->Allocate(passCBByteSize, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	memcpy(passCBAllocation.CPUAddress, &renderPassCB, sizeof(RenderPassConstants));
+
+	m_currentFrameResource->PassConstantBufferGPUAddress = passCBAllocation.GPUAddress;
+	m_renderer->CreateConstantBufferView(passCBAllocation.GPUAddress, passCBByteSize, m_currentFrameResource->PassConstantBufferHeapIndex);
 }
 
 void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shaderLibrary)
@@ -131,7 +248,7 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 
 	// Base Geo
 	auto baseGeoPass = std::make_shared<BasePassSceneGeometry>();
-	baseGeoPass->Init(m_renderer.get(), shaderLibrary, *m_meshLibrary, NumFrameResources);
+	baseGeoPass->Init(m_renderer.get(), shaderLibrary, *m_meshLibrary, int16_t(m_framesInFlight));
 	m_gpuPasses.push_back(baseGeoPass);
 
 	// Debug Draw
@@ -142,20 +259,25 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 	debugDrawRenderPass->Init(m_renderer.get(), shaderLibrary, *m_meshLibrary.get());
 
 	// Particle System
-	auto particlesSimPass = std::make_shared<ComputePassParticles>();
-	particlesSimPass->Init(m_renderer.get(), shaderLibrary);
+	auto particlesSimPass = std::make_shared<ComputePassParticles>(ParticlesMaxCount, ParticlesEmissionRate);
+	particlesSimPass->Init(m_renderer.get(), shaderLibrary, *m_meshLibrary.get());
 	std::weak_ptr<ComputePassParticles> particleSimPassWeak = particlesSimPass;
 	m_gpuPasses.push_back(particlesSimPass);
+	m_simClocks.emplace(particlesSimPass.get(), FixedStepScheduler(ParticlesSimRateHz, MaxSimStepsPerFrame));
+	m_simStateOwners.emplace_back(particlesSimPass.get(), particlesSimPass.get());
 
 	auto particlesRenderPass = std::make_shared<GraphicsPassParticles>();
 	particlesRenderPass->Init(particleSimPassWeak, m_renderer.get(), shaderLibrary, *m_meshLibrary.get());
 	m_gpuPasses.push_back(particlesRenderPass);
 
 	// Physics Chain
-	auto physicsChainSimPass = std::make_shared<ComputePassPhysicsChain>();
+	auto physicsChainSimPass = std::make_shared<ComputePassPhysicsChain>(PhysicsChainCount, PhysicsChainElementCount);
 	physicsChainSimPass->Init(m_renderer.get(), shaderLibrary, debugDrawRenderPass->GetDebugObjectsBufferUAVIndex(), debugDrawRenderPass->GetDebugCounterBufferUAVIndex());
+	physicsChainSimPass->SetColliders(MakePhysicsChainColliders(PhysicsChainCount));
 	std::weak_ptr<ComputePassPhysicsChain> physicsChainSimPassWeak = physicsChainSimPass;
 	m_gpuPasses.push_back(physicsChainSimPass);
+	m_simClocks.emplace(physicsChainSimPass.get(), FixedStepScheduler(ChainsSimRateHz, MaxSimStepsPerFrame));
+	m_simStateOwners.emplace_back(physicsChainSimPass.get(), physicsChainSimPass.get());
 
 	auto physicsChainRenderPass = std::make_shared<GraphicsPassPhysicsChain>();
 	physicsChainRenderPass->Init(physicsChainSimPassWeak, m_renderer.get(), shaderLibrary, *m_meshLibrary.get());
@@ -166,6 +288,8 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 	vbdChainSimPass->Init(m_renderer.get(), shaderLibrary, debugDrawRenderPass->GetDebugObjectsBufferUAVIndex(), debugDrawRenderPass->GetDebugCounterBufferUAVIndex());
 	std::weak_ptr<ComputePassVBDChain> vbdChainSimPassWeak = vbdChainSimPass;
 	m_gpuPasses.push_back(vbdChainSimPass);
+	m_simClocks.emplace(vbdChainSimPass.get(), FixedStepScheduler(ChainsSimRateHz, MaxSimStepsPerFrame));
+	m_simStateOwners.emplace_back(vbdChainSimPass.get(), vbdChainSimPass.get());
 
 	auto vbdChainRenderPass = std::make_shared<GraphicsPassVBDChain>();
 	vbdChainRenderPass->Init(vbdChainSimPassWeak, m_renderer.get(), shaderLibrary, *m_meshLibrary.get());
@@ -173,9 +297,11 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 
 	// Eulerian Fluid Sim 2D
 	auto fluidSim2DComputePass = std::make_shared<ComputePassFluidSim2D>();
-	fluidSim2DComputePass->Init(m_renderer.get(), shaderLibrary);
+	fluidSim2DComputePass->Init(m_renderer.get(), shaderLibrary, FluidSim2DSettings);
 	std::weak_ptr<ComputePassFluidSim2D> fluidSim2DComputePassWeak = fluidSim2DComputePass;
 	m_gpuPasses.push_back(fluidSim2DComputePass);
+	m_simClocks.emplace(fluidSim2DComputePass.get(), FixedStepScheduler(FluidSim2DRateHz, MaxSimStepsPerFrame));
+	m_simStateOwners.emplace_back(fluidSim2DComputePass.get(), fluidSim2DComputePass.get());
 
 	auto fluidSim2DGraphicsPass = std::make_shared<GraphicsPassFluidSim2D>();
 	fluidSim2DGraphicsPass->Init(fluidSim2DComputePassWeak, m_renderer.get(), shaderLibrary, *m_meshLibrary.get());
@@ -183,7 +309,7 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 
 	// PIC/FLIP 3D Fluid Sim
 	auto fluidSim3DComputePass = std::make_shared<ComputePassPicFlip3D>();
-	fluidSim3DComputePass->Init(m_renderer.get(), shaderLibrary, debugDrawLinePass);
+	fluidSim3DComputePass->Init(m_renderer.get(), shaderLibrary, debugDrawLinePass, int(m_framesInFlight));
 	std::weak_ptr<ComputePassPicFlip3D> fluidSim3DComputePassWeak = fluidSim3DComputePass;
 	m_gpuPasses.push_back(fluidSim3DComputePass);
 
@@ -197,7 +323,7 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 
 	// Raymarch SDF Scene (depends on particle sim data)
 	auto raymarchSDFScenePass = std::make_shared<ComputePassRaymarchScene>();
-	raymarchSDFScenePass->Init(m_renderer.get(), shaderLibrary, particleSimPassWeak);
+	raymarchSDFScenePass->Init(m_renderer.get(), shaderLibrary, particleSimPassWeak, &m_raymarchSettings, &m_raymarchStats, int(m_framesInFlight));
 	const int32_t GBufferColorViewIndex = raymarchSDFScenePass->GetColorRTViewIndex();
 	m_gpuPasses.push_back(raymarchSDFScenePass);
 
@@ -243,16 +369,98 @@ void AstroGameInstance::CreatePasses(AstroTools::Rendering::ShaderLibrary& shade
 
 	// ImGui pass (always on, not part of DemoManager)
 	auto imguiPass = std::make_shared<GraphicsPassImGui>();
-	imguiPass->Init(m_hwnd, m_renderer->GetRendererContext(), NumFrameResources, &m_demoManager);
+	imguiPass->Init(m_hwnd, m_renderer->GetRendererContext(), int(m_framesInFlight), &m_demoManager, m_framePacer.get(), &m_simStateRequests, &m_raymarchSettings, &m_raymarchStats);
 	m_gpuPasses.push_back(imguiPass);
 }
 
+void AstroGameInstance::CollectUIInputEvents(std::vector<RecordedInputEvent>& outEvents)
+{
+	for (const DemoToggleRequest& request : m_demoManager.TakeToggleRequests())
+	{
+		outEvents.push_back({ RecordedInputType::DemoToggle, request.demoIdx, request.enabled ? 1 : 0, 0 });
+	}
+}
+
+void AstroGameInstance::ApplyDemoToggle(uint32_t demoIdx, bool enabled)
+{
+	m_demoManager.SetDemoEnabled(demoIdx, enabled);
+}
+
+void AstroGameInstance::ProcessSimStateRequests()
+{
+	// Save takes precedence if both were requested in the same frame
+	const bool save = m_simStateRequests.SaveRequested;
+	const bool load = m_simStateRequests.LoadRequested && !save;
+	m_simStateRequests.SaveRequested = false;
+	m_simStateRequests.LoadRequested = false;
+	if (!save && !load)
+	{
+		return;
+	}
+
+	if (!m_simStateBackend)
+	{
+		m_simStateBackend = std::make_unique<SimStateBackendDX12>(*m_renderer);
+	}
+
+	const std::string snapshotDirectory = GetWorkingDirectory() + "\\SimSnapshots";
+	std::error_code directoryError;
+	std::filesystem::create_directories(snapshotDirectory, directoryError);
+
+	std::string result;
+	for (const auto& [pass, owner] : m_simStateOwners)
+	{
+		const std::string simName(owner->GetSimStateName());
+		if (!pass->IsEnabled())
+		{
+			result += simName + ": skipped, disabled\n";
+			continue;
+		}
+
+		const std::string path = snapshotDirectory + "\\" + simName + ".asim";
+		if (save)
+		{
+			const SimStateSnapshot snapshot = SimStateSnapshots::Capture(*owner, *m_simStateBackend);
+			result += simName + (SimStateSerialization::SaveToFile(path, snapshot) ? ": saved\n" : ": failed to write " + path + "\n");
+			continue;
+		}
+
+		SimStateSnapshot snapshot;
+		const SimStateReadResult readResult = SimStateSerialization::LoadFromFile(path, snapshot);
+		if (readResult != SimStateReadResult::Ok)
+		{
+			result += simName + ": failed to read " + path + " (error " + std::to_string(int(readResult)) + ")\n";
+			continue;
+		}
+
+		const SimStateRestoreResult restoreResult = SimStateSnapshots::Restore(*owner, *m_simStateBackend, snapshot);
+		if (restoreResult != SimStateRestoreResult::Ok)
+		{
+			result += simName + ": snapshot doesn't match the sim (error " + std::to_string(int(restoreResult)) + ")\n";
+			continue;
+		}
+
+		// The restored state is the latest one, time accumulated before it no longer applies
+		const auto simClock = m_simClocks.find(pass);
+		if (simClock != m_simClocks.end())
+		{
+			simClock->second.Reset();
+		}
+		result += simName + ": loaded\n";
+	}
+
+	m_simStateRequests.LastResult = result;
+}
+
 void AstroGameInstance::Update(float deltaTime, ivec2 cursorPos)
 {
 	Game::Update(deltaTime, cursorPos);
 
 	m_frameIdx++;
 
+	// Before any of this frame's work is recorded, snapshots are taken from / written to the state the previous frame left
+	ProcessSimStateRequests();
+
 	PIXBeginEvent(PIX_COLOR_DEFAULT, L"Update Frame Resource"); 
 	UpdateFrameResource();
 	PIXEndEvent();
@@ -285,9 +493,9 @@ void AstroGameInstance::Update(float deltaTime, ivec2 cursorPos)
 	
 	UpdateMainRenderPassConstantBuffer(deltaTime);
 
-	const int32_t frameIdxModulo = m_frameIdx % NumFrameResources;
+	const int32_t frameIdxModulo = m_frameIdx % m_framesInFlight;
 
-	const GPUPassUpdateData updateData
+	GPUPassUpdateData updateData
 	{
 		deltaTime,
 		frameIdxModulo,
@@ -296,8 +504,18 @@ void AstroGameInstance::Update(float deltaTime, ivec2 cursorPos)
 
 	for (auto& gpuPass : m_gpuPasses)
 	{
-		if (gpuPass->IsEnabled())
-			gpuPass->Update(updateData);
+		if (!gpuPass->IsEnabled())
+			continue;
+
+		// Sim clocks only advance while their pass is enabled, a demo being switched back on doesn't catch up on the time it was off
+		updateData.simStep = SimStepData{ 1, deltaTime, 0.f };
+		const auto simClock = m_simClocks.find(gpuPass.get());
+		if (simClock != m_simClocks.end())
+		{
+			updateData.simStep = simClock->second.Advance(deltaTime);
+		}
+
+		gpuPass->Update(updateData);
 	}
 
 	PIXEndEvent();
@@ -329,6 +547,7 @@ void AstroGameInstance::Render(float deltaTime)
 
 	m_renderer->EndNewFrame([&](int newFenceValue) {
 		m_currentFrameResource->Fence = newFenceValue;
+		m_framePacer->EndFrame(newFenceValue);
 		});
 
 	PIXEndEvent();
@@ -340,6 +559,11 @@ void AstroGameInstance::OnSimReset()
 	{
 		pass->OnSimReset();
 	}
+
+	for (auto& simClock : m_simClocks)
+	{
+		simClock.second.Reset();
+	}
 }
 
 void AstroGameInstance::Shutdown()
@@ -351,6 +575,9 @@ void AstroGameInstance::Shutdown()
 		pass->Shutdown();
 	}
 	m_gpuPasses.clear();
+	m_simClocks.clear();
+	m_simStateOwners.clear();
+	m_simStateBackend.reset();
 
 	Game::Shutdown();
 }
\ No newline at end of file
@@ -4,10 +4,15 @@
 #include <Game.h>
 #include <Maths/MathUtils.h>
 #include <Rendering/Common/FrameResource.h>
+#include <Rendering/Common/FramePacer.h>
 #include <Rendering/Common/GPUPass.h>
 #include <Rendering/Common/MeshLibrary.h>
-#include <Rendering/Common/UploadBuffer.h>
+#include <Rendering/Common/SimStateSnapshot.h>
+#include <Rendering/Common/UploadRingBuffer.h>
 #include <DemoManager.h>
+#include <GameContent/GPUPasses/RaymarchScene.h>
+#include <Timing/FixedStepScheduler.h>
+#include <unordered_map>
 
 using Microsoft::WRL::ComPtr;
 struct SceneData;
@@ -34,6 +39,7 @@ public:
 private:
     void UpdateFrameResource();
     void UpdateMainRenderPassConstantBuffer(float deltaTime);
+    void ProcessSimStateRequests();
 
     uint32_t m_frameIdx = 0;
 
@@ -42,6 +48,12 @@ private:
     XMFLOAT4X4 m_viewMat = AstroTools::Maths::Identity4x4();
     XMFLOAT4X4 m_projMat = AstroTools::Maths::Identity4x4();
 
+    // Last frame's pass constants camera, transposed as uploaded
+    bool m_hasPrevPassCamera = false;
+    XMFLOAT4X4 m_prevViewProj = AstroTools::Maths::Identity4x4();
+    XMFLOAT4X4 m_prevInvViewProj = AstroTools::Maths::Identity4x4();
+    XMFLOAT3 m_prevCameraPos = { 0.0f, 0.0f, 0.0f };
+
     const float m_theta = 1.5f * XM_PI;
     const float m_phi = XM_PIDIV4;
     const float m_radius = 5.0f;
@@ -51,13 +63,27 @@ private:
     // Resources
     std::vector<std::unique_ptr<FrameResource>> m_frameResources;
     FrameResource* m_currentFrameResource = nullptr;
-    int m_currentFrameResourceIndex = 0;
+
+    // Frame pacing
+    SteadyFrameClock m_frameClock;
+    std::unique_ptr<IFrameFence> m_frameFence;
+    std::unique_ptr<FramePacer> m_framePacer;
 
     std::vector<std::shared_ptr<GPUPass>> m_gpuPasses;
+    // Simulation passes running on their own fixed timestep, decoupled from the render rate
+    std::unordered_map<const GPUPass*, FixedStepScheduler> m_simClocks;
+    // Sims which can be saved to / restored from snapshot files, by pass
+    std::vector<std::pair<const GPUPass*, ISimStateOwner*>> m_simStateOwners;
+    std::unique_ptr<ISimStateBackend> m_simStateBackend;
+    SimStateSnapshotRequests m_simStateRequests;
+    RaymarchSettings m_raymarchSettings;
+    RaymarchStats m_raymarchStats;
     DemoManager m_demoManager;
 
     virtual void CreatePasses(AstroTools::Rendering::ShaderLibrary& shaderLibrary) override;
     virtual void Update(float deltaTime, ivec2 cursorPos) override;
     virtual void Render(float deltaTime) override;
 	virtual void OnSimReset() override;
+	virtual void CollectUIInputEvents(std::vector<RecordedInputEvent>& outEvents) override;
+	virtual void ApplyDemoToggle(uint32_t demoIdx, bool enabled) override;
 };
\ No newline at end of file
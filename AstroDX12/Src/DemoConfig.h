@@ -0,0 +1,57 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct DemoConfigEntry
+{
+	std::string name;
+	bool enabled = false;
+};
+
+// Demo configuration file: one "name = true|false" line per demo ("1"/"0" also accepted), '#' starts a comment line.
+// No platform types in here, DemoManager applies the entries to its registered demos.
+namespace DemoConfig
+{
+	namespace Privates
+	{
+		inline std::string_view Trim(std::string_view text)
+		{
+			const size_t first = text.find_first_not_of(" \t");
+			if (first == std::string_view::npos)
+			{
+				return {};
+			}
+			return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+		}
+	}
+
+	// Entries in file order, lines which aren't an assignment are skipped
+	inline std::vector<DemoConfigEntry> Parse(std::istream& stream)
+	{
+		std::vector<DemoConfigEntry> entries;
+
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			// Skip comments and empty lines
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			const size_t eqPos = line.find('=');
+			if (eqPos == std::string::npos)
+				continue;
+
+			const std::string_view lineView = line;
+			const std::string_view value = Privates::Trim(lineView.substr(eqPos + 1));
+
+			DemoConfigEntry& entry = entries.emplace_back();
+			entry.name = Privates::Trim(lineView.substr(0, eqPos));
+			entry.enabled = value == "true" || value == "1";
+		}
+
+		return entries;
+	}
+}
@@ -1,4 +1,5 @@
 #include <DemoManager.h>
+#include <DemoConfig.h>
 #include <Rendering/Common/GPUPass.h>
 #include <Common.h>
 
@@ -6,6 +7,7 @@
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
+#include <utility>
 
 void DemoManager::RegisterDemo(const std::string& name,
 	std::vector<GPUPass*> passes,
@@ -40,6 +42,27 @@ void DemoManager::SetDemoEnabled(const std::string& name, bool enabled)
 	ApplyEnabledStates();
 }
 
+void DemoManager::SetDemoEnabled(uint32_t demoIdx, bool enabled)
+{
+	if (demoIdx >= m_demos.size())
+	{
+		DX::astro_assert(false, "Demo not found");
+		return;
+	}
+
+	SetDemoEnabled(m_demos[demoIdx].name, enabled);
+}
+
+void DemoManager::RequestDemoEnabled(uint32_t demoIdx, bool enabled)
+{
+	m_toggleRequests.push_back({ demoIdx, enabled });
+}
+
+std::vector<DemoToggleRequest> DemoManager::TakeToggleRequests()
+{
+	return std::exchange(m_toggleRequests, {});
+}
+
 bool DemoManager::IsDemoEnabled(const std::string& name) const
 {
 	auto it = m_demoLookup.find(name);
@@ -104,35 +127,16 @@ void DemoManager::LoadConfig(const std::string& configPath)
 		return;
 	}
 
-	std::string line;
-	while (std::getline(file, line))
+	for (const DemoConfigEntry& entry : DemoConfig::Parse(file))
 	{
-		// Skip comments and empty lines
-		if (line.empty() || line[0] == '#')
-			continue;
-
-		auto eqPos = line.find('=');
-		if (eqPos == std::string::npos)
-			continue;
-
-		std::string name = line.substr(0, eqPos);
-		std::string value = line.substr(eqPos + 1);
-
-		// Trim whitespace
-		name.erase(0, name.find_first_not_of(" \t"));
-		name.erase(name.find_last_not_of(" \t") + 1);
-		value.erase(0, value.find_first_not_of(" \t"));
-		value.erase(value.find_last_not_of(" \t") + 1);
-
-		auto it = m_demoLookup.find(name);
+		auto it = m_demoLookup.find(entry.name);
 		if (it != m_demoLookup.end())
 		{
-			bool enabled = (value == "true" || value == "1");
-			m_demos[it->second].enabled = enabled;
+			m_demos[it->second].enabled = entry.enabled;
 
-			if (enabled)
+			if (entry.enabled)
 			{
-				EnableDependencies(name);
+				EnableDependencies(entry.name);
 			}
 		}
 	}
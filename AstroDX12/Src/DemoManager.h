@@ -14,6 +14,12 @@ struct DemoDefinition
 	bool enabled = false;
 };
 
+struct DemoToggleRequest
+{
+	uint32_t demoIdx = 0;
+	bool enabled = false;
+};
+
 class DemoManager
 {
 public:
@@ -22,6 +28,10 @@ public:
 		std::vector<std::string> dependencies = {});
 
 	void SetDemoEnabled(const std::string& name, bool enabled);
+	void SetDemoEnabled(uint32_t demoIdx, bool enabled);
+	// Toggles made from the UI are only requested, the game applies them at the start of the next frame like any other input
+	void RequestDemoEnabled(uint32_t demoIdx, bool enabled);
+	std::vector<DemoToggleRequest> TakeToggleRequests();
 	bool IsDemoEnabled(const std::string& name) const;
 
 	const std::vector<DemoDefinition>& GetDemos() const { return m_demos; }
@@ -36,4 +46,5 @@ private:
 	std::vector<DemoDefinition> m_demos;
 	std::unordered_map<std::string, size_t> m_demoLookup;
 	std::string m_configPath;
+	std::vector<DemoToggleRequest> m_toggleRequests;
 };
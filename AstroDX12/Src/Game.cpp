@@ -8,6 +8,8 @@
 #include <Rendering/Renderable/RenderableGroup.h>
 #include <Rendering/Common/VectorTypes.h>
 #include "winnt.h"
+#include <algorithm>
+#include <sstream>
 
 extern void ExitGame() noexcept;
 
@@ -20,6 +22,7 @@ Game::Game() noexcept(false)
     , m_screenHeight(200)
     , m_shaderLibrary()
     , m_lastPressedMousePos()
+    , m_cursorPos()
     , m_cameraPhi(0.f)
     , m_cameraTheta(0.f * XM_PI)
     , m_cameraOriginPos(XMVectorSet(0,0,-10, 1))
@@ -30,6 +33,11 @@ Game::Game() noexcept(false)
     m_renderer = std::make_unique<RendererDX12>();
 }
 
+void Game::SetFramesInFlight(uint32_t framesInFlight)
+{
+    m_framesInFlight = std::clamp(framesInFlight, 1u, MaxFramesInFlight);
+}
+
 Game::~Game()
 {
 }
@@ -42,7 +50,7 @@ void Game::Initialize(HWND window, int width, int height)
     
     InitCamera();
 
-    m_renderer->Init( window, width, height);
+    m_renderer->Init( window, width, height, m_framesInFlight);
     BuildFrameResources();
     CreateConstantBufferViews();
 
@@ -62,6 +70,14 @@ void Game::Initialize(HWND window, int width, int height)
 
 void Game::Shutdown()
 {
+    if (m_inputRecorder)
+    {
+        const bool saved = InputRecordingSerialization::SaveToFile(m_inputRecordingPath, m_inputRecorder->GetRecording());
+        DX::astro_assert(saved, "Failed to write the input recording");
+        m_inputRecorder.reset();
+    }
+    m_inputReplayer.reset();
+
     m_renderer->Shutdown();
     m_renderer.reset();
 
@@ -71,9 +87,55 @@ void Game::Shutdown()
 // Executes the basic game loop.
 void Game::Tick(float totalTime, float deltaTime)
 {
+    // Ignored while replaying, the recorded ones are applied instead
+    std::vector<RecordedInputEvent> uiInputEvents;
+    CollectUIInputEvents(uiInputEvents);
+    for (const RecordedInputEvent& event : uiInputEvents)
+    {
+        OnInputEvent(event);
+    }
+
+    if (m_inputReplayer)
+    {
+        // Live input & timer are ignored, the recording drives the frame
+        const RecordedFrame* recordedFrame = m_inputReplayer->BeginFrame(totalTime, deltaTime);
+        if (!recordedFrame)
+        {
+            return;
+        }
+
+        for (const RecordedInputEvent& event : recordedFrame->Events)
+        {
+            ApplyInputEvent(event);
+        }
+    }
+
     m_totalTime = totalTime;
     Update(deltaTime, ivec2(int32_t(m_cursorPos.x), int32_t(m_cursorPos.y)));
     Render(deltaTime);
+
+    if (m_inputRecorder)
+    {
+        m_inputRecorder->RecordFrame(totalTime, deltaTime, GetRecordedFrameState());
+    }
+
+    if (m_inputReplayer)
+    {
+        m_inputReplayer->EndFrame(GetRecordedFrameState());
+        if (m_inputReplayer->IsFinished())
+        {
+            std::stringstream report;
+            report << "Input replay done: " << m_inputReplayer->GetPlayedFrameCount() << " frames, "
+                << m_inputReplayer->GetDivergentFrameCount() << " diverged from the recording";
+            if (m_inputReplayer->GetDivergentFrameCount() > 0)
+            {
+                report << " (first: frame " << m_inputReplayer->GetFirstDivergentFrameIdx() << ")";
+            }
+            report << "\n";
+            ::OutputDebugStringA(report.str().c_str());
+            ExitGame();
+        }
+    }
 }
 
 // Updates the world.
@@ -89,6 +151,74 @@ void Game::Render(float /*deltaTime*/)
 }
 #pragma endregion
 
+#pragma region Input Recording
+void Game::StartInputRecording(const std::string& path)
+{
+    DX::astro_assert(!m_inputReplayer, "Can't record input while replaying");
+    m_inputRecorder = std::make_unique<InputRecorder>();
+    m_inputRecordingPath = path;
+}
+
+bool Game::StartInputReplay(const std::string& path, float fixedDeltaTime)
+{
+    DX::astro_assert(!m_inputRecorder, "Can't replay input while recording");
+    InputRecording recording;
+    if (InputRecordingSerialization::LoadFromFile(path, recording) != InputRecordingReadResult::Ok)
+    {
+        return false;
+    }
+
+    m_inputReplayer = std::make_unique<InputReplayer>(std::move(recording), fixedDeltaTime);
+    return true;
+}
+
+void Game::OnInputEvent(const RecordedInputEvent& event)
+{
+    if (m_inputReplayer)
+    {
+        return;
+    }
+
+    if (m_inputRecorder)
+    {
+        m_inputRecorder->RecordEvent(event);
+    }
+    ApplyInputEvent(event);
+}
+
+void Game::ApplyInputEvent(const RecordedInputEvent& event)
+{
+    switch (event.Type)
+    {
+    case RecordedInputType::MouseDown:
+        ApplyMouseDown(event.X, event.Y);
+        break;
+    case RecordedInputType::MouseUp:
+        break;
+    case RecordedInputType::MouseMove:
+        ApplyMouseMove(WPARAM(event.Value), event.X, event.Y);
+        break;
+    case RecordedInputType::Key:
+        ApplyKeyboardKey(KeyboardKey(event.Value));
+        break;
+    case RecordedInputType::DemoToggle:
+        ApplyDemoToggle(event.Value, event.X != 0);
+        break;
+    }
+}
+
+RecordedFrameState Game::GetRecordedFrameState() const
+{
+    RecordedFrameState state;
+    state.CursorX = int32_t(m_cursorPos.x);
+    state.CursorY = int32_t(m_cursorPos.y);
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(state.CameraPosition), m_cameraOriginPos);
+    state.CameraTheta = m_cameraTheta;
+    state.CameraPhi = m_cameraPhi;
+    return state;
+}
+#pragma endregion
+
 #pragma region Message Handlers
 // Message handlers
 void Game::OnActivated()
@@ -131,18 +261,34 @@ void Game::OnWindowSizeChanged(int width, int height)
 }
 
 
-void Game::OnMouseDown(WPARAM /*btnState*/, int x, int y)
+void Game::OnMouseDown(WPARAM btnState, int x, int y)
 {
-    m_lastPressedMousePos.x = x;
-    m_lastPressedMousePos.y = y;
-   
+    OnInputEvent({ RecordedInputType::MouseDown, uint32_t(btnState), x, y });
 }
 
-void Game::OnMouseUp(WPARAM /*btnState*/, int /*x*/, int /*y*/)
+void Game::OnMouseUp(WPARAM btnState, int x, int y)
 {
+    OnInputEvent({ RecordedInputType::MouseUp, uint32_t(btnState), x, y });
 }
 
 void Game::OnMouseMove(WPARAM mouseBtnState, int x, int y)
+{
+    OnInputEvent({ RecordedInputType::MouseMove, uint32_t(mouseBtnState), x, y });
+}
+
+void Game::OnKeyboardKey(KeyboardKey key)
+{
+    OnInputEvent({ RecordedInputType::Key, uint32_t(key), 0, 0 });
+}
+
+void Game::ApplyMouseDown(int x, int y)
+{
+    m_lastPressedMousePos.x = x;
+    m_lastPressedMousePos.y = y;
+   
+}
+
+void Game::ApplyMouseMove(WPARAM mouseBtnState, int x, int y)
 {
     if ((mouseBtnState & MK_LBUTTON) != 0)
     {
@@ -164,7 +310,7 @@ void Game::OnMouseMove(WPARAM mouseBtnState, int x, int y)
 	m_cursorPos = { x, y };
 }
 
-void Game::OnKeyboardKey(KeyboardKey key)
+void Game::ApplyKeyboardKey(KeyboardKey key)
 {
     XMVECTOR Up = XMVectorSet(0, 1, 0, 0);
     XMVECTOR RightDir = XMVector3Cross(Up, m_lookDir);
@@ -5,7 +5,9 @@
 #pragma once
 #include <Common.h>
 #include <Input/KeyboardInput.h>
+#include <Input/InputRecording.h>
 #include <Rendering/IRenderer.h>
+#include <Rendering/Common/FramePacer.h>
 #include <Rendering/Renderable/IRenderable.h>
 #include <Rendering/Common/ShaderLibrary.h>
 
@@ -44,6 +46,14 @@ public:
     void OnMouseMove(WPARAM mouseBtnState, int x, int y);
     void OnKeyboardKey(KeyboardKey key);
 
+    // Repeatable runs: record the live input & frame times to a file (written on Shutdown),
+    // or replay one in place of them. fixedDeltaTime > 0 replays with a fixed timestep instead of the recorded one.
+    void StartInputRecording(const std::string& path);
+    bool StartInputReplay(const std::string& path, float fixedDeltaTime = 0.f);
+
+    // Frames the CPU can record ahead of the GPU, clamped to [1, MaxFramesInFlight]. Must be set before Initialize.
+    void SetFramesInFlight(uint32_t framesInFlight);
+
     // Properties
     void GetDefaultSize( int& width, int& height ) const noexcept;
     inline float GetAspectRatio() const { return (float)m_screenWidth / (float)m_screenHeight;  }
@@ -64,11 +74,22 @@ protected:
     virtual void Update(float deltaTime, ivec2 cursorPos) = 0;
     virtual void Render(float deltaTime) = 0;
     virtual void OnSimReset() = 0;
+    // Input made through the UI (eg: demo toggles), taken at the start of each frame & recorded/replayed like the window's input
+    virtual void CollectUIInputEvents(std::vector<RecordedInputEvent>& /*outEvents*/) {}
+    virtual void ApplyDemoToggle(uint32_t /*demoIdx*/, bool /*enabled*/) {}
 
     std::unique_ptr<IRenderer> m_renderer;
     HWND m_hwnd = nullptr;
+    uint32_t m_framesInFlight = DefaultFramesInFlight;
 
 private:
+    void OnInputEvent(const RecordedInputEvent& event);
+    void ApplyInputEvent(const RecordedInputEvent& event);
+    void ApplyMouseDown(int x, int y);
+    void ApplyMouseMove(WPARAM mouseBtnState, int x, int y);
+    void ApplyKeyboardKey(KeyboardKey key);
+    RecordedFrameState GetRecordedFrameState() const;
+
     int m_screenWidth;
     int m_screenHeight;
     float m_totalTime;
@@ -82,4 +103,8 @@ protected:
     XMVECTOR m_lookDir;
 private:
     AstroTools::Rendering::ShaderLibrary m_shaderLibrary;
+
+    std::unique_ptr<InputRecorder> m_inputRecorder;
+    std::string m_inputRecordingPath;
+    std::unique_ptr<InputReplayer> m_inputReplayer;
 };
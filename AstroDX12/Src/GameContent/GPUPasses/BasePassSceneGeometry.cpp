@@ -2,7 +2,7 @@
 
 #include <Common.h>
 #include <Rendering/Common/FrameResource.h>
-#include <Rendering/Common/UploadBuffer.h>
+#include <Rendering/Common/UploadRingBuffer.h>
 #include <Rendering/IRenderer.h>
 #include <Rendering/Renderable/IRenderable.h>
 #include <Rendering/Renderable/RenderableGroup.h>
@@ -25,6 +25,8 @@ namespace Privates
 
 void BasePassSceneGeometry::Init(IRenderer* renderer, ShaderLibrary& shaderLibrary, MeshLibrary& meshLibrary, int16_t numFrameResources)
 {
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
     BuildSceneGeometry(renderer, meshLibrary);
     BuildShaders(shaderLibrary);
     BuildRootSignature(renderer);
@@ -44,7 +46,7 @@ void BasePassSceneGeometry::Init(IRenderer* renderer, ShaderLibrary& shaderLibra
         renderer->CreateStructuredBufferAndViews(m_renderableObjectConstantsDataBufferPerFrameResources[frameIdx].get(), std::wstring_view(Privates::BufferName), true, false);
     }
 
-    int16_t index = 0;
+    int32_t index = 0;
     for (auto& renderableDesc : m_renderablesDesc)
     {
         auto renderableObj = std::make_shared<RenderableStaticObject>(
@@ -257,29 +259,25 @@ void BasePassSceneGeometry::BuildRootSignature(IRenderer* renderer)
 void BasePassSceneGeometry::Update(const GPUPassUpdateData& updateData)
 {
     m_frameIdxModulo = updateData.frameIdxModulo;
-    // re-using the same constant buffer to set all the renderables objects - per object constant data.
-
-    //TODO: re-enable this with the new 1 buffer format - by allowing to do partial updates to the structured buffer type (currently it's not possible)
-    
-    //auto& currentFrameObjectConstantsDataBuffer = *m_renderableObjectConstantsDataBufferPerFrameResources[frameIdxModulo].get();
-    //for (auto& [rootSignaturePSOPair, renderableGroup] : m_renderableGroupMap)
-    //{
-    //    renderableGroup->ForEach([&](std::shared_ptr<IRenderable> renderable)
-    //    {
-    //        if (renderable->IsDirty())
-    //        {
-    //            //TODO: need to understand better how buffer uploads are processed
-    //            //TODO: then allow partial buffer updates for only the dirty objects's data
-
-    //            XMMATRIX worldTransform = XMLoadFloat4x4(&renderable->GetWorldTransform());
-    //            RenderableObjectConstantData objectConstants;
-    //            XMStoreFloat4x4(&objectConstants.WorldTransform, XMMatrixTranspose(worldTransform));
-    //            currentFrameObjectConstantsDataBuffer->CopyData(renderable->GetConstantBufferIndex(), objectConstants);
-
-    //            renderable->ReduceDirtyFrameCount();
-    //        }
-    //    });
-    //}
+
+    // Each frame resource has its own copy of the per object constants, a dirty object is written into each of them in turn
+    // (once per frame resource), only those elements are uploaded when the pass executes.
+    auto& currentFrameObjectConstantsDataBuffer = *m_renderableObjectConstantsDataBufferPerFrameResources[m_frameIdxModulo].get();
+    for (auto& [rootSignaturePSOPair, renderableGroup] : m_renderableGroupMap)
+    {
+        renderableGroup->ForEach([&](const std::shared_ptr<IRenderable>& renderable)
+        {
+            if (renderable->IsDirty())
+            {
+                // Stored as is, like the initial transforms the buffer was created with
+                RenderableObjectConstantData objectConstants;
+                objectConstants.WorldTransform = renderable->GetWorldTransform();
+                currentFrameObjectConstantsDataBuffer.SetElement(renderable->GetConstantBufferIndex(), objectConstants);
+
+                renderable->ReduceDirtyFrameCount();
+            }
+        });
+    }
 }
 
 void BasePassSceneGeometry::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float /*deltaTime*/, const FrameResource& frameResources) const
@@ -287,8 +285,11 @@ void BasePassSceneGeometry::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, f
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "BasePassSceneGeometry");
 
     auto& currentFrameObjectConstantsDataBuffer = *m_renderableObjectConstantsDataBufferPerFrameResources[m_frameIdxModulo].get();
+    currentFrameObjectConstantsDataBuffer.FlushDirtyElements(cmdList.Get());
+    // Readable again before the draws
+    m_resourceStates->FlushBarriers(cmdList.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     for (const auto& [groupRootSignaturePsoPair, renderableGroup] : m_renderableGroupMap)
     {
         auto& renderableGroupRootSignature = groupRootSignaturePsoPair.first;
@@ -297,7 +298,7 @@ void BasePassSceneGeometry::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, f
         cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
         cmdList->SetPipelineState(renderableGroup->GetPSO().Get());
 
-        renderableGroup->ForEach([&](const std::shared_ptr<IRenderable>& renderableObj, size_t ObjectIndex)
+        renderableGroup->ForEach([&](const std::shared_ptr<IRenderable>& renderableObj)
         {
             //if (renderableObj->GetSupportsTextures())
             //{
@@ -317,7 +318,7 @@ void BasePassSceneGeometry::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, f
             {
                 renderableObj->GetMeshVertexBufferSRVHeapIndex(),
                 currentFrameObjectConstantsDataBuffer.GetSRVIndex(),
-                int32_t(ObjectIndex)
+                renderableObj->GetConstantBufferIndex()
             };
             cmdList->SetGraphicsRoot32BitConstants(
                 (UINT)BindlessResourceIndicesRootSigParamIndex,
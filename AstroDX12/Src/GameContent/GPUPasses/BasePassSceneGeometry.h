@@ -53,5 +53,6 @@ private:
     std::vector<IRenderableDesc> m_renderablesDesc;
 
     RenderableGroupMap m_renderableGroupMap;
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
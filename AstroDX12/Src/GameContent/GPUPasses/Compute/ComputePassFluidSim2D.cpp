@@ -4,19 +4,21 @@
 #include <Rendering/Common/MeshLibrary.h>
 #include <Rendering/Common/FrameResource.h>
 #include <Rendering/Common/SamplerIDs.h>
+#include <Rendering/Common/RendererContext.h>
 #include <bit>
 
 namespace Privates
 {
-	constexpr ivec2 ThreadGroupSize = ivec2(32, 32);
-    constexpr ivec2 GridDimensions = ivec2(256, 256);
-    constexpr int32_t PressureIterationCount = 120;
+    // 2 V-cycles leave a residual over 100x lower than the 120 Jacobi iterations they replace, in 82 dispatches (FluidPressure_ benchmarks).
+    // The first one is written by the input & divergence pass.
+    constexpr uint32_t PressureVCycleCount = 2;
 
     std::unique_ptr<ComputableObject> CreateComputableObject(
         IRenderer* renderer,
         AstroTools::Rendering::ShaderLibrary& shaderLibrary,
         const std::wstring& computeShaderPath,
         const std::wstring& entryPoint,
+        const std::vector<std::wstring>& defines,
         UINT numConstantBuffers,
         UINT numRenderTargetInputs,
 		UINT numRenderTargetOutputs,
@@ -157,7 +159,7 @@ namespace Privates
         computableObjDesc.RootSignature = rootSignature;
 
         // Create shader
-        computableObjDesc.CS = shaderLibrary.GetCompiledShader(computableObjDesc.ComputeShaderPath, entryPoint, {}, L"cs_6_6");
+        computableObjDesc.CS = shaderLibrary.GetCompiledShader(computableObjDesc.ComputeShaderPath, entryPoint, defines, L"cs_6_6");
 
         // Compile PSO
         renderer->CreateComputePipelineState(
@@ -175,6 +177,37 @@ namespace Privates
 		return ivec2(dispatchX, dispatchY);
 	}
 
+    bool SupportsTypedUAVLoads(ID3D12Device* device, DXGI_FORMAT format)
+    {
+        D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport{ .Format = format };
+        if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport))))
+        {
+            return false;
+        }
+        return (formatSupport.Support2 & D3D12_FORMAT_SUPPORT2_UAV_TYPED_LOAD) != 0;
+    }
+
+    // Of the formats the grids can be stored in
+    uint32_t GetTexelByteSize(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R16_FLOAT:
+            return 2;
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R16G16_FLOAT:
+            return 4;
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            return 8;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 16;
+        default:
+            DX::astro_assert(false, "FluidSim2D: unexpected grid format");
+            return 0;
+        }
+    }
+
     void ApplyRootSignatureAndPSO(ComPtr<ID3D12GraphicsCommandList> cmdList, ComputableObject* computableObj)
     {
         cmdList->SetComputeRootSignature(computableObj->GetRootSignature().Get());
@@ -182,69 +215,80 @@ namespace Privates
 	}
 }
 
-void ComputePassFluidSim2D::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary)
+void ComputePassFluidSim2D::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, const SimSettings& settings)
 {
+    // The projection's edge cells read the cell inside them from the group's tile
+    DX::astro_assert(settings.ThreadGroupSize.x >= 2 && settings.ThreadGroupSize.y >= 2 && settings.ThreadGroupSize.x * settings.ThreadGroupSize.y <= D3D12_CS_THREAD_GROUP_MAX_THREADS_PER_GROUP,
+        "FluidSim2D: thread groups are 2x2 to 1024 threads");
+    DX::astro_assert(settings.GridResolution % uint32_t(settings.ThreadGroupSize.x) == 0 && settings.GridResolution % uint32_t(settings.ThreadGroupSize.y) == 0,
+        "FluidSim2D: the thread groups have to tile the grid");
+
+    m_settings = settings;
     m_inputScreenPos = ivec2(0, 0);
     m_inputPrevScreenPos = ivec2(0, 0);
-    m_dummySRVGPUHandle = renderer->GetDummySRVGPUHandle();
     m_imageSamplerIndex = AstroTools::Rendering::SamplerIDs::LinearClamp;
     m_imageSamplerGpuHandle = renderer->GetSamplerGPUHandle(m_imageSamplerIndex);
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
+    const UINT32 gridResolution = settings.GridResolution;
+    m_velocityFormat = settings.HalfPrecisionStorage ? DXGI_FORMAT_R16G16_FLOAT : DXGI_FORMAT_R32G32_FLOAT;
+    m_densityFormat = settings.HalfPrecisionStorage ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R32G32B32A32_FLOAT;
+    const DXGI_FORMAT pressureFormat = settings.HalfPrecisionPressure && Privates::SupportsTypedUAVLoads(renderer->GetDevice().Get(), DXGI_FORMAT_R16_FLOAT) ? DXGI_FORMAT_R16_FLOAT : DXGI_FORMAT_R32_FLOAT;
 
     m_gridDensityTexPair = std::make_unique<RenderResourcePair<RenderTarget>>(
         std::make_unique<RenderTarget>(),
         std::make_unique<RenderTarget>());
-    renderer->InitialiseRenderTarget(m_gridDensityTexPair->GetInput(), L"FluidSim2D::DensityGrid::Ping", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    renderer->InitialiseRenderTarget(m_gridDensityTexPair->GetOutput(), L"FluidSim2D::DensityGrid::Pong", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    renderer->InitialiseRenderTarget(m_gridDensityTexPair->GetInput(), L"FluidSim2D::DensityGrid::Ping", gridResolution, gridResolution, m_densityFormat, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    renderer->InitialiseRenderTarget(m_gridDensityTexPair->GetOutput(), L"FluidSim2D::DensityGrid::Pong", gridResolution, gridResolution, m_densityFormat, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
 
     m_gridVelocityTexPair = std::make_unique<RenderResourcePair<RenderTarget>>(
         std::make_unique<RenderTarget>(),
 		std::make_unique<RenderTarget>());
-    renderer->InitialiseRenderTarget(m_gridVelocityTexPair->GetInput(), L"FluidSim2D::VelocityGrid::Ping", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32G32_FLOAT, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    renderer->InitialiseRenderTarget(m_gridVelocityTexPair->GetOutput(), L"FluidSim2D::VelocityGrid::Pong", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32G32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    renderer->InitialiseRenderTarget(m_gridVelocityTexPair->GetInput(), L"FluidSim2D::VelocityGrid::Ping", gridResolution, gridResolution, m_velocityFormat, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    renderer->InitialiseRenderTarget(m_gridVelocityTexPair->GetOutput(), L"FluidSim2D::VelocityGrid::Pong", gridResolution, gridResolution, m_velocityFormat, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
     m_gridDivergenceTex = std::make_unique<RenderTarget>();
-    renderer->InitialiseRenderTarget(m_gridDivergenceTex.get(), L"FluidSim2D::DivergenceGrid", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    renderer->InitialiseRenderTarget(m_gridDivergenceTex.get(), L"FluidSim2D::DivergenceGrid", gridResolution, gridResolution, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
-    m_gridPressureTexPair = std::make_unique<RenderResourcePair<RenderTarget>>(
-        std::make_unique<RenderTarget>(),
-        std::make_unique<RenderTarget>());
-    renderer->InitialiseRenderTarget(m_gridPressureTexPair->GetInput(), L"FluidSim2D::PressureGrid::Ping", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    renderer->InitialiseRenderTarget(m_gridPressureTexPair->GetOutput(), L"FluidSim2D::PressureGrid::Pong", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    // Solved in place by the V-cycles, a single texture
+    m_gridPressureTex = std::make_unique<RenderTarget>();
+    renderer->InitialiseRenderTarget(m_gridPressureTex.get(), L"FluidSim2D::PressureGrid", gridResolution, gridResolution, pressureFormat, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
+	// Copied from the density, same format
 	m_imageRenderTarget = std::make_unique<RenderTarget>();
-	renderer->InitialiseRenderTarget(m_imageRenderTarget.get(), L"FluidSim2D::ImageRT", Privates::GridDimensions.x, Privates::GridDimensions.y, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-
-    const auto rootPath = s2ws(DX::GetWorkingDirectory());
-    const auto computeShaderPathInput = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Input.hlsl");
-    m_computeObjInput = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathInput, L"CSMain", 1, 2, 2, 6 );
+	renderer->InitialiseRenderTarget(m_imageRenderTarget.get(), L"FluidSim2D::ImageRT", gridResolution, gridResolution, m_densityFormat, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
-    const auto computeShaderPathAdvect = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Advect.hlsl");
-    m_computeObjAdvectVelocity = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathAdvect, L"CSMain", 0, 1, 1, 2, true);
-
-    const auto computeShaderPathAdvectDensity = rootPath + std::wstring(L"\\Shaders\\FluidSim\\AdvectDensity.hlsl");
-    m_computeObjAdvectDensity = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathAdvectDensity, L"CSMain", 0, 2, 1, 2, true);
-    m_computeObjAdvectDensityFixEdges = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathAdvectDensity, L"CSMain_FixEdges", 0, 2, 1, 2, true);
+    // The shaders' thread group shape permutation
+    const std::vector<std::wstring> defines = {
+        L"THREAD_GROUP_SIZE_X=" + std::to_wstring(settings.ThreadGroupSize.x),
+        L"THREAD_GROUP_SIZE_Y=" + std::to_wstring(settings.ThreadGroupSize.y)
+    };
 
-    const auto computeShaderPathDivergence = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Div.hlsl");
-    m_computeObjDivergence = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathDivergence, L"CSMain", 0, 1, 1, 1);
+    const auto rootPath = s2ws(DX::GetWorkingDirectory());
+    const auto computeShaderPathInputDivergence = rootPath + std::wstring(L"\\Shaders\\FluidSim\\InputDivergence.hlsl");
+    m_computeObjInputDivergence = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathInputDivergence, L"CSMain", defines, 1, 2, 4, 7);
 
-    const auto computeShaderPathDiffuse = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Diffuse.hlsl");
-    m_computeObjDiffuse = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathDiffuse, L"CSMain", 0, 1, 1, 1);
+    const auto computeShaderPathProject = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Project.hlsl");
+    m_computeObjProject = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathProject, L"CSMain", defines, 0, 2, 1, 1);
 
-    const auto computeShaderPathPressure = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Pressure.hlsl");
-    m_computeObjPressure = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathPressure, L"CSMain", 0, 2, 1, 2, true);
-    m_computeObjPressureFixEdges = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathPressure, L"CSMain_FixEdges", 0, 2, 1, 2, true);
+    const auto computeShaderPathAdvect = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Advect.hlsl");
+    m_computeObjAdvect = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathAdvect, L"CSMain", defines, 0, 2, 2, 3, true);
 
-    const auto computeShaderPathProject = rootPath + std::wstring(L"\\Shaders\\FluidSim\\Project.hlsl");
-    m_computeObjProject = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathProject, L"CSMain", 0, 2, 1, 1);
-    m_computeObjReflectEdgeVelocity = Privates::CreateComputableObject(renderer, shaderLibrary, computeShaderPathProject, L"CSMain_ReflectEdgeVelocity", 0, 2, 1, 1);
+    m_pressureSolver.Init(renderer, shaderLibrary, gridResolution);
 }
 
 void ComputePassFluidSim2D::Update(const GPUPassUpdateData& updateData)
 {
+    m_simStep = updateData.simStep;
+    if (m_simStep.StepCount == 0)
+    {
+        // Nothing simulated this frame, the cursor movement & any reset request carry over to the next step
+        return;
+    }
+
 	m_simNeedsReset.Tick();
-    m_timer += updateData.deltaTime;
+    m_timer += float(m_simStep.StepCount) * m_simStep.StepDeltaTime;
     m_inputPrevScreenPos = m_inputScreenPos;
     m_inputScreenPos = updateData.cursorScreenPos;
 }
@@ -253,241 +297,95 @@ void ComputePassFluidSim2D::SimReset(ComPtr<ID3D12GraphicsCommandList>& cmdList)
 {
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "Sim Reset");
 
-    const float clearValues[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    {
-		// During this step the Velocity Input texture is still a UAV - it's not been transitioned to a SRV yet, so no state transition is required
-        cmdList->ClearUnorderedAccessViewFloat(
-            m_gridVelocityTexPair->GetOutput()->GetUAVGPUDescriptorHandle(),
-            m_gridVelocityTexPair->GetOutput()->GetUAVCPUDescriptorHandle(),
-            m_gridVelocityTexPair->GetOutput()->GetResource(),
-            clearValues,
-            0,
-            nullptr);
-
-
-        auto densityTex = m_gridDensityTexPair->GetInput();
-        const auto densityTexTransitionToUAV = CD3DX12_RESOURCE_BARRIER::Transition(densityTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        std::vector<CD3DX12_RESOURCE_BARRIER> densityTransition1 = { densityTexTransitionToUAV };
-        cmdList->ResourceBarrier((UINT)densityTransition1.size(), densityTransition1.data());
+    // The latest velocity & density, the next step's inputs
+    auto velocityTex = m_gridVelocityTexPair->GetInput();
+    auto densityTex = m_gridDensityTexPair->GetInput();
 
-        cmdList->ClearUnorderedAccessViewFloat(
-            densityTex->GetUAVGPUDescriptorHandle(),
-            densityTex->GetUAVCPUDescriptorHandle(),
-            densityTex->GetResource(),
-            clearValues,
-            0,
-            nullptr);
+    // Clears write through UAVs, whatever state the textures were left in
+    m_resourceStates->UAVWrite(velocityTex->GetResource());
+    m_resourceStates->UAVWrite(densityTex->GetResource());
+    m_resourceStates->FlushBarriers(cmdList.Get());
 
-        const auto densityTexTransitionToSRV = CD3DX12_RESOURCE_BARRIER::Transition(densityTex->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-        std::vector<CD3DX12_RESOURCE_BARRIER> densityTransition2 = { densityTexTransitionToSRV };
-        cmdList->ResourceBarrier((UINT)densityTransition2.size(), densityTransition2.data());
+    const float clearValues[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    cmdList->ClearUnorderedAccessViewFloat(
+        velocityTex->GetUAVGPUDescriptorHandle(),
+        velocityTex->GetUAVCPUDescriptorHandle(),
+        velocityTex->GetResource(),
+        clearValues,
+        0,
+        nullptr);
 
-    }
+    cmdList->ClearUnorderedAccessViewFloat(
+        densityTex->GetUAVGPUDescriptorHandle(),
+        densityTex->GetUAVCPUDescriptorHandle(),
+        densityTex->GetResource(),
+        clearValues,
+        0,
+        nullptr);
 }
 
-void ComputePassFluidSim2D::FluidStepInput(ComPtr<ID3D12GraphicsCommandList> cmdList,
+void ComputePassFluidSim2D::FluidStepInputDivergence(ComPtr<ID3D12GraphicsCommandList> cmdList,
     const FrameResource& frameResources,
     ivec2 inputScreenPos,
     ivec2 inputPrevScreenPos) const
 {
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepInput");
+    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepInputDivergence");
 
-    // Dispatch Particle update
     auto velocityInputTex = m_gridVelocityTexPair->GetInput();
     auto velocityOutputTex = m_gridVelocityTexPair->GetOutput();
     auto densityInputTex = m_gridDensityTexPair->GetInput();
 	auto densityOutputTex = m_gridDensityTexPair->GetOutput();
+    auto divergenceTex = m_gridDivergenceTex.get();
+    auto pressureTex = m_gridPressureTex.get();
 
-    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjInput.get());
+    m_resourceStates->Transition(velocityInputTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(densityInputTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->UAVWrite(velocityOutputTex->GetResource());
+    m_resourceStates->UAVWrite(densityOutputTex->GetResource());
+    m_resourceStates->UAVWrite(divergenceTex->GetResource());
+    m_resourceStates->UAVWrite(pressureTex->GetResource());
+    m_resourceStates->FlushBarriers(cmdList.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjInputDivergence.get());
+
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetComputeRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
     cmdList->SetComputeRootDescriptorTable(1, velocityInputTex->GetSRVGPUDescriptorHandle());
     cmdList->SetComputeRootDescriptorTable(2, densityInputTex->GetSRVGPUDescriptorHandle());
     cmdList->SetComputeRootDescriptorTable(3, velocityOutputTex->GetUAVGPUDescriptorHandle());
     cmdList->SetComputeRootDescriptorTable(4, densityOutputTex->GetUAVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(5, divergenceTex->GetUAVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(6, pressureTex->GetUAVGPUDescriptorHandle());
 
     const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-       Privates::GridDimensions.x,
+       int32_t(m_settings.GridResolution),
        std::bit_cast<int32_t>( m_timer ),
        std::bit_cast<int32_t>(inputScreenPos.x),
        std::bit_cast<int32_t>(inputScreenPos.y),
        std::bit_cast<int32_t>(inputPrevScreenPos.x),
-       std::bit_cast<int32_t>(inputPrevScreenPos.y)
+       std::bit_cast<int32_t>(inputPrevScreenPos.y),
+       std::bit_cast<int32_t>(m_simStep.StepDeltaTime)
     };
 
-    cmdList->SetComputeRoot32BitConstants(5, 
+    cmdList->SetComputeRoot32BitConstants(7, 
         (UINT)GraphicsBindlessResourceIndices.size(),
         GraphicsBindlessResourceIndices.data(),
          0);
 
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
+    const ivec2 dispatchSize = GetDispatchSize();
     cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
 
-    // Transition resources into their next correct state
-    {
-        const auto velocityInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            velocityInputTex->GetResource(),
-            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        const auto velocityOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            velocityOutputTex->GetResource(),
-            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-        const auto densityInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            densityInputTex->GetResource(),
-            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        const auto densityOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            densityOutputTex->GetResource(),
-            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-
-        std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { velocityInStateTransition , velocityOutStateTransition, densityInStateTransition, densityOutStateTransition };
-        cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-    }
 	m_gridVelocityTexPair->Swap();
     m_gridDensityTexPair->Swap();
 }
 
-void ComputePassFluidSim2D::FluidStepDiv(ComPtr<ID3D12GraphicsCommandList> cmdList) const
-{
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepDiv");
-
-    auto velocityInput = m_gridVelocityTexPair->GetInput();
-    auto divergenceTex= m_gridDivergenceTex.get();
-
-    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjDivergence.get());
-
-    cmdList->SetComputeRootDescriptorTable(0, velocityInput->GetSRVGPUDescriptorHandle());
-    cmdList->SetComputeRootDescriptorTable(1, divergenceTex->GetUAVGPUDescriptorHandle());
-    cmdList->SetComputeRoot32BitConstant(2, Privates::GridDimensions.x, 0); // GridWidth
-
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
-    cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-
-    {
-        const auto divergenceBufferStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            divergenceTex->GetResource(),
-            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-        std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { divergenceBufferStateTransition };
-        cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-    }
-}
-
 void ComputePassFluidSim2D::FluidStepPressure(ComPtr<ID3D12GraphicsCommandList> cmdList) const
 {
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepPressure");
 
-	const float clearValues[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    {
-        // Clear input pressure tex as well as output, to start from clean slate
-        const auto pressureInTexTransitionToUAV = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_gridPressureTexPair->GetInput()->GetResource(),
-            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { pressureInTexTransitionToUAV };
-        cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-
-        cmdList->ClearUnorderedAccessViewFloat(
-            m_gridPressureTexPair->GetInput()->GetUAVGPUDescriptorHandle(),
-            m_gridPressureTexPair->GetInput()->GetUAVCPUDescriptorHandle(),
-            m_gridPressureTexPair->GetInput()->GetResource(),
-            clearValues,
-            0,
-		    nullptr);
-    
-        const auto pressureInTexTransitionToSRV = CD3DX12_RESOURCE_BARRIER::Transition(
-            m_gridPressureTexPair->GetInput()->GetResource(),
-            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-        std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition2 = { pressureInTexTransitionToSRV };
-        cmdList->ResourceBarrier((UINT)buffersStateTransition2.size(), buffersStateTransition2.data());
-    }
-
-    cmdList->ClearUnorderedAccessViewFloat(
-        m_gridPressureTexPair->GetOutput()->GetUAVGPUDescriptorHandle(),
-        m_gridPressureTexPair->GetOutput()->GetUAVCPUDescriptorHandle(),
-        m_gridPressureTexPair->GetOutput()->GetResource(),
-        clearValues,
-        0,
-        nullptr);
-
-    auto divTex = m_gridDivergenceTex.get();
-
-    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjPressure.get());
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
-    cmdList->SetComputeRootDescriptorTable(0, divTex->GetSRVGPUDescriptorHandle());
-
-    const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-        Privates::GridDimensions.x,
-        m_imageSamplerIndex
-    };
-    cmdList->SetComputeRoot32BitConstants(3,
-        (UINT)GraphicsBindlessResourceIndices.size(),
-        GraphicsBindlessResourceIndices.data(), 0); // GridWidth
-
-    cmdList->SetComputeRootDescriptorTable(
-        4,
-        m_imageSamplerGpuHandle
-    );
-
-    for (int32_t i = 0; i < Privates::PressureIterationCount; ++i)
-    {
-        auto pressureTexInput = m_gridPressureTexPair->GetInput();
-        auto pressureTexOutput = m_gridPressureTexPair->GetOutput();
-
-        cmdList->SetComputeRootDescriptorTable(1, pressureTexInput->GetSRVGPUDescriptorHandle());
-        cmdList->SetComputeRootDescriptorTable(2, pressureTexOutput->GetUAVGPUDescriptorHandle());
-
-        cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-
-        // Swap input and output for next iteration
-        const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            pressureTexInput->GetResource(),
-            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            pressureTexOutput->GetResource(),
-            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-        
-        std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-        cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-
-        m_gridPressureTexPair->Swap();
-	}
-
-	// - Fix edges
-    {
-
-        Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjPressureFixEdges.get());
-
-        auto pressureTexInput = m_gridPressureTexPair->GetInput();
-        auto pressureTexOutput = m_gridPressureTexPair->GetOutput();
-
-        cmdList->SetComputeRootDescriptorTable(0, m_dummySRVGPUHandle);
-        cmdList->SetComputeRootDescriptorTable(1, pressureTexInput->GetSRVGPUDescriptorHandle());
-        cmdList->SetComputeRootDescriptorTable(2, pressureTexOutput->GetUAVGPUDescriptorHandle());
-        cmdList->SetComputeRoot32BitConstants(3,
-            (UINT)GraphicsBindlessResourceIndices.size(),
-            GraphicsBindlessResourceIndices.data(), 0);
-        cmdList->SetComputeRootDescriptorTable(4, m_imageSamplerGpuHandle);
-        cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-
-
-        const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            pressureTexInput->GetResource(),
-            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-        const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            pressureTexOutput->GetResource(),
-            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-        const auto divergenceStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-            divTex->GetResource(),
-            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-
-
-        std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition, divergenceStateTransition };
-        cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-
-        m_gridPressureTexPair->Swap();
-    }
+    // Multigrid V-cycles, in place. The input & divergence pass wrote the first red pass from 0 along with the divergence.
+    m_pressureSolver.Solve(cmdList.Get(), *m_gridPressureTex, *m_gridDivergenceTex, Privates::PressureVCycleCount, true);
 }
 
 void ComputePassFluidSim2D::FluidStepProject(ComPtr<ID3D12GraphicsCommandList> cmdList) const
@@ -496,175 +394,78 @@ void ComputePassFluidSim2D::FluidStepProject(ComPtr<ID3D12GraphicsCommandList> c
 
     auto velocityInTex = m_gridVelocityTexPair->GetInput();
     auto velocityOutTex = m_gridVelocityTexPair->GetOutput();
-    auto pressureTex = m_gridPressureTexPair->GetInput();
-
-    {
-        Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjProject.get());
-
-        cmdList->SetComputeRootDescriptorTable(0, velocityInTex->GetSRVGPUDescriptorHandle());
-        cmdList->SetComputeRootDescriptorTable(1, pressureTex->GetSRVGPUDescriptorHandle());
-        cmdList->SetComputeRootDescriptorTable(2, velocityOutTex->GetUAVGPUDescriptorHandle());
-        cmdList->SetComputeRoot32BitConstant(3, Privates::GridDimensions.x, 0); // GridWidth
+    auto pressureTex = m_gridPressureTex.get();
 
-        constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
-        cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-    }
-
-    // Fix velocity at edges
-    {
+    m_resourceStates->Transition(velocityInTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(pressureTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->UAVWrite(velocityOutTex->GetResource());
+    m_resourceStates->FlushBarriers(cmdList.Get());
 
-    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjReflectEdgeVelocity.get());
+    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjProject.get());
 
-    cmdList->SetComputeRootDescriptorTable(0, m_dummySRVGPUHandle);
-    cmdList->SetComputeRootDescriptorTable(1, m_dummySRVGPUHandle);
+    cmdList->SetComputeRootDescriptorTable(0, velocityInTex->GetSRVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(1, pressureTex->GetSRVGPUDescriptorHandle());
     cmdList->SetComputeRootDescriptorTable(2, velocityOutTex->GetUAVGPUDescriptorHandle());
-    cmdList->SetComputeRoot32BitConstant(3, Privates::GridDimensions.x, 0); // GridWidth
+    cmdList->SetComputeRoot32BitConstant(3, m_settings.GridResolution, 0); // GridWidth
 
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
+    // The pressure's edges & the velocity's reflection at the edges are folded in
+    const ivec2 dispatchSize = GetDispatchSize();
     cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-    }
-
-    const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        velocityInTex->GetResource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        velocityOutTex->GetResource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-    cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
 
     m_gridVelocityTexPair->Swap();
 }
 
-void ComputePassFluidSim2D::FluidStepAdvectDensity(ComPtr<ID3D12GraphicsCommandList> cmdList) const
+void ComputePassFluidSim2D::FluidStepAdvect(ComPtr<ID3D12GraphicsCommandList> cmdList) const
 {
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepAdvectDensity");
+    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepAdvect");
 
-    auto velocityTex = m_gridVelocityTexPair->GetInput();
+    auto velocityInputTex = m_gridVelocityTexPair->GetInput();
+    auto velocityOutputTex = m_gridVelocityTexPair->GetOutput();
     auto densityInputTex = m_gridDensityTexPair->GetInput();
     auto densityOutputTex = m_gridDensityTexPair->GetOutput();
 
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
-
-	// - Advect density / colour
-    {
-        Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjAdvectDensity.get());
-
-        cmdList->SetComputeRootDescriptorTable(0, velocityTex->GetSRVGPUDescriptorHandle());
-        cmdList->SetComputeRootDescriptorTable(1, densityInputTex->GetSRVGPUDescriptorHandle());
-        cmdList->SetComputeRootDescriptorTable(2, densityOutputTex->GetUAVGPUDescriptorHandle());
-
-        const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-           Privates::GridDimensions.x,
-           m_imageSamplerIndex
-        };
-        cmdList->SetComputeRoot32BitConstants(
-            (UINT)3,
-            (UINT)GraphicsBindlessResourceIndices.size(), GraphicsBindlessResourceIndices.data(), 0);
-
-        cmdList->SetComputeRootDescriptorTable(
-            4,
-            m_imageSamplerGpuHandle
-        );
-
-        cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-    }
-
-	// - Fix edges
-    {
-
-        Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjAdvectDensityFixEdges.get());
-
-        cmdList->SetComputeRootDescriptorTable(0, m_dummySRVGPUHandle);
-        cmdList->SetComputeRootDescriptorTable(1, m_dummySRVGPUHandle);
-        cmdList->SetComputeRootDescriptorTable(2, densityOutputTex->GetUAVGPUDescriptorHandle());
-
-        const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-           Privates::GridDimensions.x,
-           m_imageSamplerIndex
-        };
-        cmdList->SetComputeRoot32BitConstants(
-            (UINT)3,
-            (UINT)GraphicsBindlessResourceIndices.size(), GraphicsBindlessResourceIndices.data(), 0);
-
-        cmdList->SetComputeRootDescriptorTable(
-            4,
-            m_imageSamplerGpuHandle
-        );
-        cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-    }
-
-
-    const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        densityInputTex->GetResource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        densityOutputTex->GetResource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-    cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-    m_gridDensityTexPair->Swap();
-}
-
-void ComputePassFluidSim2D::FluidStepAdvectVelocity(ComPtr<ID3D12GraphicsCommandList> cmdList) const
-{
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepAdvectVelocity");
+    m_resourceStates->Transition(velocityInputTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(densityInputTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->UAVWrite(velocityOutputTex->GetResource());
+    m_resourceStates->UAVWrite(densityOutputTex->GetResource());
+    m_resourceStates->FlushBarriers(cmdList.Get());
 
-    auto bufferInput = m_gridVelocityTexPair->GetInput();
-    auto bufferOutput = m_gridVelocityTexPair->GetOutput();
+    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjAdvect.get());
 
-    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjAdvectVelocity.get());
-
-    cmdList->SetComputeRootDescriptorTable(0, bufferInput->GetSRVGPUDescriptorHandle());
-    cmdList->SetComputeRootDescriptorTable(1, bufferOutput->GetUAVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(0, velocityInputTex->GetSRVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(1, densityInputTex->GetSRVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(2, velocityOutputTex->GetUAVGPUDescriptorHandle());
+    cmdList->SetComputeRootDescriptorTable(3, densityOutputTex->GetUAVGPUDescriptorHandle());
 
     const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-       Privates::GridDimensions.x,
-       m_imageSamplerIndex
+       int32_t(m_settings.GridResolution),
+       m_imageSamplerIndex,
+       std::bit_cast<int32_t>(m_simStep.StepDeltaTime)
     };
     cmdList->SetComputeRoot32BitConstants(
-        (UINT)2,
+        (UINT)4,
         (UINT)GraphicsBindlessResourceIndices.size(), GraphicsBindlessResourceIndices.data(), 0);
-    
+
     cmdList->SetComputeRootDescriptorTable(
-        3,
+        5,
         m_imageSamplerGpuHandle
     );
 
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
+    const ivec2 dispatchSize = GetDispatchSize();
     cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
-}
-
-void ComputePassFluidSim2D::FluidStepDiffuse(ComPtr<ID3D12GraphicsCommandList> cmdList) const
-{
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "FluidStepDiffuse");
 
-    auto bufferInput = m_gridVelocityTexPair->GetInput();
-    auto bufferOutput = m_gridVelocityTexPair->GetOutput();
-
-    Privates::ApplyRootSignatureAndPSO(cmdList, m_computeObjDiffuse.get());
-
-    cmdList->SetComputeRootDescriptorTable(0, bufferInput->GetSRVGPUDescriptorHandle());
-    cmdList->SetComputeRootDescriptorTable(1, bufferOutput->GetUAVGPUDescriptorHandle());
-    cmdList->SetComputeRoot32BitConstant(2, Privates::GridDimensions.x, 0); // GridWidth
-
-    constexpr ivec2 dispatchSize = Privates::ComputeDispatchSize(Privates::GridDimensions, Privates::ThreadGroupSize);
-    cmdList->Dispatch(dispatchSize.x, dispatchSize.y, 1);
+    m_gridVelocityTexPair->Swap();
+    m_gridDensityTexPair->Swap();
 }
 
 void ComputePassFluidSim2D::CopySimOutputToDisplayTexture(ComPtr<ID3D12GraphicsCommandList> cmdList) const
 {
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "Copy Sim output texture");
 
-    // resource barrier to copy to image render target
-    const auto imageRTTransitionToCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(m_imageRenderTarget->GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
     auto densityTex = m_gridDensityTexPair->GetInput();
-    //const auto simBufferOutputTransitionToCopySrc = CD3DX12_RESOURCE_BARRIER::Transition(bufferOutput->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
-    const auto simBufferOutputTransitionToCopySrc = CD3DX12_RESOURCE_BARRIER::Transition(densityTex->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE);
-    std::vector<CD3DX12_RESOURCE_BARRIER> prepForCopyTransition = { imageRTTransitionToCopyDest , simBufferOutputTransitionToCopySrc };
-    cmdList->ResourceBarrier((UINT)prepForCopyTransition.size(), prepForCopyTransition.data());
+    m_resourceStates->Transition(m_imageRenderTarget->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST);
+    m_resourceStates->Transition(densityTex->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+    m_resourceStates->FlushBarriers(cmdList.Get());
 
     D3D12_TEXTURE_COPY_LOCATION sourceLoc{
         .pResource = densityTex->GetResource(),
@@ -683,51 +484,28 @@ void ComputePassFluidSim2D::CopySimOutputToDisplayTexture(ComPtr<ID3D12GraphicsC
         &sourceLoc,
         nullptr);
 
-    //Resource barrier to transition back to original states
-    const auto imageRTTransitionToSrv = CD3DX12_RESOURCE_BARRIER::Transition(m_imageRenderTarget->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    //const auto simBufferOutputTransitionToUAV = CD3DX12_RESOURCE_BARRIER::Transition(bufferOutput->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto simBufferOutputTransitionToSRV = CD3DX12_RESOURCE_BARRIER::Transition(densityTex->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-    std::vector<CD3DX12_RESOURCE_BARRIER> returnResourcesToOriginalStateTransition = { imageRTTransitionToSrv , simBufferOutputTransitionToSRV };
-    cmdList->ResourceBarrier((UINT)returnResourcesToOriginalStateTransition.size(), returnResourcesToOriginalStateTransition.data());
+    // The image is transitioned for reading by the graphics pass drawing it
 }
 
-void ComputePassFluidSim2D::SwapVelocityTexturesStates(ComPtr<ID3D12GraphicsCommandList> cmdList) const
+ivec2 ComputePassFluidSim2D::GetDispatchSize() const
 {
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "SwapVelocityTexturesStates");
-
-    // Final swap before restarting the sim loop
-    auto velocityInput = m_gridVelocityTexPair->GetInput();
-    auto velocityOutput = m_gridVelocityTexPair->GetOutput();
-    const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(velocityInput->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(velocityOutput->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-    cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
-
-    m_gridVelocityTexPair->Swap();
+    const ivec2 gridDimensions = ivec2(int32_t(m_settings.GridResolution), int32_t(m_settings.GridResolution));
+    return Privates::ComputeDispatchSize(gridDimensions, m_settings.ThreadGroupSize);
 }
 
 void ComputePassFluidSim2D::RunSim(ComPtr<ID3D12GraphicsCommandList> cmdList,
     const FrameResource& frameResources,
-    ivec2 inputScreenPos, ivec2 inputPrevScreenPos) const
+    ivec2 inputScreenPos, ivec2 inputPrevScreenPos, bool resetSim) const
 {
-    FluidStepInput(cmdList, frameResources, inputScreenPos, inputPrevScreenPos);
-    FluidStepDiv(cmdList);
+    FluidStepInputDivergence(cmdList, frameResources, inputScreenPos, inputPrevScreenPos);
     FluidStepPressure(cmdList);
     FluidStepProject(cmdList);
-	FluidStepAdvectDensity(cmdList);
-    FluidStepAdvectVelocity(cmdList);
-    //FluidStepDiffuse(cmdList);
+    FluidStepAdvect(cmdList);
 
-    CopySimOutputToDisplayTexture(cmdList);
-
-    if (m_simNeedsReset.NeedsReset())
+    if (resetSim)
     {
         SimReset(cmdList);
     }
-
-    SwapVelocityTexturesStates(cmdList);
-
 }
 
 void ComputePassFluidSim2D::Execute(
@@ -737,13 +515,34 @@ void ComputePassFluidSim2D::Execute(
 {
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassFluidSim2D");
 
-    RunSim(cmdList, frameResources, m_inputScreenPos, m_inputPrevScreenPos);
+    if (m_simStep.StepCount == 0)
+    {
+        return;
+    }
+
+    for (uint32_t stepIdx = 0; stepIdx < m_simStep.StepCount; ++stepIdx)
+    {
+        // The cursor movement since the last simulated frame is applied once, by the first step
+        const bool isFirstStep = stepIdx == 0;
+        RunSim(cmdList, frameResources, m_inputScreenPos, isFirstStep ? m_inputPrevScreenPos : m_inputScreenPos, isFirstStep && m_simNeedsReset.NeedsReset());
+    }
+
+    // Only the latest state is displayed, intermediate steps aren't copied
+    CopySimOutputToDisplayTexture(cmdList);
 }
 
 void ComputePassFluidSim2D::Shutdown()
 {
 }
 
+void ComputePassFluidSim2D::GetSimStateBindings(std::vector<SimStateBinding>& outBindings)
+{
+    // Pressure & divergence are rebuilt from scratch every step, the velocity & density inputs are all the next step reads
+    outBindings.push_back({ "Velocity", SimStateStorage::GPU, m_gridVelocityTexPair->GetInput()->GetResource(), Privates::GetTexelByteSize(m_velocityFormat), m_settings.GridResolution, m_settings.GridResolution });
+    outBindings.push_back({ "Density", SimStateStorage::GPU, m_gridDensityTexPair->GetInput()->GetResource(), Privates::GetTexelByteSize(m_densityFormat), m_settings.GridResolution, m_settings.GridResolution });
+    outBindings.push_back({ "SimTime", SimStateStorage::CPU, &m_timer, sizeof(m_timer), 1 });
+}
+
 //--------------------------------------
 namespace GFXPrivates
 {
@@ -772,6 +571,9 @@ namespace GFXPrivates
 void GraphicsPassFluidSim2D::Init(std::weak_ptr<const ComputePassFluidSim2D> fluidSimComputePass, IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, MeshLibrary& meshLibrary)
 {
     m_imageSRVIndex = fluidSimComputePass.lock()->GetImageRTSRVIndex();
+    m_imageResource = fluidSimComputePass.lock()->GetImageRTResource();
+    m_gridResolution = fluidSimComputePass.lock()->GetGridResolution();
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
 
     m_imageSamplerIndex = AstroTools::Rendering::SamplerIDs::LinearClamp;
     m_imageSamplerGpuHandle = renderer->GetSamplerGPUHandle(m_imageSamplerIndex);
@@ -892,7 +694,7 @@ void GraphicsPassFluidSim2D::Execute(
     cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
     cmdList->SetPipelineState(m_pipelineStateObject.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
     const uint32_t GraphicsBindlessResourceIndicesRootSigParamIndex = 1;
@@ -900,7 +702,7 @@ void GraphicsPassFluidSim2D::Execute(
         m_imageSRVIndex,
         m_imageSamplerIndex,
         m_quadMesh.lock()->GetVertexBufferSRV(),
-        Privates::GridDimensions.x
+        int32_t(m_gridResolution)
     };
     cmdList->SetGraphicsRoot32BitConstants(
         (UINT)GraphicsBindlessResourceIndicesRootSigParamIndex,
@@ -911,6 +713,9 @@ void GraphicsPassFluidSim2D::Execute(
         m_imageSamplerGpuHandle
     );
 
+    m_resourceStates->Transition(m_imageResource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->FlushBarriers(cmdList.Get());
+
     cmdList->DrawIndexedInstanced((UINT)m_quadMesh.lock()->GetVertexIndicesCount(), 1, 0, 0, 0);
 }
 
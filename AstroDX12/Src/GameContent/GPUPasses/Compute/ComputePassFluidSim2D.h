@@ -8,17 +8,33 @@
 #include <Rendering/Common/MeshLibrary.h>
 
 #include <Rendering/Compute/ComputableObject.h>
+#include <Rendering/Compute/GPUMultigridPoisson2D.h>
 #include <Rendering/Common/RenderTarget.h>
 #include <Rendering/Common/RenderResourcePair.h>
 #include <Rendering/Common/TickableResetFlag.h>
+#include <Rendering/Common/SimStateSnapshot.h>
 
+class ResourceBarrierBatcher;
 
 class ComputePassFluidSim2D :
-    public ComputePass
+    public ComputePass, public ISimStateOwner
 {
 public:
 
-    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary);
+    struct SimSettings
+    {
+        // Square grid, a power of 2 multiple of GPUMultigridPoisson2D::CoarsestResolution. 1024 takes ~16x the 256 one's bandwidth.
+        uint32_t GridResolution = 256;
+        // THREAD_GROUP_SIZE_X/Y of the FluidSim shaders, one permutation per shape. Divides the resolution, at most 1024 threads.
+        ivec2 ThreadGroupSize = ivec2(16, 16);
+        // R16 velocity & density: half their bandwidth, ~3 significant digits.
+        bool HalfPrecisionStorage = false;
+        // R16 pressure: its rounding alone leaves a residual above the unsolved one's (FluidPressure_MultigridResolution), the projected velocity keeps that divergence.
+        // Stays R32 if the GPU can't load R16 UAVs, the multigrid smoothing reads & writes it in place.
+        bool HalfPrecisionPressure = false;
+    };
+
+    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, const SimSettings& settings = {});
     virtual void Update(const GPUPassUpdateData& updateData) override;
     virtual void Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float deltaTime, const FrameResource& frameResources) const override;
     virtual void Shutdown() override;
@@ -28,54 +44,72 @@ public:
         return m_imageRenderTarget->GetSRVIndex();
 	}
 
+    ID3D12Resource* GetImageRTResource() const
+    {
+        return m_imageRenderTarget->GetResource();
+    }
+
+    uint32_t GetGridResolution() const
+    {
+        return m_settings.GridResolution;
+    }
+
     virtual void OnSimReset()
     {
 		m_simNeedsReset.FlagForReset();
         m_timer = 0;
     }
 
+    // ISimStateOwner - BEGIN
+    virtual std::string_view GetSimStateName() const override { return "FluidSim2D"; }
+    virtual uint32_t GetSimStateLayoutVersion() const override { return 1; }
+    virtual void GetSimStateBindings(std::vector<SimStateBinding>& outBindings) override;
+    virtual void OnSimStateRestored() override
+    {
+        // The restored state replaces whatever reset was pending
+        m_simNeedsReset = {};
+    }
+    // ISimStateOwner - END
+
 private:
     
     int32_t m_frameIdxModulo = 0;
+    SimSettings m_settings;
+    SimStepData m_simStep;
     TickableResetFlag m_simNeedsReset;
-    float m_timer = 0;
+    float m_timer = 0; // Simulated time, advances by whole sim steps
 
 	void SimReset(ComPtr<ID3D12GraphicsCommandList>& cmdList) const;
-    void RunSim(ComPtr<ID3D12GraphicsCommandList> cmdList, const FrameResource& frameResources, ivec2 inputScreenPos, ivec2 inputPrevScreenPos) const;
-    void FluidStepInput(ComPtr<ID3D12GraphicsCommandList> cmdList, const FrameResource& frameResources, ivec2 inputScreenPos, ivec2 inputPrevScreenPos) const;
-    void FluidStepAdvectDensity(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
-    void FluidStepAdvectVelocity(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
-    void FluidStepDiv(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
-    void FluidStepDiffuse(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
+    void RunSim(ComPtr<ID3D12GraphicsCommandList> cmdList, const FrameResource& frameResources, ivec2 inputScreenPos, ivec2 inputPrevScreenPos, bool resetSim) const;
+    // One pass per step, besides the pressure solve: input & divergence, projection, advection. The boundaries are folded into them.
+    void FluidStepInputDivergence(ComPtr<ID3D12GraphicsCommandList> cmdList, const FrameResource& frameResources, ivec2 inputScreenPos, ivec2 inputPrevScreenPos) const;
     void FluidStepPressure(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
     void FluidStepProject(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
+    void FluidStepAdvect(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
     void CopySimOutputToDisplayTexture(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
-    void SwapVelocityTexturesStates(ComPtr<ID3D12GraphicsCommandList> cmdList) const;
+    ivec2 GetDispatchSize() const; // Of the per cell passes
 
     std::unique_ptr<RenderResourcePair<RenderTarget>> m_gridDensityTexPair;
     std::unique_ptr<RenderResourcePair<RenderTarget>> m_gridVelocityTexPair;
     std::unique_ptr<RenderTarget> m_gridDivergenceTex;
-    std::unique_ptr<RenderResourcePair<RenderTarget>> m_gridPressureTexPair;
+    std::unique_ptr<RenderTarget> m_gridPressureTex;
+    DXGI_FORMAT m_velocityFormat = DXGI_FORMAT_R32G32_FLOAT;
+    DXGI_FORMAT m_densityFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
 
 	std::unique_ptr<RenderTarget> m_imageRenderTarget;
 
-    std::unique_ptr<ComputableObject> m_computeObjInput;
-    std::unique_ptr<ComputableObject> m_computeObjAdvectDensity;
-    std::unique_ptr<ComputableObject> m_computeObjAdvectDensityFixEdges;
-    std::unique_ptr<ComputableObject> m_computeObjAdvectVelocity;
-    std::unique_ptr<ComputableObject> m_computeObjDiffuse;
-    std::unique_ptr<ComputableObject> m_computeObjDivergence;
-    std::unique_ptr<ComputableObject> m_computeObjPressure;
-    std::unique_ptr<ComputableObject> m_computeObjPressureFixEdges;
+    std::unique_ptr<ComputableObject> m_computeObjInputDivergence;
     std::unique_ptr<ComputableObject> m_computeObjProject;
-    std::unique_ptr<ComputableObject> m_computeObjReflectEdgeVelocity;
+    std::unique_ptr<ComputableObject> m_computeObjAdvect;
+
+    GPUMultigridPoisson2D m_pressureSolver;
 
 	ivec2 m_inputScreenPos;
     ivec2 m_inputPrevScreenPos;
-    D3D12_GPU_DESCRIPTOR_HANDLE m_dummySRVGPUHandle;
     int32_t m_imageSamplerIndex;
     D3D12_GPU_DESCRIPTOR_HANDLE m_imageSamplerGpuHandle;
 
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
 // Graphics
@@ -89,8 +123,12 @@ public:
 
 private:
     int32_t m_imageSRVIndex;
+    ID3D12Resource* m_imageResource = nullptr;
     int32_t m_imageSamplerIndex;
     D3D12_GPU_DESCRIPTOR_HANDLE m_imageSamplerGpuHandle;
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
+
+    uint32_t m_gridResolution = 0;
 
     std::weak_ptr<IMesh> m_quadMesh;
     ComPtr<ID3D12PipelineState> m_pipelineStateObject;
@@ -2,35 +2,55 @@
 
 #include <Rendering/IRenderer.h>
 #include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RendererContext.h>
 
 #include <Rendering\Common\MeshLibrary.h>
 #include <Rendering\Renderable\IRenderable.h>
 #include <Rendering\Common\FrameResource.h>
 #include <Rendering/CommonMeshes.h>
+#include <bit>
+#include <cstddef>
 
 using namespace AstroTools::Rendering;
 
 
-ComputePassParticles::ComputePassParticles()
-    : m_frameIdxModulo(0)
+namespace Privates
 {
-    auto BufferDataVector = std::vector<ParticleData>(20);
-    for (auto& ParticleData : BufferDataVector)
-    {
-        ParticleData.Duration = 3.f + (float(rand() % 200) / 200);
-        ParticleData.Size = 1.f;
-    }
+    constexpr uint32_t ParticlesThreadGroupSize = 64; // PARTICLES_THREAD_GROUP_SIZE in particles.hlsl
+}
 
-    m_particleDataBufferPing = std::make_unique<StructuredBuffer<ParticleData>>(BufferDataVector);
-    m_particleDataBufferPong = std::make_unique<StructuredBuffer<ParticleData>>(BufferDataVector);
+ComputePassParticles::ComputePassParticles(uint32_t maxParticleCount, float emissionRate)
+    : m_maxParticleCount(maxParticleCount)
+    , m_emissionRate(emissionRate)
+    , m_simStep()
+{
+    // Every list is sized for the whole pool, only the counted entries are ever read: nothing to upload
+    m_particleBuffer = std::make_unique<GPUStructuredBuffer<Particles::Particle>>(maxParticleCount);
+    m_deadListBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(maxParticleCount, GPUBufferInitialContent::ComputeFilled);
+    m_aliveListBuffers[0] = std::make_unique<GPUStructuredBuffer<uint32_t>>(maxParticleCount);
+    m_aliveListBuffers[1] = std::make_unique<GPUStructuredBuffer<uint32_t>>(maxParticleCount);
+    m_countersBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(uint32_t(Particles::Counter::Count), GPUBufferInitialContent::ZeroFilled);
+    // Zero filled: nothing is drawn until the first step has run
+    m_indirectArgsBuffer = std::make_unique<GPUStructuredBuffer<ParticleIndirectArgs>>(1, GPUBufferInitialContent::ZeroFilled, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 }
 
-void ComputePassParticles::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary)
+void ComputePassParticles::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, const MeshLibrary& meshLibrary)
 {
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
+    // Particles are drawn as spheres, the draw args are written on the GPU
+    std::weak_ptr<IMesh> mesh;
+    DX::astro_assert(AstroDX::CommonMeshes::GetCommonMesh(meshLibrary, AstroDX::CommonMeshNames::Sphere, mesh), "Failed to load Sphere mesh");
+    m_meshIndexCount = uint32_t(mesh.lock()->GetVertexIndicesCount());
+
     const auto rootPath = s2ws(DX::GetWorkingDirectory());
     {
-        renderer->CreateStructuredBufferAndViews(m_particleDataBufferPing.get(), std::wstring_view(L"ParticlesData_Ping"), true, true);
-        renderer->CreateStructuredBufferAndViews(m_particleDataBufferPong.get(), std::wstring_view(L"ParticlesData_Pong"), true, true);
+        renderer->CreateStructuredBufferAndViews(m_particleBuffer.get(), std::wstring_view(L"Particles"), true, true);
+        renderer->CreateStructuredBufferAndViews(m_deadListBuffer.get(), std::wstring_view(L"ParticlesDeadList"), true, true);
+        renderer->CreateStructuredBufferAndViews(m_aliveListBuffers[0].get(), std::wstring_view(L"ParticlesAliveList_0"), true, true);
+        renderer->CreateStructuredBufferAndViews(m_aliveListBuffers[1].get(), std::wstring_view(L"ParticlesAliveList_1"), true, true);
+        renderer->CreateStructuredBufferAndViews(m_countersBuffer.get(), std::wstring_view(L"ParticlesCounters"), true, true, /*byteAddressBuffer*/true);
+        renderer->CreateStructuredBufferAndViews(m_indirectArgsBuffer.get(), std::wstring_view(L"ParticlesIndirectArgs"), true, true);
 
         const auto computeShaderPath = rootPath + std::wstring(L"\\Shaders\\particles.hlsl");
 
@@ -42,7 +62,7 @@ void ComputePassParticles::Init(IRenderer* renderer, AstroTools::Rendering::Shad
             {
                 .ShaderRegister = 0,
                 .RegisterSpace = 0,
-                .Num32BitValues = 2
+                .Num32BitValues = 12
             },
             .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
         };
@@ -70,89 +90,199 @@ void ComputePassParticles::Init(IRenderer* renderer, AstroTools::Rendering::Shad
         }
         ThrowIfFailed(hr);
 
-        ComPtr<ID3D12RootSignature> rootSignature = nullptr;
-        renderer->CreateRootSignature(serializedRootSignature, rootSignature);
+        renderer->CreateRootSignature(serializedRootSignature, m_rootSignature);
 
-        ComputableDesc computableObjDesc(computeShaderPath);
-        computableObjDesc.RootSignature = rootSignature;
-
-        // Create shader
-        computableObjDesc.CS = shaderLibrary.GetCompiledShader(computableObjDesc.ComputeShaderPath, L"CSMain", {}, L"cs_6_6");
+        // One PSO per kernel, all sharing the root signature
+        const auto createComputeObj = [&](const wchar_t* entryPoint)
+        {
+            ComputableDesc computableObjDesc(computeShaderPath);
+            computableObjDesc.RootSignature = m_rootSignature;
+            computableObjDesc.CS = shaderLibrary.GetCompiledShader(computableObjDesc.ComputeShaderPath, entryPoint, {}, L"cs_6_6");
+            renderer->CreateComputePipelineState(
+                computableObjDesc.PipelineStateObject,
+                computableObjDesc.RootSignature,
+                computableObjDesc.CS);
+            return std::make_unique<ComputableObject>(computableObjDesc.RootSignature, computableObjDesc.PipelineStateObject);
+        };
+        m_resetComputeObj = createComputeObj(L"CSReset");
+        m_prepareStepComputeObj = createComputeObj(L"CSPrepareStep");
+        m_emitComputeObj = createComputeObj(L"CSEmit");
+        m_simulateComputeObj = createComputeObj(L"CSSimulate");
+        m_prepareDrawComputeObj = createComputeObj(L"CSPrepareDraw");
+    }
 
-        // Compile PSO
-        renderer->CreateComputePipelineState(
-            computableObjDesc.PipelineStateObject,
-            computableObjDesc.RootSignature,
-            computableObjDesc.CS);
+    // Emit & simulate are dispatched from the args CSPrepareStep wrote, the root constants set before stay bound
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC argDesc = {};
+        argDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
 
-        m_particlesComputeObj = std::make_unique<ComputableObject>(computableObjDesc.RootSignature, computableObjDesc.PipelineStateObject);
+        D3D12_COMMAND_SIGNATURE_DESC sigDesc = {};
+        sigDesc.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS);
+        sigDesc.NumArgumentDescs = 1;
+        sigDesc.pArgumentDescs = &argDesc;
 
+        // No root arguments changed by the command signature, so no root signature
+        renderer->CreateCommandSignature(&sigDesc, nullptr, m_dispatchCommandSignature);
     }
-
-    // TODO (schedule init particles pass)
 }
 
 void ComputePassParticles::Update(const GPUPassUpdateData& updateData)
 {
-    m_frameIdxModulo = updateData.frameIdxModulo;
+    m_simStep = updateData.simStep;
+
+    m_firstStepIndex = m_cpuState.StepIndex;
+    m_firstStepAliveListIdx = m_cpuState.AliveListIdx;
+
+    // Emission is decided on the CPU, as a budget per step, the GPU clamps it to the dead particles
+    m_stepEmitBudgets.clear();
+    for (uint32_t stepIdx = 0; stepIdx < m_simStep.StepCount; ++stepIdx)
+    {
+        m_stepEmitBudgets.push_back(m_cpuState.Emission.Next(m_emissionRate, m_simStep.StepDeltaTime));
+    }
+
+    // Every step swaps the alive lists
+    m_cpuState.StepIndex += m_simStep.StepCount;
+    m_cpuState.AliveListIdx = (m_cpuState.AliveListIdx + m_simStep.StepCount) % 2;
 }
 
-int32_t ComputePassParticles::GetParticleReadBufferSRVHeapIndex() const
+int32_t ComputePassParticles::GetParticleBufferSRVHeapIndex() const
 {
-    auto bufferInput = m_frameIdxModulo % 2 == 0 ? m_particleDataBufferPing.get() : m_particleDataBufferPong.get();
-    return bufferInput->GetSRVIndex();
+    return m_particleBuffer->GetSRVIndex();
 }
 
-int32_t ComputePassParticles::GetParticleOutputBufferSRVHeapIndex() const
+int32_t ComputePassParticles::GetLatestAliveListSRVHeapIndex() const
 {
-    auto bufferInput = m_frameIdxModulo % 2 == 1 ? m_particleDataBufferPing.get() : m_particleDataBufferPong.get();
-    return bufferInput->GetSRVIndex();
+    return m_aliveListBuffers[m_cpuState.AliveListIdx]->GetSRVIndex();
 }
 
-void ComputePassParticles::Execute(
-    ComPtr<ID3D12GraphicsCommandList> cmdList,
-    float /*deltaTime*/,
-    const FrameResource& /*frameResources*/) const
+int32_t ComputePassParticles::GetCountersSRVHeapIndex() const
 {
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassParticles");
-
-    // Dispatch Particle update
-    auto bufferInput = m_frameIdxModulo % 2 == 0 ? m_particleDataBufferPing.get() : m_particleDataBufferPong.get();
-    auto bufferOutput = m_frameIdxModulo % 2 == 1 ? m_particleDataBufferPing.get() : m_particleDataBufferPong.get();
-
-	cmdList->SetComputeRootSignature(m_particlesComputeObj->GetRootSignature().Get());
-	cmdList->SetPipelineState(m_particlesComputeObj->GetPSO().Get());
+    return m_countersBuffer->GetSRVIndex();
+}
 
+void ComputePassParticles::SetRootConstants(ID3D12GraphicsCommandList* cmdList, uint32_t aliveListInIdx, uint32_t emitBudget, uint32_t stepIndex) const
+{
     constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 0;
     const std::vector<int32_t> BindlessResourceIndices = {
-        bufferInput->GetSRVIndex(),
-        bufferOutput->GetUAVIndex()
+        m_particleBuffer->GetUAVIndex(),
+        m_deadListBuffer->GetUAVIndex(),
+        m_aliveListBuffers[aliveListInIdx]->GetUAVIndex(),
+        m_aliveListBuffers[1 - aliveListInIdx]->GetUAVIndex(),
+        m_countersBuffer->GetUAVIndex(),
+        m_indirectArgsBuffer->GetUAVIndex(),
+        std::bit_cast<int32_t>(m_simStep.StepDeltaTime),
+        int32_t(emitBudget),
+        int32_t(stepIndex),
+        int32_t(aliveListInIdx),
+        int32_t(m_maxParticleCount),
+        int32_t(m_meshIndexCount)
     };
     cmdList->SetComputeRoot32BitConstants(
         (UINT)BindlessResourceIndicesRootSigParamIndex,
         (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
+}
 
-    //TODO compute dispatch size
-	cmdList->Dispatch(1, 1, 1);
+void ComputePassParticles::ExecuteSteps(ID3D12GraphicsCommandList* cmdList) const
+{
+    for (uint32_t stepIdx = 0; stepIdx < m_simStep.StepCount; ++stepIdx)
+    {
+        const uint32_t aliveListInIdx = (m_firstStepAliveListIdx + stepIdx) % 2;
+        SetRootConstants(cmdList, aliveListInIdx, m_stepEmitBudgets[stepIdx], m_firstStepIndex + stepIdx);
+
+        // Emit count & dispatch sizes
+        m_resourceStates->UAVWrite(m_countersBuffer->Resource());
+        m_resourceStates->UAVWrite(m_indirectArgsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_prepareStepComputeObj->GetPSO().Get());
+        cmdList->Dispatch(1, 1, 1);
+
+        // Emit
+        m_resourceStates->Transition(m_indirectArgsBuffer->Resource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        m_resourceStates->UAVWrite(m_particleBuffer->Resource());
+        m_resourceStates->UAVWrite(m_deadListBuffer->Resource());
+        m_resourceStates->UAVWrite(m_aliveListBuffers[aliveListInIdx]->Resource());
+        m_resourceStates->UAVWrite(m_countersBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_emitComputeObj->GetPSO().Get());
+        cmdList->ExecuteIndirect(m_dispatchCommandSignature.Get(), 1, m_indirectArgsBuffer->Resource(), offsetof(ParticleIndirectArgs, Emit), nullptr, 0);
+
+        // Simulate
+        m_resourceStates->UAVWrite(m_particleBuffer->Resource());
+        m_resourceStates->UAVWrite(m_deadListBuffer->Resource());
+        m_resourceStates->UAVRead(m_aliveListBuffers[aliveListInIdx]->Resource());
+        m_resourceStates->UAVWrite(m_aliveListBuffers[1 - aliveListInIdx]->Resource());
+        m_resourceStates->UAVWrite(m_countersBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_simulateComputeObj->GetPSO().Get());
+        cmdList->ExecuteIndirect(m_dispatchCommandSignature.Get(), 1, m_indirectArgsBuffer->Resource(), offsetof(ParticleIndirectArgs, Simulate), nullptr, 0);
+    }
 
-    // Transition resources into their next correct state
-    const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        bufferOutput->Resource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        bufferInput->Resource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    // Instance count of the draw, from the latest alive count
+    SetRootConstants(cmdList, m_cpuState.AliveListIdx, 0, 0);
 
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-    cmdList->ResourceBarrier(2, buffersStateTransition.data());
+    m_resourceStates->UAVRead(m_countersBuffer->Resource());
+    m_resourceStates->UAVWrite(m_indirectArgsBuffer->Resource());
+    m_resourceStates->FlushBarriers(cmdList);
 
+    cmdList->SetPipelineState(m_prepareDrawComputeObj->GetPSO().Get());
+    cmdList->Dispatch(1, 1, 1);
 }
 
+void ComputePassParticles::Execute(
+    ComPtr<ID3D12GraphicsCommandList> cmdList,
+    float /*deltaTime*/,
+    const FrameResource& /*frameResources*/) const
+{
+    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassParticles");
+
+    cmdList->SetComputeRootSignature(m_rootSignature.Get());
+
+    // Once: every particle on the dead list
+    if (m_deadListBuffer->NeedsComputeFill())
+    {
+        SetRootConstants(cmdList.Get(), 0, 0, 0);
+
+        m_resourceStates->UAVWrite(m_deadListBuffer->Resource());
+        m_resourceStates->UAVWrite(m_countersBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+
+        cmdList->SetPipelineState(m_resetComputeObj->GetPSO().Get());
+        cmdList->Dispatch((m_maxParticleCount + Privates::ParticlesThreadGroupSize - 1) / Privates::ParticlesThreadGroupSize, 1, 1);
+        m_deadListBuffer->MarkComputeFilled();
+    }
+
+    // No step due: the previous frame's state & draw args are still the latest
+    if (m_simStep.StepCount > 0)
+    {
+        ExecuteSteps(cmdList.Get());
+    }
+
+    // The latest state is drawn & raymarched this frame
+    m_resourceStates->Transition(m_particleBuffer->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(m_aliveListBuffers[m_cpuState.AliveListIdx]->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(m_countersBuffer->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(m_indirectArgsBuffer->Resource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    m_resourceStates->FlushBarriers(cmdList.Get());
+}
 
 void ComputePassParticles::Shutdown()
 {
 }
 
+void ComputePassParticles::GetSimStateBindings(std::vector<SimStateBinding>& outBindings)
+{
+    // Both alive lists: which one is the latest is part of the CPU state
+    outBindings.push_back({ "Particles", SimStateStorage::GPU, m_particleBuffer->Resource(), sizeof(Particles::Particle), m_maxParticleCount });
+    outBindings.push_back({ "DeadList", SimStateStorage::GPU, m_deadListBuffer->Resource(), sizeof(uint32_t), m_maxParticleCount });
+    outBindings.push_back({ "AliveList0", SimStateStorage::GPU, m_aliveListBuffers[0]->Resource(), sizeof(uint32_t), m_maxParticleCount });
+    outBindings.push_back({ "AliveList1", SimStateStorage::GPU, m_aliveListBuffers[1]->Resource(), sizeof(uint32_t), m_maxParticleCount });
+    outBindings.push_back({ "Counters", SimStateStorage::GPU, m_countersBuffer->Resource(), sizeof(uint32_t), uint32_t(Particles::Counter::Count) });
+    outBindings.push_back({ "CPUState", SimStateStorage::CPU, &m_cpuState, sizeof(m_cpuState), 1 });
+}
+
 //---------------------------------------------------------------------------------------
 // Graphics Pass
 //---------------------------------------------------------------------------------------
@@ -201,7 +331,7 @@ void GraphicsPassParticles::Init(std::weak_ptr<const ComputePassParticles>  part
         {
             .ShaderRegister = 1,
             .RegisterSpace = 0,
-            .Num32BitValues = 2
+            .Num32BitValues = 5
         },
         .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
     };
@@ -240,6 +370,19 @@ void GraphicsPassParticles::Init(std::weak_ptr<const ComputePassParticles>  part
         nullptr,
         vs,
         ps);
+
+    // One instance per alive particle, the instance count is only known on the GPU
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC argDesc = {};
+        argDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC sigDesc = {};
+        sigDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+        sigDesc.NumArgumentDescs = 1;
+        sigDesc.pArgumentDescs = &argDesc;
+
+        renderer->CreateCommandSignature(&sigDesc, nullptr, m_drawCommandSignature);
+    }
 }
 
 void GraphicsPassParticles::Update(const GPUPassUpdateData& /*updateData*/)
@@ -260,20 +403,33 @@ void GraphicsPassParticles::Execute(
     cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
     cmdList->SetPipelineState(m_pipelineStateObject.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
+    // The sim runs at its own rate, particles are extrapolated from the latest sim state to the current time
+    const auto particlesComputePass = m_particlesComputePass.lock();
+    const SimStepData& simStep = particlesComputePass->GetSimStepData();
+
     const uint32_t GraphicsBindlessResourceIndicesRootSigParamIndex = 1;
     const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-        m_particlesComputePass.lock()->GetParticleOutputBufferSRVHeapIndex(),
-        m_mesh.lock()->GetVertexBufferSRV()                             
+        particlesComputePass->GetParticleBufferSRVHeapIndex(),
+        particlesComputePass->GetLatestAliveListSRVHeapIndex(),
+        m_mesh.lock()->GetVertexBufferSRV(),
+        std::bit_cast<int32_t>(simStep.InterpolationAlpha),
+        std::bit_cast<int32_t>(simStep.StepDeltaTime)
     };                                                                      
     cmdList->SetGraphicsRoot32BitConstants(
         (UINT)GraphicsBindlessResourceIndicesRootSigParamIndex,
         (UINT)GraphicsBindlessResourceIndices.size(), GraphicsBindlessResourceIndices.data(), 0);
 
-    const int particleCount = 20; // TODO: this is the maximum - the GPU will need to set the size of the mesh to zero for particles that are not alive
-    cmdList->DrawIndexedInstanced((UINT)m_mesh.lock()->GetVertexIndicesCount(), particleCount, 0, 0, 0);
+    // Args written by the particles compute pass, from the latest alive count
+    cmdList->ExecuteIndirect(
+        m_drawCommandSignature.Get(),
+        1,
+        particlesComputePass->GetIndirectArgsResource(),
+        offsetof(ParticleIndirectArgs, Draw),
+        nullptr,
+        0);
 }
 
 void GraphicsPassParticles::Shutdown()
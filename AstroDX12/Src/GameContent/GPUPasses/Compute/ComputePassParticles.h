@@ -4,46 +4,39 @@
 #include <Rendering/Common/GPUPass.h>
 #include <Rendering/Compute/ComputableObject.h>
 #include <directxmath.h>
-#include <Rendering/Common/StructuredBuffer.h>
+#include <Rendering/Common/GPUStructuredBuffer.h>
 #include <Rendering/RenderData/Mesh.h>
+#include <Rendering/Common/SimStateSnapshot.h>
+#include <Simulation/ParticleSystem.h>
 
 using Microsoft::WRL::ComPtr;
 
 class IRenderer;
 class MeshLibrary;
+class ResourceBarrierBatcher;
 namespace AstroTools::Rendering
 {
     class ShaderLibrary;
 }
 
-struct ParticleData
+// Keep in sync with ParticleIndirectArgs in particles.hlsl, one ExecuteIndirect per member
+struct ParticleIndirectArgs
 {
-    ParticleData()
-        : Pos(0.f, 0.f, 0.f)
-        , Vel(0.f,0.f,0.f)
-        , Age(0.f)
-        , Duration(5.f)
-		, Size(1.f)
-    {
-    }
-    
-    // Make sure to keep Input layout in sync
-    DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT3 Vel;
-    float Age;
-    float Duration;
-    float Size;
+    D3D12_DISPATCH_ARGUMENTS Emit;
+    D3D12_DISPATCH_ARGUMENTS Simulate;
+    D3D12_DRAW_INDEXED_ARGUMENTS Draw;
 };
 
-
-
+// GPU particle system: a fixed pool of particles, with dead & alive lists of slot indices.
+// The CPU only decides how many particles to emit per step, emission, simulation & drawing are sized on the GPU from the alive count.
+// Particles::CPUParticleSystem is its CPU reference.
 class ComputePassParticles :
-    public ComputePass
+    public ComputePass, public ISimStateOwner
 {
 public:
-    ComputePassParticles();
+    ComputePassParticles(uint32_t maxParticleCount, float emissionRate);
 
-    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary);
+    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, const MeshLibrary& meshLibrary);
     virtual void Update(const GPUPassUpdateData& updateData) override;
     virtual void Execute(
         ComPtr<ID3D12GraphicsCommandList> cmdList,
@@ -51,16 +44,64 @@ public:
         const FrameResource& frameResources) const override;
     virtual void Shutdown() override;
 
-    int32_t GetParticleReadBufferSRVHeapIndex() const;
-    int32_t GetParticleOutputBufferSRVHeapIndex() const;
+    // ISimStateOwner - BEGIN
+    virtual std::string_view GetSimStateName() const override { return "Particles"; }
+    virtual uint32_t GetSimStateLayoutVersion() const override { return 2; }
+    virtual void GetSimStateBindings(std::vector<SimStateBinding>& outBindings) override;
+    virtual void OnSimStateRestored() override
+    {
+        // The restored lists replace the pending reset
+        m_deadListBuffer->MarkComputeFilled();
+    }
+    // ISimStateOwner - END
+
+    int32_t GetParticleBufferSRVHeapIndex() const;
+    // Slot indices of the alive particles, as of the latest sim step
+    int32_t GetLatestAliveListSRVHeapIndex() const;
+    uint32_t GetLatestAliveListIdx() const { return m_cpuState.AliveListIdx; }
+    // Raw buffer of Particles::Counter, the alive count of alive list i is at (Particles::Counter::AliveCount0 + i) * 4
+    int32_t GetCountersSRVHeapIndex() const;
+    ID3D12Resource* GetIndirectArgsResource() const { return m_indirectArgsBuffer->Resource(); }
+    const SimStepData& GetSimStepData() const { return m_simStep; }
 
 private:
-    int32_t m_frameIdxModulo = 0;
+    // Every step of the frame, then the draw args
+    void ExecuteSteps(ID3D12GraphicsCommandList* cmdList) const;
+    void SetRootConstants(ID3D12GraphicsCommandList* cmdList, uint32_t aliveListInIdx, uint32_t emitBudget, uint32_t stepIndex) const;
 
-    std::unique_ptr<StructuredBuffer<ParticleData>> m_particleDataBufferPing;
-    std::unique_ptr<StructuredBuffer<ParticleData>> m_particleDataBufferPong;
+    // Snapshotted along with the buffers
+    struct CPUState
+    {
+        uint32_t StepIndex = 0; // Steps simulated so far, seeds the emission
+        uint32_t AliveListIdx = 0; // Alive list the next step emits into & simulates
+        Particles::EmissionBudget Emission;
+    };
+
+    const uint32_t m_maxParticleCount;
+    const float m_emissionRate; // Particles per second
+    uint32_t m_meshIndexCount = 0;
+
+    SimStepData m_simStep;
+    CPUState m_cpuState;
+    uint32_t m_firstStepIndex = 0;
+    uint32_t m_firstStepAliveListIdx = 0;
+    std::vector<uint32_t> m_stepEmitBudgets; // This frame's steps
+
+    std::unique_ptr<GPUStructuredBuffer<Particles::Particle>> m_particleBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_deadListBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_aliveListBuffers[2];
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_countersBuffer;
+    std::unique_ptr<GPUStructuredBuffer<ParticleIndirectArgs>> m_indirectArgsBuffer;
+
+    ComPtr<ID3D12RootSignature> m_rootSignature;
+    std::unique_ptr<ComputableObject> m_resetComputeObj;
+    std::unique_ptr<ComputableObject> m_prepareStepComputeObj;
+    std::unique_ptr<ComputableObject> m_emitComputeObj;
+    std::unique_ptr<ComputableObject> m_simulateComputeObj;
+    std::unique_ptr<ComputableObject> m_prepareDrawComputeObj;
+    ComPtr<ID3D12CommandSignature> m_dispatchCommandSignature;
 
-    std::unique_ptr<ComputableObject> m_particlesComputeObj;
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
 class GraphicsPassParticles : public GraphicsPass
@@ -76,6 +117,7 @@ private:
     std::weak_ptr<IMesh> m_mesh;
     ComPtr<ID3D12PipelineState> m_pipelineStateObject;
     ComPtr<ID3D12RootSignature> m_rootSignature;
+    ComPtr<ID3D12CommandSignature> m_drawCommandSignature;
 
     std::weak_ptr<const ComputePassParticles> m_particlesComputePass;
 };
\ No newline at end of file
@@ -2,53 +2,86 @@
 
 #include <Rendering/IRenderer.h>
 #include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RendererContext.h>
 
 #include <Rendering\Common\MeshLibrary.h>
 #include <Rendering\Renderable\IRenderable.h>
 #include <Rendering\Common\FrameResource.h>
 
 #include <pix3.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
 
 using namespace AstroTools::Rendering;
 using namespace DirectX;
 
 namespace Privates
 {
-    static const size_t NumChainElements = 15; // Keep in sync with hlsl file
+    static const float ChainGridSpacing = 16.f;
+    static const float ColliderGridCellSize = 16.f;
 }
 
-ComputePassPhysicsChain::ComputePassPhysicsChain()
-    : m_frameIdxModulo(0)
+ComputePassPhysicsChain::ComputePassPhysicsChain(uint32_t chainCount, uint32_t elementsPerChain)
+    : m_simStep()
 	, m_simNeedsReset(false)
+    , m_chainCount(chainCount)
 {
-    auto BufferDataVector = std::vector<PhysicsChain::ChainElementData>(Privates::NumChainElements);
+    DX::astro_assert(chainCount > 0 && chainCount <= D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION, "One threadgroup per chain, the chain count must fit a dispatch");
+    DX::astro_assert(elementsPerChain > 0 && elementsPerChain <= PhysicsChain::MaxChainElementCount, "A chain must fit in a threadgroup");
 
-	XMVECTOR nodePos = DirectX::XMVectorSet(10.f, 0.f, 10.f, 0.f);
-	XMVECTOR nodeOffset = DirectX::XMVectorSet(0.f, -8.f, 0.f, 0.f);
-    XMMATRIX rotation = DirectX::XMMatrixRotationRollPitchYaw(0.f, 0.f, 0.f);
-    for (int i = 0; i < Privates::NumChainElements; ++i)
-    {
-        DirectX::XMStoreFloat3( &BufferDataVector[i].Particle.Pos, nodePos);
-        DirectX::XMStoreFloat3( &BufferDataVector[i].Particle.PrevPos, nodePos);
+    // Small steps: as stiff as the 30 PBD iterations for 23 constraint iterations (see ChainXPBD_Convergence)
+    m_solverSettings.Mode = ChainPBD::SolverMode::XPBDSmallSteps;
 
-        // Compute rotation of element
-        rotation = DirectX::XMMatrixRotationRollPitchYaw(0.f, 0.f, i * 10.f * 3.14f / 180.f);
-		DirectX::XMStoreFloat3x3(&BufferDataVector[i].Particle.Rot,  DirectX::XMMatrixInverse(nullptr, rotation));
+    auto BufferDataVector = std::vector<PhysicsChain::ChainElementData>(size_t(chainCount) * elementsPerChain);
+    auto ChainDescVector = std::vector<PhysicsChain::ChainDesc>(chainCount);
 
-        XMVECTOR nodeOffsetRotated = DirectX::XMVector3TransformNormal(nodeOffset, rotation);
-        XMVECTOR nextNodePos = DirectX::XMVectorAdd(nodePos, nodeOffsetRotated);
-        nodePos = nextNodePos;
-        
-        BufferDataVector[i].RestLength = 8.0f;
-        BufferDataVector[i].ParentIndex = (i > 0) ? i - 1 : -1;
-        BufferDataVector[i].Pinned = (i > 0) ? false : true;
-        BufferDataVector[i].Radius = 2.f;
+    const uint32_t chainGridSize = uint32_t(std::ceil(std::sqrt(float(chainCount))));
+    for (uint32_t chainIdx = 0; chainIdx < chainCount; ++chainIdx)
+    {
+        PhysicsChain::ChainDesc& chainDesc = ChainDescVector[chainIdx];
+        chainDesc.FirstElement = chainIdx * elementsPerChain;
+        chainDesc.ElementCount = elementsPerChain;
+        chainDesc.Origin = XMFLOAT3(
+            10.f + float(chainIdx % chainGridSize) * Privates::ChainGridSpacing,
+            0.f,
+            10.f + float(chainIdx / chainGridSize) * Privates::ChainGridSpacing);
+
+        XMVECTOR nodePos = DirectX::XMLoadFloat3(&chainDesc.Origin);
+        XMVECTOR nodeOffset = DirectX::XMVectorSet(0.f, -8.f, 0.f, 0.f);
+        XMMATRIX rotation = DirectX::XMMatrixRotationRollPitchYaw(0.f, 0.f, 0.f);
+        for (uint32_t i = 0; i < elementsPerChain; ++i)
+        {
+            PhysicsChain::ChainElementData& element = BufferDataVector[chainDesc.FirstElement + i];
+            DirectX::XMStoreFloat3( &element.Particle.Pos, nodePos);
+            DirectX::XMStoreFloat3( &element.Particle.PrevPos, nodePos);
 
+            // Compute rotation of element
+            rotation = DirectX::XMMatrixRotationRollPitchYaw(0.f, 0.f, i * 10.f * 3.14f / 180.f);
+            DirectX::XMStoreFloat3x3(&element.Particle.Rot,  DirectX::XMMatrixInverse(nullptr, rotation));
 
+            XMVECTOR nodeOffsetRotated = DirectX::XMVector3TransformNormal(nodeOffset, rotation);
+            XMVECTOR nextNodePos = DirectX::XMVectorAdd(nodePos, nodeOffsetRotated);
+            nodePos = nextNodePos;
+        
+            element.RestLength = 8.0f;
+            element.ParentIndex = (i > 0) ? int32_t(i) - 1 : -1;
+            element.Pinned = (i > 0) ? false : true;
+            element.Radius = 2.f;
+            m_maxElementRadius = std::max(m_maxElementRadius, element.Radius);
+        }
     }
 
     m_chainDataBufferPing = std::make_unique<StructuredBuffer<PhysicsChain::ChainElementData>>(BufferDataVector);
     m_chainDataBufferPong = std::make_unique<StructuredBuffer<PhysicsChain::ChainElementData>>(BufferDataVector);
+    m_chainDescBuffer = std::make_unique<StructuredBuffer<PhysicsChain::ChainDesc>>(ChainDescVector);
+
+    // Allocated at capacity, SetColliders uploads the scene in their first elements
+    m_colliderBuffer = std::make_unique<StructuredBuffer<Colliders::Collider>>(std::vector<Colliders::Collider>(PhysicsChain::MaxColliderCount));
+    m_colliderGridDescBuffer = std::make_unique<StructuredBuffer<Colliders::GridDesc>>(std::vector<Colliders::GridDesc>(1));
+    m_colliderCellStartsBuffer = std::make_unique<StructuredBuffer<uint32_t>>(std::vector<uint32_t>(PhysicsChain::MaxColliderGridCellCount + 1, 0));
+    m_colliderIndicesBuffer = std::make_unique<StructuredBuffer<uint32_t>>(std::vector<uint32_t>(PhysicsChain::MaxColliderGridEntryCount, 0));
+    m_colliderSdfSamplesBuffer = std::make_unique<StructuredBuffer<float>>(std::vector<float>(PhysicsChain::MaxColliderSdfSampleCount, 0.f));
 }
 
 void ComputePassPhysicsChain::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, int32_t debugDrawBufferUAVIndex, int32_t debugDrawCounterUAVIndex)
@@ -57,6 +90,12 @@ void ComputePassPhysicsChain::Init(IRenderer* renderer, AstroTools::Rendering::S
     {
         renderer->CreateStructuredBufferAndViews(m_chainDataBufferPing.get(), std::wstring_view(L"ChainData_Ping"), true, true);
         renderer->CreateStructuredBufferAndViews(m_chainDataBufferPong.get(), std::wstring_view(L"ChainData_Pong"), true, true);
+        renderer->CreateStructuredBufferAndViews(m_chainDescBuffer.get(), std::wstring_view(L"ChainDescs"), true, false);
+        renderer->CreateStructuredBufferAndViews(m_colliderBuffer.get(), std::wstring_view(L"ChainColliders"), true, false);
+        renderer->CreateStructuredBufferAndViews(m_colliderGridDescBuffer.get(), std::wstring_view(L"ChainColliderGridDesc"), true, false);
+        renderer->CreateStructuredBufferAndViews(m_colliderCellStartsBuffer.get(), std::wstring_view(L"ChainColliderCellStarts"), true, false);
+        renderer->CreateStructuredBufferAndViews(m_colliderIndicesBuffer.get(), std::wstring_view(L"ChainColliderIndices"), true, false);
+        renderer->CreateStructuredBufferAndViews(m_colliderSdfSamplesBuffer.get(), std::wstring_view(L"ChainColliderSdfSamples"), true, false);
 
         const auto computeShaderPath = rootPath + std::wstring(L"\\Shaders\\physicsChainCompute.hlsl");
 
@@ -68,7 +107,7 @@ void ComputePassPhysicsChain::Init(IRenderer* renderer, AstroTools::Rendering::S
             {
                 .ShaderRegister = 0,
                 .RegisterSpace = 0,
-                .Num32BitValues = 5
+                .Num32BitValues = 17
             },
             .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
         };
@@ -119,25 +158,53 @@ void ComputePassPhysicsChain::Init(IRenderer* renderer, AstroTools::Rendering::S
 
     m_debugDrawBufferUAVIndex = debugDrawBufferUAVIndex;
     m_debugDrawCounterUAVIndex = debugDrawCounterUAVIndex;
+
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+}
+
+void ComputePassPhysicsChain::SetColliders(Colliders::ColliderSet colliderSet)
+{
+    DX::astro_assert(colliderSet.Colliders.size() <= PhysicsChain::MaxColliderCount, "Too many chain colliders for the collider buffer");
+    DX::astro_assert(colliderSet.SdfSamples.size() <= PhysicsChain::MaxColliderSdfSampleCount, "Too many SDF samples for the collider SDF buffer");
+
+    m_colliderSet = std::move(colliderSet);
+    m_colliderGrid.Build(m_colliderSet.Colliders, Privates::ColliderGridCellSize, m_maxElementRadius, PhysicsChain::MaxColliderGridCellCount);
+    DX::astro_assert(m_colliderGrid.GetColliderIndices().size() <= PhysicsChain::MaxColliderGridEntryCount, "Colliders overlap too many grid cells for the collider index buffer");
+
+    m_collidersChanged = true;
 }
 
 void ComputePassPhysicsChain::Update(const GPUPassUpdateData& updateData)
 {
-    m_frameIdxModulo = updateData.frameIdxModulo;
+    m_simStep = updateData.simStep;
+
+    m_uploadColliders = m_collidersChanged;
+    m_collidersChanged = false;
 
-    m_simNeedsReset.Tick();
+    // Every step swaps the ping/pong buffers
+    m_firstStepInputBufferIdx = m_latestBufferIdx;
+    m_latestBufferIdx = (m_latestBufferIdx + m_simStep.StepCount) % 2;
+
+    // A reset requested on a frame without any sim step waits for the next one
+    if (m_simStep.StepCount > 0)
+    {
+        m_simNeedsReset.Tick();
+    }
+}
+
+StructuredBuffer<PhysicsChain::ChainElementData>* ComputePassPhysicsChain::GetChainDataBuffer(uint32_t pingPongIdx) const
+{
+    return pingPongIdx % 2 == 0 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
 }
 
 int32_t ComputePassPhysicsChain::GetParticleReadBufferSRVHeapIndex() const
 {
-    auto bufferInput = m_frameIdxModulo % 2 == 0 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
-    return bufferInput->GetSRVIndex();
+    return GetChainDataBuffer(m_firstStepInputBufferIdx)->GetSRVIndex();
 }
 
 int32_t ComputePassPhysicsChain::GetParticleOutputBufferSRVHeapIndex() const
 {
-    auto bufferInput = m_frameIdxModulo % 2 == 1 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
-    return bufferInput->GetSRVIndex();
+    return GetChainDataBuffer(m_latestBufferIdx)->GetSRVIndex();
 }
 
 void ComputePassPhysicsChain::Execute(
@@ -147,38 +214,80 @@ void ComputePassPhysicsChain::Execute(
 {
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassPhysicsChain");
 
-    // Dispatch Particle update
-    auto bufferInput = m_frameIdxModulo % 2 == 0 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
-    auto bufferOutput = m_frameIdxModulo % 2 == 1 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
+    // Whether or not the sim steps this frame, the colliders must not be uploaded late
+    if (m_uploadColliders)
+    {
+        PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "UploadChainColliders");
+        if (!m_colliderSet.Colliders.empty())
+        {
+            m_colliderBuffer->CopyData(cmdList.Get(), m_colliderSet.Colliders);
+            m_colliderCellStartsBuffer->CopyData(cmdList.Get(), m_colliderGrid.GetCellStarts());
+            m_colliderIndicesBuffer->CopyData(cmdList.Get(), m_colliderGrid.GetColliderIndices());
+        }
+        if (!m_colliderSet.SdfSamples.empty())
+        {
+            m_colliderSdfSamplesBuffer->CopyData(cmdList.Get(), m_colliderSet.SdfSamples);
+        }
+        // An empty scene only needs its 0 collider count
+        m_colliderGridDescBuffer->CopyData(cmdList.Get(), { m_colliderGrid.GetDesc() });
+        // Each copy's transition back to readable went out with the next copy's batch, this sends the last one
+        m_resourceStates->FlushBarriers(cmdList.Get());
+    }
+
+    if (m_simStep.StepCount == 0)
+    {
+        return;
+    }
 
     cmdList->SetComputeRootSignature(m_particlesComputeObj->GetRootSignature().Get());
     cmdList->SetPipelineState(m_particlesComputeObj->GetPSO().Get());
 
-    constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 0;
-    const std::vector<int32_t> BindlessResourceIndices = {
-        bufferInput->GetSRVIndex(),
-        bufferOutput->GetUAVIndex(),
-        m_simNeedsReset.NeedsReset() ? 1 : 0,
-        m_debugDrawBufferUAVIndex,
-        m_debugDrawCounterUAVIndex
-    };
-    cmdList->SetComputeRoot32BitConstants(
-        (UINT)BindlessResourceIndicesRootSigParamIndex,
-        (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
-
-    // Transition resources into their next correct state
-    const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        bufferInput->Resource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        bufferOutput->Resource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-    cmdList->ResourceBarrier(2, buffersStateTransition.data());
-
-    //TODO compute dispatch size
-    cmdList->Dispatch(1, 1, 1);
+    // Dispatch chain update, once per fixed step
+    StructuredBuffer<PhysicsChain::ChainElementData>* bufferOutput = nullptr;
+    for (uint32_t stepIdx = 0; stepIdx < m_simStep.StepCount; ++stepIdx)
+    {
+        auto bufferInput = GetChainDataBuffer(m_firstStepInputBufferIdx + stepIdx);
+        bufferOutput = GetChainDataBuffer(m_firstStepInputBufferIdx + stepIdx + 1);
+
+        const bool isFirstStep = stepIdx == 0;
+        const bool isLastStep = stepIdx + 1 == m_simStep.StepCount;
+
+        constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 0;
+        const std::vector<int32_t> BindlessResourceIndices = {
+            bufferInput->GetSRVIndex(),
+            bufferOutput->GetUAVIndex(),
+            isFirstStep && m_simNeedsReset.NeedsReset() ? 1 : 0,
+            m_debugDrawBufferUAVIndex,
+            m_debugDrawCounterUAVIndex,
+            std::bit_cast<int32_t>(m_simStep.StepDeltaTime),
+            isLastStep ? 1 : 0,
+            m_chainDescBuffer->GetSRVIndex(),
+            int32_t(m_chainCount),
+            int32_t(m_solverSettings.Mode),
+            int32_t(m_solverSettings.Mode == ChainPBD::SolverMode::XPBDSmallSteps ? m_solverSettings.SubstepCount : m_solverSettings.IterationCount),
+            std::bit_cast<int32_t>(m_solverSettings.Compliance),
+            m_colliderBuffer->GetSRVIndex(),
+            m_colliderGridDescBuffer->GetSRVIndex(),
+            m_colliderCellStartsBuffer->GetSRVIndex(),
+            m_colliderIndicesBuffer->GetSRVIndex(),
+            m_colliderSdfSamplesBuffer->GetSRVIndex()
+        };
+        cmdList->SetComputeRoot32BitConstants(
+            (UINT)BindlessResourceIndicesRootSigParamIndex,
+            (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
+
+        // Ping-pong buffers: the tracker knows which one is where, whatever the step count or a previous reset
+        m_resourceStates->Transition(bufferInput->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        m_resourceStates->UAVWrite(bufferOutput->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+
+        // One group per chain
+        cmdList->Dispatch(m_chainCount, 1, 1);
+    }
+
+    // The latest state is what gets drawn this frame
+    m_resourceStates->Transition(bufferOutput->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->FlushBarriers(cmdList.Get());
 }
 
 
@@ -186,6 +295,13 @@ void ComputePassPhysicsChain::Shutdown()
 {
 }
 
+void ComputePassPhysicsChain::GetSimStateBindings(std::vector<SimStateBinding>& outBindings)
+{
+    // The other ping/pong buffer is overwritten by the next step, only the latest state matters
+    const auto latestBuffer = GetChainDataBuffer(m_latestBufferIdx);
+    outBindings.push_back({ "ChainElements", SimStateStorage::GPU, latestBuffer->Resource(), sizeof(PhysicsChain::ChainElementData), uint32_t(latestBuffer->GetElementCount()) });
+}
+
 //---------------------------------------------------------------------------------------
 // Graphics Pass
 //---------------------------------------------------------------------------------------
@@ -335,7 +451,7 @@ void GraphicsPassPhysicsChain::Init(std::weak_ptr<const ComputePassPhysicsChain>
         {
             .ShaderRegister = 1,
             .RegisterSpace = 0,
-            .Num32BitValues = 2
+            .Num32BitValues = 3
         },
         .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
     };
@@ -394,19 +510,22 @@ void GraphicsPassPhysicsChain::Execute(
     cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
     cmdList->SetPipelineState(m_pipelineStateObject.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
     const uint32_t GraphicsBindlessResourceIndicesRootSigParamIndex = 1;
+    // Draws the latest sim state, blended with the previous one by how far the render time is past it
+    const auto chainComputePass = m_particlesComputePass.lock();
     const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-        m_particlesComputePass.lock()->GetParticleReadBufferSRVHeapIndex(),
-        m_chainElementMesh.lock()->GetVertexBufferSRV()
+        chainComputePass->GetParticleOutputBufferSRVHeapIndex(),
+        m_chainElementMesh.lock()->GetVertexBufferSRV(),
+        std::bit_cast<int32_t>(chainComputePass->GetSimStepData().InterpolationAlpha)
     };
     cmdList->SetGraphicsRoot32BitConstants(
         (UINT)GraphicsBindlessResourceIndicesRootSigParamIndex,
         (UINT)GraphicsBindlessResourceIndices.size(), GraphicsBindlessResourceIndices.data(), 0);
 
-    const int instanceCount = Privates::NumChainElements; // TODO: this is the maximum - the GPU will need to set the size of the mesh to zero for particles that are not alive
+    const UINT instanceCount = chainComputePass->GetChainElementCount(); // Every element of every chain, they're contiguous in the element buffer
     cmdList->DrawIndexedInstanced((UINT)m_chainElementMesh.lock()->GetVertexIndicesCount(), instanceCount, 0, 0, 0);
 }
 
@@ -7,11 +7,15 @@
 #include <Rendering/Common/StructuredBuffer.h>
 #include <Rendering/RenderData/Mesh.h>
 #include <Rendering/Common/TickableResetFlag.h>
+#include <Rendering/Common/SimStateSnapshot.h>
+#include <Simulation/ChainPBDSolver.h>
+#include <Simulation/ColliderSet.h>
 
 using Microsoft::WRL::ComPtr;
 
 class IRenderer;
 class MeshLibrary;
+class ResourceBarrierBatcher;
 namespace AstroTools::Rendering
 {
     class ShaderLibrary;
@@ -42,21 +46,41 @@ namespace PhysicsChain
     struct ChainElementData
     {
 	    ParticleData Particle;
-	    int32_t ParentIndex;
+	    int32_t ParentIndex; // Within its chain, the previous element (-1 for the root)
 	    float RestLength;
         bool Pinned;
         float Radius;
     };
 
+    // A chain is a range of the element buffer, its first element being the root. Make sure to keep in sync with physicsChainCommon.hlsli
+    struct ChainDesc
+    {
+        uint32_t FirstElement;
+        uint32_t ElementCount;
+        DirectX::XMFLOAT3 Origin;
+    };
+
+    // One threadgroup per chain, one thread per element (MAX_CHAIN_ELEMENTS in physicsChainCompute.hlsl)
+    constexpr uint32_t MaxChainElementCount = 32;
+
+    // Capacities of the collider buffers, SetColliders asserts the scene fits
+    constexpr uint32_t MaxColliderCount = 1024;
+    constexpr uint32_t MaxColliderGridCellCount = Colliders::ColliderGrid::DefaultMaxCellCount;
+    constexpr uint32_t MaxColliderGridEntryCount = 64 * 1024; // (cell, collider) pairs
+    constexpr uint32_t MaxColliderSdfSampleCount = 64 * 64 * 64;
 }
 
 class ComputePassPhysicsChain :
-    public ComputePass
+    public ComputePass, public ISimStateOwner
 {
 public:
-    ComputePassPhysicsChain();
+    // Chains hang from a square grid, every chain being elementsPerChain long
+    ComputePassPhysicsChain(uint32_t chainCount, uint32_t elementsPerChain);
 
     void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, int32_t debugDrawBufferUAVIndex, int32_t debugDrawCounterUAVIndex);
+
+    // Replaces the scene colliders, eg: when they moved. The broadphase grid is rebuilt right away, both are uploaded by the next Execute.
+    void SetColliders(Colliders::ColliderSet colliderSet);
     virtual void Update(const GPUPassUpdateData& updateData) override;
     virtual void Execute(
         ComPtr<ID3D12GraphicsCommandList> cmdList,
@@ -69,11 +93,28 @@ public:
         m_simNeedsReset.FlagForReset();
     }
 
+    // ISimStateOwner - BEGIN
+    virtual std::string_view GetSimStateName() const override { return "PhysicsChain"; }
+    virtual uint32_t GetSimStateLayoutVersion() const override { return 2; }
+    virtual void GetSimStateBindings(std::vector<SimStateBinding>& outBindings) override;
+    virtual void OnSimStateRestored() override
+    {
+        // The restored state replaces whatever reset was pending
+        m_simNeedsReset = {};
+    }
+    // ISimStateOwner - END
+
     int32_t GetParticleReadBufferSRVHeapIndex() const;
     int32_t GetParticleOutputBufferSRVHeapIndex() const;
+    const SimStepData& GetSimStepData() const { return m_simStep; }
+    uint32_t GetChainElementCount() const { return uint32_t(m_chainDataBufferPing->GetElementCount()); }
 
 private:
-    int32_t m_frameIdxModulo = 0;
+    StructuredBuffer<PhysicsChain::ChainElementData>* GetChainDataBuffer(uint32_t pingPongIdx) const;
+
+    SimStepData m_simStep;
+    uint32_t m_firstStepInputBufferIdx = 0; // Ping/pong buffer the first step of the frame reads from
+    uint32_t m_latestBufferIdx = 0; // Ping/pong buffer holding the most recent sim state
     TickableResetFlag m_simNeedsReset;
 
 	int32_t m_debugDrawBufferUAVIndex = -1;
@@ -81,8 +122,25 @@ private:
 
     std::unique_ptr<StructuredBuffer<PhysicsChain::ChainElementData>> m_chainDataBufferPing;
     std::unique_ptr<StructuredBuffer<PhysicsChain::ChainElementData>> m_chainDataBufferPong;
+    std::unique_ptr<StructuredBuffer<PhysicsChain::ChainDesc>> m_chainDescBuffer;
+    uint32_t m_chainCount = 0;
+    // Only Mode, IterationCount, SubstepCount & Compliance reach the shader, damping & gravity are still hard-coded there
+    ChainPBD::SolverSettings m_solverSettings;
+
+    Colliders::ColliderSet m_colliderSet;
+    Colliders::ColliderGrid m_colliderGrid;
+    float m_maxElementRadius = 0.f; // Grid query radius
+    bool m_collidersChanged = false; // Since the last Update
+    bool m_uploadColliders = false; // By this frame's Execute
+    std::unique_ptr<StructuredBuffer<Colliders::Collider>> m_colliderBuffer;
+    std::unique_ptr<StructuredBuffer<Colliders::GridDesc>> m_colliderGridDescBuffer;
+    std::unique_ptr<StructuredBuffer<uint32_t>> m_colliderCellStartsBuffer;
+    std::unique_ptr<StructuredBuffer<uint32_t>> m_colliderIndicesBuffer;
+    std::unique_ptr<StructuredBuffer<float>> m_colliderSdfSamplesBuffer;
 
     std::unique_ptr<ComputableObject> m_particlesComputeObj;
+
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
 class GraphicsPassPhysicsChain : public GraphicsPass
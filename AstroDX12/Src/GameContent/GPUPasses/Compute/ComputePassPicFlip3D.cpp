@@ -4,7 +4,13 @@
 #include "Rendering\RenderData\VertexData.h"
 #include "Rendering/RenderData/GeometryHelper.h"
 #include <Rendering/Common/VectorTypes.h>
+#include <Simulation/PicFlipBricks.h>
+#include <Simulation/PicFlipPressure.h>
+#include <Simulation/PicFlipTransfer.h>
+#include <bit>
 #include <cassert>
+#include <cmath>
+#include <string>
 
 namespace Privates
 {
@@ -17,15 +23,51 @@ namespace Privates
 	ivec3 GridWorldPosition = ivec3(5, 5, 5);
 	ivec3 GridWorldExtents = ivec3(30, 30, 30);
     ivec3 GridDispatchThreadGroupSize = ivec3(8, 8, 8);
-    ivec3 ParticleDispatchThreadGroupSize = ivec3(8, 1, 1);
+    ivec3 ParticleDispatchThreadGroupSize = ivec3(32, 1, 1); // PARTICLES_THREAD_GROUP_SIZE_X
 
-    ivec3 DispatchGroupCountPressure()
+    // The grid the particles transfer to, as PicFlipTransfer sees it: same cell size bits as the shaders'
+    PicFlipTransfer::Grid GetTransferGrid()
+    {
+        PicFlipTransfer::Grid grid;
+        grid.Resolution[0] = uint32_t(PressureGridResolution.x);
+        grid.Resolution[1] = uint32_t(PressureGridResolution.y);
+        grid.Resolution[2] = uint32_t(PressureGridResolution.z);
+        grid.Origin[0] = float(GridWorldPosition.x);
+        grid.Origin[1] = float(GridWorldPosition.y);
+        grid.Origin[2] = float(GridWorldPosition.z);
+        grid.InvCellSize[0] = float(PressureGridResolution.x) / float(GridWorldExtents.x);
+        grid.InvCellSize[1] = float(PressureGridResolution.y) / float(GridWorldExtents.y);
+        grid.InvCellSize[2] = float(PressureGridResolution.z) / float(GridWorldExtents.z);
+        return grid;
+    }
+
+    // Slots of the brick pools: sized for the fluid's volume, not the domain's. The pool's 9^3 nodes are only 2^3 bricks, it fits them all.
+    uint32_t BrickPoolCapacity = 8;
+    constexpr uint32_t BrickPoolRowBrickCount = 256; // PICFLIP_BRICK_POOL_ROW_BRICK_COUNT, 2048 texels: the widest a Texture3D gets
+
+    // The CPU reference's, MaxIterationCount included
+    PicFlipPressure::SolveSettings GetPressureSolveSettings()
+    {
+        return PicFlipPressure::SolveSettings();
+    }
+
+    // Each iteration records 7 dispatches (8 with IncompletePoisson) & the indirect args' transitions, even once the solve converged &
+    // they dispatch no groups. The recorded count follows the solves read back in chunks of this many iterations instead.
+    constexpr uint32_t PressureIterationChunkSize = 8;
+
+    PicFlipBricks::BrickGrid GetBrickGrid()
+    {
+        return PicFlipBricks::BrickGrid(GetTransferGrid(), BrickPoolCapacity);
+    }
+
+    // Rows of bricks, along x then y
+    ivec3 GetBrickPoolTextureResolution()
     {
         return ivec3(
-            (PressureGridResolution.x + GridDispatchThreadGroupSize.x - 1) / GridDispatchThreadGroupSize.x,
-            (PressureGridResolution.y + GridDispatchThreadGroupSize.y - 1) / GridDispatchThreadGroupSize.y,
-            (PressureGridResolution.z + GridDispatchThreadGroupSize.z - 1) / GridDispatchThreadGroupSize.z);
-	}
+            int32_t(std::min(BrickPoolCapacity, BrickPoolRowBrickCount) * PicFlipBricks::BrickSize),
+            int32_t((BrickPoolCapacity + BrickPoolRowBrickCount - 1) / BrickPoolRowBrickCount * PicFlipBricks::BrickSize),
+            int32_t(PicFlipBricks::BrickSize));
+    }
 
     ivec3 DispatchGroupCountVelocity()
     {
@@ -42,10 +84,21 @@ namespace Privates
             1,
             1);
     }
+
+    // A thread per brick of the top level grid
+    ivec3 DispatchGroupCountBricks()
+    {
+        return ivec3(
+            (int32_t(GetBrickGrid().GetBrickCount()) + ParticleDispatchThreadGroupSize.x - 1) / ParticleDispatchThreadGroupSize.x,
+            1,
+            1);
+    }
 }
 
-void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::shared_ptr<ComputePassVertexLineDebugDraw> debugDrawLine)
+void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::shared_ptr<ComputePassVertexLineDebugDraw> debugDrawLine, int numFramesInFlight)
 {
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
     auto BufferDataVector = std::vector<PicFlip::ParticleData>(Privates::ParticleCount);
     int32_t index = 0;
     std::srand(0);
@@ -69,6 +122,68 @@ void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::Shad
 
     renderer->CreateStructuredBufferAndViews(m_particleDataBufferPair->GetInput(), std::wstring_view(L"PicFlipParticlesData_Ping"), true, true);
     renderer->CreateStructuredBufferAndViews(m_particleDataBufferPair->GetOutput(), std::wstring_view(L"PicFlipParticlesData_Pong"), true, true);
+
+    // Particle to grid transfer, every element is written before it's read
+    m_particleCellKeysBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(Privates::ParticleCount);
+    m_particleSortedIndicesBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(Privates::ParticleCount);
+    m_cellParticleStartBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(Privates::BrickPoolCapacity * PicFlipBricks::BrickNodeCount);
+    m_cellParticleEndBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(Privates::BrickPoolCapacity * PicFlipBricks::BrickNodeCount);
+    renderer->CreateStructuredBufferAndViews(m_particleCellKeysBuffer.get(), std::wstring_view(L"PicFlipParticleCellKeys"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_particleSortedIndicesBuffer.get(), std::wstring_view(L"PicFlipParticleSortedIndices"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_cellParticleStartBuffer.get(), std::wstring_view(L"PicFlipCellParticleStart"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_cellParticleEndBuffer.get(), std::wstring_view(L"PicFlipCellParticleEnd"), true, true);
+
+    // Sparse grids, every element is written before it's read but the indirect args, which are dispatched from before they're first written
+    const uint32_t brickCount = Privates::GetBrickGrid().GetBrickCount();
+    m_brickOccupancyBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(brickCount);
+    m_brickActiveFlagsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(brickCount);
+    m_brickSlotsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(brickCount);
+    m_activeBricksBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(Privates::BrickPoolCapacity);
+    m_indirectArgsBuffer = std::make_unique<GPUStructuredBuffer<PicFlip::IndirectArgs>>(1, GPUBufferInitialContent::ZeroFilled, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    renderer->CreateStructuredBufferAndViews(m_brickOccupancyBuffer.get(), std::wstring_view(L"PicFlipBrickOccupancy"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_brickActiveFlagsBuffer.get(), std::wstring_view(L"PicFlipBrickActiveFlags"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_brickSlotsBuffer.get(), std::wstring_view(L"PicFlipBrickSlots"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_activeBricksBuffer.get(), std::wstring_view(L"PicFlipActiveBricks"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_indirectArgsBuffer.get(), std::wstring_view(L"PicFlipIndirectArgs"), true, true);
+
+    // Pressure solve, every element is written before it's read
+    const uint32_t poolCellCount = Privates::BrickPoolCapacity * PicFlipBricks::BrickNodeCount;
+    m_pressureDiagonalBuffer = std::make_unique<GPUStructuredBuffer<float>>(poolCellCount);
+    m_pcgResidualBuffer = std::make_unique<GPUStructuredBuffer<float>>(poolCellCount);
+    m_pcgPreconditionedBuffer = std::make_unique<GPUStructuredBuffer<float>>(poolCellCount);
+    m_pcgSearchDirectionBuffer = std::make_unique<GPUStructuredBuffer<float>>(poolCellCount);
+    m_pcgLaplacianDirectionBuffer = std::make_unique<GPUStructuredBuffer<float>>(poolCellCount);
+    m_pcgPreconditionerTempBuffer = std::make_unique<GPUStructuredBuffer<float>>(poolCellCount);
+    m_pcgBrickPartialsBuffer = std::make_unique<GPUStructuredBuffer<DirectX::XMFLOAT2>>(Privates::BrickPoolCapacity);
+    m_pressureSolveStateBuffer = std::make_unique<GPUStructuredBuffer<PicFlip::PressureSolveState>>(1);
+    renderer->CreateStructuredBufferAndViews(m_pressureDiagonalBuffer.get(), std::wstring_view(L"PicFlipPressureDiagonal"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pcgResidualBuffer.get(), std::wstring_view(L"PicFlipPcgResidual"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pcgPreconditionedBuffer.get(), std::wstring_view(L"PicFlipPcgPreconditioned"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pcgSearchDirectionBuffer.get(), std::wstring_view(L"PicFlipPcgSearchDirection"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pcgLaplacianDirectionBuffer.get(), std::wstring_view(L"PicFlipPcgLaplacianDirection"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pcgPreconditionerTempBuffer.get(), std::wstring_view(L"PicFlipPcgPreconditionerTemp"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pcgBrickPartialsBuffer.get(), std::wstring_view(L"PicFlipPcgBrickPartials"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_pressureSolveStateBuffer.get(), std::wstring_view(L"PicFlipPressureSolveState"), true, true);
+
+    // Until a solve is read back, every iteration up to the cap is recorded
+    m_recordedPressureIterationCount = Privates::GetPressureSolveSettings().MaxIterationCount;
+    m_pressureSolveReadbacks.resize(numFramesInFlight);
+    for (PressureSolveReadback& readback : m_pressureSolveReadbacks)
+    {
+        const auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+        const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_pressureSolveStateBuffer->GetByteSize());
+        ThrowIfFailed(renderer->GetRendererContext().Device->CreateCommittedResource(
+            &heapProp,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&readback.Buffer)));
+        readback.Buffer->SetName(L"PicFlipPressureSolveStateReadback");
+    }
+
+    // Sorts the particles & scans the bricks
+    m_parallelPrimitives.Init(renderer, shaderLibrary, std::max(uint32_t(Privates::ParticleCount), brickCount));
     
     m_pressureGridPair = std::make_unique<PicFlip::GridDataBufferPair>(
         std::make_shared<Texture3D>(),
@@ -81,14 +196,15 @@ void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::Shad
     );
 
 
-	// Init pressure grid 3D textures
+	// Init pressure brick pool 3D textures
+    const ivec3 brickPoolResolution = Privates::GetBrickPoolTextureResolution();
     {
-        auto InitPressureGrid = [](IRenderer* renderer, ITexture3D* texture3D, std::wstring name, D3D12_RESOURCE_STATES initialResourceState)
+        auto InitPressureGrid = [&brickPoolResolution](IRenderer* renderer, ITexture3D* texture3D, std::wstring name, D3D12_RESOURCE_STATES initialResourceState)
         {
             renderer->InitialiseTexture3D(*texture3D, true,
                 name,
                 DXGI_FORMAT_R32_FLOAT,
-                Privates::PressureGridResolution.x, Privates::PressureGridResolution.y, Privates::PressureGridResolution.z,
+                brickPoolResolution.x, brickPoolResolution.y, brickPoolResolution.z,
                 initialResourceState,
                 /*miplevels*/ 0,
                 D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, 
@@ -99,12 +215,12 @@ void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::Shad
     }
 
     {
-        auto InitVelocityGrid = [](IRenderer* renderer, ITexture3D* texture3D, std::wstring name, D3D12_RESOURCE_STATES initialResourceState)
+        auto InitVelocityGrid = [&brickPoolResolution](IRenderer* renderer, ITexture3D* texture3D, std::wstring name, D3D12_RESOURCE_STATES initialResourceState)
             {
                 renderer->InitialiseTexture3D(*texture3D, true,
                     name,
                     DXGI_FORMAT_R16G16B16A16_FLOAT,
-                    Privates::VelocityGridResolution.x, Privates::VelocityGridResolution.y, Privates::VelocityGridResolution.z,
+                    brickPoolResolution.x, brickPoolResolution.y, brickPoolResolution.z,
                     initialResourceState,
                     /*miplevels*/ 0,
                     D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
@@ -125,7 +241,7 @@ void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::Shad
             {
                 .ShaderRegister = 0,
                 .RegisterSpace = 0,
-                .Num32BitValues = 24
+                .Num32BitValues = 56
             },
             .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
         };
@@ -157,32 +273,57 @@ void ComputePassPicFlip3D::Init(IRenderer* renderer, AstroTools::Rendering::Shad
 
 
         const auto computeShaderPath = rootPath + std::wstring(L"\\Shaders\\LagrangianFluidSim\\Simulate.hlsl");
-        ComputableDesc placeholderComputeObj(computeShaderPath);
-        placeholderComputeObj.RootSignature = m_sharedRootSignature;
-
-        // Create shader - Debug Draw Grid
+        const PicFlipPressure::Preconditioner preconditioner = Privates::GetPressureSolveSettings().Preconditioning;
+        const std::vector<std::wstring> defines = { L"PICFLIP_PRESSURE_PRECONDITIONER=" + std::to_wstring(uint32_t(preconditioner)) };
+        const auto createComputeObj = [&](const wchar_t* entryPoint)
         {
-            auto computeShader = shaderLibrary.GetCompiledShader(computeShaderPath, L"DebugDrawGrid", {}, L"cs_6_6");
-            // Compile PSO
+            ComputableDesc computeObjDesc(computeShaderPath);
+            computeObjDesc.RootSignature = m_sharedRootSignature;
+
+            auto computeShader = shaderLibrary.GetCompiledShader(computeShaderPath, entryPoint, defines, L"cs_6_6");
             renderer->CreateComputePipelineState(
-                placeholderComputeObj.PipelineStateObject,
+                computeObjDesc.PipelineStateObject,
                 m_sharedRootSignature,
                 computeShader);
-            m_debugDrawGridComputeObj = std::make_unique<ComputableObject>(placeholderComputeObj.RootSignature, placeholderComputeObj.PipelineStateObject);
-        }
+            return std::make_unique<ComputableObject>(computeObjDesc.RootSignature, computeObjDesc.PipelineStateObject);
+        };
 
-        // Create shader - SplatParticlesToGrid
+        m_debugDrawGridComputeObj = createComputeObj(L"DebugDrawGrid");
+        m_clearBrickOccupancyComputeObj = createComputeObj(L"ClearBrickOccupancy");
+        m_computeParticleCellKeysComputeObj = createComputeObj(L"ComputeParticleCellKeys");
+        m_activateBricksComputeObj = createComputeObj(L"ActivateBricks");
+        m_assignBrickSlotsComputeObj = createComputeObj(L"AssignBrickSlots");
+        m_findCellParticleRangesComputeObj = createComputeObj(L"FindCellParticleRanges");
+        m_reorderParticlesComputeObj = createComputeObj(L"ReorderParticles");
+        m_gatherParticlesToGridComputeObj = createComputeObj(L"GatherParticlesToGrid");
+        m_computeGridDivergenceComputeObj = createComputeObj(L"ComputeGridDivergence");
+        m_initPressureSolveComputeObj = createComputeObj(L"InitPressureSolve");
+        if (preconditioner == PicFlipPressure::Preconditioner::IncompletePoisson)
         {
-            auto computeShader = shaderLibrary.GetCompiledShader(computeShaderPath, L"SplatParticlesToGrid", {}, L"cs_6_6");
-            // Compile PSO
-            renderer->CreateComputePipelineState(
-                placeholderComputeObj.PipelineStateObject,
-                m_sharedRootSignature,
-                computeShader);
-            m_splatParticlesToGridComputeObj = std::make_unique<ComputableObject>(placeholderComputeObj.RootSignature, placeholderComputeObj.PipelineStateObject);
+            m_applyPressurePreconditionerTransposeComputeObj = createComputeObj(L"ApplyPressurePreconditionerTranspose");
         }
+        m_applyPressurePreconditionerComputeObj = createComputeObj(L"ApplyPressurePreconditioner");
+        m_computePcgBetaComputeObj = createComputeObj(L"ComputePcgBeta");
+        m_updateSearchDirectionComputeObj = createComputeObj(L"UpdateSearchDirection");
+        m_applyPressureLaplacianComputeObj = createComputeObj(L"ApplyPressureLaplacian");
+        m_computePcgAlphaComputeObj = createComputeObj(L"ComputePcgAlpha");
+        m_updatePressureResidualComputeObj = createComputeObj(L"UpdatePressureResidual");
+        m_checkPressureConvergenceComputeObj = createComputeObj(L"CheckPressureConvergence");
+        m_projectVelocityComputeObj = createComputeObj(L"ProjectVelocity");
+    }
+
+    // The brick passes & the pressure solve's are dispatched from the args AssignBrickSlots wrote, the root constants set before stay bound
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC argDesc = {};
+        argDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
 
+        D3D12_COMMAND_SIGNATURE_DESC sigDesc = {};
+        sigDesc.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS);
+        sigDesc.NumArgumentDescs = 1;
+        sigDesc.pArgumentDescs = &argDesc;
 
+        // No root arguments changed by the command signature, so no root signature
+        renderer->CreateCommandSignature(&sigDesc, nullptr, m_dispatchCommandSignature);
     }
 
     m_debugDrawLineVertexBufferUAVIdx = debugDrawLine->GetDebugDrawLineVertexBufferUAVIndex();
@@ -199,22 +340,57 @@ int32_t ComputePassPicFlip3D::GetParticleOutputBufferSRVHeapIndex() const
     return m_particleDataBufferPair->GetOutput()->GetSRVIndex();
 }
 
-void ComputePassPicFlip3D::Update(const GPUPassUpdateData& /*updateData*/)
+void ComputePassPicFlip3D::Update(const GPUPassUpdateData& updateData)
 {
     m_particleDataBufferPair->Swap();
     m_pressureGridPair->Swap();
     m_velocityGridPair->Swap();
+
+    // This frame resource's readback was last written FramesInFlight frames ago, the frame pacer waited for it
+    m_pressureSolveReadbackIdx = updateData.frameIdxModulo;
+    PressureSolveReadback& readback = m_pressureSolveReadbacks[m_pressureSolveReadbackIdx];
+    const uint32_t maxIterationCount = Privates::GetPressureSolveSettings().MaxIterationCount;
+    if (readback.RecordedIterationCount > 0)
+    {
+        PicFlip::PressureSolveState* solveState = nullptr;
+        const D3D12_RANGE readRange = { 0, SIZE_T(m_pressureSolveStateBuffer->GetByteSize()) };
+        ThrowIfFailed(readback.Buffer->Map(0, &readRange, reinterpret_cast<void**>(&solveState)));
+        const bool wasConverged = m_pressureSolveStats.Converged || m_pressureSolveStats.RecordedIterationCount == 0;
+        m_pressureSolveStats.IterationCount = solveState->IterationCount;
+        m_pressureSolveStats.RecordedIterationCount = readback.RecordedIterationCount;
+        m_pressureSolveStats.ResidualNorm = std::sqrt(solveState->ResidualSq);
+        m_pressureSolveStats.TargetResidualNorm = std::sqrt(solveState->ResidualSqThreshold);
+        m_pressureSolveStats.Converged = solveState->Converged != 0;
+        const D3D12_RANGE writtenRange = { 0, 0 };
+        readback.Buffer->Unmap(0, &writtenRange);
+
+        // Projected short of the target: the next frames record every iteration up to the cap. Logged once per run of such frames.
+        if (!m_pressureSolveStats.Converged)
+        {
+            m_recordedPressureIterationCount = maxIterationCount;
+            if (wasConverged)
+            {
+                ::OutputDebugStringA(("PicFlip3D: pressure solve stopped at its " + std::to_string(m_pressureSolveStats.RecordedIterationCount)
+                    + " iterations cap, residual " + std::to_string(m_pressureSolveStats.ResidualNorm)
+                    + " for a target of " + std::to_string(m_pressureSolveStats.TargetResidualNorm) + "\n").c_str());
+            }
+        }
+        else
+        {
+            const uint32_t coveredChunkCount = (m_pressureSolveStats.IterationCount + Privates::PressureIterationChunkSize - 1) / Privates::PressureIterationChunkSize;
+            m_recordedPressureIterationCount = std::min(maxIterationCount, (coveredChunkCount + 1) * Privates::PressureIterationChunkSize);
+        }
+    }
+    readback.RecordedIterationCount = m_recordedPressureIterationCount;
 }
 
-void ComputePassPicFlip3D::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float /*deltaTime*/, const FrameResource& /*frameResources*/) const
+void ComputePassPicFlip3D::ApplySharedRootSignature(ID3D12GraphicsCommandList* cmdList) const
 {
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassPicFlip3D");
-
-	// Dispatch Debug Draw Grid
-
-    cmdList->SetComputeRootSignature(m_debugDrawGridComputeObj->GetRootSignature().Get());
-    cmdList->SetPipelineState(m_debugDrawGridComputeObj->GetPSO().Get());
+    cmdList->SetComputeRootSignature(m_sharedRootSignature.Get());
 
+    const PicFlipTransfer::Grid transferGrid = Privates::GetTransferGrid();
+    const PicFlipBricks::BrickGrid brickGrid = Privates::GetBrickGrid();
+    const PicFlipPressure::SolveSettings pressureSolveSettings = Privates::GetPressureSolveSettings();
     constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 0;
     const std::vector<int32_t> BindlessResourceIndices = {
         m_particleDataBufferPair->GetInput()->GetSRVIndex(),
@@ -238,12 +414,259 @@ void ComputePassPicFlip3D::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, fl
         
         Privates::GridWorldExtents.x, Privates::GridWorldExtents.y, Privates::GridWorldExtents.z,
         Privates::ParticleCount,
+
+        m_particleCellKeysBuffer->GetUAVIndex(),
+        m_particleSortedIndicesBuffer->GetUAVIndex(),
+        m_cellParticleStartBuffer->GetUAVIndex(),
+        m_cellParticleEndBuffer->GetUAVIndex(),
+
+        std::bit_cast<int32_t>(transferGrid.InvCellSize[0]), std::bit_cast<int32_t>(transferGrid.InvCellSize[1]), std::bit_cast<int32_t>(transferGrid.InvCellSize[2]),
+        0, // Pad3
+
+        m_brickOccupancyBuffer->GetUAVIndex(),
+        m_brickActiveFlagsBuffer->GetUAVIndex(),
+        m_brickSlotsBuffer->GetUAVIndex(),
+        m_activeBricksBuffer->GetUAVIndex(),
+
+        int32_t(brickGrid.Resolution[0]), int32_t(brickGrid.Resolution[1]), int32_t(brickGrid.Resolution[2]),
+        int32_t(brickGrid.PoolCapacity),
+
+        m_indirectArgsBuffer->GetUAVIndex(),
+        0, 0, 0, // Pad4
+
+        m_pressureDiagonalBuffer->GetUAVIndex(),
+        m_pcgResidualBuffer->GetUAVIndex(),
+        m_pcgPreconditionedBuffer->GetUAVIndex(),
+        m_pcgSearchDirectionBuffer->GetUAVIndex(),
+
+        m_pcgLaplacianDirectionBuffer->GetUAVIndex(),
+        m_pcgPreconditionerTempBuffer->GetUAVIndex(),
+        m_pcgBrickPartialsBuffer->GetUAVIndex(),
+        m_pressureSolveStateBuffer->GetUAVIndex(),
+
+        std::bit_cast<int32_t>(pressureSolveSettings.RelativeTolerance), std::bit_cast<int32_t>(pressureSolveSettings.AbsoluteTolerance),
+        0, 0, // Pad5
     };
 
     cmdList->SetComputeRoot32BitConstants(
         (UINT)BindlessResourceIndicesRootSigParamIndex,
         (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
+}
+
+void ComputePassPicFlip3D::TransferParticlesToGrid(ID3D12GraphicsCommandList* cmdList) const
+{
+    PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "TransferParticlesToGrid");
+
+    const ivec3 particleDispatchSize = Privates::DispatchGroupCountParticles();
+    const ivec3 brickDispatchSize = Privates::DispatchGroupCountBricks();
+    const PicFlipBricks::BrickGrid brickGrid = Privates::GetBrickGrid();
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "ClearBrickOccupancy");
+
+        m_resourceStates->UAVWrite(m_brickOccupancyBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_clearBrickOccupancyComputeObj->GetPSO().Get());
+        cmdList->Dispatch(brickDispatchSize.x, brickDispatchSize.y, brickDispatchSize.z);
+    }
+
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "ComputeParticleCellKeys");
 
+        m_resourceStates->UAVWrite(m_particleCellKeysBuffer->Resource());
+        m_resourceStates->UAVWrite(m_particleSortedIndicesBuffer->Resource());
+        m_resourceStates->UAVWrite(m_brickOccupancyBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_computeParticleCellKeysComputeObj->GetPSO().Get());
+        cmdList->Dispatch(particleDispatchSize.x, particleDispatchSize.y, particleDispatchSize.z);
+    }
+
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "ActivateBricks");
+
+        m_resourceStates->UAVRead(m_brickOccupancyBuffer->Resource());
+        m_resourceStates->UAVWrite(m_brickActiveFlagsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_activateBricksComputeObj->GetPSO().Get());
+        cmdList->Dispatch(brickDispatchSize.x, brickDispatchSize.y, brickDispatchSize.z);
+    }
+
+    // Slots in brick order. Stable sort on the cell key bits only: the particles of a cell keep their index order, the gather's sums are the same every run.
+    m_parallelPrimitives.ExclusiveScan(cmdList, *m_brickActiveFlagsBuffer, *m_brickSlotsBuffer, brickGrid.GetBrickCount());
+    m_parallelPrimitives.RadixSortKeyValues(cmdList, *m_particleCellKeysBuffer, *m_particleSortedIndicesBuffer, uint32_t(Privates::ParticleCount), brickGrid.GetCellKeyBitCount());
+    ApplySharedRootSignature(cmdList);
+
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "AssignBrickSlots");
+
+        m_resourceStates->UAVRead(m_brickActiveFlagsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_brickSlotsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_activeBricksBuffer->Resource());
+        m_resourceStates->UAVWrite(m_indirectArgsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        cmdList->SetPipelineState(m_assignBrickSlotsComputeObj->GetPSO().Get());
+        cmdList->Dispatch(brickDispatchSize.x, brickDispatchSize.y, brickDispatchSize.z);
+    }
+
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "FindCellParticleRanges & ReorderParticles");
+
+        m_resourceStates->Transition(m_indirectArgsBuffer->Resource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        m_resourceStates->UAVRead(m_activeBricksBuffer->Resource());
+        m_resourceStates->UAVRead(m_particleCellKeysBuffer->Resource());
+        m_resourceStates->UAVRead(m_particleSortedIndicesBuffer->Resource());
+        m_resourceStates->UAVWrite(m_cellParticleStartBuffer->Resource());
+        m_resourceStates->UAVWrite(m_cellParticleEndBuffer->Resource());
+        m_resourceStates->UAVWrite(m_particleDataBufferPair->GetOutput()->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        // Independent from each other, no barrier in between
+        DispatchBricks(cmdList, *m_findCellParticleRangesComputeObj, offsetof(PicFlip::IndirectArgs, Bricks));
+
+        cmdList->SetPipelineState(m_reorderParticlesComputeObj->GetPSO().Get());
+        cmdList->Dispatch(particleDispatchSize.x, particleDispatchSize.y, particleDispatchSize.z);
+    }
+
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "GatherParticlesToGrid");
+
+        m_resourceStates->UAVRead(m_brickSlotsBuffer->Resource());
+        m_resourceStates->UAVRead(m_cellParticleStartBuffer->Resource());
+        m_resourceStates->UAVRead(m_cellParticleEndBuffer->Resource());
+        m_resourceStates->UAVRead(m_particleDataBufferPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_velocityGridPair->GetOutput()->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+
+        DispatchBricks(cmdList, *m_gatherParticlesToGridComputeObj, offsetof(PicFlip::IndirectArgs, Bricks));
+    }
+}
+
+void ComputePassPicFlip3D::DispatchBricks(ID3D12GraphicsCommandList* cmdList, const ComputableObject& computeObj, size_t argsOffset) const
+{
+    cmdList->SetPipelineState(computeObj.GetPSO().Get());
+    cmdList->ExecuteIndirect(m_dispatchCommandSignature.Get(), 1, m_indirectArgsBuffer->Resource(), argsOffset, nullptr, 0);
+}
+
+void ComputePassPicFlip3D::DispatchPressureScalars(ID3D12GraphicsCommandList* cmdList, const ComputableObject& computeObj) const
+{
+    cmdList->SetPipelineState(computeObj.GetPSO().Get());
+    cmdList->Dispatch(1, 1, 1);
+}
+
+void ComputePassPicFlip3D::SolvePressure(ID3D12GraphicsCommandList* cmdList) const
+{
+    PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "SolvePressure");
+
+    constexpr size_t BricksArgsOffset = offsetof(PicFlip::IndirectArgs, Bricks);
+    constexpr size_t PressureSolveArgsOffset = offsetof(PicFlip::IndirectArgs, PressureSolve);
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "ComputeGridDivergence & InitPressureSolve");
+
+        m_resourceStates->UAVRead(m_velocityGridPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_pressureDiagonalBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pcgResidualBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureGridPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchBricks(cmdList, *m_computeGridDivergenceComputeObj, BricksArgsOffset);
+
+        m_resourceStates->UAVRead(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->UAVWrite(m_indirectArgsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchPressureScalars(cmdList, *m_initPressureSolveComputeObj);
+    }
+
+    // Recorded up to this frame's count, see Update. CheckPressureConvergence zeroes the PressureSolve args: the iterations past it
+    // dispatch no groups, the single group passes return straight away.
+    for (uint32_t iterationIdx = 0; iterationIdx < m_recordedPressureIterationCount; ++iterationIdx)
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "PressureSolveIteration");
+
+        // z = M^-1 r, beta
+        m_resourceStates->Transition(m_indirectArgsBuffer->Resource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        m_resourceStates->UAVRead(m_pressureDiagonalBuffer->Resource());
+        m_resourceStates->UAVRead(m_pcgResidualBuffer->Resource());
+        if (m_applyPressurePreconditionerTransposeComputeObj)
+        {
+            m_resourceStates->UAVWrite(m_pcgPreconditionerTempBuffer->Resource());
+            m_resourceStates->FlushBarriers(cmdList);
+            DispatchBricks(cmdList, *m_applyPressurePreconditionerTransposeComputeObj, PressureSolveArgsOffset);
+
+            m_resourceStates->UAVRead(m_pcgPreconditionerTempBuffer->Resource());
+        }
+        m_resourceStates->UAVWrite(m_pcgPreconditionedBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchBricks(cmdList, *m_applyPressurePreconditionerComputeObj, PressureSolveArgsOffset);
+
+        m_resourceStates->UAVRead(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchPressureScalars(cmdList, *m_computePcgBetaComputeObj);
+
+        // d = z + beta d
+        m_resourceStates->UAVRead(m_pcgPreconditionedBuffer->Resource());
+        m_resourceStates->UAVRead(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pcgSearchDirectionBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchBricks(cmdList, *m_updateSearchDirectionComputeObj, PressureSolveArgsOffset);
+
+        // q = A d, alpha
+        m_resourceStates->UAVRead(m_pcgSearchDirectionBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pcgLaplacianDirectionBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchBricks(cmdList, *m_applyPressureLaplacianComputeObj, PressureSolveArgsOffset);
+
+        m_resourceStates->UAVRead(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchPressureScalars(cmdList, *m_computePcgAlphaComputeObj);
+
+        // p += alpha d, r -= alpha q, convergence
+        m_resourceStates->UAVRead(m_pcgLaplacianDirectionBuffer->Resource());
+        m_resourceStates->UAVRead(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pcgResidualBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureGridPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchBricks(cmdList, *m_updatePressureResidualComputeObj, PressureSolveArgsOffset);
+
+        m_resourceStates->UAVRead(m_pcgBrickPartialsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_pressureSolveStateBuffer->Resource());
+        m_resourceStates->UAVWrite(m_indirectArgsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchPressureScalars(cmdList, *m_checkPressureConvergenceComputeObj);
+    }
+
+    {
+        PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "ProjectVelocity");
+
+        m_resourceStates->Transition(m_indirectArgsBuffer->Resource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        m_resourceStates->UAVRead(m_pressureGridPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_velocityGridPair->GetOutput()->Resource());
+        m_resourceStates->FlushBarriers(cmdList);
+        DispatchBricks(cmdList, *m_projectVelocityComputeObj, BricksArgsOffset);
+    }
+
+    m_resourceStates->Transition(m_pressureSolveStateBuffer->Resource(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+    m_resourceStates->FlushBarriers(cmdList);
+    cmdList->CopyBufferRegion(m_pressureSolveReadbacks[m_pressureSolveReadbackIdx].Buffer.Get(), 0, m_pressureSolveStateBuffer->Resource(), 0, m_pressureSolveStateBuffer->GetByteSize());
+}
+
+void ComputePassPicFlip3D::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float /*deltaTime*/, const FrameResource& /*frameResources*/) const
+{
+    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassPicFlip3D");
+
+	// Dispatch Debug Draw Grid
+
+    ApplySharedRootSignature(cmdList.Get());
+    cmdList->SetPipelineState(m_debugDrawGridComputeObj->GetPSO().Get());
 
     /*{
         cmdList->ClearUnorderedAccessViewFloat(
@@ -259,54 +682,24 @@ void ComputePassPicFlip3D::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, fl
         // Dispatch Debug draw Grid
         PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "DebugDrawGrid");
 
+        m_resourceStates->Transition(m_particleDataBufferPair->GetInput()->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        m_resourceStates->Transition(m_pressureGridPair->GetInput()->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        m_resourceStates->Transition(m_velocityGridPair->GetInput()->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        m_resourceStates->UAVWrite(m_particleDataBufferPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_pressureGridPair->GetOutput()->Resource());
+        m_resourceStates->UAVWrite(m_velocityGridPair->GetOutput()->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+
         const ivec3 dispatchSize = Privates::DispatchGroupCountVelocity();
         cmdList->Dispatch(dispatchSize.x, dispatchSize.y, dispatchSize.z);
     }
     
-    {
-        // Dispatch Splat Particles To Grid
-        PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "SplatParticlesToGrid");
-     
-        cmdList->SetPipelineState(m_splatParticlesToGridComputeObj->GetPSO().Get());
-        const ivec3 dispatchSize = Privates::DispatchGroupCountParticles();
-        cmdList->Dispatch(dispatchSize.x, dispatchSize.y, dispatchSize.z);
-    }
+    TransferParticlesToGrid(cmdList.Get());
+    SolvePressure(cmdList.Get());
 
-
-
-
-
-
-
-    // Transition resources into their next correct state
-    const auto particleBufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_particleDataBufferPair->GetInput()->Resource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto particleBufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_particleDataBufferPair->GetOutput()->Resource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    const auto pressureGridTextureInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_pressureGridPair->GetInput()->Resource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto pressureGridTextureOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_pressureGridPair->GetOutput()->Resource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    const auto velocityGridTextureInTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_velocityGridPair->GetInput()->Resource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto velocityGridTextureOutTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_velocityGridPair->GetOutput()->Resource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { 
-        particleBufferInStateTransition,
-        particleBufferOutStateTransition,
-        pressureGridTextureInStateTransition,
-        pressureGridTextureOutStateTransition,
-        velocityGridTextureInTransition,
-        velocityGridTextureOutTransition
-    };
-    cmdList->ResourceBarrier((UINT)buffersStateTransition.size(), buffersStateTransition.data());
+    // Drawn this frame, it's already readable as next frame's input
+    m_resourceStates->Transition(m_particleDataBufferPair->GetOutput()->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->FlushBarriers(cmdList.Get());
 }
 
 void ComputePassPicFlip3D::Shutdown()
@@ -410,7 +803,7 @@ void GraphicsPassPicFlip3D::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, f
     cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
     cmdList->SetPipelineState(m_pipelineStateObject.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
     const uint32_t GraphicsBindlessResourceIndicesRootSigParamIndex = 1;
@@ -6,6 +6,8 @@
 #include <Rendering/Common/ShaderLibrary.h>
 #include <Rendering/Common/MeshLibrary.h>
 #include <Rendering/Compute/ComputableObject.h>
+#include <Rendering/Compute/GPUParallelPrimitives.h>
+#include <Rendering/Common/GPUStructuredBuffer.h>
 #include <Rendering/Common/Texture3D.h>
 #include <Rendering/Common/RenderResourcePair.h>
 
@@ -21,11 +23,41 @@ namespace PicFlip
         {
         }
 
-        // Make sure to keep Input layout in sync
+        // Make sure to keep Input layout in sync, & PicFlipTransfer::Particle
         DirectX::XMFLOAT3 Pos;
         DirectX::XMFLOAT3 Vel;
     };
 
+    // Keep in sync with IndirectArgs in Simulate.hlsl, one ExecuteIndirect per member
+    struct IndirectArgs
+    {
+        D3D12_DISPATCH_ARGUMENTS Bricks;
+        D3D12_DISPATCH_ARGUMENTS PressureSolve;
+    };
+
+    // Keep in sync with PressureSolveState in Simulate.hlsl
+    struct PressureSolveState
+    {
+        float ResidualDotPreconditioned;
+        float Alpha;
+        float Beta;
+        float ResidualSqThreshold;
+        uint32_t IterationCount;
+        uint32_t ActiveBrickCount;
+        uint32_t Converged;
+        float ResidualSq;
+    };
+
+    // A frame's pressure solve, read back once the frame is done
+    struct PressureSolveStats
+    {
+        uint32_t IterationCount = 0;
+        uint32_t RecordedIterationCount = 0; // That frame's cap, Converged false & IterationCount equal to it: the cap was hit
+        float ResidualNorm = 0.f;
+        float TargetResidualNorm = 0.f;
+        bool Converged = false;
+    };
+
     using ParticleDataBufferPair = RenderResourcePair<StructuredBuffer<PicFlip::ParticleData>>;
     using GridDataBufferPair = RenderResourcePair<ITexture3D>;
 }
@@ -34,15 +66,29 @@ class ComputePassPicFlip3D :
     public ComputePass
 {
 public:
-    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::shared_ptr<ComputePassVertexLineDebugDraw> debugDrawLine);
+    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::shared_ptr<ComputePassVertexLineDebugDraw> debugDrawLine, int numFramesInFlight);
     virtual void Update(const GPUPassUpdateData& updateData) override;
     virtual void Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float deltaTime, const FrameResource& frameResources) const override;
     virtual void Shutdown() override;
 
     int32_t GetParticleReadBufferSRVHeapIndex() const;
     int32_t GetParticleOutputBufferSRVHeapIndex() const;
+    // FramesInFlight frames late
+    const PicFlip::PressureSolveStats& GetPressureSolveStats() const { return m_pressureSolveStats; }
 
 private:
+    // The shared root signature & its constants, set again after the parallel primitives' own
+    void ApplySharedRootSignature(ID3D12GraphicsCommandList* cmdList) const;
+    // Particle to grid transfer: cell keys, sort by cell, cell ranges, particles reordered, per node gather. PicFlipTransfer is the CPU reference.
+    // The bricks are activated on the way, the cell ranges & the gather only run over the active ones.
+    void TransferParticlesToGrid(ID3D12GraphicsCommandList* cmdList) const;
+    // Pressure projection of the velocity pool, PCG up to the residual target. PicFlipPressure is the CPU reference.
+    void SolvePressure(ID3D12GraphicsCommandList* cmdList) const;
+    // A group per active brick, from the args member at argsOffset
+    void DispatchBricks(ID3D12GraphicsCommandList* cmdList, const ComputableObject& computeObj, size_t argsOffset) const;
+    // A single group, the pressure solve's scalars
+    void DispatchPressureScalars(ID3D12GraphicsCommandList* cmdList, const ComputableObject& computeObj) const;
+
 	int32_t m_frameIdxModulo = 0;
 	int32_t m_ParticleReadBufferSRVIndex = 0;
     int32_t m_debugDrawLineVertexBufferUAVIdx;
@@ -52,10 +98,70 @@ private:
 
 	ComPtr<ID3D12RootSignature> m_sharedRootSignature; // The same root signature is used for all compute passes in this sim
     std::unique_ptr<ComputableObject> m_debugDrawGridComputeObj;
-    std::unique_ptr<ComputableObject> m_splatParticlesToGridComputeObj;
+    std::unique_ptr<ComputableObject> m_clearBrickOccupancyComputeObj;
+    std::unique_ptr<ComputableObject> m_computeParticleCellKeysComputeObj;
+    std::unique_ptr<ComputableObject> m_activateBricksComputeObj;
+    std::unique_ptr<ComputableObject> m_assignBrickSlotsComputeObj;
+    std::unique_ptr<ComputableObject> m_findCellParticleRangesComputeObj;
+    std::unique_ptr<ComputableObject> m_reorderParticlesComputeObj;
+    std::unique_ptr<ComputableObject> m_gatherParticlesToGridComputeObj;
+    std::unique_ptr<ComputableObject> m_computeGridDivergenceComputeObj;
+    std::unique_ptr<ComputableObject> m_initPressureSolveComputeObj;
+    std::unique_ptr<ComputableObject> m_applyPressurePreconditionerTransposeComputeObj; // Incomplete Poisson only
+    std::unique_ptr<ComputableObject> m_applyPressurePreconditionerComputeObj;
+    std::unique_ptr<ComputableObject> m_computePcgBetaComputeObj;
+    std::unique_ptr<ComputableObject> m_updateSearchDirectionComputeObj;
+    std::unique_ptr<ComputableObject> m_applyPressureLaplacianComputeObj;
+    std::unique_ptr<ComputableObject> m_computePcgAlphaComputeObj;
+    std::unique_ptr<ComputableObject> m_updatePressureResidualComputeObj;
+    std::unique_ptr<ComputableObject> m_checkPressureConvergenceComputeObj;
+    std::unique_ptr<ComputableObject> m_projectVelocityComputeObj;
+
+    // Sorted in place: the cell key of each particle & the index of the particle
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_particleCellKeysBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_particleSortedIndicesBuffer;
+    // Per cell of the active bricks, by pool slot, the range of its sorted particles
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_cellParticleStartBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_cellParticleEndBuffer;
+    GPUParallelPrimitives m_parallelPrimitives;
+
+    // Sparse grids, PicFlipBricks is the CPU reference. Per brick of the top level grid: has particles, is active, its pool slot.
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_brickOccupancyBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_brickActiveFlagsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_brickSlotsBuffer;
+    // Per pool slot, its brick
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_activeBricksBuffer;
+    // A group per active brick, for the grid passes & the pressure solve's iterations
+    std::unique_ptr<GPUStructuredBuffer<PicFlip::IndirectArgs>> m_indirectArgsBuffer;
+    ComPtr<ID3D12CommandSignature> m_dispatchCommandSignature;
+
+    // Pressure solve, per cell of the active bricks by pool slot: the diagonal of A (0 for air), PCG's vectors, then the bricks' dot product terms
+    std::unique_ptr<GPUStructuredBuffer<float>> m_pressureDiagonalBuffer;
+    std::unique_ptr<GPUStructuredBuffer<float>> m_pcgResidualBuffer;
+    std::unique_ptr<GPUStructuredBuffer<float>> m_pcgPreconditionedBuffer;
+    std::unique_ptr<GPUStructuredBuffer<float>> m_pcgSearchDirectionBuffer;
+    std::unique_ptr<GPUStructuredBuffer<float>> m_pcgLaplacianDirectionBuffer;
+    std::unique_ptr<GPUStructuredBuffer<float>> m_pcgPreconditionerTempBuffer;
+    std::unique_ptr<GPUStructuredBuffer<DirectX::XMFLOAT2>> m_pcgBrickPartialsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<PicFlip::PressureSolveState>> m_pressureSolveStateBuffer;
+
+    // Iterations recorded this frame: whole chunks covering the last read back solve's, & a chunk more, up to MaxIterationCount.
+    // The state is copied to the frame's readback, read once the frame is done, FramesInFlight later.
+    uint32_t m_recordedPressureIterationCount = 0;
+    struct PressureSolveReadback
+    {
+        ComPtr<ID3D12Resource> Buffer;
+        uint32_t RecordedIterationCount = 0; // 0 until a frame was recorded into it
+    };
+    std::vector<PressureSolveReadback> m_pressureSolveReadbacks;
+    int32_t m_pressureSolveReadbackIdx = 0;
+    PicFlip::PressureSolveStats m_pressureSolveStats;
 
+    // Brick pools: each active brick's 8^3 nodes at its slot, see GetBrickPoolTexel in Simulate.hlsl
     std::unique_ptr<PicFlip::GridDataBufferPair> m_pressureGridPair;
     std::unique_ptr<PicFlip::GridDataBufferPair> m_velocityGridPair;
+
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
 
@@ -2,18 +2,50 @@
 
 #include <Rendering/IRenderer.h>
 #include <Rendering/Common/FrameResource.h>
+#include <Rendering/Common/RendererContext.h>
+#include <Rendering/Common/SDFRaymarch.h>
 #include <GameContent/GPUPasses/RaymarchScene.h>
 
 using namespace AstroTools::Rendering;
 
 namespace RaymarchScenePrivates
 {
-	static const int32_t ObjectCount = 20; // Number of SDF objects in the scene
+	static const int32_t ObjectCount = 256; // Max number of SDF objects in the scene, the first alive particles
+
+	constexpr uint32_t TileCountX = (GBufferStatics::GBufferWidth + SDFRaymarch::TileSize - 1) / SDFRaymarch::TileSize;
+	constexpr uint32_t TileCountY = (GBufferStatics::GBufferHeight + SDFRaymarch::TileSize - 1) / SDFRaymarch::TileSize;
+	constexpr uint32_t CellCount = TileCountX * TileCountY * SDFRaymarch::DepthSliceCount;
+	static_assert(TileCountX <= 256 && TileCountY <= 256, "The object bounds pack a tile coordinate per byte");
+
+	constexpr uint32_t BoundsGroupSize = 64; // SDF_BOUNDS_GROUP_SIZE
+	constexpr uint32_t BinTilesPerGroup = 4; // SDF_BIN_TILES_PER_GROUP
+
+	// The reduced resolutions' march, a quarter of the pixels. The march & the resolve both run 8x8 groups.
+	constexpr int32_t MarchWidth = GBufferStatics::GBufferWidth / 2;
+	constexpr int32_t MarchHeight = GBufferStatics::GBufferHeight / 2;
+	static_assert(MarchWidth % 8 == 0 && MarchHeight % 8 == 0, "The reduced march dispatches whole 8x8 groups");
+
+	// The cone prepass, a thread per block of SDFRaymarch::ConeBlockSize^2 pixels in 8x8 groups
+	constexpr uint32_t ConeCountX = (GBufferStatics::GBufferWidth + SDFRaymarch::ConeBlockSize - 1) / SDFRaymarch::ConeBlockSize;
+	constexpr uint32_t ConeCountY = (GBufferStatics::GBufferHeight + SDFRaymarch::ConeBlockSize - 1) / SDFRaymarch::ConeBlockSize;
+
+	// Keep in sync with the SDF_STATS_* slots in RaymarchScene.hlsl
+	enum RaymarchStatsSlot : uint32_t
+	{
+		PixelSteps = 0,
+		PixelMaxSteps,
+		ConeSteps,
+		ConeMaxSteps,
+		Count
+	};
 }
 
-void ComputePassRaymarchScene::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::weak_ptr<ComputePassParticles> particleComputePass)
+void ComputePassRaymarchScene::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::weak_ptr<ComputePassParticles> particleComputePass, const RaymarchSettings* settings, RaymarchStats* stats, int numFramesInFlight)
 {
     m_particleComputePass = particleComputePass;
+    m_settings = settings;
+    m_stats = stats;
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
 
     // Create SDF Scene Objects buffer
  //   auto SDFSceneObjectsList = std::vector<SDFSceneObject>(RaymarchScenePrivates::ObjectCount);
@@ -39,6 +71,68 @@ void ComputePassRaymarchScene::Init(IRenderer* renderer, AstroTools::Rendering::
         GBufferStatics::GBufferWidth, GBufferStatics::GBufferHeight,
         DXGI_FORMAT_R16G16B16A16_FLOAT, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
+    // Reduced resolutions only, compute only: they stay UAVs
+    m_marchColorRT = std::make_unique<RenderTarget>();
+    renderer->InitialiseRenderTarget(m_marchColorRT.get(), L"RaymarchMarchColor",
+        RaymarchScenePrivates::MarchWidth, RaymarchScenePrivates::MarchHeight,
+        DXGI_FORMAT_R16G16B16A16_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    m_marchDistanceRT = std::make_unique<RenderTarget>();
+    renderer->InitialiseRenderTarget(m_marchDistanceRT.get(), L"RaymarchMarchDistance",
+        RaymarchScenePrivates::MarchWidth, RaymarchScenePrivates::MarchHeight,
+        DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    const auto createHistoryRT = [&](const wchar_t* name, DXGI_FORMAT format)
+    {
+        auto historyRT = std::make_shared<RenderTarget>();
+        renderer->InitialiseRenderTarget(historyRT.get(), name,
+            GBufferStatics::GBufferWidth, GBufferStatics::GBufferHeight,
+            format, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        return historyRT;
+    };
+    m_historyColorPair = std::make_unique<RenderResourcePair<RenderTarget>>(
+        createHistoryRT(L"RaymarchHistoryColor::Ping", DXGI_FORMAT_R16G16B16A16_FLOAT),
+        createHistoryRT(L"RaymarchHistoryColor::Pong", DXGI_FORMAT_R16G16B16A16_FLOAT));
+    m_historyDistancePair = std::make_unique<RenderResourcePair<RenderTarget>>(
+        createHistoryRT(L"RaymarchHistoryDistance::Ping", DXGI_FORMAT_R32_FLOAT),
+        createHistoryRT(L"RaymarchHistoryDistance::Pong", DXGI_FORMAT_R32_FLOAT));
+
+    m_coneStartRT = std::make_unique<RenderTarget>();
+    renderer->InitialiseRenderTarget(m_coneStartRT.get(), L"RaymarchConeStart",
+        RaymarchScenePrivates::ConeCountX, RaymarchScenePrivates::ConeCountY,
+        DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    m_marchStatsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RaymarchScenePrivates::RaymarchStatsSlot::Count, GPUBufferInitialContent::ZeroFilled);
+    renderer->CreateStructuredBufferAndViews(m_marchStatsBuffer.get(), std::wstring_view(L"RaymarchStats"), true, true);
+    m_marchStatsReadbacks.resize(numFramesInFlight);
+    for (MarchStatsReadback& readback : m_marchStatsReadbacks)
+    {
+        const auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+        const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_marchStatsBuffer->GetByteSize());
+        ThrowIfFailed(renderer->GetRendererContext().Device->CreateCommittedResource(
+            &heapProp,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&readback.Buffer)));
+        readback.Buffer->SetName(L"RaymarchStatsReadback");
+    }
+
+    // Every element is written before it's read
+    m_objectBoundsBuffer = std::make_unique<GPUStructuredBuffer<DirectX::XMUINT2>>(RaymarchScenePrivates::ObjectCount);
+    m_objectCellCountsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RaymarchScenePrivates::ObjectCount);
+    m_objectCellOffsetsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RaymarchScenePrivates::ObjectCount);
+    m_cellObjectCountsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RaymarchScenePrivates::CellCount);
+    m_cellObjectOffsetsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RaymarchScenePrivates::CellCount);
+    m_cellObjectsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RaymarchScenePrivates::CellCount * SDFRaymarch::MeanCellCapacity);
+    renderer->CreateStructuredBufferAndViews(m_objectBoundsBuffer.get(), std::wstring_view(L"RaymarchObjectBounds"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_objectCellCountsBuffer.get(), std::wstring_view(L"RaymarchObjectCellCounts"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_objectCellOffsetsBuffer.get(), std::wstring_view(L"RaymarchObjectCellOffsets"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_cellObjectCountsBuffer.get(), std::wstring_view(L"RaymarchCellObjectCounts"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_cellObjectOffsetsBuffer.get(), std::wstring_view(L"RaymarchCellObjectOffsets"), true, true);
+    renderer->CreateStructuredBufferAndViews(m_cellObjectsBuffer.get(), std::wstring_view(L"RaymarchCellObjects"), true, true);
+    m_parallelPrimitives.Init(renderer, shaderLibrary, std::max(uint32_t(RaymarchScenePrivates::ObjectCount), RaymarchScenePrivates::CellCount));
+
     const auto rootPath = s2ws(DX::GetWorkingDirectory());
     {
         const auto computeShaderPath = rootPath + std::wstring(L"\\Shaders\\RaymarchScene.hlsl");
@@ -64,7 +158,7 @@ void ComputePassRaymarchScene::Init(IRenderer* renderer, AstroTools::Rendering::
             {
                 .ShaderRegister = 1,
                 .RegisterSpace = 0,
-                .Num32BitValues = 6
+                .Num32BitValues = 33
             },
             .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
         };
@@ -95,80 +189,234 @@ void ComputePassRaymarchScene::Init(IRenderer* renderer, AstroTools::Rendering::
         ComPtr<ID3D12RootSignature> rootSignature = nullptr;
         renderer->CreateRootSignature(serializedRootSignature, rootSignature);
 
-        ComputableDesc computableObjDesc(computeShaderPath);
-        computableObjDesc.RootSignature = rootSignature;
+        const auto createPSO = [&](const wchar_t* entryPoint)
+        {
+            ComputableDesc computableObjDesc(computeShaderPath);
+            computableObjDesc.RootSignature = rootSignature;
 
-        // Create shader
-        computableObjDesc.CS = shaderLibrary.GetCompiledShader(computableObjDesc.ComputeShaderPath, L"CSMain", {}, L"cs_6_6");
+            // Create shader
+            computableObjDesc.CS = shaderLibrary.GetCompiledShader(computableObjDesc.ComputeShaderPath, entryPoint, {}, L"cs_6_6");
 
-        // Compile PSO
-        renderer->CreateComputePipelineState(
-            computableObjDesc.PipelineStateObject,
-            computableObjDesc.RootSignature,
-            computableObjDesc.CS);
+            // Compile PSO
+            renderer->CreateComputePipelineState(
+                computableObjDesc.PipelineStateObject,
+                computableObjDesc.RootSignature,
+                computableObjDesc.CS);
+            return computableObjDesc.PipelineStateObject;
+        };
 
-        m_raymarchRootSignature = computableObjDesc.RootSignature;
-        m_raymarchPSO = computableObjDesc.PipelineStateObject;
+        m_raymarchRootSignature = rootSignature;
+        m_computeObjectBoundsPSO = createPSO(L"CSComputeObjectBounds");
+        m_countCellObjectsPSO = createPSO(L"CSCountCellObjects");
+        m_binObjectsPSO = createPSO(L"CSBinObjects");
+        m_raymarchPSO = createPSO(L"CSMain");
+        m_resolvePSO = createPSO(L"CSResolve");
+        m_coneMarchPSO = createPSO(L"CSConeMarch");
     }
 
 }
 
-void ComputePassRaymarchScene::Update(const GPUPassUpdateData& /*updateData*/)
-{
-    m_currentParticleDataBufferSRVIdx = m_particleComputePass.lock()->GetParticleOutputBufferSRVHeapIndex();
-}
-
-void ComputePassRaymarchScene::Execute(
-    ComPtr<ID3D12GraphicsCommandList> cmdList,
-    float /*deltaTime*/,
-    const FrameResource& frameResources) const
+void ComputePassRaymarchScene::Update(const GPUPassUpdateData& updateData)
 {
-    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassRaymarchScene");
+    const auto particleComputePass = m_particleComputePass.lock();
+    m_currentParticleDataBufferSRVIdx = particleComputePass->GetParticleBufferSRVHeapIndex();
+    m_currentParticleAliveListSRVIdx = particleComputePass->GetLatestAliveListSRVHeapIndex();
+    m_particleCountersSRVIdx = particleComputePass->GetCountersSRVHeapIndex();
+    m_currentParticleAliveListIdx = particleComputePass->GetLatestAliveListIdx();
 
-    const auto depthRTPreDrawTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_depthRT->GetResource(),
-        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    const auto colorRTPreDrawTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_colorRT->GetResource(),
-        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    // The history is the previous frame's resolve, only reprojected if it resolved the same way
+    const SDFRaymarch::Resolution resolution = m_settings ? m_settings->MarchResolution : SDFRaymarch::Resolution::Full;
+    m_isHistoryValid = resolution == SDFRaymarch::Resolution::Checkerboard && m_resolution == resolution;
+    m_resolution = resolution;
+    SDFRaymarch::GetMarchOffset(m_resolution, m_frameIdx++, m_marchOffset);
+    m_historyColorPair->Swap();
+    m_historyDistancePair->Swap();
+    m_useConePrepass = m_settings ? m_settings->ConePrepass : true;
 
-    CD3DX12_RESOURCE_BARRIER buffersPreDrawStateTransition[] = { depthRTPreDrawTransition, colorRTPreDrawTransition };
-    cmdList->ResourceBarrier(2, buffersPreDrawStateTransition);
+    // This frame resource's readback was last written FramesInFlight frames ago, the frame pacer waited for it
+    m_marchStatsReadbackIdx = updateData.frameIdxModulo;
+    MarchStatsReadback& readback = m_marchStatsReadbacks[m_marchStatsReadbackIdx];
+    if (m_stats && readback.MarchedPixelCount > 0)
+    {
+        uint32_t* statsData = nullptr;
+        const D3D12_RANGE readRange = { 0, SIZE_T(m_marchStatsBuffer->GetByteSize()) };
+        ThrowIfFailed(readback.Buffer->Map(0, &readRange, reinterpret_cast<void**>(&statsData)));
+        m_stats->MarchedPixelCount = readback.MarchedPixelCount;
+        m_stats->AverageStepCount = float(statsData[RaymarchScenePrivates::PixelSteps]) / float(readback.MarchedPixelCount);
+        m_stats->MaxStepCount = statsData[RaymarchScenePrivates::PixelMaxSteps];
+        m_stats->ConeCount = readback.ConeCount;
+        m_stats->AverageConeStepCount = readback.ConeCount > 0 ? float(statsData[RaymarchScenePrivates::ConeSteps]) / float(readback.ConeCount) : 0.f;
+        m_stats->MaxConeStepCount = statsData[RaymarchScenePrivates::ConeMaxSteps];
+        const D3D12_RANGE writtenRange = { 0, 0 };
+        readback.Buffer->Unmap(0, &writtenRange);
+    }
+    const uint32_t marchPixelStride = SDFRaymarch::GetMarchStride(m_resolution);
+    readback.MarchedPixelCount = (GBufferStatics::GBufferWidth / marchPixelStride) * (GBufferStatics::GBufferHeight / marchPixelStride);
+    readback.ConeCount = m_useConePrepass ? RaymarchScenePrivates::ConeCountX * RaymarchScenePrivates::ConeCountY : 0;
+}
 
+void ComputePassRaymarchScene::OnSimReset()
+{
+    // The scene jumps, nothing to reproject
+    m_resolution = SDFRaymarch::Resolution::Full;
+}
 
+void ComputePassRaymarchScene::ApplySharedRootSignature(ID3D12GraphicsCommandList* cmdList, const FrameResource& frameResources) const
+{
     cmdList->SetComputeRootSignature(m_raymarchRootSignature.Get());
-    cmdList->SetPipelineState(m_raymarchPSO.Get());
     
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetComputeRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
     constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 1;
+    const bool isFullResolution = m_resolution == SDFRaymarch::Resolution::Full;
+    const uint32_t marchPixelStride = SDFRaymarch::GetMarchStride(m_resolution);
     const std::vector<int32_t> BindlessResourceIndices = {
         m_currentParticleDataBufferSRVIdx,
+        m_currentParticleAliveListSRVIdx,
+        m_particleCountersSRVIdx,
+        int32_t(m_currentParticleAliveListIdx),
         m_depthRT->GetUAVIndex(),
         m_colorRT->GetUAVIndex(),
         RaymarchScenePrivates::ObjectCount,
         GBufferStatics::GBufferWidth,
-		GBufferStatics::GBufferHeight    
+		GBufferStatics::GBufferHeight,
+        m_objectBoundsBuffer->GetUAVIndex(),
+        m_objectCellCountsBuffer->GetUAVIndex(),
+        m_objectCellOffsetsBuffer->GetUAVIndex(),
+        m_cellObjectCountsBuffer->GetUAVIndex(),
+        m_cellObjectOffsetsBuffer->GetUAVIndex(),
+        m_cellObjectsBuffer->GetUAVIndex(),
+        int32_t(RaymarchScenePrivates::TileCountX),
+        int32_t(RaymarchScenePrivates::TileCountY),
+        int32_t(marchPixelStride),
+        int32_t(m_marchOffset[0]),
+        int32_t(m_marchOffset[1]),
+        isFullResolution ? m_colorRT->GetUAVIndex() : m_marchColorRT->GetUAVIndex(),
+        isFullResolution ? -1 : m_marchDistanceRT->GetUAVIndex(),
+        RaymarchScenePrivates::MarchWidth,
+        RaymarchScenePrivates::MarchHeight,
+        m_historyColorPair->GetInput()->GetUAVIndex(),
+        m_historyDistancePair->GetInput()->GetUAVIndex(),
+        m_historyColorPair->GetOutput()->GetUAVIndex(),
+        m_historyDistancePair->GetOutput()->GetUAVIndex(),
+        m_isHistoryValid ? 1 : 0,
+        m_useConePrepass ? m_coneStartRT->GetUAVIndex() : -1,
+        int32_t(RaymarchScenePrivates::ConeCountX),
+        int32_t(RaymarchScenePrivates::ConeCountY),
+        m_marchStatsBuffer->GetUAVIndex()
     };
     cmdList->SetComputeRoot32BitConstants(
         (UINT)BindlessResourceIndicesRootSigParamIndex,
         (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
+}
+
+void ComputePassRaymarchScene::Execute(
+    ComPtr<ID3D12GraphicsCommandList> cmdList,
+    float /*deltaTime*/,
+    const FrameResource& frameResources) const
+{
+    PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassRaymarchScene");
 
+    const bool isFullResolution = m_resolution == SDFRaymarch::Resolution::Full;
+    const uint32_t marchPixelStride = SDFRaymarch::GetMarchStride(m_resolution);
+    ApplySharedRootSignature(cmdList.Get(), frameResources);
 
-	int32_t DispatchX = GBufferStatics::GBufferWidth / 8; // 8 threads per group in X
-	int32_t DispatchY = GBufferStatics::GBufferHeight / 8; // 8 threads per group in Y
+    m_marchStatsBuffer->Clear(cmdList.Get());
+
+    // Tile binning: each object's cells, the objects which fit in the pool, then per cell the objects overlapping it packed in the pool
+    {
+        PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "BinObjects");
+
+        m_resourceStates->UAVWrite(m_objectBoundsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_objectCellCountsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+        cmdList->SetPipelineState(m_computeObjectBoundsPSO.Get());
+        cmdList->Dispatch((RaymarchScenePrivates::ObjectCount + RaymarchScenePrivates::BoundsGroupSize - 1) / RaymarchScenePrivates::BoundsGroupSize, 1, 1);
+
+        m_parallelPrimitives.ExclusiveScan(cmdList.Get(), *m_objectCellCountsBuffer, *m_objectCellOffsetsBuffer, RaymarchScenePrivates::ObjectCount);
+        ApplySharedRootSignature(cmdList.Get(), frameResources);
+
+        constexpr uint32_t TileCount = RaymarchScenePrivates::TileCountX * RaymarchScenePrivates::TileCountY;
+        constexpr uint32_t BinGroupCount = (TileCount + RaymarchScenePrivates::BinTilesPerGroup - 1) / RaymarchScenePrivates::BinTilesPerGroup;
+        m_resourceStates->UAVRead(m_objectBoundsBuffer->Resource());
+        m_resourceStates->UAVRead(m_objectCellCountsBuffer->Resource());
+        m_resourceStates->UAVRead(m_objectCellOffsetsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_cellObjectCountsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+        cmdList->SetPipelineState(m_countCellObjectsPSO.Get());
+        cmdList->Dispatch(BinGroupCount, 1, 1);
+
+        m_parallelPrimitives.ExclusiveScan(cmdList.Get(), *m_cellObjectCountsBuffer, *m_cellObjectOffsetsBuffer, RaymarchScenePrivates::CellCount);
+        ApplySharedRootSignature(cmdList.Get(), frameResources);
+
+        m_resourceStates->UAVRead(m_cellObjectOffsetsBuffer->Resource());
+        m_resourceStates->UAVWrite(m_cellObjectsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+        cmdList->SetPipelineState(m_binObjectsPSO.Get());
+        cmdList->Dispatch(BinGroupCount, 1, 1);
+    }
+
+    m_resourceStates->UAVRead(m_cellObjectCountsBuffer->Resource());
+    m_resourceStates->UAVRead(m_cellObjectOffsetsBuffer->Resource());
+    m_resourceStates->UAVRead(m_cellObjectsBuffer->Resource());
+
+    // Cone prepass: per block of pixels, where its rays start
+    if (m_useConePrepass)
+    {
+        PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ConeMarch");
+
+        m_resourceStates->UAVWrite(m_coneStartRT->GetResource());
+        // Step counts are atomic adds, which commute: only the clear has to be ordered before them, so they count as a read
+        m_resourceStates->UAVRead(m_marchStatsBuffer->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+        cmdList->SetPipelineState(m_coneMarchPSO.Get());
+        cmdList->Dispatch((RaymarchScenePrivates::ConeCountX + 7) / 8, (RaymarchScenePrivates::ConeCountY + 7) / 8, 1);
+        m_resourceStates->UAVRead(m_coneStartRT->GetResource());
+    }
+
+    if (isFullResolution)
+    {
+        m_resourceStates->UAVWrite(m_depthRT->GetResource());
+        m_resourceStates->UAVWrite(m_colorRT->GetResource());
+    }
+    else
+    {
+        m_resourceStates->UAVWrite(m_marchColorRT->GetResource());
+        m_resourceStates->UAVWrite(m_marchDistanceRT->GetResource());
+    }
+    m_resourceStates->UAVRead(m_marchStatsBuffer->Resource());
+    m_resourceStates->FlushBarriers(cmdList.Get());
+    cmdList->SetPipelineState(m_raymarchPSO.Get());
+
+	int32_t DispatchX = GBufferStatics::GBufferWidth / int32_t(8 * marchPixelStride); // 8 threads per group in X
+	int32_t DispatchY = GBufferStatics::GBufferHeight / int32_t(8 * marchPixelStride); // 8 threads per group in Y
     cmdList->Dispatch(DispatchX, DispatchY, 1);
 
-    const auto depthRTPostDrawTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_depthRT->GetResource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    const auto colorRTPostDrawTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_colorRT->GetResource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    // Reduced resolutions: the marched pixels upsampled (& the history reprojected) to the gbuffer
+    if (!isFullResolution)
+    {
+        PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "Resolve");
+
+        m_resourceStates->UAVRead(m_marchColorRT->GetResource());
+        m_resourceStates->UAVRead(m_marchDistanceRT->GetResource());
+        m_resourceStates->UAVRead(m_historyColorPair->GetInput()->GetResource());
+        m_resourceStates->UAVRead(m_historyDistancePair->GetInput()->GetResource());
+        m_resourceStates->UAVWrite(m_historyColorPair->GetOutput()->GetResource());
+        m_resourceStates->UAVWrite(m_historyDistancePair->GetOutput()->GetResource());
+        m_resourceStates->UAVWrite(m_depthRT->GetResource());
+        m_resourceStates->UAVWrite(m_colorRT->GetResource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
+        cmdList->SetPipelineState(m_resolvePSO.Get());
+        cmdList->Dispatch(GBufferStatics::GBufferWidth / 8, GBufferStatics::GBufferHeight / 8, 1);
+    }
 
-    CD3DX12_RESOURCE_BARRIER buffersPostDrawStateTransition[] = { depthRTPostDrawTransition, colorRTPostDrawTransition };
-    cmdList->ResourceBarrier(2, buffersPostDrawStateTransition);
+    // Sampled by the gbuffer composition draw
+    m_resourceStates->Transition(m_depthRT->GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(m_colorRT->GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->Transition(m_marchStatsBuffer->Resource(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+    m_resourceStates->FlushBarriers(cmdList.Get());
+    cmdList->CopyBufferRegion(m_marchStatsReadbacks[m_marchStatsReadbackIdx].Buffer.Get(), 0, m_marchStatsBuffer->Resource(), 0, m_marchStatsBuffer->GetByteSize());
 }
 
 void ComputePassRaymarchScene::Shutdown()
@@ -4,12 +4,20 @@
 #include <Rendering/Compute/ComputeGroup.h>
 #include <Rendering/Common/RenderTarget.h>
 #include <Rendering/Common/StructuredBuffer.h>
+#include <Rendering/Common/GPUStructuredBuffer.h>
 #include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RenderResourcePair.h>
+#include <Rendering/Common/SDFRaymarch.h>
+#include <Rendering/Compute/GPUParallelPrimitives.h>
 
 #include <GameContent/GPUPasses/Compute/ComputePassParticles.h>
 
 using Microsoft::WRL::ComPtr;
 
+class ResourceBarrierBatcher;
+struct RaymarchSettings;
+struct RaymarchStats;
+
 struct SDFSceneObject
 {
     SDFSceneObject()
@@ -40,12 +48,13 @@ public:
 		ComputePassParticles* ParticleComputePass = nullptr;
     };
 
-    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::weak_ptr<ComputePassParticles> particleComputePass);
+    void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, std::weak_ptr<ComputePassParticles> particleComputePass, const RaymarchSettings* settings, RaymarchStats* stats, int numFramesInFlight);
     virtual void Update(const GPUPassUpdateData& updateData) override;
     virtual void Execute(
         ComPtr<ID3D12GraphicsCommandList> cmdList,
         float deltaTime,
         const FrameResource& frameResources) const override;
+    virtual void OnSimReset() override;
     virtual void Shutdown() override;
 
     int32_t GetDepthRTViewIndex() const
@@ -59,16 +68,66 @@ public:
 	}
 
 private:
+    // The root signature & its constants, again after the parallel primitives' passes which set their own
+    void ApplySharedRootSignature(ID3D12GraphicsCommandList* cmdList, const FrameResource& frameResources) const;
+
 	std::shared_ptr<RenderTarget> m_depthRT;
 	std::shared_ptr<RenderTarget> m_colorRT;
     std::unique_ptr<StructuredBuffer<SDFSceneObject>> m_SDFSceneObjectsBuffer;
 
-    ComPtr<ID3D12RootSignature> m_raymarchRootSignature;
+    ComPtr<ID3D12RootSignature> m_raymarchRootSignature; // Shared by the binning & the march
+    ComPtr<ID3D12PipelineState> m_computeObjectBoundsPSO;
+    ComPtr<ID3D12PipelineState> m_countCellObjectsPSO;
+    ComPtr<ID3D12PipelineState> m_binObjectsPSO;
     ComPtr<ID3D12PipelineState> m_raymarchPSO;
+    ComPtr<ID3D12PipelineState> m_resolvePSO;
+    ComPtr<ID3D12PipelineState> m_coneMarchPSO;
+
+    // Tile binning, SDFRaymarch is the CPU reference. Per object its cells, per cell (a tile's depth slice) its objects.
+    // Counts are scanned into offsets: the objects' entries in the pool, the binned ones are those which fit, & the cells' lists.
+    std::unique_ptr<GPUStructuredBuffer<DirectX::XMUINT2>> m_objectBoundsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_objectCellCountsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_objectCellOffsetsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_cellObjectCountsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_cellObjectOffsetsBuffer;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_cellObjectsBuffer; // The pool, SDFRaymarch::MeanCellCapacity entries per cell
+    GPUParallelPrimitives m_parallelPrimitives;
+
+    // Reduced resolution, SDFRaymarch::Reconstructor is the CPU reference. The marched quarter of the pixels, then the resolve's
+    // output kept for the next frame's reprojection: color & ray distance.
+    const RaymarchSettings* m_settings = nullptr;
+    SDFRaymarch::Resolution m_resolution = SDFRaymarch::Resolution::Full;
+    uint32_t m_frameIdx = 0;
+    uint32_t m_marchOffset[2] = { 0, 0 };
+    bool m_isHistoryValid = false;
+    std::unique_ptr<RenderTarget> m_marchColorRT;
+    std::unique_ptr<RenderTarget> m_marchDistanceRT;
+    std::unique_ptr<RenderResourcePair<RenderTarget>> m_historyColorPair;
+    std::unique_ptr<RenderResourcePair<RenderTarget>> m_historyDistancePair;
+
+    // Cone prepass, SDFRaymarch::ConeMarch is the CPU reference: per block of SDFRaymarch::ConeBlockSize^2 pixels, its rays' start distance
+    bool m_useConePrepass = false;
+    std::unique_ptr<RenderTarget> m_coneStartRT;
+
+    // Step count stats, cleared every frame & copied to the frame's readback buffer. Read once the frame is done, FramesInFlight later.
+    RaymarchStats* m_stats = nullptr;
+    std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_marchStatsBuffer;
+    struct MarchStatsReadback
+    {
+        ComPtr<ID3D12Resource> Buffer;
+        uint32_t MarchedPixelCount = 0; // 0 until a frame was recorded into it
+        uint32_t ConeCount = 0;
+    };
+    std::vector<MarchStatsReadback> m_marchStatsReadbacks;
+    int32_t m_marchStatsReadbackIdx = 0;
 
     std::weak_ptr<ComputePassParticles> m_particleComputePass;
     int32_t m_currentParticleDataBufferSRVIdx = -1;
+    int32_t m_currentParticleAliveListSRVIdx = -1;
+    int32_t m_particleCountersSRVIdx = -1;
+    uint32_t m_currentParticleAliveListIdx = 0;
 
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 
 };
 
@@ -2,23 +2,28 @@
 
 #include <Rendering/IRenderer.h>
 #include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RendererContext.h>
 
 #include <Rendering\Common\MeshLibrary.h>
 #include <Rendering\Renderable\IRenderable.h>
 #include <Rendering\Common\FrameResource.h>
 
+#include <Simulation/ChainVBDSolver.h>
+
 #include <pix3.h>
+#include <bit>
 
 using namespace AstroTools::Rendering;
 using namespace DirectX;
 
 namespace Privates_VBD
 {
-    static const size_t NumChainElements = 15; // Keep in sync with hlsl file
+    static const size_t NumChainElements = 15; // At most GROUP_SIZE (vbdChainCompute.hlsl), one thread per element
+    static_assert(NumChainElements <= ChainVBD::MaxChainElementCount);
 }
 
 ComputePassVBDChain::ComputePassVBDChain()
-    : m_frameIdxModulo(0)
+    : m_simStep()
 	, m_simNeedsReset(false)
 {
     auto BufferDataVector = std::vector<VBDChain::ChainElementData>(Privates_VBD::NumChainElements);
@@ -44,6 +49,19 @@ ComputePassVBDChain::ComputePassVBDChain()
         BufferDataVector[i].Radius = 2.f;
     }
 
+    // Elements of a color are solved in parallel, they must not share a constraint
+    std::vector<int32_t> parentIndices;
+    for (const auto& element : BufferDataVector)
+    {
+        parentIndices.push_back(element.ParentIndex);
+    }
+    std::vector<uint32_t> colors;
+    m_colorCount = ChainVBD::ColorConstraintGraph(parentIndices, colors);
+    for (size_t i = 0; i < BufferDataVector.size(); ++i)
+    {
+        BufferDataVector[i].Color = colors[i];
+    }
+
     m_chainDataBufferPing = std::make_unique<StructuredBuffer<VBDChain::ChainElementData>>(BufferDataVector);
     m_chainDataBufferPong = std::make_unique<StructuredBuffer<VBDChain::ChainElementData>>(BufferDataVector);
 }
@@ -65,7 +83,7 @@ void ComputePassVBDChain::Init(IRenderer* renderer, AstroTools::Rendering::Shade
             {
                 .ShaderRegister = 0,
                 .RegisterSpace = 0,
-                .Num32BitValues = 5
+                .Num32BitValues = 9
             },
             .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
         };
@@ -109,25 +127,38 @@ void ComputePassVBDChain::Init(IRenderer* renderer, AstroTools::Rendering::Shade
 
     m_debugDrawBufferUAVIndex = debugDrawBufferUAVIndex;
     m_debugDrawCounterUAVIndex = debugCounterBufferUAVIndex;
+
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
 }
 
 void ComputePassVBDChain::Update(const GPUPassUpdateData& updateData)
 {
-    m_frameIdxModulo = updateData.frameIdxModulo;
+    m_simStep = updateData.simStep;
+
+    // Every step swaps the ping/pong buffers
+    m_firstStepInputBufferIdx = m_latestBufferIdx;
+    m_latestBufferIdx = (m_latestBufferIdx + m_simStep.StepCount) % 2;
+
+    // A reset requested on a frame without any sim step waits for the next one
+    if (m_simStep.StepCount > 0)
+    {
+        m_simNeedsReset.Tick();
+    }
+}
 
-    m_simNeedsReset.Tick();
+StructuredBuffer<VBDChain::ChainElementData>* ComputePassVBDChain::GetChainDataBuffer(uint32_t pingPongIdx) const
+{
+    return pingPongIdx % 2 == 0 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
 }
 
 int32_t ComputePassVBDChain::GetParticleReadBufferSRVHeapIndex() const
 {
-    auto bufferInput = m_frameIdxModulo % 2 == 0 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
-    return bufferInput->GetSRVIndex();
+    return GetChainDataBuffer(m_firstStepInputBufferIdx)->GetSRVIndex();
 }
 
 int32_t ComputePassVBDChain::GetParticleOutputBufferSRVHeapIndex() const
 {
-    auto bufferInput = m_frameIdxModulo % 2 == 1 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
-    return bufferInput->GetSRVIndex();
+    return GetChainDataBuffer(m_latestBufferIdx)->GetSRVIndex();
 }
 
 void ComputePassVBDChain::Execute(
@@ -137,35 +168,51 @@ void ComputePassVBDChain::Execute(
 {
     PIXScopedEvent(cmdList.Get(), PIX_COLOR(128, 0, 255), "ComputePassVBDChain");
 
-    auto bufferInput = m_frameIdxModulo % 2 == 0 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
-    auto bufferOutput = m_frameIdxModulo % 2 == 1 ? m_chainDataBufferPing.get() : m_chainDataBufferPong.get();
+    if (m_simStep.StepCount == 0)
+    {
+        return;
+    }
 
     cmdList->SetComputeRootSignature(m_particlesComputeObj->GetRootSignature().Get());
     cmdList->SetPipelineState(m_particlesComputeObj->GetPSO().Get());
 
-    constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 0;
-    const std::vector<int32_t> BindlessResourceIndices = {
-        bufferInput->GetSRVIndex(),
-        bufferOutput->GetUAVIndex(),
-        m_simNeedsReset.NeedsReset() ? 1 : 0,
-        m_debugDrawBufferUAVIndex,
-        m_debugDrawCounterUAVIndex
-    };
-    cmdList->SetComputeRoot32BitConstants(
-        (UINT)BindlessResourceIndicesRootSigParamIndex,
-        (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
+    // Dispatch chain update, once per fixed step
+    StructuredBuffer<VBDChain::ChainElementData>* bufferOutput = nullptr;
+    for (uint32_t stepIdx = 0; stepIdx < m_simStep.StepCount; ++stepIdx)
+    {
+        auto bufferInput = GetChainDataBuffer(m_firstStepInputBufferIdx + stepIdx);
+        bufferOutput = GetChainDataBuffer(m_firstStepInputBufferIdx + stepIdx + 1);
+
+        const bool isFirstStep = stepIdx == 0;
+        const bool isLastStep = stepIdx + 1 == m_simStep.StepCount;
+
+        constexpr int32_t BindlessResourceIndicesRootSigParamIndex = 0;
+        const std::vector<int32_t> BindlessResourceIndices = {
+            bufferInput->GetSRVIndex(),
+            bufferOutput->GetUAVIndex(),
+            isFirstStep && m_simNeedsReset.NeedsReset() ? 1 : 0,
+            m_debugDrawBufferUAVIndex,
+            m_debugDrawCounterUAVIndex,
+            std::bit_cast<int32_t>(m_simStep.StepDeltaTime),
+            isLastStep ? 1 : 0,
+            int32_t(Privates_VBD::NumChainElements),
+            int32_t(m_colorCount)
+        };
+        cmdList->SetComputeRoot32BitConstants(
+            (UINT)BindlessResourceIndicesRootSigParamIndex,
+            (UINT)BindlessResourceIndices.size(), BindlessResourceIndices.data(), 0);
 
-    const auto bufferInStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        bufferInput->Resource(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    const auto bufferOutStateTransition = CD3DX12_RESOURCE_BARRIER::Transition(
-        bufferOutput->Resource(),
-        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        // Ping-pong buffers: the tracker knows which one is where, whatever the step count or a previous reset
+        m_resourceStates->Transition(bufferInput->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        m_resourceStates->UAVWrite(bufferOutput->Resource());
+        m_resourceStates->FlushBarriers(cmdList.Get());
 
-    std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransition = { bufferInStateTransition , bufferOutStateTransition };
-    cmdList->ResourceBarrier(2, buffersStateTransition.data());
+        cmdList->Dispatch(1, 1, 1);
+    }
 
-    cmdList->Dispatch(1, 1, 1);
+    // The latest state is what gets drawn this frame
+    m_resourceStates->Transition(bufferOutput->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_resourceStates->FlushBarriers(cmdList.Get());
 }
 
 
@@ -173,6 +220,13 @@ void ComputePassVBDChain::Shutdown()
 {
 }
 
+void ComputePassVBDChain::GetSimStateBindings(std::vector<SimStateBinding>& outBindings)
+{
+    // The other ping/pong buffer is overwritten by the next step, only the latest state matters
+    const auto latestBuffer = GetChainDataBuffer(m_latestBufferIdx);
+    outBindings.push_back({ "ChainElements", SimStateStorage::GPU, latestBuffer->Resource(), sizeof(VBDChain::ChainElementData), uint32_t(latestBuffer->GetElementCount()) });
+}
+
 //---------------------------------------------------------------------------------------
 // Graphics Pass
 //---------------------------------------------------------------------------------------
@@ -303,7 +357,7 @@ void GraphicsPassVBDChain::Init(std::weak_ptr<const ComputePassVBDChain> particl
         {
             .ShaderRegister = 1,
             .RegisterSpace = 0,
-            .Num32BitValues = 2
+            .Num32BitValues = 3
         },
         .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
     };
@@ -360,13 +414,16 @@ void GraphicsPassVBDChain::Execute(
     cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
     cmdList->SetPipelineState(m_pipelineStateObject.Get());
 
-    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+    const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
     cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
     const uint32_t GraphicsBindlessResourceIndicesRootSigParamIndex = 1;
+    // Draws the latest sim state, blended with the previous one by how far the render time is past it
+    const auto chainComputePass = m_particlesComputePass.lock();
     const std::vector<int32_t> GraphicsBindlessResourceIndices = {
-        m_particlesComputePass.lock()->GetParticleReadBufferSRVHeapIndex(),
-        m_chainElementMesh.lock()->GetVertexBufferSRV()
+        chainComputePass->GetParticleOutputBufferSRVHeapIndex(),
+        m_chainElementMesh.lock()->GetVertexBufferSRV(),
+        std::bit_cast<int32_t>(chainComputePass->GetSimStepData().InterpolationAlpha)
     };
     cmdList->SetGraphicsRoot32BitConstants(
         (UINT)GraphicsBindlessResourceIndicesRootSigParamIndex,
@@ -7,11 +7,13 @@
 #include <Rendering/Common/StructuredBuffer.h>
 #include <Rendering/RenderData/Mesh.h>
 #include <Rendering/Common/TickableResetFlag.h>
+#include <Rendering/Common/SimStateSnapshot.h>
 
 using Microsoft::WRL::ComPtr;
 
 class IRenderer;
 class MeshLibrary;
+class ResourceBarrierBatcher;
 namespace AstroTools::Rendering
 {
     class ShaderLibrary;
@@ -45,12 +47,14 @@ namespace VBDChain
 	    float RestLength;
         bool Pinned;
         float Radius;
+        uint32_t Color; // Graph color, elements linked by ParentIndex never share one
+        DirectX::XMFLOAT3 Acceleration; // Of the last step, for the next one's initial guess
     };
 
 }
 
 class ComputePassVBDChain :
-    public ComputePass
+    public ComputePass, public ISimStateOwner
 {
 public:
     ComputePassVBDChain();
@@ -68,11 +72,27 @@ public:
         m_simNeedsReset.FlagForReset();
     }
 
+    // ISimStateOwner - BEGIN
+    virtual std::string_view GetSimStateName() const override { return "VBDChain"; }
+    virtual uint32_t GetSimStateLayoutVersion() const override { return 3; }
+    virtual void GetSimStateBindings(std::vector<SimStateBinding>& outBindings) override;
+    virtual void OnSimStateRestored() override
+    {
+        // The restored state replaces whatever reset was pending
+        m_simNeedsReset = {};
+    }
+    // ISimStateOwner - END
+
     int32_t GetParticleReadBufferSRVHeapIndex() const;
     int32_t GetParticleOutputBufferSRVHeapIndex() const;
+    const SimStepData& GetSimStepData() const { return m_simStep; }
 
 private:
-    int32_t m_frameIdxModulo = 0;
+    StructuredBuffer<VBDChain::ChainElementData>* GetChainDataBuffer(uint32_t pingPongIdx) const;
+
+    SimStepData m_simStep;
+    uint32_t m_firstStepInputBufferIdx = 0; // Ping/pong buffer the first step of the frame reads from
+    uint32_t m_latestBufferIdx = 0; // Ping/pong buffer holding the most recent sim state
     TickableResetFlag m_simNeedsReset;
 
 	int32_t m_debugDrawBufferUAVIndex = -1;
@@ -80,8 +100,11 @@ private:
 
     std::unique_ptr<StructuredBuffer<VBDChain::ChainElementData>> m_chainDataBufferPing;
     std::unique_ptr<StructuredBuffer<VBDChain::ChainElementData>> m_chainDataBufferPong;
+    uint32_t m_colorCount = 0; // Of the constraint graph
 
     std::unique_ptr<ComputableObject> m_particlesComputeObj;
+
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
 class GraphicsPassVBDChain : public GraphicsPass
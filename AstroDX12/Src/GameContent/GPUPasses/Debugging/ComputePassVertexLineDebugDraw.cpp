@@ -15,25 +15,19 @@ namespace Privates
 
 void ComputePassVertexLineDebugDraw::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary)
 {
-    auto BufferDataVector = std::vector<DebugVertexLineData>(Privates::MaxDebugLines);
-    
-	// Buffer to store the debug line data into
-    m_debugDataBuffer = std::make_unique<StructuredBuffer<DebugVertexLineData>>(BufferDataVector);
+	// Buffer to store the debug line data into, only the lines counted this frame are ever read, so it's left uninitialised (no 10M elements CPU copy / upload)
+    m_debugDataBuffer = std::make_unique<GPUStructuredBuffer<DebugVertexLineData>>(Privates::MaxDebugLines);
     renderer->CreateStructuredBufferAndViews(m_debugDataBuffer.get(), std::wstring_view(L"LineDebugDrawData"), true, true);
 
 	// Buffer to count the number of lines to draw
-	std::vector< uint32_t > lineCounterData(1);
-	m_lineCountBuffer = std::make_unique<StructuredBuffer<uint32_t>>(lineCounterData);
+	m_lineCountBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(1, GPUBufferInitialContent::ZeroFilled);
 	renderer->CreateStructuredBufferAndViews(m_lineCountBuffer.get(), std::wstring_view(L"LineDebugDrawCount"), true, true, /*byteAddressBuffer*/true);
 
-	// Buffer to store the indirect draw args into 
-	std::vector<DrawIndirectArgs> drawArgsData(1);
-	m_indirectArgsBuffer = std::make_unique<StructuredBuffer<DrawIndirectArgs>>(drawArgsData);
+	// Buffer to store the indirect draw args into, starts as indirect args as expected by the first ExecuteComputeIndirectArgs
+	m_indirectArgsBuffer = std::make_unique<GPUStructuredBuffer<DrawIndirectArgs>>(1, GPUBufferInitialContent::ZeroFilled, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 	renderer->CreateStructuredBufferAndViews(m_indirectArgsBuffer.get(), std::wstring_view(L"LineDebugDrawIndirectArgs"), true, true);
 
-
-	// TODO: set resources in the correct initial state?
-
+    m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
 
     CreateRootSignatures(renderer);
     CreatePipelineState(renderer, shaderLibrary);
@@ -196,17 +190,9 @@ void ComputePassVertexLineDebugDraw::ExecuteComputeIndirectArgs(ComPtr<ID3D12Gra
 	// Calculate indirect draw args - by dispatching compute shader
 	PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassVertexLineDebugDraw::ExecuteComputeIndirectArgs");
 
-	// Transition buffers into correct state for the compute indirect args dispatch
-	// Transition resources into their next correct state
-
-	std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransitions;
-
-	// Indirect args buffer becomes UAV
-	buffersStateTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-		m_indirectArgsBuffer->Resource(),
-		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
-	cmdList->ResourceBarrier((UINT)buffersStateTransitions.size(), buffersStateTransitions.data());
+	// Indirect args buffer becomes UAV for the compute indirect args dispatch
+	m_resourceStates->UAVWrite(m_indirectArgsBuffer->Resource());
+	m_resourceStates->FlushBarriers(cmdList.Get());
 
 	// Dispatch compute shader to calculate the indirect draw args
 	cmdList->SetComputeRootSignature(m_rsComputeIndirectArgs.Get());
@@ -217,7 +203,7 @@ void ComputePassVertexLineDebugDraw::ExecuteComputeIndirectArgs(ComPtr<ID3D12Gra
 		m_lineCountBuffer->GetUAVIndex(),
 		m_indirectArgsBuffer->GetUAVIndex(),
 		m_debugDataBuffer->GetSRVIndex(),
-		frameResources.PassConstantBuffer->GetHeapDescriptorIndex()
+		frameResources.PassConstantBufferHeapIndex
 	};
 
 	cmdList->SetComputeRoot32BitConstants(
@@ -226,15 +212,8 @@ void ComputePassVertexLineDebugDraw::ExecuteComputeIndirectArgs(ComPtr<ID3D12Gra
 
 	cmdList->Dispatch(1, 1, 1);
 
-	// Transition buffers back to correct state for the indirect draw & to be ready for the next compute shader dispatches
-	buffersStateTransitions.clear();
-
-	// Indirect args buffer becomes SRV
-	buffersStateTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-		m_indirectArgsBuffer->Resource(),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
-
-	cmdList->ResourceBarrier(buffersStateTransitions.size(), buffersStateTransitions.data());
+	// Indirect args buffer becomes indirect args for the draw, flushed with the draw's own barriers
+	m_resourceStates->Transition(m_indirectArgsBuffer->Resource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 }
 
 void ComputePassVertexLineDebugDraw::ExecuteIndirectDraw(ComPtr<ID3D12GraphicsCommandList> cmdList, const FrameResource& /*frameResources*/) const
@@ -242,20 +221,16 @@ void ComputePassVertexLineDebugDraw::ExecuteIndirectDraw(ComPtr<ID3D12GraphicsCo
 	// Calculate indirect draw args - by dispatching compute shader
 	PIXScopedEvent(cmdList.Get(), PIX_COLOR(255, 128, 0), "ComputePassVertexLineDebugDraw::ExecuteIndirectDraw");
 
-	
-	std::vector<CD3DX12_RESOURCE_BARRIER> buffersStateTransitions;
 	// debug line draw buffer becomes SRV
-	buffersStateTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-		m_debugDataBuffer->Resource(),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
-	cmdList->ResourceBarrier((UINT)buffersStateTransitions.size(), buffersStateTransitions.data());
+	m_resourceStates->Transition(m_debugDataBuffer->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	m_resourceStates->FlushBarriers(cmdList.Get());
 
 	cmdList->SetPipelineState(m_psoDrawDebug.Get());
 	cmdList->SetGraphicsRootSignature(m_rsDrawDebug.Get());
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
 
 	// TODO: use bindless CBV index
-	//const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+	//const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
 	//cmdList->SetGraphicsRootConstantBufferView(1, frameResourceCBVBufferGPUAddress);
 
 	cmdList->ExecuteIndirect(
@@ -270,11 +245,8 @@ void ComputePassVertexLineDebugDraw::ExecuteIndirectDraw(ComPtr<ID3D12GraphicsCo
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// debug line draw buffer becomes UAV for the next compute shader dispatch that will write to it
-	buffersStateTransitions.clear();
-	buffersStateTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
-		m_debugDataBuffer->Resource(),
-		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-	cmdList->ResourceBarrier((UINT)buffersStateTransitions.size(), buffersStateTransitions.data());
+	m_resourceStates->Transition(m_debugDataBuffer->Resource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	m_resourceStates->FlushBarriers(cmdList.Get());
 }
 
 void ComputePassVertexLineDebugDraw::Shutdown()
@@ -1,6 +1,6 @@
 #pragma once
 #include <Rendering/Common/GPUPass.h>
-#include <Rendering/Common/StructuredBuffer.h>
+#include <Rendering/Common/GPUStructuredBuffer.h>
 
 class IRenderer;
 
@@ -53,9 +53,10 @@ private:
 		std::int32_t ColorIndex;
 	};
 
-	std::unique_ptr<StructuredBuffer<DebugVertexLineData>> m_debugDataBuffer;
-	std::unique_ptr<StructuredBuffer<DrawIndirectArgs>> m_indirectArgsBuffer;
-	std::unique_ptr<StructuredBuffer<uint32_t>> m_lineCountBuffer;
+	std::unique_ptr<GPUStructuredBuffer<DebugVertexLineData>> m_debugDataBuffer;
+	std::unique_ptr<GPUStructuredBuffer<DrawIndirectArgs>> m_indirectArgsBuffer;
+	std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_lineCountBuffer;
+	ResourceBarrierBatcher* m_resourceStates = nullptr;
 
 	ComPtr<ID3D12RootSignature> m_rsComputeIndirectArgs = nullptr;
 	ComPtr<ID3D12PipelineState> m_psoComputeIndirectArgs = nullptr;
@@ -14,21 +14,16 @@ namespace Privates
 
 void GraphicsPassDebugDraw::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, MeshLibrary& meshLibrary)
 {
-    auto BufferDataVector = std::vector<GraphicsPassDebugDraw::DebugObjectData>(Privates::MaxDebugObjects);
-    for (int32_t idx = 0; idx < Privates::MaxDebugObjects; ++idx)
-    {
-        BufferDataVector[idx].Transform = AstroTools::Maths::Identity4x4();
-		BufferDataVector[idx].Color = DirectX::XMFLOAT3(1.f, 0.f, 0.f);
-    }
-
-    m_debugObjectsBuffer = std::make_unique<StructuredBuffer<GraphicsPassDebugDraw::DebugObjectData>>(BufferDataVector);
+    // Only the first 'counter' objects are ever drawn, and compute passes write them before that, so no initial content is needed
+    m_debugObjectsBuffer = std::make_unique<GPUStructuredBuffer<GraphicsPassDebugDraw::DebugObjectData>>(Privates::MaxDebugObjects);
     renderer->CreateStructuredBufferAndViews(m_debugObjectsBuffer.get(), std::wstring_view(L"DebugDrawData"), true, true);
 
     // Atomic counter buffer (single uint32, used by compute passes via InterlockedAdd)
-    std::vector<uint32_t> counterInit = { 0 };
-    m_counterBuffer = std::make_unique<StructuredBuffer<uint32_t>>(counterInit);
+    m_counterBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(1, GPUBufferInitialContent::ZeroFilled);
     renderer->CreateStructuredBufferAndViews(m_counterBuffer.get(), std::wstring_view(L"DebugDrawCounter"), true, true);
 
+	m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
 	CreateRootSignature(renderer);
 	CreatePipelineState(renderer, shaderLibrary);
 
@@ -130,7 +125,7 @@ void GraphicsPassDebugDraw::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, f
 	cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
 	cmdList->SetPipelineState(m_pso.Get());
 
-	const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBuffer->Resource()->GetGPUVirtualAddress();
+	const auto frameResourceCBVBufferGPUAddress = frameResources.PassConstantBufferGPUAddress;
 	cmdList->SetGraphicsRootConstantBufferView(0, frameResourceCBVBufferGPUAddress);
 
 	const uint32_t GraphicsBindlessResourceIndicesRootSigParamIndex = 1;
@@ -143,10 +138,18 @@ void GraphicsPassDebugDraw::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, f
 		(UINT)GraphicsBindlessResourceIndicesRootSigParamIndex,
 		(UINT)GraphicsBindlessResourceIndices.size(), GraphicsBindlessResourceIndices.data(), 0);
 
+	// Both buffers live as UAVs for the compute passes writing into them, they're only read as SRVs for the draw
+	m_resourceStates->Transition(m_debugObjectsBuffer->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	m_resourceStates->Transition(m_counterBuffer->Resource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	m_resourceStates->FlushBarriers(cmdList.Get());
+
 	cmdList->DrawIndexedInstanced((UINT)m_debugMesh.lock()->GetVertexIndicesCount(), Privates::MaxDebugObjects, 0, 0, 0);
 
-	// Reset counter to 0 on GPU timeline for next frame's compute passes
-	m_counterBuffer->ResetToZero(cmdList.Get());
+	// Back to UAVs for next frame's compute passes, both transitions go out in the clear's batch
+	m_resourceStates->Transition(m_debugObjectsBuffer->Resource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	// Reset counter to 0 on GPU timeline for next frame's compute passes, cleared in place, nothing to upload
+	m_counterBuffer->Clear(cmdList.Get());
 }
 
 void GraphicsPassDebugDraw::Shutdown()
@@ -3,7 +3,7 @@
 #include <Rendering/Common/GPUPass.h>
 #include <Common.h>
 #include <Rendering/Common/RendererContext.h>
-#include <Rendering/Common/StructuredBuffer.h>
+#include <Rendering/Common/GPUStructuredBuffer.h>
 #include <Rendering/Common/ShaderLibrary.h>
 
 
@@ -45,8 +45,9 @@ private:
 		DirectX::XMFLOAT4X4 Transform;
 		DirectX::XMFLOAT3 Color;
 	};
-	std::unique_ptr<StructuredBuffer<DebugObjectData>> m_debugObjectsBuffer;
-	std::unique_ptr<StructuredBuffer<uint32_t>> m_counterBuffer;
+	std::unique_ptr<GPUStructuredBuffer<DebugObjectData>> m_debugObjectsBuffer;
+	std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_counterBuffer;
+	ResourceBarrierBatcher* m_resourceStates = nullptr;
 
 	ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
 	ComPtr<ID3D12PipelineState> m_pso = nullptr;
@@ -83,11 +83,12 @@ void GraphicsPassCopyGBufferToBackbuffer::Init(IRenderer* renderer, AstroTools::
     RendererContext& rendererContext = renderer->GetRendererContext();
 	const UINT64 IndexBufferByteSize = PassPrivates::VertexIndices.size() * sizeof(uint32_t);
 
+    m_resourceStates = rendererContext.ResourceStates.lock().get();
 	m_indexBufferGPU = AstroTools::Rendering::CreateDefaultBuffer(
-        rendererContext.Device.Get(), rendererContext.CommandList.Get(),
+        rendererContext.ResourceAllocator.lock(), m_indexBufferMemory, rendererContext.CommandList.Get(), *m_resourceStates,
         PassPrivates::VertexIndices.data(), IndexBufferByteSize, false,
 		std::wstring_view(L"GraphicsPassCopyGBufferToBackbuffer_IndexBuffer"),
-        m_indexUploadBuffer);
+        *rendererContext.UploadRing.lock());
 
 	m_indexBufferView.BufferLocation = m_indexBufferGPU->GetGPUVirtualAddress();
 	m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
@@ -131,5 +132,10 @@ void GraphicsPassCopyGBufferToBackbuffer::Execute(ComPtr<ID3D12GraphicsCommandLi
 
 void GraphicsPassCopyGBufferToBackbuffer::Shutdown()
 {
+    if (m_resourceStates && m_indexBufferGPU)
+    {
+        m_resourceStates->UnregisterResource(m_indexBufferGPU.Get());
+        m_resourceStates = nullptr;
+    }
 }
 
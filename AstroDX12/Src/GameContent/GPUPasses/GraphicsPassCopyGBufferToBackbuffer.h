@@ -2,8 +2,10 @@
 
 #include <Rendering/Common/GPUPass.h>
 #include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/PlacedResourceAllocator.h>
 
 class IRenderer;
+class ResourceBarrierBatcher;
 using Microsoft::WRL::ComPtr;
 
 class GraphicsPassCopyGBufferToBackbuffer : public GraphicsPass
@@ -11,7 +13,6 @@ class GraphicsPassCopyGBufferToBackbuffer : public GraphicsPass
 public:
     GraphicsPassCopyGBufferToBackbuffer()
 		: m_indexBufferGPU(nullptr)
-		, m_indexUploadBuffer(nullptr)
 		, m_indexBufferView{}
 		, m_rootSignature(nullptr)
 		, m_pso(nullptr)
@@ -25,8 +26,8 @@ public:
     virtual void Shutdown() override;
 
 private:
+    PlacedResourceMemory m_indexBufferMemory;
     ComPtr<ID3D12Resource> m_indexBufferGPU = nullptr;
-    ComPtr<ID3D12Resource> m_indexUploadBuffer = nullptr;
 
     D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
 
@@ -34,5 +35,7 @@ private:
     ComPtr<ID3D12PipelineState> m_pso = nullptr;
 
 	int32_t m_GBufferRTViewIndex = -1;
+
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
 };
 
@@ -1,13 +1,17 @@
 #include <GameContent/GPUPasses/GraphicsPassImGui.h>
 #include <Rendering/Common/RendererContext.h>
 #include <Rendering/Common/DescriptorHeap.h>
+#include <Rendering/Common/FramePacer.h>
+#include <Rendering/Common/PlacedResourceAllocator.h>
+#include <Rendering/Common/SimStateSnapshot.h>
+#include <GameContent/GPUPasses/RaymarchScene.h>
 #include <DemoManager.h>
 
 #include <imgui.h>
 #include <backends/imgui_impl_win32.h>
 #include <backends/imgui_impl_dx12.h>
 
-void GraphicsPassImGui::Init(HWND hwnd, RendererContext& rendererContext, int numFramesInFlight, DemoManager* demoManager)
+void GraphicsPassImGui::Init(HWND hwnd, RendererContext& rendererContext, int numFramesInFlight, DemoManager* demoManager, FramePacer* framePacer, SimStateSnapshotRequests* simStateRequests, RaymarchSettings* raymarchSettings, const RaymarchStats* raymarchStats)
 {
 	auto srvHeap = rendererContext.GlobalCBVSRVUAVDescriptorHeap.lock();
 	DX::astro_assert(srvHeap != nullptr, "SRV heap expired");
@@ -36,7 +40,12 @@ void GraphicsPassImGui::Init(HWND hwnd, RendererContext& rendererContext, int nu
 	initInfo.LegacySingleSrvGpuDescriptor = srvHeap->GetGPUDescriptorHandleByIndex(imguiSrvIndex);
 	ImGui_ImplDX12_Init(&initInfo);
 
+	m_resourceAllocator = rendererContext.ResourceAllocator;
 	m_demoManager = demoManager;
+	m_framePacer = framePacer;
+	m_simStateRequests = simStateRequests;
+	m_raymarchSettings = raymarchSettings;
+	m_raymarchStats = raymarchStats;
 }
 
 void GraphicsPassImGui::Update(const GPUPassUpdateData& /*updateData*/)
@@ -46,6 +55,10 @@ void GraphicsPassImGui::Update(const GPUPassUpdateData& /*updateData*/)
 	ImGui::NewFrame();
 
 	DrawDemoManagerUI();
+	DrawFramePacingUI();
+	DrawSimStateUI();
+	DrawRaymarchUI();
+	DrawGPUMemoryUI();
 }
 
 void GraphicsPassImGui::Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float /*deltaTime*/, const FrameResource& /*frameResources*/) const
@@ -68,12 +81,15 @@ void GraphicsPassImGui::DrawDemoManagerUI()
 
 	ImGui::Begin("Demos");
 
-	for (auto& demo : m_demoManager->GetDemos())
+	const auto& demos = m_demoManager->GetDemos();
+	for (uint32_t demoIdx = 0; demoIdx < uint32_t(demos.size()); ++demoIdx)
 	{
+		const auto& demo = demos[demoIdx];
 		bool enabled = demo.enabled;
 		if (ImGui::Checkbox(demo.name.c_str(), &enabled))
 		{
-			m_demoManager->SetDemoEnabled(demo.name, enabled);
+			// Applied next frame, so it's recorded along with the rest of the input
+			m_demoManager->RequestDemoEnabled(demoIdx, enabled);
 		}
 
 		if (!demo.dependencies.empty())
@@ -93,3 +109,105 @@ void GraphicsPassImGui::DrawDemoManagerUI()
 
 	ImGui::End();
 }
+
+void GraphicsPassImGui::DrawFramePacingUI()
+{
+	if (!m_framePacer)
+		return;
+
+	ImGui::Begin("Frame Pacing");
+
+	ImGui::Text("Frames in flight: %u", m_framePacer->GetFramesInFlight());
+
+	bool minimumLatency = m_framePacer->GetPolicy() == FramePacingPolicy::MinimumLatency;
+	if (ImGui::Checkbox("Minimum latency", &minimumLatency))
+	{
+		m_framePacer->SetPolicy(minimumLatency ? FramePacingPolicy::MinimumLatency : FramePacingPolicy::MaximumThroughput);
+		m_framePacer->ResetStats();
+	}
+
+	const FramePacerStats& stats = m_framePacer->GetStats();
+	ImGui::Text("CPU wait: %.3f ms (avg %.3f ms, max %.3f ms)",
+		double(stats.LastWaitMicroseconds) / 1000.0,
+		stats.GetAverageWaitMilliseconds(),
+		double(stats.MaxWaitMicroseconds) / 1000.0);
+	ImGui::Text("Frames waited on the GPU: %llu / %llu", (unsigned long long)stats.WaitedFrameCount, (unsigned long long)stats.FrameCount);
+
+	if (ImGui::Button("Reset stats"))
+	{
+		m_framePacer->ResetStats();
+	}
+
+	ImGui::End();
+}
+
+void GraphicsPassImGui::DrawSimStateUI()
+{
+	if (!m_simStateRequests)
+		return;
+
+	ImGui::Begin("Sim State");
+
+	// Processed at the start of the next frame, once the GPU is idle
+	if (ImGui::Button("Save snapshot"))
+	{
+		m_simStateRequests->SaveRequested = true;
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Load snapshot"))
+	{
+		m_simStateRequests->LoadRequested = true;
+	}
+
+	if (!m_simStateRequests->LastResult.empty())
+	{
+		ImGui::TextWrapped("%s", m_simStateRequests->LastResult.c_str());
+	}
+
+	ImGui::End();
+}
+
+void GraphicsPassImGui::DrawRaymarchUI()
+{
+	if (!m_raymarchSettings)
+		return;
+
+	ImGui::Begin("SDF Raymarch");
+
+	// Keep in the order of SDFRaymarch::Resolution
+	const char* resolutionNames[] = { "Full", "Half (upsampled)", "Checkerboard (reprojected)" };
+	int resolution = int(m_raymarchSettings->MarchResolution);
+	if (ImGui::Combo("Resolution", &resolution, resolutionNames, IM_ARRAYSIZE(resolutionNames)))
+	{
+		m_raymarchSettings->MarchResolution = SDFRaymarch::Resolution(resolution);
+	}
+	ImGui::Checkbox("Cone prepass", &m_raymarchSettings->ConePrepass);
+
+	if (m_raymarchStats)
+	{
+		const RaymarchStats& stats = *m_raymarchStats;
+		ImGui::Text("Marched pixels: %u", stats.MarchedPixelCount);
+		ImGui::Text("Steps per pixel: avg %.2f, max %u", double(stats.AverageStepCount), stats.MaxStepCount);
+		if (stats.ConeCount > 0)
+		{
+			ImGui::Text("Steps per cone (%u): avg %.2f, max %u", stats.ConeCount, double(stats.AverageConeStepCount), stats.MaxConeStepCount);
+		}
+	}
+
+	ImGui::End();
+}
+
+void GraphicsPassImGui::DrawGPUMemoryUI()
+{
+	const auto resourceAllocator = m_resourceAllocator.lock();
+	if (!resourceAllocator)
+		return;
+
+	// Collapsed by default, the report is only built while it's open
+	ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+	if (ImGui::Begin("GPU Memory"))
+	{
+		ImGui::TextUnformatted(resourceAllocator->GetFragmentationReport().c_str());
+	}
+	ImGui::End();
+}
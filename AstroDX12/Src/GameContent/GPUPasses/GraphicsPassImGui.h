@@ -4,13 +4,18 @@
 #include <Rendering/Common/GPUPass.h>
 
 class DemoManager;
+class FramePacer;
+struct SimStateSnapshotRequests;
+struct RaymarchSettings;
+struct RaymarchStats;
 class DescriptorHeap;
+class PlacedResourceAllocator;
 struct RendererContext;
 
 class GraphicsPassImGui : public GraphicsPass
 {
 public:
-	void Init(HWND hwnd, RendererContext& rendererContext, int numFramesInFlight, DemoManager* demoManager);
+	void Init(HWND hwnd, RendererContext& rendererContext, int numFramesInFlight, DemoManager* demoManager, FramePacer* framePacer, SimStateSnapshotRequests* simStateRequests, RaymarchSettings* raymarchSettings, const RaymarchStats* raymarchStats);
 
 	virtual void Update(const GPUPassUpdateData& updateData) override;
 	virtual void Execute(ComPtr<ID3D12GraphicsCommandList> cmdList, float deltaTime, const FrameResource& frameResources) const override;
@@ -18,6 +23,15 @@ public:
 
 private:
 	void DrawDemoManagerUI();
+	void DrawFramePacingUI();
+	void DrawSimStateUI();
+	void DrawRaymarchUI();
+	void DrawGPUMemoryUI();
 
 	DemoManager* m_demoManager = nullptr;
+	FramePacer* m_framePacer = nullptr;
+	SimStateSnapshotRequests* m_simStateRequests = nullptr;
+	RaymarchSettings* m_raymarchSettings = nullptr;
+	const RaymarchStats* m_raymarchStats = nullptr;
+	std::weak_ptr<PlacedResourceAllocator> m_resourceAllocator; // Its heaps' fragmentation report
 };
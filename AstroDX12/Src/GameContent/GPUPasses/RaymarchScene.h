@@ -1,7 +1,29 @@
 #pragma once
 
+#include <Rendering/Common/SDFRaymarch.h>
+
 namespace GBufferStatics
 {
     static const int32_t GBufferWidth = 1280;
     static const int32_t GBufferHeight = 720;
 }
+
+// Edited from the ImGui pass, read by the raymarch pass every frame
+struct RaymarchSettings
+{
+    // Full marches every pixel, the reduced ones a quarter of them, see SDFRaymarch::Resolution
+    SDFRaymarch::Resolution MarchResolution = SDFRaymarch::Resolution::Full;
+    // Coarse cone march first, pixels start where their block's cone may touch a surface
+    bool ConePrepass = true;
+};
+
+// Step counts of a frame, read back by the raymarch pass a few frames late, shown by the ImGui pass
+struct RaymarchStats
+{
+    uint32_t MarchedPixelCount = 0;
+    float AverageStepCount = 0.f;
+    uint32_t MaxStepCount = 0;
+    uint32_t ConeCount = 0; // 0 without the prepass
+    float AverageConeStepCount = 0.f;
+    uint32_t MaxConeStepCount = 0;
+};
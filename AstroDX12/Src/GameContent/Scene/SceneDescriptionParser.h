@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdlib>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Text level description of a scene object, as read from a .lvl file, before any maths types are involved.
+// No platform types in here, SceneLoader turns these into SceneObjectDesc.
+struct ParsedSceneObject
+{
+	std::string meshPath;
+	float position[3] = {};
+	float rotationDegrees[3] = {};
+	float scale[3] = {};
+};
+
+// .lvl format, one token per line:
+// "#" starts an object, "/" ends it, anything else is a property name followed by its value on the next line.
+// Vector values are "x,y,z".
+namespace SceneDescriptionParser
+{
+	namespace Privates
+	{
+		// Parses "x,y,z" in place, no temporary strings
+		inline void ParseFloat3(const std::string& text, float (&outValue)[3])
+		{
+			const char* cursor = text.c_str();
+			for (int component = 0; component < 3; ++component)
+			{
+				char* componentEnd = nullptr;
+				outValue[component] = std::strtof(cursor, &componentEnd);
+				cursor = *componentEnd == ',' ? componentEnd + 1 : componentEnd;
+			}
+		}
+
+		// Files authored on Windows may be read in binary mode elsewhere
+		inline void TrimLineEnding(std::string& line)
+		{
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+		}
+	}
+
+	inline std::vector<ParsedSceneObject> Parse(std::istream& stream)
+	{
+		std::vector<ParsedSceneObject> sceneObjects;
+		ParsedSceneObject newObject;
+
+		std::string text;
+		std::string propertyVal;
+		while (std::getline(stream, text))
+		{
+			Privates::TrimLineEnding(text);
+			if (text == "#")
+			{
+				newObject = {};
+			}
+			else if (text == "/")
+			{
+				// finalise object and add to the list
+				sceneObjects.push_back(newObject);
+			}
+			else
+			{
+				// parse lines and initialise parameters of newObject
+				if (!std::getline(stream, propertyVal))
+				{
+					break;
+				}
+				Privates::TrimLineEnding(propertyVal);
+
+				if (text == "MeshPath")
+				{
+					newObject.meshPath = propertyVal;
+				}
+				else if (text == "Position")
+				{
+					Privates::ParseFloat3(propertyVal, newObject.position);
+				}
+				else if (text == "Rotation")
+				{
+					Privates::ParseFloat3(propertyVal, newObject.rotationDegrees);
+				}
+				else if (text == "Scale")
+				{
+					Privates::ParseFloat3(propertyVal, newObject.scale);
+				}
+			}
+		}
+
+		return sceneObjects;
+	}
+}
@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include <GameContent\Scene\SceneDescription.h>
+#include <GameContent/Scene/SceneDescriptionParser.h>
 
 namespace SceneLoaderHelpers
 {
@@ -82,19 +83,6 @@ namespace SceneLoaderHelpers
 			SceneMeshData<VertexData_Pos_Normal_UV> meshObject_VD_PosNormUV = { vertsConverted, indicesConverted, meshName};
 			return meshObject_VD_PosNormUV;
 	}
-
-	[[nodiscard]] static XMFLOAT3 ConvertStringToFloat3(const std::string& str)
-	{
-		const size_t yIndex = str.find(',', 0) + 1;
-		const size_t zIndex = str.find(',', yIndex) + 1;
-
-		XMFLOAT3 result;
-		result.x = std::stof(str.substr(0, yIndex - 1));
-		result.y = std::stof(str.substr(yIndex, zIndex - yIndex - 1));
-		result.z = std::stof(str.substr(zIndex, str.length() - zIndex));
-
-		return result;
-	}
 }
 
 SceneData SceneLoader::LoadScene(std::uint8_t SceneIdx)
@@ -117,47 +105,16 @@ SceneData SceneLoader::LoadScene1()
 		std::ifstream stream;
 		stream.open(DX::GetWorkingDirectory()+"/Content/Scenes/Scene1.lvl", std::ifstream::in);
 
-		SceneObjectDesc newObject;
-		while (stream.good())
+		for (const ParsedSceneObject& parsedObject : SceneDescriptionParser::Parse(stream))
 		{
-			char line[64];
-			stream.getline(line,64);
-
-			std::string text{ line };
-
-			if (text == "#")
-			{
-				newObject = {};
-			}
-			else if (text == "/")
-			{
-				// finalise object and add to the list
-				sceneDesc.sceneObjects.push_back(newObject);
-			}
-			else
-			{
-				// parse lines and initialise parameters of newObject
-				stream.getline(line, 64);
-				std::string propertyVal{ line };
-
-				if (text == "MeshPath")
-				{
-					newObject.meshPath = propertyVal;
-				}
-				else if (text == "Position")
-				{
-					newObject.position = SceneLoaderHelpers::ConvertStringToFloat3(propertyVal);
-				}
-				else if (text == "Rotation")
-				{
-					XMFLOAT3 eulerAnglesInDegrees = SceneLoaderHelpers::ConvertStringToFloat3(propertyVal);
-					newObject.rotationEulerAngles = { XMConvertToRadians(eulerAnglesInDegrees.x),XMConvertToRadians(eulerAnglesInDegrees.y),XMConvertToRadians(eulerAnglesInDegrees.z) };
-				}
-				else if (text == "Scale")
-				{
-					newObject.scale = SceneLoaderHelpers::ConvertStringToFloat3(propertyVal);
-				}
-			}
+			SceneObjectDesc& newObject = sceneDesc.sceneObjects.emplace_back();
+			newObject.meshPath = parsedObject.meshPath;
+			newObject.position = XMFLOAT3(parsedObject.position);
+			newObject.rotationEulerAngles = {
+				XMConvertToRadians(parsedObject.rotationDegrees[0]),
+				XMConvertToRadians(parsedObject.rotationDegrees[1]),
+				XMConvertToRadians(parsedObject.rotationDegrees[2]) };
+			newObject.scale = XMFLOAT3(parsedObject.scale);
 		}
 
 		stream.close();
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Record & replay of everything driving a frame from outside the app: input events and frame timing.
+// Replaying a recording feeds a run the same inputs frame for frame, so two builds can be compared on identical work.
+// No platform types in here, the Game translates its window messages to & from these.
+
+enum class RecordedInputType : uint8_t
+{
+	MouseDown = 0,
+	MouseUp,
+	MouseMove,
+	Key,
+	DemoToggle, // Made through the UI, whose own mouse & keyboard input isn't recorded
+};
+
+struct RecordedInputEvent
+{
+	RecordedInputType Type = RecordedInputType::MouseMove;
+	uint32_t Value = 0; // Mouse buttons state (MK_ flags) for mouse events, KeyboardKey for key events, the demo's index for toggles
+	int32_t X = 0; // 1 to enable the demo, 0 to disable it for toggles
+	int32_t Y = 0;
+};
+
+// State a frame ended in, recorded so a replay diverging from its recording can be detected
+struct RecordedFrameState
+{
+	int32_t CursorX = 0;
+	int32_t CursorY = 0;
+	float CameraPosition[3] = {};
+	float CameraTheta = 0.f;
+	float CameraPhi = 0.f;
+
+	bool operator==(const RecordedFrameState& rhs) const
+	{
+		return CursorX == rhs.CursorX
+			&& CursorY == rhs.CursorY
+			&& memcmp(CameraPosition, rhs.CameraPosition, sizeof(CameraPosition)) == 0
+			&& CameraTheta == rhs.CameraTheta
+			&& CameraPhi == rhs.CameraPhi;
+	}
+};
+
+struct RecordedFrame
+{
+	float TotalTime = 0.f;
+	float DeltaTime = 0.f;
+	std::vector<RecordedInputEvent> Events; // Received since the previous frame, in order
+	RecordedFrameState EndState;
+};
+
+struct InputRecording
+{
+	std::vector<RecordedFrame> Frames;
+};
+
+enum class InputRecordingReadResult : uint8_t
+{
+	Ok = 0,
+	FileNotFound,
+	BadMagic,
+	UnsupportedFormatVersion,
+	Truncated,
+	ChecksumMismatch,
+};
+
+// Binary layout, little endian:
+// "AREC" | u32 format version | u32 frame count
+// per frame: f32 total time | f32 delta time | end state | u32 event count | events
+// u64 FNV-1a hash of everything before it
+namespace InputRecordingSerialization
+{
+	constexpr char Magic[4] = { 'A', 'R', 'E', 'C' };
+	constexpr uint32_t FormatVersion = 1;
+
+	inline uint64_t HashBytes(const uint8_t* data, size_t byteSize)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < byteSize; ++i)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	namespace Privates
+	{
+		template<typename T>
+		void Write(std::vector<uint8_t>& outBytes, const T& value)
+		{
+			const uint8_t* valueBytes = reinterpret_cast<const uint8_t*>(&value);
+			outBytes.insert(outBytes.end(), valueBytes, valueBytes + sizeof(T));
+		}
+
+		struct Reader
+		{
+			const uint8_t* Data;
+			size_t ByteSize;
+			size_t Offset = 0;
+
+			template<typename T>
+			bool Read(T& outValue)
+			{
+				if (ByteSize - Offset < sizeof(T))
+				{
+					return false;
+				}
+				memcpy(&outValue, Data + Offset, sizeof(T));
+				Offset += sizeof(T);
+				return true;
+			}
+
+			size_t GetRemainingByteSize() const
+			{
+				return ByteSize - Offset;
+			}
+		};
+
+		inline void WriteFrameState(std::vector<uint8_t>& outBytes, const RecordedFrameState& state)
+		{
+			Write(outBytes, state.CursorX);
+			Write(outBytes, state.CursorY);
+			Write(outBytes, state.CameraPosition);
+			Write(outBytes, state.CameraTheta);
+			Write(outBytes, state.CameraPhi);
+		}
+
+		inline bool ReadFrameState(Reader& reader, RecordedFrameState& outState)
+		{
+			return reader.Read(outState.CursorX)
+				&& reader.Read(outState.CursorY)
+				&& reader.Read(outState.CameraPosition)
+				&& reader.Read(outState.CameraTheta)
+				&& reader.Read(outState.CameraPhi);
+		}
+	}
+
+	inline std::vector<uint8_t> Serialize(const InputRecording& recording)
+	{
+		constexpr size_t FrameByteSize = sizeof(float) * 2 + sizeof(RecordedFrameState) + sizeof(uint32_t);
+		constexpr size_t EventByteSize = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(int32_t) * 2;
+		size_t eventCount = 0;
+		for (const RecordedFrame& frame : recording.Frames)
+		{
+			eventCount += frame.Events.size();
+		}
+
+		std::vector<uint8_t> bytes;
+		bytes.reserve(sizeof(Magic) + sizeof(uint32_t) * 2 + recording.Frames.size() * FrameByteSize + eventCount * EventByteSize + sizeof(uint64_t));
+		Privates::Write(bytes, Magic);
+		Privates::Write(bytes, FormatVersion);
+		Privates::Write(bytes, uint32_t(recording.Frames.size()));
+
+		for (const RecordedFrame& frame : recording.Frames)
+		{
+			Privates::Write(bytes, frame.TotalTime);
+			Privates::Write(bytes, frame.DeltaTime);
+			Privates::WriteFrameState(bytes, frame.EndState);
+			Privates::Write(bytes, uint32_t(frame.Events.size()));
+			for (const RecordedInputEvent& event : frame.Events)
+			{
+				Privates::Write(bytes, uint8_t(event.Type));
+				Privates::Write(bytes, event.Value);
+				Privates::Write(bytes, event.X);
+				Privates::Write(bytes, event.Y);
+			}
+		}
+
+		Privates::Write(bytes, HashBytes(bytes.data(), bytes.size()));
+		return bytes;
+	}
+
+	inline InputRecordingReadResult Deserialize(const uint8_t* data, size_t byteSize, InputRecording& outRecording)
+	{
+		constexpr size_t HeaderByteSize = sizeof(Magic) + sizeof(uint32_t);
+		if (byteSize < HeaderByteSize || memcmp(data, Magic, sizeof(Magic)) != 0)
+		{
+			return byteSize < sizeof(Magic) ? InputRecordingReadResult::Truncated : InputRecordingReadResult::BadMagic;
+		}
+
+		uint32_t formatVersion = 0;
+		memcpy(&formatVersion, data + sizeof(Magic), sizeof(formatVersion));
+		if (formatVersion != FormatVersion)
+		{
+			return InputRecordingReadResult::UnsupportedFormatVersion;
+		}
+
+		if (byteSize < HeaderByteSize + sizeof(uint64_t))
+		{
+			return InputRecordingReadResult::Truncated;
+		}
+
+		const size_t hashedByteSize = byteSize - sizeof(uint64_t);
+		uint64_t storedHash = 0;
+		memcpy(&storedHash, data + hashedByteSize, sizeof(storedHash));
+		if (storedHash != HashBytes(data, hashedByteSize))
+		{
+			return InputRecordingReadResult::ChecksumMismatch;
+		}
+
+		Privates::Reader reader{ data, hashedByteSize, HeaderByteSize };
+		uint32_t frameCount = 0;
+		if (!reader.Read(frameCount))
+		{
+			return InputRecordingReadResult::Truncated;
+		}
+
+		InputRecording recording;
+		recording.Frames.resize(frameCount);
+		for (RecordedFrame& frame : recording.Frames)
+		{
+			uint32_t eventCount = 0;
+			if (!reader.Read(frame.TotalTime)
+				|| !reader.Read(frame.DeltaTime)
+				|| !Privates::ReadFrameState(reader, frame.EndState)
+				|| !reader.Read(eventCount))
+			{
+				return InputRecordingReadResult::Truncated;
+			}
+
+			frame.Events.resize(eventCount);
+			for (RecordedInputEvent& event : frame.Events)
+			{
+				uint8_t type = 0;
+				if (!reader.Read(type)
+					|| !reader.Read(event.Value)
+					|| !reader.Read(event.X)
+					|| !reader.Read(event.Y))
+				{
+					return InputRecordingReadResult::Truncated;
+				}
+				event.Type = RecordedInputType(type);
+			}
+		}
+
+		outRecording = std::move(recording);
+		return InputRecordingReadResult::Ok;
+	}
+
+	inline bool SaveToFile(const std::string& path, const InputRecording& recording)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		const std::vector<uint8_t> bytes = Serialize(recording);
+		file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+		return file.good();
+	}
+
+	inline InputRecordingReadResult LoadFromFile(const std::string& path, InputRecording& outRecording)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+		{
+			return InputRecordingReadResult::FileNotFound;
+		}
+
+		const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return Deserialize(bytes.data(), bytes.size(), outRecording);
+	}
+}
+
+// Collects input events as they're received, and closes a frame once it has been updated & rendered
+class InputRecorder final
+{
+public:
+	void RecordEvent(const RecordedInputEvent& event)
+	{
+		m_pendingEvents.push_back(event);
+	}
+
+	// The events received since the previous frame were applied before this one, they're attributed to it
+	void RecordFrame(float totalTime, float deltaTime, const RecordedFrameState& endState)
+	{
+		RecordedFrame& frame = m_recording.Frames.emplace_back();
+		frame.TotalTime = totalTime;
+		frame.DeltaTime = deltaTime;
+		frame.Events = std::move(m_pendingEvents);
+		frame.EndState = endState;
+		m_pendingEvents.clear();
+	}
+
+	const InputRecording& GetRecording() const { return m_recording; }
+
+private:
+	InputRecording m_recording;
+	std::vector<RecordedInputEvent> m_pendingEvents;
+};
+
+// Plays a recording back frame by frame, in place of the live input & timer
+class InputReplayer final
+{
+public:
+	// fixedDeltaTime > 0 replaces the recorded frame times with a fixed timestep, eg: to compare builds independently of the recording machine's speed
+	InputReplayer(InputRecording recording, float fixedDeltaTime = 0.f)
+		: m_recording(std::move(recording))
+		, m_fixedDeltaTime(fixedDeltaTime)
+	{
+	}
+
+	bool IsFinished() const
+	{
+		return m_nextFrameIdx >= m_recording.Frames.size();
+	}
+
+	// Returns the frame to play next, nullptr once done. Its events are to be applied before the frame is updated.
+	const RecordedFrame* BeginFrame(float& outTotalTime, float& outDeltaTime)
+	{
+		if (IsFinished())
+		{
+			return nullptr;
+		}
+
+		const RecordedFrame& frame = m_recording.Frames[m_nextFrameIdx];
+		if (m_fixedDeltaTime > 0.f)
+		{
+			outDeltaTime = m_fixedDeltaTime;
+			outTotalTime = float(double(m_nextFrameIdx + 1) * m_fixedDeltaTime);
+		}
+		else
+		{
+			outDeltaTime = frame.DeltaTime;
+			outTotalTime = frame.TotalTime;
+		}
+		return &frame;
+	}
+
+	// Compares the state the frame ended in with the recorded one
+	void EndFrame(const RecordedFrameState& endState)
+	{
+		if (IsFinished())
+		{
+			return;
+		}
+
+		if (!(endState == m_recording.Frames[m_nextFrameIdx].EndState))
+		{
+			if (m_divergentFrameCount == 0)
+			{
+				m_firstDivergentFrameIdx = m_nextFrameIdx;
+			}
+			++m_divergentFrameCount;
+		}
+		++m_nextFrameIdx;
+	}
+
+	size_t GetFrameCount() const { return m_recording.Frames.size(); }
+	size_t GetPlayedFrameCount() const { return m_nextFrameIdx; }
+	size_t GetDivergentFrameCount() const { return m_divergentFrameCount; }
+	size_t GetFirstDivergentFrameIdx() const { return m_firstDivergentFrameIdx; } // Only meaningful if GetDivergentFrameCount() > 0
+
+private:
+	InputRecording m_recording;
+	float m_fixedDeltaTime = 0.f;
+	size_t m_nextFrameIdx = 0;
+	size_t m_divergentFrameCount = 0;
+	size_t m_firstDivergentFrameIdx = 0;
+};
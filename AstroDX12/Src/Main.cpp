@@ -4,6 +4,9 @@
 
 #include <Common.h>
 #include <windowsx.h>
+#include <shellapi.h>
+#include <cmath>
+#include <cwchar>
 
 #include <AstroGameInstance.h>
 #include <Timing/GameTimer.h>
@@ -32,6 +35,76 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = ".\\D3D12\\
 
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 
+struct CommandLineArguments
+{
+    std::wstring RecordPath;
+    std::wstring ReplayPath;
+    float FixedDeltaTime = 0.f;
+    uint32_t FramesInFlight = DefaultFramesInFlight;
+};
+
+// -record <file>: records input & frame times to file
+// -replay <file> [-fixeddt <seconds>]: replays a recording then quits, with the recorded frame times or a fixed timestep
+// -framesinflight <count>: frames the CPU can record ahead of the GPU, 1 to MaxFramesInFlight
+CommandLineArguments ParseCommandLineArguments()
+{
+    CommandLineArguments arguments;
+
+    int argCount = 0;
+    LPWSTR* args = CommandLineToArgvW(GetCommandLineW(), &argCount);
+    if (!args)
+        return arguments;
+
+    for (int i = 1; i + 1 < argCount; ++i)
+    {
+        const std::wstring arg = args[i];
+        if (arg == L"-record")
+            arguments.RecordPath = args[++i];
+        else if (arg == L"-replay")
+            arguments.ReplayPath = args[++i];
+        else if (arg == L"-fixeddt")
+        {
+            // Bad values are logged & ignored rather than thrown, args still has to be freed
+            const wchar_t* value = args[++i];
+            wchar_t* valueEnd = nullptr;
+            const float fixedDeltaTime = wcstof(value, &valueEnd);
+            if (valueEnd != value && *valueEnd == L'\0' && fixedDeltaTime > 0.f && std::isfinite(fixedDeltaTime))
+                arguments.FixedDeltaTime = fixedDeltaTime;
+            else
+                ::OutputDebugStringW((L"Ignoring -fixeddt " + std::wstring(value) + L", expected a positive number of seconds\n").c_str());
+        }
+        else if (arg == L"-framesinflight")
+        {
+            const wchar_t* value = args[++i];
+            wchar_t* valueEnd = nullptr;
+            const unsigned long framesInFlight = wcstoul(value, &valueEnd, 10);
+            if (valueEnd != value && *valueEnd == L'\0' && value[0] != L'-')
+                arguments.FramesInFlight = uint32_t(std::min<unsigned long>(framesInFlight, MaxFramesInFlight));
+            else
+                ::OutputDebugStringW((L"Ignoring -framesinflight " + std::wstring(value) + L", expected a frame count\n").c_str());
+        }
+    }
+    LocalFree(args);
+    return arguments;
+}
+
+bool StartInputRecordingOrReplay(const CommandLineArguments& arguments)
+{
+    if (!arguments.ReplayPath.empty())
+    {
+        if (!g_game->StartInputReplay(std::filesystem::path(arguments.ReplayPath).string(), arguments.FixedDeltaTime))
+        {
+            MessageBoxW(nullptr, (L"Couldn't read input recording " + arguments.ReplayPath).c_str(), g_szAppName, MB_OK | MB_ICONERROR);
+            return false;
+        }
+    }
+    else if (!arguments.RecordPath.empty())
+    {
+        g_game->StartInputRecording(std::filesystem::path(arguments.RecordPath).string());
+    }
+    return true;
+}
+
 // Entry point
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
@@ -42,7 +115,10 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         return 1;
 
 
+    const CommandLineArguments arguments = ParseCommandLineArguments();
+
     g_game = std::make_unique<AstroGameInstance>();
+    g_game->SetFramesInFlight(arguments.FramesInFlight);
 
     // Register class and create window
     HWND hwnd;
@@ -87,6 +163,13 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
         g_game->Initialize(hwnd, rc.right - rc.left, rc.bottom - rc.top);
     }
+
+    if (!StartInputRecordingOrReplay(arguments))
+    {
+        g_game->Shutdown();
+        return 1;
+    }
+
     g_gameTimer = std::make_unique<GameTimer>();
     g_gameTimer->Reset();
     
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// Element range [Begin, End) of a buffer whose CPU copy changed since its last upload
+struct DirtyRange
+{
+	size_t Begin = 0;
+	size_t End = 0;
+
+	size_t Count() const { return End - Begin; }
+};
+
+// Records which elements of a buffer were modified, then hands them back as as few sorted, non overlapping ranges as possible.
+// No graphics API types in here, the coalescing can be exercised on its own.
+class DirtyRangeTracker final
+{
+public:
+	void MarkDirty(size_t firstElement, size_t elementCount = 1)
+	{
+		if (elementCount == 0)
+		{
+			return;
+		}
+
+		// Extending the last range covers the common case of consecutive elements being written in order, without growing the list
+		if (!m_ranges.empty() && m_ranges.back().End == firstElement)
+		{
+			m_ranges.back().End += elementCount;
+			return;
+		}
+		m_ranges.push_back({ firstElement, firstElement + elementCount });
+	}
+
+	bool IsEmpty() const
+	{
+		return m_ranges.empty();
+	}
+
+	void Clear()
+	{
+		m_ranges.clear();
+	}
+
+	// Sorted ranges where overlapping & touching ranges are merged.
+	// Ranges separated by at most maxGapElements clean elements are merged too, re-uploading a few clean elements is cheaper than an extra copy command.
+	std::vector<DirtyRange> GetCoalescedRanges(size_t maxGapElements = 0) const
+	{
+		std::vector<DirtyRange> sortedRanges = m_ranges;
+		std::sort(sortedRanges.begin(), sortedRanges.end(), [](const DirtyRange& lhs, const DirtyRange& rhs)
+		{
+			return lhs.Begin < rhs.Begin;
+		});
+
+		std::vector<DirtyRange> coalescedRanges;
+		for (const DirtyRange& range : sortedRanges)
+		{
+			assert(range.Begin < range.End);
+			if (!coalescedRanges.empty() && range.Begin <= coalescedRanges.back().End + maxGapElements)
+			{
+				coalescedRanges.back().End = std::max(coalescedRanges.back().End, range.End);
+			}
+			else
+			{
+				coalescedRanges.push_back(range);
+			}
+		}
+		return coalescedRanges;
+	}
+
+private:
+	std::vector<DirtyRange> m_ranges; // In the order they were marked, may overlap
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Platform independent CPU/GPU frame pacing: decides which fence the CPU waits on before recording a new frame,
+// and measures how long it waited. The fence & clock are interfaces so the policy can be driven by fakes, no graphics API types in here.
+
+// GPU progress, as seen by the CPU
+class IFrameFence
+{
+public:
+	virtual ~IFrameFence() {}
+	virtual uint64_t GetCompletedValue() const = 0;
+	// Blocks until the GPU has reached fenceValue
+	virtual void WaitForValue(uint64_t fenceValue) = 0;
+};
+
+class IFrameClock
+{
+public:
+	virtual ~IFrameClock() {}
+	virtual uint64_t GetMicroseconds() const = 0;
+};
+
+class SteadyFrameClock final : public IFrameClock
+{
+public:
+	virtual uint64_t GetMicroseconds() const override
+	{
+		return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+};
+
+// Frame resources the CPU can record ahead of the GPU, the app takes it from its -framesinflight argument.
+// Past MaxFramesInFlight the extra latency isn't worth the memory: each frame in flight has its own resources & upload ring share.
+constexpr uint32_t DefaultFramesInFlight = 3;
+constexpr uint32_t MaxFramesInFlight = 4;
+
+enum class FramePacingPolicy : uint8_t
+{
+	MaximumThroughput = 0, // The CPU runs up to FramesInFlight frames ahead of the GPU, it only waits when every frame resource is in use
+	MinimumLatency,        // The CPU waits for the previous frame to complete, input is sampled as late as possible
+};
+
+struct FramePacerStats
+{
+	uint64_t FrameCount = 0;
+	uint64_t WaitedFrameCount = 0;   // Frames where the GPU wasn't done yet and the CPU had to block
+	uint64_t LastWaitMicroseconds = 0;
+	uint64_t MaxWaitMicroseconds = 0;
+	uint64_t TotalWaitMicroseconds = 0;
+
+	double GetAverageWaitMilliseconds() const
+	{
+		return FrameCount == 0 ? 0.0 : double(TotalWaitMicroseconds) / double(FrameCount) / 1000.0;
+	}
+};
+
+class FramePacer final
+{
+public:
+	FramePacer(uint32_t framesInFlight, FramePacingPolicy policy, IFrameFence& fence, IFrameClock& clock)
+		: m_framesInFlight(framesInFlight)
+		, m_policy(policy)
+		, m_fence(fence)
+		, m_clock(clock)
+		, m_frameFences(framesInFlight, 0)
+	{
+		assert(framesInFlight > 0);
+	}
+
+	FramePacer(const FramePacer& rhs) = delete;
+	FramePacer& operator=(const FramePacer& rhs) = delete;
+
+	// Waits until the next frame can be recorded, returns the index of the frame resource it can use
+	uint32_t BeginFrame()
+	{
+		assert(!m_frameInProgress && "BeginFrame called twice without EndFrame");
+		m_frameInProgress = true;
+		m_currentFrameIndex = (m_currentFrameIndex + 1) % m_framesInFlight;
+
+		// The frame resource about to be reused must always be free, the latency policy may require more than that
+		uint64_t fenceToWaitFor = m_frameFences[m_currentFrameIndex];
+		if (m_policy == FramePacingPolicy::MinimumLatency)
+		{
+			fenceToWaitFor = std::max(fenceToWaitFor, m_lastSubmittedFence);
+		}
+
+		uint64_t waitMicroseconds = 0;
+		if (fenceToWaitFor != 0 && m_fence.GetCompletedValue() < fenceToWaitFor)
+		{
+			const uint64_t waitStart = m_clock.GetMicroseconds();
+			m_fence.WaitForValue(fenceToWaitFor);
+			waitMicroseconds = m_clock.GetMicroseconds() - waitStart;
+			++m_stats.WaitedFrameCount;
+		}
+
+		++m_stats.FrameCount;
+		m_stats.LastWaitMicroseconds = waitMicroseconds;
+		m_stats.MaxWaitMicroseconds = std::max(m_stats.MaxWaitMicroseconds, waitMicroseconds);
+		m_stats.TotalWaitMicroseconds += waitMicroseconds;
+		return m_currentFrameIndex;
+	}
+
+	// fenceValue is signalled once the GPU is done with the frame recorded since BeginFrame
+	void EndFrame(uint64_t fenceValue)
+	{
+		assert(m_frameInProgress && "EndFrame called without BeginFrame");
+		assert(fenceValue > m_lastSubmittedFence && "Fence values must be increasing");
+		m_frameInProgress = false;
+		m_frameFences[m_currentFrameIndex] = fenceValue;
+		m_lastSubmittedFence = fenceValue;
+	}
+
+	uint32_t GetCurrentFrameIndex() const
+	{
+		return m_currentFrameIndex;
+	}
+
+	uint32_t GetFramesInFlight() const
+	{
+		return m_framesInFlight;
+	}
+
+	FramePacingPolicy GetPolicy() const
+	{
+		return m_policy;
+	}
+
+	// Can be changed at any time, it only affects the next waits
+	void SetPolicy(FramePacingPolicy policy)
+	{
+		m_policy = policy;
+	}
+
+	const FramePacerStats& GetStats() const
+	{
+		return m_stats;
+	}
+
+	void ResetStats()
+	{
+		m_stats = {};
+	}
+
+private:
+	uint32_t m_framesInFlight;
+	FramePacingPolicy m_policy;
+	IFrameFence& m_fence;
+	IFrameClock& m_clock;
+
+	std::vector<uint64_t> m_frameFences; // Per frame resource, fence of the last frame which used it
+	uint64_t m_lastSubmittedFence = 0;
+	uint32_t m_currentFrameIndex = 0;
+	bool m_frameInProgress = false;
+	FramePacerStats m_stats;
+};
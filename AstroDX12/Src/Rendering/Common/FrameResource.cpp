@@ -3,7 +3,7 @@
 #include <d3d12.h>
 #include <Rendering/RenderData/RenderConstants.h>
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, int16_t frameResourceIndex)
+FrameResource::FrameResource(ID3D12Device* device, int16_t frameResourceIndex)
 	: m_frameResourceIndex(frameResourceIndex)
 {
 	ThrowIfFailed(device->CreateCommandAllocator(
@@ -11,8 +11,6 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, int16_t frame
 		IID_PPV_ARGS(CmdListAllocator.GetAddressOf())
 	));
 
-	PassConstantBuffer = std::make_unique<UploadBuffer<RenderPassConstants>>(device, passCount, true);
-
 }
 
 FrameResource::~FrameResource()
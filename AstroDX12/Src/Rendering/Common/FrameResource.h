@@ -1,7 +1,6 @@
 #pragma once
 
 #include <Common.h>
-#include <Rendering/Common/UploadBuffer.h>
 #include <Rendering/Common/StructuredBuffer.h>
 
 using Microsoft::WRL::ComPtr;
@@ -13,7 +12,7 @@ struct RenderPassConstants;
 struct FrameResource final
 {
 public: 
-	FrameResource(ID3D12Device* device, UINT passCount, int16_t frameResourceIndex);
+	FrameResource(ID3D12Device* device, int16_t frameResourceIndex);
 	FrameResource(const FrameResource& other) = delete;
 	FrameResource& operator=(const FrameResource& other) = delete;
 	virtual ~FrameResource();
@@ -23,8 +22,10 @@ public:
 	// Command allocators - one for each frame, since we can't reset an allocator whilst commands are being processed
 	ComPtr<ID3D12CommandAllocator> CmdListAllocator;
 
-	// Each frame needs it's own cbuffers, since one can't be modified whilst being used by another frame
-	std::unique_ptr<UploadBuffer<RenderPassConstants>> PassConstantBuffer = nullptr;
+	// Each frame needs it's own cbuffers, since one can't be modified whilst being used by another frame.
+	// The pass constants are re-allocated from the renderer's upload ring every frame, the CBV descriptor is re-pointed at it.
+	D3D12_GPU_VIRTUAL_ADDRESS PassConstantBufferGPUAddress = 0;
+	int32_t PassConstantBufferHeapIndex = -1;
 	
 	// Fence value, marking commands up to this fence point. This let's us check if GPU has finished using these frame resources
 	UINT64 Fence = 0;
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// Platform independent sub-allocation of large GPU memory pages (heaps), no graphics API types in here.
+// Each page is split with a buddy allocator whose smallest block is the default resource placement alignment (64KiB),
+// blocks of size N are always N aligned, so larger alignment classes (eg: 4MiB for MSAA textures) come for free by rounding the block up.
+// Allocations are referred to through handles (slot index + generation) instead of offsets: a freed handle is never mistaken for
+// the allocation that reuses its slot.
+
+struct GPUMemoryHandle
+{
+	static constexpr uint32_t InvalidIndex = ~0u;
+
+	uint32_t Index = InvalidIndex;
+	uint32_t Generation = 0;
+
+	bool IsValid() const { return Index != InvalidIndex; }
+};
+
+struct GPUMemoryBlock
+{
+	uint32_t PageIndex = 0;
+	uint64_t Offset = 0;
+	uint64_t Size = 0; // Size of the buddy block, >= RequestedSize
+	uint64_t RequestedSize = 0;
+};
+
+struct GPUMemoryReport
+{
+	uint32_t PageCount = 0;
+	uint32_t AllocationCount = 0;
+	uint64_t ReservedBytes = 0;  // Sum of all pages
+	uint64_t AllocatedBytes = 0; // Sum of all buddy blocks handed out
+	uint64_t RequestedBytes = 0; // Sum of what callers asked for
+	uint64_t LargestFreeBlock = 0;
+
+	// Memory lost to rounding requests up to buddy block sizes
+	float InternalFragmentation() const
+	{
+		return AllocatedBytes > 0 ? 1.f - float(double(RequestedBytes) / double(AllocatedBytes)) : 0.f;
+	}
+
+	// 0 when all the free memory is a single block, tends to 1 when free memory is scattered in small blocks
+	float ExternalFragmentation() const
+	{
+		const uint64_t freeBytes = ReservedBytes - AllocatedBytes;
+		return freeBytes > 0 ? 1.f - float(double(LargestFreeBlock) / double(freeBytes)) : 0.f;
+	}
+};
+
+// Buddy allocator over a single page
+class BuddyBlockAllocator final
+{
+public:
+	static constexpr uint64_t InvalidOffset = ~0ull;
+
+	BuddyBlockAllocator(uint64_t pageSize, uint64_t minBlockSize)
+		: m_minBlockSize(minBlockSize)
+		, m_freeBytes(pageSize)
+	{
+		assert(IsPowerOf2(pageSize) && IsPowerOf2(minBlockSize) && pageSize >= minBlockSize);
+
+		uint32_t maxOrder = 0;
+		while ((minBlockSize << maxOrder) < pageSize)
+		{
+			++maxOrder;
+		}
+		m_freeBlocks.resize(maxOrder + 1);
+		m_freeBlocks[maxOrder].insert(0);
+	}
+
+	uint32_t GetMaxOrder() const { return uint32_t(m_freeBlocks.size() - 1); }
+	uint64_t GetBlockSize(uint32_t order) const { return m_minBlockSize << order; }
+	uint64_t GetFreeBytes() const { return m_freeBytes; }
+
+	// Smallest order whose blocks can hold byteSize with the requested alignment, or GetMaxOrder() + 1 if none can
+	uint32_t GetOrderForRequest(uint64_t byteSize, uint64_t alignment) const
+	{
+		const uint64_t requiredSize = byteSize > alignment ? byteSize : alignment;
+		uint32_t order = 0;
+		while (order <= GetMaxOrder() && GetBlockSize(order) < requiredSize)
+		{
+			++order;
+		}
+		return order;
+	}
+
+	uint64_t Allocate(uint32_t order)
+	{
+		if (order > GetMaxOrder())
+		{
+			return InvalidOffset;
+		}
+
+		// Find the smallest free block big enough, then split it down to the order we need
+		uint32_t foundOrder = order;
+		while (foundOrder <= GetMaxOrder() && m_freeBlocks[foundOrder].empty())
+		{
+			++foundOrder;
+		}
+		if (foundOrder > GetMaxOrder())
+		{
+			return InvalidOffset;
+		}
+
+		const uint64_t offset = *m_freeBlocks[foundOrder].begin();
+		m_freeBlocks[foundOrder].erase(m_freeBlocks[foundOrder].begin());
+		while (foundOrder > order)
+		{
+			--foundOrder;
+			// Keep the lower half, the upper half becomes a free buddy
+			m_freeBlocks[foundOrder].insert(offset + GetBlockSize(foundOrder));
+		}
+
+		m_freeBytes -= GetBlockSize(order);
+		return offset;
+	}
+
+	void Free(uint64_t offset, uint32_t order)
+	{
+		assert(order <= GetMaxOrder());
+		m_freeBytes += GetBlockSize(order);
+
+		// Merge with the buddy as long as it's free too
+		while (order < GetMaxOrder())
+		{
+			const uint64_t buddyOffset = offset ^ GetBlockSize(order);
+			auto buddyIt = m_freeBlocks[order].find(buddyOffset);
+			if (buddyIt == m_freeBlocks[order].end())
+			{
+				break;
+			}
+			m_freeBlocks[order].erase(buddyIt);
+			offset = offset < buddyOffset ? offset : buddyOffset;
+			++order;
+		}
+		m_freeBlocks[order].insert(offset);
+	}
+
+	uint64_t GetLargestFreeBlock() const
+	{
+		for (int32_t order = int32_t(GetMaxOrder()); order >= 0; --order)
+		{
+			if (!m_freeBlocks[order].empty())
+			{
+				return GetBlockSize(uint32_t(order));
+			}
+		}
+		return 0;
+	}
+
+	bool IsEmpty() const { return !m_freeBlocks[GetMaxOrder()].empty(); }
+
+private:
+	static bool IsPowerOf2(uint64_t value) { return value != 0 && (value & (value - 1)) == 0; }
+
+	uint64_t m_minBlockSize;
+	uint64_t m_freeBytes;
+	std::vector<std::set<uint64_t>> m_freeBlocks; // free block offsets, per order
+};
+
+// Pages of a single memory type + the handle table pointing into them
+class GPUMemorySubAllocator final
+{
+public:
+	static constexpr uint64_t DefaultAlignment = 64 * 1024;     // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+	static constexpr uint64_t MSAAAlignment = 4 * 1024 * 1024;  // D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+
+	explicit GPUMemorySubAllocator(uint64_t pageSize, uint64_t minBlockSize = DefaultAlignment)
+		: m_pageSize(pageSize)
+		, m_minBlockSize(minBlockSize)
+	{
+	}
+
+	uint64_t GetPageSize() const { return m_pageSize; }
+	uint32_t GetPageCount() const { return uint32_t(m_pages.size()); }
+
+	// Returns an invalid handle if the request can never fit in a page (the caller should fall back to a dedicated allocation).
+	// A new page is added when none of the existing ones has room, check GetPageCount() to back new pages with real memory.
+	GPUMemoryHandle Allocate(uint64_t byteSize, uint64_t alignment = DefaultAlignment)
+	{
+		assert(byteSize > 0);
+		if (byteSize > m_pageSize || alignment > m_pageSize)
+		{
+			return {};
+		}
+
+		for (uint32_t pageIndex = 0; pageIndex <= GetPageCount(); ++pageIndex)
+		{
+			if (pageIndex == GetPageCount())
+			{
+				m_pages.emplace_back(m_pageSize, m_minBlockSize);
+			}
+
+			BuddyBlockAllocator& page = m_pages[pageIndex];
+			const uint32_t order = page.GetOrderForRequest(byteSize, alignment);
+			const uint64_t offset = page.Allocate(order);
+			if (offset != BuddyBlockAllocator::InvalidOffset)
+			{
+				return AddSlot({ pageIndex, offset, page.GetBlockSize(order), byteSize }, order);
+			}
+		}
+
+		assert(false && "A fresh page should always fit a request smaller than the page size");
+		return {};
+	}
+
+	void Free(GPUMemoryHandle handle)
+	{
+		if (!IsAlive(handle))
+		{
+			assert(!handle.IsValid() && "Freeing a stale GPU memory handle");
+			return;
+		}
+
+		Slot& slot = m_slots[handle.Index];
+		m_pages[slot.Block.PageIndex].Free(slot.Block.Offset, slot.Order);
+		slot.Alive = false;
+		++slot.Generation;
+		m_freeSlots.push_back(handle.Index);
+	}
+
+	bool IsAlive(GPUMemoryHandle handle) const
+	{
+		return handle.IsValid()
+			&& handle.Index < m_slots.size()
+			&& m_slots[handle.Index].Alive
+			&& m_slots[handle.Index].Generation == handle.Generation;
+	}
+
+	const GPUMemoryBlock& GetBlock(GPUMemoryHandle handle) const
+	{
+		assert(IsAlive(handle));
+		return m_slots[handle.Index].Block;
+	}
+
+	// Index of a page that no longer has any allocation in it, or InvalidIndex
+	uint32_t FindEmptyPage() const
+	{
+		for (uint32_t pageIndex = 0; pageIndex < GetPageCount(); ++pageIndex)
+		{
+			if (m_pages[pageIndex].IsEmpty())
+			{
+				return pageIndex;
+			}
+		}
+		return GPUMemoryHandle::InvalidIndex;
+	}
+
+	GPUMemoryReport GetReport() const
+	{
+		GPUMemoryReport report;
+		report.PageCount = GetPageCount();
+		report.ReservedBytes = m_pageSize * m_pages.size();
+		for (const BuddyBlockAllocator& page : m_pages)
+		{
+			report.AllocatedBytes += m_pageSize - page.GetFreeBytes();
+			const uint64_t largestFreeBlock = page.GetLargestFreeBlock();
+			report.LargestFreeBlock = largestFreeBlock > report.LargestFreeBlock ? largestFreeBlock : report.LargestFreeBlock;
+		}
+		for (const Slot& slot : m_slots)
+		{
+			if (slot.Alive)
+			{
+				++report.AllocationCount;
+				report.RequestedBytes += slot.Block.RequestedSize;
+			}
+		}
+		return report;
+	}
+
+private:
+	struct Slot
+	{
+		GPUMemoryBlock Block;
+		uint32_t Order = 0;
+		uint32_t Generation = 0;
+		bool Alive = false;
+	};
+
+	GPUMemoryHandle AddSlot(const GPUMemoryBlock& block, uint32_t order)
+	{
+		uint32_t slotIndex;
+		if (!m_freeSlots.empty())
+		{
+			slotIndex = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slotIndex = uint32_t(m_slots.size());
+			m_slots.emplace_back();
+		}
+
+		Slot& slot = m_slots[slotIndex];
+		slot.Block = block;
+		slot.Order = order;
+		slot.Alive = true;
+		return { slotIndex, slot.Generation };
+	}
+
+	uint64_t m_pageSize;
+	uint64_t m_minBlockSize;
+	std::vector<BuddyBlockAllocator> m_pages;
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+};
@@ -2,6 +2,7 @@
 
 #include <Common.h>
 #include <Rendering/Common/VectorTypes.h>
+#include <Timing/FixedStepScheduler.h>
 
 struct FrameResource;
 class DescriptorHeap;
@@ -18,6 +19,7 @@ struct GPUPassUpdateData
 	float deltaTime;
 	int32_t frameIdxModulo;
 	ivec2 cursorScreenPos;
+	SimStepData simStep; // Fixed steps to simulate this frame, passes without a sim clock get a single step of deltaTime
 };
 
 class GPUPass
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <Common.h>
+#include <Rendering/Common/DescriptorHeap.h>
+#include <Rendering/Common/PlacedResourceAllocator.h>
+#include <Rendering/Common/RendererContext.h>
+#include <Rendering/Common/StructuredBuffer.h>
+
+using namespace Microsoft::WRL;
+using namespace DX;
+
+// What a GPU only buffer holds before its first use
+enum class GPUBufferInitialContent : uint8_t
+{
+	Uninitialised = 0, // Garbage, the GPU writes every element before reading it (eg: append buffers guarded by a counter)
+	ZeroFilled,        // Cleared with ClearUnorderedAccessViewUint on the init command list
+	ComputeFilled      // The owning pass dispatches its own fill kernel, see NeedsComputeFill()
+};
+
+// Structured buffer whose content only ever lives on the GPU: created from an element count,
+// without any CPU copy of the data nor any upload of initial content.
+template<typename T>
+class GPUStructuredBuffer : public IStructuredBuffer
+{
+public:
+	// initialState is the state the buffer is left in once Init has recorded its initialisation
+	GPUStructuredBuffer(
+		size_t elementCount,
+		GPUBufferInitialContent initialContent = GPUBufferInitialContent::Uninitialised,
+		D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+		: m_elementCount(UINT(elementCount))
+		, m_elementByteSize(sizeof(T))
+		, m_initialContent(initialContent)
+		, m_initialState(initialState)
+		, m_defaultBuffer()
+		, SrvIndex(-1)
+		, UavIndex(-1)
+		, m_clearUavIndex(-1)
+		, m_initialised(false)
+		, m_needsComputeFill(initialContent == GPUBufferInitialContent::ComputeFilled)
+	{
+		assert(elementCount > 0);
+		// The clear view is raw, which addresses the buffer in 4 bytes words
+		static_assert(sizeof(T) % 4 == 0, "GPU only structured buffer elements must be a multiple of 4 bytes");
+	}
+
+	virtual ~GPUStructuredBuffer()
+	{
+		if (m_resourceStates && m_defaultBuffer)
+		{
+			m_resourceStates->UnregisterResource(m_defaultBuffer.Get());
+		}
+	}
+
+	GPUStructuredBuffer(const GPUStructuredBuffer& rhs) = delete;
+	GPUStructuredBuffer& operator=(const GPUStructuredBuffer& rhs) = delete;
+
+	virtual void Init(RendererContext& rendererContext, std::wstring_view bufferName, bool needSRV, bool needUAV, bool viewsAreByteAddress = false) override
+	{
+		ID3D12Device* device = rendererContext.Device.Get();
+		DescriptorHeap& descriptorHeap = *rendererContext.GlobalCBVSRVUAVDescriptorHeap.lock();
+		DescriptorHeap& cpuDescriptorHeap = *rendererContext.CPUGlobalUAVDescriptorHeap.lock();
+
+		// UAV access is always allowed, clears go through a UAV even when the owner only reads the buffer through a SRV
+		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(GetByteSize(), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		m_defaultBuffer = m_defaultBufferMemory.CreateResource(
+			rendererContext.ResourceAllocator.lock(),
+			bufferDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		m_defaultBuffer->SetName(bufferName.data());
+
+		m_resourceStates = rendererContext.ResourceStates.lock().get();
+		m_resourceStates->RegisterResource(m_defaultBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+		m_initialised = true;
+
+		if (needSRV)
+		{
+			SrvIndex = descriptorHeap.GetCurrentDescriptorHeapHandle();
+			StructuredBufferViews::CreateSRV(device, Resource(), m_elementCount, m_elementByteSize, viewsAreByteAddress, descriptorHeap.GetCPUDescriptorHandleByIndex(SrvIndex));
+			descriptorHeap.IncreaseCurrentDescriptorHeapHandle();
+		}
+
+		if (needUAV)
+		{
+			UavIndex = descriptorHeap.GetCurrentDescriptorHeapHandle();
+			StructuredBufferViews::CreateUAV(device, Resource(), m_elementCount, m_elementByteSize, viewsAreByteAddress, descriptorHeap.GetCPUDescriptorHandleByIndex(UavIndex));
+			descriptorHeap.IncreaseCurrentDescriptorHeapHandle();
+		}
+
+		// ClearUnorderedAccessViewUint needs both a shader visible & a CPU only handle of a typed (or raw R32) view,
+		// structured views can't be cleared, so a raw one is kept at the same index in both heaps
+		m_clearUavIndex = descriptorHeap.GetCurrentDescriptorHeapHandle();
+		m_clearUavGPUHandle = descriptorHeap.GetGPUDescriptorHandleByIndex(m_clearUavIndex);
+		m_clearUavCPUHandle = cpuDescriptorHeap.GetCPUDescriptorHandleByIndex(m_clearUavIndex);
+		StructuredBufferViews::CreateUAV(device, Resource(), m_elementCount, m_elementByteSize, true, m_clearUavCPUHandle);
+		device->CopyDescriptorsSimple(1, descriptorHeap.GetCPUDescriptorHandleByIndex(m_clearUavIndex), m_clearUavCPUHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		descriptorHeap.IncreaseCurrentDescriptorHeapHandle();
+
+		if (m_initialContent == GPUBufferInitialContent::ZeroFilled)
+		{
+			Clear(rendererContext.CommandList.Get());
+		}
+
+		if (m_initialState != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+		{
+			DX::astro_assert(m_initialContent != GPUBufferInitialContent::ComputeFilled, "Compute filled buffers must start as UAVs for their fill kernel");
+			m_resourceStates->Transition(m_defaultBuffer.Get(), m_initialState);
+			m_resourceStates->FlushBarriers(rendererContext.CommandList.Get());
+		}
+	}
+
+	ID3D12Resource* Resource() const
+	{
+		assert(m_initialised);
+		return m_defaultBuffer.Get();
+	}
+
+	// Fills every 4 bytes word of the buffer with value, without any upload.
+	// Moves the buffer to UNORDERED_ACCESS if needed, the clear counts as a UAV write so the next UAV access gets its UAV barrier.
+	void Clear(ID3D12GraphicsCommandList* cmdList, uint32_t value = 0) const
+	{
+		assert(m_initialised);
+
+		m_resourceStates->UAVWrite(m_defaultBuffer.Get());
+		m_resourceStates->FlushBarriers(cmdList);
+
+		const UINT clearValues[4] = { value, value, value, value };
+		cmdList->ClearUnorderedAccessViewUint(
+			m_clearUavGPUHandle,
+			m_clearUavCPUHandle,
+			m_defaultBuffer.Get(),
+			clearValues,
+			0,
+			nullptr);
+	}
+
+	// ComputeFilled buffers: true until the owning pass has dispatched its fill kernel & called MarkComputeFilled()
+	bool NeedsComputeFill() const
+	{
+		return m_needsComputeFill;
+	}
+
+	void MarkComputeFilled()
+	{
+		m_needsComputeFill = false;
+	}
+
+	size_t GetElementCount() const
+	{
+		return m_elementCount;
+	}
+
+	UINT64 GetByteSize() const
+	{
+		return UINT64(m_elementCount) * m_elementByteSize;
+	}
+
+	// returns the descriptor index of an element in the descriptor heap this resource has a SRV for
+	int32_t GetSRVIndex() const
+	{
+		return SrvIndex;
+	}
+
+	// returns the descriptor index of an element in the descriptor heap this resource has a UAV for
+	int32_t GetUAVIndex() const
+	{
+		DX::astro_assert(UavIndex != -1, "UAV Index is invalid, UAV hasn't been initialised");
+
+		return UavIndex;
+	}
+
+private:
+	UINT m_elementCount;
+	UINT m_elementByteSize;
+	GPUBufferInitialContent m_initialContent;
+	D3D12_RESOURCE_STATES m_initialState;
+	PlacedResourceMemory m_defaultBufferMemory; // Declared before the resource so it outlives it
+	ComPtr<ID3D12Resource> m_defaultBuffer{ nullptr };
+	ResourceBarrierBatcher* m_resourceStates{ nullptr };
+
+	int32_t SrvIndex;
+	int32_t UavIndex;
+	int32_t m_clearUavIndex;
+	D3D12_GPU_DESCRIPTOR_HANDLE m_clearUavGPUHandle = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE m_clearUavCPUHandle = {};
+	bool m_initialised;
+	bool m_needsComputeFill;
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <Common.h>
+#include <array>
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Rendering/Common/GPUMemorySubAllocator.h>
+
+using namespace Microsoft::WRL;
+using namespace DX;
+
+// Heap tier 1 hardware can't mix buffers, render targets & other textures in the same heap, so each gets its own set of pages
+enum class PlacedResourceHeapCategory : uint8_t
+{
+	Buffers = 0,
+	RenderTargetTextures,
+	Textures,
+	Count
+};
+
+struct PlacedResourceHandle
+{
+	PlacedResourceHeapCategory HeapCategory = PlacedResourceHeapCategory::Count;
+	GPUMemoryHandle Memory;
+
+	// Invalid when the resource didn't fit in a page and was created as a committed resource instead
+	bool IsValid() const { return Memory.IsValid(); }
+};
+
+// Reserves large default heaps and places buffers & textures inside them, instead of one implicit heap per CreateCommittedResource.
+// Freed memory is tagged with the fence of the frame it's released in (FinishFrame) and handed out again once that fence completed (ReclaimCompleted),
+// the same way the upload ring recycles its memory: a new resource never lands on memory the GPU may still be reading.
+// Buffers smaller than 64KiB still take a whole block: they can't be placed at finer offsets, and sharing one resource between
+// several buffers would force them into the same resource state & views for the barrier tracker.
+class PlacedResourceAllocator final
+{
+public:
+	PlacedResourceAllocator(ID3D12Device* device, UINT64 heapByteSize)
+		: m_device(device)
+		, m_subAllocators{ GPUMemorySubAllocator(heapByteSize), GPUMemorySubAllocator(heapByteSize), GPUMemorySubAllocator(heapByteSize) }
+	{
+	}
+
+	PlacedResourceAllocator(const PlacedResourceAllocator& rhs) = delete;
+	PlacedResourceAllocator& operator=(const PlacedResourceAllocator& rhs) = delete;
+
+	// initCommandList is needed for render targets & depth stencils: placed ones start with undefined contents (including their compression metadata)
+	// and must be discarded before any other use, the discard is recorded on it before the resource is returned.
+	ComPtr<ID3D12Resource> CreateResource(
+		const D3D12_RESOURCE_DESC& resourceDesc,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* optimizedClearValue,
+		ID3D12GraphicsCommandList* initCommandList,
+		PlacedResourceHandle& outHandle)
+	{
+		const PlacedResourceHeapCategory heapCategory = GetHeapCategory(resourceDesc);
+		GPUMemorySubAllocator& subAllocator = m_subAllocators[size_t(heapCategory)];
+
+		// Size & alignment (64KiB, or 4MiB for MSAA) as the driver wants them for this resource
+		const D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = m_device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+
+		ComPtr<ID3D12Resource> resource;
+		outHandle = {};
+		outHandle.HeapCategory = heapCategory;
+		outHandle.Memory = subAllocator.Allocate(allocationInfo.SizeInBytes, allocationInfo.Alignment);
+		if (!outHandle.IsValid())
+		{
+			// Bigger than a whole heap, give it its own
+			const auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+			ThrowIfFailed(m_device->CreateCommittedResource(
+				&defaultHeapProps,
+				D3D12_HEAP_FLAG_NONE,
+				&resourceDesc,
+				initialState,
+				optimizedClearValue,
+				IID_PPV_ARGS(resource.GetAddressOf())));
+			return resource;
+		}
+
+		auto& heaps = m_heaps[size_t(heapCategory)];
+		while (heaps.size() < subAllocator.GetPageCount())
+		{
+			heaps.push_back(CreateHeap(heapCategory, subAllocator.GetPageSize()));
+		}
+
+		// DiscardResource needs render targets & depth stencils in their writable state
+		const bool needsDiscard = heapCategory == PlacedResourceHeapCategory::RenderTargetTextures;
+		const D3D12_RESOURCE_STATES placedState = needsDiscard ? GetWritableState(resourceDesc) : initialState;
+
+		const GPUMemoryBlock& block = subAllocator.GetBlock(outHandle.Memory);
+		ThrowIfFailed(m_device->CreatePlacedResource(
+			heaps[block.PageIndex].Get(),
+			block.Offset,
+			&resourceDesc,
+			placedState,
+			optimizedClearValue,
+			IID_PPV_ARGS(resource.GetAddressOf())));
+
+		if (needsDiscard)
+		{
+			assert(initCommandList && "Placed render targets & depth stencils must be discarded before their first use");
+			initCommandList->DiscardResource(resource.Get(), nullptr);
+			if (placedState != initialState)
+			{
+				// Not registered with the state tracker yet, it starts tracking from initialState
+				const auto barrierToInitialState = CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(), placedState, initialState);
+				initCommandList->ResourceBarrier(1, &barrierToInitialState);
+			}
+		}
+
+		return resource;
+	}
+
+	// The memory (and the resource, kept alive until then) is only reused once the fence of the frame being recorded completes
+	void Free(PlacedResourceHandle& handle, ComPtr<ID3D12Resource> resource = nullptr)
+	{
+		if (handle.IsValid() || resource)
+		{
+			m_pendingFrees.push_back({ handle, std::move(resource) });
+		}
+		handle = {};
+	}
+
+	// Everything freed since the last call may be in use by the GPU until fenceValue is signaled
+	void FinishFrame(UINT64 fenceValue)
+	{
+		for (PendingFree& pendingFree : m_pendingFrees)
+		{
+			m_retiredFrees.push_back({ fenceValue, std::move(pendingFree) });
+		}
+		m_pendingFrees.clear();
+	}
+
+	void ReclaimCompleted(UINT64 completedFenceValue)
+	{
+		while (!m_retiredFrees.empty() && m_retiredFrees.front().FenceValue <= completedFenceValue)
+		{
+			RetiredFree& retiredFree = m_retiredFrees.front();
+			// Resource first, its memory can't be reused while it exists
+			retiredFree.Free.Resource = nullptr;
+			if (retiredFree.Free.Handle.IsValid())
+			{
+				m_subAllocators[size_t(retiredFree.Free.Handle.HeapCategory)].Free(retiredFree.Free.Handle.Memory);
+			}
+			m_retiredFrees.pop_front();
+		}
+	}
+
+	GPUMemoryReport GetReport(PlacedResourceHeapCategory heapCategory) const
+	{
+		return m_subAllocators[size_t(heapCategory)].GetReport();
+	}
+
+	std::string GetFragmentationReport() const
+	{
+		static const char* CategoryNames[] = { "Buffers", "RenderTargetTextures", "Textures" };
+
+		std::string report = "Placed resource heaps:\n";
+		char retiredLine[64];
+		sprintf_s(retiredLine, "  waiting for their fence: %zu\n", m_pendingFrees.size() + m_retiredFrees.size());
+		report += retiredLine;
+		for (size_t categoryIdx = 0; categoryIdx < size_t(PlacedResourceHeapCategory::Count); ++categoryIdx)
+		{
+			const GPUMemoryReport categoryReport = m_subAllocators[categoryIdx].GetReport();
+			char line[256];
+			sprintf_s(line, "  %-20s heaps: %u allocations: %u reserved: %.1fMiB allocated: %.1fMiB requested: %.1fMiB largest free: %.1fMiB internal frag: %.1f%% external frag: %.1f%%\n",
+				CategoryNames[categoryIdx],
+				categoryReport.PageCount,
+				categoryReport.AllocationCount,
+				double(categoryReport.ReservedBytes) / (1024.0 * 1024.0),
+				double(categoryReport.AllocatedBytes) / (1024.0 * 1024.0),
+				double(categoryReport.RequestedBytes) / (1024.0 * 1024.0),
+				double(categoryReport.LargestFreeBlock) / (1024.0 * 1024.0),
+				categoryReport.InternalFragmentation() * 100.f,
+				categoryReport.ExternalFragmentation() * 100.f);
+			report += line;
+		}
+		return report;
+	}
+
+private:
+	static PlacedResourceHeapCategory GetHeapCategory(const D3D12_RESOURCE_DESC& resourceDesc)
+	{
+		if (resourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return PlacedResourceHeapCategory::Buffers;
+		}
+		if (resourceDesc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+		{
+			return PlacedResourceHeapCategory::RenderTargetTextures;
+		}
+		return PlacedResourceHeapCategory::Textures;
+	}
+
+	static D3D12_RESOURCE_STATES GetWritableState(const D3D12_RESOURCE_DESC& resourceDesc)
+	{
+		return (resourceDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) ? D3D12_RESOURCE_STATE_DEPTH_WRITE : D3D12_RESOURCE_STATE_RENDER_TARGET;
+	}
+
+	ComPtr<ID3D12Heap> CreateHeap(PlacedResourceHeapCategory heapCategory, UINT64 heapByteSize)
+	{
+		static const D3D12_HEAP_FLAGS CategoryHeapFlags[] = {
+			D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+			D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES
+		};
+
+		D3D12_HEAP_DESC heapDesc{};
+		heapDesc.SizeInBytes = heapByteSize;
+		heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		// Placing at the MSAA alignment lets any resource category land anywhere in the heap
+		heapDesc.Alignment = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = CategoryHeapFlags[size_t(heapCategory)];
+
+		ComPtr<ID3D12Heap> heap;
+		ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())));
+		return heap;
+	}
+
+	struct PendingFree
+	{
+		PlacedResourceHandle Handle;
+		ComPtr<ID3D12Resource> Resource;
+	};
+
+	struct RetiredFree
+	{
+		UINT64 FenceValue;
+		PendingFree Free;
+	};
+
+	ComPtr<ID3D12Device> m_device;
+	std::array<GPUMemorySubAllocator, size_t(PlacedResourceHeapCategory::Count)> m_subAllocators;
+	std::array<std::vector<ComPtr<ID3D12Heap>>, size_t(PlacedResourceHeapCategory::Count)> m_heaps;
+
+	std::vector<PendingFree> m_pendingFrees;
+	std::deque<RetiredFree> m_retiredFrees;
+};
+
+// Owned next to a placed resource, gives its memory back to the allocator when released or destroyed.
+// It holds a reference to the resource too, so both are retired together until the GPU is done with them.
+class PlacedResourceMemory final
+{
+public:
+	PlacedResourceMemory() = default;
+
+	~PlacedResourceMemory()
+	{
+		Release();
+	}
+
+	PlacedResourceMemory(const PlacedResourceMemory& rhs) = delete;
+	PlacedResourceMemory& operator=(const PlacedResourceMemory& rhs) = delete;
+
+	ComPtr<ID3D12Resource> CreateResource(
+		const std::shared_ptr<PlacedResourceAllocator>& allocator,
+		const D3D12_RESOURCE_DESC& resourceDesc,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* optimizedClearValue = nullptr,
+		ID3D12GraphicsCommandList* initCommandList = nullptr)
+	{
+		Release();
+		m_allocator = allocator;
+		m_resource = allocator->CreateResource(resourceDesc, initialState, optimizedClearValue, initCommandList, m_handle);
+		return m_resource;
+	}
+
+	void Release()
+	{
+		if (auto allocator = m_allocator.lock())
+		{
+			allocator->Free(m_handle, std::move(m_resource));
+		}
+		m_allocator.reset();
+		m_resource = nullptr;
+		m_handle = {};
+	}
+
+private:
+	std::weak_ptr<PlacedResourceAllocator> m_allocator;
+	ComPtr<ID3D12Resource> m_resource;
+	PlacedResourceHandle m_handle;
+};
@@ -20,11 +20,16 @@ void RenderTarget::Initialize(
 	m_format = format;
 	auto& renderContext = renderer->GetRendererContext();
 	m_renderTargetResource = AstroTools::Rendering::CreateRenderTarget(
-		renderContext.Device.Get(),
+		renderContext.ResourceAllocator.lock(),
+		m_renderTargetMemory,
+		renderContext.CommandList.Get(),
 		m_width, m_height, m_format, initialState);
 
 	m_renderTargetResource->SetName(name);
 
+	m_resourceStates = renderContext.ResourceStates.lock().get();
+	m_resourceStates->RegisterResource(m_renderTargetResource.Get(), initialState);
+
 	m_uavIndex = gpuVisibleDescriptorHeap.GetCurrentDescriptorHeapHandle();
 	
 	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc;
@@ -69,8 +74,14 @@ void RenderTarget::ReleaseResources()
 {
 	if (m_renderTargetResource)
 	{
+		if (m_resourceStates)
+		{
+			m_resourceStates->UnregisterResource(m_renderTargetResource.Get());
+		}
 		m_renderTargetResource = nullptr;
 	}
+	m_resourceStates = nullptr;
+	m_renderTargetMemory.Release();
 	m_uavIndex = -1;
 	m_srvIndex = -1;
 }
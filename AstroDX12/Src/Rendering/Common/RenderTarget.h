@@ -1,9 +1,11 @@
 #pragma once
 
 #include <Common.h>
+#include <Rendering/Common/PlacedResourceAllocator.h>
 
 class IRenderer;
 class DescriptorHeap;
+class ResourceBarrierBatcher;
 
 using Microsoft::WRL::ComPtr;
 
@@ -68,7 +70,9 @@ public:
 	}
 
 private:
+    PlacedResourceMemory m_renderTargetMemory; // Declared before the resource so it outlives it
     ComPtr<ID3D12Resource> m_renderTargetResource = nullptr;
+    ResourceBarrierBatcher* m_resourceStates = nullptr;
     UINT32 m_width = 0;
     UINT32 m_height = 0;
     DXGI_FORMAT m_format = DXGI_FORMAT_UNKNOWN;
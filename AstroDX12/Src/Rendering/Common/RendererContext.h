@@ -3,6 +3,9 @@
 #include <Common.h>
 #include <memory>
 #include <Rendering/Common/DescriptorHeap.h>
+#include <Rendering/Common/UploadRingBuffer.h>
+#include <Rendering/Common/PlacedResourceAllocator.h>
+#include <Rendering/Common/ResourceBarrierBatcher.h>
 
 using namespace Microsoft::WRL;
 
@@ -12,4 +15,8 @@ struct RendererContext final
     ComPtr<ID3D12GraphicsCommandList> CommandList;
     ComPtr<ID3D12CommandQueue> CommandQueue;
     std::weak_ptr<DescriptorHeap> GlobalCBVSRVUAVDescriptorHeap;
+    std::weak_ptr<DescriptorHeap> CPUGlobalUAVDescriptorHeap; // Same indices as the global heap, for APIs needing a CPU only handle (eg: UAV clears)
+    std::weak_ptr<UploadRingBuffer> UploadRing;
+    std::weak_ptr<PlacedResourceAllocator> ResourceAllocator;
+    std::weak_ptr<ResourceBarrierBatcher> ResourceStates;
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <Common.h>
+#include <Rendering/Common/UploadRingBuffer.h>
+#include <Rendering/Common/PlacedResourceAllocator.h>
+#include <Rendering/Common/ResourceBarrierBatcher.h>
 
 #include <DXC/d3d12shader.h>
 #include <DXC/dxcapi.h>
@@ -201,73 +204,50 @@ namespace AstroTools
 			return compiledShaderBlob;
 		}
 
+		// The buffer is registered with resourceStates & left readable (GENERIC_READ), the caller unregisters it before releasing it
 		static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
-			ID3D12Device* device,
+			const std::shared_ptr<PlacedResourceAllocator>& resourceAllocator,
+			PlacedResourceMemory& outResourceMemory,
 			ID3D12GraphicsCommandList* commandList,
+			ResourceBarrierBatcher& resourceStates,
 			const void* initData,
 			UINT64 byteSize,
 			bool enableUAVsupport,
 			std::wstring_view bufferName,
-			Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer
+			UploadRingBuffer& uploadRing
 		)
 		{
-			Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer;
-
-			// Create default buffer resource
-			auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+			// Create default buffer resource, placed in one of the allocator's default heaps
 			auto defaultHeapBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
 			if (enableUAVsupport)
 			{
 				defaultHeapBufferDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 			}
-			DX::ThrowIfFailed(device->CreateCommittedResource(
-				&defaultHeapProps,
-				D3D12_HEAP_FLAG_NONE,
-				&defaultHeapBufferDesc,
-				D3D12_RESOURCE_STATE_COMMON,
-				nullptr,
-				IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+			Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer = outResourceMemory.CreateResource(
+				resourceAllocator,
+				defaultHeapBufferDesc,
+				D3D12_RESOURCE_STATE_COMMON);
 			
 			defaultBuffer->SetName(bufferName.data());
-			// In order to copy CPU memory data into our default buffer, we need to create
-			// an intermediate upload heap. 
-			auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-			auto uploadHeapBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
-			DX::ThrowIfFailed(device->CreateCommittedResource(
-				&uploadHeapProps,
-				D3D12_HEAP_FLAG_NONE,
-				&uploadHeapBufferDesc,
-				D3D12_RESOURCE_STATE_GENERIC_READ,
-				nullptr,
-				IID_PPV_ARGS(uploadBuffer.GetAddressOf())));
-
-			// Describe the data we want to copy into the default buffer.
-			D3D12_SUBRESOURCE_DATA subResourceData = {};
-			subResourceData.pData = initData;
-			subResourceData.RowPitch = byteSize;
-			subResourceData.SlicePitch = subResourceData.RowPitch;
-
-			// Schedule to copy the data to the default buffer resource.  At a high level, the helper function UpdateSubresources
-			// will copy the CPU memory into the intermediate upload heap.  Then, using ID3D12CommandList::CopySubresourceRegion,
-			// the intermediate upload heap data will be copied to mBuffer.
-			auto barrierTransitionCommonToCopy = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
-				D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-			commandList->ResourceBarrier(1, &barrierTransitionCommonToCopy);
-			UpdateSubresources<1>(commandList, defaultBuffer.Get(), uploadBuffer.Get(), 0, 0, 1, &subResourceData);
-			auto barrierTransitionCopyToRead = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(),
-				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
-			commandList->ResourceBarrier(1, &barrierTransitionCopyToRead);
-
-			// Note: uploadBuffer has to be kept alive after the above function calls because
-			// the command list has not been executed yet that performs the actual copy.
-			// The caller can Release the uploadBuffer after it knows the copy has been executed.
 
+			// In order to copy CPU memory data into our default buffer, we stage it in the shared upload ring.
+			// The ring keeps that memory alive until the fence of the frame recording this copy has been passed by the GPU.
+			const UploadAllocation uploadAllocation = uploadRing.Allocate(byteSize);
+			memcpy(uploadAllocation.CPUAddress, initData, byteSize);
+
+			resourceStates.RegisterResource(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COMMON);
+			resourceStates.Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+			resourceStates.FlushBarriers(commandList);
+			commandList->CopyBufferRegion(defaultBuffer.Get(), 0, uploadAllocation.Resource, uploadAllocation.Offset, byteSize);
+			resourceStates.Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_GENERIC_READ);
+			resourceStates.FlushBarriers(commandList);
 
 			return defaultBuffer;
 		}
 
 		[[nodiscard]] static Microsoft::WRL::ComPtr<ID3D12Resource> CreateTexture3D(
-				ID3D12Device* device,
+				const std::shared_ptr<PlacedResourceAllocator>& resourceAllocator,
+				PlacedResourceMemory& outResourceMemory,
 				bool needUAV,
 				DXGI_FORMAT format,
 				int16_t width,
@@ -285,16 +265,10 @@ namespace AstroTools
 					defaultHeapBufferDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 				}
 
-				auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-
-				Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer;
-				DX::ThrowIfFailed(device->CreateCommittedResource(
-					&defaultHeapProps,
-					D3D12_HEAP_FLAG_NONE,
-					&defaultHeapBufferDesc,
-					initialResourceState,
-					nullptr,
-					IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+				Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer = outResourceMemory.CreateResource(
+					resourceAllocator,
+					defaultHeapBufferDesc,
+					initialResourceState);
 
 				// Upload heap not implemented for Texture3D (no need atm)
 
@@ -302,26 +276,24 @@ namespace AstroTools
 			}
 
 		[[nodiscard]] static Microsoft::WRL::ComPtr<ID3D12Resource> CreateRenderTarget(
-			ID3D12Device* device,
+			const std::shared_ptr<PlacedResourceAllocator>& resourceAllocator,
+			PlacedResourceMemory& outResourceMemory,
+			ID3D12GraphicsCommandList* commandList,
 			UINT64 width,
 			UINT64 height,
 			DXGI_FORMAT format,
 			D3D12_RESOURCE_STATES initialState
 		)
 		{
-			Microsoft::WRL::ComPtr<ID3D12Resource> renderTargetResource;
-
-			// Create default buffer resource
-			auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+			// Create default buffer resource, discarded on commandList before its first use
 			auto bufferDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, (UINT)height);
 			bufferDesc.Flags = (D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
-			DX::ThrowIfFailed(device->CreateCommittedResource(
-				&defaultHeapProps,
-				D3D12_HEAP_FLAG_NONE,
-				&bufferDesc,
+			Microsoft::WRL::ComPtr<ID3D12Resource> renderTargetResource = outResourceMemory.CreateResource(
+				resourceAllocator,
+				bufferDesc,
 				initialState,
 				nullptr,
-				IID_PPV_ARGS(renderTargetResource.GetAddressOf())));
+				commandList);
 
 			return renderTargetResource;
 		}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Common.h>
+#include <vector>
+#include <Rendering/Common/ResourceStateTracker.h>
+
+using namespace Microsoft::WRL;
+
+static_assert(ResourceStateBits::UnorderedAccess == D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+	&& ResourceStateBits::NonPixelShaderResource == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE
+	&& ResourceStateBits::PixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE
+	&& ResourceStateBits::IndirectArgument == D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT
+	&& ResourceStateBits::CopyDest == D3D12_RESOURCE_STATE_COPY_DEST
+	&& ResourceStateBits::CopySource == D3D12_RESOURCE_STATE_COPY_SOURCE
+	&& ResourceStateBits::RenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET
+	&& ResourceStateBits::DepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE,
+	"Resource state tracker bits must match D3D12_RESOURCE_STATES");
+static_assert(ResourceStateTracker::AllSubresources == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+// Tracks the state of every resource created through the renderer, for the frame's command list.
+// Passes ask for the states they need right before each dispatch/draw/copy, then FlushBarriers submits whatever is needed in one ResourceBarrier call.
+class ResourceBarrierBatcher final
+{
+public:
+	void RegisterResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES initialState, UINT subresourceCount = 1)
+	{
+		m_tracker.RegisterResource(resource, uint32_t(initialState), subresourceCount);
+	}
+
+	void UnregisterResource(ID3D12Resource* resource)
+	{
+		m_tracker.UnregisterResource(resource);
+	}
+
+	D3D12_RESOURCE_STATES GetState(ID3D12Resource* resource, UINT subresource = 0) const
+	{
+		return D3D12_RESOURCE_STATES(m_tracker.GetState(resource, subresource));
+	}
+
+	void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES state, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		m_tracker.TransitionResource(resource, uint32_t(state), subresource);
+	}
+
+	void UAVRead(ID3D12Resource* resource)
+	{
+		m_tracker.UAVRead(resource);
+	}
+
+	void UAVWrite(ID3D12Resource* resource)
+	{
+		m_tracker.UAVWrite(resource);
+	}
+
+	// Call right before the dispatch/draw/copy/clear the requests were made for
+	void FlushBarriers(ID3D12GraphicsCommandList* cmdList)
+	{
+		const std::vector<ResourceBarrierDesc> barrierDescs = m_tracker.FlushBarriers();
+		if (barrierDescs.empty())
+		{
+			return;
+		}
+
+		m_barriers.clear();
+		for (const ResourceBarrierDesc& barrierDesc : barrierDescs)
+		{
+			ID3D12Resource* resource = static_cast<ID3D12Resource*>(const_cast<void*>(barrierDesc.Resource));
+			if (barrierDesc.Type == ResourceBarrierDesc::BarrierType::UAV)
+			{
+				m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+			}
+			else
+			{
+				m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+					resource,
+					D3D12_RESOURCE_STATES(barrierDesc.StateBefore),
+					D3D12_RESOURCE_STATES(barrierDesc.StateAfter),
+					barrierDesc.Subresource));
+			}
+		}
+		cmdList->ResourceBarrier((UINT)m_barriers.size(), m_barriers.data());
+	}
+
+	void OnCommandListExecuted()
+	{
+		m_tracker.OnCommandListExecuted();
+	}
+
+	const ResourceStateTrackerStats& GetStats() const
+	{
+		return m_tracker.GetStats();
+	}
+
+private:
+	ResourceStateTracker m_tracker;
+	std::vector<CD3DX12_RESOURCE_BARRIER> m_barriers; // Kept between flushes to avoid re-allocating every batch
+};
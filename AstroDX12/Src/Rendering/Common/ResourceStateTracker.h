@@ -0,0 +1,405 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Platform independent bookkeeping of resource states & the barriers needed to move between them, no graphics API types in here.
+// Resources are identified by an opaque key (the API resource pointer), states are bitmasks using the D3D12_RESOURCE_STATES values
+// (the API layer checks they match), so recorded pass sequences can be replayed on the CPU to check which barriers come out.
+//
+// - Each resource knows its current state, per subresource, so callers only ask for the state they need next.
+// - Requests for the state a resource is already in are dropped, read only states are combined instead of ping-ponging between them.
+// - Barriers are only queued, then handed out all at once by FlushBarriers() right before the next dispatch/draw/copy.
+//   Transitions of the same subresource queued back to back are merged into one (and dropped if they end up where they started).
+// - UAV barriers are only added when a UAV is accessed again after a previous dispatch wrote to it (read/write after write),
+//   a transition out of the UAV state already orders the accesses.
+namespace ResourceStateBits
+{
+	constexpr uint32_t Common = 0;
+	constexpr uint32_t VertexAndConstantBuffer = 0x1;
+	constexpr uint32_t IndexBuffer = 0x2;
+	constexpr uint32_t RenderTarget = 0x4;
+	constexpr uint32_t UnorderedAccess = 0x8;
+	constexpr uint32_t DepthWrite = 0x10;
+	constexpr uint32_t DepthRead = 0x20;
+	constexpr uint32_t NonPixelShaderResource = 0x40;
+	constexpr uint32_t PixelShaderResource = 0x80;
+	constexpr uint32_t StreamOut = 0x100;
+	constexpr uint32_t IndirectArgument = 0x200;
+	constexpr uint32_t CopyDest = 0x400;
+	constexpr uint32_t CopySource = 0x800;
+	constexpr uint32_t ResolveDest = 0x1000;
+	constexpr uint32_t ResolveSource = 0x2000;
+
+	// States which can't be combined with any other one
+	constexpr uint32_t WriteMask = RenderTarget | UnorderedAccess | DepthWrite | StreamOut | CopyDest | ResolveDest;
+
+	constexpr bool IsReadOnly(uint32_t state)
+	{
+		return state != Common && (state & WriteMask) == 0;
+	}
+}
+
+struct ResourceBarrierDesc
+{
+	enum class BarrierType : uint8_t
+	{
+		Transition,
+		UAV
+	};
+
+	BarrierType Type = BarrierType::Transition;
+	const void* Resource = nullptr;
+	uint32_t Subresource = 0;
+	uint32_t StateBefore = 0;
+	uint32_t StateAfter = 0;
+};
+
+struct ResourceStateTrackerStats
+{
+	uint32_t RequestedTransitions = 0; // Every state request made, redundant or not
+	uint32_t DroppedTransitions = 0;   // Requests which didn't need a barrier, or were merged away
+	uint32_t TransitionBarriers = 0;
+	uint32_t UAVBarriers = 0;
+	uint32_t BarrierBatches = 0;       // Flushes which had at least one barrier to submit
+};
+
+class ResourceStateTracker final
+{
+public:
+	static constexpr uint32_t AllSubresources = 0xffffffff; // D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES
+
+	void RegisterResource(const void* resource, uint32_t initialState, uint32_t subresourceCount = 1)
+	{
+		assert(resource != nullptr && subresourceCount > 0);
+		TrackedResource& trackedResource = m_resources[resource];
+		trackedResource.SubresourceStates.assign(subresourceCount, initialState);
+		trackedResource.Uniform = true;
+	}
+
+	// Drops the resource and anything still queued for it, must be called before the resource memory can be reused
+	void UnregisterResource(const void* resource)
+	{
+		m_resources.erase(resource);
+		m_unsyncedWrites.erase(resource);
+		m_pendingWrites.erase(resource);
+		std::erase(m_pendingUAVAccesses, resource);
+
+		std::vector<ResourceBarrierDesc> remainingBarriers;
+		for (const ResourceBarrierDesc& barrier : m_pendingBarriers)
+		{
+			if (barrier.Resource != resource)
+			{
+				remainingBarriers.push_back(barrier);
+			}
+		}
+		m_pendingBarriers = std::move(remainingBarriers);
+		RebuildLastPendingIndices();
+	}
+
+	bool IsRegistered(const void* resource) const
+	{
+		return m_resources.find(resource) != m_resources.end();
+	}
+
+	// State the resource will be in once the queued barriers are flushed
+	uint32_t GetState(const void* resource, uint32_t subresource = 0) const
+	{
+		const TrackedResource& trackedResource = GetTrackedResource(resource);
+		return trackedResource.SubresourceStates[subresource == AllSubresources ? 0 : subresource];
+	}
+
+	void TransitionResource(const void* resource, uint32_t state, uint32_t subresource = AllSubresources)
+	{
+		TrackedResource& trackedResource = GetTrackedResource(resource);
+		if (subresource == AllSubresources)
+		{
+			if (trackedResource.Uniform)
+			{
+				TransitionSubresource(resource, trackedResource, AllSubresources, state);
+			}
+			else
+			{
+				for (uint32_t subresourceIdx = 0; subresourceIdx < trackedResource.SubresourceStates.size(); ++subresourceIdx)
+				{
+					TransitionSubresource(resource, trackedResource, subresourceIdx, state);
+				}
+				// Read states are combined per subresource, they may still differ
+				trackedResource.Uniform = std::all_of(trackedResource.SubresourceStates.begin(), trackedResource.SubresourceStates.end(), [&](uint32_t subresourceState)
+				{
+					return subresourceState == trackedResource.SubresourceStates[0];
+				});
+				if (trackedResource.Uniform)
+				{
+					CollapsePendingSubresourceBarriers(resource, trackedResource);
+				}
+			}
+			return;
+		}
+
+		assert(subresource < trackedResource.SubresourceStates.size());
+		if (trackedResource.SubresourceStates.size() == 1)
+		{
+			TransitionSubresource(resource, trackedResource, AllSubresources, state);
+			return;
+		}
+		trackedResource.Uniform = false;
+		TransitionSubresource(resource, trackedResource, subresource, state);
+	}
+
+	// The next dispatch reads the resource through a UAV
+	void UAVRead(const void* resource)
+	{
+		RequireUAV(resource);
+	}
+
+	// The next dispatch (or clear) writes the resource through a UAV
+	void UAVWrite(const void* resource)
+	{
+		RequireUAV(resource);
+		m_pendingWrites.insert(resource);
+	}
+
+	bool HasPendingBarriers() const
+	{
+		return !m_pendingBarriers.empty();
+	}
+
+	// Barriers to submit, in a single call, before the work which made the requests since the previous flush.
+	// UAV writes requested since the previous flush become hazards for the following work.
+	std::vector<ResourceBarrierDesc> FlushBarriers()
+	{
+		std::vector<ResourceBarrierDesc> barriers;
+		barriers.reserve(m_pendingBarriers.size());
+		for (const ResourceBarrierDesc& barrier : m_pendingBarriers)
+		{
+			if (barrier.StateBefore == barrier.StateAfter)
+			{
+				// Merged into a round trip, nothing left to do
+				++m_stats.DroppedTransitions;
+				continue;
+			}
+
+			// A transition waits for all previous accesses of the resource, including UAV writes
+			m_unsyncedWrites.erase(barrier.Resource);
+			++m_stats.TransitionBarriers;
+			barriers.push_back(barrier);
+		}
+
+		// Resources accessed as UAVs again, after a previous dispatch wrote to them without any transition since
+		for (const void* resource : m_pendingUAVAccesses)
+		{
+			auto unsyncedWriteIt = m_unsyncedWrites.find(resource);
+			if (unsyncedWriteIt != m_unsyncedWrites.end())
+			{
+				m_unsyncedWrites.erase(unsyncedWriteIt);
+
+				ResourceBarrierDesc barrier;
+				barrier.Type = ResourceBarrierDesc::BarrierType::UAV;
+				barrier.Resource = resource;
+				++m_stats.UAVBarriers;
+				barriers.push_back(barrier);
+			}
+		}
+
+		m_pendingBarriers.clear();
+		m_lastPendingIndex.clear();
+		m_pendingUAVAccesses.clear();
+
+		m_unsyncedWrites.insert(m_pendingWrites.begin(), m_pendingWrites.end());
+		m_pendingWrites.clear();
+
+		if (!barriers.empty())
+		{
+			++m_stats.BarrierBatches;
+		}
+		return barriers;
+	}
+
+	// Work submitted in separate command list executions is ordered by the queue, no UAV hazard carries over
+	void OnCommandListExecuted()
+	{
+		assert(m_pendingBarriers.empty() && "Barriers were requested but never flushed");
+		m_unsyncedWrites.clear();
+		m_pendingWrites.clear();
+		m_pendingUAVAccesses.clear();
+	}
+
+	const ResourceStateTrackerStats& GetStats() const
+	{
+		return m_stats;
+	}
+
+	void ResetStats()
+	{
+		m_stats = {};
+	}
+
+private:
+	struct TrackedResource
+	{
+		std::vector<uint32_t> SubresourceStates;
+		bool Uniform = true; // All subresources share the same state, transitions can target the whole resource at once
+	};
+
+	TrackedResource& GetTrackedResource(const void* resource)
+	{
+		auto it = m_resources.find(resource);
+		assert(it != m_resources.end() && "Resource isn't registered with the state tracker");
+		return it->second;
+	}
+
+	const TrackedResource& GetTrackedResource(const void* resource) const
+	{
+		auto it = m_resources.find(resource);
+		assert(it != m_resources.end() && "Resource isn't registered with the state tracker");
+		return it->second;
+	}
+
+	void RequireUAV(const void* resource)
+	{
+		TransitionResource(resource, ResourceStateBits::UnorderedAccess);
+		if (std::find(m_pendingUAVAccesses.begin(), m_pendingUAVAccesses.end(), resource) == m_pendingUAVAccesses.end())
+		{
+			m_pendingUAVAccesses.push_back(resource);
+		}
+	}
+
+	void TransitionSubresource(const void* resource, TrackedResource& trackedResource, uint32_t subresource, uint32_t requestedState)
+	{
+		++m_stats.RequestedTransitions;
+
+		const uint32_t stateIndex = subresource == AllSubresources ? 0 : subresource;
+		const uint32_t currentState = trackedResource.SubresourceStates[stateIndex];
+
+		uint32_t newState = requestedState;
+		if (ResourceStateBits::IsReadOnly(currentState) && ResourceStateBits::IsReadOnly(requestedState))
+		{
+			if ((currentState & requestedState) == requestedState)
+			{
+				// Already readable the way it's going to be read
+				++m_stats.DroppedTransitions;
+				return;
+			}
+			// Keep the previous read states too, the next reader is likely to be the previous one again
+			newState = currentState | requestedState;
+		}
+		else if (currentState == requestedState)
+		{
+			++m_stats.DroppedTransitions;
+			return;
+		}
+
+		if (subresource == AllSubresources)
+		{
+			for (uint32_t& subresourceState : trackedResource.SubresourceStates)
+			{
+				subresourceState = newState;
+			}
+		}
+		else
+		{
+			trackedResource.SubresourceStates[subresource] = newState;
+		}
+
+		// Merge with the previous queued barrier of this resource when it targets the same subresource(s),
+		// anything queued in between for the resource would have to execute first, so only the last one is merged with
+		auto lastPendingIt = m_lastPendingIndex.find(resource);
+		if (lastPendingIt != m_lastPendingIndex.end())
+		{
+			ResourceBarrierDesc& lastBarrier = m_pendingBarriers[lastPendingIt->second];
+			if (lastBarrier.Subresource == subresource)
+			{
+				lastBarrier.StateAfter = newState;
+				++m_stats.DroppedTransitions;
+				return;
+			}
+		}
+
+		ResourceBarrierDesc barrier;
+		barrier.Type = ResourceBarrierDesc::BarrierType::Transition;
+		barrier.Resource = resource;
+		barrier.Subresource = subresource;
+		barrier.StateBefore = currentState;
+		barrier.StateAfter = newState;
+		AddPendingBarrier(barrier);
+	}
+
+	// The resource ends up in a single state: when its subresources also started the batch from a single state,
+	// its queued barriers (per subresource, or all subresources) are replaced by one all subresources barrier.
+	// Nothing executes between the barriers of a batch, so the intermediate states don't matter.
+	void CollapsePendingSubresourceBarriers(const void* resource, const TrackedResource& trackedResource)
+	{
+		// State each subresource was in before its first queued barrier
+		std::vector<uint32_t> statesBefore = trackedResource.SubresourceStates;
+		size_t pendingBarrierCount = 0;
+		for (auto barrierIt = m_pendingBarriers.rbegin(); barrierIt != m_pendingBarriers.rend(); ++barrierIt)
+		{
+			if (barrierIt->Resource != resource)
+			{
+				continue;
+			}
+			++pendingBarrierCount;
+			if (barrierIt->Subresource == AllSubresources)
+			{
+				std::fill(statesBefore.begin(), statesBefore.end(), barrierIt->StateBefore);
+			}
+			else
+			{
+				statesBefore[barrierIt->Subresource] = barrierIt->StateBefore;
+			}
+		}
+
+		const bool uniformStatesBefore = std::all_of(statesBefore.begin(), statesBefore.end(), [&](uint32_t stateBefore)
+		{
+			return stateBefore == statesBefore[0];
+		});
+		if (pendingBarrierCount < 2 || !uniformStatesBefore)
+		{
+			return;
+		}
+
+		std::erase_if(m_pendingBarriers, [resource](const ResourceBarrierDesc& barrier)
+		{
+			return barrier.Resource == resource;
+		});
+		RebuildLastPendingIndices();
+		m_stats.DroppedTransitions += uint32_t(pendingBarrierCount - 1);
+
+		ResourceBarrierDesc barrier;
+		barrier.Type = ResourceBarrierDesc::BarrierType::Transition;
+		barrier.Resource = resource;
+		barrier.Subresource = AllSubresources;
+		barrier.StateBefore = statesBefore[0];
+		barrier.StateAfter = trackedResource.SubresourceStates[0];
+		AddPendingBarrier(barrier);
+	}
+
+	void AddPendingBarrier(const ResourceBarrierDesc& barrier)
+	{
+		m_lastPendingIndex[barrier.Resource] = m_pendingBarriers.size();
+		m_pendingBarriers.push_back(barrier);
+	}
+
+	void RebuildLastPendingIndices()
+	{
+		m_lastPendingIndex.clear();
+		for (size_t barrierIdx = 0; barrierIdx < m_pendingBarriers.size(); ++barrierIdx)
+		{
+			m_lastPendingIndex[m_pendingBarriers[barrierIdx].Resource] = barrierIdx;
+		}
+	}
+
+	std::unordered_map<const void*, TrackedResource> m_resources;
+	std::vector<ResourceBarrierDesc> m_pendingBarriers; // Transitions only, UAV barriers are decided when flushing
+	std::unordered_map<const void*, size_t> m_lastPendingIndex; // Per resource, index of its last barrier in m_pendingBarriers
+	std::vector<const void*> m_pendingUAVAccesses;        // UAV reads & writes of the work about to be submitted, in request order
+	std::unordered_set<const void*> m_pendingWrites;      // UAV writes of the work about to be submitted
+	std::unordered_set<const void*> m_unsyncedWrites;     // UAV writes of submitted work, not yet ordered with later accesses
+	ResourceStateTrackerStats m_stats;
+};
@@ -0,0 +1,846 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <Simulation/ParallelPrimitives.h>
+
+// SDF scene raymarching, CPU reference of Shaders/RaymarchScene.hlsl. The scene is the smooth union of spheres, in view space here.
+// The union is blended in scene order from MaxBlendedDistance, an object further than SupportRadius from a point doesn't change it:
+// the field is local, each point's value only depends on the objects whose sphere inflated by SupportRadius it's in.
+// Tile binning, so rays only evaluate the objects around them:
+// - The screen is split into tiles, the view depth into exponential slices. A cell is a tile's slice.
+// - ComputeObjectBounds: the cells an object's inflated sphere overlaps
+// - TileBins::Bin: per cell, the overlapping objects in scene order. smin isn't associative, the order keeps the full loop's blending.
+//   The cells' lists are packed in a pool of MeanCellCapacity objects per cell: counted, scanned into offsets & filled.
+//   Objects whose cells don't fit in the pool anymore aren't binned, the last ones in scene order first, every cell agrees.
+// - MarchBinned: rays walk their tile's cells front to back, only evaluate the current cell's objects & never step past its far depth.
+//   A cell lists every object that changes the field in it: below MaxBlendedDistance, its field is the full loop's bit for bit.
+//   Further from any surface it's the same or larger, capped by the cell's far depth: the rays take other steps there, & reach
+//   the same surfaces within their last step's MinDistForCollision unless one of the marches runs out of steps.
+namespace SDFRaymarch
+{
+	constexpr uint32_t TileSize = 32; // SDF_TILE_SIZE, pixels
+	constexpr uint32_t DepthSliceCount = 16; // SDF_DEPTH_SLICE_COUNT
+	constexpr uint32_t MeanCellCapacity = 64; // SDF_MEAN_CELL_CAPACITY, the cell lists' pool holds this many objects per cell
+	constexpr float BlendRadius = 15.f; // SDF_BLEND_RADIUS, smin's k
+	constexpr float MaxBlendedDistance = 5.f; // SDF_MAX_BLENDED_DISTANCE, the smooth union's start: objects further than it + BlendRadius don't change it
+	constexpr float SupportRadius = MaxBlendedDistance + BlendRadius; // Around an object's surface, where it takes part in the blend
+	constexpr uint32_t MaxStepCount = 100;
+	constexpr uint32_t MaxBinnedStepCount = MaxStepCount + DepthSliceCount; // Entering the next slice takes a step, one per slice on top
+	constexpr float MaxDistancePerStep = 30.f;
+	constexpr float MinDistForCollision = 0.0001f;
+	constexpr uint32_t ConeBlockSize = 8; // SDF_CONE_BLOCK_SIZE, pixels per side of a cone march's block
+	static_assert(TileSize % ConeBlockSize == 0, "A cone's rays must share their tile's cells");
+
+	// A sphere, the alive particles' position & size
+	struct Object
+	{
+		float Pos[3] = {};
+		float Size = 1.f;
+	};
+
+	// A perspective camera looking down +z, the projection's terms RaymarchScene.hlsl's rays & bounds depend on
+	struct Camera
+	{
+		float ProjScaleX = 1.f; // proj[0][0]
+		float ProjScaleY = 1.f; // proj[1][1]
+		float NearZ = 1.f;
+		float FarZ = 1000.f;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+
+		uint32_t GetTileCountX() const { return (Width + TileSize - 1) / TileSize; }
+		uint32_t GetTileCountY() const { return (Height + TileSize - 1) / TileSize; }
+		uint32_t GetCellCount() const { return GetTileCountX() * GetTileCountY() * DepthSliceCount; }
+
+		// A tile's slices are contiguous, its rays walk them in order
+		uint32_t GetCellIdx(uint32_t tileX, uint32_t tileY, uint32_t slice) const
+		{
+			return (tileX + GetTileCountX() * tileY) * DepthSliceCount + slice;
+		}
+
+		// Slice 0 starts at the eye, the last one ends at the far plane
+		uint32_t GetDepthSlice(float viewZ) const
+		{
+			if (viewZ <= NearZ)
+			{
+				return 0;
+			}
+			const float slice = std::log(viewZ / NearZ) * (float(DepthSliceCount) / std::log(FarZ / NearZ));
+			return std::min(uint32_t(slice), DepthSliceCount - 1);
+		}
+
+		float GetDepthSliceEnd(uint32_t slice) const
+		{
+			return NearZ * std::pow(FarZ / NearZ, float(slice + 1) / float(DepthSliceCount));
+		}
+
+		// Through the pixel's center, normalised
+		void GetRayDir(uint32_t x, uint32_t y, float outDir[3]) const
+		{
+			GetRayDirAt(float(x) + 0.5f, float(y) + 0.5f, outDir);
+		}
+
+		// Through a position in pixels, pixel p's center is p + 0.5
+		void GetRayDirAt(float pixelX, float pixelY, float outDir[3]) const
+		{
+			const float ndcX = (pixelX / float(Width)) * 2.f - 1.f;
+			const float ndcY = (pixelY / float(Height)) * 2.f - 1.f;
+			outDir[0] = ndcX / ProjScaleX;
+			outDir[1] = ndcY / ProjScaleY;
+			outDir[2] = 1.f;
+			const float invLength = 1.f / std::sqrt(outDir[0] * outDir[0] + outDir[1] * outDir[1] + 1.f);
+			outDir[0] *= invLength;
+			outDir[1] *= invLength;
+			outDir[2] *= invLength;
+		}
+	};
+
+	// The cells an object overlaps: a rectangle of tiles & a range of slices. Packed into a uint2 on the GPU.
+	struct ObjectBounds
+	{
+		uint32_t TileMin[2] = {};
+		uint32_t TileMax[2] = {};
+		uint32_t SliceMin = 0;
+		uint32_t SliceMax = 0;
+		bool IsVisible = false;
+
+		bool Overlaps(uint32_t tileX, uint32_t tileY, uint32_t slice) const
+		{
+			return IsVisible
+				&& tileX >= TileMin[0] && tileX <= TileMax[0]
+				&& tileY >= TileMin[1] && tileY <= TileMax[1]
+				&& slice >= SliceMin && slice <= SliceMax;
+		}
+
+		// The entries of the cell lists the object takes
+		uint32_t GetCellCount() const
+		{
+			return IsVisible ? (TileMax[0] - TileMin[0] + 1) * (TileMax[1] - TileMin[1] + 1) * (SliceMax - SliceMin + 1) : 0;
+		}
+	};
+
+	// The view space box around the inflated sphere, projected: x / z & y / z are extremal at its corners
+	inline ObjectBounds ComputeObjectBounds(const Camera& camera, const Object& object)
+	{
+		ObjectBounds bounds;
+		const float radius = object.Size + SupportRadius;
+		const float minZ = object.Pos[2] - radius;
+		const float maxZ = object.Pos[2] + radius;
+		if (maxZ <= 0.f || minZ >= camera.FarZ)
+		{
+			return bounds;
+		}
+
+		const uint32_t tileCount[2] = { camera.GetTileCountX(), camera.GetTileCountY() };
+		const uint32_t pixelCount[2] = { camera.Width, camera.Height };
+		const float projScale[2] = { camera.ProjScaleX, camera.ProjScaleY };
+		for (uint32_t axis = 0; axis < 2; ++axis)
+		{
+			// Around or behind the eye, it can cover any pixel
+			float minNdc = -1.f;
+			float maxNdc = 1.f;
+			if (minZ > 0.001f)
+			{
+				const float low = (object.Pos[axis] - radius) * projScale[axis];
+				const float high = (object.Pos[axis] + radius) * projScale[axis];
+				minNdc = std::min(low / minZ, low / maxZ);
+				maxNdc = std::max(high / minZ, high / maxZ);
+			}
+			if (maxNdc < -1.f || minNdc > 1.f)
+			{
+				return bounds;
+			}
+
+			// Pixel (p, ...)'s ray goes through p + 0.5, in tile p / TileSize
+			const float maxTile = float(tileCount[axis] - 1);
+			const float minPixel = (minNdc * 0.5f + 0.5f) * float(pixelCount[axis]);
+			const float maxPixel = (maxNdc * 0.5f + 0.5f) * float(pixelCount[axis]);
+			bounds.TileMin[axis] = uint32_t(std::clamp(std::floor(minPixel / float(TileSize)), 0.f, maxTile));
+			bounds.TileMax[axis] = uint32_t(std::clamp(std::floor(maxPixel / float(TileSize)), 0.f, maxTile));
+		}
+
+		// A margin for the slices' rounding, the march's slice ends & GetDepthSlice don't round alike
+		bounds.SliceMin = camera.GetDepthSlice(std::max(minZ, 0.f) * 0.999f);
+		bounds.SliceMax = camera.GetDepthSlice(maxZ * 1.001f);
+		bounds.IsVisible = true;
+		return bounds;
+	}
+
+	// The first count objects overlapping the cell. A GPU thread per cell, the objects' bounds staged in groupshared memory.
+	inline uint32_t CountCellObjects(const ObjectBounds* bounds, uint32_t count, uint32_t tileX, uint32_t tileY, uint32_t slice)
+	{
+		uint32_t cellObjectCount = 0;
+		for (uint32_t objectIdx = 0; objectIdx < count; ++objectIdx)
+		{
+			cellObjectCount += bounds[objectIdx].Overlaps(tileX, tileY, slice) ? 1 : 0;
+		}
+		return cellObjectCount;
+	}
+
+	// outObjects gets the first count objects overlapping the cell, in order: CountCellObjects of them
+	inline void BinCell(const ObjectBounds* bounds, uint32_t count, uint32_t tileX, uint32_t tileY, uint32_t slice, uint32_t* outObjects)
+	{
+		uint32_t cellObjectCount = 0;
+		for (uint32_t objectIdx = 0; objectIdx < count; ++objectIdx)
+		{
+			if (bounds[objectIdx].Overlaps(tileX, tileY, slice))
+			{
+				outObjects[cellObjectCount++] = objectIdx;
+			}
+		}
+	}
+
+	class TileBins
+	{
+	public:
+		explicit TileBins(const Camera& camera)
+			: m_camera(camera)
+			, m_cellObjectCounts(camera.GetCellCount())
+			, m_cellObjectOffsets(camera.GetCellCount())
+			, m_cellObjects(size_t(camera.GetCellCount()) * MeanCellCapacity)
+		{
+		}
+
+		// The GPU's kernels & scans one after the other
+		void Bin(const Object* objects, uint32_t count)
+		{
+			m_objectBounds.resize(count);
+			m_objectCellOffsets.resize(count);
+			for (uint32_t objectIdx = 0; objectIdx < count; ++objectIdx)
+			{
+				m_objectBounds[objectIdx] = ComputeObjectBounds(m_camera, objects[objectIdx]);
+				m_objectCellOffsets[objectIdx] = m_objectBounds[objectIdx].GetCellCount();
+			}
+
+			// The objects whose entries all fit in the pool, a prefix of the scene: the offsets only grow
+			ParallelPrimitives::ExclusiveScan(m_objectCellOffsets.data(), m_objectCellOffsets.data(), count);
+			m_binnedObjectCount = 0;
+			while (m_binnedObjectCount < count
+				&& m_objectCellOffsets[m_binnedObjectCount] + m_objectBounds[m_binnedObjectCount].GetCellCount() <= GetCellListCapacity())
+			{
+				++m_binnedObjectCount;
+			}
+
+			ForEachCell([&](uint32_t tileX, uint32_t tileY, uint32_t slice, uint32_t cellIdx)
+			{
+				m_cellObjectCounts[cellIdx] = CountCellObjects(m_objectBounds.data(), m_binnedObjectCount, tileX, tileY, slice);
+			});
+			m_listedObjectCount = ParallelPrimitives::ExclusiveScan(m_cellObjectCounts.data(), m_cellObjectOffsets.data(), m_cellObjectCounts.size());
+			ForEachCell([&](uint32_t tileX, uint32_t tileY, uint32_t slice, uint32_t cellIdx)
+			{
+				BinCell(m_objectBounds.data(), m_binnedObjectCount, tileX, tileY, slice, &m_cellObjects[m_cellObjectOffsets[cellIdx]]);
+			});
+		}
+
+		const Camera& GetCamera() const { return m_camera; }
+		uint32_t GetCellObjectCount(uint32_t cellIdx) const { return m_cellObjectCounts[cellIdx]; }
+		const uint32_t* GetCellObjects(uint32_t cellIdx) const { return &m_cellObjects[m_cellObjectOffsets[cellIdx]]; }
+		uint32_t GetCellListCapacity() const { return uint32_t(m_cellObjects.size()); }
+		// Entries of the cell lists, GetCellListCapacity at most
+		uint32_t GetListedObjectCount() const { return m_listedObjectCount; }
+		// The first objects, the ones after them didn't fit in the pool & aren't in any cell
+		uint32_t GetBinnedObjectCount() const { return m_binnedObjectCount; }
+		uint32_t GetDroppedObjectCount() const { return uint32_t(m_objectBounds.size()) - m_binnedObjectCount; }
+
+		// Every ray of one pixel out of pixelStride^2 against every binned object's inflated sphere: each slice the ray is inside
+		// the sphere in must list the object
+		bool Validate(const Object* objects, uint32_t pixelStride) const
+		{
+			for (uint32_t y = 0; y < m_camera.Height; y += pixelStride)
+			{
+				for (uint32_t x = 0; x < m_camera.Width; x += pixelStride)
+				{
+					float dir[3];
+					m_camera.GetRayDir(x, y, dir);
+					for (uint32_t objectIdx = 0; objectIdx < m_binnedObjectCount; ++objectIdx)
+					{
+						const Object& object = objects[objectIdx];
+						const float radius = object.Size + SupportRadius;
+						const float centerAlongRay = object.Pos[0] * dir[0] + object.Pos[1] * dir[1] + object.Pos[2] * dir[2];
+						const float centerSqDist = object.Pos[0] * object.Pos[0] + object.Pos[1] * object.Pos[1] + object.Pos[2] * object.Pos[2];
+						const float discriminant = centerAlongRay * centerAlongRay - centerSqDist + radius * radius;
+						if (discriminant < 0.f || centerAlongRay + std::sqrt(discriminant) <= 0.f)
+						{
+							continue;
+						}
+						const float enterZ = std::max(centerAlongRay - std::sqrt(discriminant), 0.f) * dir[2];
+						const float exitZ = (centerAlongRay + std::sqrt(discriminant)) * dir[2];
+						if (enterZ >= m_camera.FarZ)
+						{
+							continue;
+						}
+						for (uint32_t slice = m_camera.GetDepthSlice(enterZ); slice <= m_camera.GetDepthSlice(exitZ); ++slice)
+						{
+							const uint32_t cellIdx = m_camera.GetCellIdx(x / TileSize, y / TileSize, slice);
+							const uint32_t* cellObjects = GetCellObjects(cellIdx);
+							if (std::find(cellObjects, cellObjects + GetCellObjectCount(cellIdx), objectIdx) == cellObjects + GetCellObjectCount(cellIdx))
+							{
+								return false;
+							}
+						}
+					}
+				}
+			}
+			return true;
+		}
+
+	private:
+		template<typename TFunction>
+		void ForEachCell(const TFunction& function) const
+		{
+			for (uint32_t tileY = 0; tileY < m_camera.GetTileCountY(); ++tileY)
+			{
+				for (uint32_t tileX = 0; tileX < m_camera.GetTileCountX(); ++tileX)
+				{
+					for (uint32_t slice = 0; slice < DepthSliceCount; ++slice)
+					{
+						function(tileX, tileY, slice, m_camera.GetCellIdx(tileX, tileY, slice));
+					}
+				}
+			}
+		}
+
+		Camera m_camera;
+		std::vector<ObjectBounds> m_objectBounds;
+		std::vector<uint32_t> m_objectCellOffsets;
+		std::vector<uint32_t> m_cellObjectCounts;
+		std::vector<uint32_t> m_cellObjectOffsets;
+		std::vector<uint32_t> m_cellObjects;
+		uint32_t m_binnedObjectCount = 0;
+		uint32_t m_listedObjectCount = 0;
+	};
+
+	struct MarchResult
+	{
+		bool Hit = false;
+		float Distance = 0.f; // Travelled, far - near if nothing was hit
+		float Normal[3] = {};
+		uint32_t StepCount = 0;
+		uint32_t ObjectEvaluationCount = 0;
+	};
+
+	// Smooth min of the running field a & an object's b, blend is 0 for fully a, 1 for fully b
+	inline float Smin(float a, float b, float k, float& outBlend)
+	{
+		outBlend = std::clamp(0.5f + 0.5f * (b - a) / k, 0.f, 1.f);
+		return b + (a - b) * outBlend - k * outBlend * (1.f - outBlend);
+	}
+
+	// The field at pos over objects[objectIndices[i]], or over every object if objectIndices is null.
+	// The smooth union of the objects, blended in that order from MaxBlendedDistance: smin(a, b, k) is a wherever b >= a + k,
+	// the objects further than SupportRadius leave it as it is & are skipped. With none closer, it's MaxBlendedDistance everywhere:
+	// the field is then the nearest object's distance less BlendRadius, MaxBlendedDistance at SupportRadius, so it stays continuous
+	// & never more than the distance to the union's surface.
+	inline float EvaluateField(const Object* objects, const uint32_t* objectIndices, uint32_t count, const float pos[3], float outNormal[3])
+	{
+		float dist = MaxBlendedDistance;
+		float nearestDist = MaxDistancePerStep + BlendRadius;
+		bool isBlended = false;
+		float normal[3] = {};
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const Object& object = objects[objectIndices ? objectIndices[i] : i];
+			const float objToPos[3] = { pos[0] - object.Pos[0], pos[1] - object.Pos[1], pos[2] - object.Pos[2] };
+			const float distToCenter = std::sqrt(objToPos[0] * objToPos[0] + objToPos[1] * objToPos[1] + objToPos[2] * objToPos[2]);
+			const float objDist = distToCenter - object.Size;
+			if (objDist >= SupportRadius)
+			{
+				nearestDist = std::min(nearestDist, objDist);
+				continue;
+			}
+			isBlended = true;
+			const float invDistToCenter = 1.f / std::max(distToCenter, 0.0001f);
+			float blend;
+			dist = Smin(dist, objDist, BlendRadius, blend);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				normal[axis] = objToPos[axis] * invDistToCenter + (normal[axis] - objToPos[axis] * invDistToCenter) * blend;
+			}
+		}
+		std::copy(normal, normal + 3, outNormal);
+		return isBlended ? dist : nearestDist - BlendRadius;
+	}
+
+	inline void FinishHit(MarchResult& result, const float normal[3])
+	{
+		const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			result.Normal[axis] = normal[axis] / std::max(length, 0.0001f);
+		}
+		result.Hit = true;
+	}
+
+	// Every object at every step, RaymarchScene.hlsl before tile binning
+	inline MarchResult March(const Camera& camera, const Object* objects, uint32_t count, uint32_t x, uint32_t y)
+	{
+		const float worldSize = camera.FarZ - camera.NearZ;
+		float dir[3];
+		camera.GetRayDir(x, y, dir);
+
+		MarchResult result;
+		for (uint32_t step = 0; step < MaxStepCount; ++step)
+		{
+			const float pos[3] = { dir[0] * result.Distance, dir[1] * result.Distance, dir[2] * result.Distance };
+			float normal[3];
+			const float dist = EvaluateField(objects, nullptr, count, pos, normal);
+			result.ObjectEvaluationCount += count;
+			result.StepCount = step + 1;
+			result.Distance += dist;
+			if (dist <= MinDistForCollision)
+			{
+				FinishHit(result, normal);
+				break;
+			}
+			if (step == MaxStepCount - 1 || result.Distance >= worldSize)
+			{
+				result.Distance = worldSize;
+				break;
+			}
+		}
+		return result;
+	}
+
+	// Through the pixel's tile cells: the current cell's objects only, none if it's empty.
+	// A step never crosses the cell's far depth, its rays enter the next slice exactly there: up to MaxBinnedStepCount steps.
+	// Rays start at startDistance, ConeMarch's for their block, there's no surface before it.
+	inline MarchResult MarchBinned(const TileBins& bins, const Object* objects, uint32_t x, uint32_t y, float startDistance = 0.f)
+	{
+		const Camera& camera = bins.GetCamera();
+		const float worldSize = camera.FarZ - camera.NearZ;
+		float dir[3];
+		camera.GetRayDir(x, y, dir);
+
+		MarchResult result;
+		if (startDistance >= worldSize)
+		{
+			result.Distance = worldSize;
+			return result;
+		}
+		result.Distance = startDistance;
+		uint32_t slice = camera.GetDepthSlice(startDistance * dir[2]);
+		for (uint32_t step = 0; step < MaxBinnedStepCount; ++step)
+		{
+			const uint32_t cellIdx = camera.GetCellIdx(x / TileSize, y / TileSize, slice);
+			const float sliceEnd = camera.GetDepthSliceEnd(slice) / dir[2];
+			const uint32_t cellObjectCount = bins.GetCellObjectCount(cellIdx);
+
+			float dist = sliceEnd - result.Distance;
+			float normal[3] = {};
+			if (cellObjectCount > 0)
+			{
+				const float pos[3] = { dir[0] * result.Distance, dir[1] * result.Distance, dir[2] * result.Distance };
+				dist = EvaluateField(objects, bins.GetCellObjects(cellIdx), cellObjectCount, pos, normal);
+				result.ObjectEvaluationCount += cellObjectCount;
+			}
+			result.StepCount = step + 1;
+			if (result.Distance + dist >= sliceEnd)
+			{
+				result.Distance = sliceEnd;
+				++slice;
+			}
+			else
+			{
+				result.Distance += dist;
+			}
+
+			if (cellObjectCount > 0 && dist <= MinDistForCollision)
+			{
+				FinishHit(result, normal);
+				break;
+			}
+			if (step == MaxBinnedStepCount - 1 || slice == DepthSliceCount || result.Distance >= worldSize)
+			{
+				result.Distance = worldSize;
+				break;
+			}
+		}
+		return result;
+	}
+
+	struct ConeResult
+	{
+		float StartDistance = 0.f; // far - near if no ray of the block hits anything
+		uint32_t StepCount = 0;
+		uint32_t ObjectEvaluationCount = 0;
+	};
+
+	// Cone marching, RaymarchScene.hlsl's CSConeMarch: a cone around the rays of a ConeBlockSize^2 pixels block, marched along its
+	// center ray until a surface may be within it. Its rays have no surface before StartDistance, they start marching there.
+	// - Every block ray's point at distance t is within t * slope of the center ray's, slope being the widest chord to a corner ray.
+	//   A field of f at the center point leaves f - t * slope free around each of them.
+	// - The block's rays share their tile's cells but not their depth: at t they're spread over the slices between t times
+	//   the block's smallest & largest view z per unit of ray. Each of these cells' field is evaluated, empty cells have no surface.
+	// - Steps stop at the earliest end of the furthest of these slices, where the block's rays can enter the next one.
+	inline ConeResult ConeMarch(const TileBins& bins, const Object* objects, uint32_t blockX, uint32_t blockY)
+	{
+		const Camera& camera = bins.GetCamera();
+		const float worldSize = camera.FarZ - camera.NearZ;
+
+		// The block's pixel centers, clipped to the screen
+		const float pixelMin[2] = { float(blockX * ConeBlockSize) + 0.5f, float(blockY * ConeBlockSize) + 0.5f };
+		const float pixelMax[2] = {
+			float(std::min((blockX + 1) * ConeBlockSize, camera.Width) - 1) + 0.5f,
+			float(std::min((blockY + 1) * ConeBlockSize, camera.Height) - 1) + 0.5f };
+		float centerDir[3];
+		camera.GetRayDirAt((pixelMin[0] + pixelMax[0]) * 0.5f, (pixelMin[1] + pixelMax[1]) * 0.5f, centerDir);
+
+		float slope = 0.f;
+		for (uint32_t corner = 0; corner < 4; ++corner)
+		{
+			float cornerDir[3];
+			camera.GetRayDirAt((corner & 1) ? pixelMax[0] : pixelMin[0], (corner >> 1) ? pixelMax[1] : pixelMin[1], cornerDir);
+			const float chord[3] = { cornerDir[0] - centerDir[0], cornerDir[1] - centerDir[1], cornerDir[2] - centerDir[2] };
+			slope = std::max(slope, std::sqrt(chord[0] * chord[0] + chord[1] * chord[1] + chord[2] * chord[2]));
+		}
+
+		// View z per unit of ray falls off away from the screen's center: largest at the block's pixel nearest to it,
+		// smallest at its furthest corner
+		const float screenCenter[2] = { float(camera.Width) * 0.5f, float(camera.Height) * 0.5f };
+		float nearestDir[3];
+		float furthestDir[3];
+		camera.GetRayDirAt(std::clamp(screenCenter[0], pixelMin[0], pixelMax[0]), std::clamp(screenCenter[1], pixelMin[1], pixelMax[1]), nearestDir);
+		camera.GetRayDirAt(
+			screenCenter[0] - pixelMin[0] > pixelMax[0] - screenCenter[0] ? pixelMin[0] : pixelMax[0],
+			screenCenter[1] - pixelMin[1] > pixelMax[1] - screenCenter[1] ? pixelMin[1] : pixelMax[1],
+			furthestDir);
+		const float maxDirZ = nearestDir[2];
+		const float minDirZ = furthestDir[2];
+
+		const uint32_t tileX = blockX * ConeBlockSize / TileSize;
+		const uint32_t tileY = blockY * ConeBlockSize / TileSize;
+		ConeResult result;
+		uint32_t sliceMax = 0;
+		for (uint32_t step = 0; step < MaxBinnedStepCount; ++step)
+		{
+			const float t = result.StartDistance;
+			const float sliceEnd = camera.GetDepthSliceEnd(sliceMax) / maxDirZ;
+			const float pos[3] = { centerDir[0] * t, centerDir[1] * t, centerDir[2] * t };
+			float dist = sliceEnd - t;
+			for (uint32_t slice = std::min(camera.GetDepthSlice(t * minDirZ), sliceMax); slice <= sliceMax; ++slice)
+			{
+				const uint32_t cellIdx = camera.GetCellIdx(tileX, tileY, slice);
+				const uint32_t cellObjectCount = bins.GetCellObjectCount(cellIdx);
+				if (cellObjectCount == 0)
+				{
+					continue;
+				}
+				float normal[3];
+				dist = std::min(dist, EvaluateField(objects, bins.GetCellObjects(cellIdx), cellObjectCount, pos, normal) - t * slope);
+				result.ObjectEvaluationCount += cellObjectCount;
+			}
+			result.StepCount = step + 1;
+
+			// A surface may be within the cone
+			if (dist <= MinDistForCollision)
+			{
+				break;
+			}
+			if (t + dist >= sliceEnd)
+			{
+				result.StartDistance = sliceEnd;
+				++sliceMax;
+			}
+			else
+			{
+				result.StartDistance += dist;
+			}
+			if (sliceMax == DepthSliceCount || result.StartDistance >= worldSize)
+			{
+				result.StartDistance = worldSize;
+				break;
+			}
+		}
+		return result;
+	}
+
+	// Reduced resolution, RaymarchScene.hlsl's CSResolve. A quarter of the pixels are marched, one of each 2x2 quad:
+	// - Half: always the quad's first pixel, the others are upsampled
+	// - Checkerboard: the quad's pixels in turn over 4 frames. The others are reprojected from the previous frame if it agrees with
+	//   the samples around them, upsampled otherwise, then clamped to these samples' colors.
+	// Upsampling is depth aware: the samples of the bilinear footprint too far from the nearest one's depth are left out,
+	// silhouettes don't blend with what's behind them.
+	enum class Resolution : uint32_t
+	{
+		Full = 0,
+		Half,
+		Checkerboard
+	};
+
+	constexpr float UpsampleDepthTolerance = 0.05f; // Relative to the nearest sample's distance
+	constexpr float ReprojectionTolerance = 0.05f; // Relative to the neighbourhood's depth range
+
+	inline uint32_t GetMarchStride(Resolution resolution)
+	{
+		return resolution == Resolution::Full ? 1 : 2;
+	}
+
+	// The pixel of each quad marched on frameIdx, diagonal ones on consecutive frames
+	inline void GetMarchOffset(Resolution resolution, uint32_t frameIdx, uint32_t outOffset[2])
+	{
+		constexpr uint32_t CheckerboardOffsets[4][2] = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+		const uint32_t phase = resolution == Resolution::Checkerboard ? frameIdx % 4 : 0;
+		outOffset[0] = CheckerboardOffsets[phase][0];
+		outOffset[1] = CheckerboardOffsets[phase][1];
+	}
+
+	// RaymarchScene.hlsl's fake light
+	inline void Shade(const MarchResult& result, float outColor[4])
+	{
+		std::fill(outColor, outColor + 4, 0.f);
+		if (!result.Hit)
+		{
+			return;
+		}
+		const float lightDirLength = std::sqrt(0.5f * 0.5f + 1.f + 0.5f * 0.5f);
+		const float lightDir[3] = { 0.5f / lightDirLength, 1.f / lightDirLength, -0.5f / lightDirLength };
+		const float lightColorLength = std::sqrt(1.5f * 1.5f + 1.f);
+		const float lightColor[3] = { 1.5f / lightColorLength, 1.f / lightColorLength, 0.f };
+		const float nDotL = std::clamp(result.Normal[0] * lightDir[0] + result.Normal[1] * lightDir[1] + result.Normal[2] * lightDir[2], 0.f, 1.f);
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			outColor[channel] = 0.2f + nDotL * lightColor[channel];
+		}
+		outColor[3] = 1.f;
+	}
+
+	// A frame at a time: the binned march of the marched pixels, then every pixel resolved.
+	// Objects & eye positions are in world space, the CPU camera only translates: view space is world space minus the eye's position.
+	class Reconstructor
+	{
+	public:
+		Reconstructor(const Camera& camera, Resolution resolution)
+			: m_camera(camera)
+			, m_resolution(resolution)
+			, m_bins(camera)
+			, m_marchWidth(camera.Width / GetMarchStride(resolution))
+			, m_marchHeight(camera.Height / GetMarchStride(resolution))
+			, m_marchColors(size_t(m_marchWidth) * m_marchHeight * 4)
+			, m_marchDistances(size_t(m_marchWidth) * m_marchHeight)
+			, m_colors(size_t(camera.Width) * camera.Height * 4)
+			, m_distances(size_t(camera.Width) * camera.Height)
+			, m_historyColors(m_colors.size())
+			, m_historyDistances(m_distances.size())
+		{
+		}
+
+		void RenderFrame(const Object* objects, uint32_t count, const float eyePos[3])
+		{
+			m_viewObjects.resize(count);
+			for (uint32_t objectIdx = 0; objectIdx < count; ++objectIdx)
+			{
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					m_viewObjects[objectIdx].Pos[axis] = objects[objectIdx].Pos[axis] - eyePos[axis];
+				}
+				m_viewObjects[objectIdx].Size = objects[objectIdx].Size;
+			}
+			m_bins.Bin(m_viewObjects.data(), count);
+
+			const uint32_t stride = GetMarchStride(m_resolution);
+			GetMarchOffset(m_resolution, m_frameIdx, m_marchOffset);
+			for (uint32_t marchY = 0; marchY < m_marchHeight; ++marchY)
+			{
+				for (uint32_t marchX = 0; marchX < m_marchWidth; ++marchX)
+				{
+					const size_t marchIdx = marchX + size_t(m_marchWidth) * marchY;
+					const MarchResult result = MarchBinned(m_bins, m_viewObjects.data(), marchX * stride + m_marchOffset[0], marchY * stride + m_marchOffset[1]);
+					Shade(result, &m_marchColors[marchIdx * 4]);
+					m_marchDistances[marchIdx] = result.Distance;
+				}
+			}
+
+			// Last frame's output is this frame's history
+			std::swap(m_colors, m_historyColors);
+			std::swap(m_distances, m_historyDistances);
+			m_reprojectedPixelCount = 0;
+			for (uint32_t y = 0; y < m_camera.Height; ++y)
+			{
+				for (uint32_t x = 0; x < m_camera.Width; ++x)
+				{
+					ResolvePixel(x, y, eyePos);
+				}
+			}
+
+			std::copy(eyePos, eyePos + 3, m_prevEyePos);
+			m_hasHistory = m_resolution == Resolution::Checkerboard;
+			++m_frameIdx;
+		}
+
+		// The next frame won't reproject, eg: after a camera cut
+		void ResetHistory() { m_hasHistory = false; }
+
+		// As ComputePassRaymarchScene's settings change: the history is only kept from a checkerboard frame to the next
+		void SetResolution(Resolution resolution)
+		{
+			if (resolution == m_resolution)
+			{
+				return;
+			}
+			m_resolution = resolution;
+			m_marchWidth = m_camera.Width / GetMarchStride(resolution);
+			m_marchHeight = m_camera.Height / GetMarchStride(resolution);
+			m_marchColors.resize(size_t(m_marchWidth) * m_marchHeight * 4);
+			m_marchDistances.resize(size_t(m_marchWidth) * m_marchHeight);
+			m_hasHistory = false;
+		}
+
+		uint32_t GetMarchedRayCount() const { return m_marchWidth * m_marchHeight; }
+		uint32_t GetReprojectedPixelCount() const { return m_reprojectedPixelCount; }
+		// RGBA per pixel, the last frame's
+		const std::vector<float>& GetColors() const { return m_colors; }
+		const std::vector<float>& GetDistances() const { return m_distances; }
+
+	private:
+		void ResolvePixel(uint32_t x, uint32_t y, const float eyePos[3])
+		{
+			// The bilinear footprint in the marched samples, sample q is pixel q * stride + offset
+			const float stride = float(GetMarchStride(m_resolution));
+			const float marchPos[2] = { (float(x) - float(m_marchOffset[0])) / stride, (float(y) - float(m_marchOffset[1])) / stride };
+			const float marchFloor[2] = { std::floor(marchPos[0]), std::floor(marchPos[1]) };
+			const float frac[2] = { marchPos[0] - marchFloor[0], marchPos[1] - marchFloor[1] };
+			size_t sampleIndices[4];
+			float sampleWeights[4];
+			uint32_t nearestSample = 0;
+			for (uint32_t sample = 0; sample < 4; ++sample)
+			{
+				const int32_t sampleX = std::clamp(int32_t(marchFloor[0]) + int32_t(sample & 1), 0, int32_t(m_marchWidth) - 1);
+				const int32_t sampleY = std::clamp(int32_t(marchFloor[1]) + int32_t(sample >> 1), 0, int32_t(m_marchHeight) - 1);
+				sampleIndices[sample] = size_t(sampleX) + size_t(m_marchWidth) * size_t(sampleY);
+				sampleWeights[sample] = ((sample & 1) ? frac[0] : 1.f - frac[0]) * ((sample >> 1) ? frac[1] : 1.f - frac[1]);
+				nearestSample = sampleWeights[sample] > sampleWeights[nearestSample] ? sample : nearestSample;
+			}
+
+			// The footprint's samples bound the reprojected history, all of them: they straddle the silhouettes the history refines
+			const float nearestDistance = m_marchDistances[sampleIndices[nearestSample]];
+			PixelNeighbourhood neighbourhood;
+			float color[4] = {};
+			float distance = 0.f;
+			float totalWeight = 0.f;
+			for (uint32_t sample = 0; sample < 4; ++sample)
+			{
+				const float sampleDistance = m_marchDistances[sampleIndices[sample]];
+				const float* sampleColor = &m_marchColors[sampleIndices[sample] * 4];
+				neighbourhood.Add(sampleColor, sampleDistance);
+				if (std::abs(sampleDistance - nearestDistance) > UpsampleDepthTolerance * nearestDistance)
+				{
+					continue;
+				}
+				for (uint32_t channel = 0; channel < 4; ++channel)
+				{
+					color[channel] += sampleColor[channel] * sampleWeights[sample];
+				}
+				distance += sampleDistance * sampleWeights[sample];
+				totalWeight += sampleWeights[sample];
+			}
+			for (float& channel : color)
+			{
+				channel /= totalWeight;
+			}
+			distance /= totalWeight;
+
+			const size_t pixelIdx = x + size_t(m_camera.Width) * y;
+			const bool isMarched = frac[0] == 0.f && frac[1] == 0.f;
+			if (m_hasHistory && !isMarched && Reproject(x, y, eyePos, neighbourhood, color, distance))
+			{
+				++m_reprojectedPixelCount;
+			}
+			std::copy(color, color + 4, &m_colors[pixelIdx * 4]);
+			m_distances[pixelIdx] = distance;
+		}
+
+		struct PixelNeighbourhood
+		{
+			void Add(const float color[4], float distance)
+			{
+				for (uint32_t channel = 0; channel < 4; ++channel)
+				{
+					MinColor[channel] = std::min(MinColor[channel], color[channel]);
+					MaxColor[channel] = std::max(MaxColor[channel], color[channel]);
+				}
+				MinDistance = std::min(MinDistance, distance);
+				MaxDistance = std::max(MaxDistance, distance);
+			}
+
+			float MinColor[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+			float MaxColor[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			float MinDistance = FLT_MAX;
+			float MaxDistance = 0.f;
+		};
+
+		// The upsampled surface point into the previous frame. The history there is kept if its own surface point is within the
+		// neighbourhood's depth range, its color clamped to the neighbourhood's.
+		bool Reproject(uint32_t x, uint32_t y, const float eyePos[3], const PixelNeighbourhood& neighbourhood, float inOutColor[4], float& inOutDistance) const
+		{
+			const float worldSize = m_camera.FarZ - m_camera.NearZ;
+			float dir[3];
+			m_camera.GetRayDir(x, y, dir);
+			float prevView[3];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				prevView[axis] = eyePos[axis] + dir[axis] * inOutDistance - m_prevEyePos[axis];
+			}
+			if (prevView[2] <= 0.f)
+			{
+				return false;
+			}
+
+			const float prevPixelX = std::round(((m_camera.ProjScaleX * prevView[0] / prevView[2]) * 0.5f + 0.5f) * float(m_camera.Width) - 0.5f);
+			const float prevPixelY = std::round(((m_camera.ProjScaleY * prevView[1] / prevView[2]) * 0.5f + 0.5f) * float(m_camera.Height) - 0.5f);
+			if (prevPixelX < 0.f || prevPixelY < 0.f || prevPixelX > float(m_camera.Width - 1) || prevPixelY > float(m_camera.Height - 1))
+			{
+				return false;
+			}
+
+			// A miss stays a miss, a hit is at the history's point seen from the current eye
+			const size_t historyIdx = size_t(prevPixelX) + size_t(m_camera.Width) * size_t(prevPixelY);
+			float historyDistance = m_historyDistances[historyIdx];
+			if (historyDistance < worldSize)
+			{
+				float prevDir[3];
+				m_camera.GetRayDir(uint32_t(prevPixelX), uint32_t(prevPixelY), prevDir);
+				float historyToEyeSq = 0.f;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					const float historyToEye = m_prevEyePos[axis] + prevDir[axis] * historyDistance - eyePos[axis];
+					historyToEyeSq += historyToEye * historyToEye;
+				}
+				historyDistance = std::sqrt(historyToEyeSq);
+			}
+			if (historyDistance < neighbourhood.MinDistance * (1.f - ReprojectionTolerance) || historyDistance > neighbourhood.MaxDistance * (1.f + ReprojectionTolerance))
+			{
+				return false;
+			}
+
+			for (uint32_t channel = 0; channel < 4; ++channel)
+			{
+				inOutColor[channel] = std::clamp(m_historyColors[historyIdx * 4 + channel], neighbourhood.MinColor[channel], neighbourhood.MaxColor[channel]);
+			}
+			inOutDistance = historyDistance;
+			return true;
+		}
+
+		Camera m_camera;
+		Resolution m_resolution;
+		TileBins m_bins;
+		std::vector<Object> m_viewObjects;
+		uint32_t m_marchWidth = 0;
+		uint32_t m_marchHeight = 0;
+		uint32_t m_marchOffset[2] = {};
+		std::vector<float> m_marchColors;
+		std::vector<float> m_marchDistances;
+		std::vector<float> m_colors;
+		std::vector<float> m_distances;
+		std::vector<float> m_historyColors;
+		std::vector<float> m_historyDistances;
+		float m_prevEyePos[3] = {};
+		uint32_t m_frameIdx = 0;
+		uint32_t m_reprojectedPixelCount = 0;
+		bool m_hasHistory = false;
+	};
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace AstroTools::Rendering
+{
+	// Key of a compiled shader permutation in the ShaderLibrary. Built on every GetCompiledShader call, cache hits included,
+	// so it's sized up front rather than grown by each append.
+	inline std::wstring BuildShaderKey(
+		const std::wstring& path,
+		const std::wstring& entryPoint,
+		const std::vector<std::wstring>& defines,
+		const std::wstring& target)
+	{
+		size_t keyLength = path.size() + target.size() + entryPoint.size();
+		for (const auto& define : defines)
+		{
+			keyLength += define.size();
+		}
+
+		std::wstring key;
+		key.reserve(keyLength);
+		key += path;
+		key += target;
+		key += entryPoint;
+		for (const auto& define : defines)
+		{
+			key += define;
+		}
+		return key;
+	}
+}
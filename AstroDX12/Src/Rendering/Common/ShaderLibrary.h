@@ -5,6 +5,7 @@
 
 #include <Common.h>
 #include <Rendering/Common/RenderingUtils.h>
+#include <Rendering/Common/ShaderKey.h>
 
 using namespace Microsoft::WRL;
 namespace AstroTools::Rendering
@@ -18,11 +19,7 @@ namespace AstroTools::Rendering
 			const std::vector<std::wstring>& defines,
 			const std::wstring& target )
 		{
-			auto key = path + target + entryPoint;
-			for(auto& define : defines)
-			{
-				key += define;
-			}
+			const auto key = BuildShaderKey(path, entryPoint, defines, target);
 			if ( const auto& shaderIt = m_compiledShaders.find(key); shaderIt != m_compiledShaders.end())
 			{
 				return (*shaderIt).second;
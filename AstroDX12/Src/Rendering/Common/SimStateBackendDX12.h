@@ -0,0 +1,212 @@
+#pragma once
+
+#include <Common.h>
+#include <vector>
+#include <Rendering/IRenderer.h>
+#include <Rendering/Common/RendererContext.h>
+#include <Rendering/Common/SimStateSnapshot.h>
+
+using namespace Microsoft::WRL;
+
+// Reads & writes GPU sim bindings (SimStateBinding::Resource is an ID3D12Resource*), buffers or 2D textures.
+// Reads go through a readback buffer, writes through the upload ring, both on an immediate command list:
+// the GPU is idle once a call returns, so this is for occasional snapshots, not per frame streaming.
+class SimStateBackendDX12 final : public ISimStateBackend
+{
+public:
+	explicit SimStateBackendDX12(IRenderer& renderer)
+		: m_renderer(renderer)
+	{
+	}
+
+	virtual void ReadBindings(const std::vector<SimStateBinding>& bindings, std::vector<SimStateChunk>& outChunks) override
+	{
+		RendererContext& rendererContext = m_renderer.GetRendererContext();
+		ResourceBarrierBatcher& resourceStates = *rendererContext.ResourceStates.lock();
+
+		UINT64 readbackByteSize = 0;
+		std::vector<CopyLayout> copyLayouts;
+		for (const SimStateBinding& binding : bindings)
+		{
+			copyLayouts.push_back(GetCopyLayout(rendererContext.Device.Get(), binding, readbackByteSize));
+		}
+
+		ComPtr<ID3D12Resource> readbackBuffer;
+		const auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+		const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(readbackByteSize);
+		ThrowIfFailed(rendererContext.Device->CreateCommittedResource(
+			&heapProp,
+			D3D12_HEAP_FLAG_NONE,
+			&bufferDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&readbackBuffer)));
+		readbackBuffer->SetName(L"SimStateReadback");
+
+		m_renderer.ExecuteImmediate([&](ID3D12GraphicsCommandList* cmdList)
+			{
+				for (const SimStateBinding& binding : bindings)
+				{
+					resourceStates.Transition(GetResource(binding), D3D12_RESOURCE_STATE_COPY_SOURCE);
+				}
+				resourceStates.FlushBarriers(cmdList);
+
+				for (size_t i = 0; i < bindings.size(); ++i)
+				{
+					RecordCopy(cmdList, readbackBuffer.Get(), GetResource(bindings[i]), copyLayouts[i], /*toResource*/ false);
+				}
+			});
+
+		BYTE* mappedData = nullptr;
+		const D3D12_RANGE readRange = { 0, SIZE_T(readbackByteSize) };
+		ThrowIfFailed(readbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mappedData)));
+
+		outChunks.resize(bindings.size());
+		for (size_t i = 0; i < bindings.size(); ++i)
+		{
+			const SimStateBinding& binding = bindings[i];
+			SimStateChunk& chunk = outChunks[i];
+			chunk.Name = binding.Name;
+			chunk.ElementByteSize = binding.ElementByteSize;
+			chunk.Width = binding.Width;
+			chunk.Height = binding.Height;
+			chunk.Data.resize(size_t(chunk.GetExpectedByteSize()));
+
+			// Drop the row pitch padding of textures
+			const CopyLayout& layout = copyLayouts[i];
+			for (UINT row = 0; row < layout.RowCount; ++row)
+			{
+				memcpy(
+					chunk.Data.data() + row * layout.RowByteSize,
+					mappedData + layout.Footprint.Offset + row * layout.Footprint.Footprint.RowPitch,
+					size_t(layout.RowByteSize));
+			}
+		}
+
+		const D3D12_RANGE writtenRange = { 0, 0 };
+		readbackBuffer->Unmap(0, &writtenRange);
+	}
+
+	virtual void WriteBindings(const std::vector<SimStateBinding>& bindings, const std::vector<const SimStateChunk*>& chunks) override
+	{
+		RendererContext& rendererContext = m_renderer.GetRendererContext();
+		ResourceBarrierBatcher& resourceStates = *rendererContext.ResourceStates.lock();
+
+		UINT64 uploadByteSize = 0;
+		std::vector<CopyLayout> copyLayouts;
+		for (const SimStateBinding& binding : bindings)
+		{
+			copyLayouts.push_back(GetCopyLayout(rendererContext.Device.Get(), binding, uploadByteSize));
+		}
+
+		const UploadAllocation upload = rendererContext.UploadRing.lock()->Allocate(uploadByteSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+		for (size_t i = 0; i < bindings.size(); ++i)
+		{
+			const CopyLayout& layout = copyLayouts[i];
+			for (UINT row = 0; row < layout.RowCount; ++row)
+			{
+				memcpy(
+					upload.CPUAddress + layout.Footprint.Offset + row * layout.Footprint.Footprint.RowPitch,
+					chunks[i]->Data.data() + row * layout.RowByteSize,
+					size_t(layout.RowByteSize));
+			}
+		}
+
+		m_renderer.ExecuteImmediate([&](ID3D12GraphicsCommandList* cmdList)
+			{
+				for (const SimStateBinding& binding : bindings)
+				{
+					resourceStates.Transition(GetResource(binding), D3D12_RESOURCE_STATE_COPY_DEST);
+				}
+				resourceStates.FlushBarriers(cmdList);
+
+				for (size_t i = 0; i < bindings.size(); ++i)
+				{
+					CopyLayout layout = copyLayouts[i];
+					layout.Footprint.Offset += upload.Offset;
+					RecordCopy(cmdList, upload.Resource, GetResource(bindings[i]), layout, /*toResource*/ true);
+				}
+			});
+	}
+
+private:
+	// Where a binding's content sits in the staging buffer, rows are RowPitch apart (textures only)
+	struct CopyLayout
+	{
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint = {};
+		UINT RowCount = 1;
+		UINT64 RowByteSize = 0;
+		bool IsBuffer = true;
+	};
+
+	static ID3D12Resource* GetResource(const SimStateBinding& binding)
+	{
+		DX::astro_assert(binding.Storage == SimStateStorage::GPU && binding.Resource != nullptr, "Sim state binding isn't a GPU resource");
+		return static_cast<ID3D12Resource*>(binding.Resource);
+	}
+
+	static UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Lays the binding out at the end of the staging buffer, inOutStagingByteSize is grown to include it
+	static CopyLayout GetCopyLayout(ID3D12Device* device, const SimStateBinding& binding, UINT64& inOutStagingByteSize)
+	{
+		const D3D12_RESOURCE_DESC desc = GetResource(binding)->GetDesc();
+		const UINT64 stagingOffset = AlignUp(inOutStagingByteSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+		CopyLayout layout;
+		layout.IsBuffer = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER;
+		if (layout.IsBuffer)
+		{
+			layout.RowByteSize = UINT64(binding.ElementByteSize) * binding.Width * binding.Height;
+			DX::astro_assert(layout.RowByteSize <= desc.Width, "Sim state binding is larger than its buffer");
+
+			layout.Footprint.Offset = stagingOffset;
+			inOutStagingByteSize = stagingOffset + layout.RowByteSize;
+		}
+		else
+		{
+			DX::astro_assert(desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && desc.Width == binding.Width && desc.Height == binding.Height,
+				"Sim state binding doesn't match its 2D texture");
+
+			UINT64 totalByteSize = 0;
+			device->GetCopyableFootprints(&desc, 0, 1, stagingOffset, &layout.Footprint, &layout.RowCount, &layout.RowByteSize, &totalByteSize);
+			DX::astro_assert(layout.RowByteSize == UINT64(binding.ElementByteSize) * binding.Width, "Sim state binding element size doesn't match its texture format");
+
+			inOutStagingByteSize = stagingOffset + totalByteSize;
+		}
+
+		return layout;
+	}
+
+	static void RecordCopy(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* stagingBuffer, ID3D12Resource* resource, const CopyLayout& layout, bool toResource)
+	{
+		if (layout.IsBuffer)
+		{
+			if (toResource)
+			{
+				cmdList->CopyBufferRegion(resource, 0, stagingBuffer, layout.Footprint.Offset, layout.RowByteSize);
+			}
+			else
+			{
+				cmdList->CopyBufferRegion(stagingBuffer, layout.Footprint.Offset, resource, 0, layout.RowByteSize);
+			}
+			return;
+		}
+
+		const CD3DX12_TEXTURE_COPY_LOCATION stagingLocation(stagingBuffer, layout.Footprint);
+		const CD3DX12_TEXTURE_COPY_LOCATION resourceLocation(resource, 0);
+		if (toResource)
+		{
+			cmdList->CopyTextureRegion(&resourceLocation, 0, 0, 0, &stagingLocation, nullptr);
+		}
+		else
+		{
+			cmdList->CopyTextureRegion(&stagingLocation, 0, 0, 0, &resourceLocation, nullptr);
+		}
+	}
+
+	IRenderer& m_renderer;
+};
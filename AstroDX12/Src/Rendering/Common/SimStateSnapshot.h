@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Snapshot of a simulation's state: the content of the buffers/textures it keeps between frames, plus any CPU side state.
+// Used to warm-start a sim from a steady state instead of re-simulating from its reset state.
+// No graphics API types in here: moving bytes to & from the GPU is the job of an ISimStateBackend.
+
+// One buffer or texture of a sim. Textures are stored with tightly packed rows, Height is 1 for buffers.
+struct SimStateChunk
+{
+	std::string Name;
+	uint32_t ElementByteSize = 0;
+	uint32_t Width = 0;
+	uint32_t Height = 1;
+	std::vector<uint8_t> Data;
+
+	uint64_t GetExpectedByteSize() const
+	{
+		return uint64_t(ElementByteSize) * Width * Height;
+	}
+};
+
+struct SimStateSnapshot
+{
+	std::string SimName;
+	uint32_t LayoutVersion = 0; // Owned by the sim, bumped whenever the content of its chunks changes
+	std::vector<SimStateChunk> Chunks;
+
+	const SimStateChunk* FindChunk(std::string_view name) const
+	{
+		for (const SimStateChunk& chunk : Chunks)
+		{
+			if (chunk.Name == name)
+			{
+				return &chunk;
+			}
+		}
+		return nullptr;
+	}
+};
+
+enum class SimStateReadResult : uint8_t
+{
+	Ok = 0,
+	FileNotFound,
+	BadMagic,
+	UnsupportedFormatVersion,
+	Truncated,
+	ChecksumMismatch,
+};
+
+// Binary layout, little endian:
+//   "ASIM" | u32 format version | string sim name | u32 layout version | u32 chunk count
+//   chunks: string name | u32 element byte size | u32 width | u32 height | u64 byte size | bytes
+//   u64 FNV-1a hash of everything before it
+// strings are a u32 length followed by the characters, without terminator.
+namespace SimStateSerialization
+{
+	constexpr char Magic[4] = { 'A', 'S', 'I', 'M' };
+	constexpr uint32_t FormatVersion = 1;
+
+	inline uint64_t HashBytes(const uint8_t* data, size_t byteSize)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < byteSize; ++i)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	namespace Privates
+	{
+		template<typename T>
+		void Write(std::vector<uint8_t>& out, T value)
+		{
+			const size_t offset = out.size();
+			out.resize(offset + sizeof(T));
+			std::memcpy(out.data() + offset, &value, sizeof(T));
+		}
+
+		inline void WriteString(std::vector<uint8_t>& out, std::string_view value)
+		{
+			Write(out, uint32_t(value.size()));
+			out.insert(out.end(), value.begin(), value.end());
+		}
+
+		// Bounds checked reads, every read fails once the data ran out
+		class Reader
+		{
+		public:
+			Reader(const uint8_t* data, size_t byteSize)
+				: m_data(data)
+				, m_byteSize(byteSize)
+			{
+			}
+
+			template<typename T>
+			bool Read(T& outValue)
+			{
+				if (m_byteSize - m_offset < sizeof(T))
+				{
+					return false;
+				}
+				std::memcpy(&outValue, m_data + m_offset, sizeof(T));
+				m_offset += sizeof(T);
+				return true;
+			}
+
+			bool ReadBytes(void* outData, size_t byteSize)
+			{
+				if (m_byteSize - m_offset < byteSize)
+				{
+					return false;
+				}
+				std::memcpy(outData, m_data + m_offset, byteSize);
+				m_offset += byteSize;
+				return true;
+			}
+
+			bool ReadString(std::string& outValue)
+			{
+				uint32_t length = 0;
+				if (!Read(length) || m_byteSize - m_offset < length)
+				{
+					return false;
+				}
+				outValue.assign(reinterpret_cast<const char*>(m_data + m_offset), length);
+				m_offset += length;
+				return true;
+			}
+
+			size_t GetRemainingByteSize() const { return m_byteSize - m_offset; }
+
+		private:
+			const uint8_t* m_data;
+			size_t m_byteSize;
+			size_t m_offset = 0;
+		};
+	}
+
+	inline std::vector<uint8_t> Serialize(const SimStateSnapshot& snapshot)
+	{
+		// Sized up front, snapshots are mostly chunk data and can be several MB
+		size_t byteSize = sizeof(Magic) + sizeof(uint32_t) * 4 + snapshot.SimName.size() + sizeof(uint64_t);
+		for (const SimStateChunk& chunk : snapshot.Chunks)
+		{
+			byteSize += sizeof(uint32_t) * 4 + sizeof(uint64_t) + chunk.Name.size() + chunk.Data.size();
+		}
+
+		std::vector<uint8_t> out;
+		out.reserve(byteSize);
+		out.resize(sizeof(Magic));
+		std::memcpy(out.data(), Magic, sizeof(Magic));
+		Privates::Write(out, FormatVersion);
+		Privates::WriteString(out, snapshot.SimName);
+		Privates::Write(out, snapshot.LayoutVersion);
+		Privates::Write(out, uint32_t(snapshot.Chunks.size()));
+
+		for (const SimStateChunk& chunk : snapshot.Chunks)
+		{
+			assert(chunk.Data.size() == chunk.GetExpectedByteSize());
+			Privates::WriteString(out, chunk.Name);
+			Privates::Write(out, chunk.ElementByteSize);
+			Privates::Write(out, chunk.Width);
+			Privates::Write(out, chunk.Height);
+			Privates::Write(out, uint64_t(chunk.Data.size()));
+			out.insert(out.end(), chunk.Data.begin(), chunk.Data.end());
+		}
+
+		Privates::Write(out, HashBytes(out.data(), out.size()));
+		return out;
+	}
+
+	inline SimStateReadResult Deserialize(const uint8_t* data, size_t byteSize, SimStateSnapshot& outSnapshot)
+	{
+		constexpr size_t HashByteSize = sizeof(uint64_t);
+		if (byteSize < sizeof(Magic) + sizeof(FormatVersion) + HashByteSize)
+		{
+			return SimStateReadResult::Truncated;
+		}
+
+		// The trailing hash isn't part of the content
+		Privates::Reader reader(data, byteSize - HashByteSize);
+
+		char magic[4] = {};
+		reader.ReadBytes(magic, sizeof(magic));
+		if (std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+		{
+			return SimStateReadResult::BadMagic;
+		}
+
+		uint32_t formatVersion = 0;
+		reader.Read(formatVersion);
+		if (formatVersion != FormatVersion)
+		{
+			return SimStateReadResult::UnsupportedFormatVersion;
+		}
+
+		// Validate the whole content before parsing chunk sizes out of it
+		uint64_t storedHash = 0;
+		std::memcpy(&storedHash, data + byteSize - HashByteSize, HashByteSize);
+		if (storedHash != HashBytes(data, byteSize - HashByteSize))
+		{
+			return SimStateReadResult::ChecksumMismatch;
+		}
+
+		SimStateSnapshot snapshot;
+		uint32_t chunkCount = 0;
+		if (!reader.ReadString(snapshot.SimName) || !reader.Read(snapshot.LayoutVersion) || !reader.Read(chunkCount))
+		{
+			return SimStateReadResult::Truncated;
+		}
+
+		for (uint32_t chunkIdx = 0; chunkIdx < chunkCount; ++chunkIdx)
+		{
+			SimStateChunk chunk;
+			uint64_t chunkByteSize = 0;
+			if (!reader.ReadString(chunk.Name)
+				|| !reader.Read(chunk.ElementByteSize)
+				|| !reader.Read(chunk.Width)
+				|| !reader.Read(chunk.Height)
+				|| !reader.Read(chunkByteSize)
+				|| chunkByteSize != chunk.GetExpectedByteSize()
+				|| chunkByteSize > reader.GetRemainingByteSize())
+			{
+				return SimStateReadResult::Truncated;
+			}
+
+			chunk.Data.resize(size_t(chunkByteSize));
+			if (!reader.ReadBytes(chunk.Data.data(), chunk.Data.size()))
+			{
+				return SimStateReadResult::Truncated;
+			}
+			snapshot.Chunks.push_back(std::move(chunk));
+		}
+
+		outSnapshot = std::move(snapshot);
+		return SimStateReadResult::Ok;
+	}
+
+	inline bool SaveToFile(const std::string& path, const SimStateSnapshot& snapshot)
+	{
+		const std::vector<uint8_t> bytes = Serialize(snapshot);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+		return file.good();
+	}
+
+	inline SimStateReadResult LoadFromFile(const std::string& path, SimStateSnapshot& outSnapshot)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return SimStateReadResult::FileNotFound;
+		}
+
+		const std::streamsize byteSize = file.tellg();
+		std::vector<uint8_t> bytes(size_t(std::max<std::streamsize>(byteSize, 0)));
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(bytes.data()), byteSize))
+		{
+			return SimStateReadResult::Truncated;
+		}
+		return Deserialize(bytes.data(), bytes.size(), outSnapshot);
+	}
+}
+
+enum class SimStateStorage : uint8_t
+{
+	GPU = 0, // Resource is a graphics API resource, moved through the renderer's backend
+	CPU,     // Resource points to Width * Height * ElementByteSize bytes of CPU memory
+};
+
+// Where one chunk of a sim's state lives
+struct SimStateBinding
+{
+	std::string Name;
+	SimStateStorage Storage = SimStateStorage::GPU;
+	void* Resource = nullptr;
+	uint32_t ElementByteSize = 0;
+	uint32_t Width = 0;
+	uint32_t Height = 1;
+};
+
+// Moves the content of sim bindings between where they live and CPU memory
+class ISimStateBackend
+{
+public:
+	virtual ~ISimStateBackend() {}
+	// outChunks[i] receives the content of bindings[i]
+	virtual void ReadBindings(const std::vector<SimStateBinding>& bindings, std::vector<SimStateChunk>& outChunks) = 0;
+	// chunks[i] has already been validated against bindings[i]
+	virtual void WriteBindings(const std::vector<SimStateBinding>& bindings, const std::vector<const SimStateChunk*>& chunks) = 0;
+};
+
+// CPU memory only backend: for sim state kept on the CPU, and for running snapshots without any GPU (eg: CPU reference sims)
+class NullSimStateBackend final : public ISimStateBackend
+{
+public:
+	virtual void ReadBindings(const std::vector<SimStateBinding>& bindings, std::vector<SimStateChunk>& outChunks) override
+	{
+		outChunks.resize(bindings.size());
+		for (size_t i = 0; i < bindings.size(); ++i)
+		{
+			const SimStateBinding& binding = bindings[i];
+			assert(binding.Storage == SimStateStorage::CPU && "The null backend can only read CPU memory");
+
+			SimStateChunk& chunk = outChunks[i];
+			chunk.Name = binding.Name;
+			chunk.ElementByteSize = binding.ElementByteSize;
+			chunk.Width = binding.Width;
+			chunk.Height = binding.Height;
+			chunk.Data.resize(size_t(chunk.GetExpectedByteSize()));
+			std::memcpy(chunk.Data.data(), binding.Resource, chunk.Data.size());
+		}
+	}
+
+	virtual void WriteBindings(const std::vector<SimStateBinding>& bindings, const std::vector<const SimStateChunk*>& chunks) override
+	{
+		for (size_t i = 0; i < bindings.size(); ++i)
+		{
+			assert(bindings[i].Storage == SimStateStorage::CPU && "The null backend can only write CPU memory");
+			std::memcpy(bindings[i].Resource, chunks[i]->Data.data(), chunks[i]->Data.size());
+		}
+	}
+};
+
+// Implemented by sims which can be snapshotted
+class ISimStateOwner
+{
+public:
+	virtual ~ISimStateOwner() {}
+	virtual std::string_view GetSimStateName() const = 0;
+	virtual uint32_t GetSimStateLayoutVersion() const = 0;
+	// Bindings holding the state the sim's next step starts from
+	virtual void GetSimStateBindings(std::vector<SimStateBinding>& outBindings) = 0;
+	// Called once restored bindings have been written, eg: to drop a pending reset
+	virtual void OnSimStateRestored() {}
+};
+
+enum class SimStateRestoreResult : uint8_t
+{
+	Ok = 0,
+	WrongSim,
+	LayoutVersionMismatch,
+	MissingChunk,
+	ChunkLayoutMismatch,
+};
+
+namespace SimStateSnapshots
+{
+	namespace Privates
+	{
+		inline void SplitByStorage(
+			const std::vector<SimStateBinding>& bindings,
+			std::vector<SimStateBinding>& outGPUBindings,
+			std::vector<SimStateBinding>& outCPUBindings)
+		{
+			for (const SimStateBinding& binding : bindings)
+			{
+				(binding.Storage == SimStateStorage::GPU ? outGPUBindings : outCPUBindings).push_back(binding);
+			}
+		}
+	}
+
+	// GPU bindings go through gpuBackend, CPU ones through the null backend
+	inline SimStateSnapshot Capture(ISimStateOwner& owner, ISimStateBackend& gpuBackend)
+	{
+		std::vector<SimStateBinding> bindings;
+		owner.GetSimStateBindings(bindings);
+
+		std::vector<SimStateBinding> gpuBindings;
+		std::vector<SimStateBinding> cpuBindings;
+		Privates::SplitByStorage(bindings, gpuBindings, cpuBindings);
+
+		SimStateSnapshot snapshot;
+		snapshot.SimName = owner.GetSimStateName();
+		snapshot.LayoutVersion = owner.GetSimStateLayoutVersion();
+
+		std::vector<SimStateChunk> chunks;
+		if (!gpuBindings.empty())
+		{
+			gpuBackend.ReadBindings(gpuBindings, chunks);
+			snapshot.Chunks.insert(snapshot.Chunks.end(), std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+		}
+
+		NullSimStateBackend cpuBackend;
+		cpuBackend.ReadBindings(cpuBindings, chunks);
+		snapshot.Chunks.insert(snapshot.Chunks.end(), std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+
+		return snapshot;
+	}
+
+	// Nothing is written unless every binding has a matching chunk
+	inline SimStateRestoreResult Restore(ISimStateOwner& owner, ISimStateBackend& gpuBackend, const SimStateSnapshot& snapshot)
+	{
+		if (snapshot.SimName != owner.GetSimStateName())
+		{
+			return SimStateRestoreResult::WrongSim;
+		}
+		if (snapshot.LayoutVersion != owner.GetSimStateLayoutVersion())
+		{
+			return SimStateRestoreResult::LayoutVersionMismatch;
+		}
+
+		std::vector<SimStateBinding> bindings;
+		owner.GetSimStateBindings(bindings);
+
+		std::vector<SimStateBinding> gpuBindings;
+		std::vector<SimStateBinding> cpuBindings;
+		Privates::SplitByStorage(bindings, gpuBindings, cpuBindings);
+
+		std::vector<const SimStateChunk*> gpuChunks;
+		std::vector<const SimStateChunk*> cpuChunks;
+		for (const SimStateBinding& binding : bindings)
+		{
+			const SimStateChunk* chunk = snapshot.FindChunk(binding.Name);
+			if (chunk == nullptr)
+			{
+				return SimStateRestoreResult::MissingChunk;
+			}
+			if (chunk->ElementByteSize != binding.ElementByteSize
+				|| chunk->Width != binding.Width
+				|| chunk->Height != binding.Height
+				|| chunk->Data.size() != chunk->GetExpectedByteSize())
+			{
+				return SimStateRestoreResult::ChunkLayoutMismatch;
+			}
+			(binding.Storage == SimStateStorage::GPU ? gpuChunks : cpuChunks).push_back(chunk);
+		}
+
+		if (!gpuBindings.empty())
+		{
+			gpuBackend.WriteBindings(gpuBindings, gpuChunks);
+		}
+
+		NullSimStateBackend cpuBackend;
+		cpuBackend.WriteBindings(cpuBindings, cpuChunks);
+
+		owner.OnSimStateRestored();
+		return SimStateRestoreResult::Ok;
+	}
+}
+
+// Save/load requests made from the UI, processed between frames by whoever owns the sims
+struct SimStateSnapshotRequests
+{
+	bool SaveRequested = false;
+	bool LoadRequested = false;
+	std::string LastResult; // Outcome of the last processed request, for display
+};
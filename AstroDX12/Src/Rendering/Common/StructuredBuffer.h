@@ -2,24 +2,58 @@
 
 #include <Common.h>
 #include <Rendering/Common/DescriptorHeap.h>
+#include <Rendering/Common/DirtyRangeTracker.h>
+#include <Rendering/Common/RendererContext.h>
 #include <Rendering/Common/RenderingUtils.h>
+#include <Rendering/Common/UploadRingBuffer.h>
 #include <vector>
 
 using namespace Microsoft::WRL;
 using namespace DX;
 
+// View creation shared by the structured buffer types, byte address views count elements in 4 bytes words
+namespace StructuredBufferViews
+{
+	static void CreateSRV(ID3D12Device* device, ID3D12Resource* resource, UINT elementCount, UINT elementByteSize, bool byteAddress, D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		srvDesc.Format = byteAddress ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = byteAddress ? (elementByteSize * elementCount / 4) : elementCount;
+		srvDesc.Buffer.StructureByteStride = byteAddress ? 0 : elementByteSize;
+		srvDesc.Buffer.Flags = byteAddress ? D3D12_BUFFER_SRV_FLAG_RAW : D3D12_BUFFER_SRV_FLAG_NONE;
+
+		device->CreateShaderResourceView(resource, &srvDesc, cpuDescriptorHandle);
+	}
+
+	static void CreateUAV(ID3D12Device* device, ID3D12Resource* resource, UINT elementCount, UINT elementByteSize, bool byteAddress, D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle)
+	{
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+		uavDesc.Format = byteAddress ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements = byteAddress ? (elementByteSize * elementCount / 4) : elementCount;
+		uavDesc.Buffer.StructureByteStride = byteAddress ? 0 : elementByteSize;
+		uavDesc.Buffer.CounterOffsetInBytes = 0;
+		uavDesc.Buffer.Flags = byteAddress ? D3D12_BUFFER_UAV_FLAG_RAW : D3D12_BUFFER_UAV_FLAG_NONE;
+
+		device->CreateUnorderedAccessView(resource, nullptr, &uavDesc, cpuDescriptorHandle);
+	}
+}
+
 class IStructuredBuffer
 {
 public:
 	virtual void Init(
-		ID3D12Device* device, 
-		ID3D12GraphicsCommandList* cmdList,
+		RendererContext& rendererContext,
 		std::wstring_view bufferName, 
 		bool needSRV,
 		bool needUAV, 
-		DescriptorHeap& descriptorHeap, 
 		bool viewsAreByteAddress = false) = 0;
-	virtual void DisposeUploadBuffer() = 0;
 };
 
 template<typename T>
@@ -29,7 +63,7 @@ public:
 	StructuredBuffer(std::vector<T> bufferData)
 		: m_elementByteSize(sizeof(T))
 		, m_defaultBuffer()
-		, m_mappedData(nullptr)
+		, m_uploadRing(nullptr)
 		, SrvIndex(-1)
 		, UavIndex(-1)
 		, m_initialised(false)
@@ -39,58 +73,48 @@ public:
 
 	virtual ~StructuredBuffer()
 	{
-		if (m_uploadBuffer)
+		if (m_resourceStates && m_defaultBuffer)
 		{
-			m_uploadBuffer->Unmap(0, nullptr);
+			m_resourceStates->UnregisterResource(m_defaultBuffer.Get());
 		}
-
-		m_mappedData = nullptr;
+		m_uploadRing = nullptr;
 	}
 
-	virtual void Init(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::wstring_view bufferName, bool needSRV, bool needUAV, DescriptorHeap& descriptorHeap, bool viewsAreByteAddress = false) override
+	virtual void Init(RendererContext& rendererContext, std::wstring_view bufferName, bool needSRV, bool needUAV, bool viewsAreByteAddress = false) override
 	{
-		// Creates both he default buffer and the "helper" upload buffer + adds the copy of data resources copy to the command list
+		ID3D12Device* device = rendererContext.Device.Get();
+		DescriptorHeap& descriptorHeap = *rendererContext.GlobalCBVSRVUAVDescriptorHeap.lock();
+		UploadRingBuffer& uploadRing = *rendererContext.UploadRing.lock();
+		m_resourceStates = rendererContext.ResourceStates.lock().get();
+
+		// Creates the default buffer + adds the copy of the initial data (staged in the upload ring) to the command list
 		m_defaultBuffer = AstroTools::Rendering::CreateDefaultBuffer(
-			device,
-			cmdList,
+			rendererContext.ResourceAllocator.lock(),
+			m_defaultBufferMemory,
+			rendererContext.CommandList.Get(),
+			*m_resourceStates,
 			m_dataVector.data(),
 			m_dataVector.size() * m_elementByteSize,
 			needUAV,
 			bufferName,
-			m_uploadBuffer);
+			uploadRing);
 
-		// Assigns a pointer to m_mappedData that points to the subresource 0 inside the "uploadBuffer" I3D12Resource
-		// This way we can modify the contents of the upload buffer using CopyData()
-		// TODO: But somewhere we'll presumably still need to force a copy of subresource from the upload buffer to the default buffer (post initialisation if we modify it at runtime)
-		ThrowIfFailed(m_uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedData)));
+		// Later updates (CopyData) are staged through the same ring, no upload memory is owned by the buffer itself
+		m_uploadRing = &uploadRing;
 
 		m_initialised = true;
 
 		if (needSRV)
 		{
 			SrvIndex = descriptorHeap.GetCurrentDescriptorHeapHandle();
-			if (viewsAreByteAddress)
-			{
-				CreateByteAddressSRV(device, descriptorHeap.GetCPUDescriptorHandleByIndex(SrvIndex));
-			}
-			else
-			{
-				CreateSRV(device, descriptorHeap.GetCPUDescriptorHandleByIndex(SrvIndex));
-			}
+			StructuredBufferViews::CreateSRV(device, Resource(), UINT(m_dataVector.size()), m_elementByteSize, viewsAreByteAddress, descriptorHeap.GetCPUDescriptorHandleByIndex(SrvIndex));
 			descriptorHeap.IncreaseCurrentDescriptorHeapHandle();
 		}
 		
 		if (needUAV)
 		{
 			UavIndex = descriptorHeap.GetCurrentDescriptorHeapHandle();
-			if (viewsAreByteAddress)
-			{
-				CreateByteAddressUAV(device, descriptorHeap.GetCPUDescriptorHandleByIndex(UavIndex));
-			}
-			else
-			{
-				CreateUAV(device, descriptorHeap.GetCPUDescriptorHandleByIndex(UavIndex));
-			}
+			StructuredBufferViews::CreateUAV(device, Resource(), UINT(m_dataVector.size()), m_elementByteSize, viewsAreByteAddress, descriptorHeap.GetCPUDescriptorHandleByIndex(UavIndex));
 			descriptorHeap.IncreaseCurrentDescriptorHeapHandle();
 		}
 	}
@@ -104,129 +128,133 @@ public:
 		return m_defaultBuffer.Get();
 	}
 
-	void CopyData(const std::vector<T>& data)
+	// Stages data in the upload ring and records its copy into the default buffer.
+	// The transition back to the state the buffer was in is only queued: it goes out with the next FlushBarriers, which must happen before the buffer is read.
+	void CopyData(ID3D12GraphicsCommandList* cmdList, const std::vector<T>& data)
 	{
 		assert(m_initialised);
-		memcpy(&m_mappedData, data.data(), sizeof(T) * data.size());
-		//TODO: schedule copy of subresource in uploadbuffer to common buffer (using cmd list) to push the data to fast GPU visible memory
+		assert(data.size() <= m_dataVector.size());
+
+		const UINT64 byteSize = UINT64(data.size()) * m_elementByteSize;
+		const UploadAllocation uploadAllocation = m_uploadRing->Allocate(byteSize);
+		memcpy(uploadAllocation.CPUAddress, data.data(), byteSize);
+
+		// Keep the CPU copy in sync, dirty elements are uploaded from it
+		std::copy(data.begin(), data.end(), m_dataVector.begin());
+
+		const D3D12_RESOURCE_STATES previousState = m_resourceStates->GetState(m_defaultBuffer.Get());
+		m_resourceStates->Transition(m_defaultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+		m_resourceStates->FlushBarriers(cmdList);
+
+		cmdList->CopyBufferRegion(
+			m_defaultBuffer.Get(), 0,
+			uploadAllocation.Resource, uploadAllocation.Offset,
+			byteSize);
+
+		m_resourceStates->Transition(m_defaultBuffer.Get(), previousState);
 	}
 
-	UINT ByteSize()
+	// Updates the CPU copy of an element, it's uploaded by the next FlushDirtyElements
+	void SetElement(size_t elementIndex, const T& value)
 	{
-		return m_elementByteSize;
+		assert(elementIndex < m_dataVector.size());
+		m_dataVector[elementIndex] = value;
+		m_dirtyRanges.MarkDirty(elementIndex);
 	}
 
-	// returns the descriptor index of an element in the descriptor heap this resource has a SRV for
-	int32_t GetSRVIndex() const 
+	const T& GetElement(size_t elementIndex) const
 	{
-		return SrvIndex;
+		return m_dataVector[elementIndex];
 	}
 
-	// returns the descriptor index of an element in the descriptor heap this resource has a SRV for
-	int32_t GetUAVIndex() const 
+	size_t GetElementCount() const
 	{
-		DX::astro_assert(UavIndex!= -1, "UAV Index is invalid, UAV hasn't been initialised");
+		return m_dataVector.size();
+	}
 
-		return UavIndex;
+	bool HasDirtyElements() const
+	{
+		return !m_dirtyRanges.IsEmpty();
 	}
 
-	// Resets the default buffer contents to zero by copying from the upload buffer (which is pre-initialized to 0).
-	// Must be called on the GPU timeline via a command list.
-	void ResetToZero(ID3D12GraphicsCommandList* cmdList)
+	// Uploads the elements modified since the last flush, one CopyBufferRegion per coalesced range, all staged in a single upload ring allocation.
+	// Ranges closer than maxGapElements are merged, trading a few re-uploaded clean elements for fewer copies.
+	// Like CopyData, the transition back to the previous state is queued for the next FlushBarriers. Returns the amount of copies recorded.
+	size_t FlushDirtyElements(ID3D12GraphicsCommandList* cmdList, size_t maxGapElements = 0)
 	{
 		assert(m_initialised);
+		if (m_dirtyRanges.IsEmpty())
+		{
+			return 0;
+		}
 
-		auto barrierToCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_defaultBuffer.Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_COPY_DEST);
-		cmdList->ResourceBarrier(1, &barrierToCopyDest);
+		const std::vector<DirtyRange> dirtyRanges = m_dirtyRanges.GetCoalescedRanges(maxGapElements);
+		m_dirtyRanges.Clear();
 
-		cmdList->CopyBufferRegion(
-			m_defaultBuffer.Get(), 0,
-			m_uploadBuffer.Get(), 0,
-			m_dataVector.size() * m_elementByteSize);
-
-		auto barrierToUAV = CD3DX12_RESOURCE_BARRIER::Transition(
-			m_defaultBuffer.Get(),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		cmdList->ResourceBarrier(1, &barrierToUAV);
-	}
+		size_t dirtyElementCount = 0;
+		for (const DirtyRange& range : dirtyRanges)
+		{
+			dirtyElementCount += range.Count();
+		}
 
-	virtual void DisposeUploadBuffer() override
-	{
-		m_uploadBuffer = nullptr;
-	}
+		// Ranges are packed back to back in the upload memory, buffer to buffer copies have no alignment requirement
+		const UploadAllocation uploadAllocation = m_uploadRing->Allocate(UINT64(dirtyElementCount) * m_elementByteSize);
+		UINT64 uploadOffset = 0;
+		for (const DirtyRange& range : dirtyRanges)
+		{
+			memcpy(uploadAllocation.CPUAddress + uploadOffset, &m_dataVector[range.Begin], range.Count() * m_elementByteSize);
+			uploadOffset += UINT64(range.Count()) * m_elementByteSize;
+		}
 
-private:
-	void CreateSRV(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle)
-	{
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		const D3D12_RESOURCE_STATES previousState = m_resourceStates->GetState(m_defaultBuffer.Get());
+		m_resourceStates->Transition(m_defaultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+		m_resourceStates->FlushBarriers(cmdList);
 
-		srvDesc.Buffer.FirstElement = 0;
-		srvDesc.Buffer.NumElements = UINT(m_dataVector.size());
-		srvDesc.Buffer.StructureByteStride = m_elementByteSize;
-		srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+		uploadOffset = 0;
+		for (const DirtyRange& range : dirtyRanges)
+		{
+			const UINT64 rangeByteSize = UINT64(range.Count()) * m_elementByteSize;
+			cmdList->CopyBufferRegion(
+				m_defaultBuffer.Get(), UINT64(range.Begin) * m_elementByteSize,
+				uploadAllocation.Resource, uploadAllocation.Offset + uploadOffset,
+				rangeByteSize);
+			uploadOffset += rangeByteSize;
+		}
+
+		m_resourceStates->Transition(m_defaultBuffer.Get(), previousState);
 
-		device->CreateShaderResourceView(Resource(),  &srvDesc, cpuDescriptorHandle);
+		return dirtyRanges.size();
 	}
 
-	void CreateByteAddressSRV(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle)
+	UINT ByteSize()
 	{
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
-		srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-
-		srvDesc.Buffer.FirstElement = 0;
-		srvDesc.Buffer.NumElements = UINT(sizeof(m_dataVector[0]) * m_dataVector.size() / 4); // elements for byteAddressBuffer is measured in number of 4 bytes
-		srvDesc.Buffer.StructureByteStride = 0;
-		srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-
-		device->CreateShaderResourceView(Resource(), &srvDesc, cpuDescriptorHandle);
+		return m_elementByteSize;
 	}
 
-	void CreateUAV(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle)
+	// returns the descriptor index of an element in the descriptor heap this resource has a SRV for
+	int32_t GetSRVIndex() const 
 	{
-		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc;
-		uavDesc.Format = DXGI_FORMAT_UNKNOWN;
-		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-
-		uavDesc.Buffer.FirstElement = 0;
-		uavDesc.Buffer.NumElements = UINT(m_dataVector.size());
-		uavDesc.Buffer.StructureByteStride = m_elementByteSize;
-		uavDesc.Buffer.CounterOffsetInBytes = 0;
-		uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-
-		device->CreateUnorderedAccessView(Resource(), nullptr, &uavDesc, cpuDescriptorHandle);
+		return SrvIndex;
 	}
 
-	void CreateByteAddressUAV(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE cpuDescriptorHandle)
+	// returns the descriptor index of an element in the descriptor heap this resource has a SRV for
+	int32_t GetUAVIndex() const 
 	{
-		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc;
-		uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-
-		uavDesc.Buffer.FirstElement = 0;
-		uavDesc.Buffer.NumElements = UINT(sizeof(m_dataVector[0]) * m_dataVector.size() / 4); // elements for byteAddressBuffer is measured in number of 4 bytes
-		uavDesc.Buffer.StructureByteStride = 0;
-		uavDesc.Buffer.CounterOffsetInBytes = 0;
-		uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+		DX::astro_assert(UavIndex!= -1, "UAV Index is invalid, UAV hasn't been initialised");
 
-		device->CreateUnorderedAccessView(Resource(), nullptr, &uavDesc, cpuDescriptorHandle);
+		return UavIndex;
 	}
 
+private:
 	UINT m_elementByteSize{ -1 };
+	PlacedResourceMemory m_defaultBufferMemory; // Declared before the resource so it outlives it
 	ComPtr<ID3D12Resource> m_defaultBuffer{ nullptr };
-	ComPtr<ID3D12Resource> m_uploadBuffer{ nullptr };
-	BYTE* m_mappedData{ nullptr };
+	UploadRingBuffer* m_uploadRing{ nullptr };
+	ResourceBarrierBatcher* m_resourceStates{ nullptr };
 	int32_t SrvIndex{-1};
 	int32_t UavIndex{ -1 };
 	bool m_initialised{ false };
 
 	std::vector<T> m_dataVector{};
+	DirtyRangeTracker m_dirtyRanges;
 };
\ No newline at end of file
@@ -42,6 +42,10 @@ public:
 
 	virtual ~Texture3D()
 	{
+		if (m_resourceStates && m_texture3DResource)
+		{
+			m_resourceStates->UnregisterResource(m_texture3DResource.Get());
+		}
 	}
 
 	ID3D12Resource* Resource() const 
@@ -66,7 +70,8 @@ public:
 		) override
 	{
 		m_texture3DResource = AstroTools::Rendering::CreateTexture3D(
-			rendererContext.Device.Get(),
+			rendererContext.ResourceAllocator.lock(),
+			m_texture3DMemory,
 			needUAV,
 			format,
 			width,
@@ -80,6 +85,9 @@ public:
 
 		m_texture3DResource->SetName( name.c_str() );
 
+		m_resourceStates = rendererContext.ResourceStates.lock().get();
+		m_resourceStates->RegisterResource(m_texture3DResource.Get(), initialResourceState, m_texture3DResource->GetDesc().MipLevels);
+
 		// Create UAV and SRV
 		if (needUAV)
 		{
@@ -135,7 +143,9 @@ public:
 	}
 
 private:
+	PlacedResourceMemory m_texture3DMemory; // Declared before the resource so it outlives it
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_texture3DResource;
+	ResourceBarrierBatcher* m_resourceStates = nullptr;
 	int32_t m_uavIndex = -1;
 	int32_t m_srvIndex = -1;
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Platform independent bookkeeping for a linear upload ring.
+// Offsets are handed out front to back, wrapping to the start when an allocation doesn't fit before the end.
+// Everything allocated between two FinishFrame calls is tagged with that frame's fence value,
+// and is only released once ReclaimCompleted is given a completed fence value >= that tag.
+// No graphics API types in here, so the wrap/reclaim logic can be exercised on its own with a fake fence.
+class UploadRingAllocator final
+{
+public:
+	static constexpr uint64_t InvalidOffset = ~0ull;
+
+	explicit UploadRingAllocator(uint64_t capacity)
+		: m_capacity(capacity)
+	{
+		assert(capacity > 0);
+	}
+
+	// Returns the offset of the allocation inside the ring, or InvalidOffset if there isn't enough free space
+	// (either because the ring is full of in-flight data, or the request is bigger than the ring itself)
+	uint64_t Allocate(uint64_t byteSize, uint64_t alignment)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of 2");
+		if (byteSize == 0 || byteSize > m_capacity)
+		{
+			return InvalidOffset;
+		}
+
+		const uint64_t head = m_allocatedTotal % m_capacity;
+		uint64_t offset = AlignUp(head, alignment);
+		uint64_t padding = offset - head;
+		if (offset + byteSize > m_capacity)
+		{
+			// Doesn't fit before the end, skip the remainder of the ring and start again from 0
+			padding = m_capacity - head;
+			offset = 0;
+		}
+
+		if (GetUsedBytes() + padding + byteSize > m_capacity)
+		{
+			return InvalidOffset;
+		}
+
+		// Padding is accounted for as used memory, this keeps head == m_allocatedTotal % m_capacity
+		m_allocatedTotal += padding + byteSize;
+		return offset;
+	}
+
+	// Tags every allocation made since the previous call with fenceValue (fence values must be increasing)
+	void FinishFrame(uint64_t fenceValue)
+	{
+		assert(m_inFlightFrames.empty() || m_inFlightFrames.back().FenceValue <= fenceValue);
+		if (!m_inFlightFrames.empty() && m_inFlightFrames.back().AllocatedTotal == m_allocatedTotal)
+		{
+			// Nothing new was allocated, just extend the previous marker to the newer fence
+			m_inFlightFrames.back().FenceValue = fenceValue;
+			return;
+		}
+		m_inFlightFrames.push_back({ fenceValue, m_allocatedTotal });
+	}
+
+	// Releases memory of every frame whose fence value has been reached by the GPU
+	void ReclaimCompleted(uint64_t completedFenceValue)
+	{
+		while (!m_inFlightFrames.empty() && m_inFlightFrames.front().FenceValue <= completedFenceValue)
+		{
+			m_releasedTotal = m_inFlightFrames.front().AllocatedTotal;
+			m_inFlightFrames.pop_front();
+		}
+	}
+
+	uint64_t GetCapacity() const { return m_capacity; }
+	uint64_t GetUsedBytes() const { return m_allocatedTotal - m_releasedTotal; }
+	uint64_t GetFreeBytes() const { return m_capacity - GetUsedBytes(); }
+	size_t GetInFlightFrameCount() const { return m_inFlightFrames.size(); }
+
+private:
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	struct FrameMarker
+	{
+		uint64_t FenceValue;
+		uint64_t AllocatedTotal; // Value of m_allocatedTotal when the frame was finished
+	};
+
+	uint64_t m_capacity{ 0 };
+	// Both totals only ever grow, the difference is what's currently in flight
+	uint64_t m_allocatedTotal{ 0 };
+	uint64_t m_releasedTotal{ 0 };
+	std::deque<FrameMarker> m_inFlightFrames;
+};
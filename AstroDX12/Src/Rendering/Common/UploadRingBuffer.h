@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Common.h>
+#include <deque>
+#include <vector>
+#include <Rendering/Common/UploadRingAllocator.h>
+
+using namespace Microsoft::WRL;
+using namespace DX;
+
+// A CPU writable slice of upload memory, valid until the GPU has passed the fence of the frame it was allocated in
+struct UploadAllocation
+{
+	ID3D12Resource* Resource = nullptr;
+	UINT64 Offset = 0;
+	BYTE* CPUAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GPUAddress = 0;
+};
+
+// One large persistently mapped upload heap shared by all initial data uploads, per-frame constants & dynamic buffer updates.
+// Allocations are tagged with the fence of the frame they are recorded in (FinishFrame) and recycled once that fence completed (ReclaimCompleted).
+class UploadRingBuffer final
+{
+public:
+	UploadRingBuffer(ID3D12Device* device, UINT64 capacity)
+		: m_device(device)
+		, m_allocator(capacity)
+		, m_mappedData(nullptr)
+	{
+		const auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heapProp,
+			D3D12_HEAP_FLAG_NONE,
+			&bufferDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&m_uploadBuffer)
+		));
+		m_uploadBuffer->SetName(L"UploadRingBuffer");
+
+		// Upload heaps can stay mapped for their whole lifetime, CPU writes are write-combined
+		ThrowIfFailed(m_uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_mappedData)));
+	}
+
+	~UploadRingBuffer()
+	{
+		if (m_uploadBuffer)
+		{
+			m_uploadBuffer->Unmap(0, nullptr);
+		}
+		m_mappedData = nullptr;
+	}
+
+	UploadRingBuffer(const UploadRingBuffer& rhs) = delete;
+	UploadRingBuffer& operator=(const UploadRingBuffer& rhs) = delete;
+
+	// Alignment defaults to the constant buffer placement alignment, which also satisfies CopyBufferRegion
+	UploadAllocation Allocate(UINT64 byteSize, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT)
+	{
+		const UINT64 offset = m_allocator.Allocate(byteSize, alignment);
+		if (offset == UploadRingAllocator::InvalidOffset)
+		{
+			return AllocateDedicated(byteSize);
+		}
+
+		UploadAllocation allocation;
+		allocation.Resource = m_uploadBuffer.Get();
+		allocation.Offset = offset;
+		allocation.CPUAddress = m_mappedData + offset;
+		allocation.GPUAddress = m_uploadBuffer->GetGPUVirtualAddress() + offset;
+		return allocation;
+	}
+
+	// Everything allocated since the last call will be in use by the GPU until fenceValue is signaled
+	void FinishFrame(UINT64 fenceValue)
+	{
+		m_allocator.FinishFrame(fenceValue);
+
+		for (auto& dedicatedBuffer : m_pendingDedicatedBuffers)
+		{
+			m_retiredDedicatedBuffers.push_back({ fenceValue, dedicatedBuffer });
+		}
+		m_pendingDedicatedBuffers.clear();
+	}
+
+	void ReclaimCompleted(UINT64 completedFenceValue)
+	{
+		m_allocator.ReclaimCompleted(completedFenceValue);
+
+		while (!m_retiredDedicatedBuffers.empty() && m_retiredDedicatedBuffers.front().FenceValue <= completedFenceValue)
+		{
+			m_retiredDedicatedBuffers.pop_front();
+		}
+	}
+
+	UINT64 GetCapacity() const { return m_allocator.GetCapacity(); }
+	UINT64 GetUsedBytes() const { return m_allocator.GetUsedBytes(); }
+
+private:
+	// Fallback for requests that don't fit in the ring right now (or ever, eg: very large initial buffers).
+	// The resource is kept alive the same way as ring memory, until the fence of its frame completes.
+	UploadAllocation AllocateDedicated(UINT64 byteSize)
+	{
+		ComPtr<ID3D12Resource> dedicatedBuffer;
+		const auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&heapProp,
+			D3D12_HEAP_FLAG_NONE,
+			&bufferDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&dedicatedBuffer)
+		));
+
+		// Dedicated buffers are written once then released, no need to unmap them before destruction
+		BYTE* mappedData = nullptr;
+		ThrowIfFailed(dedicatedBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+
+		m_pendingDedicatedBuffers.push_back(dedicatedBuffer);
+
+		UploadAllocation allocation;
+		allocation.Resource = dedicatedBuffer.Get();
+		allocation.Offset = 0;
+		allocation.CPUAddress = mappedData;
+		allocation.GPUAddress = dedicatedBuffer->GetGPUVirtualAddress();
+		return allocation;
+	}
+
+	struct RetiredBuffer
+	{
+		UINT64 FenceValue;
+		ComPtr<ID3D12Resource> Buffer;
+	};
+
+	ComPtr<ID3D12Device> m_device;
+	UploadRingAllocator m_allocator;
+	ComPtr<ID3D12Resource> m_uploadBuffer;
+	BYTE* m_mappedData;
+
+	std::vector<ComPtr<ID3D12Resource>> m_pendingDedicatedBuffers;
+	std::deque<RetiredBuffer> m_retiredDedicatedBuffers;
+};
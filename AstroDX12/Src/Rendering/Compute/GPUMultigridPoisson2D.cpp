@@ -0,0 +1,158 @@
+#include "GPUMultigridPoisson2D.h"
+
+#include <Rendering/IRenderer.h>
+#include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RendererContext.h>
+#include <Rendering/Common/ResourceBarrierBatcher.h>
+#include <string>
+
+void GPUMultigridPoisson2D::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, uint32_t resolution, const MultigridPoisson::VCycleSettings& settings)
+{
+	DX::astro_assert(settings.CoarsestResolution == CoarsestResolution, "GPUMultigridPoisson2D: the coarsest level is solved by a single group of MULTIGRID_COARSEST_RESOLUTION^2 threads");
+	DX::astro_assert(resolution >= CoarsestResolution && resolution % CoarsestResolution == 0 && ((resolution / CoarsestResolution) & (resolution / CoarsestResolution - 1)) == 0,
+		"GPUMultigridPoisson2D: the resolution has to halve down to the coarsest one");
+
+	m_resolution = resolution;
+	m_settings = settings;
+	m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
+	const uint32_t levelCount = MultigridPoisson::GetLevelCount(resolution, settings);
+	for (uint32_t levelIdx = 1; levelIdx < levelCount; ++levelIdx)
+	{
+		const uint32_t levelResolution = resolution >> levelIdx;
+		const std::wstring levelName = L"MultigridPoisson2D::Level" + std::to_wstring(levelIdx);
+
+		Level& level = m_coarseLevels.emplace_back(Level{ std::make_unique<RenderTarget>(), std::make_unique<RenderTarget>() });
+		renderer->InitialiseRenderTarget(level.Solution.get(), (levelName + L"::Solution").c_str(), levelResolution, levelResolution, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		renderer->InitialiseRenderTarget(level.Rhs.get(), (levelName + L"::Rhs").c_str(), levelResolution, levelResolution, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
+
+	std::vector<D3D12_ROOT_PARAMETER1> slotRootParams;
+	const D3D12_ROOT_PARAMETER1 rootParamBindlessResourceIndices
+	{
+		.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+		.Constants
+		{
+			.ShaderRegister = 0,
+			.RegisterSpace = 0,
+			.Num32BitValues = sizeof(RootConstants) / sizeof(int32_t)
+		},
+		.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
+	};
+	slotRootParams.push_back(rootParamBindlessResourceIndices);
+
+	// Root signature is an array of root parameters
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc(
+		(UINT)slotRootParams.size(),
+		slotRootParams.data(),
+		0,
+		nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED
+	);
+
+	// Create the root signature
+	ComPtr<ID3DBlob> serializedRootSignature = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeVersionedRootSignature(
+		&rootSignatureDesc,
+		serializedRootSignature.GetAddressOf(),
+		errorBlob.GetAddressOf());
+	if (errorBlob)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	renderer->CreateRootSignature(serializedRootSignature, m_rootSignature);
+
+	const auto computeShaderPath = s2ws(DX::GetWorkingDirectory()) + std::wstring(L"\\Shaders\\FluidSim\\Multigrid.hlsl");
+	const auto createPSO = [&](const wchar_t* entryPoint, ComPtr<ID3D12PipelineState>& outPSO)
+	{
+		auto computeShader = shaderLibrary.GetCompiledShader(computeShaderPath, entryPoint, {}, L"cs_6_6");
+		renderer->CreateComputePipelineState(outPSO, m_rootSignature, computeShader);
+	};
+	createPSO(L"CSSmoothRedBlack", m_psoSmoothRedBlack);
+	createPSO(L"CSRestrictResidual", m_psoRestrictResidual);
+	createPSO(L"CSProlongate", m_psoProlongate);
+	createPSO(L"CSSolveCoarsest", m_psoSolveCoarsest);
+}
+
+void GPUMultigridPoisson2D::Dispatch(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* pso, const RootConstants& constants, uint32_t groupCountX, uint32_t groupCountY) const
+{
+	m_resourceStates->FlushBarriers(cmdList);
+
+	cmdList->SetComputeRootSignature(m_rootSignature.Get());
+	cmdList->SetPipelineState(pso);
+	cmdList->SetComputeRoot32BitConstants(0, sizeof(RootConstants) / sizeof(int32_t), &constants, 0);
+	cmdList->Dispatch(groupCountX, groupCountY, 1);
+}
+
+void GPUMultigridPoisson2D::Smooth(ID3D12GraphicsCommandList* cmdList, RenderTarget& solution, RenderTarget& rhs, uint32_t resolution, uint32_t sweepCount, uint32_t firstColourPassIdx) const
+{
+	RootConstants constants;
+	constants.SolutionTex = solution.GetUAVIndex();
+	constants.RhsTex = rhs.GetUAVIndex();
+	constants.Resolution = int32_t(resolution);
+
+	// Each colour reads the other one's latest values
+	for (uint32_t colourPassIdx = firstColourPassIdx; colourPassIdx < sweepCount * 2; ++colourPassIdx)
+	{
+		m_resourceStates->UAVRead(rhs.GetResource());
+		m_resourceStates->UAVWrite(solution.GetResource());
+
+		constants.Parity = colourPassIdx & 1;
+		Dispatch(cmdList, m_psoSmoothRedBlack.Get(), constants, GetGroupCount(resolution / 2), GetGroupCount(resolution));
+	}
+}
+
+void GPUMultigridPoisson2D::VCycleLevel(ID3D12GraphicsCommandList* cmdList, uint32_t levelIdx, RenderTarget& solution, RenderTarget& rhs, uint32_t firstColourPassIdx) const
+{
+	const uint32_t resolution = m_resolution >> levelIdx;
+	if (levelIdx == m_coarseLevels.size())
+	{
+		m_resourceStates->UAVRead(rhs.GetResource());
+		m_resourceStates->UAVWrite(solution.GetResource());
+
+		RootConstants constants;
+		constants.SolutionTex = solution.GetUAVIndex();
+		constants.RhsTex = rhs.GetUAVIndex();
+		constants.Resolution = int32_t(resolution);
+		constants.SweepCount = m_settings.CoarsestSweepCount;
+		Dispatch(cmdList, m_psoSolveCoarsest.Get(), constants, 1, 1);
+		return;
+	}
+
+	Smooth(cmdList, solution, rhs, resolution, m_settings.PreSmoothSweepCount, firstColourPassIdx);
+
+	const Level& coarse = m_coarseLevels[levelIdx];
+	RootConstants constants;
+	constants.SolutionTex = solution.GetUAVIndex();
+	constants.RhsTex = rhs.GetUAVIndex();
+	constants.CoarseSolutionTex = coarse.Solution->GetUAVIndex();
+	constants.CoarseRhsTex = coarse.Rhs->GetUAVIndex();
+	constants.Resolution = int32_t(resolution);
+
+	m_resourceStates->UAVRead(solution.GetResource());
+	m_resourceStates->UAVRead(rhs.GetResource());
+	m_resourceStates->UAVWrite(coarse.Solution->GetResource());
+	m_resourceStates->UAVWrite(coarse.Rhs->GetResource());
+	Dispatch(cmdList, m_psoRestrictResidual.Get(), constants, GetGroupCount(resolution / 2), GetGroupCount(resolution / 2));
+
+	VCycleLevel(cmdList, levelIdx + 1, *coarse.Solution, *coarse.Rhs, 0);
+
+	m_resourceStates->UAVRead(coarse.Solution->GetResource());
+	m_resourceStates->UAVWrite(solution.GetResource());
+	Dispatch(cmdList, m_psoProlongate.Get(), constants, GetGroupCount(resolution), GetGroupCount(resolution));
+
+	Smooth(cmdList, solution, rhs, resolution, m_settings.PostSmoothSweepCount, 0);
+}
+
+void GPUMultigridPoisson2D::Solve(ID3D12GraphicsCommandList* cmdList, RenderTarget& solution, RenderTarget& rhs, uint32_t vCycleCount, bool firstRedPassDone) const
+{
+	PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "GPUMultigridPoisson2D::Solve");
+
+	for (uint32_t vCycleIdx = 0; vCycleIdx < vCycleCount; ++vCycleIdx)
+	{
+		VCycleLevel(cmdList, 0, solution, rhs, (firstRedPassDone && vCycleIdx == 0) ? 1 : 0);
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Common.h>
+#include <Rendering/Common/RenderTarget.h>
+#include <Simulation/MultigridPoisson.h>
+#include <memory>
+#include <vector>
+
+class IRenderer;
+class ResourceBarrierBatcher;
+namespace AstroTools::Rendering
+{
+	class ShaderLibrary;
+}
+
+using Microsoft::WRL::ComPtr;
+
+// Records the multigrid V-cycles of Shaders/FluidSim/Multigrid.hlsl, solving L x = b for a square solution & right hand side.
+// The solution is R32_FLOAT or R16_FLOAT (FluidSim2D's pressure with HalfPrecisionPressure), the coarse levels are always R32_FLOAT.
+// Owns the coarse levels, the full resolution textures are the caller's. They go through the resource state tracker & are left as UAVs.
+// MultigridPoisson is the CPU reference, see it for the operator & the boundaries.
+class GPUMultigridPoisson2D
+{
+public:
+	static constexpr uint32_t CoarsestResolution = 16; // MULTIGRID_COARSEST_RESOLUTION
+	static constexpr uint32_t ThreadGroupSize = 8; // MULTIGRID_THREAD_GROUP_SIZE
+
+	// resolution is a power of 2 multiple of CoarsestResolution
+	void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, uint32_t resolution, const MultigridPoisson::VCycleSettings& settings = {});
+
+	// Improves solution in place, starting from whatever it holds.
+	// firstRedPassDone: solution holds MultigridPoisson::RedPassFromZero's output, written by the kernel producing rhs, & the first colour pass is skipped.
+	void Solve(ID3D12GraphicsCommandList* cmdList, RenderTarget& solution, RenderTarget& rhs, uint32_t vCycleCount, bool firstRedPassDone = false) const;
+
+	uint32_t GetDispatchCountPerVCycle() const
+	{
+		return MultigridPoisson::GetDispatchCountPerVCycle(m_resolution, m_settings);
+	}
+
+private:
+	struct RootConstants
+	{
+		int32_t SolutionTex = -1;
+		int32_t RhsTex = -1;
+		int32_t CoarseSolutionTex = -1;
+		int32_t CoarseRhsTex = -1;
+		int32_t Resolution = 0;
+		uint32_t Parity = 0;
+		uint32_t SweepCount = 0;
+	};
+
+	struct Level
+	{
+		std::unique_ptr<RenderTarget> Solution;
+		std::unique_ptr<RenderTarget> Rhs;
+	};
+
+	void Dispatch(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* pso, const RootConstants& constants, uint32_t groupCountX, uint32_t groupCountY) const;
+	void Smooth(ID3D12GraphicsCommandList* cmdList, RenderTarget& solution, RenderTarget& rhs, uint32_t resolution, uint32_t sweepCount, uint32_t firstColourPassIdx) const;
+	void VCycleLevel(ID3D12GraphicsCommandList* cmdList, uint32_t levelIdx, RenderTarget& solution, RenderTarget& rhs, uint32_t firstColourPassIdx) const;
+
+	static uint32_t GetGroupCount(uint32_t threadCount)
+	{
+		return (threadCount + ThreadGroupSize - 1) / ThreadGroupSize;
+	}
+
+	uint32_t m_resolution = 0;
+	MultigridPoisson::VCycleSettings m_settings;
+	std::vector<Level> m_coarseLevels; // Level i + 1, half the resolution of level i
+
+	ComPtr<ID3D12RootSignature> m_rootSignature;
+	ComPtr<ID3D12PipelineState> m_psoSmoothRedBlack;
+	ComPtr<ID3D12PipelineState> m_psoRestrictResidual;
+	ComPtr<ID3D12PipelineState> m_psoProlongate;
+	ComPtr<ID3D12PipelineState> m_psoSolveCoarsest;
+
+	ResourceBarrierBatcher* m_resourceStates = nullptr;
+};
@@ -0,0 +1,283 @@
+#include "GPUParallelPrimitives.h"
+
+#include <Rendering/IRenderer.h>
+#include <Rendering/Common/ShaderLibrary.h>
+#include <Rendering/Common/RendererContext.h>
+#include <Rendering/Common/ResourceBarrierBatcher.h>
+#include <algorithm>
+
+void GPUParallelPrimitives::Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, uint32_t maxElementCount)
+{
+	m_maxElementCount = maxElementCount;
+	m_resourceStates = renderer->GetRendererContext().ResourceStates.lock().get();
+
+	// The radix sort scans a count per digit per tile, which can be more than the elements for tiny arrays
+	const uint32_t maxTileCount = GetTileCount(maxElementCount);
+	const uint32_t maxScanCount = std::max(maxElementCount, RadixDigitCount * maxTileCount);
+
+	// Only levels of more than one tile have tile results, the last level scans / reduces a single tile
+	for (uint32_t levelTileCount = GetTileCount(maxScanCount); levelTileCount > 1; levelTileCount = GetTileCount(levelTileCount))
+	{
+		auto& tileResults = m_tileResultBuffers.emplace_back(std::make_unique<GPUStructuredBuffer<uint32_t>>(levelTileCount));
+		renderer->CreateStructuredBufferAndViews(tileResults.get(), std::wstring_view(L"ParallelPrimitivesTileResults"), false, true);
+	}
+
+	m_scannedFlagsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(maxElementCount);
+	renderer->CreateStructuredBufferAndViews(m_scannedFlagsBuffer.get(), std::wstring_view(L"ParallelPrimitivesScannedFlags"), false, true);
+	m_sortKeysScratchBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(maxElementCount);
+	renderer->CreateStructuredBufferAndViews(m_sortKeysScratchBuffer.get(), std::wstring_view(L"ParallelPrimitivesSortKeys"), false, true);
+	m_sortValuesScratchBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(maxElementCount);
+	renderer->CreateStructuredBufferAndViews(m_sortValuesScratchBuffer.get(), std::wstring_view(L"ParallelPrimitivesSortValues"), false, true);
+	m_sortTileDigitOffsetsBuffer = std::make_unique<GPUStructuredBuffer<uint32_t>>(RadixDigitCount * maxTileCount);
+	renderer->CreateStructuredBufferAndViews(m_sortTileDigitOffsetsBuffer.get(), std::wstring_view(L"ParallelPrimitivesSortTileDigitOffsets"), false, true);
+
+	std::vector<D3D12_ROOT_PARAMETER1> slotRootParams;
+	const D3D12_ROOT_PARAMETER1 rootParamBindlessResourceIndices
+	{
+		.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+		.Constants
+		{
+			.ShaderRegister = 0,
+			.RegisterSpace = 0,
+			.Num32BitValues = sizeof(RootConstants) / sizeof(int32_t)
+		},
+		.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
+	};
+	slotRootParams.push_back(rootParamBindlessResourceIndices);
+
+	// Root signature is an array of root parameters
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc(
+		(UINT)slotRootParams.size(),
+		slotRootParams.data(),
+		0,
+		nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED
+	);
+
+	// Create the root signature
+	ComPtr<ID3DBlob> serializedRootSignature = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeVersionedRootSignature(
+		&rootSignatureDesc,
+		serializedRootSignature.GetAddressOf(),
+		errorBlob.GetAddressOf());
+	if (errorBlob)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	renderer->CreateRootSignature(serializedRootSignature, m_rootSignature);
+
+	const auto computeShaderPath = s2ws(DX::GetWorkingDirectory()) + std::wstring(L"\\Shaders\\ParallelPrimitives.hlsl");
+	const auto createPSO = [&](const wchar_t* entryPoint, ComPtr<ID3D12PipelineState>& outPSO)
+	{
+		auto computeShader = shaderLibrary.GetCompiledShader(computeShaderPath, entryPoint, {}, L"cs_6_6");
+		renderer->CreateComputePipelineState(outPSO, m_rootSignature, computeShader);
+	};
+	createPSO(L"CSReduceTiles", m_psoReduceTiles);
+	createPSO(L"CSScanTiles", m_psoScanTiles);
+	createPSO(L"CSAddTileOffsets", m_psoAddTileOffsets);
+	createPSO(L"CSCompactScatter", m_psoCompactScatter);
+	createPSO(L"CSRadixHistogram", m_psoRadixHistogram);
+	createPSO(L"CSRadixScatter", m_psoRadixScatter);
+}
+
+void GPUParallelPrimitives::Dispatch(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* pso, const RootConstants& constants, uint32_t groupCount) const
+{
+	m_resourceStates->FlushBarriers(cmdList);
+
+	cmdList->SetComputeRootSignature(m_rootSignature.Get());
+	cmdList->SetPipelineState(pso);
+	cmdList->SetComputeRoot32BitConstants(0, sizeof(RootConstants) / sizeof(int32_t), &constants, 0);
+	cmdList->Dispatch(groupCount, 1, 1);
+}
+
+void GPUParallelPrimitives::Reduce(ID3D12GraphicsCommandList* cmdList, GPUStructuredBuffer<uint32_t>& input, uint32_t count, ParallelPrimitives::ReduceOp op, GPUStructuredBuffer<uint32_t>& output) const
+{
+	DX::astro_assert(count <= m_maxElementCount, "GPUParallelPrimitives: more elements than it was initialised for");
+	PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "GPUParallelPrimitives::Reduce");
+
+	// Every level reduces its tiles into the next level's input, until a single tile is left to reduce into output
+	GPUStructuredBuffer<uint32_t>* levelInput = &input;
+	uint32_t levelCount = count;
+	for (uint32_t level = 0; ; ++level)
+	{
+		// An empty input still reduces to the identity
+		const uint32_t tileCount = std::max(1u, GetTileCount(levelCount));
+		GPUStructuredBuffer<uint32_t>* tileResults = tileCount > 1 ? m_tileResultBuffers[level].get() : nullptr;
+
+		m_resourceStates->UAVRead(levelInput->Resource());
+		m_resourceStates->UAVWrite(tileResults ? tileResults->Resource() : output.Resource());
+
+		RootConstants constants;
+		constants.Input = levelInput->GetUAVIndex();
+		constants.Output = output.GetUAVIndex();
+		constants.TileResults = tileResults ? tileResults->GetUAVIndex() : -1;
+		constants.ElementCount = levelCount;
+		constants.OpOrShift = uint32_t(op);
+		Dispatch(cmdList, m_psoReduceTiles.Get(), constants, tileCount);
+
+		if (!tileResults)
+		{
+			return;
+		}
+		levelInput = tileResults;
+		levelCount = tileCount;
+	}
+}
+
+void GPUParallelPrimitives::ExclusiveScanLevel(ID3D12GraphicsCommandList* cmdList, GPUStructuredBuffer<uint32_t>& levelInput, GPUStructuredBuffer<uint32_t>& levelOutput, uint32_t count, uint32_t level) const
+{
+	const uint32_t tileCount = GetTileCount(count);
+	GPUStructuredBuffer<uint32_t>* tileSums = tileCount > 1 ? m_tileResultBuffers[level].get() : nullptr;
+
+	// Tiles on their own
+	m_resourceStates->UAVRead(levelInput.Resource());
+	m_resourceStates->UAVWrite(levelOutput.Resource());
+	if (tileSums)
+	{
+		m_resourceStates->UAVWrite(tileSums->Resource());
+	}
+
+	RootConstants constants;
+	constants.Input = levelInput.GetUAVIndex();
+	constants.Output = levelOutput.GetUAVIndex();
+	constants.TileResults = tileSums ? tileSums->GetUAVIndex() : -1;
+	constants.ElementCount = count;
+	Dispatch(cmdList, m_psoScanTiles.Get(), constants, tileCount);
+
+	if (!tileSums)
+	{
+		return;
+	}
+
+	// Tile sums scanned in place into tile offsets, then added to their tile
+	ExclusiveScanLevel(cmdList, *tileSums, *tileSums, tileCount, level + 1);
+
+	m_resourceStates->UAVRead(tileSums->Resource());
+	m_resourceStates->UAVWrite(levelOutput.Resource());
+	Dispatch(cmdList, m_psoAddTileOffsets.Get(), constants, tileCount);
+}
+
+void GPUParallelPrimitives::ExclusiveScan(ID3D12GraphicsCommandList* cmdList, GPUStructuredBuffer<uint32_t>& input, GPUStructuredBuffer<uint32_t>& output, uint32_t count) const
+{
+	DX::astro_assert(count <= m_maxElementCount, "GPUParallelPrimitives: more elements than it was initialised for");
+	PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "GPUParallelPrimitives::ExclusiveScan");
+
+	if (count > 0)
+	{
+		ExclusiveScanLevel(cmdList, input, output, count, 0);
+	}
+}
+
+void GPUParallelPrimitives::Compact(
+	ID3D12GraphicsCommandList* cmdList,
+	GPUStructuredBuffer<uint32_t>& values,
+	GPUStructuredBuffer<uint32_t>& flags,
+	GPUStructuredBuffer<uint32_t>& output,
+	GPUStructuredBuffer<uint32_t>& keptCount,
+	uint32_t count) const
+{
+	DX::astro_assert(count <= m_maxElementCount, "GPUParallelPrimitives: more elements than it was initialised for");
+	PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "GPUParallelPrimitives::Compact");
+
+	if (count == 0)
+	{
+		// No element to write the kept count
+		keptCount.Clear(cmdList);
+		return;
+	}
+
+	// Scanned flags are where the kept values go
+	ExclusiveScanLevel(cmdList, flags, *m_scannedFlagsBuffer, count, 0);
+
+	m_resourceStates->UAVRead(values.Resource());
+	m_resourceStates->UAVRead(flags.Resource());
+	m_resourceStates->UAVRead(m_scannedFlagsBuffer->Resource());
+	m_resourceStates->UAVWrite(output.Resource());
+	m_resourceStates->UAVWrite(keptCount.Resource());
+
+	RootConstants constants;
+	constants.Input = values.GetUAVIndex();
+	constants.Output = output.GetUAVIndex();
+	constants.AuxInput = flags.GetUAVIndex();
+	constants.AuxInput2 = m_scannedFlagsBuffer->GetUAVIndex();
+	constants.AuxOutput = keptCount.GetUAVIndex();
+	constants.ElementCount = count;
+	Dispatch(cmdList, m_psoCompactScatter.Get(), constants, GetTileCount(count));
+}
+
+void GPUParallelPrimitives::RadixSortKeyValues(
+	ID3D12GraphicsCommandList* cmdList,
+	GPUStructuredBuffer<uint32_t>& keys,
+	GPUStructuredBuffer<uint32_t>& values,
+	uint32_t count,
+	uint32_t keyBitCount) const
+{
+	DX::astro_assert(count <= m_maxElementCount, "GPUParallelPrimitives: more elements than it was initialised for");
+	PIXScopedEvent(cmdList, PIX_COLOR(255, 128, 0), "GPUParallelPrimitives::RadixSortKeyValues");
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	const uint32_t tileCount = GetTileCount(count);
+	GPUStructuredBuffer<uint32_t>* keysIn = &keys;
+	GPUStructuredBuffer<uint32_t>* valuesIn = &values;
+	GPUStructuredBuffer<uint32_t>* keysOut = m_sortKeysScratchBuffer.get();
+	GPUStructuredBuffer<uint32_t>* valuesOut = m_sortValuesScratchBuffer.get();
+	keyBitCount = std::min(keyBitCount, 32u);
+	for (uint32_t shift = 0; shift < keyBitCount; shift += RadixDigitBitCount)
+	{
+		RootConstants constants;
+		constants.Input = keysIn->GetUAVIndex();
+		constants.Output = keysOut->GetUAVIndex();
+		constants.TileResults = m_sortTileDigitOffsetsBuffer->GetUAVIndex();
+		constants.AuxInput = valuesIn->GetUAVIndex();
+		constants.AuxOutput = valuesOut->GetUAVIndex();
+		constants.ElementCount = count;
+		constants.OpOrShift = shift;
+		// The last digit only covers the key bits left, as ParallelPrimitives::RadixSortKeyValues
+		constants.DigitMask = (1u << std::min(RadixDigitBitCount, keyBitCount - shift)) - 1;
+
+		// Digit counts per tile, digit major
+		m_resourceStates->UAVRead(keysIn->Resource());
+		m_resourceStates->UAVWrite(m_sortTileDigitOffsetsBuffer->Resource());
+		Dispatch(cmdList, m_psoRadixHistogram.Get(), constants, tileCount);
+
+		// Scanned: where each tile's keys of each digit start
+		ExclusiveScanLevel(cmdList, *m_sortTileDigitOffsetsBuffer, *m_sortTileDigitOffsetsBuffer, RadixDigitCount * tileCount, 0);
+
+		m_resourceStates->UAVRead(keysIn->Resource());
+		m_resourceStates->UAVRead(valuesIn->Resource());
+		m_resourceStates->UAVRead(m_sortTileDigitOffsetsBuffer->Resource());
+		m_resourceStates->UAVWrite(keysOut->Resource());
+		m_resourceStates->UAVWrite(valuesOut->Resource());
+		Dispatch(cmdList, m_psoRadixScatter.Get(), constants, tileCount);
+
+		std::swap(keysIn, keysOut);
+		std::swap(valuesIn, valuesOut);
+	}
+
+	// An odd pass count leaves the result in the scratch buffers
+	if (keysIn != &keys)
+	{
+		const UINT64 byteSize = UINT64(count) * sizeof(uint32_t);
+		m_resourceStates->Transition(keysIn->Resource(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+		m_resourceStates->Transition(valuesIn->Resource(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+		m_resourceStates->Transition(keys.Resource(), D3D12_RESOURCE_STATE_COPY_DEST);
+		m_resourceStates->Transition(values.Resource(), D3D12_RESOURCE_STATE_COPY_DEST);
+		m_resourceStates->FlushBarriers(cmdList);
+
+		cmdList->CopyBufferRegion(keys.Resource(), 0, keysIn->Resource(), 0, byteSize);
+		cmdList->CopyBufferRegion(values.Resource(), 0, valuesIn->Resource(), 0, byteSize);
+
+		for (ID3D12Resource* resource : { keysIn->Resource(), valuesIn->Resource(), keys.Resource(), values.Resource() })
+		{
+			m_resourceStates->Transition(resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}
+		m_resourceStates->FlushBarriers(cmdList);
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Common.h>
+#include <Rendering/Common/GPUStructuredBuffer.h>
+#include <Simulation/ParallelPrimitives.h>
+#include <memory>
+#include <vector>
+
+class IRenderer;
+class ResourceBarrierBatcher;
+namespace AstroTools::Rendering
+{
+	class ShaderLibrary;
+}
+
+using Microsoft::WRL::ComPtr;
+
+// Records the kernels of Shaders/ParallelPrimitives.hlsl: reduction, exclusive scan, stream compaction & key/value radix sort of uint buffers.
+// Owned by the passes which need them, sized for their largest array. Element counts are known on the CPU when recording.
+// Buffers go through the resource state tracker, they're left as UAVs. ParallelPrimitives is the CPU reference, results match bit for bit.
+class GPUParallelPrimitives
+{
+public:
+	static constexpr uint32_t TileSize = 1024; // PRIMITIVES_TILE_SIZE
+	static constexpr uint32_t RadixDigitBitCount = 4; // RADIX_DIGIT_BIT_COUNT
+	static constexpr uint32_t RadixDigitCount = 1u << RadixDigitBitCount;
+
+	void Init(IRenderer* renderer, AstroTools::Rendering::ShaderLibrary& shaderLibrary, uint32_t maxElementCount);
+
+	// output[0] = op over the count first input elements
+	void Reduce(ID3D12GraphicsCommandList* cmdList, GPUStructuredBuffer<uint32_t>& input, uint32_t count, ParallelPrimitives::ReduceOp op, GPUStructuredBuffer<uint32_t>& output) const;
+
+	// output[i] = input[0] + ... + input[i - 1], output may be input
+	void ExclusiveScan(ID3D12GraphicsCommandList* cmdList, GPUStructuredBuffer<uint32_t>& input, GPUStructuredBuffer<uint32_t>& output, uint32_t count) const;
+
+	// Stable: the values flagged 1 (flags are 0 or 1) are written to output in order, keptCount[0] = how many
+	void Compact(
+		ID3D12GraphicsCommandList* cmdList,
+		GPUStructuredBuffer<uint32_t>& values,
+		GPUStructuredBuffer<uint32_t>& flags,
+		GPUStructuredBuffer<uint32_t>& output,
+		GPUStructuredBuffer<uint32_t>& keptCount,
+		uint32_t count) const;
+
+	// Stable LSD radix sort on the low keyBitCount bits of the keys (higher bits are ignored), 4 bits per pass, in place
+	void RadixSortKeyValues(
+		ID3D12GraphicsCommandList* cmdList,
+		GPUStructuredBuffer<uint32_t>& keys,
+		GPUStructuredBuffer<uint32_t>& values,
+		uint32_t count,
+		uint32_t keyBitCount = 32) const;
+
+private:
+	struct RootConstants
+	{
+		int32_t Input = -1;
+		int32_t Output = -1;
+		int32_t TileResults = -1;
+		int32_t AuxInput = -1;
+		int32_t AuxInput2 = -1;
+		int32_t AuxOutput = -1;
+		uint32_t ElementCount = 0;
+		uint32_t OpOrShift = 0;
+		uint32_t DigitMask = 0;
+	};
+
+	void Dispatch(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* pso, const RootConstants& constants, uint32_t groupCount) const;
+	// Scans count elements of levelInput into levelOutput, using the tile sums of level & the ones above
+	void ExclusiveScanLevel(ID3D12GraphicsCommandList* cmdList, GPUStructuredBuffer<uint32_t>& levelInput, GPUStructuredBuffer<uint32_t>& levelOutput, uint32_t count, uint32_t level) const;
+
+	static uint32_t GetTileCount(uint32_t count)
+	{
+		return (count + TileSize - 1) / TileSize;
+	}
+
+	uint32_t m_maxElementCount = 0;
+
+	// One per level of tiles, level i holds a result per tile of level i - 1
+	std::vector<std::unique_ptr<GPUStructuredBuffer<uint32_t>>> m_tileResultBuffers;
+	std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_scannedFlagsBuffer;
+	std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_sortKeysScratchBuffer;
+	std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_sortValuesScratchBuffer;
+	std::unique_ptr<GPUStructuredBuffer<uint32_t>> m_sortTileDigitOffsetsBuffer;
+
+	ComPtr<ID3D12RootSignature> m_rootSignature;
+	ComPtr<ID3D12PipelineState> m_psoReduceTiles;
+	ComPtr<ID3D12PipelineState> m_psoScanTiles;
+	ComPtr<ID3D12PipelineState> m_psoAddTileOffsets;
+	ComPtr<ID3D12PipelineState> m_psoCompactScatter;
+	ComPtr<ID3D12PipelineState> m_psoRadixHistogram;
+	ComPtr<ID3D12PipelineState> m_psoRadixScatter;
+
+	ResourceBarrierBatcher* m_resourceStates = nullptr;
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <Common.h>
-#include <Rendering/Common/UploadBuffer.h>
+#include <Rendering/Common/UploadRingBuffer.h>
 #include <Rendering/Common/RenderTarget.h>
 #include <Rendering/Renderable/RenderableGroup.h>
 #include <functional>
@@ -18,7 +18,8 @@ class IRenderer
 {
 public:
 	virtual ~IRenderer() {};
-	virtual void Init(HWND window, int width, int height) = 0;
+	// framesInFlight: frames the CPU records ahead of the GPU, sizes the per-frame resources such as the upload ring
+	virtual void Init(HWND window, int width, int height, uint32_t framesInFlight) = 0;
 	virtual void FinaliseInit() = 0;
 	virtual void StartNewFrame(FrameResource* frameResources) = 0;
 	virtual void EndNewFrame(std::function<void(int)> onNewFenceValue) = 0;
@@ -40,13 +41,8 @@ protected:
 
 public:
 
-	template<typename T>
-	std::unique_ptr<UploadBuffer<T>> CreateConstantBuffer(UINT elementCount)
-	{
-		return std::make_unique<UploadBuffer<T>>(GetDevice().Get(), elementCount, true);
-	}
-
-	virtual int32_t CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuAddress, UINT cbvByteSize) = 0;
+	// Creates the CBV in a new descriptor of the global heap, or overwrites the one at descriptorIndex if provided
+	virtual int32_t CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuAddress, UINT cbvByteSize, int32_t descriptorIndex = -1) = 0;
 
 	virtual void CreateStructuredBufferAndViews(IStructuredBuffer* structuredBuffer, std::wstring_view bufferName, bool srv, bool uav, bool viewsAreByteAddress = false) = 0;
 	virtual void CreateCommandSignature(D3D12_COMMAND_SIGNATURE_DESC* sigDesc, ComPtr<ID3D12RootSignature> executeIndirectRootSignature, ComPtr<ID3D12CommandSignature>& commandSignature) = 0;
@@ -87,5 +83,8 @@ public:
 	virtual void WaitForFence(UINT64 fenceValue) = 0;
 	virtual D3D12_GPU_DESCRIPTOR_HANDLE GetSamplerGPUHandle(int32_t samplerID) = 0;
 	virtual D3D12_GPU_DESCRIPTOR_HANDLE GetDummySRVGPUHandle() const = 0;
+	// Records & executes commands outside of any frame, then waits for the GPU to be done with them.
+	// Only valid between frames (after EndNewFrame, before StartNewFrame), for rare operations like sim state snapshots.
+	virtual void ExecuteImmediate(const std::function<void(ID3D12GraphicsCommandList*)>& recordCommands) = 0;
 
 };
@@ -17,11 +17,12 @@ public:
 	{
 	}
 
-	virtual ~IMesh() {}
-
-	virtual void DisposeUploadBuffers()
+	virtual ~IMesh()
 	{
-		IndexUploadBuffer = nullptr;
+		if (ResourceStates && IndexBufferGPU)
+		{
+			ResourceStates->UnregisterResource(IndexBufferGPU.Get());
+		}
 	}
 
 
@@ -32,8 +33,9 @@ protected:
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R32_UINT;
 	size_t IndexBufferByteSize = 0;
 
+	PlacedResourceMemory IndexBufferMemory; // Declared before the resource so it outlives it
 	ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
-	ComPtr<ID3D12Resource> IndexUploadBuffer = nullptr;
+	ResourceBarrierBatcher* ResourceStates = nullptr; // Tracks the index buffer's state
 
 public:
 	virtual D3D12_INDEX_BUFFER_VIEW IndexBufferView() const = 0;
@@ -57,29 +59,29 @@ public:
 	{
 		// Vertex Data (structured) Buffer
 		VertexDataStructuredBuffer->Init(
-			rendererContext.Device.Get(),
-			rendererContext.CommandList.Get(),
+			rendererContext,
 			std::wstring_view(L"VertexDataBuffer"),
 			true, // SRV
-			false,// UAV
-			*rendererContext.GlobalCBVSRVUAVDescriptorHeap.lock());
+			false);// UAV
 
 		// Vertex Index buffer
+		ResourceStates = rendererContext.ResourceStates.lock().get();
 		IndexBufferGPU = AstroTools::Rendering::CreateDefaultBuffer(
-			rendererContext.Device.Get(),
+			rendererContext.ResourceAllocator.lock(),
+			IndexBufferMemory,
 			rendererContext.CommandList.Get(),
+			*ResourceStates,
 			VertexIndices.data(),
 			IndexBufferByteSize,
 			false, 
 			std::wstring_view(L"VertexIndexBuffer"), 
-			IndexUploadBuffer);
+			*rendererContext.UploadRing.lock());
 	}
 
 	Mesh(Mesh&& other) = delete;
 
 	virtual ~Mesh() override
 	{
-		DisposeUploadBuffers();
 	}
 
 	std::unique_ptr<StructuredBuffer<VertexDataType>> VertexDataStructuredBuffer; // TODO: could probably store this as a IStructuredBuffer
@@ -93,12 +95,6 @@ public:
 		return ibv;
 	}
 
-	virtual void DisposeUploadBuffers() override
-	{
-		IMesh::DisposeUploadBuffers();
-		VertexDataStructuredBuffer->DisposeUploadBuffer();
-	}
-
 	virtual int32_t GetVertexBufferSRV() const
 	{
 		return VertexDataStructuredBuffer->GetSRVIndex();
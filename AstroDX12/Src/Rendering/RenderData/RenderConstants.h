@@ -22,6 +22,12 @@ struct RenderPassConstants
 	float FarZ = 0.0f;
 	float TotalTime = 0.0f;
 	float DeltaTime = 0.0f;
+
+	// The previous frame's camera, for temporal reprojection. The current one's on the first frame.
+	XMFLOAT4X4 PrevViewProj = AstroTools::Maths::Identity4x4();
+	XMFLOAT4X4 PrevInvViewProj = AstroTools::Maths::Identity4x4();
+	XMFLOAT3 PrevEyePosWorld = { 0.0f, 0.0f, 0.0f };
+	float padding2 = 0.0f;
 };
 
 struct RenderableObjectConstantData
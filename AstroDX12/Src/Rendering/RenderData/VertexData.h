@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Common.h>
+#include <Rendering/RenderData/VertexDataConversion.h>
 
 using namespace DirectX;
 
@@ -79,13 +80,6 @@ struct VertexData_Long_POD
 	//More stuff like tangent, normal, uv, ...
 };
 
-class IVertexData
-{
-public:
-	virtual ~IVertexData() = default;
-	virtual std::shared_ptr<void> GetData() = 0;
-};
-
 
 class VertexData_Pos : public IVertexData
 {
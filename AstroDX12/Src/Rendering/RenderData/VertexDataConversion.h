@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Vertex data as the mesh building code handles it: each vertex owns its POD, which is what ends up in the vertex buffer
+class IVertexData
+{
+public:
+	virtual ~IVertexData() = default;
+	virtual std::shared_ptr<void> GetData() = 0;
+};
+
+// No maths library types in here, so the conversion can be benchmarked on its own. VertexDataFactory picks the POD type for each vertex type.
+namespace VertexDataConversion
+{
+	template<typename PodType, typename Type>
+	[[nodiscard]] std::vector<PodType> ToPOD(const std::vector<Type>& inData)
+	{
+		auto convertedData = std::vector< PodType >(inData.size());
+		uint32_t index = 0;
+		for (auto inDataInstance : inData)
+		{
+			convertedData[index] = *reinterpret_cast<PodType*>(inDataInstance.GetData().get());
+			index++;
+		}
+		return convertedData;
+	}
+}
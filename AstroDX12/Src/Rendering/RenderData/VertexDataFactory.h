@@ -13,14 +13,7 @@ private:
 	template<typename Type, typename PodType>
 	[[nodiscard]] static const std::vector<PodType> Convert(const std::vector<Type>& inData)
 	{
-		auto convertedData = std::vector< PodType >(inData.size());
-		uint32_t index = 0;
-		for (auto inDataInstance : inData)
-		{
-			convertedData[index] = *reinterpret_cast<PodType*>(inDataInstance.GetData().get());
-			index++;
-		}
-		return convertedData;
+		return VertexDataConversion::ToPOD<PodType>(inData);
 	}
 
 public:
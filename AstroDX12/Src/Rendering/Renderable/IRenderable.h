@@ -63,7 +63,7 @@ public:
 	virtual bool IsDirty() const = 0;
 	virtual void MarkDirty(int16_t dirtyFrameCount) = 0;
 	virtual void ReduceDirtyFrameCount() = 0;
-	virtual int16_t GetConstantBufferIndex() const = 0;
+	virtual int32_t GetConstantBufferIndex() const = 0;
 
 	virtual std::vector<int32_t> GetBindlessResourceIndices() const = 0;
 	virtual int32_t GetMeshVertexBufferSRVHeapIndex() const = 0;
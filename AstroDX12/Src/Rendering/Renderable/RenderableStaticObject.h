@@ -13,7 +13,7 @@ class RenderableStaticObject : public IRenderable
 public:
 	explicit RenderableStaticObject(
 		const IRenderableDesc& InRenderableDesc,
-		int16_t objectIndex
+		int32_t objectIndex
 	)
 		: m_transform( InRenderableDesc.InitialTransform)
 		, m_mesh(InRenderableDesc.Mesh)
@@ -79,7 +79,7 @@ public:
 		m_dirtyFrameCount--;
 	}
 
-	virtual int16_t GetConstantBufferIndex() const override
+	virtual int32_t GetConstantBufferIndex() const override
 	{
 		return m_objectsConstantBufferIndex;
 	}
@@ -114,7 +114,7 @@ private:
 	int16_t m_dirtyFrameCount;
 
 	// Index into which object constant buffer this object corresponds to
-	int16_t m_objectsConstantBufferIndex;
+	int32_t m_objectsConstantBufferIndex;
 
 	bool m_supportsTextures;
 };
\ No newline at end of file
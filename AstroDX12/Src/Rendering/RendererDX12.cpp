@@ -19,7 +19,7 @@ RendererDX12::~RendererDX12()
 	IRenderer::~IRenderer();
 }
 
-void RendererDX12::Init(HWND window, int width, int height)
+void RendererDX12::Init(HWND window, int width, int height, uint32_t framesInFlight)
 {
 #if _DEBUG
 	ComPtr<ID3D12Debug1> debugController;
@@ -120,6 +120,11 @@ void RendererDX12::Init(HWND window, int width, int height)
 
 	// Fence
 	ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+	m_fenceEvent = CreateEventW(nullptr, false, false, nullptr);
+	if (m_fenceEvent == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
 
 	// Descriptor Sizes
 	m_descriptorSizeRTV = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -143,11 +148,19 @@ void RendererDX12::Init(HWND window, int width, int height)
 	CreateGlobalDescriptorHeaps();
 	CreateDefaultGlobalSamplers();
 
+	m_uploadRing = std::make_shared<UploadRingBuffer>(m_device.Get(), m_uploadRingByteSizePerFrame * framesInFlight);
+	m_resourceAllocator = std::make_shared<PlacedResourceAllocator>(m_device.Get(), m_placedResourceHeapByteSize);
+	m_resourceStates = std::make_shared<ResourceBarrierBatcher>();
+
 	m_rendererContext = {
 		.Device = m_device,
 		.CommandList = m_commandList,
 		.CommandQueue = m_commandQueue,
-		.GlobalCBVSRVUAVDescriptorHeap = m_globalCBVSRVUAVDescriptorHeap
+		.GlobalCBVSRVUAVDescriptorHeap = m_globalCBVSRVUAVDescriptorHeap,
+		.CPUGlobalUAVDescriptorHeap = m_cpuGlobalUAVDescriptorHeap,
+		.UploadRing = m_uploadRing,
+		.ResourceAllocator = m_resourceAllocator,
+		.ResourceStates = m_resourceStates
 	};
 
 	// Swap Chain
@@ -199,6 +212,7 @@ void RendererDX12::FinaliseInit()
 	ThrowIfFailed(m_commandList->Close());
 	ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
 	m_commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	m_resourceStates->OnCommandListExecuted();
 
 	AddNewFence([](int) {});
 }
@@ -410,6 +424,10 @@ void RendererDX12::StartNewFrame( FrameResource* frameResources )
 	// We know at this point we've waited for last frame's commands to be executed on the GPU , we can now safely reset the commandlist allocator
 	ThrowIfFailed(frameResources->CmdListAllocator->Reset());
 
+	// Recycle upload memory & released resources' memory of every frame the GPU is done with
+	m_uploadRing->ReclaimCompleted(GetLastCompletedFence());
+	m_resourceAllocator->ReclaimCompleted(GetLastCompletedFence());
+
 	// Reset command list so we can re-use it for the next frame worth of commands.
 	// This is safe to do after the commandlist is comitted to the command queue with ExecuteCommandList
 	ThrowIfFailed(m_commandList->Reset(frameResources->CmdListAllocator.Get(), nullptr));
@@ -466,6 +484,7 @@ void RendererDX12::EndNewFrame(std::function<void(int)> onNewFenceValue)
 	// add command lists on queue
 	ID3D12CommandList* cmdLists[] = { m_commandList.Get() };
 	m_commandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+	m_resourceStates->OnCommandListExecuted();
 
 	// Present swaps the back & front buffers
 	ThrowIfFailed(m_swapChain->Present(0, 0));
@@ -488,20 +507,32 @@ void RendererDX12::AddNewFence(std::function<void(int)> onNewFenceValue)
 	m_currentFence++;
 	onNewFenceValue(m_currentFence);
 
+	// Uploads recorded & resources released up to here are used by the commands this fence marks at most
+	m_uploadRing->FinishFrame(m_currentFence);
+	m_resourceAllocator->FinishFrame(m_currentFence);
+
 	// Add fence on GPU queue which will get signalled when queue is fully processed
 	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), m_currentFence));
 }
 
 void RendererDX12::Shutdown()
 {
+	if (m_fenceEvent != nullptr)
+	{
+		CloseHandle(m_fenceEvent);
+		m_fenceEvent = nullptr;
+	}
 }
 
-int32_t RendererDX12::CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuAddress, UINT cbvByteSize)
+int32_t RendererDX12::CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuAddress, UINT cbvByteSize, int32_t descriptorIndex /* -1 */)
 {
-	const auto cbvDescriptorIndex = m_globalCBVSRVUAVDescriptorHeap->GetCurrentDescriptorHeapHandle();
+	auto cbvDescriptorIndex = descriptorIndex;
+	if (cbvDescriptorIndex == -1)
+	{
+		cbvDescriptorIndex = m_globalCBVSRVUAVDescriptorHeap->GetCurrentDescriptorHeapHandle();
+		m_globalCBVSRVUAVDescriptorHeap->IncreaseCurrentDescriptorHeapHandle();
+	}
 	const auto cpuDescriptorHandle = m_globalCBVSRVUAVDescriptorHeap->GetCPUDescriptorHandleByIndex(cbvDescriptorIndex);
-	const auto gpuDescriptorHandle = m_globalCBVSRVUAVDescriptorHeap->GetGPUDescriptorHandleByIndex(cbvDescriptorIndex);
-	m_globalCBVSRVUAVDescriptorHeap->IncreaseCurrentDescriptorHeapHandle();
 
 	D3D12_CONSTANT_BUFFER_VIEW_DESC cbViewDesc;
 	cbViewDesc.BufferLocation = cbvGpuAddress;
@@ -515,12 +546,10 @@ int32_t RendererDX12::CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuA
 void RendererDX12::CreateStructuredBufferAndViews(IStructuredBuffer* structuredBuffer, std::wstring_view bufferName, bool srv, bool uav, bool viewsAreByteAddress)
 {
 	structuredBuffer->Init(
-		m_device.Get(),
-		m_commandList.Get(),
+		m_rendererContext,
 		bufferName,
 		srv, 
 		uav,
-		*m_globalCBVSRVUAVDescriptorHeap, 
 		viewsAreByteAddress);
 }
 
@@ -625,7 +654,6 @@ void RendererDX12::BuildFrameResources(std::vector<std::unique_ptr<FrameResource
 	{
 		outFrameResourcesList.push_back(std::make_unique<FrameResource>(
 			m_device.Get(),
-			1,
 			i
 			));
 	}
@@ -680,10 +708,40 @@ UINT64 RendererDX12::GetLastCompletedFence()
 
 void RendererDX12::WaitForFence(UINT64 fenceValue)
 {
-	HANDLE eventHandle = CreateEventW(nullptr, false, false, nullptr);
-	ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, eventHandle));
-	WaitForSingleObject(eventHandle, INFINITE);
-	CloseHandle(eventHandle);
+	if (m_fence->GetCompletedValue() >= fenceValue)
+	{
+		return;
+	}
+
+	// Auto reset event, created once & reused by every wait
+	ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+	WaitForSingleObject(m_fenceEvent, INFINITE);
+}
+
+void RendererDX12::ExecuteImmediate(const std::function<void(ID3D12GraphicsCommandList*)>& recordCommands)
+{
+	// Idle GPU: the init allocator can be reset, and whatever the recorded commands read is final
+	WaitForFence(m_currentFence);
+
+	ThrowIfFailed(m_directCommandListAllocator->Reset());
+	ThrowIfFailed(m_commandList->Reset(m_directCommandListAllocator.Get(), nullptr));
+
+	ID3D12DescriptorHeap* globalDescriptorHeaps[] =
+	{
+		m_globalCBVSRVUAVDescriptorHeap->GetHeapPtr(),
+		m_globalSamplerDescriptorHeap->GetHeapPtr(),
+	};
+	m_commandList->SetDescriptorHeaps(_countof(globalDescriptorHeaps), globalDescriptorHeaps);
+
+	recordCommands(m_commandList.Get());
+
+	ThrowIfFailed(m_commandList->Close());
+	ID3D12CommandList* cmdLists[] = { m_commandList.Get() };
+	m_commandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
+	m_resourceStates->OnCommandListExecuted();
+
+	AddNewFence([](int) {});
+	WaitForFence(m_currentFence);
 }
 
 void RendererDX12::CreateDefaultGlobalSamplers()
@@ -18,7 +18,7 @@ public:
     virtual ~RendererDX12();
 
     // IRenderer - BEGIN
-    virtual void Init(HWND window, int  width, int height) override;
+    virtual void Init(HWND window, int  width, int height, uint32_t framesInFlight) override;
     virtual void FinaliseInit() override;
     virtual void StartNewFrame(FrameResource* frameResources) override;
     virtual void EndNewFrame(std::function<void(int)> onNewFenceValue) override;
@@ -38,7 +38,7 @@ protected:
     virtual void CreateRenderTargetView(ID3D12Resource* resource, const D3D12_RENDER_TARGET_VIEW_DESC* desc) override;
     virtual void CreateGlobalDescriptorHeaps() override;
 public:
-    virtual int32_t CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuAddress, UINT cbvByteSize) override;
+    virtual int32_t CreateConstantBufferView(D3D12_GPU_VIRTUAL_ADDRESS cbvGpuAddress, UINT cbvByteSize, int32_t descriptorIndex = -1) override;
 
     virtual void CreateStructuredBufferAndViews(IStructuredBuffer* structuredBuffer, std::wstring_view bufferName, bool srv, bool uav, bool viewsAreByteAddress = false) override;
     virtual void CreateCommandSignature(D3D12_COMMAND_SIGNATURE_DESC* sigDesc, ComPtr<ID3D12RootSignature> executeIndirectRootSignature, ComPtr<ID3D12CommandSignature>& commandSignature) override;
@@ -82,6 +82,7 @@ public:
     virtual void WaitForFence(UINT64 fenceValue) override;
     virtual D3D12_GPU_DESCRIPTOR_HANDLE GetSamplerGPUHandle(int32_t samplerID) override;
     virtual D3D12_GPU_DESCRIPTOR_HANDLE GetDummySRVGPUHandle() const override;
+    virtual void ExecuteImmediate(const std::function<void(ID3D12GraphicsCommandList*)>& recordCommands) override;
     // IRenderer - END
 
 private:
@@ -101,6 +102,8 @@ private:
     int m_width = 32;
     int m_height = 32;
     static const uint8_t m_swapChainBufferCount = 2;
+    static constexpr UINT64 m_uploadRingByteSizePerFrame = 24 * 1024 * 1024; // Every frame in flight keeps its uploads alive until its fence, the ring scales with their count
+    static constexpr UINT64 m_placedResourceHeapByteSize = 256 * 1024 * 1024;
     int m_currentBackBuffer = 0;
     int m_currentFence = 0;
     size_t m_renderPassCBVOffset = 0;
@@ -109,6 +112,7 @@ private:
     ComPtr<IDXGIAdapter> m_currentAdapter;
     ComPtr<ID3D12Device> m_device;
     ComPtr<ID3D12Fence> m_fence;
+    HANDLE m_fenceEvent = nullptr; // Signalled by m_fence, reused by every CPU wait
     ComPtr<IDXGISwapChain1> m_swapChain;
 
     int32_t m_descriptorSizeRTV;   // Render Target View
@@ -121,7 +125,7 @@ private:
     DXGI_FORMAT m_depthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
 
     ComPtr<ID3D12CommandQueue> m_commandQueue;
-    ComPtr<ID3D12CommandAllocator> m_directCommandListAllocator; // Only used during renderer initialisation
+    ComPtr<ID3D12CommandAllocator> m_directCommandListAllocator; // Only used during renderer initialisation & by ExecuteImmediate
     ComPtr<ID3D12GraphicsCommandList> m_commandList;
 
     ComPtr<ID3D12DescriptorHeap> m_rtvHeap; // Render Target
@@ -129,6 +133,9 @@ private:
     std::shared_ptr<DescriptorHeap> m_globalCBVSRVUAVDescriptorHeap; // UAV/SRV/CBV Buffers heap for everything including bindless resources
 	std::shared_ptr<DescriptorHeap> m_globalSamplerDescriptorHeap; // Sampler heap for everything including bindless resources
     std::shared_ptr<DescriptorHeap> m_cpuGlobalUAVDescriptorHeap; // useful to clear render targets, when a CPU handle is needed
+    std::shared_ptr<UploadRingBuffer> m_uploadRing; // Staging memory for every CPU -> GPU upload, recycled per fence
+    std::shared_ptr<PlacedResourceAllocator> m_resourceAllocator; // Default heaps buffers & textures are placed in
+    std::shared_ptr<ResourceBarrierBatcher> m_resourceStates; // Current state of the resources, as seen by the frame's command list
 
 	int32_t m_rtvHeapViewsCount = 0; // Count of RTV views in the heap
 
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <Simulation/SimdFloat4.h>
+
+// Batched position based dynamics for chains (ropes, hair strands...), CPU reference of physicsChainCompute.hlsl.
+// All chains live in one element buffer, each one being an offset & length into it, element 0 of a chain being its root.
+// Chains are linear: an element's parent is the previous element of its chain.
+//
+// Per step, as on the GPU, velocity = (Pos - PrevPos) / dt then:
+// - PBD: IterationCount times, every unpinned element integrates that velocity & gravity over dt / IterationCount then gets pushed out of the collision spheres,
+//   then the parent length constraints are solved in 2 phases, odd links then even links, so no two links of a phase share an element.
+//   The velocity stays fixed for the whole step, and how stiff the chain ends up depends on the iteration count & timestep.
+// - XPBD small steps (Macklin et al. 2019): the same loop over SubstepCount substeps, except the constraints are compliant (Compliance, 0 is rigid)
+//   and every substep derives the velocity from its own displacement. One constraint iteration per substep, so the stiffness
+//   no longer depends on the iteration count.
+// XPBD doesn't reach PBD's stiffness at a fraction of the constraint evaluations, only at ~3/4 of them (ChainXPBD_Convergence):
+// PBD iterations already integrate over dt / IterationCount, so they are small steps too, their error falling with the count squared as
+// the substeps' does. What's left to XPBD is the velocity derived per substep, worth 20-25% less stretch at equal evaluations, and
+// the compliance. Both damp the velocity by Damping over a step, XPBD by Damping^(1 / SubstepCount) per substep. The stretch measured
+// also depends on it, damping calming the swing: undamped XPBD is further ahead (0.020 vs 0.027), at 0.95 PBD is (0.012 vs 0.016).
+// On the GPU an element is a thread of its chain's threadgroup, here an element is solved for 4 chains at once, one chain per SIMD lane.
+namespace ChainPBD
+{
+	// Matches MAX_CHAIN_ELEMENTS in physicsChainCompute.hlsl: one thread per element, so a chain fits in a threadgroup
+	constexpr uint32_t MaxChainElementCount = 32;
+
+	struct ChainDesc
+	{
+		uint32_t FirstElement = 0;
+		uint32_t ElementCount = 0;
+	};
+
+	struct Element
+	{
+		float Pos[3] = {};
+		float PrevPos[3] = {};
+		float RestLength = 0.f; // To the parent
+		float Radius = 0.f;
+		bool Pinned = false;
+	};
+
+	struct CollisionSphere
+	{
+		float Pos[3] = {};
+		float Radius = 0.f;
+	};
+
+	// Keep in sync with physicsChainCompute.hlsl
+	enum class SolverMode : uint32_t
+	{
+		PBD = 0,
+		XPBDSmallSteps,
+	};
+
+	struct SolverSettings
+	{
+		SolverMode Mode = SolverMode::PBD;
+		uint32_t IterationCount = 30; // PBD
+		uint32_t SubstepCount = 23; // XPBD, one constraint iteration each. The fewest as stiff as the 30 PBD iterations.
+		float Compliance = 0.f; // XPBD, inverse stiffness of the links
+		float Damping = 0.99f; // Velocity kept per step
+		float Gravity[3] = { 0.f, -9.81f * 1000.f, 0.f };
+	};
+
+	// Same as MakeCollisionData() in vbdChainCompute.hlsl, also the first colliders of the PhysicsChain demo scene
+	inline std::vector<CollisionSphere> MakeDefaultCollisionSpheres()
+	{
+		return {
+			{ { 16.f, -24.f, 9.f }, 5.f },
+			{ { 18.f, -35.f, 10.f }, 3.f },
+			{ { 10.f, -47.f, 10.f }, 3.5f },
+		};
+	}
+
+	class CPUSolver final
+	{
+	public:
+		static constexpr uint32_t LaneCount = 4;
+
+		// Chains longer than MaxChainElementCount are truncated, as the GPU solver can't fit them in a threadgroup either
+		CPUSolver(const std::vector<ChainDesc>& chains, const std::vector<Element>& elements)
+			: m_chains(chains)
+		{
+			// Batch chains of similar lengths together: a batch is as long as its longest chain, shorter chains idle in the remaining slots
+			std::vector<uint32_t> chainOrder(chains.size());
+			std::iota(chainOrder.begin(), chainOrder.end(), 0u);
+			std::stable_sort(chainOrder.begin(), chainOrder.end(), [&chains](uint32_t lhs, uint32_t rhs) { return chains[lhs].ElementCount < chains[rhs].ElementCount; });
+
+			size_t slotCount = 0;
+			for (size_t orderIdx = 0; orderIdx < chainOrder.size(); orderIdx += LaneCount)
+			{
+				Batch& batch = m_batches.emplace_back();
+				batch.FirstSlot = slotCount;
+				for (uint32_t lane = 0; lane < LaneCount && orderIdx + lane < chainOrder.size(); ++lane)
+				{
+					batch.Chains[lane] = chainOrder[orderIdx + lane];
+					batch.ElementCount = std::max(batch.ElementCount, GetSolvedElementCount(chains[batch.Chains[lane]]));
+				}
+				slotCount += batch.ElementCount;
+			}
+
+			m_slots.Resize(slotCount * LaneCount);
+
+			// Unused slots are pinned, they never move nor pull on their parent
+			const float pinnedMask = MakeMask(true);
+			std::fill(m_slots.PinnedMask.begin(), m_slots.PinnedMask.end(), pinnedMask);
+
+			for (const Batch& batch : m_batches)
+			{
+				for (uint32_t lane = 0; lane < LaneCount && batch.Chains[lane] != InvalidChain; ++lane)
+				{
+					const ChainDesc& chain = chains[batch.Chains[lane]];
+					for (uint32_t elementIdx = 0; elementIdx < GetSolvedElementCount(chain); ++elementIdx)
+					{
+						const Element& element = elements[chain.FirstElement + elementIdx];
+						const size_t slot = GetSlotIndex(batch, elementIdx, lane);
+						for (int axis = 0; axis < 3; ++axis)
+						{
+							m_slots.Pos[axis][slot] = element.Pos[axis];
+							m_slots.PrevPos[axis][slot] = element.PrevPos[axis];
+						}
+						m_slots.RestLength[slot] = element.RestLength;
+						m_slots.Radius[slot] = element.Radius;
+						m_slots.PinnedMask[slot] = MakeMask(element.Pinned);
+					}
+				}
+			}
+		}
+
+		// workerCount 0 uses every hardware thread, batches are split evenly between the workers
+		void Step(float dt, const SolverSettings& settings, const std::vector<CollisionSphere>& collisionSpheres, uint32_t workerCount = 0)
+		{
+			if (workerCount == 0)
+			{
+				workerCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+			workerCount = uint32_t(std::min<size_t>(workerCount, m_batches.size()));
+
+			const auto solveBatches = [&](size_t firstBatch, size_t lastBatch)
+			{
+				for (size_t batchIdx = firstBatch; batchIdx < lastBatch; ++batchIdx)
+				{
+					SolveBatch(m_batches[batchIdx], dt, settings, collisionSpheres);
+				}
+			};
+
+			if (workerCount <= 1)
+			{
+				solveBatches(0, m_batches.size());
+				return;
+			}
+
+			std::vector<std::thread> workers;
+			workers.reserve(workerCount - 1);
+			const size_t batchesPerWorker = (m_batches.size() + workerCount - 1) / workerCount;
+			for (uint32_t workerIdx = 1; workerIdx < workerCount; ++workerIdx)
+			{
+				const size_t firstBatch = std::min(m_batches.size(), workerIdx * batchesPerWorker);
+				workers.emplace_back(solveBatches, firstBatch, std::min(m_batches.size(), firstBatch + batchesPerWorker));
+			}
+			solveBatches(0, std::min(m_batches.size(), batchesPerWorker));
+
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+		}
+
+		// Writes the solved positions back to the caller's element buffer, laid out as described by the chains this solver was built with
+		void ReadElements(std::vector<Element>& inOutElements) const
+		{
+			for (const Batch& batch : m_batches)
+			{
+				for (uint32_t lane = 0; lane < LaneCount && batch.Chains[lane] != InvalidChain; ++lane)
+				{
+					const ChainDesc& chain = m_chains[batch.Chains[lane]];
+					for (uint32_t elementIdx = 0; elementIdx < GetSolvedElementCount(chain); ++elementIdx)
+					{
+						Element& element = inOutElements[chain.FirstElement + elementIdx];
+						const size_t slot = GetSlotIndex(batch, elementIdx, lane);
+						for (int axis = 0; axis < 3; ++axis)
+						{
+							element.Pos[axis] = m_slots.Pos[axis][slot];
+							element.PrevPos[axis] = m_slots.PrevPos[axis][slot];
+						}
+					}
+				}
+			}
+		}
+
+		size_t GetChainCount() const { return m_chains.size(); }
+
+	private:
+		static constexpr uint32_t InvalidChain = ~0u;
+
+		struct Batch
+		{
+			uint32_t Chains[LaneCount] = { InvalidChain, InvalidChain, InvalidChain, InvalidChain };
+			uint32_t ElementCount = 0;
+			size_t FirstSlot = 0;
+		};
+
+		// Structure of arrays, interleaved by lane: element e of a batch's lane l is at (FirstSlot + e) * LaneCount + l
+		struct SlotArrays
+		{
+			std::vector<float> Pos[3];
+			std::vector<float> PrevPos[3];
+			std::vector<float> RestLength;
+			std::vector<float> Radius;
+			std::vector<float> PinnedMask; // All bits set when pinned
+
+			void Resize(size_t slotCount)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					Pos[axis].resize(slotCount, 0.f);
+					PrevPos[axis].resize(slotCount, 0.f);
+				}
+				RestLength.resize(slotCount, 0.f);
+				Radius.resize(slotCount, 0.f);
+				PinnedMask.resize(slotCount, 0.f);
+			}
+		};
+
+		static uint32_t GetSolvedElementCount(const ChainDesc& chain)
+		{
+			return std::min(chain.ElementCount, MaxChainElementCount);
+		}
+
+		static size_t GetSlotIndex(const Batch& batch, uint32_t elementIdx, uint32_t lane)
+		{
+			return (batch.FirstSlot + elementIdx) * LaneCount + lane;
+		}
+
+		static float MakeMask(bool set)
+		{
+			const uint32_t bits = set ? ~0u : 0u;
+			float mask;
+			memcpy(&mask, &bits, sizeof(mask));
+			return mask;
+		}
+
+		static SimdFloat3x4 LoadFloat3(const std::vector<float> (&values)[3], size_t slot)
+		{
+			return { SimdFloat4::Load(&values[0][slot]), SimdFloat4::Load(&values[1][slot]), SimdFloat4::Load(&values[2][slot]) };
+		}
+
+		static void StoreFloat3(const SimdFloat3x4& value, std::vector<float> (&values)[3], size_t slot)
+		{
+			value.X.Store(&values[0][slot]);
+			value.Y.Store(&values[1][slot]);
+			value.Z.Store(&values[2][slot]);
+		}
+
+		void SolveBatch(const Batch& batch, float dt, const SolverSettings& settings, const std::vector<CollisionSphere>& collisionSpheres)
+		{
+			SimdFloat3x4 pos[MaxChainElementCount];
+			SimdFloat3x4 velocity[MaxChainElementCount];
+			SimdFloat4 restLength[MaxChainElementCount];
+			SimdFloat4 radius[MaxChainElementCount];
+			SimdFloat4 pinnedMask[MaxChainElementCount];
+
+			const SimdFloat4 invDt(1.f / dt);
+			for (uint32_t elementIdx = 0; elementIdx < batch.ElementCount; ++elementIdx)
+			{
+				const size_t slot = GetSlotIndex(batch, elementIdx, 0);
+				pos[elementIdx] = LoadFloat3(m_slots.Pos, slot);
+				velocity[elementIdx] = (pos[elementIdx] - LoadFloat3(m_slots.PrevPos, slot)) * invDt;
+				restLength[elementIdx] = SimdFloat4::Load(&m_slots.RestLength[slot]);
+				radius[elementIdx] = SimdFloat4::Load(&m_slots.Radius[slot]);
+				pinnedMask[elementIdx] = SimdFloat4::Load(&m_slots.PinnedMask[slot]);
+
+				// The step starts from the current positions, they become the previous ones
+				StoreFloat3(pos[elementIdx], m_slots.PrevPos, slot);
+			}
+
+			// PBD iterations & XPBD substeps only differ by the velocity update & compliance, with 0 compliance the constraint weights are the PBD ones
+			const bool isSmallSteps = settings.Mode == SolverMode::XPBDSmallSteps;
+			const uint32_t subStepCount = isSmallSteps ? settings.SubstepCount : settings.IterationCount;
+			const float h = dt / float(subStepCount);
+			const SimdFloat4 velocityScale(h * (isSmallSteps ? std::pow(settings.Damping, 1.f / float(subStepCount)) : settings.Damping));
+			const SimdFloat3x4 gravityOffset = {
+				SimdFloat4(settings.Gravity[0] * h * h),
+				SimdFloat4(settings.Gravity[1] * h * h),
+				SimdFloat4(settings.Gravity[2] * h * h) };
+			const SimdFloat4 alphaTilde(isSmallSteps ? settings.Compliance / (h * h) : 0.f);
+			const SimdFloat4 invH(1.f / h);
+			const SimdFloat4 zero(0.f);
+			const SimdFloat4 one(1.f);
+			const SimdFloat4 distanceEpsilon(1e-6f);
+			const SimdFloat4 correctionEpsilon(0.0001f);
+
+			SimdFloat3x4 subStepStartPos[MaxChainElementCount];
+			for (uint32_t subStep = 0; subStep < subStepCount; ++subStep)
+			{
+				// Integrate & collide
+				for (uint32_t elementIdx = 0; elementIdx < batch.ElementCount; ++elementIdx)
+				{
+					subStepStartPos[elementIdx] = pos[elementIdx];
+					SimdFloat3x4 newPos = pos[elementIdx] + velocity[elementIdx] * velocityScale + gravityOffset;
+					for (const CollisionSphere& sphere : collisionSpheres)
+					{
+						const SimdFloat3x4 toSphere = SimdFloat3x4{ SimdFloat4(sphere.Pos[0]), SimdFloat4(sphere.Pos[1]), SimdFloat4(sphere.Pos[2]) } - newPos;
+						const SimdFloat4 distance = SimdFloat3x4::Length(toSphere);
+						const SimdFloat4 minDistance = SimdFloat4(sphere.Radius) + radius[elementIdx];
+						const SimdFloat4 collides = distance < minDistance;
+						if (SimdFloat4::AnyTrue(collides))
+						{
+							const SimdFloat3x4 push = toSphere * ((minDistance - distance) / SimdFloat4::Max(distance, distanceEpsilon));
+							newPos = SimdFloat3x4::Select(collides, newPos - push, newPos);
+						}
+					}
+					pos[elementIdx] = SimdFloat3x4::Select(pinnedMask[elementIdx], pos[elementIdx], newPos);
+				}
+
+				// Parent length constraints, odd links then even links. Pinned elements don't solve their link.
+				// XPBD: dLambda = -C / (w + wParent + alpha / h^2), lambda restarting from 0 every substep
+				for (uint32_t firstLink = 1; firstLink <= 2; ++firstLink)
+				{
+					for (uint32_t elementIdx = firstLink; elementIdx < batch.ElementCount; elementIdx += 2)
+					{
+						const uint32_t parentIdx = elementIdx - 1;
+						const SimdFloat3x4 toParent = pos[parentIdx] - pos[elementIdx];
+						const SimdFloat4 distance = SimdFloat3x4::Length(toParent);
+						const SimdFloat4 lengthCorrection = distance - restLength[elementIdx];
+						const SimdFloat4 correct = SimdFloat4::Abs(lengthCorrection) > correctionEpsilon;
+						const SimdFloat4 scale = SimdFloat4::Select(correct, lengthCorrection / SimdFloat4::Max(distance, distanceEpsilon), zero);
+						const SimdFloat3x4 correction = toParent * SimdFloat4::Select(pinnedMask[elementIdx], zero, scale);
+
+						const SimdFloat4 parentInvMass = SimdFloat4::Select(pinnedMask[parentIdx], zero, one);
+						const SimdFloat4 invDenominator = one / (one + parentInvMass + alphaTilde);
+						pos[elementIdx] = pos[elementIdx] + correction * invDenominator;
+						pos[parentIdx] = pos[parentIdx] - correction * (parentInvMass * invDenominator);
+					}
+				}
+
+				if (isSmallSteps)
+				{
+					for (uint32_t elementIdx = 0; elementIdx < batch.ElementCount; ++elementIdx)
+					{
+						velocity[elementIdx] = (pos[elementIdx] - subStepStartPos[elementIdx]) * invH;
+					}
+				}
+			}
+
+			for (uint32_t elementIdx = 0; elementIdx < batch.ElementCount; ++elementIdx)
+			{
+				StoreFloat3(pos[elementIdx], m_slots.Pos, GetSlotIndex(batch, elementIdx, 0));
+			}
+		}
+
+		std::vector<ChainDesc> m_chains;
+		std::vector<Batch> m_batches;
+		SlotArrays m_slots;
+	};
+}
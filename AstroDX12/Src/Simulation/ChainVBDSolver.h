@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <Simulation/ChainPBDSolver.h>
+
+// Vertex Block Descent (Chen et al. 2024) for chains, CPU reference of vbdChainCompute.hlsl.
+// Each element is a vertex of mass Mass, each ParentIndex link a spring of rest length RestLength, collision spheres push with a penalty spring.
+//
+// Per step:
+// - inertial prediction y = x + dt * v * Damping + dt^2 * g
+// - initial guess x + dt * v * Damping + dt^2 * a~, the paper's adaptive initialization: a~ is the part of g the element's previous step
+//   actually accelerated by (its acceleration projected on g, clamped to [0, |g|]). Starting from y instead pulls a hanging chain down
+//   by dt^2 * g (2.7 units at 60Hz) against its pinned root, and Gauss-Seidel takes about as many iterations as the chain is long to carry
+//   that stretch back up: 30 iterations stopped at 7x PBD's stretch. Starting without g makes free-falling elements lag behind it instead.
+// - IterationCount times, color by color: every unpinned vertex of the color takes one Newton step on its local energy
+//   E(x) = Mass / (2 dt^2) |x - y|^2 + sum of its springs' & collisions' energies, solving the 3x3 system H dx = -grad E.
+//   Vertices of a color share no spring, so they're independent: on the GPU they update in parallel, one thread each.
+// The constraint graph is colored once at init, the colors are part of the element data.
+namespace ChainVBD
+{
+	// Matches GROUP_SIZE in vbdChainCompute.hlsl: one thread per element
+	constexpr uint32_t MaxChainElementCount = 32;
+
+	using CollisionSphere = ChainPBD::CollisionSphere;
+
+	struct Element
+	{
+		float Pos[3] = {};
+		float PrevPos[3] = {};
+		int32_t ParentIndex = -1;
+		float RestLength = 0.f; // To the parent
+		float Radius = 0.f;
+		bool Pinned = false;
+		uint32_t Color = 0;
+		float Acceleration[3] = {}; // Of the last step, for the next one's initial guess
+	};
+
+	struct SolverSettings
+	{
+		uint32_t IterationCount = 30;
+		float Mass = 1.f;
+		float Stiffness = 1e6f;
+		float CollisionStiffness = 1e6f;
+		float Damping = 0.99f;
+		float Gravity[3] = { 0.f, -9.81f * 1000.f, 0.f };
+	};
+
+	// Greedy coloring of the graph linking every element to its parent: linked elements never share a color.
+	// Returns the color count, 2 for a chain.
+	inline uint32_t ColorConstraintGraph(const std::vector<int32_t>& parentIndices, std::vector<uint32_t>& outColors)
+	{
+		const size_t elementCount = parentIndices.size();
+		std::vector<std::vector<uint32_t>> neighbours(elementCount);
+		for (size_t elementIdx = 0; elementIdx < elementCount; ++elementIdx)
+		{
+			const int32_t parentIdx = parentIndices[elementIdx];
+			if (parentIdx >= 0)
+			{
+				neighbours[elementIdx].push_back(uint32_t(parentIdx));
+				neighbours[parentIdx].push_back(uint32_t(elementIdx));
+			}
+		}
+
+		constexpr uint32_t Uncolored = ~0u;
+		outColors.assign(elementCount, Uncolored);
+		uint32_t colorCount = 0;
+		std::vector<bool> usedColors;
+		for (size_t elementIdx = 0; elementIdx < elementCount; ++elementIdx)
+		{
+			usedColors.assign(colorCount + 1, false);
+			for (uint32_t neighbourIdx : neighbours[elementIdx])
+			{
+				if (outColors[neighbourIdx] != Uncolored)
+				{
+					usedColors[outColors[neighbourIdx]] = true;
+				}
+			}
+
+			const uint32_t color = uint32_t(std::find(usedColors.begin(), usedColors.end(), false) - usedColors.begin());
+			outColors[elementIdx] = color;
+			colorCount = std::max(colorCount, color + 1);
+		}
+		return colorCount;
+	}
+
+	inline uint32_t ColorConstraintGraph(std::vector<Element>& elements)
+	{
+		std::vector<int32_t> parentIndices;
+		parentIndices.reserve(elements.size());
+		for (const Element& element : elements)
+		{
+			parentIndices.push_back(element.ParentIndex);
+		}
+
+		std::vector<uint32_t> colors;
+		const uint32_t colorCount = ColorConstraintGraph(parentIndices, colors);
+		for (size_t elementIdx = 0; elementIdx < elements.size(); ++elementIdx)
+		{
+			elements[elementIdx].Color = colors[elementIdx];
+		}
+		return colorCount;
+	}
+
+	namespace Privates
+	{
+		struct Vec3
+		{
+			float X = 0.f;
+			float Y = 0.f;
+			float Z = 0.f;
+
+			static Vec3 Load(const float (&values)[3]) { return { values[0], values[1], values[2] }; }
+			void Store(float (&values)[3]) const { values[0] = X; values[1] = Y; values[2] = Z; }
+
+			friend Vec3 operator+(const Vec3& a, const Vec3& b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+			friend Vec3 operator-(const Vec3& a, const Vec3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+			friend Vec3 operator*(const Vec3& a, float s) { return { a.X * s, a.Y * s, a.Z * s }; }
+
+			static float Dot(const Vec3& a, const Vec3& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+			static Vec3 Cross(const Vec3& a, const Vec3& b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+			static float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+		};
+
+		// Symmetric 3x3, as rows
+		struct Mat3
+		{
+			Vec3 Rows[3];
+
+			static Mat3 Diagonal(float value) { return { { { value, 0.f, 0.f }, { 0.f, value, 0.f }, { 0.f, 0.f, value } } }; }
+			static Mat3 Outer(const Vec3& a, const Vec3& b) { return { { b * a.X, b * a.Y, b * a.Z } }; }
+
+			friend Mat3 operator+(const Mat3& a, const Mat3& b) { return { { a.Rows[0] + b.Rows[0], a.Rows[1] + b.Rows[1], a.Rows[2] + b.Rows[2] } }; }
+			friend Mat3 operator*(const Mat3& a, float s) { return { { a.Rows[0] * s, a.Rows[1] * s, a.Rows[2] * s } }; }
+			friend Vec3 operator*(const Mat3& a, const Vec3& v) { return { Vec3::Dot(a.Rows[0], v), Vec3::Dot(a.Rows[1], v), Vec3::Dot(a.Rows[2], v) }; }
+		};
+
+		// dx = H^-1 f through the adjugate, no step if H is singular
+		inline Vec3 Solve3x3(const Mat3& H, const Vec3& f)
+		{
+			const Vec3 c0 = Vec3::Cross(H.Rows[1], H.Rows[2]);
+			const Vec3 c1 = Vec3::Cross(H.Rows[2], H.Rows[0]);
+			const Vec3 c2 = Vec3::Cross(H.Rows[0], H.Rows[1]);
+			const float det = Vec3::Dot(H.Rows[0], c0);
+			if (std::fabs(det) < 1e-12f)
+			{
+				return {};
+			}
+
+			// adj(H) has the cofactor vectors as columns, H being symmetric they can be used as rows
+			const Mat3 inverse = Mat3{ { c0, c1, c2 } } * (1.f / det);
+			return inverse * f;
+		}
+
+		// Force & Hessian of a spring between x and other: E = k/2 (|x - other| - restLength)^2.
+		// The Hessian's transverse term is clamped at 0 when compressed, keeping it positive semi-definite.
+		inline void AccumulateSpring(const Vec3& x, const Vec3& other, float restLength, float stiffness, Vec3& inOutForce, Mat3& inOutHessian)
+		{
+			const Vec3 d = x - other;
+			const float length = Vec3::Length(d);
+			if (length < 1e-6f)
+			{
+				return;
+			}
+
+			const Vec3 n = d * (1.f / length);
+			const Mat3 nnT = Mat3::Outer(n, n);
+			const float transverse = std::max(0.f, 1.f - restLength / length);
+			inOutForce = inOutForce - n * (stiffness * (length - restLength));
+			inOutHessian = inOutHessian + (nnT + (Mat3::Diagonal(1.f) + nnT * -1.f) * transverse) * stiffness;
+		}
+
+		// Penalty spring pushing x out of a sphere it penetrates
+		inline void AccumulateCollision(const Vec3& x, float radius, const CollisionSphere& sphere, float stiffness, Vec3& inOutForce, Mat3& inOutHessian)
+		{
+			const Vec3 d = x - Vec3::Load(sphere.Pos);
+			const float distance = Vec3::Length(d);
+			const float penetration = sphere.Radius + radius - distance;
+			if (penetration <= 0.f || distance < 1e-6f)
+			{
+				return;
+			}
+
+			const Vec3 n = d * (1.f / distance);
+			inOutForce = inOutForce + n * (stiffness * penetration);
+			inOutHessian = inOutHessian + Mat3::Outer(n, n) * stiffness;
+		}
+	}
+
+	// One step of a chain (or any tree of elements linked by ParentIndex), colored with ColorConstraintGraph.
+	// PrevPos becomes the positions the step started from, as on the GPU.
+	inline void Step(std::vector<Element>& elements, uint32_t colorCount, float dt, const SolverSettings& settings, const std::vector<CollisionSphere>& collisionSpheres)
+	{
+		using namespace Privates;
+
+		const size_t elementCount = elements.size();
+		const float inertia = settings.Mass / (dt * dt);
+		const Vec3 gravity = Vec3::Load(settings.Gravity);
+		const float gravityLength = Vec3::Length(gravity);
+		const Vec3 gravityDir = gravityLength > 0.f ? gravity * (1.f / gravityLength) : Vec3{};
+
+		std::vector<Vec3> pos(elementCount);
+		std::vector<Vec3> inertialPos(elementCount);
+		std::vector<Vec3> velocities(elementCount);
+
+		for (size_t elementIdx = 0; elementIdx < elementCount; ++elementIdx)
+		{
+			Element& element = elements[elementIdx];
+			const Vec3 x = Vec3::Load(element.Pos);
+			const Vec3 velocity = (x - Vec3::Load(element.PrevPos)) * (1.f / dt);
+			const Vec3 freeMotion = x + velocity * (dt * settings.Damping);
+			const float adaptiveGravity = std::clamp(Vec3::Dot(Vec3::Load(element.Acceleration), gravityDir), 0.f, gravityLength);
+			velocities[elementIdx] = velocity;
+			inertialPos[elementIdx] = element.Pinned ? x : freeMotion + gravity * (dt * dt);
+			pos[elementIdx] = element.Pinned ? x : freeMotion + gravityDir * (adaptiveGravity * dt * dt);
+			element.PrevPos[0] = element.Pos[0];
+			element.PrevPos[1] = element.Pos[1];
+			element.PrevPos[2] = element.Pos[2];
+		}
+
+		for (uint32_t iter = 0; iter < settings.IterationCount; ++iter)
+		{
+			for (uint32_t color = 0; color < colorCount; ++color)
+			{
+				for (size_t elementIdx = 0; elementIdx < elementCount; ++elementIdx)
+				{
+					const Element& element = elements[elementIdx];
+					if (element.Pinned || element.Color != color)
+					{
+						continue;
+					}
+
+					const Vec3 x = pos[elementIdx];
+					Vec3 force = (inertialPos[elementIdx] - x) * inertia;
+					Mat3 hessian = Mat3::Diagonal(inertia);
+
+					if (element.ParentIndex >= 0)
+					{
+						AccumulateSpring(x, pos[element.ParentIndex], element.RestLength, settings.Stiffness, force, hessian);
+					}
+					for (size_t childIdx = 0; childIdx < elementCount; ++childIdx)
+					{
+						if (elements[childIdx].ParentIndex == int32_t(elementIdx))
+						{
+							AccumulateSpring(x, pos[childIdx], elements[childIdx].RestLength, settings.Stiffness, force, hessian);
+						}
+					}
+					for (const CollisionSphere& sphere : collisionSpheres)
+					{
+						AccumulateCollision(x, element.Radius, sphere, settings.CollisionStiffness, force, hessian);
+					}
+
+					pos[elementIdx] = x + Solve3x3(hessian, force);
+				}
+			}
+		}
+
+		for (size_t elementIdx = 0; elementIdx < elementCount; ++elementIdx)
+		{
+			Element& element = elements[elementIdx];
+			const Vec3 newVelocity = (pos[elementIdx] - Vec3::Load(element.PrevPos)) * (1.f / dt);
+			((newVelocity - velocities[elementIdx]) * (1.f / dt)).Store(element.Acceleration);
+			pos[elementIdx].Store(element.Pos);
+		}
+	}
+}
@@ -0,0 +1,474 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Scene colliders for the chain sims, CPU reference of Shaders/Inc/Colliders.hlsli.
+// Spheres, capsules, (rounded) oriented boxes & baked SDF volumes share one collider buffer, SDF samples live in a second one.
+//
+// Broadphase: a uniform grid over the colliders' bounds, rebuilt on the CPU whenever they move. Every cell lists the colliders whose bounds,
+// grown by the largest node radius, overlap it, so a node only tests the colliders of the one cell it's in.
+// The per node cost follows how crowded the scene is around it, not how many colliders it has.
+namespace Colliders
+{
+	// Keep in sync with COLLIDER_SHAPE_ in Colliders.hlsli
+	enum class ColliderShape : uint32_t
+	{
+		Sphere = 0,
+		Capsule,
+		Box,
+		SDF
+	};
+
+	// GPU layout, keep in sync with Collider in Colliders.hlsli
+	struct Collider
+	{
+		float Center[3] = {};
+		ColliderShape Shape = ColliderShape::Sphere;
+		float Extents[3] = {}; // Capsule: half segment, in world space. Box & SDF: half size, in local space
+		float Radius = 0.f; // Sphere & Capsule. Box: rounding
+		float Rotation[4] = { 0.f, 0.f, 0.f, 1.f }; // Box & SDF: local to world, quaternion xyzw
+		uint32_t SdfResolution[3] = {}; // SDF: samples per axis, spanning [-Extents, Extents]
+		uint32_t SdfFirstSample = 0; // SDF: its first sample in the SDF sample buffer, x fastest, then y, then z
+	};
+	static_assert(sizeof(Collider) == 64, "Collider is mirrored in Colliders.hlsli");
+
+	// GPU layout, keep in sync with ColliderGridDesc in Colliders.hlsli
+	struct GridDesc
+	{
+		float Origin[3] = {};
+		float CellSize = 1.f;
+		uint32_t CellCount[3] = { 1, 1, 1 };
+		uint32_t ColliderCount = 0;
+	};
+
+	namespace Privates
+	{
+		struct Vec3
+		{
+			float X = 0.f;
+			float Y = 0.f;
+			float Z = 0.f;
+
+			static Vec3 Load(const float* values) { return { values[0], values[1], values[2] }; }
+			void Store(float* values) const { values[0] = X; values[1] = Y; values[2] = Z; }
+			float operator[](int axis) const { return axis == 0 ? X : (axis == 1 ? Y : Z); }
+
+			friend Vec3 operator+(const Vec3& a, const Vec3& b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+			friend Vec3 operator-(const Vec3& a, const Vec3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+			friend Vec3 operator*(const Vec3& a, float s) { return { a.X * s, a.Y * s, a.Z * s }; }
+
+			static float Dot(const Vec3& a, const Vec3& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+			static Vec3 Cross(const Vec3& a, const Vec3& b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+			static float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+			static Vec3 Abs(const Vec3& a) { return { std::fabs(a.X), std::fabs(a.Y), std::fabs(a.Z) }; }
+			static Vec3 Min(const Vec3& a, const Vec3& b) { return { std::min(a.X, b.X), std::min(a.Y, b.Y), std::min(a.Z, b.Z) }; }
+			static Vec3 Max(const Vec3& a, const Vec3& b) { return { std::max(a.X, b.X), std::max(a.Y, b.Y), std::max(a.Z, b.Z) }; }
+			static Vec3 Clamp(const Vec3& a, const Vec3& low, const Vec3& high) { return Min(Max(a, low), high); }
+		};
+
+		// v + 2w (q x v) + 2 q x (q x v), conjugate set for the inverse rotation
+		inline Vec3 Rotate(const float (&rotation)[4], const Vec3& v, bool conjugate = false)
+		{
+			const float sign = conjugate ? -1.f : 1.f;
+			const Vec3 q = { rotation[0] * sign, rotation[1] * sign, rotation[2] * sign };
+			const Vec3 t = Vec3::Cross(q, v) * 2.f;
+			return v + t * rotation[3] + Vec3::Cross(q, t);
+		}
+
+		// Half size of the world space box bounding a rotated local box
+		inline Vec3 RotatedHalfSize(const float (&rotation)[4], const Vec3& halfSize)
+		{
+			return Vec3::Abs(Rotate(rotation, { halfSize.X, 0.f, 0.f }))
+				+ Vec3::Abs(Rotate(rotation, { 0.f, halfSize.Y, 0.f }))
+				+ Vec3::Abs(Rotate(rotation, { 0.f, 0.f, halfSize.Z }));
+		}
+
+		inline float SampleSdf(const Collider& collider, const std::vector<float>& sdfSamples, uint32_t x, uint32_t y, uint32_t z)
+		{
+			const uint32_t resX = collider.SdfResolution[0];
+			const uint32_t resY = collider.SdfResolution[1];
+			return sdfSamples[collider.SdfFirstSample + (z * resY + y) * resX + x];
+		}
+
+		// Trilinear, localPos clamped to the volume
+		inline float SampleSdfTrilinear(const Collider& collider, const std::vector<float>& sdfSamples, const Vec3& localPos)
+		{
+			uint32_t cell[3];
+			float weight[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float extent = collider.Extents[axis];
+				const float lastSample = float(collider.SdfResolution[axis] - 1);
+				const float coord = std::clamp((localPos[axis] + extent) / (2.f * extent) * lastSample, 0.f, lastSample);
+				cell[axis] = std::min(uint32_t(coord), collider.SdfResolution[axis] - 2);
+				weight[axis] = coord - float(cell[axis]);
+			}
+
+			float result = 0.f;
+			for (uint32_t corner = 0; corner < 8; ++corner)
+			{
+				const uint32_t dx = corner & 1;
+				const uint32_t dy = (corner >> 1) & 1;
+				const uint32_t dz = (corner >> 2) & 1;
+				const float cornerWeight = (dx ? weight[0] : 1.f - weight[0]) * (dy ? weight[1] : 1.f - weight[1]) * (dz ? weight[2] : 1.f - weight[2]);
+				result += cornerWeight * SampleSdf(collider, sdfSamples, cell[0] + dx, cell[1] + dy, cell[2] + dz);
+			}
+			return result;
+		}
+
+		// Pushes x along toX until it is contactDistance away from the closest point, if closer
+		inline Vec3 PushOut(const Vec3& x, const Vec3& toX, float distance, float contactDistance)
+		{
+			const float penetration = contactDistance - distance;
+			if (penetration <= 0.f || distance < 1e-6f)
+			{
+				return x;
+			}
+			return x + toX * (penetration / distance);
+		}
+	}
+
+	// World space bounds of a collider
+	inline void GetBounds(const Collider& collider, float (&outMin)[3], float (&outMax)[3])
+	{
+		using namespace Privates;
+
+		const Vec3 center = Vec3::Load(collider.Center);
+		Vec3 halfSize;
+		switch (collider.Shape)
+		{
+		case ColliderShape::Sphere:
+			halfSize = { collider.Radius, collider.Radius, collider.Radius };
+			break;
+		case ColliderShape::Capsule:
+			halfSize = Vec3::Abs(Vec3::Load(collider.Extents)) + Vec3{ collider.Radius, collider.Radius, collider.Radius };
+			break;
+		case ColliderShape::Box:
+			halfSize = RotatedHalfSize(collider.Rotation, Vec3::Load(collider.Extents) + Vec3{ collider.Radius, collider.Radius, collider.Radius });
+			break;
+		case ColliderShape::SDF:
+			halfSize = RotatedHalfSize(collider.Rotation, Vec3::Load(collider.Extents));
+			break;
+		}
+		(center - halfSize).Store(outMin);
+		(center + halfSize).Store(outMax);
+	}
+
+	// Moves a node of radius nodeRadius at pos out of the collider
+	inline void ResolveCollision(const Collider& collider, const std::vector<float>& sdfSamples, float (&inOutPos)[3], float nodeRadius)
+	{
+		using namespace Privates;
+
+		const Vec3 pos = Vec3::Load(inOutPos);
+		const Vec3 center = Vec3::Load(collider.Center);
+		Vec3 result = pos;
+		switch (collider.Shape)
+		{
+		case ColliderShape::Sphere:
+		{
+			const Vec3 toPos = pos - center;
+			result = PushOut(pos, toPos, Vec3::Length(toPos), collider.Radius + nodeRadius);
+			break;
+		}
+		case ColliderShape::Capsule:
+		{
+			const Vec3 halfSegment = Vec3::Load(collider.Extents);
+			const Vec3 segmentStart = center - halfSegment;
+			const float segmentLengthSqr = 4.f * Vec3::Dot(halfSegment, halfSegment);
+			const float t = segmentLengthSqr > 0.f ? std::clamp(Vec3::Dot(pos - segmentStart, halfSegment * 2.f) / segmentLengthSqr, 0.f, 1.f) : 0.f;
+			const Vec3 toPos = pos - (segmentStart + halfSegment * (2.f * t));
+			result = PushOut(pos, toPos, Vec3::Length(toPos), collider.Radius + nodeRadius);
+			break;
+		}
+		case ColliderShape::Box:
+		{
+			const Vec3 halfSize = Vec3::Load(collider.Extents);
+			const Vec3 localPos = Rotate(collider.Rotation, pos - center, true);
+			const Vec3 closest = Vec3::Clamp(localPos, halfSize * -1.f, halfSize);
+			const Vec3 toPos = localPos - closest;
+			const float distance = Vec3::Length(toPos);
+			if (distance > 1e-6f)
+			{
+				// Only the push goes through the rotation, a node left untouched doesn't pick up its rounding
+				result = pos + Rotate(collider.Rotation, PushOut(localPos, toPos, distance, collider.Radius + nodeRadius) - localPos);
+				break;
+			}
+
+			// Inside: out through the closest face
+			int faceAxis = 0;
+			float faceDistance = halfSize.X - std::fabs(localPos.X);
+			for (int axis = 1; axis < 3; ++axis)
+			{
+				const float axisDistance = halfSize[axis] - std::fabs(localPos[axis]);
+				if (axisDistance < faceDistance)
+				{
+					faceAxis = axis;
+					faceDistance = axisDistance;
+				}
+			}
+			float localPush[3] = {};
+			localPush[faceAxis] = (localPos[faceAxis] < 0.f ? -1.f : 1.f) * (faceDistance + collider.Radius + nodeRadius);
+			result = pos + Rotate(collider.Rotation, Vec3::Load(localPush));
+			break;
+		}
+		case ColliderShape::SDF:
+		{
+			const Vec3 halfSize = Vec3::Load(collider.Extents);
+			const Vec3 localPos = Rotate(collider.Rotation, pos - center, true);
+			const Vec3 clampedPos = Vec3::Clamp(localPos, halfSize * -1.f, halfSize);
+
+			// Outside the volume, the distance to it is added to the distance sampled on its boundary
+			const float distance = SampleSdfTrilinear(collider, sdfSamples, clampedPos) + Vec3::Length(localPos - clampedPos);
+			const float penetration = nodeRadius - distance;
+			if (penetration <= 0.f)
+			{
+				break;
+			}
+
+			// Central differences, one sample apart
+			float gradientAxes[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float offset[3] = {};
+				offset[axis] = 2.f * collider.Extents[axis] / float(collider.SdfResolution[axis] - 1);
+				gradientAxes[axis] = SampleSdfTrilinear(collider, sdfSamples, clampedPos + Vec3::Load(offset)) - SampleSdfTrilinear(collider, sdfSamples, clampedPos - Vec3::Load(offset));
+			}
+			const Vec3 gradient = Vec3::Load(gradientAxes);
+			const float gradientLength = Vec3::Length(gradient);
+			if (gradientLength < 1e-6f)
+			{
+				break;
+			}
+			result = pos + Rotate(collider.Rotation, gradient * (penetration / gradientLength));
+			break;
+		}
+		}
+		result.Store(inOutPos);
+	}
+
+	// The scene's colliders, as uploaded to the GPU
+	struct ColliderSet
+	{
+		std::vector<Collider> Colliders;
+		std::vector<float> SdfSamples;
+
+		void AddSphere(const float (&center)[3], float radius)
+		{
+			Collider& collider = Colliders.emplace_back();
+			std::copy(std::begin(center), std::end(center), std::begin(collider.Center));
+			collider.Shape = ColliderShape::Sphere;
+			collider.Radius = radius;
+		}
+
+		void AddCapsule(const float (&start)[3], const float (&end)[3], float radius)
+		{
+			Collider& collider = Colliders.emplace_back();
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				collider.Center[axis] = 0.5f * (start[axis] + end[axis]);
+				collider.Extents[axis] = 0.5f * (end[axis] - start[axis]);
+			}
+			collider.Shape = ColliderShape::Capsule;
+			collider.Radius = radius;
+		}
+
+		void AddBox(const float (&center)[3], const float (&halfSize)[3], const float (&rotation)[4], float rounding = 0.f)
+		{
+			Collider& collider = Colliders.emplace_back();
+			std::copy(std::begin(center), std::end(center), std::begin(collider.Center));
+			std::copy(std::begin(halfSize), std::end(halfSize), std::begin(collider.Extents));
+			std::copy(std::begin(rotation), std::end(rotation), std::begin(collider.Rotation));
+			collider.Shape = ColliderShape::Box;
+			collider.Radius = rounding;
+		}
+
+		// Bakes distanceFunction(localX, localY, localZ) over the volume, at resolution samples per axis (at least 2)
+		template<typename TDistanceFunction>
+		void AddSdf(const float (&center)[3], const float (&halfSize)[3], const float (&rotation)[4], const uint32_t (&resolution)[3], TDistanceFunction&& distanceFunction)
+		{
+			assert(resolution[0] >= 2 && resolution[1] >= 2 && resolution[2] >= 2);
+
+			Collider& collider = Colliders.emplace_back();
+			std::copy(std::begin(center), std::end(center), std::begin(collider.Center));
+			std::copy(std::begin(halfSize), std::end(halfSize), std::begin(collider.Extents));
+			std::copy(std::begin(rotation), std::end(rotation), std::begin(collider.Rotation));
+			std::copy(std::begin(resolution), std::end(resolution), std::begin(collider.SdfResolution));
+			collider.Shape = ColliderShape::SDF;
+			collider.SdfFirstSample = uint32_t(SdfSamples.size());
+
+			for (uint32_t z = 0; z < resolution[2]; ++z)
+			{
+				for (uint32_t y = 0; y < resolution[1]; ++y)
+				{
+					for (uint32_t x = 0; x < resolution[0]; ++x)
+					{
+						SdfSamples.push_back(distanceFunction(
+							-halfSize[0] + 2.f * halfSize[0] * float(x) / float(resolution[0] - 1),
+							-halfSize[1] + 2.f * halfSize[1] * float(y) / float(resolution[1] - 1),
+							-halfSize[2] + 2.f * halfSize[2] * float(z) / float(resolution[2] - 1)));
+					}
+				}
+			}
+		}
+	};
+
+	// Uniform grid broadphase over a ColliderSet, see the top of the file
+	class ColliderGrid
+	{
+	public:
+		// Past this many cells, the cell size grows instead
+		static constexpr uint32_t DefaultMaxCellCount = 32 * 32 * 32;
+
+		// queryRadius: the largest radius of the nodes querying the grid
+		void Build(const std::vector<Collider>& colliders, float cellSize, float queryRadius, uint32_t maxCellCount = DefaultMaxCellCount)
+		{
+			assert(cellSize > 0.f && maxCellCount > 0);
+
+			m_desc = {};
+			m_desc.ColliderCount = uint32_t(colliders.size());
+			m_cellStarts.assign(2, 0);
+			m_colliderIndices.clear();
+			if (colliders.empty())
+			{
+				return;
+			}
+
+			// Collider bounds (min xyz, max xyz), grown so any node touching a collider has its center in one of the collider's cells
+			std::vector<float> bounds(colliders.size() * 6);
+			float gridMin[3] = { INFINITY, INFINITY, INFINITY };
+			float gridMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+			for (size_t colliderIdx = 0; colliderIdx < colliders.size(); ++colliderIdx)
+			{
+				float colliderMin[3];
+				float colliderMax[3];
+				GetBounds(colliders[colliderIdx], colliderMin, colliderMax);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					bounds[colliderIdx * 6 + axis] = colliderMin[axis] - queryRadius;
+					bounds[colliderIdx * 6 + 3 + axis] = colliderMax[axis] + queryRadius;
+					gridMin[axis] = std::min(gridMin[axis], bounds[colliderIdx * 6 + axis]);
+					gridMax[axis] = std::max(gridMax[axis], bounds[colliderIdx * 6 + 3 + axis]);
+				}
+			}
+
+			const auto cellCountFor = [&](float size, int axis) { return std::max(1u, uint32_t(std::ceil((gridMax[axis] - gridMin[axis]) / size))); };
+			while (uint64_t(cellCountFor(cellSize, 0)) * cellCountFor(cellSize, 1) * cellCountFor(cellSize, 2) > maxCellCount)
+			{
+				cellSize *= 1.25f;
+			}
+
+			std::copy(std::begin(gridMin), std::end(gridMin), std::begin(m_desc.Origin));
+			m_desc.CellSize = cellSize;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				m_desc.CellCount[axis] = cellCountFor(cellSize, axis);
+			}
+
+			// Counting sort of (cell, collider) pairs: count, prefix sum, scatter. Colliders are visited in order, so every cell lists them in order.
+			const uint32_t cellCount = m_desc.CellCount[0] * m_desc.CellCount[1] * m_desc.CellCount[2];
+			m_cellStarts.assign(cellCount + 1, 0);
+			ForEachOverlappedCell(bounds, colliders.size(), [&](uint32_t cellIdx, uint32_t) { ++m_cellStarts[cellIdx + 1]; });
+			for (uint32_t cellIdx = 0; cellIdx < cellCount; ++cellIdx)
+			{
+				m_cellStarts[cellIdx + 1] += m_cellStarts[cellIdx];
+			}
+
+			m_colliderIndices.resize(m_cellStarts[cellCount]);
+			std::vector<uint32_t> cellCursors(m_cellStarts.begin(), m_cellStarts.end() - 1);
+			ForEachOverlappedCell(bounds, colliders.size(), [&](uint32_t cellIdx, uint32_t colliderIdx) { m_colliderIndices[cellCursors[cellIdx]++] = colliderIdx; });
+		}
+
+		// Cell of a position, false outside the grid: nothing to collide with there
+		bool GetCellIndex(const float (&pos)[3], uint32_t& outCellIdx) const
+		{
+			uint32_t cell[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float coord = std::floor((pos[axis] - m_desc.Origin[axis]) / m_desc.CellSize);
+				if (!(coord >= 0.f && coord < float(m_desc.CellCount[axis])))
+				{
+					return false;
+				}
+				cell[axis] = uint32_t(coord);
+			}
+			outCellIdx = (cell[2] * m_desc.CellCount[1] + cell[1]) * m_desc.CellCount[0] + cell[0];
+			return true;
+		}
+
+		// Calls func(colliderIdx) for the colliders a node of up to queryRadius at pos can touch, in collider order
+		template<typename TFunc>
+		void ForEachCandidate(const float (&pos)[3], TFunc&& func) const
+		{
+			uint32_t cellIdx;
+			if (m_desc.ColliderCount == 0 || !GetCellIndex(pos, cellIdx))
+			{
+				return;
+			}
+			for (uint32_t entryIdx = m_cellStarts[cellIdx]; entryIdx < m_cellStarts[cellIdx + 1]; ++entryIdx)
+			{
+				func(m_colliderIndices[entryIdx]);
+			}
+		}
+
+		const GridDesc& GetDesc() const { return m_desc; }
+		// Cell count + 1 entries: the colliders of cell i are m_colliderIndices[CellStarts[i], CellStarts[i + 1])
+		const std::vector<uint32_t>& GetCellStarts() const { return m_cellStarts; }
+		const std::vector<uint32_t>& GetColliderIndices() const { return m_colliderIndices; }
+
+	private:
+		template<typename TFunc>
+		void ForEachOverlappedCell(const std::vector<float>& bounds, size_t colliderCount, TFunc&& func) const
+		{
+			for (size_t colliderIdx = 0; colliderIdx < colliderCount; ++colliderIdx)
+			{
+				uint32_t firstCell[3];
+				uint32_t lastCell[3];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const float lastCellCoord = float(m_desc.CellCount[axis] - 1);
+					firstCell[axis] = uint32_t(std::clamp(std::floor((bounds[colliderIdx * 6 + axis] - m_desc.Origin[axis]) / m_desc.CellSize), 0.f, lastCellCoord));
+					lastCell[axis] = uint32_t(std::clamp(std::floor((bounds[colliderIdx * 6 + 3 + axis] - m_desc.Origin[axis]) / m_desc.CellSize), 0.f, lastCellCoord));
+				}
+
+				for (uint32_t z = firstCell[2]; z <= lastCell[2]; ++z)
+				{
+					for (uint32_t y = firstCell[1]; y <= lastCell[1]; ++y)
+					{
+						for (uint32_t x = firstCell[0]; x <= lastCell[0]; ++x)
+						{
+							func((z * m_desc.CellCount[1] + y) * m_desc.CellCount[0] + x, uint32_t(colliderIdx));
+						}
+					}
+				}
+			}
+		}
+
+		GridDesc m_desc;
+		std::vector<uint32_t> m_cellStarts = { 0, 0 };
+		std::vector<uint32_t> m_colliderIndices;
+	};
+
+	// Collides a node against the colliders the grid lists around it, what HandleCollisions does on the GPU
+	inline void ResolveCollisions(const ColliderSet& colliderSet, const ColliderGrid& grid, float (&inOutPos)[3], float nodeRadius)
+	{
+		// The candidates are those of the node's cell before any push, as on the GPU
+		const float queryPos[3] = { inOutPos[0], inOutPos[1], inOutPos[2] };
+		grid.ForEachCandidate(queryPos, [&](uint32_t colliderIdx)
+		{
+			ResolveCollision(colliderSet.Colliders[colliderIdx], colliderSet.SdfSamples, inOutPos, nodeRadius);
+		});
+	}
+
+	// Reference without broadphase, every collider in order
+	inline void ResolveCollisionsBruteForce(const ColliderSet& colliderSet, float (&inOutPos)[3], float nodeRadius)
+	{
+		for (const Collider& collider : colliderSet.Colliders)
+		{
+			ResolveCollision(collider, colliderSet.SdfSamples, inOutPos, nodeRadius);
+		}
+	}
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Geometric multigrid solver for the 2D fluid sim's pressure: L x = b on a square cell centred grid, row major.
+// L is the 5 point Laplacian in grid units with zero gradient (Neumann) boundaries, the operator the Jacobi iterations multigrid replaced
+// worked on through their clamped taps: (L x)_i = sum over the neighbours j inside the grid of (x_j - x_i).
+// The solution is only defined up to a constant, which the projection's gradient doesn't see.
+//
+// V-cycle: red-black Gauss-Seidel smoothing, the residual restricted by summing 2x2 fine cells, bilinear prolongation of the correction,
+// down to a coarsest level solved by red-black sweeps alone.
+// CPU reference of Shaders/FluidSim/Multigrid.hlsl recorded by GPUMultigridPoisson2D, same steps in the same order:
+// the results match up to float rounding.
+namespace MultigridPoisson
+{
+	struct VCycleSettings
+	{
+		uint32_t PreSmoothSweepCount = 2;
+		uint32_t PostSmoothSweepCount = 2;
+		// Solved by a single thread group on the GPU, one thread per cell
+		uint32_t CoarsestResolution = 16;
+		uint32_t CoarsestSweepCount = 128;
+	};
+
+	// Number of levels of a V-cycle, from the full resolution down to the coarsest one included
+	inline uint32_t GetLevelCount(uint32_t resolution, const VCycleSettings& settings)
+	{
+		assert(resolution >= settings.CoarsestResolution && resolution % settings.CoarsestResolution == 0);
+		uint32_t levelCount = 1;
+		for (; resolution > settings.CoarsestResolution; resolution /= 2)
+		{
+			assert(resolution % 2 == 0);
+			++levelCount;
+		}
+		return levelCount;
+	}
+
+	// Dispatches GPUMultigridPoisson2D records per V-cycle: a red & a black one per sweep, a restriction & a prolongation per level
+	// above the coarsest, which is solved by a single dispatch
+	inline uint32_t GetDispatchCountPerVCycle(uint32_t resolution, const VCycleSettings& settings)
+	{
+		const uint32_t dispatchCountPerLevel = 2 * (settings.PreSmoothSweepCount + settings.PostSmoothSweepCount) + 2;
+		return (GetLevelCount(resolution, settings) - 1) * dispatchCountPerLevel + 1;
+	}
+
+	namespace Privates
+	{
+		inline float Load(const float* values, int32_t x, int32_t y, int32_t resolution)
+		{
+			return values[size_t(y) * resolution + x];
+		}
+
+		// Sum of the neighbours inside the grid & their count
+		inline float SumNeighbours(const float* x, int32_t cellX, int32_t cellY, int32_t resolution, float& outNeighbourCount)
+		{
+			float sum = 0.f;
+			outNeighbourCount = 0.f;
+			const auto addNeighbour = [&](int32_t neighbourX, int32_t neighbourY)
+			{
+				if (neighbourX >= 0 && neighbourX < resolution && neighbourY >= 0 && neighbourY < resolution)
+				{
+					sum += Load(x, neighbourX, neighbourY, resolution);
+					outNeighbourCount += 1.f;
+				}
+			};
+			addNeighbour(cellX - 1, cellY);
+			addNeighbour(cellX + 1, cellY);
+			addNeighbour(cellX, cellY - 1);
+			addNeighbour(cellX, cellY + 1);
+			return sum;
+		}
+
+		inline float ComputeResidual(const float* x, const float* b, int32_t cellX, int32_t cellY, int32_t resolution)
+		{
+			float neighbourCount;
+			const float neighbourSum = SumNeighbours(x, cellX, cellY, resolution, neighbourCount);
+			return Load(b, cellX, cellY, resolution) - (neighbourSum - neighbourCount * Load(x, cellX, cellY, resolution));
+		}
+	}
+
+	// Root mean square of b - L x
+	inline float ComputeResidualRms(const float* x, const float* b, uint32_t resolution)
+	{
+		double sumSquared = 0.0;
+		for (int32_t cellY = 0; cellY < int32_t(resolution); ++cellY)
+		{
+			for (int32_t cellX = 0; cellX < int32_t(resolution); ++cellX)
+			{
+				const float residual = Privates::ComputeResidual(x, b, cellX, cellY, int32_t(resolution));
+				sumSquared += double(residual) * residual;
+			}
+		}
+		return float(std::sqrt(sumSquared / (double(resolution) * resolution)));
+	}
+
+	// One iteration of the Jacobi solver FluidSim2D used before multigrid, kept as the baseline to compare against
+	inline void JacobiIteration(const float* x, const float* b, float* outX, uint32_t resolution)
+	{
+		const int32_t res = int32_t(resolution);
+		for (int32_t cellY = 0; cellY < res; ++cellY)
+		{
+			for (int32_t cellX = 0; cellX < res; ++cellX)
+			{
+				// Clamped taps: a tap outside the grid reads the cell itself
+				const float neighbourSum =
+					Privates::Load(x, std::max(cellX - 1, 0), cellY, res) +
+					Privates::Load(x, std::min(cellX + 1, res - 1), cellY, res) +
+					Privates::Load(x, cellX, std::max(cellY - 1, 0), res) +
+					Privates::Load(x, cellX, std::min(cellY + 1, res - 1), res);
+				outX[size_t(cellY) * res + cellX] = (neighbourSum - Privates::Load(b, cellX, cellY, res)) * 0.25f;
+			}
+		}
+	}
+
+	// Gauss-Seidel on the cells of one colour, parity 0 for the cells with an even x + y. Cells of a colour only neighbour the other colour,
+	// they're all updated from the same values whatever the order.
+	inline void SmoothRedBlack(float* x, const float* b, uint32_t resolution, uint32_t parity)
+	{
+		const int32_t res = int32_t(resolution);
+		for (int32_t cellY = 0; cellY < res; ++cellY)
+		{
+			for (int32_t cellX = (cellY + parity) & 1; cellX < res; cellX += 2)
+			{
+				float neighbourCount;
+				const float neighbourSum = Privates::SumNeighbours(x, cellX, cellY, res, neighbourCount);
+				x[size_t(cellY) * res + cellX] = (neighbourSum - Privates::Load(b, cellX, cellY, res)) / neighbourCount;
+			}
+		}
+	}
+
+	// firstColourPassIdx 1 skips the red half of the first sweep
+	inline void SmoothSweeps(float* x, const float* b, uint32_t resolution, uint32_t sweepCount, uint32_t firstColourPassIdx = 0)
+	{
+		for (uint32_t colourPassIdx = firstColourPassIdx; colourPassIdx < sweepCount * 2; ++colourPassIdx)
+		{
+			SmoothRedBlack(x, b, resolution, colourPassIdx & 1);
+		}
+	}
+
+	// The red half of the first sweep from x = 0, without reading x: -b / neighbour count on the red cells, 0 on the black ones.
+	// What FluidSim2D's fused input & divergence kernel writes, for the V-cycle to carry on from with firstRedPassDone.
+	inline void RedPassFromZero(const float* b, float* outX, uint32_t resolution)
+	{
+		const int32_t res = int32_t(resolution);
+		for (int32_t cellY = 0; cellY < res; ++cellY)
+		{
+			for (int32_t cellX = 0; cellX < res; ++cellX)
+			{
+				const float neighbourCount = float(2 + (cellX > 0 && cellX < res - 1) + (cellY > 0 && cellY < res - 1));
+				const bool isRed = ((cellX + cellY) & 1) == 0;
+				outX[size_t(cellY) * res + cellX] = isRed ? (0.f - Privates::Load(b, cellX, cellY, res)) / neighbourCount : 0.f;
+			}
+		}
+	}
+
+	// Coarse right hand side: the sum of the residuals of its 2x2 fine cells. L in grid units scales by 1/4 per level, the average
+	// of the residuals times 4. The coarse solution starts from 0.
+	inline void RestrictResidual(const float* x, const float* b, uint32_t resolution, float* outCoarseX, float* outCoarseB)
+	{
+		const int32_t coarseRes = int32_t(resolution / 2);
+		for (int32_t coarseY = 0; coarseY < coarseRes; ++coarseY)
+		{
+			for (int32_t coarseX = 0; coarseX < coarseRes; ++coarseX)
+			{
+				float residualSum = 0.f;
+				for (int32_t childIdx = 0; childIdx < 4; ++childIdx)
+				{
+					residualSum += Privates::ComputeResidual(x, b, coarseX * 2 + (childIdx & 1), coarseY * 2 + (childIdx >> 1), int32_t(resolution));
+				}
+				outCoarseB[size_t(coarseY) * coarseRes + coarseX] = residualSum;
+				outCoarseX[size_t(coarseY) * coarseRes + coarseX] = 0.f;
+			}
+		}
+	}
+
+	// Adds the bilinear interpolation of the coarse correction, the fine cell centres sitting a quarter of a coarse cell from
+	// the nearest coarse centre. Clamped at the edges, where the gradient is 0.
+	inline void ProlongateAdd(const float* coarseX, float* x, uint32_t resolution)
+	{
+		const int32_t coarseRes = int32_t(resolution / 2);
+		for (int32_t cellY = 0; cellY < int32_t(resolution); ++cellY)
+		{
+			const int32_t nearY = cellY / 2;
+			const int32_t farY = std::clamp(nearY + ((cellY & 1) ? 1 : -1), 0, coarseRes - 1);
+			for (int32_t cellX = 0; cellX < int32_t(resolution); ++cellX)
+			{
+				const int32_t nearX = cellX / 2;
+				const int32_t farX = std::clamp(nearX + ((cellX & 1) ? 1 : -1), 0, coarseRes - 1);
+				const float correction =
+					0.5625f * Privates::Load(coarseX, nearX, nearY, coarseRes) +
+					0.1875f * (Privates::Load(coarseX, farX, nearY, coarseRes) + Privates::Load(coarseX, nearX, farY, coarseRes)) +
+					0.0625f * Privates::Load(coarseX, farX, farY, coarseRes);
+				x[size_t(cellY) * resolution + cellX] += correction;
+			}
+		}
+	}
+
+	// Owns the coarse levels, the full resolution solution & right hand side are the caller's
+	class Solver
+	{
+	public:
+		Solver(uint32_t resolution, const VCycleSettings& settings = {})
+			: m_resolution(resolution)
+			, m_settings(settings)
+		{
+			const uint32_t levelCount = GetLevelCount(resolution, settings);
+			for (uint32_t levelIdx = 1; levelIdx < levelCount; ++levelIdx)
+			{
+				const size_t cellCount = size_t(resolution >> levelIdx) * (resolution >> levelIdx);
+				m_coarseLevels.push_back({ std::vector<float>(cellCount, 0.f), std::vector<float>(cellCount, 0.f) });
+			}
+		}
+
+		// Improves x in place, whatever it starts from. firstRedPassDone: x is RedPassFromZero's output, the cycle's first colour pass is skipped.
+		void VCycle(float* x, const float* b, bool firstRedPassDone = false)
+		{
+			VCycleLevel(0, x, b, firstRedPassDone ? 1 : 0);
+		}
+
+		uint32_t GetResolution() const { return m_resolution; }
+		const VCycleSettings& GetSettings() const { return m_settings; }
+
+	private:
+		struct Level
+		{
+			std::vector<float> Solution;
+			std::vector<float> Rhs;
+		};
+
+		void VCycleLevel(uint32_t levelIdx, float* x, const float* b, uint32_t firstColourPassIdx)
+		{
+			const uint32_t resolution = m_resolution >> levelIdx;
+			if (levelIdx == m_coarseLevels.size())
+			{
+				SmoothSweeps(x, b, resolution, m_settings.CoarsestSweepCount);
+				return;
+			}
+
+			SmoothSweeps(x, b, resolution, m_settings.PreSmoothSweepCount, firstColourPassIdx);
+
+			Level& coarse = m_coarseLevels[levelIdx];
+			RestrictResidual(x, b, resolution, coarse.Solution.data(), coarse.Rhs.data());
+			VCycleLevel(levelIdx + 1, coarse.Solution.data(), coarse.Rhs.data(), 0);
+			ProlongateAdd(coarse.Solution.data(), x, resolution);
+
+			SmoothSweeps(x, b, resolution, m_settings.PostSmoothSweepCount);
+		}
+
+		uint32_t m_resolution;
+		VCycleSettings m_settings;
+		std::vector<Level> m_coarseLevels; // Level i + 1, half the resolution of level i
+	};
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Reduction, exclusive prefix sum, stream compaction & key/value radix sort of uint32 arrays.
+// CPU reference of Shaders/ParallelPrimitives.hlsl, recorded by GPUParallelPrimitives: same inputs, same outputs, bit for bit.
+// Only uint32 is supported: integer sums wrap the same way whatever the order they're added in, so a multithreaded CPU run
+// & the GPU's tiles agree exactly. Float sums would depend on the GPU's reduction order, which isn't specified.
+//
+// workerCount 0 uses every hardware thread. Arrays too small to be worth it are processed on the calling thread only.
+namespace ParallelPrimitives
+{
+	// Keep in sync with REDUCE_OP_ in ParallelPrimitives.hlsl
+	enum class ReduceOp : uint32_t
+	{
+		Sum = 0,
+		Min,
+		Max
+	};
+
+	namespace Privates
+	{
+		// Below this many elements per worker, starting a thread costs more than it saves
+		constexpr size_t MinElementsPerWorker = 64 * 1024;
+
+		inline uint32_t GetWorkerCount(size_t elementCount, uint32_t workerCount)
+		{
+			if (workerCount == 0)
+			{
+				workerCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+			return uint32_t(std::clamp<size_t>(elementCount / MinElementsPerWorker, 1, workerCount));
+		}
+
+		// Calls function(workerIdx, first, last) for workerCount even chunks of [0, count), chunk 0 on the calling thread
+		template<typename TFunction>
+		void ForEachChunk(size_t count, uint32_t workerCount, const TFunction& function)
+		{
+			const size_t chunkSize = (count + workerCount - 1) / workerCount;
+			const auto processChunk = [&](uint32_t workerIdx)
+			{
+				const size_t first = std::min(count, workerIdx * chunkSize);
+				function(workerIdx, first, std::min(count, first + chunkSize));
+			};
+
+			std::vector<std::thread> workers;
+			workers.reserve(workerCount - 1);
+			for (uint32_t workerIdx = 1; workerIdx < workerCount; ++workerIdx)
+			{
+				workers.emplace_back(processChunk, workerIdx);
+			}
+			processChunk(0);
+
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+		}
+
+		template<ReduceOp Op>
+		constexpr uint32_t GetIdentity()
+		{
+			return Op == ReduceOp::Min ? UINT32_MAX : 0u;
+		}
+
+		template<ReduceOp Op>
+		inline uint32_t Apply(uint32_t a, uint32_t b)
+		{
+			if constexpr (Op == ReduceOp::Min)
+			{
+				return std::min(a, b);
+			}
+			else if constexpr (Op == ReduceOp::Max)
+			{
+				return std::max(a, b);
+			}
+			else
+			{
+				return a + b;
+			}
+		}
+
+		template<ReduceOp Op>
+		uint32_t Reduce(const uint32_t* values, size_t count, uint32_t workerCount)
+		{
+			workerCount = GetWorkerCount(count, workerCount);
+			std::vector<uint32_t> partials(workerCount, GetIdentity<Op>());
+			ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+			{
+				uint32_t partial = GetIdentity<Op>();
+				for (size_t valueIdx = first; valueIdx < last; ++valueIdx)
+				{
+					partial = Apply<Op>(partial, values[valueIdx]);
+				}
+				partials[workerIdx] = partial;
+			});
+
+			uint32_t result = GetIdentity<Op>();
+			for (uint32_t partial : partials)
+			{
+				result = Apply<Op>(result, partial);
+			}
+			return result;
+		}
+
+		// Exclusive scan of counts in place, returns their sum
+		inline uint32_t ExclusiveScanSerial(uint32_t* counts, size_t count)
+		{
+			uint32_t sum = 0;
+			for (size_t countIdx = 0; countIdx < count; ++countIdx)
+			{
+				const uint32_t value = counts[countIdx];
+				counts[countIdx] = sum;
+				sum += value;
+			}
+			return sum;
+		}
+	}
+
+	// Empty arrays reduce to the op's identity: 0 for Sum & Max, UINT32_MAX for Min
+	inline uint32_t Reduce(const uint32_t* values, size_t count, ReduceOp op, uint32_t workerCount = 0)
+	{
+		switch (op)
+		{
+		case ReduceOp::Min:
+			return Privates::Reduce<ReduceOp::Min>(values, count, workerCount);
+		case ReduceOp::Max:
+			return Privates::Reduce<ReduceOp::Max>(values, count, workerCount);
+		default:
+			return Privates::Reduce<ReduceOp::Sum>(values, count, workerCount);
+		}
+	}
+
+	// output[i] = values[0] + ... + values[i - 1], returns the sum of every value. output may be values.
+	inline uint32_t ExclusiveScan(const uint32_t* values, uint32_t* output, size_t count, uint32_t workerCount = 0)
+	{
+		workerCount = Privates::GetWorkerCount(count, workerCount);
+
+		// Per chunk sums, scanned into each chunk's offset
+		std::vector<uint32_t> chunkOffsets(workerCount, 0);
+		Privates::ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+		{
+			uint32_t sum = 0;
+			for (size_t valueIdx = first; valueIdx < last; ++valueIdx)
+			{
+				sum += values[valueIdx];
+			}
+			chunkOffsets[workerIdx] = sum;
+		});
+		const uint32_t total = Privates::ExclusiveScanSerial(chunkOffsets.data(), chunkOffsets.size());
+
+		Privates::ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+		{
+			uint32_t sum = chunkOffsets[workerIdx];
+			for (size_t valueIdx = first; valueIdx < last; ++valueIdx)
+			{
+				const uint32_t value = values[valueIdx];
+				output[valueIdx] = sum;
+				sum += value;
+			}
+		});
+		return total;
+	}
+
+	// Stable: the values flagged 1 are written to output in their original order, returns how many.
+	// Flags are 0 or 1, on the GPU they're summed by the scan. output must not overlap values.
+	inline uint32_t Compact(const uint32_t* values, const uint32_t* flags, uint32_t* output, size_t count, uint32_t workerCount = 0)
+	{
+		workerCount = Privates::GetWorkerCount(count, workerCount);
+
+		std::vector<uint32_t> chunkOffsets(workerCount, 0);
+		Privates::ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+		{
+			uint32_t keptCount = 0;
+			for (size_t valueIdx = first; valueIdx < last; ++valueIdx)
+			{
+				assert(flags[valueIdx] <= 1);
+				keptCount += flags[valueIdx];
+			}
+			chunkOffsets[workerIdx] = keptCount;
+		});
+		const uint32_t total = Privates::ExclusiveScanSerial(chunkOffsets.data(), chunkOffsets.size());
+
+		Privates::ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+		{
+			uint32_t outputIdx = chunkOffsets[workerIdx];
+			for (size_t valueIdx = first; valueIdx < last; ++valueIdx)
+			{
+				if (flags[valueIdx] != 0)
+				{
+					output[outputIdx++] = values[valueIdx];
+				}
+			}
+		});
+		return total;
+	}
+
+	// Stable LSD radix sort of keys, values are moved along with their key. Only the low keyBitCount bits of the keys are sorted on,
+	// the last digit is masked down to the bits left so higher bits never reorder keys.
+	// 8 bits per pass here, 4 on the GPU: a stable sort on the same bits has a single result, whatever the digit size.
+	inline void RadixSortKeyValues(uint32_t* keys, uint32_t* values, size_t count, uint32_t keyBitCount = 32, uint32_t workerCount = 0)
+	{
+		constexpr uint32_t DigitBitCount = 8;
+		constexpr uint32_t DigitCount = 1u << DigitBitCount;
+
+		workerCount = Privates::GetWorkerCount(count, workerCount);
+		std::vector<uint32_t> keysScratch(count);
+		std::vector<uint32_t> valuesScratch(count);
+		// Worker major: digit d of worker w starts after every smaller digit & after digit d of the workers before w, which keeps the sort stable
+		std::vector<uint32_t> digitOffsets(size_t(workerCount) * DigitCount);
+
+		uint32_t* keysIn = keys;
+		uint32_t* valuesIn = values;
+		uint32_t* keysOut = keysScratch.data();
+		uint32_t* valuesOut = valuesScratch.data();
+		keyBitCount = std::min(keyBitCount, 32u);
+		for (uint32_t shift = 0; shift < keyBitCount; shift += DigitBitCount)
+		{
+			const uint32_t digitMask = (1u << std::min(DigitBitCount, keyBitCount - shift)) - 1;
+			Privates::ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+			{
+				uint32_t* histogram = &digitOffsets[size_t(workerIdx) * DigitCount];
+				std::fill(histogram, histogram + DigitCount, 0u);
+				for (size_t keyIdx = first; keyIdx < last; ++keyIdx)
+				{
+					++histogram[(keysIn[keyIdx] >> shift) & digitMask];
+				}
+			});
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < DigitCount; ++digit)
+			{
+				for (uint32_t workerIdx = 0; workerIdx < workerCount; ++workerIdx)
+				{
+					uint32_t& digitOffset = digitOffsets[size_t(workerIdx) * DigitCount + digit];
+					const uint32_t digitCount = digitOffset;
+					digitOffset = offset;
+					offset += digitCount;
+				}
+			}
+
+			Privates::ForEachChunk(count, workerCount, [&](uint32_t workerIdx, size_t first, size_t last)
+			{
+				uint32_t* offsets = &digitOffsets[size_t(workerIdx) * DigitCount];
+				for (size_t keyIdx = first; keyIdx < last; ++keyIdx)
+				{
+					const uint32_t outputIdx = offsets[(keysIn[keyIdx] >> shift) & digitMask]++;
+					keysOut[outputIdx] = keysIn[keyIdx];
+					valuesOut[outputIdx] = valuesIn[keyIdx];
+				}
+			});
+
+			std::swap(keysIn, keysOut);
+			std::swap(valuesIn, valuesOut);
+		}
+
+		// An odd pass count leaves the result in the scratch arrays
+		if (keysIn != keys)
+		{
+			std::memcpy(keys, keysIn, count * sizeof(uint32_t));
+			std::memcpy(values, valuesIn, count * sizeof(uint32_t));
+		}
+	}
+}
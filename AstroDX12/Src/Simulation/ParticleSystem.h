@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Particle system with a fixed pool of slots, CPU implementation of particles.hlsl: same phases, same emission, same integration.
+// Used to validate the GPU one & to benchmark it headless.
+//
+// Slots are either on the dead list (a stack of free slot indices) or on the alive list. Per step:
+// - Prepare: the emission budget is clamped to the dead count, dispatch sizes are derived from the counters (indirect args on the GPU)
+// - Emit: every emitted particle pops a dead slot & is appended to the current alive list
+// - Simulate: every alive particle integrates, then goes back to the dead list or onto the next alive list
+// - The alive lists swap
+// Only alive particles are ever touched: the cost follows the alive count, not the pool size.
+namespace Particles
+{
+	// GPU layout, keep in sync with ParticleData in ParticlesCommon.hlsli
+	struct Particle
+	{
+		float Pos[3] = {};
+		float Vel[3] = {};
+		float Age = 0.f;
+		float Lifetime = 0.f;
+		float Size = 1.f;
+	};
+	static_assert(sizeof(Particle) == 36, "Particle is mirrored in ParticlesCommon.hlsli");
+
+	// Counters buffer, one uint each, keep in sync with COUNTER_ in particles.hlsl
+	enum class Counter : uint32_t
+	{
+		DeadCount = 0,
+		AliveCount0, // Of alive list 0
+		AliveCount1, // Of alive list 1
+		EmitCount, // Emitted this step, the budget clamped to the dead count
+		Count
+	};
+
+	// Particles per second turned into per step budgets, the fractional particles carried over to the next step
+	struct EmissionBudget
+	{
+		float Carry = 0.f;
+
+		uint32_t Next(float emissionRate, float dt)
+		{
+			Carry += emissionRate * dt;
+			const uint32_t budget = uint32_t(Carry);
+			Carry -= float(budget);
+			return budget;
+		}
+	};
+
+	// PCG hash, same as Hash() in particles.hlsl
+	inline uint32_t Hash(uint32_t value)
+	{
+		const uint32_t state = value * 747796405u + 2891336453u;
+		const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	// [0, 1), advancing the seed
+	inline float NextRandom(uint32_t& inOutSeed)
+	{
+		inOutSeed = Hash(inOutSeed);
+		return float(inOutSeed >> 8) * (1.f / 16777216.f);
+	}
+
+	// The emitIdx-th particle emitted at stepIndex: the emitted particles only depend on when they're emitted, not on the slot they land in
+	inline Particle EmitParticle(uint32_t stepIndex, uint32_t emitIdx)
+	{
+		uint32_t seed = Hash(stepIndex) + emitIdx;
+		const float angle = NextRandom(seed) * 6.2831853f;
+		const float radius = 8.f * std::sqrt(NextRandom(seed));
+
+		Particle particle;
+		particle.Pos[0] = std::cos(angle) * radius;
+		particle.Pos[2] = std::sin(angle) * radius;
+		particle.Vel[0] = (NextRandom(seed) * 2.f - 1.f) * 20.f;
+		particle.Vel[1] = 60.f + (NextRandom(seed) * 2.f - 1.f) * 40.f;
+		particle.Vel[2] = (NextRandom(seed) * 2.f - 1.f) * 20.f;
+		particle.Lifetime = 3.f + NextRandom(seed);
+		return particle;
+	}
+
+	// Gravity & a bouncy floor. Returns false once the particle is past its lifetime.
+	inline bool Integrate(Particle& particle, float dt)
+	{
+		particle.Vel[1] += -98.1f * dt;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			particle.Pos[axis] += particle.Vel[axis] * dt;
+		}
+
+		if (particle.Pos[1] < -2.f)
+		{
+			particle.Vel[0] *= 0.9f;
+			particle.Vel[2] *= 0.9f;
+			particle.Vel[1] *= -1.f;
+			particle.Pos[1] = -2.f;
+		}
+
+		particle.Age += dt;
+		return particle.Age < particle.Lifetime;
+	}
+
+	class CPUParticleSystem final
+	{
+	public:
+		explicit CPUParticleSystem(uint32_t maxParticleCount)
+			: m_particles(maxParticleCount)
+			, m_deadList(maxParticleCount)
+			, m_aliveLists{ std::vector<uint32_t>(maxParticleCount), std::vector<uint32_t>(maxParticleCount) }
+		{
+			Reset();
+		}
+
+		// Every slot dead, as CSReset does on the GPU
+		void Reset()
+		{
+			for (uint32_t slotIdx = 0; slotIdx < uint32_t(m_deadList.size()); ++slotIdx)
+			{
+				m_deadList[slotIdx] = slotIdx;
+			}
+			std::fill(std::begin(m_counters), std::end(m_counters), 0u);
+			m_counters[uint32_t(Counter::DeadCount)] = uint32_t(m_deadList.size());
+			m_aliveListIdx = 0;
+		}
+
+		void Step(float dt, uint32_t emitBudget, uint32_t stepIndex)
+		{
+			uint32_t& deadCount = m_counters[uint32_t(Counter::DeadCount)];
+			uint32_t& aliveCountIn = m_counters[uint32_t(Counter::AliveCount0) + m_aliveListIdx];
+			uint32_t& aliveCountOut = m_counters[uint32_t(Counter::AliveCount0) + 1 - m_aliveListIdx];
+			std::vector<uint32_t>& aliveListIn = m_aliveLists[m_aliveListIdx];
+			std::vector<uint32_t>& aliveListOut = m_aliveLists[1 - m_aliveListIdx];
+
+			// Prepare
+			const uint32_t emitCount = std::min(emitBudget, deadCount);
+			m_counters[uint32_t(Counter::EmitCount)] = emitCount;
+			aliveCountOut = 0;
+
+			// Emit
+			for (uint32_t emitIdx = 0; emitIdx < emitCount; ++emitIdx)
+			{
+				const uint32_t slotIdx = m_deadList[--deadCount];
+				m_particles[slotIdx] = EmitParticle(stepIndex, emitIdx);
+				aliveListIn[aliveCountIn++] = slotIdx;
+			}
+
+			// Simulate
+			for (uint32_t aliveIdx = 0; aliveIdx < aliveCountIn; ++aliveIdx)
+			{
+				const uint32_t slotIdx = aliveListIn[aliveIdx];
+				if (Integrate(m_particles[slotIdx], dt))
+				{
+					aliveListOut[aliveCountOut++] = slotIdx;
+				}
+				else
+				{
+					m_deadList[deadCount++] = slotIdx;
+				}
+			}
+
+			m_aliveListIdx = 1 - m_aliveListIdx;
+		}
+
+		uint32_t GetMaxParticleCount() const { return uint32_t(m_particles.size()); }
+		uint32_t GetAliveCount() const { return m_counters[uint32_t(Counter::AliveCount0) + m_aliveListIdx]; }
+		uint32_t GetDeadCount() const { return m_counters[uint32_t(Counter::DeadCount)]; }
+		const std::vector<Particle>& GetParticles() const { return m_particles; }
+		// The first GetAliveCount() entries are the alive slots
+		const std::vector<uint32_t>& GetAliveList() const { return m_aliveLists[m_aliveListIdx]; }
+		const std::vector<uint32_t>& GetDeadList() const { return m_deadList; }
+
+		// Every slot is either alive or dead, exactly once. Also valid for lists & counters read back from the GPU.
+		static bool ValidateLists(uint32_t maxParticleCount, const uint32_t* aliveList, uint32_t aliveCount, const uint32_t* deadList, uint32_t deadCount)
+		{
+			if (aliveCount + deadCount != maxParticleCount)
+			{
+				return false;
+			}
+
+			std::vector<bool> seen(maxParticleCount, false);
+			const auto markSeen = [&](const uint32_t* list, uint32_t count)
+			{
+				for (uint32_t entryIdx = 0; entryIdx < count; ++entryIdx)
+				{
+					const uint32_t slotIdx = list[entryIdx];
+					if (slotIdx >= maxParticleCount || seen[slotIdx])
+					{
+						return false;
+					}
+					seen[slotIdx] = true;
+				}
+				return true;
+			};
+			return markSeen(aliveList, aliveCount) && markSeen(deadList, deadCount);
+		}
+
+		bool ValidateLists() const
+		{
+			return ValidateLists(GetMaxParticleCount(), GetAliveList().data(), GetAliveCount(), m_deadList.data(), GetDeadCount());
+		}
+
+	private:
+		std::vector<Particle> m_particles;
+		std::vector<uint32_t> m_deadList;
+		std::vector<uint32_t> m_aliveLists[2];
+		uint32_t m_counters[uint32_t(Counter::Count)] = {};
+		uint32_t m_aliveListIdx = 0; // Alive list the next step emits into & simulates
+	};
+}
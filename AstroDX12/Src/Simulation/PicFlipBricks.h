@@ -0,0 +1,193 @@
+#pragma once
+
+#include <Simulation/ParallelPrimitives.h>
+#include <Simulation/PicFlipTransfer.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// Sparse grids of the PIC/FLIP 3D sim, CPU reference of the brick kernels of Shaders/LagrangianFluidSim/Simulate.hlsl.
+// The domain is split into 8^3 bricks, a top level grid of them maps each one to a slot of the brick pools, or none.
+// Only the bricks with particles & their 26 neighbours are active, the rest of the domain is air nobody allocates nor dispatches.
+// - MarkOccupiedBricks: the bricks particles are in
+// - ActivateBricks: dilated by a brick, the nodes a particle transfers to & the air around the fluid are in its neighbours
+// - AssignSlots: an exclusive scan of the active flags, slots in brick order. The bricks past the pool's capacity get none.
+// Bricks cover the velocity nodes, one more than the cells along every axis: the cells are the nodes' subset.
+namespace PicFlipBricks
+{
+	constexpr uint32_t BrickSize = 8; // PICFLIP_BRICK_SIZE, the grid passes' thread group: a group per brick
+	constexpr uint32_t BrickNodeCount = BrickSize * BrickSize * BrickSize;
+	constexpr uint32_t InvalidSlot = UINT32_MAX;
+
+	struct BrickGrid
+	{
+		uint32_t Resolution[3] = {}; // Bricks
+		uint32_t PoolCapacity = 0; // Slots of the brick pools
+
+		BrickGrid() = default;
+		BrickGrid(const PicFlipTransfer::Grid& grid, uint32_t poolCapacity)
+			: PoolCapacity(poolCapacity)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				Resolution[axis] = (grid.Resolution[axis] + 1 + BrickSize - 1) / BrickSize;
+			}
+		}
+
+		uint32_t GetBrickCount() const
+		{
+			return Resolution[0] * Resolution[1] * Resolution[2];
+		}
+
+		uint32_t GetBrickIdx(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			return x + Resolution[0] * (y + Resolution[1] * z);
+		}
+
+		// The brick node (or cell) (x, y, z) is in
+		uint32_t GetBrickIdxOfNode(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			return GetBrickIdx(x / BrickSize, y / BrickSize, z / BrickSize);
+		}
+
+		// Brick major cell keys: the particles of a brick are contiguous once sorted, its cell ranges fill its pool slot
+		uint32_t GetCellKey(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			const uint32_t localIdx = (x % BrickSize) + BrickSize * ((y % BrickSize) + BrickSize * (z % BrickSize));
+			return GetBrickIdxOfNode(x, y, z) * BrickNodeCount + localIdx;
+		}
+
+		uint32_t GetCellKeyBitCount() const
+		{
+			return uint32_t(std::bit_width(GetBrickCount() * BrickNodeCount - 1));
+		}
+	};
+
+	// outOccupied[b] is 1 if a particle is in brick b, 0 otherwise
+	inline void MarkOccupiedBricks(const PicFlipTransfer::Grid& grid, const BrickGrid& brickGrid, const PicFlipTransfer::Particle* particles, size_t count, uint32_t* outOccupied)
+	{
+		std::fill(outOccupied, outOccupied + brickGrid.GetBrickCount(), 0u);
+		for (size_t particleIdx = 0; particleIdx < count; ++particleIdx)
+		{
+			const uint32_t cellIdx = PicFlipTransfer::ComputeCellKey(grid, particles[particleIdx]);
+			const uint32_t cellX = cellIdx % grid.Resolution[0];
+			const uint32_t cellY = (cellIdx / grid.Resolution[0]) % grid.Resolution[1];
+			const uint32_t cellZ = cellIdx / (grid.Resolution[0] * grid.Resolution[1]);
+			outOccupied[brickGrid.GetBrickIdxOfNode(cellX, cellY, cellZ)] = 1;
+		}
+	}
+
+	// outActive[b] is 1 if b or any of its 26 neighbours is occupied
+	inline void ActivateBricks(const BrickGrid& brickGrid, const uint32_t* occupied, uint32_t* outActive)
+	{
+		for (uint32_t z = 0; z < brickGrid.Resolution[2]; ++z)
+		{
+			for (uint32_t y = 0; y < brickGrid.Resolution[1]; ++y)
+			{
+				for (uint32_t x = 0; x < brickGrid.Resolution[0]; ++x)
+				{
+					uint32_t isActive = 0;
+					for (uint32_t neighbourZ = z > 0 ? z - 1 : 0; neighbourZ <= std::min(z + 1, brickGrid.Resolution[2] - 1); ++neighbourZ)
+					{
+						for (uint32_t neighbourY = y > 0 ? y - 1 : 0; neighbourY <= std::min(y + 1, brickGrid.Resolution[1] - 1); ++neighbourY)
+						{
+							for (uint32_t neighbourX = x > 0 ? x - 1 : 0; neighbourX <= std::min(x + 1, brickGrid.Resolution[0] - 1); ++neighbourX)
+							{
+								isActive |= occupied[brickGrid.GetBrickIdx(neighbourX, neighbourY, neighbourZ)];
+							}
+						}
+					}
+					outActive[brickGrid.GetBrickIdx(x, y, z)] = isActive;
+				}
+			}
+		}
+	}
+
+	// outSlots[b]: b's pool slot, InvalidSlot if b isn't active or the pool is full. outActiveBricks[slot] = b.
+	// Returns the active brick count, the pool's capacity at most: the indirect dispatches' group count.
+	inline uint32_t AssignSlots(const BrickGrid& brickGrid, const uint32_t* active, uint32_t* outSlots, uint32_t* outActiveBricks)
+	{
+		const uint32_t brickCount = brickGrid.GetBrickCount();
+		const uint32_t activeCount = ParallelPrimitives::ExclusiveScan(active, outSlots, brickCount);
+		for (uint32_t brickIdx = 0; brickIdx < brickCount; ++brickIdx)
+		{
+			const uint32_t slot = outSlots[brickIdx];
+			if (!active[brickIdx] || slot >= brickGrid.PoolCapacity)
+			{
+				outSlots[brickIdx] = InvalidSlot;
+				continue;
+			}
+			outActiveBricks[slot] = brickIdx;
+		}
+		return std::min(activeCount, brickGrid.PoolCapacity);
+	}
+
+	// The whole activation, the GPU's sequence of kernels
+	class BrickMap
+	{
+	public:
+		explicit BrickMap(const BrickGrid& brickGrid)
+			: m_brickGrid(brickGrid)
+			, m_occupied(brickGrid.GetBrickCount())
+			, m_active(brickGrid.GetBrickCount())
+			, m_slots(brickGrid.GetBrickCount())
+			, m_activeBricks(brickGrid.PoolCapacity)
+		{
+		}
+
+		void Update(const PicFlipTransfer::Grid& grid, const PicFlipTransfer::Particle* particles, size_t count)
+		{
+			MarkOccupiedBricks(grid, m_brickGrid, particles, count, m_occupied.data());
+			ActivateBricks(m_brickGrid, m_occupied.data(), m_active.data());
+			m_activeBrickCount = AssignSlots(m_brickGrid, m_active.data(), m_slots.data(), m_activeBricks.data());
+		}
+
+		const BrickGrid& GetBrickGrid() const { return m_brickGrid; }
+		uint32_t GetActiveBrickCount() const { return m_activeBrickCount; }
+		uint32_t GetSlot(uint32_t brickIdx) const { return m_slots[brickIdx]; }
+		const uint32_t* GetActiveBricks() const { return m_activeBricks.data(); }
+
+		// Active bricks the pool had no slot left for, their particles don't transfer to the grid
+		uint32_t GetOverflowBrickCount() const
+		{
+			return uint32_t(std::count(m_active.begin(), m_active.end(), 1u)) - m_activeBrickCount;
+		}
+
+		// Every occupied brick & its neighbours active, every active brick next to an occupied one, slots & active list agreeing
+		bool Validate() const
+		{
+			const uint32_t brickCount = m_brickGrid.GetBrickCount();
+			std::vector<uint32_t> expectedActive(brickCount);
+			ActivateBricks(m_brickGrid, m_occupied.data(), expectedActive.data());
+			uint32_t slotCount = 0;
+			for (uint32_t brickIdx = 0; brickIdx < brickCount; ++brickIdx)
+			{
+				if (expectedActive[brickIdx] != m_active[brickIdx])
+				{
+					return false;
+				}
+				const uint32_t slot = m_slots[brickIdx];
+				if (slot == InvalidSlot)
+				{
+					continue;
+				}
+				if (!m_active[brickIdx] || slot >= m_activeBrickCount || m_activeBricks[slot] != brickIdx)
+				{
+					return false;
+				}
+				++slotCount;
+			}
+			return slotCount == m_activeBrickCount;
+		}
+
+	private:
+		BrickGrid m_brickGrid;
+		std::vector<uint32_t> m_occupied;
+		std::vector<uint32_t> m_active;
+		std::vector<uint32_t> m_slots;
+		std::vector<uint32_t> m_activeBricks;
+		uint32_t m_activeBrickCount = 0;
+	};
+}
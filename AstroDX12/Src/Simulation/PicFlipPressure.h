@@ -0,0 +1,372 @@
+#pragma once
+
+#include <Simulation/ParallelPrimitives.h>
+#include <Simulation/PicFlipTransfer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Pressure projection of the PIC/FLIP 3D sim, CPU reference of the pressure kernels of Shaders/LagrangianFluidSim/Simulate.hlsl.
+// A p = -div u over the fluid cells, in grid units: A is the negated 7 point Laplacian, (A p)_i = d_i p_i - sum of the fluid neighbours' p_j.
+// - Fluid cells are the ones with particles, the other cells are air: p = 0 there (Dirichlet)
+// - The domain's walls are solid: their faces' velocities are 0 & they aren't counted in d_i, the count of non solid neighbours (Neumann)
+// Solved by preconditioned conjugate gradient until ||r|| <= RelativeTolerance * ||b||, or the residual's RMS is below AbsoluteTolerance.
+// MaxIterationCount is only a safety net: a splash's divergence takes more iterations than a calm pool's, neither stops short of the target
+// nor runs past it.
+//
+// Multithreaded over z slices of cells, the dot products sum per slice then in slice order: the same results for any worker count.
+// The GPU runs the same iterations over the active bricks' cells, its dot products sum in another order: the results match up to float rounding.
+namespace PicFlipPressure
+{
+	// Keep in sync with PICFLIP_PRESSURE_PRECONDITIONER_ in Simulate.hlsl
+	enum class Preconditioner : uint32_t
+	{
+		Jacobi = 0, // z_i = r_i / d_i
+		IncompletePoisson, // z = K K^T r, K = I - L D^-1 with L the strictly lower part of A: 2 more neighbour passes, fewer iterations
+	};
+
+	struct SolveSettings
+	{
+		float RelativeTolerance = 1e-3f;
+		float AbsoluteTolerance = 1e-4f; // RMS over the fluid cells, in velocity units: the divergence left once projected
+		uint32_t MaxIterationCount = 256;
+		Preconditioner Preconditioning = Preconditioner::IncompletePoisson;
+	};
+
+	struct SolveStats
+	{
+		uint32_t IterationCount = 0;
+		float InitialResidualNorm = 0.f;
+		float ResidualNorm = 0.f;
+		bool Converged = false;
+	};
+
+	namespace Privates
+	{
+		constexpr int32_t NeighbourOffsets[6][3] = { { -1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+		constexpr uint32_t LowerNeighbourCount = 3; // The first 3 of NeighbourOffsets, lower cell indices
+
+		// The neighbour's cell index, or -1 past the domain's walls
+		inline int64_t GetNeighbourIdx(const PicFlipTransfer::Grid& grid, uint32_t x, uint32_t y, uint32_t z, uint32_t neighbourIdx)
+		{
+			const int64_t cell[3] = {
+				int64_t(x) + NeighbourOffsets[neighbourIdx][0],
+				int64_t(y) + NeighbourOffsets[neighbourIdx][1],
+				int64_t(z) + NeighbourOffsets[neighbourIdx][2] };
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				if (cell[axis] < 0 || cell[axis] >= int64_t(grid.Resolution[axis]))
+				{
+					return -1;
+				}
+			}
+			return int64_t(grid.GetCellIdx(uint32_t(cell[0]), uint32_t(cell[1]), uint32_t(cell[2])));
+		}
+
+		// Calls function(x, y, z, cellIdx) for every cell, z slices split between the workers
+		template<typename TFunction>
+		void ForEachCell(const PicFlipTransfer::Grid& grid, uint32_t workerCount, const TFunction& function)
+		{
+			workerCount = ParallelPrimitives::Privates::GetWorkerCount(grid.GetCellCount(), workerCount);
+			ParallelPrimitives::Privates::ForEachChunk(grid.Resolution[2], workerCount, [&](uint32_t /*workerIdx*/, size_t firstSlice, size_t lastSlice)
+			{
+				for (uint32_t z = uint32_t(firstSlice); z < lastSlice; ++z)
+				{
+					for (uint32_t y = 0; y < grid.Resolution[1]; ++y)
+					{
+						for (uint32_t x = 0; x < grid.Resolution[0]; ++x)
+						{
+							function(x, y, z, grid.GetCellIdx(x, y, z));
+						}
+					}
+				}
+			});
+		}
+
+		// Sum over the cells of term(cellIdx), per slice then in slice order
+		template<typename TTerm>
+		float SumCells(const PicFlipTransfer::Grid& grid, uint32_t workerCount, std::vector<float>& sliceSums, const TTerm& term)
+		{
+			sliceSums.assign(grid.Resolution[2], 0.f);
+			const uint32_t sliceCellCount = grid.Resolution[0] * grid.Resolution[1];
+			workerCount = ParallelPrimitives::Privates::GetWorkerCount(grid.GetCellCount(), workerCount);
+			ParallelPrimitives::Privates::ForEachChunk(grid.Resolution[2], workerCount, [&](uint32_t /*workerIdx*/, size_t firstSlice, size_t lastSlice)
+			{
+				for (size_t z = firstSlice; z < lastSlice; ++z)
+				{
+					float sliceSum = 0.f;
+					for (uint32_t cellIdx = uint32_t(z) * sliceCellCount; cellIdx < uint32_t(z + 1) * sliceCellCount; ++cellIdx)
+					{
+						sliceSum += term(cellIdx);
+					}
+					sliceSums[z] = sliceSum;
+				}
+			});
+
+			float sum = 0.f;
+			for (float sliceSum : sliceSums)
+			{
+				sum += sliceSum;
+			}
+			return sum;
+		}
+	}
+
+	// outIsFluid[c] is 1 if cell c has particles, from PicFlipTransfer::FindCellRanges' ranges
+	inline void MarkFluidCells(const PicFlipTransfer::Grid& grid, const uint32_t* cellStart, const uint32_t* cellEnd, uint8_t* outIsFluid)
+	{
+		for (uint32_t cellIdx = 0; cellIdx < grid.GetCellCount(); ++cellIdx)
+		{
+			outIsFluid[cellIdx] = cellStart[cellIdx] < cellEnd[cellIdx] ? 1 : 0;
+		}
+	}
+
+	// outRhs[c] = -div u for the fluid cells, 0 for the air ones. The walls' faces count as 0, whatever the gather left there.
+	inline void ComputeDivergenceRhs(const PicFlipTransfer::Grid& grid, const uint8_t* isFluid, const float* nodeVelocities, float* outRhs, uint32_t workerCount = 0)
+	{
+		Privates::ForEachCell(grid, workerCount, [&](uint32_t x, uint32_t y, uint32_t z, uint32_t cellIdx)
+		{
+			if (!isFluid[cellIdx])
+			{
+				outRhs[cellIdx] = 0.f;
+				return;
+			}
+
+			const uint32_t cell[3] = { x, y, z };
+			float divergence = 0.f;
+			for (uint32_t component = 0; component < 3; ++component)
+			{
+				uint32_t upperNode[3] = { x, y, z };
+				++upperNode[component];
+				const float lowerFace = cell[component] == 0 ? 0.f : nodeVelocities[size_t(grid.GetNodeIdx(x, y, z)) * 3 + component];
+				const float upperFace = upperNode[component] == grid.Resolution[component] ? 0.f : nodeVelocities[size_t(grid.GetNodeIdx(upperNode[0], upperNode[1], upperNode[2])) * 3 + component];
+				divergence += upperFace - lowerFace;
+			}
+			outRhs[cellIdx] = -divergence;
+		});
+	}
+
+	// Subtracts the pressure gradient from the faces next to fluid, zeroes the walls' faces
+	inline void Project(const PicFlipTransfer::Grid& grid, const uint8_t* isFluid, const float* pressure, float* nodeVelocities)
+	{
+		for (uint32_t z = 0; z <= grid.Resolution[2]; ++z)
+		{
+			for (uint32_t y = 0; y <= grid.Resolution[1]; ++y)
+			{
+				for (uint32_t x = 0; x <= grid.Resolution[0]; ++x)
+				{
+					const uint32_t node[3] = { x, y, z };
+					for (uint32_t component = 0; component < 3; ++component)
+					{
+						float& velocity = nodeVelocities[size_t(grid.GetNodeIdx(x, y, z)) * 3 + component];
+						if (node[component] == 0 || node[component] == grid.Resolution[component]
+							|| node[(component + 1) % 3] == grid.Resolution[(component + 1) % 3] || node[(component + 2) % 3] == grid.Resolution[(component + 2) % 3])
+						{
+							// Walls, & the last node along the other axes which no face is at
+							velocity = 0.f;
+							continue;
+						}
+
+						uint32_t lowerCell[3] = { x, y, z };
+						--lowerCell[component];
+						const uint32_t upperCellIdx = grid.GetCellIdx(x, y, z);
+						const uint32_t lowerCellIdx = grid.GetCellIdx(lowerCell[0], lowerCell[1], lowerCell[2]);
+						if (isFluid[upperCellIdx] || isFluid[lowerCellIdx])
+						{
+							velocity -= pressure[upperCellIdx] - pressure[lowerCellIdx];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	class Solver
+	{
+	public:
+		explicit Solver(const PicFlipTransfer::Grid& grid, const SolveSettings& settings = {}, uint32_t workerCount = 0)
+			: m_grid(grid)
+			, m_settings(settings)
+			, m_workerCount(workerCount)
+		{
+			const size_t cellCount = grid.GetCellCount();
+			m_diagonal.resize(cellCount);
+			m_residual.resize(cellCount);
+			m_preconditioned.resize(cellCount);
+			m_searchDirection.resize(cellCount);
+			m_laplacianDirection.resize(cellCount);
+			m_preconditionerTemp.resize(cellCount);
+		}
+
+		const SolveSettings& GetSettings() const { return m_settings; }
+
+		// Solves for outPressure, from 0: last step's pressure is in other cells once the particles moved
+		SolveStats Solve(const uint8_t* isFluid, const float* rhs, float* outPressure)
+		{
+			SetupDiagonal(isFluid);
+			ForEachCell([&](uint32_t, uint32_t, uint32_t, uint32_t cellIdx)
+			{
+				outPressure[cellIdx] = 0.f;
+				m_residual[cellIdx] = isFluid[cellIdx] ? rhs[cellIdx] : 0.f;
+			});
+			ApplyPreconditioner();
+			ForEachCell([&](uint32_t, uint32_t, uint32_t, uint32_t cellIdx)
+			{
+				m_searchDirection[cellIdx] = m_preconditioned[cellIdx];
+			});
+
+			float residualDotPreconditioned = SumCells([&](uint32_t cellIdx) { return m_residual[cellIdx] * m_preconditioned[cellIdx]; });
+			const float initialResidualSq = SumCells([&](uint32_t cellIdx) { return m_residual[cellIdx] * m_residual[cellIdx]; });
+			const float fluidCellCount = SumCells([&](uint32_t cellIdx) { return isFluid[cellIdx] ? 1.f : 0.f; });
+			const float residualSqThreshold = std::max(
+				m_settings.RelativeTolerance * m_settings.RelativeTolerance * initialResidualSq,
+				m_settings.AbsoluteTolerance * m_settings.AbsoluteTolerance * fluidCellCount);
+
+			SolveStats stats;
+			stats.InitialResidualNorm = std::sqrt(initialResidualSq);
+			stats.ResidualNorm = stats.InitialResidualNorm;
+			stats.Converged = initialResidualSq <= residualSqThreshold;
+			while (!stats.Converged && stats.IterationCount < m_settings.MaxIterationCount)
+			{
+				ApplyLaplacian(m_searchDirection.data(), m_laplacianDirection.data());
+				const float directionDotLaplacian = SumCells([&](uint32_t cellIdx) { return m_searchDirection[cellIdx] * m_laplacianDirection[cellIdx]; });
+				const float alpha = residualDotPreconditioned / directionDotLaplacian;
+
+				ForEachCell([&](uint32_t, uint32_t, uint32_t, uint32_t cellIdx)
+				{
+					outPressure[cellIdx] += alpha * m_searchDirection[cellIdx];
+					m_residual[cellIdx] -= alpha * m_laplacianDirection[cellIdx];
+				});
+				const float residualSq = SumCells([&](uint32_t cellIdx) { return m_residual[cellIdx] * m_residual[cellIdx]; });
+				++stats.IterationCount;
+				stats.ResidualNorm = std::sqrt(residualSq);
+				stats.Converged = residualSq <= residualSqThreshold;
+				if (stats.Converged)
+				{
+					break;
+				}
+
+				ApplyPreconditioner();
+				const float newResidualDotPreconditioned = SumCells([&](uint32_t cellIdx) { return m_residual[cellIdx] * m_preconditioned[cellIdx]; });
+				const float beta = newResidualDotPreconditioned / residualDotPreconditioned;
+				residualDotPreconditioned = newResidualDotPreconditioned;
+				ForEachCell([&](uint32_t, uint32_t, uint32_t, uint32_t cellIdx)
+				{
+					m_searchDirection[cellIdx] = m_preconditioned[cellIdx] + beta * m_searchDirection[cellIdx];
+				});
+			}
+			return stats;
+		}
+
+		// ||rhs - A pressure|| over the fluid cells, recomputed rather than the iterations' own
+		float ComputeResidualNorm(const uint8_t* isFluid, const float* rhs, const float* pressure)
+		{
+			SetupDiagonal(isFluid);
+			ApplyLaplacian(pressure, m_laplacianDirection.data());
+			return std::sqrt(SumCells([&](uint32_t cellIdx)
+			{
+				const float residual = isFluid[cellIdx] ? rhs[cellIdx] - m_laplacianDirection[cellIdx] : 0.f;
+				return residual * residual;
+			}));
+		}
+
+	private:
+		template<typename TFunction>
+		void ForEachCell(const TFunction& function) const
+		{
+			Privates::ForEachCell(m_grid, m_workerCount, function);
+		}
+
+		template<typename TTerm>
+		float SumCells(const TTerm& term)
+		{
+			return Privates::SumCells(m_grid, m_workerCount, m_sliceSums, term);
+		}
+
+		// d_i for the fluid cells, 0 for the air ones: the fluid flag the other steps read
+		void SetupDiagonal(const uint8_t* isFluid)
+		{
+			ForEachCell([&](uint32_t x, uint32_t y, uint32_t z, uint32_t cellIdx)
+			{
+				uint32_t nonSolidNeighbourCount = 0;
+				for (uint32_t neighbourIdx = 0; neighbourIdx < 6; ++neighbourIdx)
+				{
+					nonSolidNeighbourCount += Privates::GetNeighbourIdx(m_grid, x, y, z, neighbourIdx) >= 0 ? 1 : 0;
+				}
+				m_diagonal[cellIdx] = isFluid[cellIdx] ? float(nonSolidNeighbourCount) : 0.f;
+			});
+		}
+
+		// Over fluid neighbours only, weighted by factor(neighbourCellIdx), neighbourFirst to neighbourLast excluded of NeighbourOffsets
+		template<typename TFactor>
+		float SumFluidNeighbours(uint32_t x, uint32_t y, uint32_t z, const float* values, uint32_t neighbourFirst, uint32_t neighbourLast, const TFactor& factor) const
+		{
+			float sum = 0.f;
+			for (uint32_t neighbourIdx = neighbourFirst; neighbourIdx < neighbourLast; ++neighbourIdx)
+			{
+				const int64_t neighbourCellIdx = Privates::GetNeighbourIdx(m_grid, x, y, z, neighbourIdx);
+				if (neighbourCellIdx >= 0 && m_diagonal[neighbourCellIdx] > 0.f)
+				{
+					sum += factor(uint32_t(neighbourCellIdx)) * values[neighbourCellIdx];
+				}
+			}
+			return sum;
+		}
+
+		void ApplyLaplacian(const float* values, float* outValues)
+		{
+			ForEachCell([&](uint32_t x, uint32_t y, uint32_t z, uint32_t cellIdx)
+			{
+				const float diagonal = m_diagonal[cellIdx];
+				outValues[cellIdx] = diagonal > 0.f
+					? diagonal * values[cellIdx] - SumFluidNeighbours(x, y, z, values, 0, 6, [](uint32_t) { return 1.f; })
+					: 0.f;
+			});
+		}
+
+		// m_preconditioned = M^-1 m_residual
+		void ApplyPreconditioner()
+		{
+			if (m_settings.Preconditioning == Preconditioner::Jacobi)
+			{
+				ForEachCell([&](uint32_t, uint32_t, uint32_t, uint32_t cellIdx)
+				{
+					const float diagonal = m_diagonal[cellIdx];
+					m_preconditioned[cellIdx] = diagonal > 0.f ? m_residual[cellIdx] / diagonal : 0.f;
+				});
+				return;
+			}
+
+			// t = K^T r: t_i = r_i + (sum of the upper fluid neighbours' r_j) / d_i
+			ForEachCell([&](uint32_t x, uint32_t y, uint32_t z, uint32_t cellIdx)
+			{
+				const float diagonal = m_diagonal[cellIdx];
+				m_preconditionerTemp[cellIdx] = diagonal > 0.f
+					? m_residual[cellIdx] + SumFluidNeighbours(x, y, z, m_residual.data(), Privates::LowerNeighbourCount, 6, [](uint32_t) { return 1.f; }) / diagonal
+					: 0.f;
+			});
+			// z = K t: z_i = t_i + sum of the lower fluid neighbours' t_j / d_j
+			ForEachCell([&](uint32_t x, uint32_t y, uint32_t z, uint32_t cellIdx)
+			{
+				m_preconditioned[cellIdx] = m_diagonal[cellIdx] > 0.f
+					? m_preconditionerTemp[cellIdx] + SumFluidNeighbours(x, y, z, m_preconditionerTemp.data(), 0, Privates::LowerNeighbourCount,
+						[this](uint32_t neighbourCellIdx) { return 1.f / m_diagonal[neighbourCellIdx]; })
+					: 0.f;
+			});
+		}
+
+		PicFlipTransfer::Grid m_grid;
+		SolveSettings m_settings;
+		uint32_t m_workerCount = 0;
+
+		std::vector<float> m_diagonal;
+		std::vector<float> m_residual;
+		std::vector<float> m_preconditioned;
+		std::vector<float> m_searchDirection;
+		std::vector<float> m_laplacianDirection;
+		std::vector<float> m_preconditionerTemp;
+		std::vector<float> m_sliceSums;
+	};
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <Simulation/ParallelPrimitives.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Particle to grid (P2G) transfer of the PIC/FLIP 3D sim, CPU reference of the P2G kernels of Shaders/LagrangianFluidSim/Simulate.hlsl.
+// Atomic free & deterministic: particles are sorted by cell, then every velocity grid node gathers the particles of the cells around it.
+// - ComputeCellKeys: the cell each particle is in
+// - SortByCell: stable sort of the particle indices by cell key, the GPU one records GPUParallelPrimitives::RadixSortKeyValues
+// - FindCellRanges: the range of sorted particles of each cell
+// - GatherToGrid: the weighted average of the sorted particles' velocities, per node & component. Transfer scatters the sorted particles instead,
+//   the same sums in the same order on the CPU.
+// The GPU gathers the cells & their particles in the same order & with the same float operations: the sums match bit for bit.
+// The final division is within the GPU's 2.5 ULP division precision of the one here, & the GPU's grid stores the result as half floats.
+// The GPU's cell keys are brick major (PicFlipBricks::BrickGrid::GetCellKey): the cells sort in another order, their particles don't.
+//
+// Velocities are staggered (MAC): component c of node (i, j, k) is at the centre of the face of cell (i, j, k) facing -c,
+// eg: x at (i, j + 0.5, k + 0.5) in cell units. There's one more node than cells along every axis.
+namespace PicFlipTransfer
+{
+	// Keep in sync with PicFlip::ParticleData & ParticleData in Simulate.hlsl
+	struct Particle
+	{
+		float Pos[3] = {};
+		float Vel[3] = {};
+	};
+	static_assert(sizeof(Particle) == 24, "Particle is mirrored in Simulate.hlsl");
+
+	struct Grid
+	{
+		uint32_t Resolution[3] = {}; // Cells, the velocity grid has Resolution + 1 nodes along every axis
+		float Origin[3] = {}; // World space position of the lower corner
+		float InvCellSize[3] = {}; // Multiplied by, never divided by: the GPU's multiplication is exact, its division isn't
+
+		uint32_t GetCellCount() const
+		{
+			return Resolution[0] * Resolution[1] * Resolution[2];
+		}
+
+		uint32_t GetNodeCount() const
+		{
+			return (Resolution[0] + 1) * (Resolution[1] + 1) * (Resolution[2] + 1);
+		}
+
+		uint32_t GetCellIdx(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			return x + Resolution[0] * (y + Resolution[1] * z);
+		}
+
+		uint32_t GetNodeIdx(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			return x + (Resolution[0] + 1) * (y + (Resolution[1] + 1) * z);
+		}
+
+		// Bits the cell keys are sorted on
+		uint32_t GetCellKeyBitCount() const
+		{
+			return uint32_t(std::bit_width(GetCellCount() - 1));
+		}
+	};
+
+	namespace Privates
+	{
+		// Position in cell units, clamped to the grid: particles outside of it transfer to its boundary
+		inline float GetCellSpaceCoord(const Grid& grid, const Particle& particle, uint32_t axis)
+		{
+			const float coord = (particle.Pos[axis] - grid.Origin[axis]) * grid.InvCellSize[axis];
+			return std::clamp(coord, 0.f, float(grid.Resolution[axis]));
+		}
+
+		// The trilinear weight of node along axis, for a particle at cellSpaceCoord. 0 when the node isn't one of the 2 around it.
+		// Along the component's axis the samples are on the cell faces, along the others at the cell centres.
+		inline float GetNodeAxisWeight(float cellSpaceCoord, int32_t node, bool isComponentAxis)
+		{
+			const float sampleCoord = isComponentAxis ? cellSpaceCoord : cellSpaceCoord - 0.5f;
+			const float baseNode = std::floor(sampleCoord);
+			const float fraction = sampleCoord - baseNode;
+			const int32_t nodeOffset = node - int32_t(baseNode);
+			if (nodeOffset == 0)
+			{
+				return 1.f - fraction;
+			}
+			return nodeOffset == 1 ? fraction : 0.f;
+		}
+	}
+
+	inline uint32_t ComputeCellKey(const Grid& grid, const Particle& particle)
+	{
+		uint32_t cell[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			cell[axis] = std::min(uint32_t(Privates::GetCellSpaceCoord(grid, particle, axis)), grid.Resolution[axis] - 1);
+		}
+		return grid.GetCellIdx(cell[0], cell[1], cell[2]);
+	}
+
+	// outKeys[i]: the cell of particles[i], outParticleIndices[i] = i, the values SortByCell moves along with the keys
+	inline void ComputeCellKeys(const Grid& grid, const Particle* particles, size_t count, uint32_t* outKeys, uint32_t* outParticleIndices)
+	{
+		for (size_t particleIdx = 0; particleIdx < count; ++particleIdx)
+		{
+			outKeys[particleIdx] = ComputeCellKey(grid, particles[particleIdx]);
+			outParticleIndices[particleIdx] = uint32_t(particleIdx);
+		}
+	}
+
+	// Stable, in place: particles of the same cell keep their order, which is what makes the gather's sums deterministic
+	inline void SortByCell(const Grid& grid, uint32_t* keys, uint32_t* particleIndices, size_t count, uint32_t workerCount = 0)
+	{
+		ParallelPrimitives::RadixSortKeyValues(keys, particleIndices, count, grid.GetCellKeyBitCount(), workerCount);
+	}
+
+	// The particles of cell c are sorted [outCellStart[c], outCellEnd[c]), empty cells have start == end
+	inline void FindCellRanges(const Grid& grid, const uint32_t* sortedKeys, size_t count, uint32_t* outCellStart, uint32_t* outCellEnd)
+	{
+		for (uint32_t cellIdx = 0; cellIdx < grid.GetCellCount(); ++cellIdx)
+		{
+			// Binary searches, like the GPU's thread per cell
+			outCellStart[cellIdx] = uint32_t(std::lower_bound(sortedKeys, sortedKeys + count, cellIdx) - sortedKeys);
+			outCellEnd[cellIdx] = uint32_t(std::lower_bound(sortedKeys, sortedKeys + count, cellIdx + 1) - sortedKeys);
+		}
+	}
+
+	// The velocity of node (x, y, z), 3 components, 0 for the components no particle is near
+	inline void GatherNode(const Grid& grid, const Particle* sortedParticles, const uint32_t* cellStart, const uint32_t* cellEnd, uint32_t x, uint32_t y, uint32_t z, float* outVelocity)
+	{
+		const uint32_t node[3] = { x, y, z };
+		float velocitySum[3] = {};
+		float weightSum[3] = {};
+
+		// Particles within a cell of any of the node's 3 samples: the 3x3x3 cells around the node's lower corner cell
+		uint32_t firstCell[3];
+		uint32_t lastCell[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			firstCell[axis] = node[axis] > 0 ? node[axis] - 1 : 0;
+			lastCell[axis] = std::min(node[axis] + 1, grid.Resolution[axis] - 1);
+		}
+
+		for (uint32_t cellZ = firstCell[2]; cellZ <= lastCell[2]; ++cellZ)
+		{
+			for (uint32_t cellY = firstCell[1]; cellY <= lastCell[1]; ++cellY)
+			{
+				for (uint32_t cellX = firstCell[0]; cellX <= lastCell[0]; ++cellX)
+				{
+					const uint32_t cellIdx = grid.GetCellIdx(cellX, cellY, cellZ);
+					for (uint32_t sortedIdx = cellStart[cellIdx]; sortedIdx < cellEnd[cellIdx]; ++sortedIdx)
+					{
+						const Particle& particle = sortedParticles[sortedIdx];
+						const float cellSpacePos[3] = {
+							Privates::GetCellSpaceCoord(grid, particle, 0),
+							Privates::GetCellSpaceCoord(grid, particle, 1),
+							Privates::GetCellSpaceCoord(grid, particle, 2) };
+
+						for (uint32_t component = 0; component < 3; ++component)
+						{
+							const float weightX = Privates::GetNodeAxisWeight(cellSpacePos[0], int32_t(node[0]), component == 0);
+							const float weightY = Privates::GetNodeAxisWeight(cellSpacePos[1], int32_t(node[1]), component == 1);
+							const float weightZ = Privates::GetNodeAxisWeight(cellSpacePos[2], int32_t(node[2]), component == 2);
+							const float weight = weightX * weightY * weightZ;
+							velocitySum[component] += weight * particle.Vel[component];
+							weightSum[component] += weight;
+						}
+					}
+				}
+			}
+		}
+
+		for (uint32_t component = 0; component < 3; ++component)
+		{
+			outVelocity[component] = weightSum[component] > 0.f ? velocitySum[component] / weightSum[component] : 0.f;
+		}
+	}
+
+	// outNodeVelocities: 3 floats per node, x fastest
+	inline void GatherToGrid(const Grid& grid, const Particle* sortedParticles, const uint32_t* cellStart, const uint32_t* cellEnd, float* outNodeVelocities)
+	{
+		for (uint32_t z = 0; z <= grid.Resolution[2]; ++z)
+		{
+			for (uint32_t y = 0; y <= grid.Resolution[1]; ++y)
+			{
+				for (uint32_t x = 0; x <= grid.Resolution[0]; ++x)
+				{
+					GatherNode(grid, sortedParticles, cellStart, cellEnd, x, y, z, &outNodeVelocities[size_t(grid.GetNodeIdx(x, y, z)) * 3]);
+				}
+			}
+		}
+	}
+
+	namespace Privates
+	{
+		// Adds particle to the 2x2x2 nodes around each of its 3 component samples, each node's velocity & weight sums in outSums & weightSums.
+		// The weights are GetNodeAxisWeight's, multiplied in the same x, y, z order: each axis' 2 weights per sample kind are computed once.
+		inline void ScatterParticle(const Grid& grid, const Particle& particle, float* velocitySums, float* weightSums)
+		{
+			int32_t baseNode[2][3]; // [isComponentAxis][axis]
+			float axisWeights[2][3][2]; // [isComponentAxis][axis][nodeOffset]
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float cellSpaceCoord = GetCellSpaceCoord(grid, particle, axis);
+				for (uint32_t isComponentAxis = 0; isComponentAxis < 2; ++isComponentAxis)
+				{
+					const float sampleCoord = isComponentAxis ? cellSpaceCoord : cellSpaceCoord - 0.5f;
+					const float node = std::floor(sampleCoord);
+					const float fraction = sampleCoord - node;
+					baseNode[isComponentAxis][axis] = int32_t(node);
+					axisWeights[isComponentAxis][axis][0] = 1.f - fraction;
+					axisWeights[isComponentAxis][axis][1] = fraction;
+				}
+			}
+
+			for (uint32_t component = 0; component < 3; ++component)
+			{
+				int32_t componentBaseNode[3];
+				const float* weights[3];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					componentBaseNode[axis] = baseNode[axis == component][axis];
+					weights[axis] = axisWeights[axis == component][axis];
+				}
+
+				for (int32_t offsetZ = 0; offsetZ < 2; ++offsetZ)
+				{
+					const int32_t nodeZ = componentBaseNode[2] + offsetZ;
+					if (nodeZ < 0 || nodeZ > int32_t(grid.Resolution[2]))
+					{
+						continue;
+					}
+					for (int32_t offsetY = 0; offsetY < 2; ++offsetY)
+					{
+						const int32_t nodeY = componentBaseNode[1] + offsetY;
+						if (nodeY < 0 || nodeY > int32_t(grid.Resolution[1]))
+						{
+							continue;
+						}
+						for (int32_t offsetX = 0; offsetX < 2; ++offsetX)
+						{
+							const int32_t nodeX = componentBaseNode[0] + offsetX;
+							if (nodeX < 0 || nodeX > int32_t(grid.Resolution[0]))
+							{
+								continue;
+							}
+
+							const float weight = weights[0][offsetX] * weights[1][offsetY] * weights[2][offsetZ];
+							const size_t valueIdx = size_t(grid.GetNodeIdx(uint32_t(nodeX), uint32_t(nodeY), uint32_t(nodeZ))) * 3 + component;
+							velocitySums[valueIdx] += weight * particle.Vel[component];
+							weightSums[valueIdx] += weight;
+						}
+					}
+				}
+			}
+		}
+
+		// weightSums is scratch, resized to the grid
+		inline void ScatterToGrid(const Grid& grid, const Particle* particles, size_t count, std::vector<float>& weightSums, float* outNodeVelocities)
+		{
+			weightSums.assign(size_t(grid.GetNodeCount()) * 3, 0.f);
+			std::fill(outNodeVelocities, outNodeVelocities + weightSums.size(), 0.f);
+
+			for (size_t particleIdx = 0; particleIdx < count; ++particleIdx)
+			{
+				ScatterParticle(grid, particles[particleIdx], outNodeVelocities, weightSums.data());
+			}
+
+			for (size_t valueIdx = 0; valueIdx < weightSums.size(); ++valueIdx)
+			{
+				outNodeVelocities[valueIdx] = weightSums[valueIdx] > 0.f ? outNodeVelocities[valueIdx] / weightSums[valueIdx] : 0.f;
+			}
+		}
+	}
+
+	// The scatter the sort & gather replace, each particle adding to its nodes in particle order: what the GPU could only do with float atomics,
+	// in whatever order they land in. Same grid up to the sums' rounding.
+	inline void ScatterToGrid(const Grid& grid, const Particle* particles, size_t count, float* outNodeVelocities)
+	{
+		std::vector<float> weightSums;
+		Privates::ScatterToGrid(grid, particles, count, weightSums, outNodeVelocities);
+	}
+
+	// The whole sorted transfer, the GPU's grid: particles are left sorted by cell in outSortedParticles,
+	// coherent in memory for the grid to particle transfer.
+	// A node gathers the cells around it in cell order & their particles in sorted order, so it adds up its particles in sorted order,
+	// skipping none but the ones of 0 weight, which leave its sums unchanged. Scattering the sorted particles in order adds the same terms
+	// in the same order: the CPU gets the gather's grid bit for bit without visiting 27 cells per node, GatherToGrid is kept for the tests.
+	class Transfer
+	{
+	public:
+		void Run(const Grid& grid, const Particle* particles, size_t count, std::vector<Particle>& outSortedParticles, std::vector<float>& outNodeVelocities)
+		{
+			m_keys.resize(count);
+			m_particleIndices.resize(count);
+			outSortedParticles.resize(count);
+			outNodeVelocities.resize(size_t(grid.GetNodeCount()) * 3);
+
+			ComputeCellKeys(grid, particles, count, m_keys.data(), m_particleIndices.data());
+			SortByCell(grid, m_keys.data(), m_particleIndices.data(), count);
+			for (size_t sortedIdx = 0; sortedIdx < count; ++sortedIdx)
+			{
+				outSortedParticles[sortedIdx] = particles[m_particleIndices[sortedIdx]];
+			}
+			Privates::ScatterToGrid(grid, outSortedParticles.data(), count, m_weightSums, outNodeVelocities.data());
+		}
+
+	private:
+		std::vector<uint32_t> m_keys;
+		std::vector<uint32_t> m_particleIndices;
+		std::vector<float> m_weightSums;
+	};
+}
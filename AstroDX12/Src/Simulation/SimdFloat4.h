@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define ASTRO_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define ASTRO_SIMD_SSE 0
+#endif
+
+// 4 wide float vector for the CPU sim references, one lane per simulated object (eg: 4 chains solved together).
+// SSE when available, plain scalar loops otherwise: same results, only slower.
+struct SimdFloat4
+{
+#if ASTRO_SIMD_SSE
+	__m128 Value;
+
+	SimdFloat4() : Value(_mm_setzero_ps()) {}
+	SimdFloat4(__m128 value) : Value(value) {}
+	explicit SimdFloat4(float value) : Value(_mm_set1_ps(value)) {}
+
+	static SimdFloat4 Load(const float* data) { return _mm_loadu_ps(data); }
+	void Store(float* data) const { _mm_storeu_ps(data, Value); }
+
+	friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return _mm_add_ps(a.Value, b.Value); }
+	friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return _mm_sub_ps(a.Value, b.Value); }
+	friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return _mm_mul_ps(a.Value, b.Value); }
+	friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return _mm_div_ps(a.Value, b.Value); }
+
+	// Comparisons return all-bits-set lanes where true, for Select
+	friend SimdFloat4 operator<(SimdFloat4 a, SimdFloat4 b) { return _mm_cmplt_ps(a.Value, b.Value); }
+	friend SimdFloat4 operator>(SimdFloat4 a, SimdFloat4 b) { return _mm_cmpgt_ps(a.Value, b.Value); }
+	friend SimdFloat4 operator&(SimdFloat4 a, SimdFloat4 b) { return _mm_and_ps(a.Value, b.Value); }
+
+	static SimdFloat4 Sqrt(SimdFloat4 a) { return _mm_sqrt_ps(a.Value); }
+	static SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return _mm_max_ps(a.Value, b.Value); }
+	static SimdFloat4 Abs(SimdFloat4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.Value); }
+	// mask ? a : b, per lane
+	static SimdFloat4 Select(SimdFloat4 mask, SimdFloat4 a, SimdFloat4 b) { return _mm_or_ps(_mm_and_ps(mask.Value, a.Value), _mm_andnot_ps(mask.Value, b.Value)); }
+	static bool AnyTrue(SimdFloat4 mask) { return _mm_movemask_ps(mask.Value) != 0; }
+#else
+	float Value[4];
+
+	SimdFloat4() : Value{ 0.f, 0.f, 0.f, 0.f } {}
+	explicit SimdFloat4(float value) : Value{ value, value, value, value } {}
+
+	static SimdFloat4 Load(const float* data) { SimdFloat4 result; for (int lane = 0; lane < 4; ++lane) result.Value[lane] = data[lane]; return result; }
+	void Store(float* data) const { for (int lane = 0; lane < 4; ++lane) data[lane] = Value[lane]; }
+
+	template<typename TOp>
+	static SimdFloat4 PerLane(SimdFloat4 a, SimdFloat4 b, TOp op) { SimdFloat4 result; for (int lane = 0; lane < 4; ++lane) result.Value[lane] = op(a.Value[lane], b.Value[lane]); return result; }
+	static float MaskFrom(bool condition) { const uint32_t bits = condition ? 0xFFFFFFFFu : 0u; float mask; memcpy(&mask, &bits, sizeof(mask)); return mask; }
+	static bool IsSet(float mask) { uint32_t bits; memcpy(&bits, &mask, sizeof(bits)); return bits != 0; }
+
+	friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return x + y; }); }
+	friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return x - y; }); }
+	friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return x * y; }); }
+	friend SimdFloat4 operator/(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return x / y; }); }
+
+	friend SimdFloat4 operator<(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return MaskFrom(x < y); }); }
+	friend SimdFloat4 operator>(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return MaskFrom(x > y); }); }
+	friend SimdFloat4 operator&(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return MaskFrom(IsSet(x) && IsSet(y)); }); }
+
+	static SimdFloat4 Sqrt(SimdFloat4 a) { SimdFloat4 result; for (int lane = 0; lane < 4; ++lane) result.Value[lane] = std::sqrt(a.Value[lane]); return result; }
+	static SimdFloat4 Max(SimdFloat4 a, SimdFloat4 b) { return PerLane(a, b, [](float x, float y) { return x > y ? x : y; }); }
+	static SimdFloat4 Abs(SimdFloat4 a) { SimdFloat4 result; for (int lane = 0; lane < 4; ++lane) result.Value[lane] = std::fabs(a.Value[lane]); return result; }
+	static SimdFloat4 Select(SimdFloat4 mask, SimdFloat4 a, SimdFloat4 b) { SimdFloat4 result; for (int lane = 0; lane < 4; ++lane) result.Value[lane] = IsSet(mask.Value[lane]) ? a.Value[lane] : b.Value[lane]; return result; }
+	static bool AnyTrue(SimdFloat4 mask) { for (int lane = 0; lane < 4; ++lane) if (IsSet(mask.Value[lane])) return true; return false; }
+#endif
+};
+
+// 3D vector of SimdFloat4: 4 lanes of xyz, structure of arrays
+struct SimdFloat3x4
+{
+	SimdFloat4 X;
+	SimdFloat4 Y;
+	SimdFloat4 Z;
+
+	friend SimdFloat3x4 operator+(const SimdFloat3x4& a, const SimdFloat3x4& b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+	friend SimdFloat3x4 operator-(const SimdFloat3x4& a, const SimdFloat3x4& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+	friend SimdFloat3x4 operator*(const SimdFloat3x4& a, SimdFloat4 s) { return { a.X * s, a.Y * s, a.Z * s }; }
+
+	static SimdFloat4 Dot(const SimdFloat3x4& a, const SimdFloat3x4& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+	static SimdFloat4 Length(const SimdFloat3x4& a) { return SimdFloat4::Sqrt(Dot(a, a)); }
+	static SimdFloat3x4 Select(SimdFloat4 mask, const SimdFloat3x4& a, const SimdFloat3x4& b)
+	{
+		return { SimdFloat4::Select(mask, a.X, b.X), SimdFloat4::Select(mask, a.Y, b.Y), SimdFloat4::Select(mask, a.Z, b.Z) };
+	}
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+// What a simulation pass has to run this frame: StepCount fixed steps of StepDeltaTime seconds each.
+// InterpolationAlpha is how far (in [0, 1) steps) the real time is past the last simulated state, used to blend rendering between sim states.
+struct SimStepData
+{
+	uint32_t StepCount = 1;
+	float StepDeltaTime = 1.f / 60.f;
+	float InterpolationAlpha = 0.f;
+};
+
+// Fixed timestep clock, decoupling a simulation's update rate from the render rate.
+// Accumulates real time each frame and hands out however many whole steps fit in it (possibly 0), up to a cap.
+// No platform types in here, can be driven with any sequence of frame times.
+class FixedStepScheduler final
+{
+public:
+	FixedStepScheduler(float stepRateHz = 60.f, uint32_t maxStepsPerFrame = 4)
+	{
+		SetStepRate(stepRateHz);
+		SetMaxStepsPerFrame(maxStepsPerFrame);
+	}
+
+	SimStepData Advance(float realDeltaSeconds)
+	{
+		m_accumulatedTime += std::max(double(realDeltaSeconds), 0.0);
+
+		uint32_t stepCount = uint32_t(m_accumulatedTime / m_stepDeltaTime);
+		if (stepCount > m_maxStepsPerFrame)
+		{
+			// The sim can't keep up (or the app was stalled), drop the time it's behind on rather than
+			// carrying it over: catching up would make the next frames even slower (spiral of death).
+			m_droppedStepCount += stepCount - m_maxStepsPerFrame;
+			stepCount = m_maxStepsPerFrame;
+			m_accumulatedTime -= double(stepCount) * m_stepDeltaTime;
+			m_accumulatedTime -= double(uint32_t(m_accumulatedTime / m_stepDeltaTime)) * m_stepDeltaTime;
+		}
+		else
+		{
+			m_accumulatedTime -= double(stepCount) * m_stepDeltaTime;
+		}
+
+		m_totalStepCount += stepCount;
+
+		SimStepData stepData;
+		stepData.StepCount = stepCount;
+		stepData.StepDeltaTime = float(m_stepDeltaTime);
+		// Just short of a step can still round up to 1 as a float, kept below it
+		stepData.InterpolationAlpha = std::min(float(std::clamp(m_accumulatedTime / m_stepDeltaTime, 0.0, 1.0)), std::nextafter(1.f, 0.f));
+		return stepData;
+	}
+
+	// Keeps the accumulated time, the new rate applies from the next Advance
+	void SetStepRate(float stepRateHz)
+	{
+		assert(stepRateHz > 0.f);
+		m_stepRateHz = stepRateHz;
+		m_stepDeltaTime = 1.0 / double(stepRateHz);
+	}
+
+	void SetMaxStepsPerFrame(uint32_t maxStepsPerFrame)
+	{
+		assert(maxStepsPerFrame > 0);
+		m_maxStepsPerFrame = maxStepsPerFrame;
+	}
+
+	// Forgets any accumulated time, eg: when the sim is reset or re-enabled
+	void Reset()
+	{
+		m_accumulatedTime = 0.0;
+	}
+
+	float GetStepRate() const { return m_stepRateHz; }
+	float GetStepDeltaTime() const { return float(m_stepDeltaTime); }
+	uint32_t GetMaxStepsPerFrame() const { return m_maxStepsPerFrame; }
+	uint64_t GetTotalStepCount() const { return m_totalStepCount; }
+	uint64_t GetDroppedStepCount() const { return m_droppedStepCount; }
+
+private:
+	float m_stepRateHz = 60.f;
+	double m_stepDeltaTime = 1.0 / 60.0;
+	uint32_t m_maxStepsPerFrame = 4;
+
+	double m_accumulatedTime = 0.0; // Real time not simulated yet, always less than a step after Advance
+	uint64_t m_totalStepCount = 0;
+	uint64_t m_droppedStepCount = 0;
+};